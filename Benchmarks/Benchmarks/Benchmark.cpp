@@ -0,0 +1,120 @@
+//***************************************************************************************
+// Benchmark.cpp
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+BenchmarkRunner::BenchmarkRunner(const Options& options) :
+	mOptions(options)
+{
+	mOptions.Samples = (std::max)(mOptions.Samples, 1u);
+}
+
+bool BenchmarkRunner::Selected(const std::string& name)const
+{
+	return mOptions.Filter.empty() || name.find(mOptions.Filter) != std::string::npos;
+}
+
+void BenchmarkRunner::Skip(const std::string& name, const std::string& reason)
+{
+	if (!Selected(name))
+		return;
+
+	Result result;
+	result.Name = name;
+	result.Skipped = reason;
+	mResults.push_back(result);
+
+	std::cout << std::left << std::setw(44) << name << "skipped: " << reason << '\n';
+}
+
+void BenchmarkRunner::DoNotOptimize(const void* p)
+{
+	// A volatile store of the address is cheap and the optimizer cannot see past it.
+	static const void* volatile sink;
+	sink = p;
+}
+
+double BenchmarkRunner::NowMs()
+{
+	static double msPerCount = 0.0;
+	if (msPerCount == 0.0)
+	{
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		msPerCount = 1000.0 / (double)frequency.QuadPart;
+	}
+
+	LARGE_INTEGER time;
+	QueryPerformanceCounter(&time);
+	return (double)time.QuadPart * msPerCount;
+}
+
+void BenchmarkRunner::AddResult(const std::string& name, UINT64 opsPerCall, std::vector<double>& samplesNs)
+{
+	std::sort(samplesNs.begin(), samplesNs.end());
+
+	size_t count = samplesNs.size();
+	Result result;
+	result.Name = name;
+	result.OpsPerCall = opsPerCall;
+	result.MedianNs = samplesNs[count / 2];
+	result.MinNs = samplesNs.front();
+	result.Spread = result.MedianNs > 0.0 ?
+		(samplesNs[count * 3 / 4] - samplesNs[count / 4]) / result.MedianNs : 0.0;
+	mResults.push_back(result);
+
+	std::cout << std::left << std::setw(44) << name << std::right << std::fixed
+		<< std::setprecision(3) << std::setw(14) << result.MedianNs << " ns/op   +/- "
+		<< std::setprecision(1) << result.Spread * 100.0 << "%\n";
+}
+
+bool BenchmarkRunner::WriteJson(const std::wstring& filename)const
+{
+	std::ofstream fout(filename, std::ios::trunc);
+	if (!fout)
+		return false;
+
+#if defined(DEBUG) || defined(_DEBUG)
+	const char* configuration = "Debug";
+#else
+	const char* configuration = "Release";
+#endif
+#if defined(_WIN64)
+	const char* platform = "x64";
+#else
+	const char* platform = "Win32";
+#endif
+
+	fout << "{\n";
+	fout << "  \"configuration\": \"" << configuration << "\",\n";
+	fout << "  \"platform\": \"" << platform << "\",\n";
+	fout << "  \"samples\": " << mOptions.Samples << ",\n";
+	fout << "  \"benchmarks\": [\n";
+
+	fout << std::fixed;
+	for (size_t i = 0; i < mResults.size(); ++i)
+	{
+		const Result& r = mResults[i];
+		fout << "    {\"name\": \"" << r.Name << "\"";
+		if (!r.Skipped.empty())
+		{
+			fout << ", \"skipped\": \"" << r.Skipped << "\"}";
+		}
+		else
+		{
+			fout << std::setprecision(3)
+				<< ", \"ns_per_op\": " << r.MedianNs
+				<< ", \"min_ns_per_op\": " << r.MinNs
+				<< ", \"spread\": " << r.Spread
+				<< ", \"ops_per_call\": " << r.OpsPerCall << "}";
+		}
+		fout << (i + 1 < mResults.size() ? ",\n" : "\n");
+	}
+
+	fout << "  ]\n}\n";
+	return fout.good();
+}
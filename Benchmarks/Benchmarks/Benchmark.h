@@ -0,0 +1,111 @@
+//***************************************************************************************
+// Benchmark.h
+//
+// A small harness for timing Common code on its own, without a window or a demo.
+//
+//     runner.Run("waves/update/256", 256 * 256, [&]() { waves.Update(dt); });
+//
+// Run() first finds how many calls of fn fill SampleMs, then times that many calls
+// Samples times and keeps the median per operation (opsPerCall operations per call,
+// e.g. vertices), which a stray context switch or frequency change cannot move much.
+// The spread (interquartile range over the median) tells how far to trust a result.
+//
+// WriteJson() writes one line per benchmark in the order they ran, with fixed
+// precision, so the files of two commits diff line by line.
+//***************************************************************************************
+
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+class BenchmarkRunner
+{
+public:
+	struct Options
+	{
+		// Only benchmarks whose name contains Filter run; empty runs them all.
+		std::string Filter;
+		UINT Samples = 15;
+		double SampleMs = 20.0;
+	};
+
+	explicit BenchmarkRunner(const Options& options);
+	BenchmarkRunner(const BenchmarkRunner& rhs) = delete;
+	BenchmarkRunner& operator=(const BenchmarkRunner& rhs) = delete;
+	~BenchmarkRunner() = default;
+
+	bool Selected(const std::string& name)const;
+
+	template<typename Fn>
+	void Run(const std::string& name, UINT64 opsPerCall, const Fn& fn);
+
+	// Notes a benchmark that could not run, e.g. without a D3D12 device.
+	void Skip(const std::string& name, const std::string& reason);
+
+	// Keeps the compiler from dropping work whose result is otherwise unused.
+	static void DoNotOptimize(const void* p);
+
+	bool WriteJson(const std::wstring& filename)const;
+
+private:
+	struct Result
+	{
+		std::string Name;
+		UINT64 OpsPerCall = 0;
+		double MedianNs = 0.0;   // per operation
+		double MinNs = 0.0;
+		double Spread = 0.0;
+		std::string Skipped;
+	};
+
+	static double NowMs();
+
+	void AddResult(const std::string& name, UINT64 opsPerCall, std::vector<double>& samplesNs);
+
+private:
+	Options mOptions;
+	std::vector<Result> mResults;
+};
+
+template<typename Fn>
+void BenchmarkRunner::Run(const std::string& name, UINT64 opsPerCall, const Fn& fn)
+{
+	if (!Selected(name))
+		return;
+
+	// Warms the caches and finds the calls per sample, doubling until one is long
+	// enough to time.
+	UINT64 calls = 1;
+	for (;;)
+	{
+		double start = NowMs();
+		for (UINT64 i = 0; i < calls; ++i)
+			fn();
+		double elapsed = NowMs() - start;
+
+		if (elapsed >= mOptions.SampleMs || calls >= (1ull << 32))
+			break;
+
+		if (elapsed <= 0.0)
+			calls *= 16;
+		else
+			calls = (std::max)(calls * 2, (UINT64)(calls * mOptions.SampleMs / elapsed));
+	}
+
+	std::vector<double> samplesNs;
+	samplesNs.reserve(mOptions.Samples);
+	for (UINT s = 0; s < mOptions.Samples; ++s)
+	{
+		double start = NowMs();
+		for (UINT64 i = 0; i < calls; ++i)
+			fn();
+		double elapsed = NowMs() - start;
+
+		samplesNs.push_back(elapsed * 1.0e6 / (double)(calls * opsPerCall));
+	}
+
+	AddResult(name, opsPerCall, samplesNs);
+}
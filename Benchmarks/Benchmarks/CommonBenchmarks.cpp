@@ -0,0 +1,471 @@
+//***************************************************************************************
+// CommonBenchmarks.cpp
+//
+// Microbenchmarks of the Common building blocks the demos spend their CPU time in.
+// A console program: it needs no window, and a D3D12 device only for the upload
+// heap benchmarks, which are skipped without one.
+//
+//     Benchmarks.exe [-out <file.json>] [-filter <substring>] [-samples <n>] [-models <dir>]
+//
+// Run the Release build; Debug numbers say little.  The main thread is pinned to one
+// core and raised in priority so its samples do not migrate mid-run.  Every input
+// comes from a fixed seed, so two commits time the same work.
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include "../../Common/d3dUtil.h"
+#include "../../Common/UploadBuffer.h"
+#include "../../Common/GeometryGenerator.h"
+#include "../../Common/MathHelper.h"
+#include "../../Common/Camera.h"
+#include "../../Common/JobSystem.h"
+#include "../../Common/MeshFile.h"
+#include "../../Common/VertexQuantizer.h"
+#include "../../BlendDemo/BlendDemo/Waves.h"
+#include <cstring>
+#include <iostream>
+
+#pragma comment(lib, "d3dcompiler.lib")
+#pragma comment(lib, "D3D12.lib")
+#pragma comment(lib, "dxgi.lib")
+
+using Microsoft::WRL::ComPtr;
+using namespace DirectX;
+
+namespace
+{
+	// BlendDemo's vertex layout, as Waves::WriteVertices() writes it.
+	struct Vertex
+	{
+		XMFLOAT3 Pos;
+		XMFLOAT3 Normal;
+		XMFLOAT2 TexC;
+	};
+
+	// ObjectConstants as the demos lay them out, one per 256-byte constant buffer slot.
+	struct ObjectConstants
+	{
+		XMFLOAT4X4 World = MathHelper::Identity4x4();
+		XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+	};
+
+	// A tiny deterministic generator, so the inputs do not depend on rand()'s state.
+	struct Lcg
+	{
+		UINT State = 12345;
+
+		UINT Next()
+		{
+			State = State * 1664525u + 1013904223u;
+			return State >> 8;
+		}
+
+		float NextFloat(float a, float b)
+		{
+			return a + (b - a) * (float)(Next() & 0xFFFF) / 65535.0f;
+		}
+	};
+
+	// The stencil update stays well clear of denormals if the grid keeps moving, so
+	// each benchmarked step is preceded by a disturbance now and then.
+	void DisturbSome(Waves& waves, Lcg& lcg)
+	{
+		int i = 5 + (int)(lcg.Next() % (UINT)(waves.RowCount() - 10));
+		int j = 5 + (int)(lcg.Next() % (UINT)(waves.ColumnCount() - 10));
+		waves.Disturb(i, j, 0.5f);
+	}
+
+	const float WaveTimeStep = 0.03f;
+
+	void BenchmarkWaves(BenchmarkRunner& runner, JobSystem& jobs)
+	{
+		const int gridSizes[] = { 128, 256, 512, 1024 };
+		for (int n : gridSizes)
+		{
+			std::string size = std::to_string(n);
+			UINT64 points = (UINT64)n * n;
+
+			{
+				Waves waves(n, n, 1.0f, WaveTimeStep, 4.0f, 0.2f);
+				Lcg lcg;
+				UINT step = 0;
+				runner.Run("waves/update_serial/" + size, points, [&]()
+				{
+					if ((step++ & 15) == 0)
+						DisturbSome(waves, lcg);
+					waves.Update(WaveTimeStep);
+				});
+			}
+
+			{
+				Waves waves(n, n, 1.0f, WaveTimeStep, 4.0f, 0.2f);
+				Lcg lcg;
+				UINT step = 0;
+				runner.Run("waves/update_parallel/" + size, points, [&]()
+				{
+					if ((step++ & 15) == 0)
+						DisturbSome(waves, lcg);
+					waves.Update(WaveTimeStep, jobs);
+				});
+			}
+
+			{
+				// Flat water: no tile is active, so a step only scans the tile map.
+				Waves waves(n, n, 1.0f, WaveTimeStep, 4.0f, 0.2f);
+				runner.Run("waves/update_calm/" + size, points, [&]()
+				{
+					waves.Update(WaveTimeStep);
+				});
+			}
+
+			{
+				Waves waves(n, n, 1.0f, WaveTimeStep, 4.0f, 0.2f);
+				Lcg lcg;
+				const UINT disturbsPerCall = 256;
+				runner.Run("waves/disturb/" + size, disturbsPerCall, [&]()
+				{
+					for (UINT k = 0; k < disturbsPerCall; ++k)
+						DisturbSome(waves, lcg);
+				});
+			}
+		}
+	}
+
+	ComPtr<ID3D12Device> CreateDevice()
+	{
+		ComPtr<ID3D12Device> device;
+		if (SUCCEEDED(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(device.GetAddressOf()))))
+			return device;
+
+		// Upload heaps are plain write-combined system memory on WARP too.
+		ComPtr<IDXGIFactory4> factory;
+		ComPtr<IDXGIAdapter> warpAdapter;
+		if (SUCCEEDED(CreateDXGIFactory1(IID_PPV_ARGS(factory.GetAddressOf()))) &&
+			SUCCEEDED(factory->EnumWarpAdapter(IID_PPV_ARGS(warpAdapter.GetAddressOf()))) &&
+			SUCCEEDED(D3D12CreateDevice(warpAdapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(device.GetAddressOf()))))
+			return device;
+
+		return nullptr;
+	}
+
+	void BenchmarkUploads(BenchmarkRunner& runner, ID3D12Device* device)
+	{
+		const UINT vertexCount = 256 * 256;
+		const UINT objectCount = 1024;
+
+		if (device == nullptr)
+		{
+			runner.Skip("upload/vertices_copydata_each", "no D3D12 device");
+			runner.Skip("upload/vertices_copydata_range", "no D3D12 device");
+			runner.Skip("upload/vertices_write_in_place", "no D3D12 device");
+			runner.Skip("upload/objects_copydata_each", "no D3D12 device");
+			runner.Skip("upload/objects_stream_in_place", "no D3D12 device");
+			return;
+		}
+
+		Waves waves(256, 256, 1.0f, WaveTimeStep, 4.0f, 0.2f);
+		std::vector<Vertex> vertices(vertexCount);
+		waves.WriteVertices(vertices.data());
+
+		UploadBuffer<Vertex> vertexBuffer(device, vertexCount, false);
+
+		runner.Run("upload/vertices_copydata_each", vertexCount, [&]()
+		{
+			for (UINT i = 0; i < vertexCount; ++i)
+				vertexBuffer.CopyData((int)i, vertices[i]);
+		});
+
+		runner.Run("upload/vertices_copydata_range", vertexCount, [&]()
+		{
+			vertexBuffer.CopyData(0, vertices.data(), vertexCount);
+		});
+
+		// What BlendDemo does: generate the vertices straight into the upload heap.
+		runner.Run("upload/vertices_write_in_place", vertexCount, [&]()
+		{
+			waves.WriteVertices(vertexBuffer.MappedData());
+		});
+
+		Lcg lcg;
+		std::vector<XMFLOAT4X4> worlds(objectCount);
+		for (auto& world : worlds)
+			XMStoreFloat4x4(&world, XMMatrixRotationY(lcg.NextFloat(0.0f, MathHelper::Pi)) *
+				XMMatrixTranslation(lcg.NextFloat(-50.0f, 50.0f), 0.0f, lcg.NextFloat(-50.0f, 50.0f)));
+
+		UploadBuffer<ObjectConstants> objectCB(device, objectCount, true);
+
+		runner.Run("upload/objects_copydata_each", objectCount, [&]()
+		{
+			for (UINT i = 0; i < objectCount; ++i)
+			{
+				ObjectConstants objConstants;
+				XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(XMLoadFloat4x4(&worlds[i])));
+				objectCB.CopyData((int)i, objConstants);
+			}
+		});
+
+		runner.Run("upload/objects_stream_in_place", objectCount, [&]()
+		{
+			XMMATRIX identity = XMMatrixIdentity();
+			for (UINT i = 0; i < objectCount; ++i)
+			{
+				ObjectConstants* dest = objectCB.MappedElement((int)i);
+				MathHelper::StoreTransposedStream(&dest->World, XMLoadFloat4x4(&worlds[i]));
+				MathHelper::StoreTransposedStream(&dest->TexTransform, identity);
+			}
+			MathHelper::StreamFence();
+		});
+	}
+
+	void BenchmarkGeometry(BenchmarkRunner& runner)
+	{
+		GeometryGenerator geoGen;
+
+		// CreateGeosphere and CreateBox subdivide their base mesh once per level.
+		for (UINT subdivisions : { 4u, 6u })
+		{
+			std::string level = std::to_string(subdivisions);
+			GeometryGenerator::MeshSize size = GeometryGenerator::GeosphereSize(subdivisions);
+
+			runner.Run("geometry/create_geosphere/" + level, 1, [&]()
+			{
+				GeometryGenerator::MeshData mesh = geoGen.CreateGeosphere(1.0f, subdivisions);
+				BenchmarkRunner::DoNotOptimize(mesh.Vertices.data());
+			});
+
+			std::vector<GeometryGenerator::Vertex> vertices(size.VertexCount);
+			std::vector<uint32_t> indices(size.IndexCount);
+			GeometryGenerator::MeshSpans spans;
+			spans.Vertices = vertices.data();
+			spans.Indices = indices.data();
+
+			runner.Run("geometry/write_geosphere/" + level, 1, [&]()
+			{
+				geoGen.WriteGeosphere(1.0f, subdivisions, spans);
+				BenchmarkRunner::DoNotOptimize(vertices.data());
+			});
+
+			runner.Run("geometry/create_box/" + level, 1, [&]()
+			{
+				GeometryGenerator::MeshData mesh = geoGen.CreateBox(1.0f, 1.0f, 1.0f, subdivisions);
+				BenchmarkRunner::DoNotOptimize(mesh.Vertices.data());
+			});
+		}
+
+		for (UINT n : { 256u, 1024u })
+		{
+			std::string level = std::to_string(n);
+			GeometryGenerator::MeshSize size = GeometryGenerator::GridSize(n, n);
+
+			runner.Run("geometry/create_grid/" + level, 1, [&]()
+			{
+				GeometryGenerator::MeshData mesh = geoGen.CreateGrid(160.0f, 160.0f, n, n);
+				BenchmarkRunner::DoNotOptimize(mesh.Vertices.data());
+			});
+
+			std::vector<GeometryGenerator::Vertex> vertices(size.VertexCount);
+			std::vector<uint32_t> indices(size.IndexCount);
+			GeometryGenerator::MeshSpans spans;
+			spans.Vertices = vertices.data();
+			spans.Indices = indices.data();
+
+			runner.Run("geometry/write_grid/" + level, 1, [&]()
+			{
+				geoGen.WriteGrid(160.0f, 160.0f, n, n, spans);
+				BenchmarkRunner::DoNotOptimize(vertices.data());
+			});
+		}
+	}
+
+	void BenchmarkMeshLoading(BenchmarkRunner& runner, const std::wstring& modelDirectory)
+	{
+		// The skull as BuildSkullGeometry() reads it: position and normal.
+		struct SkullVertex
+		{
+			XMFLOAT3 Pos;
+			XMFLOAT3 Normal;
+		};
+
+		std::wstring textFile = modelDirectory + L"skull.txt";
+		TextMesh text;
+		if (!ImportTextMesh(textFile, text))
+		{
+			runner.Skip("mesh/skull_import_text", "skull.txt not found, see -models");
+			runner.Skip("mesh/skull_quantize", "skull.txt not found, see -models");
+			runner.Skip("mesh/skull_open_binary", "skull.txt not found, see -models");
+			return;
+		}
+
+		runner.Run("mesh/skull_import_text", 1, [&]()
+		{
+			TextMesh mesh;
+			ImportTextMesh(textFile, mesh);
+			BenchmarkRunner::DoNotOptimize(mesh.Positions.data());
+		});
+
+		std::vector<SkullVertex> vertices(text.Positions.size());
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			vertices[i].Pos = text.Positions[i];
+			vertices[i].Normal = text.Normals[i];
+		}
+
+		// The conversion the exporter runs before it writes a compact mesh file.
+		VertexAttributes attributes;
+		attributes.Stride = sizeof(SkullVertex);
+		attributes.Position = offsetof(SkullVertex, Pos);
+		attributes.Normal = offsetof(SkullVertex, Normal);
+		std::vector<CompactVertex> compactVertices(vertices.size());
+		runner.Run("mesh/skull_quantize", vertices.size(), [&]()
+		{
+			VertexQuantizer::Quantize(vertices.data(), attributes, (UINT)vertices.size(),
+				text.Bounds, PositionEncoding::Unorm16, compactVertices.data());
+			BenchmarkRunner::DoNotOptimize(compactVertices.data());
+		});
+
+		wchar_t tempPath[MAX_PATH];
+		GetTempPath(MAX_PATH, tempPath);
+		std::wstring binaryFile = std::wstring(tempPath) + L"skull_benchmark.mesh";
+		if (!MeshFile::Write(binaryFile, vertices.data(), sizeof(SkullVertex), (UINT)vertices.size(),
+			text.Indices.data(), sizeof(uint32_t), (UINT)text.Indices.size(), text.Bounds))
+		{
+			runner.Skip("mesh/skull_open_binary", "cannot write the temporary mesh file");
+			return;
+		}
+
+		// Mapping alone touches nothing, so copy the blobs out as an upload would.
+		std::vector<BYTE> copy(vertices.size() * sizeof(SkullVertex) + text.Indices.size() * sizeof(uint32_t));
+		runner.Run("mesh/skull_open_binary", 1, [&]()
+		{
+			MeshFile mesh;
+			if (mesh.Open(binaryFile, sizeof(SkullVertex)))
+			{
+				memcpy(copy.data(), mesh.Vertices(), mesh.VertexByteSize());
+				memcpy(copy.data() + mesh.VertexByteSize(), mesh.Indices(), mesh.IndexByteSize());
+			}
+			BenchmarkRunner::DoNotOptimize(copy.data());
+		});
+
+		DeleteFile(binaryFile.c_str());
+	}
+
+	void BenchmarkMath(BenchmarkRunner& runner)
+	{
+		const UINT count = 1024;
+
+		Lcg lcg;
+		std::vector<XMFLOAT4X4> matrices(count);
+		std::vector<XMFLOAT2> points(count);
+		for (UINT i = 0; i < count; ++i)
+		{
+			XMStoreFloat4x4(&matrices[i],
+				XMMatrixScaling(lcg.NextFloat(0.5f, 2.0f), lcg.NextFloat(0.5f, 2.0f), lcg.NextFloat(0.5f, 2.0f)) *
+				XMMatrixRotationY(lcg.NextFloat(0.0f, MathHelper::Pi)) *
+				XMMatrixTranslation(lcg.NextFloat(-50.0f, 50.0f), 0.0f, lcg.NextFloat(-50.0f, 50.0f)));
+			points[i] = XMFLOAT2(lcg.NextFloat(-1.0f, 1.0f), lcg.NextFloat(-1.0f, 1.0f));
+		}
+
+		std::vector<XMFLOAT4X4> results(count);
+
+		runner.Run("math/inverse_transpose", count, [&]()
+		{
+			for (UINT i = 0; i < count; ++i)
+				XMStoreFloat4x4(&results[i], MathHelper::InverseTranspose(XMLoadFloat4x4(&matrices[i])));
+			BenchmarkRunner::DoNotOptimize(results.data());
+		});
+
+		std::vector<XMFLOAT4> positions(count);
+		runner.Run("math/spherical_to_cartesian", count, [&]()
+		{
+			for (UINT i = 0; i < count; ++i)
+				XMStoreFloat4(&positions[i],
+					MathHelper::SphericalToCartesian(15.0f, points[i].x * MathHelper::Pi, points[i].y + 1.5f));
+			BenchmarkRunner::DoNotOptimize(positions.data());
+		});
+
+		std::vector<float> angles(count);
+		runner.Run("math/angle_from_xy", count, [&]()
+		{
+			for (UINT i = 0; i < count; ++i)
+				angles[i] = MathHelper::AngleFromXY(points[i].x, points[i].y);
+			BenchmarkRunner::DoNotOptimize(angles.data());
+		});
+
+		Camera camera;
+		camera.SetPosition(0.0f, 2.0f, -15.0f);
+		runner.Run("camera/update_view_matrix", 1, [&]()
+		{
+			// Rotating marks the view dirty, so every call rebuilds it.
+			camera.RotateY(0.001f);
+			camera.UpdateViewMatrix();
+			BenchmarkRunner::DoNotOptimize(&camera);
+		});
+	}
+
+	std::string Narrow(const std::wstring& text)
+	{
+		return std::string(text.begin(), text.end());
+	}
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+	BenchmarkRunner::Options options;
+	std::wstring outFilename = L"benchmarks.json";
+	std::wstring modelDirectory = L"../../StencilDemo/StencilDemo/Models/";
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::wstring arg = argv[i];
+		if (arg == L"-out")
+			outFilename = argv[i + 1];
+		else if (arg == L"-filter")
+			options.Filter = Narrow(argv[i + 1]);
+		else if (arg == L"-samples")
+			options.Samples = (UINT)_wtoi(argv[i + 1]);
+		else if (arg == L"-models")
+		{
+			modelDirectory = argv[i + 1];
+			if (!modelDirectory.empty() && modelDirectory.back() != L'/' && modelDirectory.back() != L'\\')
+				modelDirectory += L'/';
+		}
+	}
+
+#if defined(DEBUG) || defined(_DEBUG)
+	std::cout << "Warning: a Debug build; compare Release results only.\n";
+#endif
+
+	SetPriorityClass(GetCurrentProcess(), HIGH_PRIORITY_CLASS);
+	SetThreadAffinityMask(GetCurrentThread(), 1);
+
+	try
+	{
+		BenchmarkRunner runner(options);
+
+		// Created here so the main thread is its thread 0, as in D3DApp.
+		JobSystem jobs;
+
+		BenchmarkWaves(runner, jobs);
+
+		ComPtr<ID3D12Device> device = CreateDevice();
+		BenchmarkUploads(runner, device.Get());
+
+		BenchmarkGeometry(runner);
+		BenchmarkMeshLoading(runner, modelDirectory);
+		BenchmarkMath(runner);
+
+		if (!runner.WriteJson(outFilename))
+		{
+			std::wcout << L"Cannot write " << outFilename << L"\n";
+			return 1;
+		}
+		std::wcout << L"Results -> " << outFilename << L"\n";
+	}
+	catch (DxException& e)
+	{
+		std::wcout << e.ToString() << L"\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -2,6 +2,14 @@
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/GpuWaves.h"
+#include "../../Common/CpuProfiler.h"
+#include "../../Common/GpuProfiler.h"
+#include "../../Common/TextureConverter.h"
+#include "../../Common/BillboardSet.h"
+#include "../../Common/ClusteredLighting.h"
+#include "../../Common/ShaderPermutations.h"
+#include "../../Common/SceneTarget.h"
 #include "FrameResource.h"
 #include "Waves.h"
 
@@ -11,6 +19,18 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// Where GeometryGenerator's Write* functions put the attributes of our Vertex.
+GeometryGenerator::VertexLayout GetVertexLayout()
+{
+	GeometryGenerator::VertexLayout layout;
+	layout.Stride = sizeof(Vertex);
+	layout.PositionOffset = offsetof(Vertex, Pos);
+	layout.NormalOffset = offsetof(Vertex, Normal);
+	layout.TangentOffset = -1;
+	layout.TexCOffset = offsetof(Vertex, TexC);
+	return layout;
+}
+
 struct RenderItem
 {
 	RenderItem() = default;
@@ -28,6 +48,13 @@ struct RenderItem
 
 	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
+	// Default.hlsl variant for the material, picks the PSO within the layer's pass.
+	ShaderKey Variant = 0;
+
+	// Only used by the GPU waves render item.
+	XMFLOAT2 DisplacementMapTexelSize = { 1.0f, 1.0f };
+	float GridSpatialStep = 1.0f;
+
 	UINT IndexCount = 0;
 	UINT StartIndexLocation = 0;
 	int BaseVertexLocation = 0;
@@ -40,6 +67,7 @@ enum class RenderLayer :int
 	Opaque=0,
 	Transparent,
 	AlphaTested,
+	GpuWaves,
 	Count
 };
 
@@ -57,6 +85,9 @@ private:
 	virtual void OnResize()override;
 	virtual void Update(const GameTimer& gt)override;
 	virtual void Draw(const GameTimer& gt)override;
+	virtual void PrecompileShaders()override;
+	virtual std::wstring FrameStatsText()const override;
+	virtual std::vector<FrameTelemetry::ScopeTime> GpuScopeTimes()const override;
 
 	virtual void OnMouseDown(WPARAM btnState, int x, int y)override;
 	virtual void OnMouseUp(WPARAM btnState, int x, int y)override;
@@ -69,19 +100,28 @@ private:
 	void UpdateMaterialCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 	void UpdateWaves(const GameTimer& gt);
+	void CopyWavesVertices(ID3D12GraphicsCommandList* cmdList);
+	void UpdateWavesGPU(const GameTimer& gt, ID3D12GraphicsCommandList* cmdList);
+	UINT64 SubmitWavesCompute(const GameTimer& gt);
+	void SetScenePassState(ID3D12GraphicsCommandList* cmdList);
 
 	void LoadTextures();
 	void BuildRootSignature();
+	void BuildWavesRootSignature();
 	void BuildDescriptorHeaps();
 	void BuildShadersAndInputLayout();
 	void BuildLandGeometry();
 	void BuildWavesGeometry();
 	void BuildBoxGeometry();
+	void BuildTreeSprites();
+	void BuildLights();
 	void BuildPSOs();
 	void BuildFrameResources();
 	void BuildMaterials();
 	void BuildRenderItems();
-	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems,
+		PermutationPsos& psos);
+	void DrawTreeSprites(ID3D12GraphicsCommandList* cmdList);
 
 	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSamplers();
 
@@ -96,6 +136,7 @@ private:
 	UINT mCbvSrvDescriptorSize = 0;
 
 	ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
+	ComPtr<ID3D12RootSignature> mWavesRootSignature = nullptr;
 
 	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 
@@ -105,13 +146,69 @@ private:
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
 
+	// Default.hlsl is specialized per material instead of branching on defines at
+	// runtime; each pass keeps one PSO per variant.
+	std::unique_ptr<ShaderPermutations> mDefaultShaders;
+	std::unordered_map<std::string, std::unique_ptr<PermutationPsos>> mPassPsos;
+
+	std::vector<D3D12_INPUT_ELEMENT_DESC> mDepthInputLayout;
+
+	// Layers that first lay down their depth with a position-only pass, so their
+	// lit pass tests for EQUAL and shades every pixel once.  Only the opaque layer
+	// qualifies: the others blend, clip or displace their vertices.
+	bool mDepthPrepass[(int)RenderLayer::Count] = { true, false, false, false };
+
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 
+	// The forest is a single BillboardSet drawn with one call, not render items.
+	// A few MB of buffer for 100k trees; the default keeps the overdraw modest.
+	UINT mTreeCount = 20000;
+	std::unique_ptr<BillboardSet> mTreeSprites;
+
+	// Point and spot lights scattered over the land, shaded through light clusters.
+	// The three directional lights stay in the pass constants.
+	UINT mPointLightCount = 256;
+	UINT mSpotLightCount = 128;
+	std::vector<Light> mPointLights;
+	std::vector<Light> mSpotLights;
+	std::unique_ptr<ClusteredLighting> mClusteredLighting;
+
+	// The scene is drawn here and resolved / filtered into the back buffer (F2 MSAA,
+	// F4 FXAA).  The PSOs are rebuilt when the sample count they were made for changes.
+	std::unique_ptr<SceneTarget> mSceneTarget;
+	DXGI_SAMPLE_DESC mPsoSampleDesc = { 1, 0 };
+
 	RenderItem* mWavesRitem = nullptr;
 
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 
+	// Run the wave simulation in a compute shader and displace a static grid in
+	// the vertex shader.  Set false to fall back to the CPU Waves class, which
+	// only re-uploads the tiles of the grid that moved.
+	bool mUseGpuWaves = true;
+
 	std::unique_ptr<Waves> mWaves;
+	std::unique_ptr<GpuWaves> mGpuWaves;
+
+	// This frame's copies from the upload heap into the CPU waves' vertex buffer:
+	// RowCount whole rows of the grid, or ColCount points of a single row.
+	struct WavesCopy
+	{
+		int FirstRow;
+		int RowCount;
+		int FirstCol;
+		int ColCount;
+		UINT64 SrcOffset;
+	};
+	std::vector<WavesCopy> mWavesCopies;
+	// The upload page all of this frame's copies read from.
+	ID3D12Resource* mWavesCopySource = nullptr;
+
+	// With "-asynccompute" the GPU waves step on mComputeQueue, recorded in
+	// mComputeCmdList and timed by mComputeProfiler; mGpuProfiler times the direct queue.
+	ComPtr<ID3D12GraphicsCommandList> mComputeCmdList;
+	std::unique_ptr<GpuProfiler> mGpuProfiler;
+	std::unique_ptr<GpuProfiler> mComputeProfiler;
 
 	// just like render queue unityȾУ(Tags { "Queue"="Transparent" }
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
@@ -154,7 +251,11 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 BlendApp::BlendApp(HINSTANCE hInstance)
 	:D3DApp(hInstance)
 {
+	// Draw() goes through mSceneTarget, so MSAA and FXAA can be switched on.
+	mAntiAliasingSupported = true;
 
+	// The GPU waves can step on the compute queue, see SubmitWavesCompute().
+	mAsyncComputeSupported = true;
 }
 
 BlendApp::~BlendApp()
@@ -168,30 +269,57 @@ bool BlendApp::Initialize()
 	if (!D3DApp::Initialize())
 		return false;
 
+	// Hitches wait this many frames for their GPU times.
+	mTelemetry.SetGpuLatency(gNumFrameResources);
+
 	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(),nullptr));
 
 	mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
-	mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+	mSceneTarget = std::make_unique<SceneTarget>(md3dDevice.Get(), mBackBufferFormat, mMainPassCB.FogColor);
+	mSceneTarget->Resize(mClientWidth, mClientHeight, MsaaSampleDesc(), mFxaaState);
+
+	if (mUseGpuWaves)
+		mGpuWaves = std::make_unique<GpuWaves>(md3dDevice.Get(), mCommandList.Get(),
+			128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+	else
+		mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
 
 	LoadTextures();
 	BuildRootSignature();
+	BuildWavesRootSignature();
 	BuildDescriptorHeaps();
 	BuildShadersAndInputLayout();
 	BuildLandGeometry();
 	BuildWavesGeometry();
 	BuildBoxGeometry();
+	BuildTreeSprites();
+	BuildLights();
 	BuildMaterials();
 	BuildRenderItems();
 	BuildFrameResources();
 	BuildPSOs();
 
+	mGpuProfiler = std::make_unique<GpuProfiler>(md3dDevice.Get(), mCommandQueue.Get(), gNumFrameResources);
+	if (mUseGpuWaves && mAsyncCompute)
+	{
+		ThrowIfFailed(md3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COMPUTE,
+			mFrameResources[0]->ComputeCmdListAlloc.Get(), nullptr, IID_PPV_ARGS(mComputeCmdList.GetAddressOf())));
+		ThrowIfFailed(mComputeCmdList->Close());
+
+		mComputeProfiler = std::make_unique<GpuProfiler>(md3dDevice.Get(), mComputeQueue.Get(), gNumFrameResources);
+	}
+
 	ThrowIfFailed(mCommandList->Close());
 	ID3D12CommandList* cmdsList[] = { mCommandList.Get() };
 	mCommandQueue->ExecuteCommandLists(_countof(cmdsList), cmdsList);
 
 	FlushCommandQueue();
 
+	if (mGpuWaves != nullptr)
+		mGpuWaves->DisposeUploaders();
+	mTreeSprites->DisposeUploader();
+
 	return true;
 }
 
@@ -202,6 +330,20 @@ void BlendApp::OnResize()
 	// The window resized, so update the aspect ratio and recompute the projection matrix.
 	XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f * MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
 	XMStoreFloat4x4(&mProj, P);
+
+	// The first OnResize() comes from D3DApp::Initialize(), before the clusters exist.
+	if (mClusteredLighting != nullptr)
+		mClusteredLighting->OnResize(mClientWidth, mClientHeight);
+
+	// Also called by Set4xMsaaState() and SetFxaaState(), after the GPU is flushed.
+	if (mSceneTarget != nullptr)
+	{
+		DXGI_SAMPLE_DESC sampleDesc = MsaaSampleDesc();
+		mSceneTarget->Resize(mClientWidth, mClientHeight, sampleDesc, mFxaaState);
+
+		if (sampleDesc.Count != mPsoSampleDesc.Count || sampleDesc.Quality != mPsoSampleDesc.Quality)
+			BuildPSOs();
+	}
 }
 
 
@@ -213,19 +355,17 @@ void BlendApp::Update(const GameTimer& gt)
 	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
 	mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
 
-	if (mCurrFrameResource->Fence != 0 && mFence->GetCompletedValue() < mCurrFrameResource->Fence)
-	{
-		HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-		ThrowIfFailed(mFence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle));
-		WaitForSingleObject(eventHandle, INFINITE);
-		CloseHandle(eventHandle);
-	}
+	WaitForFence(mCurrFrameResource->Fence);
+
+	// The GPU is done with this frame resource, so its transient upload data can be reused.
+	mCurrFrameResource->Upload->Reset();
 
 	AnimateMaterials(gt);
 	UpdateObjectCBs(gt);
 	UpdateMaterialCBs(gt);
 	UpdateMainPassCB(gt);
-	UpdateWaves(gt);
+	if (!mUseGpuWaves)
+		UpdateWaves(gt);
 }
 
 void BlendApp::Draw(const GameTimer& gt)
@@ -234,55 +374,162 @@ void BlendApp::Draw(const GameTimer& gt)
 
 	ThrowIfFailed(cmdListAlloc->Reset());
 
+	// With async compute the waves step while the GPU draws the rest of this frame
+	// and the previous one; only the water waits for it.
+	UINT64 wavesFence = 0;
+	if (mComputeCmdList != nullptr)
+		wavesFence = SubmitWavesCompute(gt);
+
 	//ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["transparent"].Get()));
 
-	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
+	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), nullptr));
 
-	mCommandList->RSSetViewports(1, &mScreenViewport);
-	mCommandList->RSSetScissorRects(1, &mScissorRect);
+	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
+	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+	// The frame's fence has completed, so its timestamps can be read back.
+	mGpuProfiler->BeginFrame(mCurrFrameResourceIndex);
 
-	mCommandList->ClearRenderTargetView(CurrentBackBufferView(), (float*)&mMainPassCB.FogColor, 0, nullptr);
-	mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+	// Step the GPU simulation before any graphics work reads the displacement map.
+	if (mUseGpuWaves && mComputeCmdList == nullptr)
+	{
+		UINT wavesScope = mGpuProfiler->AddScope("waves");
+		mGpuProfiler->BeginScope(mCommandList.Get(), wavesScope);
+		UpdateWavesGPU(gt, mCommandList.Get());
+		mGpuProfiler->EndScope(mCommandList.Get(), wavesScope);
+	}
 
-	mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
+	if (!mUseGpuWaves)
+		CopyWavesVertices(mCommandList.Get());
 
-	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
-	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+	UINT sceneScope = mGpuProfiler->AddScope("scene");
+	mGpuProfiler->BeginScope(mCommandList.Get(), sceneScope);
+
+	// Bin the point and spot lights for this frame's view before any pixel shader
+	// reads the cluster lists.
+	mClusteredLighting->Build(mCommandList.Get(), *mCurrFrameResource->Upload,
+		mView, mProj, 1.0f, 1000.0f, mPointLights, mSpotLights);
 
-	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
+	mSceneTarget->BeginScene(mCommandList.Get(), CurrentBackBuffer());
 
-	auto passCB = mCurrFrameResource->PassCB->Resource();
-	mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
+	D3D12_CPU_DESCRIPTOR_HANDLE sceneView = mSceneTarget->RenderTargetView(CurrentBackBufferView());
+	mCommandList->ClearRenderTargetView(sceneView, (float*)&mMainPassCB.FogColor, 0, nullptr);
+	mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
 
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
+	SetScenePassState(mCommandList.Get());
 
-	mCommandList->SetPipelineState(mPSOs["alphaTested"].Get());
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::AlphaTested]);
+	if (mDepthPrepass[(int)RenderLayer::Opaque])
+	{
+		DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque], *mPassPsos["opaqueDepthPrepass"]);
+		DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque], *mPassPsos["opaqueDepthEqual"]);
+	}
+	else
+	{
+		DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque], *mPassPsos["opaque"]);
+	}
+
+	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::AlphaTested], *mPassPsos["alphaTested"]);
+
+	mCommandList->SetPipelineState(mPSOs["treeSprites"].Get());
+	DrawTreeSprites(mCommandList.Get());
 
 	/*mCommandList->SetPipelineState(mPSOs["opaque"].Get());
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);*/
-	mCommandList->SetPipelineState(mPSOs["transparent"].Get());
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Transparent]);
+	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Transparent], *mPassPsos["transparent"]);
+
+	mGpuProfiler->EndScope(mCommandList.Get(), sceneScope);
+
+	if (mComputeCmdList != nullptr)
+	{
+		// Submit what does not read the waves, then have the direct queue wait for
+		// the step before the water.  The list can be reset as soon as it is submitted.
+		ThrowIfFailed(mCommandList->Close());
+		ID3D12CommandList* sceneLists[] = { mCommandList.Get() };
+		mCommandQueue->ExecuteCommandLists(_countof(sceneLists), sceneLists);
+
+		GraphicsWaitForCompute(wavesFence);
+
+		ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), nullptr));
+		mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+		SetScenePassState(mCommandList.Get());
+	}
+
+	UINT waterScope = mGpuProfiler->AddScope("water");
+	mGpuProfiler->BeginScope(mCommandList.Get(), waterScope);
 
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+	if (mUseGpuWaves)
+	{
+		mCommandList->SetGraphicsRootDescriptorTable(4, mGpuWaves->DisplacementMap());
+		DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::GpuWaves], *mPassPsos["transparent"]);
+	}
+
+	// Resolve and / or FXAA into the back buffer, which ends up in PRESENT.
+	mSceneTarget->EndScene(mCommandList.Get(), CurrentBackBuffer());
+
+	mGpuProfiler->EndScope(mCommandList.Get(), waterScope);
+	mGpuProfiler->EndFrame(mCommandList.Get());
 
 	ThrowIfFailed(mCommandList->Close());
 
 	ID3D12CommandList* cmdsList[] = { mCommandList.Get() };
 	mCommandQueue->ExecuteCommandLists(_countof(cmdsList), cmdsList);
 
-	ThrowIfFailed(mSwapChain->Present(0, 0));
-	mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
+	Present();
 
 	mCurrFrameResource->Fence = ++mCurrentFence;
 
 	mCommandQueue->Signal(mFence.Get(), mCurrentFence);
 }
 
+void BlendApp::SetScenePassState(ID3D12GraphicsCommandList* cmdList)
+{
+	cmdList->RSSetViewports(1, &mScreenViewport);
+	cmdList->RSSetScissorRects(1, &mScissorRect);
+
+	D3D12_CPU_DESCRIPTOR_HANDLE sceneView = mSceneTarget->RenderTargetView(CurrentBackBufferView());
+	cmdList->OMSetRenderTargets(1, &sceneView, true, &DepthStencilView());
+
+	cmdList->SetGraphicsRootSignature(mRootSignature.Get());
+
+	cmdList->SetGraphicsRootConstantBufferView(2, mCurrFrameResource->PassCB.GpuAddress());
+	mClusteredLighting->Bind(cmdList, 7, 8, 9);
+}
+
+std::wstring BlendApp::FrameStatsText()const
+{
+	std::wstring text = L"   gpu " + mGpuProfiler->Summary();
+
+	// Compute work that ran while the direct queue was busy came for free.
+	if (mComputeProfiler != nullptr)
+	{
+		float overlapped =
+			GpuProfiler::Overlap(*mComputeProfiler, "waves", *mGpuProfiler, "scene") +
+			GpuProfiler::Overlap(*mComputeProfiler, "waves", *mGpuProfiler, "water");
+
+		wchar_t buffer[96];
+		swprintf_s(buffer, L"   async waves: %.3f ms, %.3f ms overlapped",
+			mComputeProfiler->GpuTime("waves"), overlapped);
+		text += buffer;
+	}
+	return text;
+}
+
+std::vector<FrameTelemetry::ScopeTime> BlendApp::GpuScopeTimes()const
+{
+	std::vector<FrameTelemetry::ScopeTime> times;
+	for (const auto& scope : mGpuProfiler->GpuTimes())
+		times.push_back(FrameTelemetry::ScopeTime(scope.first, mGpuProfiler->LatestGpuTime(scope.first), scope.second));
+
+	// The compute queue's frames are read back as late as the direct queue's.
+	if (mComputeProfiler != nullptr)
+	{
+		for (const auto& scope : mComputeProfiler->GpuTimes())
+			times.push_back(FrameTelemetry::ScopeTime("compute " + scope.first,
+				mComputeProfiler->LatestGpuTime(scope.first), scope.second));
+	}
+	return times;
+}
+
 void BlendApp::OnMouseDown(WPARAM btnState, int x, int y)
 {
 	mLastMousePos.x = x;
@@ -324,6 +571,7 @@ void BlendApp::OnMouseMove(WPARAM btnState, int x, int y)
 
 void BlendApp::OnKeyboardInput(const GameTimer& gt)
 {
+	CPU_PROFILE_SCOPE("OnKeyboardInput");
 
 }
 
@@ -364,7 +612,8 @@ void BlendApp::AnimateMaterials(const GameTimer& gt)
 
 void BlendApp::UpdateObjectCBs(const GameTimer& gt)
 {
-	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
+	CPU_PROFILE_SCOPE("UpdateObjectCBs");
+	auto currObjectCB = &mCurrFrameResource->ObjectCB;
 	for (auto& e : mAllRitems)
 	{
 		if (e->NumFramesDirty > 0)
@@ -375,6 +624,8 @@ void BlendApp::UpdateObjectCBs(const GameTimer& gt)
 			ObjectConstants objConstants;
 			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
 			XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
+			objConstants.DisplacementMapTexelSize = e->DisplacementMapTexelSize;
+			objConstants.GridSpatialStep = e->GridSpatialStep;
 
 			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
 
@@ -385,7 +636,8 @@ void BlendApp::UpdateObjectCBs(const GameTimer& gt)
 
 void BlendApp::UpdateMaterialCBs(const GameTimer& gt)
 {
-	auto currMaterialCB = mCurrFrameResource->MaterialCB.get();
+	CPU_PROFILE_SCOPE("UpdateMaterialCBs");
+	auto currMaterialCB = &mCurrFrameResource->MaterialCB;
 	for (auto& e : mMaterials)
 	{
 		Material* mat = e.second.get();
@@ -408,6 +660,7 @@ void BlendApp::UpdateMaterialCBs(const GameTimer& gt)
 
 void BlendApp::UpdateMainPassCB(const GameTimer& gt)
 {
+	CPU_PROFILE_SCOPE("UpdateMainPassCB");
 	XMMATRIX view = XMLoadFloat4x4(&mView);
 	XMMATRIX proj = XMLoadFloat4x4(&mProj);
 
@@ -437,12 +690,13 @@ void BlendApp::UpdateMainPassCB(const GameTimer& gt)
 	mMainPassCB.Lights[2].Direction = { 0.0f, -0.707f, -0.707f };
 	mMainPassCB.Lights[2].Strength = { 0.15f, 0.15f, 0.15f };
 
-	auto currPassCB = mCurrFrameResource->PassCB.get();
+	auto currPassCB = &mCurrFrameResource->PassCB;
 	currPassCB->CopyData(0, mMainPassCB);
 }
 
 void BlendApp::UpdateWaves(const GameTimer& gt)
 {
+	CPU_PROFILE_SCOPE("UpdateWaves");
 	static float t_base = 0.0f;
 	if ((mTimer.TotalTime() - t_base) >= 0.25f)
 	{
@@ -456,23 +710,149 @@ void BlendApp::UpdateWaves(const GameTimer& gt)
 		mWaves->Disturb(i, j, r);
 	}
 
-	mWaves->Update(gt.DeltaTime());
+	mWaves->Update(gt.DeltaTime(), *mJobs);
+
+	// Only the tiles that changed since the last frame go through this frame's
+	// upload heap.  A row of tiles that changed all the way across is copied as
+	// whole grid rows, joined with the rows before it if those were too; otherwise
+	// each grid row is copied from its first to its last changed tile.
+	const int n = mWaves->ColumnCount();
+	UINT vertexCount = 0;
+	mWavesCopies.clear();
+
+	for (int r = 0; r < mWaves->TileRowCount(); ++r)
+	{
+		int firstTile = -1;
+		int lastTile = -1;
+		for (int c = 0; c < mWaves->TileColumnCount(); ++c)
+		{
+			if (mWaves->TileChanged(r, c))
+			{
+				if (firstTile < 0)
+					firstTile = c;
+				lastTile = c;
+			}
+		}
+
+		if (firstTile < 0)
+			continue;
+
+		int firstRow, lastRow, firstCol, lastCol, unused;
+		mWaves->TileRows(r, firstRow, lastRow);
+		mWaves->TileColumns(firstTile, firstCol, unused);
+		mWaves->TileColumns(lastTile, unused, lastCol);
+
+		if (firstTile == 0 && lastTile == mWaves->TileColumnCount() - 1)
+		{
+			WavesCopy* prev = mWavesCopies.empty() ? nullptr : &mWavesCopies.back();
+			if (prev != nullptr && prev->ColCount == n && prev->FirstRow + prev->RowCount == firstRow)
+				prev->RowCount += lastRow - firstRow;
+			else
+				mWavesCopies.push_back({ firstRow, lastRow - firstRow, 0, n, 0 });
+
+			vertexCount += (lastRow - firstRow) * n;
+		}
+		else
+		{
+			for (int i = firstRow; i < lastRow; ++i)
+				mWavesCopies.push_back({ i, 1, firstCol, lastCol - firstCol, 0 });
+
+			vertexCount += (lastRow - firstRow) * (lastCol - firstCol);
+		}
+	}
+
+	mWaves->ClearChangedTiles();
 
-	auto currWavesVB = mCurrFrameResource->WavesVB.get();
-	for (int i = 0; i < mWaves->VertexCount(); ++i)
+	if (mWavesCopies.empty())
+		return;
+
+	UploadSlice<Vertex> upload(*mCurrFrameResource->Upload, vertexCount, false);
+	mWavesCopySource = upload.Resource();
+	Vertex* dest = upload.MappedData();
+	for (WavesCopy& copy : mWavesCopies)
 	{
-		Vertex v;
+		copy.SrcOffset = upload.Offset() + (UINT64)(dest - upload.MappedData()) * sizeof(Vertex);
+		for (int i = 0; i < copy.RowCount; ++i, dest += copy.ColCount)
+			mWaves->WriteVertices(dest, copy.FirstRow + i, copy.FirstCol, copy.ColCount);
+	}
+}
 
-		v.Pos = mWaves->Position(i);
-		v.Normal = mWaves->Normal(i);
+void BlendApp::CopyWavesVertices(ID3D12GraphicsCommandList* cmdList)
+{
+	if (mWavesCopies.empty())
+		return;
 
-		v.TexC.x = 0.5f + v.Pos.x / mWaves->Width();
-		v.TexC.y = 0.5f - v.Pos.z / mWaves->Depth();
+	ID3D12Resource* vertexBuffer = mWavesRitem->Geo->VertexBufferGPU.Get();
+	const UINT64 rowBytes = (UINT64)mWaves->ColumnCount() * sizeof(Vertex);
 
-		currWavesVB->CopyData(i, v);
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(vertexBuffer,
+		D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST));
+
+	for (const WavesCopy& copy : mWavesCopies)
+	{
+		cmdList->CopyBufferRegion(vertexBuffer, copy.FirstRow * rowBytes + copy.FirstCol * sizeof(Vertex),
+			mWavesCopySource, copy.SrcOffset,
+			(UINT64)copy.RowCount * copy.ColCount * sizeof(Vertex));
 	}
 
-	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(vertexBuffer,
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
+}
+
+void BlendApp::UpdateWavesGPU(const GameTimer& gt, ID3D12GraphicsCommandList* cmdList)
+{
+	CPU_PROFILE_SCOPE("UpdateWavesGPU");
+
+	// Update the wave simulation.
+	if (!mGpuWaves->Update(gt.DeltaTime(), cmdList, mWavesRootSignature.Get(), mPSOs["wavesUpdate"].Get()))
+		return;
+
+	// Every quarter second, generate a random wave.  Only right after a step: the
+	// solution it changes is then one no frame has drawn yet.
+	static float t_base = 0.0f;
+	if ((mTimer.TotalTime() - t_base) >= 0.25f)
+	{
+		t_base += 0.25f;
+
+		int i = MathHelper::Rand(4, mGpuWaves->RowCount() - 5);
+		int j = MathHelper::Rand(4, mGpuWaves->ColumnCount() - 5);
+
+		float r = MathHelper::RandF(0.2f, 0.5f);
+
+		mGpuWaves->Disturb(cmdList, mWavesRootSignature.Get(), mPSOs["wavesDisturb"].Get(), i, j, r);
+	}
+}
+
+UINT64 BlendApp::SubmitWavesCompute(const GameTimer& gt)
+{
+	auto cmdListAlloc = mCurrFrameResource->ComputeCmdListAlloc;
+	ThrowIfFailed(cmdListAlloc->Reset());
+	ThrowIfFailed(mComputeCmdList->Reset(cmdListAlloc.Get(), nullptr));
+
+	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
+	mComputeCmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+
+	// The direct queue waited for this frame resource's last step before its fence.
+	mComputeProfiler->BeginFrame(mCurrFrameResourceIndex);
+	UINT wavesScope = mComputeProfiler->AddScope("waves");
+	mComputeProfiler->BeginScope(mComputeCmdList.Get(), wavesScope);
+	UpdateWavesGPU(gt, mComputeCmdList.Get());
+	mComputeProfiler->EndScope(mComputeCmdList.Get(), wavesScope);
+	mComputeProfiler->EndFrame(mComputeCmdList.Get());
+
+	ThrowIfFailed(mComputeCmdList->Close());
+
+	// The step overwrites the solution drawn two steps ago, and every frame takes at
+	// most one step, so only frames two or more back must be done; the previous
+	// frame can still be drawing while the step runs.
+	const FrameResource* twoFramesBack =
+		mFrameResources[(mCurrFrameResourceIndex + gNumFrameResources - 2) % gNumFrameResources].get();
+	ComputeWaitForGraphics(twoFramesBack->Fence);
+
+	ID3D12CommandList* cmdsList[] = { mComputeCmdList.Get() };
+	mComputeQueue->ExecuteCommandLists(_countof(cmdsList), cmdsList);
+
+	return SignalCompute();
 }
 
 void BlendApp::LoadTextures()
@@ -483,6 +863,7 @@ void BlendApp::LoadTextures()
 	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
 		mCommandList.Get(), grassTex->Filename.c_str(),
 		grassTex->Resource, grassTex->UploadHeap));
+	TextureConverter::Validate(*grassTex);
 
 	auto waterTex = std::make_unique<Texture>();
 	waterTex->Name = "waterTex";
@@ -490,6 +871,7 @@ void BlendApp::LoadTextures()
 	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
 		mCommandList.Get(), waterTex->Filename.c_str(),
 		waterTex->Resource, waterTex->UploadHeap));
+	TextureConverter::Validate(*waterTex);
 
 	auto fenceTex = std::make_unique<Texture>();
 	fenceTex->Name = "fenceTex";
@@ -497,27 +879,57 @@ void BlendApp::LoadTextures()
 	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
 		mCommandList.Get(), fenceTex->Filename.c_str(),
 		fenceTex->Resource, fenceTex->UploadHeap));
+	TextureConverter::Validate(*fenceTex);
+
+	// The three tree images become the slices of one array, with mips, converted
+	// once into the texture cache.  BC3 keeps the cutout alpha sharper than BC7.
+	TextureConvertDesc treeDesc;
+	treeDesc.Compression = TextureCompression::BC3;
+
+	auto treeArrayTex = std::make_unique<Texture>();
+	treeArrayTex->Name = "treeArrayTex";
+	treeArrayTex->Filename = TextureConverter::ConvertCached(
+		{ L"../../Textures/tree0.bmp", L"../../Textures/tree1.bmp", L"../../Textures/tree2.bmp" },
+		L"treearray", treeDesc);
+	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
+		mCommandList.Get(), treeArrayTex->Filename.c_str(),
+		treeArrayTex->Resource, treeArrayTex->UploadHeap));
+	TextureConverter::Validate(*treeArrayTex);
 
 	mTextures[grassTex->Name] = std::move(grassTex);
 	mTextures[waterTex->Name] = std::move(waterTex);
 	mTextures[fenceTex->Name] = std::move(fenceTex);
+	mTextures[treeArrayTex->Name] = std::move(treeArrayTex);
 }
 
 void BlendApp::BuildRootSignature()
 {
 	CD3DX12_DESCRIPTOR_RANGE texTable;
 	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+
+	CD3DX12_DESCRIPTOR_RANGE displacementMapTable;
+	displacementMapTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1);
 	
-	CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+	CD3DX12_ROOT_PARAMETER slotRootParameter[10];
 
 	slotRootParameter[0].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
 	slotRootParameter[1].InitAsConstantBufferView(0);
 	slotRootParameter[2].InitAsConstantBufferView(1);
 	slotRootParameter[3].InitAsConstantBufferView(2);
+	slotRootParameter[4].InitAsDescriptorTable(1, &displacementMapTable, D3D12_SHADER_VISIBILITY_VERTEX);
+
+	// Tree billboards and their fade distances, see BillboardSet::Draw().
+	slotRootParameter[5].InitAsShaderResourceView(2, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	slotRootParameter[6].InitAsConstants(2, 3);
+
+	// Clustered point and spot lights, see ClusteredLighting::Bind().
+	slotRootParameter[7].InitAsConstantBufferView(4, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[8].InitAsShaderResourceView(3, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[9].InitAsShaderResourceView(4, 0, D3D12_SHADER_VISIBILITY_PIXEL);
 
 	auto staticSamplers = GetStaticSamplers();
 
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(10, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -540,11 +952,20 @@ void BlendApp::BuildRootSignature()
 	));
 }
 
+void BlendApp::BuildWavesRootSignature()
+{
+	if (mUseGpuWaves)
+		mGpuWaves->BuildRootSignature(md3dDevice.Get(), mWavesRootSignature);
+}
+
 void BlendApp::BuildDescriptorHeaps()
 {
+	const UINT textureDescriptorCount = 4;
+	const UINT wavesDescriptorCount = mUseGpuWaves ? mGpuWaves->DescriptorCount() : 0;
+
 	// create srv heap
 	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 3;
+	srvHeapDesc.NumDescriptors = textureDescriptorCount + wavesDescriptorCount;
 	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
@@ -573,26 +994,60 @@ void BlendApp::BuildDescriptorHeaps()
 
 	srvDesc.Format = fenceTex->GetDesc().Format;
 	md3dDevice->CreateShaderResourceView(fenceTex.Get(), &srvDesc, hDescriptor);
+
+	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
+
+	auto treeArrayTex = mTextures["treeArrayTex"]->Resource;
+	auto treeArrayDesc = treeArrayTex->GetDesc();
+	srvDesc.Format = treeArrayDesc.Format;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MostDetailedMip = 0;
+	srvDesc.Texture2DArray.MipLevels = -1;
+	srvDesc.Texture2DArray.FirstArraySlice = 0;
+	srvDesc.Texture2DArray.ArraySize = treeArrayDesc.DepthOrArraySize;
+	md3dDevice->CreateShaderResourceView(treeArrayTex.Get(), &srvDesc, hDescriptor);
+
+	// The wave simulation textures follow the diffuse textures.
+	if (mUseGpuWaves)
+	{
+		mGpuWaves->BuildDescriptors(
+			CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), textureDescriptorCount, mCbvSrvDescriptorSize),
+			CD3DX12_GPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), textureDescriptorCount, mCbvSrvDescriptorSize),
+			mCbvSrvDescriptorSize);
+	}
+}
+
+void BlendApp::PrecompileShaders()
+{
+	BuildShadersAndInputLayout();
 }
 
 void BlendApp::BuildShadersAndInputLayout()
 {
-	const D3D_SHADER_MACRO defines[] =
+	mDefaultShaders = std::make_unique<ShaderPermutations>(L"Default.hlsl", std::vector<ShaderOption>
 	{
-		"FOG","1",
-		NULL,NULL
-	};
-
-	const D3D_SHADER_MACRO alphaTestDefines[] =
+		{ "NUM_DIR_LIGHTS", 2 },
+		{ "FOG" },
+		{ "ALPHA_TEST" },
+		{ "DISPLACEMENT_MAP" },
+	});
+	mDefaultShaders->AddEntryPoint("VS", "vs_5_0", { "DISPLACEMENT_MAP" });
+	mDefaultShaders->AddEntryPoint("PS", "ps_5_0", { "NUM_DIR_LIGHTS", "FOG", "ALPHA_TEST" });
+	mDefaultShaders->AddEntryPoint("DepthVS", "vs_5_0");
+
+	// Every fog/alpha test/displacement variant of the three light scene: 4 pixel
+	// shaders, 2 vertex shaders and the depth pre-pass one, compiled in parallel.
+	ShaderKey lit = mDefaultShaders->With(0, "NUM_DIR_LIGHTS", 3);
+	mDefaultShaders->Compile(mDefaultShaders->Expand(lit, { "FOG", "ALPHA_TEST", "DISPLACEMENT_MAP" }));
+
+	if (mUseGpuWaves)
 	{
-		"FOG","1",
-		"ALPHA_TEST","1",
-		NULL,NULL
-	};
+		mShaders["wavesUpdateCS"] = d3dUtil::CompileShader(L"../../Shader/WaveSim.hlsl", nullptr, "UpdateWavesCS", "cs_5_0");
+		mShaders["wavesDisturbCS"] = d3dUtil::CompileShader(L"../../Shader/WaveSim.hlsl", nullptr, "DisturbWavesCS", "cs_5_0");
+	}
 
-	mShaders["standardVS"] = d3dUtil::CompileShader(L"Default.hlsl", nullptr, "VS", "vs_5_0");
-	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Default.hlsl", defines, "PS", "ps_5_0");
-	mShaders["alphaTestedPS"] = d3dUtil::CompileShader(L"Default.hlsl", alphaTestDefines, "PS", "ps_5_0");
+	mShaders["treeSpriteVS"] = d3dUtil::CompileShader(L"TreeSprite.hlsl", nullptr, "VS", "vs_5_0");
+	mShaders["treeSpritePS"] = d3dUtil::CompileShader(L"TreeSprite.hlsl", nullptr, "PS", "ps_5_0");
 
 	mInputLayout =
 	{
@@ -600,42 +1055,50 @@ void BlendApp::BuildShadersAndInputLayout()
 		{"NORMAL",0,DXGI_FORMAT_R32G32B32_FLOAT,0,12,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0},
 		{"TEXCOORD",0,DXGI_FORMAT_R32G32_FLOAT,0,24,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0}
 	};
+
+	// Reads the same vertex buffers; the stride comes from the buffer view.
+	mDepthInputLayout =
+	{
+		{"POSITION",0,DXGI_FORMAT_R32G32B32_FLOAT,0,0,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0}
+	};
 }
 
 void BlendApp::BuildLandGeometry()
 {
+	// The grid is generated straight into the CPU copies in this demo's Vertex
+	// format, with 16-bit indices; nothing is converted afterwards.
 	GeometryGenerator geoGen;
-	GeometryGenerator::MeshData grid = geoGen.CreateGrid(160.0f, 160.0f, 50, 50);
+	GeometryGenerator::MeshSize size = GeometryGenerator::GridSize(50, 50);
 
-	std::vector<Vertex> vertices(grid.Vertices.size());
-	for (size_t i = 0; i < grid.Vertices.size(); ++i)
-	{
-		auto& p = grid.Vertices[i].Position;
-		vertices[i].Pos = p;
-		vertices[i].Pos.y = GetHillsHeight(p.x, p.z);
-		vertices[i].Normal = GetHillsNormal(p.x, p.z);
-		vertices[i].TexC = grid.Vertices[i].TexC;
-	}
-
-	const UINT vbByteSize = sizeof(Vertex) * vertices.size();
-
-	std::vector<std::uint16_t> indices = grid.GetIndices16();
-	const UINT ibByteSize = indices.size() * sizeof(std::uint16_t);
+	const UINT vbByteSize = size.VertexCount * sizeof(Vertex);
+	const UINT ibByteSize = size.IndexCount * sizeof(std::uint16_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "landGeo";
 
 	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+
+	GeometryGenerator::MeshSpans out;
+	out.Vertices = geo->VertexBufferCPU->GetBufferPointer();
+	out.Layout = GetVertexLayout();
+	out.Indices = geo->IndexBufferCPU->GetBufferPointer();
+	out.IndexStride = sizeof(std::uint16_t);
+	geoGen.WriteGrid(160.0f, 160.0f, 50, 50, out);
+
+	Vertex* vertices = reinterpret_cast<Vertex*>(geo->VertexBufferCPU->GetBufferPointer());
+	for (UINT i = 0; i < size.VertexCount; ++i)
+	{
+		auto& p = vertices[i].Pos;
+		p.y = GetHillsHeight(p.x, p.z);
+		vertices[i].Normal = GetHillsNormal(p.x, p.z);
+	}
 
 	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+		mCommandList.Get(), vertices, vbByteSize, geo->VertexBufferUploader);
 
 	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+		mCommandList.Get(), geo->IndexBufferCPU->GetBufferPointer(), ibByteSize, geo->IndexBufferUploader);
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
@@ -643,7 +1106,7 @@ void BlendApp::BuildLandGeometry()
 	geo->IndexBufferByteSize = ibByteSize;
 
 	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
+	submesh.IndexCount = size.IndexCount;
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
 
@@ -654,6 +1117,55 @@ void BlendApp::BuildLandGeometry()
 
 void BlendApp::BuildWavesGeometry()
 {
+	if (mUseGpuWaves)
+	{
+		// The heights come from the displacement map, so the grid itself never changes
+		// and can live in a default buffer like any other static mesh.
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshSize size = GeometryGenerator::GridSize(
+			mGpuWaves->RowCount(), mGpuWaves->ColumnCount());
+
+		UINT vbByteSize = size.VertexCount * sizeof(Vertex);
+		UINT ibByteSize = size.IndexCount * sizeof(std::uint32_t);
+
+		auto geo = std::make_unique<MeshGeometry>();
+		geo->Name = "waterGeo";
+
+		ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+		ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+
+		GeometryGenerator::MeshSpans out;
+		out.Vertices = geo->VertexBufferCPU->GetBufferPointer();
+		out.Layout = GetVertexLayout();
+		out.Indices = geo->IndexBufferCPU->GetBufferPointer();
+		out.IndexStride = sizeof(std::uint32_t);
+		geoGen.WriteGrid(
+			(mGpuWaves->ColumnCount() - 1) * mGpuWaves->SpatialStep(),
+			(mGpuWaves->RowCount() - 1) * mGpuWaves->SpatialStep(),
+			mGpuWaves->RowCount(), mGpuWaves->ColumnCount(), out);
+
+		geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+			mCommandList.Get(), geo->VertexBufferCPU->GetBufferPointer(), vbByteSize, geo->VertexBufferUploader);
+
+		geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+			mCommandList.Get(), geo->IndexBufferCPU->GetBufferPointer(), ibByteSize, geo->IndexBufferUploader);
+
+		geo->VertexByteStride = sizeof(Vertex);
+		geo->VertexBufferByteSize = vbByteSize;
+		geo->IndexFormat = DXGI_FORMAT_R32_UINT;
+		geo->IndexBufferByteSize = ibByteSize;
+
+		SubmeshGeometry submesh;
+		submesh.IndexCount = (UINT)indices.size();
+		submesh.StartIndexLocation = 0;
+		submesh.BaseVertexLocation = 0;
+
+		geo->DrawArgs["grid"] = submesh;
+
+		mGeometries["waterGeo"] = std::move(geo);
+		return;
+	}
+
 	std::vector<std::uint16_t> indices(3 * mWaves->TriangleCount());
 	assert(mWaves->VertexCount() < 0x0000ffff);
 
@@ -682,8 +1194,14 @@ void BlendApp::BuildWavesGeometry()
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "waterGeo";
 
+	// The vertices live in a default heap; UpdateWaves() only uploads the parts of
+	// the grid that move.
+	std::vector<Vertex> vertices(mWaves->VertexCount());
+	mWaves->WriteVertices(vertices.data());
+
 	geo->VertexBufferCPU = nullptr;
-	geo->VertexBufferGPU = nullptr;
+	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
 
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
@@ -755,23 +1273,91 @@ void BlendApp::BuildBoxGeometry()
 	mGeometries["boxGeo"] = std::move(geo);
 }
 
+void BlendApp::BuildTreeSprites()
+{
+	std::vector<Billboard> trees;
+	trees.reserve(mTreeCount);
+
+	// Scatter the trees over the land above the water line; give up on a spot
+	// after a few tries rather than looping on a mostly flooded map.
+	for (UINT i = 0; i < mTreeCount; ++i)
+	{
+		for (int attempt = 0; attempt < 8; ++attempt)
+		{
+			float x = MathHelper::RandF(-75.0f, 75.0f);
+			float z = MathHelper::RandF(-75.0f, 75.0f);
+			float y = GetHillsHeight(x, z);
+			if (y < 2.0f)
+				continue;
+
+			float size = MathHelper::RandF(3.0f, 6.0f);
+
+			Billboard tree;
+			tree.Position = XMFLOAT3(x, y - 0.3f, z);
+			tree.Size = XMFLOAT2(size, size);
+			tree.Slice = (UINT)MathHelper::Rand(0, 2);
+			trees.push_back(tree);
+			break;
+		}
+	}
+
+	mTreeSprites = std::make_unique<BillboardSet>(md3dDevice.Get(), mCommandList.Get(), trees);
+	mTreeSprites->SetFadeDistances(80.0f, 120.0f);
+}
+
+void BlendApp::BuildLights()
+{
+	mClusteredLighting = std::make_unique<ClusteredLighting>(md3dDevice.Get(), mClientWidth, mClientHeight);
+
+	// Lanterns hovering over the hills, and lamps shining down on them.
+	auto randomLandPoint = [this](float heightAboveGround)
+	{
+		for (;;)
+		{
+			float x = MathHelper::RandF(-75.0f, 75.0f);
+			float z = MathHelper::RandF(-75.0f, 75.0f);
+			float y = GetHillsHeight(x, z);
+			if (y > 0.5f)
+				return XMFLOAT3(x, y + heightAboveGround, z);
+		}
+	};
+
+	auto randomColor = []()
+	{
+		XMFLOAT3 color(MathHelper::RandF(0.2f, 1.0f), MathHelper::RandF(0.2f, 1.0f), MathHelper::RandF(0.2f, 1.0f));
+		return color;
+	};
+
+	mPointLights.resize(mPointLightCount);
+	for (auto& light : mPointLights)
+	{
+		light.Strength = randomColor();
+		light.Position = randomLandPoint(1.5f);
+		light.FalloffStart = 1.0f;
+		light.FalloffEnd = MathHelper::RandF(4.0f, 8.0f);
+	}
+
+	mSpotLights.resize(mSpotLightCount);
+	for (auto& light : mSpotLights)
+	{
+		light.Strength = randomColor();
+		light.Position = randomLandPoint(8.0f);
+		light.Direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+		light.FalloffStart = 4.0f;
+		light.FalloffEnd = 16.0f;
+		light.SpotPower = MathHelper::RandF(8.0f, 32.0f);
+	}
+}
+
 void BlendApp::BuildPSOs()
 {
+	// The shaders of the opaque, transparent and alpha tested passes come from
+	// mDefaultShaders per render item key.
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaquePsoDesc;
 
 	ZeroMemory(&opaquePsoDesc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
 	opaquePsoDesc.InputLayout = { mInputLayout.data(),(UINT)mInputLayout.size() };
 	opaquePsoDesc.pRootSignature = mRootSignature.Get();
-	opaquePsoDesc.VS =
-	{
-		reinterpret_cast<BYTE*>(mShaders["standardVS"]->GetBufferPointer()),
-		mShaders["standardVS"]->GetBufferSize()
-	};
-	opaquePsoDesc.PS =
-	{
-		reinterpret_cast<BYTE*>(mShaders["opaquePS"]->GetBufferPointer()),
-		mShaders["opaquePS"]->GetBufferSize()
-	};
 	opaquePsoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
 	opaquePsoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
 	opaquePsoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
@@ -779,10 +1365,21 @@ void BlendApp::BuildPSOs()
 	opaquePsoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
 	opaquePsoDesc.NumRenderTargets = 1;
 	opaquePsoDesc.RTVFormats[0] = mBackBufferFormat;
-	opaquePsoDesc.SampleDesc.Count = m4xMsaaState ? 4 : 1;
-	opaquePsoDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
+	opaquePsoDesc.SampleDesc = MsaaSampleDesc();
+	mPsoSampleDesc = opaquePsoDesc.SampleDesc;
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+	mPassPsos["opaque"] = std::make_unique<PermutationPsos>(md3dDevice.Get(), opaquePsoDesc, *mDefaultShaders, "VS", "PS");
+
+	// The depth pre-pass has no pixel shader, so every opaque key shares its PSO.
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC depthPrepassPsoDesc = opaquePsoDesc;
+	depthPrepassPsoDesc.InputLayout = { mDepthInputLayout.data(),(UINT)mDepthInputLayout.size() };
+	depthPrepassPsoDesc.BlendState.RenderTarget[0].RenderTargetWriteMask = 0;
+	mPassPsos["opaqueDepthPrepass"] = std::make_unique<PermutationPsos>(md3dDevice.Get(), depthPrepassPsoDesc, *mDefaultShaders, "DepthVS", "");
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC depthEqualPsoDesc = opaquePsoDesc;
+	depthEqualPsoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_EQUAL;
+	depthEqualPsoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+	mPassPsos["opaqueDepthEqual"] = std::make_unique<PermutationPsos>(md3dDevice.Get(), depthEqualPsoDesc, *mDefaultShaders, "VS", "PS");
 
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC transparentPsoDesc = opaquePsoDesc;
 
@@ -799,16 +1396,62 @@ void BlendApp::BuildPSOs()
 	transparencyBlendDesc.RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
 
 	transparentPsoDesc.BlendState.RenderTarget[0] = transparencyBlendDesc;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&transparentPsoDesc, IID_PPV_ARGS(&mPSOs["transparent"])));
+	mPassPsos["transparent"] = std::make_unique<PermutationPsos>(md3dDevice.Get(), transparentPsoDesc, *mDefaultShaders, "VS", "PS");
 
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC alphaTestedPsoDesc = opaquePsoDesc;
-	alphaTestedPsoDesc.PS =
+	alphaTestedPsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+	mPassPsos["alphaTested"] = std::make_unique<PermutationPsos>(md3dDevice.Get(), alphaTestedPsoDesc, *mDefaultShaders, "VS", "PS");
+
+	// Create the variants the scene uses now rather than on their first draw.
+	const char* layerPasses[] = { "opaque", "transparent", "alphaTested", "transparent" };
+	for (int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+	{
+		for (auto ri : mRitemLayer[layer])
+			mPassPsos[layerPasses[layer]]->Get(ri->Variant);
+	}
+	for (auto ri : mRitemLayer[(int)RenderLayer::Opaque])
+	{
+		mPassPsos["opaqueDepthPrepass"]->Get(ri->Variant);
+		mPassPsos["opaqueDepthEqual"]->Get(ri->Variant);
+	}
+
+	// The tree vertices come from SV_VertexID, so there is no input layout.
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC treeSpritePsoDesc = alphaTestedPsoDesc;
+	treeSpritePsoDesc.InputLayout = { nullptr, 0 };
+	treeSpritePsoDesc.VS =
 	{
-		reinterpret_cast<BYTE*>(mShaders["alphaTestedPS"]->GetBufferPointer()),
-		mShaders["alphaTestedPS"]->GetBufferSize()
+		reinterpret_cast<BYTE*>(mShaders["treeSpriteVS"]->GetBufferPointer()),
+		mShaders["treeSpriteVS"]->GetBufferSize()
 	};
-	alphaTestedPsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&alphaTestedPsoDesc, IID_PPV_ARGS(&mPSOs["alphaTested"])));
+	treeSpritePsoDesc.PS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["treeSpritePS"]->GetBufferPointer()),
+		mShaders["treeSpritePS"]->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&treeSpritePsoDesc, IID_PPV_ARGS(&mPSOs["treeSprites"])));
+
+	if (mUseGpuWaves)
+	{
+		D3D12_COMPUTE_PIPELINE_STATE_DESC wavesDisturbPSO = {};
+		wavesDisturbPSO.pRootSignature = mWavesRootSignature.Get();
+		wavesDisturbPSO.CS =
+		{
+			reinterpret_cast<BYTE*>(mShaders["wavesDisturbCS"]->GetBufferPointer()),
+			mShaders["wavesDisturbCS"]->GetBufferSize()
+		};
+		wavesDisturbPSO.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+		ThrowIfFailed(md3dDevice->CreateComputePipelineState(&wavesDisturbPSO, IID_PPV_ARGS(&mPSOs["wavesDisturb"])));
+
+		D3D12_COMPUTE_PIPELINE_STATE_DESC wavesUpdatePSO = {};
+		wavesUpdatePSO.pRootSignature = mWavesRootSignature.Get();
+		wavesUpdatePSO.CS =
+		{
+			reinterpret_cast<BYTE*>(mShaders["wavesUpdateCS"]->GetBufferPointer()),
+			mShaders["wavesUpdateCS"]->GetBufferSize()
+		};
+		wavesUpdatePSO.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+		ThrowIfFailed(md3dDevice->CreateComputePipelineState(&wavesUpdatePSO, IID_PPV_ARGS(&mPSOs["wavesUpdate"])));
+	}
 }
 
 void BlendApp::BuildFrameResources()
@@ -816,7 +1459,8 @@ void BlendApp::BuildFrameResources()
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
 		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-			1, (UINT)mAllRitems.size(), (UINT)mMaterials.size(), mWaves->VertexCount()));
+			1, (UINT)mAllRitems.size(), (UINT)mMaterials.size(), mUseGpuWaves ? 0 : mWaves->VertexCount(),
+			ClusteredLighting::UploadByteSize(mPointLightCount + mSpotLightCount)));
 	}
 }
 
@@ -846,9 +1490,18 @@ void BlendApp::BuildMaterials()
 	wirefence->FresnelR0 = XMFLOAT3(0.1f, 0.1f, 0.1f);
 	wirefence->Roughness = 0.25f;
 
+	auto treeSprites = std::make_unique<Material>();
+	treeSprites->Name = "treeSprites";
+	treeSprites->MatCBIndex = 3;
+	treeSprites->DiffuseSrvHeapIndex = 3;
+	treeSprites->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+	treeSprites->FresnelR0 = XMFLOAT3(0.01f, 0.01f, 0.01f);
+	treeSprites->Roughness = 0.125f;
+
 	mMaterials["grass"] = std::move(grass);
 	mMaterials["water"] = std::move(water);
 	mMaterials["wirefence"] = std::move(wirefence);
+	mMaterials["treeSprites"] = std::move(treeSprites);
 }
 
 void BlendApp::BuildRenderItems()
@@ -864,9 +1517,26 @@ void BlendApp::BuildRenderItems()
 	wavesRitem->StartIndexLocation = wavesRitem->Geo->DrawArgs["grid"].StartIndexLocation;
 	wavesRitem->BaseVertexLocation = wavesRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
 
+	// Lit by the three directional lights and fogged; the materials only differ
+	// in alpha testing and displacement.
+	const ShaderKey litFogged = mDefaultShaders->With(mDefaultShaders->With(0, "NUM_DIR_LIGHTS", 3), "FOG");
+	wavesRitem->Variant = litFogged;
+
 	mWavesRitem = wavesRitem.get();
 
-	mRitemLayer[(int)RenderLayer::Transparent].push_back(wavesRitem.get());
+	if (mUseGpuWaves)
+	{
+		wavesRitem->DisplacementMapTexelSize.x = 1.0f / mGpuWaves->ColumnCount();
+		wavesRitem->DisplacementMapTexelSize.y = 1.0f / mGpuWaves->RowCount();
+		wavesRitem->GridSpatialStep = mGpuWaves->SpatialStep();
+		wavesRitem->Variant = mDefaultShaders->With(litFogged, "DISPLACEMENT_MAP");
+
+		mRitemLayer[(int)RenderLayer::GpuWaves].push_back(wavesRitem.get());
+	}
+	else
+	{
+		mRitemLayer[(int)RenderLayer::Transparent].push_back(wavesRitem.get());
+	}
 
 	auto gridRitem = std::make_unique<RenderItem>();
 	gridRitem->World = MathHelper::Identity4x4();
@@ -878,6 +1548,7 @@ void BlendApp::BuildRenderItems()
 	gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
 	gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
 	gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+	gridRitem->Variant = litFogged;
 
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(gridRitem.get());
 
@@ -890,6 +1561,7 @@ void BlendApp::BuildRenderItems()
 	boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
 	boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
 	boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
+	boxRitem->Variant = mDefaultShaders->With(litFogged, "ALPHA_TEST");
 
 	mRitemLayer[(int)RenderLayer::AlphaTested].push_back(boxRitem.get());
 
@@ -898,18 +1570,25 @@ void BlendApp::BuildRenderItems()
 	mAllRitems.push_back(std::move(boxRitem));
 }
 
-void BlendApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
+void BlendApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems,
+	PermutationPsos& psos)
 {
-	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
-	UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
-
-	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
-	auto matCB = mCurrFrameResource->MaterialCB->Resource();
+	const auto& objectCB = mCurrFrameResource->ObjectCB;
+	const auto& matCB = mCurrFrameResource->MaterialCB;
 
+	ID3D12PipelineState* currentPso = nullptr;
 	for (size_t i = 0; i < ritems.size(); ++i)
 	{
 		auto ri = ritems[i];
 
+		// Only switch when the variant changes.
+		ID3D12PipelineState* pso = psos.Get(ri->Variant);
+		if (pso != currentPso)
+		{
+			cmdList->SetPipelineState(pso);
+			currentPso = pso;
+		}
+
 		cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
 		cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
 		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
@@ -917,8 +1596,8 @@ void BlendApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::ve
 		CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
 		tex.Offset(ri->Mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
 
-		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex * objCBByteSize;
-		D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB->GetGPUVirtualAddress() + ri->Mat->MatCBIndex * matCBByteSize;
+		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB.GpuAddress(ri->ObjCBIndex);
+		D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB.GpuAddress(ri->Mat->MatCBIndex);
 
 		cmdList->SetGraphicsRootDescriptorTable(0, tex);
 		cmdList->SetGraphicsRootConstantBufferView(1, objCBAddress);
@@ -928,6 +1607,19 @@ void BlendApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::ve
 	}
 }
 
+void BlendApp::DrawTreeSprites(ID3D12GraphicsCommandList* cmdList)
+{
+	auto mat = mMaterials["treeSprites"].get();
+
+	CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	tex.Offset(mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
+
+	cmdList->SetGraphicsRootDescriptorTable(0, tex);
+	cmdList->SetGraphicsRootConstantBufferView(3, mCurrFrameResource->MaterialCB.GpuAddress(mat->MatCBIndex));
+
+	mTreeSprites->Draw(cmdList, 5, 6);
+}
+
 std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> BlendApp::GetStaticSamplers()
 {
 	const CD3DX12_STATIC_SAMPLER_DESC pointWrap(
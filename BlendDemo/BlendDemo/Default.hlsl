@@ -11,9 +11,15 @@
 #endif
 
 #include "../../Shader/LightingUtil.hlsl"
+#include "../../Shader/ClusteredLighting.hlsl"
 
 Texture2D gDiffuseMap : register(t0);
 
+#ifdef DISPLACEMENT_MAP
+// Wave heights written by WaveSim.hlsl.
+Texture2D gDisplacementMap : register(t1);
+#endif
+
 SamplerState gsamPointWrap : register(s0);
 SamplerState gsamPointClamp : register(s1);
 SamplerState gsamLinearWrap : register(s2);
@@ -25,6 +31,9 @@ cbuffer cbPerObject : register(b0)
 {
     float4x4 gWorld;
     float4x4 gTexTransform;
+    float2 gDisplacementMapTexelSize;
+    float gGridSpatialStep;
+    float cbPerObjectPad0;
 };
 
 cbuffer cbPass : register(b1)
@@ -79,13 +88,29 @@ struct VertexOut
 VertexOut VS(VertexIn vin)
 {
     VertexOut vout = (VertexOut) 0.0f;
+    
+#ifdef DISPLACEMENT_MAP
+    // Sample the displacement map using non-transformed [0,1]^2 tex-coords.
+    vin.PosL.y += gDisplacementMap.SampleLevel(gsamLinearClamp, vin.TexC, 0.0f).r;
+    
+    // Estimate normal using finite difference.
+    float du = gDisplacementMapTexelSize.x;
+    float dv = gDisplacementMapTexelSize.y;
+    float l = gDisplacementMap.SampleLevel(gsamPointClamp, vin.TexC - float2(du, 0.0f), 0.0f).r;
+    float r = gDisplacementMap.SampleLevel(gsamPointClamp, vin.TexC + float2(du, 0.0f), 0.0f).r;
+    float t = gDisplacementMap.SampleLevel(gsamPointClamp, vin.TexC - float2(0.0f, dv), 0.0f).r;
+    float b = gDisplacementMap.SampleLevel(gsamPointClamp, vin.TexC + float2(0.0f, dv), 0.0f).r;
+    vin.NormalL = normalize(float3(-r + l, 2.0f * gGridSpatialStep, b - t));
+#endif
      
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    // precise: DepthVS must produce the same bits for the depth EQUAL test.
+    precise float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
     vout.PosW = posW.xyz;
     
     vout.NormalW = mul(vin.NormalL, (float3x3) gWorld);
     
-    vout.PosH = mul(posW, gViewProj);
+    precise float4 posH = mul(posW, gViewProj);
+    vout.PosH = posH;
     
     float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
     vout.TexC = mul(texC,gMatTransform).xy;
@@ -93,6 +118,15 @@ VertexOut VS(VertexIn vin)
     return vout;
 }
 
+// Position only, for the depth pre-pass of undisplaced geometry.  Transforms
+// exactly like VS.
+float4 DepthVS(float3 posL : POSITION) : SV_POSITION
+{
+    precise float4 posW = mul(float4(posL, 1.0f), gWorld);
+    precise float4 posH = mul(posW, gViewProj);
+    return posH;
+}
+
 float4 PS(VertexOut pin):SV_Target
 {
     float4 diffuseAlbedo = gDiffuseAlbedo * gDiffuseMap.Sample(gsamAnisotropicWrap, pin.TexC);
@@ -115,6 +149,10 @@ float4 PS(VertexOut pin):SV_Target
     float4 directLight = ComputeLighting(Lights, mat, pin.PosW,
         pin.NormalW, toEyeW, shadowFactor);
 
+    // Only the point and spot lights binned into this pixel's cluster.
+    directLight.rgb += ComputeClusteredLighting(mat, pin.PosW, pin.NormalW, toEyeW,
+        pin.PosH.xy, pin.PosH.w);
+
     float4 litColor = ambient + directLight;
     
     #ifdef FOG
@@ -1,17 +1,37 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT wavesVertCount)
+FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT wavesVertCount,
+	UINT64 lightingUploadBytes)
 {
 	ThrowIfFailed(device->CreateCommandAllocator(
 		D3D12_COMMAND_LIST_TYPE_DIRECT,
 		IID_PPV_ARGS(CmdListAlloc.GetAddressOf())
 	));
 
-	PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
-	MaterialCB = std::make_unique<UploadBuffer<MaterialConstants>>(device, materialCount, true);
-	ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
+	ThrowIfFailed(device->CreateCommandAllocator(
+		D3D12_COMMAND_LIST_TYPE_COMPUTE,
+		IID_PPV_ARGS(ComputeCmdListAlloc.GetAddressOf())
+	));
+
+	const UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+
+	UINT64 persistentBytes =
+		(UINT64)passCount * d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants)) +
+		(UINT64)materialCount * d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants)) +
+		(UINT64)objectCount * d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+
+	// The GPU wave simulation displaces a static grid in the vertex shader,
+	// so it does not need any per-frame vertex data.
+	UINT64 transientBytes = wavesVertCount > 0 ? (UINT64)wavesVertCount * sizeof(Vertex) + alignment : 0;
+	transientBytes += lightingUploadBytes;
+
+	Upload = std::make_unique<LinearUploadAllocator>(device, persistentBytes + transientBytes);
+
+	PassCB = UploadSlice<PassConstants>(*Upload, passCount, true);
+	MaterialCB = UploadSlice<MaterialConstants>(*Upload, materialCount, true);
+	ObjectCB = UploadSlice<ObjectConstants>(*Upload, objectCount, true);
 
-	WavesVB = std::make_unique<UploadBuffer<Vertex>>(device, wavesVertCount, false);
+	Upload->MarkPersistent();
 }
 
 FrameResource::~FrameResource()
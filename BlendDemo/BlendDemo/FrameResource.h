@@ -3,11 +3,15 @@
 #include "../../Common/d3dUtil.h"
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
+#include "../../Common/LinearUploadAllocator.h"
 
 struct ObjectConstants
 {
 	DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
 	DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+	DirectX::XMFLOAT2 DisplacementMapTexelSize = { 1.0f, 1.0f };
+	float GridSpatialStep = 1.0f;
+	float Pad;
 };
 
 struct PassConstants
@@ -47,18 +51,27 @@ struct Vertex
 struct FrameResource
 {
 public:
-	FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount);
+	FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount,
+		UINT64 lightingUploadBytes);
 	FrameResource(const FrameResource& rhs) = delete;
 	FrameResource& operator=(const FrameResource& rhs) = delete;
 	~FrameResource();
 
 	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
 
-	std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
-	std::unique_ptr<UploadBuffer<MaterialConstants>> MaterialCB = nullptr;
-	std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
+	// For the waves step on the async compute queue.
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> ComputeCmdListAlloc;
 
-	std::unique_ptr<UploadBuffer<Vertex>> WavesVB = nullptr;
+	// All of the frame's upload memory.  The constant buffers below are
+	// persistent slices of it; per-frame data such as the CPU waves vertex
+	// buffer and the clustered lights is allocated from it after Upload->Reset().
+	// It is sized for all of that up front, and chains another page if a
+	// frame needs more.
+	std::unique_ptr<LinearUploadAllocator> Upload = nullptr;
+
+	UploadSlice<PassConstants> PassCB;
+	UploadSlice<MaterialConstants> MaterialCB;
+	UploadSlice<ObjectConstants> ObjectCB;
 
 	UINT64 Fence = 0;
 };
\ No newline at end of file
@@ -0,0 +1,179 @@
+//=============================================================================
+// TreeSprite.hlsl
+//
+// Draws a BillboardSet: the vertex shader pulls one tree per six vertices
+// from gBillboards and expands it into a quad that turns about the y axis
+// to face the eye.  Trees dissolve with a screen space dither between
+// gFadeStart and gFadeEnd and are not rasterized past gFadeEnd.
+//=============================================================================
+
+#ifndef NUM_DIR_LIGHTS
+    #define NUM_DIR_LIGHTS 3
+#endif
+
+#ifndef NUM_POINT_LIGHTS
+    #define NUM_POINT_LIGHTS 0
+#endif
+
+#ifndef NUM_SPOT_LIGHTS
+    #define NUM_SPOT_LIGHTS 0
+#endif
+
+#include "../../Shader/LightingUtil.hlsl"
+#include "../../Shader/ClusteredLighting.hlsl"
+
+struct Billboard
+{
+    float3 PosW;
+    float2 Size;
+    uint Slice;
+};
+
+Texture2DArray gTreeMapArray : register(t0);
+
+StructuredBuffer<Billboard> gBillboards : register(t2);
+
+SamplerState gsamPointWrap : register(s0);
+SamplerState gsamPointClamp : register(s1);
+SamplerState gsamLinearWrap : register(s2);
+SamplerState gsamLinearClamp : register(s3);
+SamplerState gsamAnisotropicWrap : register(s4);
+SamplerState gsamAnisotropicClamp : register(s5);
+
+cbuffer cbPass : register(b1)
+{
+    float4x4 gView;
+    float4x4 gInvView;
+    float4x4 gProj;
+    float4x4 gInvProj;
+    float4x4 gViewProj;
+    float4x4 gInvViewProj;
+    float3 gEyePosW;
+    float cbPerObjectPad1;
+    float2 gRenderTargetSize;
+    float2 gInvRenderTargetSize;
+    float gNearZ;
+    float gFarZ;
+    float gTotalTime;
+    float gDeltaTime;
+    float4 gAmbientLight;
+    
+    float4 gFogColor;
+    float gFogStart;
+    float gFogRange;
+    float2 cbPerObjectPad2;
+    
+    Light Lights[MaxLights];
+};
+
+cbuffer cbMaterial : register(b2)
+{
+    float4 gDiffuseAlbedo;
+    float3 gFresnelR0;
+    float gRoughness;
+    float4x4 gMatTransform;
+};
+
+// Set by BillboardSet::Draw().
+cbuffer cbBillboard : register(b3)
+{
+    float gFadeStart;
+    float gFadeEnd;
+};
+
+// Two triangles per quad: x across the quad in [-1, 1], y up it in [0, 1].
+static const float2 gQuadCorners[6] =
+{
+    float2(-1.0f, 0.0f), float2(-1.0f, 1.0f), float2(1.0f, 0.0f),
+    float2( 1.0f, 0.0f), float2(-1.0f, 1.0f), float2(1.0f, 1.0f)
+};
+
+struct VertexOut
+{
+    float4 PosH : SV_POSITION;
+    float3 PosW : POSITION;
+    float3 NormalW : NORMAL;
+    float2 TexC : TEXCOORD0;
+    float Fade : TEXCOORD1;
+    nointerpolation uint Slice : SLICE;
+};
+
+VertexOut VS(uint vertexID : SV_VertexID)
+{
+    VertexOut vout = (VertexOut)0.0f;
+
+    Billboard tree = gBillboards[vertexID / 6];
+    float2 corner = gQuadCorners[vertexID % 6];
+
+    float3 look = gEyePosW - tree.PosW;
+    look.y = 0.0f;
+    float distToEye = length(look);
+
+    // Past the fade distance the whole quad is put behind the near plane and clipped.
+    if (distToEye >= gFadeEnd)
+    {
+        vout.PosH = float4(0.0f, 0.0f, -1.0f, 1.0f);
+        return vout;
+    }
+
+    look = distToEye > 1e-4f ? look / distToEye : float3(0.0f, 0.0f, -1.0f);
+    float3 right = float3(look.z, 0.0f, -look.x);
+
+    vout.PosW = tree.PosW +
+        right * (0.5f * tree.Size.x * corner.x) +
+        float3(0.0f, tree.Size.y * corner.y, 0.0f);
+    vout.PosH = mul(float4(vout.PosW, 1.0f), gViewProj);
+    vout.NormalW = look;
+    vout.TexC = float2(0.5f + 0.5f * corner.x, 1.0f - corner.y);
+    vout.Fade = 1.0f - saturate((distToEye - gFadeStart) / (gFadeEnd - gFadeStart));
+    vout.Slice = tree.Slice;
+
+    return vout;
+}
+
+// 4x4 ordered dither thresholds in (0, 1).
+static const float gDither[16] =
+{
+     1.0f / 17.0f,  9.0f / 17.0f,  3.0f / 17.0f, 11.0f / 17.0f,
+    13.0f / 17.0f,  5.0f / 17.0f, 15.0f / 17.0f,  7.0f / 17.0f,
+     4.0f / 17.0f, 12.0f / 17.0f,  2.0f / 17.0f, 10.0f / 17.0f,
+    16.0f / 17.0f,  8.0f / 17.0f, 14.0f / 17.0f,  6.0f / 17.0f
+};
+
+float4 PS(VertexOut pin) : SV_Target
+{
+    // Stays alpha tested, so the forest needs neither sorting nor blending.
+    uint2 pixel = (uint2)pin.PosH.xy;
+    clip(pin.Fade - gDither[(pixel.y & 3) * 4 + (pixel.x & 3)]);
+
+    float4 diffuseAlbedo = gDiffuseAlbedo *
+        gTreeMapArray.Sample(gsamAnisotropicClamp, float3(pin.TexC, pin.Slice));
+    clip(diffuseAlbedo.a - 0.1f);
+
+    pin.NormalW = normalize(pin.NormalW);
+
+    float3 toEyeW = gEyePosW - pin.PosW;
+    float distToEye = length(toEyeW);
+    toEyeW /= distToEye;
+
+    float4 ambient = gAmbientLight * diffuseAlbedo;
+
+    const float shininess = 1.0f - gRoughness;
+    Material mat = { diffuseAlbedo, gFresnelR0, shininess };
+    float3 shadowFactor = 1.0f;
+    float4 directLight = ComputeLighting(Lights, mat, pin.PosW,
+        pin.NormalW, toEyeW, shadowFactor);
+
+    // Only the point and spot lights binned into this pixel's cluster.
+    directLight.rgb += ComputeClusteredLighting(mat, pin.PosW, pin.NormalW, toEyeW,
+        pin.PosH.xy, pin.PosH.w);
+
+    float4 litColor = ambient + directLight;
+
+    float fogAmount = saturate((distToEye - gFogStart) / gFogRange);
+    litColor = lerp(litColor, gFogColor, fogAmount);
+
+    litColor.a = diffuseAlbedo.a;
+
+    return litColor;
+}
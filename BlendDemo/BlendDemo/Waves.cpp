@@ -3,13 +3,21 @@
 //***************************************************************************************
 
 #include "Waves.h"
-#include <ppl.h>
+#include "../../Common/JobSystem.h"
 #include <algorithm>
 #include <vector>
 #include <cassert>
+#include <cmath>
 
 using namespace DirectX;
 
+namespace
+{
+	// Heights (and changes of height per step) below this count as flat water;
+	// a thousandth of a unit is far below anything that shows.
+	const float ActiveEpsilon = 1.0e-3f;
+}
+
 Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
 {
 	mNumRows = m;
@@ -27,28 +35,24 @@ Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
 	mK2 = (4.0f - 8.0f * e) / d;
 	mK3 = (2.0f * e) / d;
 
-	mPrevSolution.resize(m * n);
-	mCurrSolution.resize(m * n);
-	mNormals.resize(m * n);
-	mTangentX.resize(m * n);
-
-	// Generate grid vertices in system memory.
+	// The grid starts flat; x/z are derived from the grid in Position().
+	mHalfWidth = (n - 1) * dx * 0.5f;
+	mHalfDepth = (m - 1) * dx * 0.5f;
 
-	float halfWidth = (n - 1) * dx * 0.5f;
-	float halfDepth = (m - 1) * dx * 0.5f;
-	for (int i = 0; i < m; ++i)
-	{
-		float z = halfDepth - i * dx;
-		for (int j = 0; j < n; ++j)
-		{
-			float x = -halfWidth + j * dx;
+	mPrevHeights.assign(m * n, 0.0f);
+	mCurrHeights.assign(m * n, 0.0f);
+	mNormalX.assign(m * n, 0.0f);
+	mNormalY.assign(m * n, 1.0f);
+	mNormalZ.assign(m * n, 0.0f);
+	mTangentX.assign(m * n, 1.0f);
+	mTangentY.assign(m * n, 0.0f);
 
-			mPrevSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-			mCurrSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-			mNormals[i * n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			mTangentX[i * n + j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
-		}
-	}
+	mTileRows = (m - 2 + TileSize - 1) / TileSize;
+	mTileCols = (n - 2 + TileSize - 1) / TileSize;
+	mActiveTiles.assign(mTileRows * mTileCols, 0);
+	mSimulatedTiles.assign(mTileRows * mTileCols, 0);
+	mChangedTiles.assign(mTileRows * mTileCols, 0);
+	mTileAmplitudes.assign(mTileRows * mTileCols, 0.0f);
 }
 
 Waves::~Waves()
@@ -85,72 +89,326 @@ float Waves::Depth()const
 	return mNumRows * mSpatialStep;
 }
 
+XMFLOAT3 Waves::Position(int i)const
+{
+	int row = i / mNumCols;
+	int col = i - row * mNumCols;
+
+	return XMFLOAT3(-mHalfWidth + col * mSpatialStep, mCurrHeights[i], mHalfDepth - row * mSpatialStep);
+}
+
+int Waves::TileRowCount()const
+{
+	return mTileRows;
+}
+
+int Waves::TileColumnCount()const
+{
+	return mTileCols;
+}
+
+void Waves::TileRows(int tileRow, int& first, int& last)const
+{
+	first = 1 + tileRow * TileSize;
+	last = (std::min)(first + TileSize, mNumRows - 1);
+}
+
+void Waves::TileColumns(int tileCol, int& first, int& last)const
+{
+	first = 1 + tileCol * TileSize;
+	last = (std::min)(first + TileSize, mNumCols - 1);
+}
+
+bool Waves::TileChanged(int tileRow, int tileCol)const
+{
+	return mChangedTiles[tileRow * mTileCols + tileCol] != 0;
+}
+
+void Waves::ClearChangedTiles()
+{
+	std::fill(mChangedTiles.begin(), mChangedTiles.end(), (unsigned char)0);
+}
+
+void Waves::Update(float dt, JobSystem& jobs)
+{
+	if (!BeginStep(dt))
+		return;
+
+	// Only update interior points; we use zero boundary conditions.
+	//
+	// The height update and the normal pass are fused: each task owns a band
+	// of rows, and as soon as row i is written the normals of row i-1 can be
+	// computed while its neighbours are still in cache.  The first and last
+	// row of a band depend on the neighbouring bands, so those are done
+	// in a second, much smaller pass.  Within a band only the tiles UpdateTiles()
+	// picked are touched.
+	if (UpdateTiles() > 0)
+	{
+		jobs.ParallelFor(0, mTileRows, 1, [this](int band) { UpdateBand(band); });
+		jobs.ParallelFor(0, mTileRows, 1, [this](int band) { UpdateBandEdges(band); });
+	}
+
+	EndStep();
+}
+
 void Waves::Update(float dt)
 {
-	static float t = 0;
+	if (!BeginStep(dt))
+		return;
+
+	if (UpdateTiles() > 0)
+	{
+		for (int band = 0; band < mTileRows; ++band)
+			UpdateBand(band);
+		for (int band = 0; band < mTileRows; ++band)
+			UpdateBandEdges(band);
+	}
+
+	EndStep();
+}
+
+bool Waves::BeginStep(float dt)
+{
+	// Accumulate time; only update the simulation at the specified time step.
+	mTime += dt;
+	return mTime >= mTimeStep;
+}
+
+void Waves::EndStep()
+{
+	// We just overwrote the previous buffer with the new data, so
+	// this data needs to become the current solution and the old
+	// current solution becomes the new previous solution.
+	std::swap(mPrevHeights, mCurrHeights);
+
+	mTime = 0.0f; // reset time
+}
 
-	// Accumulate time.
-	t += dt;
+int Waves::UpdateTiles()
+{
+	// The stencil only reaches the four direct neighbours, so a wave leaves a
+	// tile through one of its sides and the tiles beside the active ones are
+	// enough of a halo: they turn active themselves before it can get further.
+	auto active = [this](int r, int c)
+	{
+		return r >= 0 && r < mTileRows && c >= 0 && c < mTileCols && mActiveTiles[r * mTileCols + c] != 0;
+	};
 
-	// Only update the simulation at the specified time step.
-	if (t >= mTimeStep)
+	int simulatedCount = 0;
+	for (int r = 0; r < mTileRows; ++r)
 	{
-		// Only update interior points; we use zero boundary conditions.
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-			//for(int i = 1; i < mNumRows-1; ++i)
+		for (int c = 0; c < mTileCols; ++c)
+		{
+			const int k = r * mTileCols + c;
+			const bool simulate = active(r, c) || active(r - 1, c) || active(r + 1, c) ||
+				active(r, c - 1) || active(r, c + 1);
+
+			if (simulate)
 			{
-				for (int j = 1; j < mNumCols - 1; ++j)
-				{
-					// After this update we will be discarding the old previous
-					// buffer, so overwrite that buffer with the new update.
-					// Note how we can do this inplace (read/write to same element) 
-					// because we won't need prev_ij again and the assignment happens last.
-
-					// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
-					// Moreover, our +z axis goes "down"; this is just to 
-					// keep consistent with our row indices going down.
-
-					mPrevSolution[i * mNumCols + j].y =
-						mK1 * mPrevSolution[i * mNumCols + j].y +
-						mK2 * mCurrSolution[i * mNumCols + j].y +
-						mK3 * (mCurrSolution[(i + 1) * mNumCols + j].y +
-							mCurrSolution[(i - 1) * mNumCols + j].y +
-							mCurrSolution[i * mNumCols + j + 1].y +
-							mCurrSolution[i * mNumCols + j - 1].y);
-				}
-			});
-
-		// We just overwrote the previous buffer with the new data, so
-		// this data needs to become the current solution and the old
-		// current solution becomes the new previous solution.
-		std::swap(mPrevSolution, mCurrSolution);
-
-		t = 0.0f; // reset time
-
-		//
-		// Compute normals using finite difference scheme.
-		//
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-			//for(int i = 1; i < mNumRows - 1; ++i)
+				++simulatedCount;
+				mChangedTiles[k] = 1;
+			}
+			else if (mSimulatedTiles[k])
 			{
-				for (int j = 1; j < mNumCols - 1; ++j)
-				{
-					float l = mCurrSolution[i * mNumCols + j - 1].y;
-					float r = mCurrSolution[i * mNumCols + j + 1].y;
-					float t = mCurrSolution[(i - 1) * mNumCols + j].y;
-					float b = mCurrSolution[(i + 1) * mNumCols + j].y;
-					mNormals[i * mNumCols + j].x = -r + l;
-					mNormals[i * mNumCols + j].y = 2.0f * mSpatialStep;
-					mNormals[i * mNumCols + j].z = b - t;
-
-					XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i * mNumCols + j]));
-					XMStoreFloat3(&mNormals[i * mNumCols + j], n);
-
-					mTangentX[i * mNumCols + j] = XMFLOAT3(2.0f * mSpatialStep, r - l, 0.0f);
-					XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i * mNumCols + j]));
-					XMStoreFloat3(&mTangentX[i * mNumCols + j], T);
-				}
-			});
+				// Everything in and around it is below the epsilon, so what is left
+				// there is put to rest for good.
+				SettleTile(r, c);
+				mChangedTiles[k] = 1;
+			}
+
+			mSimulatedTiles[k] = simulate ? 1 : 0;
+		}
+	}
+
+	return simulatedCount;
+}
+
+void Waves::SettleTile(int tileRow, int tileCol)
+{
+	int firstRow, lastRow, firstCol, lastCol;
+	TileRows(tileRow, firstRow, lastRow);
+	TileColumns(tileCol, firstCol, lastCol);
+
+	for (int i = firstRow; i < lastRow; ++i)
+	{
+		const int begin = i * mNumCols + firstCol;
+		const int end = i * mNumCols + lastCol;
+
+		std::fill(&mPrevHeights[begin], &mPrevHeights[end], 0.0f);
+		std::fill(&mCurrHeights[begin], &mCurrHeights[end], 0.0f);
+		std::fill(&mNormalX[begin], &mNormalX[end], 0.0f);
+		std::fill(&mNormalY[begin], &mNormalY[end], 1.0f);
+		std::fill(&mNormalZ[begin], &mNormalZ[end], 0.0f);
+		std::fill(&mTangentX[begin], &mTangentX[end], 1.0f);
+		std::fill(&mTangentY[begin], &mTangentY[end], 0.0f);
+	}
+}
+
+void Waves::UpdateBand(int band)
+{
+	int first, last;
+	TileRows(band, first, last);
+
+	const unsigned char* simulated = &mSimulatedTiles[band * mTileCols];
+	float* amplitudes = &mTileAmplitudes[band * mTileCols];
+	std::fill(amplitudes, amplitudes + mTileCols, 0.0f);
+
+	// Row by row across the band rather than tile by tile, so the normals of
+	// row i-1 can still read the updated heights of the tiles on either side.
+	for (int i = first; i < last; ++i)
+	{
+		for (int c = 0; c < mTileCols; ++c)
+		{
+			if (!simulated[c])
+				continue;
+
+			int firstCol, lastCol;
+			TileColumns(c, firstCol, lastCol);
+
+			amplitudes[c] = (std::max)(amplitudes[c], UpdateRow(i, firstCol, lastCol));
+
+			if (i - 1 > first)
+				UpdateNormalsRow(mPrevHeights, i - 1, firstCol, lastCol);
+		}
+	}
+
+	// Only simulated tiles can be active, so this covers every active tile.
+	for (int c = 0; c < mTileCols; ++c)
+		mActiveTiles[band * mTileCols + c] = simulated[c] && amplitudes[c] > ActiveEpsilon ? 1 : 0;
+}
+
+void Waves::UpdateBandEdges(int band)
+{
+	int first, last;
+	TileRows(band, first, last);
+
+	for (int c = 0; c < mTileCols; ++c)
+	{
+		if (!mSimulatedTiles[band * mTileCols + c])
+			continue;
+
+		int firstCol, lastCol;
+		TileColumns(c, firstCol, lastCol);
+
+		UpdateNormalsRow(mPrevHeights, first, firstCol, lastCol);
+		if (last - 1 > first)
+			UpdateNormalsRow(mPrevHeights, last - 1, firstCol, lastCol);
+	}
+}
+
+float Waves::UpdateRow(int i, int first, int last)
+{
+	// After this update we will be discarding the old previous
+	// buffer, so overwrite that buffer with the new update.
+	// Note how we can do this inplace (read/write to same element)
+	// because we won't need prev_ij again and the assignment happens last.
+
+	// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
+	// Moreover, our +z axis goes "down"; this is just to
+	// keep consistent with our row indices going down.
+	float* prev = &mPrevHeights[i * mNumCols];
+	const float* curr = &mCurrHeights[i * mNumCols];
+	const float* up = curr - mNumCols;
+	const float* down = curr + mNumCols;
+
+	XMVECTOR k1 = XMVectorReplicate(mK1);
+	XMVECTOR k2 = XMVectorReplicate(mK2);
+	XMVECTOR k3 = XMVectorReplicate(mK3);
+	XMVECTOR amplitude = XMVectorZero();
+
+	int j = first;
+	for (; j + 4 <= last; j += 4)
+	{
+		XMVECTOR p = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(prev + j));
+		XMVECTOR c = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(curr + j));
+		XMVECTOR u = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(up + j));
+		XMVECTOR d = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(down + j));
+		XMVECTOR l = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(curr + j - 1));
+		XMVECTOR r = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(curr + j + 1));
+
+		XMVECTOR sum = XMVectorAdd(XMVectorAdd(d, u), XMVectorAdd(r, l));
+		XMVECTOR next = XMVectorMultiplyAdd(k1, p, XMVectorMultiplyAdd(k2, c, XMVectorMultiply(k3, sum)));
+
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(prev + j), next);
+
+		amplitude = XMVectorMax(amplitude, XMVectorMax(XMVectorAbs(next), XMVectorAbs(XMVectorSubtract(next, c))));
+	}
+
+	XMFLOAT4 lanes;
+	XMStoreFloat4(&lanes, amplitude);
+	float result = (std::max)((std::max)(lanes.x, lanes.y), (std::max)(lanes.z, lanes.w));
+
+	for (; j < last; ++j)
+	{
+		float next =
+			mK1 * prev[j] +
+			mK2 * curr[j] +
+			mK3 * (down[j] + up[j] + curr[j + 1] + curr[j - 1]);
+
+		result = (std::max)(result, (std::max)(std::fabs(next), std::fabs(next - curr[j])));
+		prev[j] = next;
+	}
+
+	return result;
+}
+
+void Waves::UpdateNormalsRow(const std::vector<float>& heights, int i, int first, int last)
+{
+	//
+	// Compute normals using finite difference scheme.
+	//
+	const float* h = &heights[i * mNumCols];
+	const float* up = h - mNumCols;
+	const float* down = h + mNumCols;
+
+	float* nx = &mNormalX[i * mNumCols];
+	float* ny = &mNormalY[i * mNumCols];
+	float* nz = &mNormalZ[i * mNumCols];
+	float* tx = &mTangentX[i * mNumCols];
+	float* ty = &mTangentY[i * mNumCols];
+
+	const float twoDx = 2.0f * mSpatialStep;
+	XMVECTOR twoDxV = XMVectorReplicate(twoDx);
+	XMVECTOR twoDxSq = XMVectorMultiply(twoDxV, twoDxV);
+
+	int j = first;
+	for (; j + 4 <= last; j += 4)
+	{
+		XMVECTOR l = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(h + j - 1));
+		XMVECTOR r = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(h + j + 1));
+		XMVECTOR t = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(up + j));
+		XMVECTOR b = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(down + j));
+
+		// n = normalize(l - r, 2dx, b - t)
+		XMVECTOR dxv = XMVectorSubtract(l, r);
+		XMVECTOR dzv = XMVectorSubtract(b, t);
+		XMVECTOR lenSq = XMVectorMultiplyAdd(dxv, dxv, XMVectorMultiplyAdd(dzv, dzv, twoDxSq));
+		XMVECTOR invLen = XMVectorReciprocalSqrt(lenSq);
+
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(nx + j), XMVectorMultiply(dxv, invLen));
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(ny + j), XMVectorMultiply(twoDxV, invLen));
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(nz + j), XMVectorMultiply(dzv, invLen));
+
+		// T = normalize(2dx, r - l, 0)
+		XMVECTOR invLenT = XMVectorReciprocalSqrt(XMVectorMultiplyAdd(dxv, dxv, twoDxSq));
+
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(tx + j), XMVectorMultiply(twoDxV, invLenT));
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(ty + j), XMVectorMultiply(XMVectorNegate(dxv), invLenT));
+	}
+
+	for (; j < last; ++j)
+	{
+		float dx = h[j - 1] - h[j + 1];
+		float dz = down[j] - up[j];
+
+		float invLen = 1.0f / std::sqrt(dx * dx + twoDx * twoDx + dz * dz);
+		nx[j] = dx * invLen;
+		ny[j] = twoDx * invLen;
+		nz[j] = dz * invLen;
+
+		float invLenT = 1.0f / std::sqrt(twoDx * twoDx + dx * dx);
+		tx[j] = twoDx * invLenT;
+		ty[j] = -dx * invLenT;
 	}
 }
 
@@ -163,10 +421,23 @@ void Waves::Disturb(int i, int j, float magnitude)
 	float halfMag = 0.5f * magnitude;
 
 	// Disturb the ijth vertex height and its neighbors.
-	mCurrSolution[i * mNumCols + j].y += magnitude;
-	mCurrSolution[i * mNumCols + j + 1].y += halfMag;
-	mCurrSolution[i * mNumCols + j - 1].y += halfMag;
-	mCurrSolution[(i + 1) * mNumCols + j].y += halfMag;
-	mCurrSolution[(i - 1) * mNumCols + j].y += halfMag;
-}
+	mCurrHeights[i * mNumCols + j] += magnitude;
+	mCurrHeights[i * mNumCols + j + 1] += halfMag;
+	mCurrHeights[i * mNumCols + j - 1] += halfMag;
+	mCurrHeights[(i + 1) * mNumCols + j] += halfMag;
+	mCurrHeights[(i - 1) * mNumCols + j] += halfMag;
 
+	// Wake up the tiles of all five points; the cross can straddle a tile edge.
+	auto touch = [this](int row, int col)
+	{
+		const int k = ((row - 1) / TileSize) * mTileCols + (col - 1) / TileSize;
+		mActiveTiles[k] = 1;
+		mChangedTiles[k] = 1;
+	};
+
+	touch(i, j);
+	touch(i, j + 1);
+	touch(i, j - 1);
+	touch(i + 1, j);
+	touch(i - 1, j);
+}
@@ -3,6 +3,8 @@
 #include <vector>
 #include <DirectXMath.h>
 
+class JobSystem;
+
 class Waves
 {
 public:
@@ -18,13 +20,72 @@ public:
 	float Width()const;
 	float Depth()const;
 
-	const DirectX::XMFLOAT3& Position(int i)const { return mCurrSolution[i]; }
-	const DirectX::XMFLOAT3& Normal(int i)const { return mNormals[i]; }
-	const DirectX::XMFLOAT3& TangentX(int i)const { return mTangentX[i]; }
+	// Only the heights are simulated; x/z come from the grid.
+	DirectX::XMFLOAT3 Position(int i)const;
+	DirectX::XMFLOAT3 Normal(int i)const { return DirectX::XMFLOAT3(mNormalX[i], mNormalY[i], mNormalZ[i]); }
+	DirectX::XMFLOAT3 TangentX(int i)const { return DirectX::XMFLOAT3(mTangentX[i], mTangentY[i], 0.0f); }
+
+	void Update(float dt, JobSystem& jobs);
 
+	// The same step on the calling thread only, e.g. to measure what the job
+	// system buys.
 	void Update(float dt);
 	void Disturb(int i, int j, float magnitude);
 
+	// The interior of the grid is split into tiles of TileSize x TileSize points.
+	// A tile is active while its heights are above a small epsilon; each step
+	// only simulates the active tiles and the ring of tiles around them, into
+	// which their waves can spread.  A tile that falls out of that set is
+	// settled to flat water, so calm water costs next to nothing.
+	static const int TileSize = 16;
+
+	int TileRowCount()const;
+	int TileColumnCount()const;
+
+	// The grid rows [first, last) and columns [first, last) of a tile.
+	void TileRows(int tileRow, int& first, int& last)const;
+	void TileColumns(int tileCol, int& first, int& last)const;
+
+	// True if the tile's vertices changed since ClearChangedTiles(), so only
+	// those need to be written out again.  The boundary never changes.
+	bool TileChanged(int tileRow, int tileCol)const;
+	void ClearChangedTiles();
+
+	// Writes Pos, Normal and TexC for every grid point into dest in one
+	// sequential pass.  dest is typically the mapped pointer of an upload
+	// buffer, so whole vertices are stored in order and nothing is read back.
+	template<typename VertexT>
+	void WriteVertices(VertexT* dest)const;
+
+	// The same for the colCount points of row i from firstCol on, written to
+	// dest[0, colCount).
+	template<typename VertexT>
+	void WriteVertices(VertexT* dest, int i, int firstCol, int colCount)const;
+
+private:
+	// Accumulates dt; true once a time step has passed.
+	bool BeginStep(float dt);
+	void EndStep();
+
+	// Picks this step's tiles from the active ones and settles the tiles that
+	// were simulated last step but no longer are.  Returns the number of tiles
+	// to simulate.
+	int UpdateTiles();
+	void SettleTile(int tileRow, int tileCol);
+
+	// A band is one row of tiles, so each task owns the tiles it updates.
+	// Heights of the rows of band, and the normals of its inner rows.
+	void UpdateBand(int band);
+	// Normals of the first and last row of band, which need the neighbouring bands.
+	void UpdateBandEdges(int band);
+
+	// Writes the next solution for row i, columns [first, last), over
+	// mPrevHeights.  Returns the largest |next| or |next - curr| of the span.
+	float UpdateRow(int i, int first, int last);
+	// Normals/tangents for row i, columns [first, last), from the heights of
+	// rows i-1, i and i+1.
+	void UpdateNormalsRow(const std::vector<float>& heights, int i, int first, int last);
+
 private:
 	int mNumRows = 0;
 	int mNumCols = 0;
@@ -38,9 +99,58 @@ private:
 
 	float mTimeStep = 0.0f;
 	float mSpatialStep = 0.0f;
-	
-	std::vector<DirectX::XMFLOAT3> mPrevSolution;
-	std::vector<DirectX::XMFLOAT3> mCurrSolution;
-	std::vector<DirectX::XMFLOAT3> mNormals;
-	std::vector<DirectX::XMFLOAT3> mTangentX;
-};
\ No newline at end of file
+
+	float mHalfWidth = 0.0f;
+	float mHalfDepth = 0.0f;
+
+	float mTime = 0.0f;
+
+	// Structure of arrays: the stencil streams through heights only, and the
+	// normal pass writes each component contiguously.
+	std::vector<float> mPrevHeights;
+	std::vector<float> mCurrHeights;
+	std::vector<float> mNormalX;
+	std::vector<float> mNormalY;
+	std::vector<float> mNormalZ;
+	std::vector<float> mTangentX;
+	std::vector<float> mTangentY;
+
+	// One entry per tile, row by row.  Bytes rather than vector<bool>, so the
+	// bands can write their own rows from different threads.
+	int mTileRows = 0;
+	int mTileCols = 0;
+	std::vector<unsigned char> mActiveTiles;
+	std::vector<unsigned char> mSimulatedTiles;
+	std::vector<unsigned char> mChangedTiles;
+	std::vector<float> mTileAmplitudes;
+};
+
+template<typename VertexT>
+void Waves::WriteVertices(VertexT* dest)const
+{
+	for (int i = 0; i < mNumRows; ++i)
+		WriteVertices(dest + i * mNumCols, i, 0, mNumCols);
+}
+
+template<typename VertexT>
+void Waves::WriteVertices(VertexT* dest, int i, int firstCol, int colCount)const
+{
+	const float invWidth = 1.0f / Width();
+	const float invDepth = 1.0f / Depth();
+
+	const float z = mHalfDepth - i * mSpatialStep;
+	const float v = 0.5f - z * invDepth;
+
+	for (int j = firstCol; j < firstCol + colCount; ++j)
+	{
+		const int k = i * mNumCols + j;
+		const float x = -mHalfWidth + j * mSpatialStep;
+
+		VertexT vert;
+		vert.Pos = DirectX::XMFLOAT3(x, mCurrHeights[k], z);
+		vert.Normal = DirectX::XMFLOAT3(mNormalX[k], mNormalY[k], mNormalZ[k]);
+		vert.TexC = DirectX::XMFLOAT2(0.5f + x * invWidth, v);
+
+		dest[j - firstCol] = vert;
+	}
+}
@@ -0,0 +1,55 @@
+//***************************************************************************************
+// BillboardSet.cpp
+//***************************************************************************************
+
+#include "BillboardSet.h"
+
+static_assert(sizeof(Billboard) == 24, "Billboard must match the shader's structured buffer stride.");
+
+BillboardSet::BillboardSet(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList,
+	const std::vector<Billboard>& billboards)
+{
+	mCount = (UINT)billboards.size();
+
+	// An empty set still gets a buffer, so Draw() never binds a null SRV.
+	Billboard placeholder;
+	const void* data = mCount > 0 ? (const void*)billboards.data() : (const void*)&placeholder;
+	const UINT64 byteSize = (UINT64)(std::max)(mCount, 1u) * sizeof(Billboard);
+
+	mBuffer = d3dUtil::CreateDefaultBuffer(device, cmdList, data, byteSize, mUploader);
+}
+
+UINT BillboardSet::Count()const
+{
+	return mCount;
+}
+
+UINT64 BillboardSet::ByteSize()const
+{
+	return (UINT64)mCount * sizeof(Billboard);
+}
+
+void BillboardSet::SetFadeDistances(float fadeStart, float fadeEnd)
+{
+	mFadeStart = fadeStart;
+	mFadeEnd = (std::max)(fadeEnd, fadeStart + 0.01f);
+}
+
+void BillboardSet::Draw(ID3D12GraphicsCommandList* cmdList, UINT srvRootParameter, UINT constantsRootParameter)const
+{
+	if (mCount == 0)
+		return;
+
+	float constants[2] = { mFadeStart, mFadeEnd };
+	cmdList->SetGraphicsRoot32BitConstants(constantsRootParameter, 2, constants, 0);
+	cmdList->SetGraphicsRootShaderResourceView(srvRootParameter, mBuffer->GetGPUVirtualAddress());
+
+	// Two triangles per billboard, generated from SV_VertexID.
+	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	cmdList->DrawInstanced(6 * mCount, 1, 0, 0);
+}
+
+void BillboardSet::DisposeUploader()
+{
+	mUploader = nullptr;
+}
@@ -0,0 +1,68 @@
+//***************************************************************************************
+// BillboardSet.h
+//
+// Many camera-facing quads (trees, grass clumps, ...) drawn with a single draw call.
+// Each billboard is one 24-byte record in a structured buffer, so 100k of them take
+// about 2.4 MB.  There is no vertex or index buffer: Draw() issues six vertices per
+// billboard and the vertex shader pulls record SV_VertexID / 6 and expands it into
+// the corner SV_VertexID % 6, facing the eye about the world y axis.
+//
+// The shader side is expected to declare
+//
+//   struct Billboard { float3 PosW; float2 Size; uint Slice; };
+//   StructuredBuffer<Billboard> gBillboards;     // root SRV
+//   cbuffer cbBillboard { float gFadeStart; float gFadeEnd; };  // 2 root constants
+//
+// and sample a Texture2DArray with Slice.  Billboards past gFadeEnd should be moved
+// outside the clip volume so they cost no rasterization; between gFadeStart and
+// gFadeEnd they dissolve instead of popping.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+// Must match struct Billboard in the shader.
+struct Billboard
+{
+	// Bottom center; the quad extends Size.y upwards.
+	DirectX::XMFLOAT3 Position = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT2 Size = { 1.0f, 1.0f };
+
+	// Slice of the texture array.
+	UINT Slice = 0;
+};
+
+class BillboardSet
+{
+public:
+	// The copy into the default heap buffer is recorded on cmdList; call
+	// DisposeUploader() once it has executed.
+	BillboardSet(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList,
+		const std::vector<Billboard>& billboards);
+	BillboardSet(const BillboardSet& rhs) = delete;
+	BillboardSet& operator=(const BillboardSet& rhs) = delete;
+	~BillboardSet() = default;
+
+	UINT Count()const;
+	UINT64 ByteSize()const;
+
+	// Distance from the eye where billboards start to dissolve, and where they are gone.
+	void SetFadeDistances(float fadeStart, float fadeEnd);
+
+	// Binds the buffer as a root SRV and the fade distances as two root constants at
+	// the given root parameters, then draws every billboard as a triangle list.  The
+	// caller sets the PSO, the texture array and any other constants.
+	void Draw(ID3D12GraphicsCommandList* cmdList, UINT srvRootParameter, UINT constantsRootParameter)const;
+
+	void DisposeUploader();
+
+private:
+	UINT mCount = 0;
+
+	float mFadeStart = 100.0f;
+	float mFadeEnd = 150.0f;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mBuffer = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mUploader = nullptr;
+};
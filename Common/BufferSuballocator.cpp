@@ -0,0 +1,100 @@
+//***************************************************************************************
+// BufferSuballocator.cpp
+//***************************************************************************************
+
+#include "BufferSuballocator.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	UINT64 AlignUp(UINT64 value, UINT64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+BufferSuballocator::BufferSuballocator(ID3D12Device* device, UINT64 pageSize) :
+	md3dDevice(device),
+	mPageSize(AlignUp(pageSize, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT))
+{
+}
+
+BufferAllocation BufferSuballocator::Allocate(UINT64 byteSize, UINT64 alignment)
+{
+	assert(byteSize > 0);
+	assert((alignment & (alignment - 1)) == 0);
+
+	// First fit.  There are only ever a handful of pages.
+	Page* page = nullptr;
+	UINT64 offset = 0;
+	for(auto& p : mPages)
+	{
+		offset = AlignUp(p.Offset, alignment);
+		if(offset + byteSize <= p.Size)
+		{
+			page = &p;
+			break;
+		}
+	}
+
+	if(page == nullptr)
+	{
+		CreatePage(byteSize);
+		page = &mPages.back();
+		offset = 0;
+	}
+
+	page->Offset = offset + byteSize;
+	mUsed += byteSize;
+
+	BufferAllocation allocation;
+	allocation.Resource = page->Buffer.Get();
+	allocation.GPU = page->Buffer->GetGPUVirtualAddress() + offset;
+	allocation.Offset = offset;
+	allocation.Size = byteSize;
+
+	return allocation;
+}
+
+void BufferSuballocator::CreatePage(UINT64 byteSize)
+{
+	Page page;
+	page.Size = byteSize > mPageSize ?
+		AlignUp(byteSize, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT) : mPageSize;
+
+	CD3DX12_HEAP_DESC heapDesc(page.Size, D3D12_HEAP_TYPE_DEFAULT, 0, D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS);
+	ThrowIfFailed(md3dDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(page.Heap.GetAddressOf())));
+
+	// Buffers are promoted out of COMMON implicitly (to COPY_DEST for the upload,
+	// then to the vertex/index buffer states), so no barriers are ever needed.
+	ThrowIfFailed(md3dDevice->CreatePlacedResource(
+		page.Heap.Get(),
+		0,
+		&CD3DX12_RESOURCE_DESC::Buffer(page.Size),
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(page.Buffer.GetAddressOf())));
+	GpuMemory::Track(page.Buffer.Get(), MemoryCategory::Geometry);
+
+	mPages.push_back(page);
+}
+
+UINT BufferSuballocator::PageCount()const
+{
+	return (UINT)mPages.size();
+}
+
+UINT64 BufferSuballocator::Used()const
+{
+	return mUsed;
+}
+
+UINT64 BufferSuballocator::Reserved()const
+{
+	UINT64 reserved = 0;
+	for(const auto& p : mPages)
+		reserved += p.Size;
+
+	return reserved;
+}
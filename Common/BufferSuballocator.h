@@ -0,0 +1,58 @@
+//***************************************************************************************
+// BufferSuballocator.h
+//
+// Carves static vertex/index buffers out of a few large default heaps instead of
+// creating a committed resource per buffer.  Each page is an ID3D12Heap with one
+// placed buffer spanning all of it; an allocation is a byte range of that buffer,
+// so MeshGeometry keeps the page buffer plus VertexBufferOffset/IndexBufferOffset.
+//
+// Allocations are never freed individually.  A page is released when the
+// allocator and every MeshGeometry referencing its buffer are gone.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+struct BufferAllocation
+{
+	ID3D12Resource* Resource = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS GPU = 0;
+	UINT64 Offset = 0;
+	UINT64 Size = 0;
+};
+
+class BufferSuballocator
+{
+public:
+	BufferSuballocator(ID3D12Device* device, UINT64 pageSize = 16 * 1024 * 1024);
+	BufferSuballocator(const BufferSuballocator& rhs) = delete;
+	BufferSuballocator& operator=(const BufferSuballocator& rhs) = delete;
+	~BufferSuballocator() = default;
+
+	// alignment must be a power of two.  Requests larger than the page size get a
+	// page of their own.  Not thread safe.
+	BufferAllocation Allocate(UINT64 byteSize, UINT64 alignment = 256);
+
+	UINT PageCount()const;
+	UINT64 Used()const;
+	UINT64 Reserved()const;
+
+private:
+	struct Page
+	{
+		Microsoft::WRL::ComPtr<ID3D12Heap> Heap;
+		Microsoft::WRL::ComPtr<ID3D12Resource> Buffer;
+		UINT64 Size = 0;
+		UINT64 Offset = 0;
+	};
+
+	void CreatePage(UINT64 byteSize);
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+	UINT64 mPageSize = 0;
+	UINT64 mUsed = 0;
+
+	std::vector<Page> mPages;
+};
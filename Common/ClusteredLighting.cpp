@@ -0,0 +1,158 @@
+//***************************************************************************************
+// ClusteredLighting.cpp
+//***************************************************************************************
+
+#include "ClusteredLighting.h"
+
+using Microsoft::WRL::ComPtr;
+using namespace DirectX;
+
+ClusteredLighting::ClusteredLighting(ID3D12Device* device, UINT width, UINT height,
+	const std::wstring& shaderFile)
+{
+	md3dDevice = device;
+
+	BuildRootSignature();
+	BuildPso(shaderFile);
+	OnResize(width, height);
+}
+
+void ClusteredLighting::OnResize(UINT width, UINT height)
+{
+	mWidth = (std::max)(width, 1u);
+	mHeight = (std::max)(height, 1u);
+	mGridX = (mWidth + TileSize - 1) / TileSize;
+	mGridY = (mHeight + TileSize - 1) / TileSize;
+
+	const UINT64 byteSize = (UINT64)ClusterCount() * (MaxLightsPerCluster + 1) * sizeof(UINT);
+
+	CD3DX12_HEAP_PROPERTIES defaultHeap(D3D12_HEAP_TYPE_DEFAULT);
+	CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize,
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+
+	mClusterLists = nullptr;
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&defaultHeap,
+		D3D12_HEAP_FLAG_NONE,
+		&bufferDesc,
+		D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+		nullptr,
+		IID_PPV_ARGS(mClusterLists.GetAddressOf())));
+	GpuMemory::Track(mClusterLists.Get(), MemoryCategory::Other);
+}
+
+UINT64 ClusteredLighting::UploadByteSize(UINT lightCount)
+{
+	const UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+	return d3dUtil::CalcConstantBufferByteSize(sizeof(ClusterConstants)) +
+		(UINT64)(std::max)(lightCount, 1u) * sizeof(Light) + 2 * alignment;
+}
+
+UINT ClusteredLighting::ClusterCount()const
+{
+	return mGridX * mGridY * DepthSlices;
+}
+
+void ClusteredLighting::BuildRootSignature()
+{
+	CD3DX12_ROOT_PARAMETER slotRootParameter[3];
+	slotRootParameter[0].InitAsConstantBufferView(4);
+	slotRootParameter[1].InitAsShaderResourceView(3);
+	slotRootParameter[2].InitAsUnorderedAccessView(0);
+
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(3, slotRootParameter,
+		0, nullptr,
+		D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+	ComPtr<ID3DBlob> serializedRootSig = nullptr;
+	ComPtr<ID3DBlob> errorBlob = nullptr;
+	HRESULT hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1,
+		serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
+
+	if (errorBlob != nullptr)
+	{
+		::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+	}
+	ThrowIfFailed(hr);
+
+	ThrowIfFailed(md3dDevice->CreateRootSignature(
+		0,
+		serializedRootSig->GetBufferPointer(),
+		serializedRootSig->GetBufferSize(),
+		IID_PPV_ARGS(mRootSignature.GetAddressOf())));
+}
+
+void ClusteredLighting::BuildPso(const std::wstring& shaderFile)
+{
+	ComPtr<ID3DBlob> cs = d3dUtil::CompileShader(shaderFile, nullptr, "BuildClustersCS", "cs_5_0");
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
+	psoDesc.pRootSignature = mRootSignature.Get();
+	psoDesc.CS =
+	{
+		reinterpret_cast<BYTE*>(cs->GetBufferPointer()),
+		cs->GetBufferSize()
+	};
+	psoDesc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+	ThrowIfFailed(md3dDevice->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(mPso.GetAddressOf())));
+}
+
+void ClusteredLighting::Build(ID3D12GraphicsCommandList* cmdList, LinearUploadAllocator& upload,
+	const XMFLOAT4X4& view, const XMFLOAT4X4& proj, float nearZ, float farZ,
+	const std::vector<Light>& pointLights, const std::vector<Light>& spotLights)
+{
+	XMMATRIX V = XMLoadFloat4x4(&view);
+	XMMATRIX P = XMLoadFloat4x4(&proj);
+	XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(P), P);
+
+	// slice = log(z) * SliceScale + SliceBias maps [nearZ, farZ] to [0, DepthSlices].
+	const float logDepthRange = logf(farZ / nearZ);
+
+	ClusterConstants constants;
+	XMStoreFloat4x4(&constants.View, XMMatrixTranspose(V));
+	XMStoreFloat4x4(&constants.InvProj, XMMatrixTranspose(invProj));
+	constants.Grid = XMUINT3(mGridX, mGridY, DepthSlices);
+	constants.PointLightCount = (UINT)pointLights.size();
+	constants.ScreenSize = XMFLOAT2((float)mWidth, (float)mHeight);
+	constants.SliceScale = DepthSlices / logDepthRange;
+	constants.SliceBias = -DepthSlices * logf(nearZ) / logDepthRange;
+	constants.SpotLightCount = (UINT)spotLights.size();
+
+	UploadAllocation cb = upload.Allocate(d3dUtil::CalcConstantBufferByteSize(sizeof(ClusterConstants)));
+	memcpy(cb.CPU, &constants, sizeof(ClusterConstants));
+	mConstants = cb.GPU;
+
+	// Never empty, so the root SRV always points at a valid buffer.
+	const size_t lightCount = pointLights.size() + spotLights.size();
+	UploadAllocation lights = upload.Allocate((std::max)(lightCount, (size_t)1) * sizeof(Light));
+	Light* mappedLights = reinterpret_cast<Light*>(lights.CPU);
+	std::copy(pointLights.begin(), pointLights.end(), mappedLights);
+	std::copy(spotLights.begin(), spotLights.end(), mappedLights + pointLights.size());
+	mLights = lights.GPU;
+
+	const D3D12_RESOURCE_STATES readState =
+		D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mClusterLists.Get(),
+		readState, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+
+	cmdList->SetComputeRootSignature(mRootSignature.Get());
+	cmdList->SetPipelineState(mPso.Get());
+	cmdList->SetComputeRootConstantBufferView(0, mConstants);
+	cmdList->SetComputeRootShaderResourceView(1, mLights);
+	cmdList->SetComputeRootUnorderedAccessView(2, mClusterLists->GetGPUVirtualAddress());
+
+	// One thread per cluster, 8x8 tiles per group.
+	cmdList->Dispatch((mGridX + 7) / 8, (mGridY + 7) / 8, DepthSlices);
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mClusterLists.Get(),
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS, readState));
+}
+
+void ClusteredLighting::Bind(ID3D12GraphicsCommandList* cmdList,
+	UINT constantsRootParameter, UINT lightsRootParameter, UINT listsRootParameter)const
+{
+	cmdList->SetGraphicsRootConstantBufferView(constantsRootParameter, mConstants);
+	cmdList->SetGraphicsRootShaderResourceView(lightsRootParameter, mLights);
+	cmdList->SetGraphicsRootShaderResourceView(listsRootParameter, mClusterLists->GetGPUVirtualAddress());
+}
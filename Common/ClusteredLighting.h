@@ -0,0 +1,94 @@
+//***************************************************************************************
+// ClusteredLighting.h
+//
+// Clustered forward shading for any number of point and spot lights.  The view
+// frustum is split into 64x64 pixel tiles and 16 exponentially spaced depth slices;
+// every frame a compute pass (Shader/LightClusters.hlsl) writes, per cluster, the
+// lights that can reach it.  A pixel shader that includes ClusteredLighting.hlsl
+// then shades only its own cluster's lights, so the cost per pixel follows the
+// lights around it instead of the lights in the scene.
+//
+// The lights are copied into the frame's upload memory as a structured buffer, so
+// there is no MaxLights cap; each cluster keeps at most MaxLightsPerCluster of them.
+// The directional lights stay in the pass constants.
+//
+// The pixel shader reads the resources through three root parameters of the
+// caller's root signature, set by Bind():
+//   root CBV b4 (cluster constants), root SRV t3 (lights), root SRV t4 (cluster lists)
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "LinearUploadAllocator.h"
+
+class ClusteredLighting
+{
+public:
+	// Must match ClusteredLighting.hlsl.
+	static const UINT TileSize = 64;
+	static const UINT DepthSlices = 16;
+	static const UINT MaxLightsPerCluster = 63;
+
+	ClusteredLighting(ID3D12Device* device, UINT width, UINT height,
+		const std::wstring& shaderFile = L"../../Shader/LightClusters.hlsl");
+	ClusteredLighting(const ClusteredLighting& rhs) = delete;
+	ClusteredLighting& operator=(const ClusteredLighting& rhs) = delete;
+	~ClusteredLighting() = default;
+
+	// Recreates the cluster lists for a new render target size.  The GPU must be
+	// done with the old ones.
+	void OnResize(UINT width, UINT height);
+
+	// Upload memory Build() takes from the frame's allocator for lightCount lights.
+	static UINT64 UploadByteSize(UINT lightCount);
+
+	UINT ClusterCount()const;
+
+	// Copies the lights into upload memory and records the culling dispatch on
+	// cmdList, which replaces the compute root signature and the PSO.  view and proj
+	// are the untransposed camera matrices; nearZ and farZ those of proj.
+	void Build(ID3D12GraphicsCommandList* cmdList, LinearUploadAllocator& upload,
+		const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& proj, float nearZ, float farZ,
+		const std::vector<Light>& pointLights, const std::vector<Light>& spotLights);
+
+	// Binds what the last Build() produced for the pixel shader.
+	void Bind(ID3D12GraphicsCommandList* cmdList,
+		UINT constantsRootParameter, UINT lightsRootParameter, UINT listsRootParameter)const;
+
+private:
+	// Must match cbClusters in ClusteredLighting.hlsl.
+	struct ClusterConstants
+	{
+		DirectX::XMFLOAT4X4 View = MathHelper::Identity4x4();
+		DirectX::XMFLOAT4X4 InvProj = MathHelper::Identity4x4();
+		DirectX::XMUINT3 Grid = { 0, 0, 0 };
+		UINT PointLightCount = 0;
+		DirectX::XMFLOAT2 ScreenSize = { 0.0f, 0.0f };
+		float SliceScale = 0.0f;
+		float SliceBias = 0.0f;
+		UINT SpotLightCount = 0;
+		DirectX::XMFLOAT3 Pad = { 0.0f, 0.0f, 0.0f };
+	};
+
+	void BuildRootSignature();
+	void BuildPso(const std::wstring& shaderFile);
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+
+	UINT mWidth = 0;
+	UINT mHeight = 0;
+	UINT mGridX = 0;
+	UINT mGridY = 0;
+
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> mPso = nullptr;
+
+	// Per cluster: the light count, then MaxLightsPerCluster indices.  Kept in a
+	// shader resource state between builds.
+	Microsoft::WRL::ComPtr<ID3D12Resource> mClusterLists = nullptr;
+
+	D3D12_GPU_VIRTUAL_ADDRESS mConstants = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS mLights = 0;
+};
@@ -0,0 +1,182 @@
+//***************************************************************************************
+// CpuProfiler.cpp
+//***************************************************************************************
+
+#include "CpuProfiler.h"
+
+#if CPU_PROFILER_ENABLED
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	// Per-thread capacity; at a few dozen scopes per frame this holds hundreds of frames.
+	const uint32_t EventCapacity = 1u << 16;
+	const uint32_t FrameCapacity = 1u << 10;
+
+	struct ScopeEvent
+	{
+		const char* Name;
+		int64_t Start;
+		int64_t End;
+	};
+
+	// Written by its owning thread only.  Count is published after the event is
+	// stored, so a reader sees complete events; a reader racing a thread that laps
+	// the whole ring can still see overwritten entries, which only affects that dump.
+	struct ThreadEvents
+	{
+		DWORD ThreadId = 0;
+		std::unique_ptr<ScopeEvent[]> Events{ new ScopeEvent[EventCapacity] };
+		std::atomic<uint32_t> Count{ 0 };
+	};
+
+	struct ProfilerState
+	{
+		// Only grows, under Mutex; threads keep a pointer to their own entry.
+		std::mutex Mutex;
+		std::vector<std::unique_ptr<ThreadEvents>> Threads;
+
+		int64_t FrameStarts[FrameCapacity] = {};
+		std::atomic<uint32_t> FrameCount{ 0 };
+	};
+
+	ProfilerState& State()
+	{
+		static ProfilerState state;
+		return state;
+	}
+
+	ThreadEvents& LocalEvents()
+	{
+		thread_local ThreadEvents* events = nullptr;
+		if (events == nullptr)
+		{
+			auto newEvents = std::make_unique<ThreadEvents>();
+			newEvents->ThreadId = GetCurrentThreadId();
+			events = newEvents.get();
+
+			ProfilerState& state = State();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			state.Threads.push_back(std::move(newEvents));
+		}
+		return *events;
+	}
+}
+
+void CpuProfiler::Record(const char* name, int64_t start, int64_t end)
+{
+	ThreadEvents& events = LocalEvents();
+
+	uint32_t count = events.Count.load(std::memory_order_relaxed);
+	ScopeEvent& e = events.Events[count % EventCapacity];
+	e.Name = name;
+	e.Start = start;
+	e.End = end;
+
+	events.Count.store(count + 1, std::memory_order_release);
+}
+
+void CpuProfiler::BeginFrame()
+{
+	ProfilerState& state = State();
+
+	uint32_t frame = state.FrameCount.load(std::memory_order_relaxed);
+	state.FrameStarts[frame % FrameCapacity] = Now();
+	state.FrameCount.store(frame + 1, std::memory_order_release);
+}
+
+bool CpuProfiler::DumpChromeTrace(const std::wstring& filename, UINT frameCount)
+{
+	ProfilerState& state = State();
+
+	// Scopes that started before the oldest requested frame are left out.
+	uint32_t frames = state.FrameCount.load(std::memory_order_acquire);
+	uint32_t available = frames < FrameCapacity ? frames : FrameCapacity;
+	if (frameCount > available)
+		frameCount = available;
+	int64_t cutoff = frameCount > 0 ? state.FrameStarts[(frames - frameCount) % FrameCapacity] : 0;
+
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	const double ticksToUs = 1000000.0 / (double)frequency.QuadPart;
+
+	std::ofstream fout(filename, std::ios::trunc);
+	if (!fout)
+		return false;
+
+	fout << "{\"traceEvents\":[\n";
+	bool first = true;
+
+	std::lock_guard<std::mutex> lock(state.Mutex);
+	for (const auto& thread : state.Threads)
+	{
+		uint32_t count = thread->Count.load(std::memory_order_acquire);
+		uint32_t begin = count > EventCapacity ? count - EventCapacity : 0;
+
+		for (uint32_t i = begin; i < count; ++i)
+		{
+			const ScopeEvent& e = thread->Events[i % EventCapacity];
+			if (e.Start < cutoff)
+				continue;
+
+			if (!first)
+				fout << ",\n";
+			first = false;
+
+			// Complete events ("X") with microsecond timestamps.
+			fout << "{\"name\":\"" << e.Name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << thread->ThreadId
+				<< ",\"ts\":" << (uint64_t)((e.Start - cutoff) * ticksToUs)
+				<< ",\"dur\":" << (uint64_t)((e.End - e.Start) * ticksToUs) << "}";
+		}
+	}
+
+	fout << "\n]}\n";
+	return fout.good();
+}
+
+std::vector<std::pair<const char*, float>> CpuProfiler::ScopeTimesSince(int64_t since)
+{
+	ProfilerState& state = State();
+
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	const double ticksToMs = 1000.0 / (double)frequency.QuadPart;
+
+	std::vector<std::pair<const char*, float>> times;
+
+	std::lock_guard<std::mutex> lock(state.Mutex);
+	for (const auto& thread : state.Threads)
+	{
+		uint32_t count = thread->Count.load(std::memory_order_acquire);
+		uint32_t begin = count > EventCapacity ? count - EventCapacity : 0;
+
+		// A thread records its scopes as they end, so walk back until one ended earlier.
+		for (uint32_t i = count; i > begin; --i)
+		{
+			const ScopeEvent& e = thread->Events[(i - 1) % EventCapacity];
+			if (e.End <= since)
+				break;
+
+			// The same literal may have different addresses in different modules.
+			auto it = std::find_if(times.begin(), times.end(),
+				[&](const std::pair<const char*, float>& t) { return std::strcmp(t.first, e.Name) == 0; });
+			float ms = (float)((e.End - e.Start) * ticksToMs);
+			if (it != times.end())
+				it->second += ms;
+			else
+				times.push_back(std::make_pair(e.Name, ms));
+		}
+	}
+
+	std::sort(times.begin(), times.end(),
+		[](const std::pair<const char*, float>& a, const std::pair<const char*, float>& b) { return a.second > b.second; });
+	return times;
+}
+
+#endif
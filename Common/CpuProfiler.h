@@ -0,0 +1,95 @@
+//***************************************************************************************
+// CpuProfiler.h
+//
+// Scoped CPU timers that can be dumped as a Chrome trace (chrome://tracing or
+// https://ui.perfetto.dev).
+//
+//     CPU_PROFILE_SCOPE("UpdateObjectCBs");   // times the rest of the enclosing block
+//     CPU_PROFILE_FRAME();                    // marks the start of a frame (D3DApp::Run)
+//
+// Every thread records into its own ring buffer, which only that thread writes, so
+// timing a scope costs two QueryPerformanceCounter calls and a store -- no locks.
+// CpuProfiler::DumpChromeTrace() writes the scopes of the last N frames; D3DApp
+// calls it when F3 is pressed.  ScopeTimesSince() sums the recent scopes by name,
+// which is what FrameTelemetry records for a hitch.
+//
+// Compiled in for debug builds, or when CPU_PROFILER is defined.  Otherwise the
+// macros expand to nothing and none of this code exists.
+//***************************************************************************************
+
+#pragma once
+
+#if defined(DEBUG) || defined(_DEBUG) || defined(CPU_PROFILER)
+#define CPU_PROFILER_ENABLED 1
+#else
+#define CPU_PROFILER_ENABLED 0
+#endif
+
+#if CPU_PROFILER_ENABLED
+
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define CPU_PROFILE_CONCAT_INNER(a, b) a##b
+#define CPU_PROFILE_CONCAT(a, b) CPU_PROFILE_CONCAT_INNER(a, b)
+
+// name must be a string literal (or otherwise outlive the dump).
+#define CPU_PROFILE_SCOPE(name) CpuProfileScope CPU_PROFILE_CONCAT(cpuProfileScope, __LINE__)(name)
+#define CPU_PROFILE_FRAME() CpuProfiler::BeginFrame()
+
+class CpuProfiler
+{
+public:
+	// Records a completed scope on the calling thread.
+	static void Record(const char* name, int64_t start, int64_t end);
+
+	// Marks the start of a frame.  Call from one thread only.
+	static void BeginFrame();
+
+	// Writes the scopes of the last frameCount frames, from every thread, as Chrome
+	// trace_event JSON.  Returns false if the file cannot be written.
+	static bool DumpChromeTrace(const std::wstring& filename, UINT frameCount);
+
+	// Milliseconds per scope name of the scopes, from every thread, that ended after
+	// since (a Now() value), slowest first.  Nested scopes count in their parents too.
+	static std::vector<std::pair<const char*, float>> ScopeTimesSince(int64_t since);
+
+	static int64_t Now()
+	{
+		LARGE_INTEGER time;
+		QueryPerformanceCounter(&time);
+		return time.QuadPart;
+	}
+};
+
+class CpuProfileScope
+{
+public:
+	explicit CpuProfileScope(const char* name) :
+		mName(name), mStart(CpuProfiler::Now())
+	{
+	}
+
+	CpuProfileScope(const CpuProfileScope& rhs) = delete;
+	CpuProfileScope& operator=(const CpuProfileScope& rhs) = delete;
+
+	~CpuProfileScope()
+	{
+		CpuProfiler::Record(mName, mStart, CpuProfiler::Now());
+	}
+
+private:
+	const char* mName;
+	int64_t mStart;
+};
+
+#else
+
+#define CPU_PROFILE_SCOPE(name)
+#define CPU_PROFILE_FRAME()
+
+#endif
@@ -24,6 +24,7 @@
 #include <wrl.h>
 
 #include "DDSTextureLoader.h" 
+#include "GpuMemory.h"
 
 using namespace Microsoft::WRL;
 
@@ -1241,7 +1242,8 @@ static HRESULT CreateD3DResources12(
 	_In_ bool isCubeMap,
 	_In_reads_opt_(mipCount*arraySize) D3D12_SUBRESOURCE_DATA* initData,
 	ComPtr<ID3D12Resource>& texture,
-	ComPtr<ID3D12Resource>& textureUploadHeap
+	ComPtr<ID3D12Resource>& textureUploadHeap,
+	_In_ D3D12_RESOURCE_STATES finalState
 	)
 {
 	if (device == nullptr)
@@ -1302,14 +1304,22 @@ static HRESULT CreateD3DResources12(
 			}
 			else
 			{
+				GpuMemory::Track(texture.Get(), MemoryCategory::Texture);
+				GpuMemory::Track(textureUploadHeap.Get(), MemoryCategory::Upload);
+
 				cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
 					D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST));
 
 				// Use Heap-allocating UpdateSubresources implementation for variable number of subresources (which is the case for textures).
 				UpdateSubresources(cmdList, texture.Get(), textureUploadHeap.Get(), 0, 0, num2DSubresources, initData);
 
-				cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
-					D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+				// Copy queues can only transition to COMMON/COPY states; the caller
+				// picks COMMON there and relies on implicit promotion afterwards.
+				if (finalState != D3D12_RESOURCE_STATE_COPY_DEST)
+				{
+					cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
+						D3D12_RESOURCE_STATE_COPY_DEST, finalState));
+				}
 			}
 		}
 	} break;
@@ -1678,7 +1688,8 @@ static HRESULT CreateTextureFromDDS12(
 	_In_ size_t maxsize,
 	_In_ bool forceSRGB,
 	ComPtr<ID3D12Resource>& texture,
-	ComPtr<ID3D12Resource>& textureUploadHeap)
+	ComPtr<ID3D12Resource>& textureUploadHeap,
+	_In_ D3D12_RESOURCE_STATES finalState)
 {
 	HRESULT hr = S_OK;
 
@@ -1867,7 +1878,8 @@ static HRESULT CreateTextureFromDDS12(
 			isCubeMap,
 			initData.get(),
 			texture, 
-			textureUploadHeap);
+			textureUploadHeap,
+			finalState);
 	}
 
 	return hr;
@@ -1926,7 +1938,8 @@ HRESULT DirectX::CreateDDSTextureFromMemory12(
 	ComPtr<ID3D12Resource>& texture,
 	ComPtr<ID3D12Resource>& textureUploadHeap,
 	_In_ size_t maxsize,
-	_Out_opt_ DDS_ALPHA_MODE* alphaMode
+	_Out_opt_ DDS_ALPHA_MODE* alphaMode,
+	_In_ D3D12_RESOURCE_STATES finalState
 	)
 {
 	if (alphaMode)
@@ -1979,7 +1992,8 @@ HRESULT DirectX::CreateDDSTextureFromMemory12(
 		maxsize,
 		false,
 		texture,
-		textureUploadHeap
+		textureUploadHeap,
+		finalState
 		);
 
 	if (SUCCEEDED(hr))
@@ -2172,7 +2186,8 @@ HRESULT DirectX::CreateDDSTextureFromFile12(_In_ ID3D12Device* device,
 	}
 
 	hr = CreateTextureFromDDS12(device, cmdList, header,
-		bitData, bitSize, maxsize, false, texture, textureUploadHeap);
+		bitData, bitSize, maxsize, false, texture, textureUploadHeap,
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 
 	if (SUCCEEDED(hr))
 	{
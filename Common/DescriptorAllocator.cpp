@@ -0,0 +1,172 @@
+//***************************************************************************************
+// DescriptorAllocator.cpp
+//***************************************************************************************
+
+#include "DescriptorAllocator.h"
+#include <algorithm>
+
+DescriptorAllocator::DescriptorAllocator(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, UINT count)
+{
+	mType = type;
+	mShaderVisible = type == D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV || type == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER;
+	if (count == 0)
+		throw DxException(E_INVALIDARG, L"DescriptorAllocator count", AnsiToWString(__FILE__), __LINE__);
+
+	mCount = count;
+	mDescriptorSize = device->GetDescriptorHandleIncrementSize(type);
+
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc;
+	heapDesc.NumDescriptors = count;
+	heapDesc.Type = type;
+	heapDesc.Flags = mShaderVisible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	heapDesc.NodeMask = 0;
+	ThrowIfFailed(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(mHeap.GetAddressOf())));
+
+	Range all;
+	all.First = 0;
+	all.Count = count;
+	mFreeRanges.push_back(all);
+}
+
+DescriptorAllocation DescriptorAllocator::Allocate(UINT count)
+{
+	for (size_t i = 0; i < mFreeRanges.size(); ++i)
+	{
+		Range& range = mFreeRanges[i];
+		if (range.Count < count)
+			continue;
+
+		UINT first = range.First;
+		range.First += count;
+		range.Count -= count;
+		if (range.Count == 0)
+			mFreeRanges.erase(mFreeRanges.begin() + i);
+
+		mInUse += count;
+		return MakeAllocation(first, count);
+	}
+
+	throw DxException(E_OUTOFMEMORY, L"DescriptorAllocator::Allocate", AnsiToWString(__FILE__), __LINE__);
+}
+
+void DescriptorAllocator::Free(const DescriptorAllocation& allocation)
+{
+	if (allocation.IsNull())
+		return;
+
+	Range range;
+	range.First = allocation.Index;
+	range.Count = allocation.Count;
+	FreeRange(range);
+}
+
+void DescriptorAllocator::FreeDeferred(const DescriptorAllocation& allocation, UINT64 fenceValue)
+{
+	if (allocation.IsNull())
+		return;
+
+	DeferredFree deferred;
+	deferred.Freed.First = allocation.Index;
+	deferred.Freed.Count = allocation.Count;
+	deferred.FenceValue = fenceValue;
+	mDeferredFrees.push_back(deferred);
+}
+
+void DescriptorAllocator::ReleaseCompleted(UINT64 completedFenceValue)
+{
+	// Deferred frees come in any fence order, so all of them are checked.
+	for (size_t i = 0; i < mDeferredFrees.size();)
+	{
+		if (mDeferredFrees[i].FenceValue <= completedFenceValue)
+		{
+			FreeRange(mDeferredFrees[i].Freed);
+			mDeferredFrees[i] = mDeferredFrees.back();
+			mDeferredFrees.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+ID3D12DescriptorHeap* DescriptorAllocator::Heap()const
+{
+	return mHeap.Get();
+}
+
+D3D12_DESCRIPTOR_HEAP_TYPE DescriptorAllocator::Type()const
+{
+	return mType;
+}
+
+UINT DescriptorAllocator::DescriptorSize()const
+{
+	return mDescriptorSize;
+}
+
+CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorAllocator::CpuHandle(UINT index)const
+{
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(mHeap->GetCPUDescriptorHandleForHeapStart(), index, mDescriptorSize);
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorAllocator::GpuHandle(UINT index)const
+{
+	if (!mShaderVisible)
+		return CD3DX12_GPU_DESCRIPTOR_HANDLE(D3D12_DEFAULT);
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(mHeap->GetGPUDescriptorHandleForHeapStart(), index, mDescriptorSize);
+}
+
+UINT DescriptorAllocator::Count()const
+{
+	return mCount;
+}
+
+UINT DescriptorAllocator::InUse()const
+{
+	return mInUse;
+}
+
+DescriptorAllocation DescriptorAllocator::MakeAllocation(UINT first, UINT count)const
+{
+	DescriptorAllocation allocation;
+	allocation.CPU = CpuHandle(first);
+	allocation.GPU = GpuHandle(first);
+	allocation.Index = first;
+	allocation.Count = count;
+	return allocation;
+}
+
+void DescriptorAllocator::FreeRange(Range range)
+{
+	mInUse -= range.Count;
+
+	auto next = std::lower_bound(mFreeRanges.begin(), mFreeRanges.end(), range,
+		[](const Range& a, const Range& b) { return a.First < b.First; });
+
+	// Merge with the free range that ends where this one starts, then with the one
+	// that starts where it ends.
+	if (next != mFreeRanges.begin())
+	{
+		auto prev = next - 1;
+		if (prev->First + prev->Count == range.First)
+		{
+			prev->Count += range.Count;
+			if (next != mFreeRanges.end() && prev->First + prev->Count == next->First)
+			{
+				prev->Count += next->Count;
+				mFreeRanges.erase(next);
+			}
+			return;
+		}
+	}
+
+	if (next != mFreeRanges.end() && range.First + range.Count == next->First)
+	{
+		next->First = range.First;
+		next->Count += range.Count;
+		return;
+	}
+
+	mFreeRanges.insert(next, range);
+}
@@ -0,0 +1,93 @@
+//***************************************************************************************
+// DescriptorAllocator.h
+//
+// One descriptor heap handing out contiguous ranges from a first-fit free list, for
+// views that live as long as their resource (textures, render targets).  Free()
+// returns a range at once, FreeDeferred() once a fence value has completed, so a
+// streamed texture can drop its SRV as soon as it is evicted without waiting for
+// the frames still reading it.
+//
+// Not thread safe: allocate and release on one thread, or between the frame's
+// worker jobs.
+//
+//     heap.ReleaseCompleted(fence->GetCompletedValue());  // start of the frame
+//     ...
+//     heap.FreeDeferred(srv, lastFenceUsingSrv);
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+struct DescriptorAllocation
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE CPU = { 0 };
+	D3D12_GPU_DESCRIPTOR_HANDLE GPU = { 0 };   // zero in non shader-visible heaps
+
+	// Position in the heap, e.g. for a bindless index into a table at its start.
+	UINT Index = 0;
+	UINT Count = 0;
+
+	bool IsNull()const { return Count == 0; }
+};
+
+class DescriptorAllocator
+{
+public:
+	DescriptorAllocator(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, UINT count);
+	DescriptorAllocator(const DescriptorAllocator& rhs) = delete;
+	DescriptorAllocator& operator=(const DescriptorAllocator& rhs) = delete;
+	~DescriptorAllocator() = default;
+
+	// count contiguous descriptors.  Throws DxException(E_OUTOFMEMORY) when no free
+	// range is large enough.
+	DescriptorAllocation Allocate(UINT count = 1);
+
+	// The GPU must be done with the descriptors.
+	void Free(const DescriptorAllocation& allocation);
+
+	// Returned by the first ReleaseCompleted() that sees fenceValue completed.
+	void FreeDeferred(const DescriptorAllocation& allocation, UINT64 fenceValue);
+
+	// Returns the deferred frees whose fence completed.
+	void ReleaseCompleted(UINT64 completedFenceValue);
+
+	ID3D12DescriptorHeap* Heap()const;
+	D3D12_DESCRIPTOR_HEAP_TYPE Type()const;
+	UINT DescriptorSize()const;
+
+	CD3DX12_CPU_DESCRIPTOR_HANDLE CpuHandle(UINT index)const;
+	CD3DX12_GPU_DESCRIPTOR_HANDLE GpuHandle(UINT index)const;
+
+	UINT Count()const;
+	UINT InUse()const;
+
+private:
+	struct Range
+	{
+		UINT First = 0;
+		UINT Count = 0;
+	};
+
+	struct DeferredFree
+	{
+		Range Freed;
+		UINT64 FenceValue = 0;
+	};
+
+	DescriptorAllocation MakeAllocation(UINT first, UINT count)const;
+	void FreeRange(Range range);
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mHeap;
+	D3D12_DESCRIPTOR_HEAP_TYPE mType = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	bool mShaderVisible = false;
+	UINT mDescriptorSize = 0;
+
+	UINT mCount = 0;
+	UINT mInUse = 0;
+
+	// Sorted by First, never adjacent: neighbours are merged on free.
+	std::vector<Range> mFreeRanges;
+	std::vector<DeferredFree> mDeferredFrees;
+};
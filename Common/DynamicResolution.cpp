@@ -0,0 +1,240 @@
+//***************************************************************************************
+// DynamicResolution.cpp
+//***************************************************************************************
+
+#include "DynamicResolution.h"
+
+using Microsoft::WRL::ComPtr;
+using namespace DirectX;
+
+DynamicResolution::DynamicResolution(ID3D12Device* device, UINT width, UINT height, DXGI_FORMAT format,
+	const XMFLOAT4& clearColor, UINT frameCount, const std::wstring& shaderFile)
+{
+	md3dDevice = device;
+	mFormat = format;
+	mClearColor = clearColor;
+
+	BuildDescriptorHeap(frameCount);
+	BuildRootSignature();
+	BuildPso(shaderFile);
+	OnResize(width, height);
+}
+
+void DynamicResolution::OnResize(UINT width, UINT height)
+{
+	mWidth = (std::max)(width, 1u);
+	mHeight = (std::max)(height, 1u);
+}
+
+void DynamicResolution::SetBudget(float milliseconds)
+{
+	mBudgetMs = milliseconds;
+}
+
+void DynamicResolution::SetScaleRange(float minScale, float maxScale)
+{
+	mMinScale = MathHelper::Clamp(minScale, 0.1f, 1.0f);
+	mMaxScale = MathHelper::Clamp(maxScale, mMinScale, 1.0f);
+	mScale = MathHelper::Clamp(mScale, mMinScale, mMaxScale);
+}
+
+void DynamicResolution::Update(float gpuMilliseconds)
+{
+	if (gpuMilliseconds <= 0.0f)
+		return;
+
+	float target = mScale * sqrtf(mBudgetMs / gpuMilliseconds);
+
+	// Back off quickly when over budget, creep up when there is headroom.
+	float rate = target < mScale ? 0.25f : 0.05f;
+	float scale = MathHelper::Clamp(mScale + (target - mScale) * rate, mMinScale, mMaxScale);
+
+	// Steps under a percent only make the image shimmer.
+	if (fabsf(scale - mScale) >= 0.01f || scale == mMinScale || scale == mMaxScale)
+		mScale = scale;
+}
+
+float DynamicResolution::Scale()const
+{
+	return mScale;
+}
+
+UINT DynamicResolution::RenderWidth()const
+{
+	return MathHelper::Clamp((UINT)(mWidth * mScale + 0.5f), 1u, mWidth);
+}
+
+UINT DynamicResolution::RenderHeight()const
+{
+	return MathHelper::Clamp((UINT)(mHeight * mScale + 0.5f), 1u, mHeight);
+}
+
+D3D12_VIEWPORT DynamicResolution::Viewport()const
+{
+	D3D12_VIEWPORT viewport;
+	viewport.TopLeftX = 0.0f;
+	viewport.TopLeftY = 0.0f;
+	viewport.Width = (float)RenderWidth();
+	viewport.Height = (float)RenderHeight();
+	viewport.MinDepth = 0.0f;
+	viewport.MaxDepth = 1.0f;
+	return viewport;
+}
+
+D3D12_RECT DynamicResolution::ScissorRect()const
+{
+	return { 0, 0, (LONG)RenderWidth(), (LONG)RenderHeight() };
+}
+
+UINT DynamicResolution::TargetWidth()const
+{
+	return mWidth;
+}
+
+UINT DynamicResolution::TargetHeight()const
+{
+	return mHeight;
+}
+
+D3D12_CLEAR_VALUE DynamicResolution::ClearValue()const
+{
+	D3D12_CLEAR_VALUE clearValue;
+	clearValue.Format = mFormat;
+	memcpy(clearValue.Color, &mClearColor, sizeof(clearValue.Color));
+	return clearValue;
+}
+
+void DynamicResolution::BeginScene(ID3D12GraphicsCommandList* cmdList, D3D12_CPU_DESCRIPTOR_HANDLE sceneTarget)
+{
+	// Only the rendered part; the rest is never sampled.
+	D3D12_RECT rect = ScissorRect();
+	cmdList->ClearRenderTargetView(sceneTarget, (float*)&mClearColor, 1, &rect);
+}
+
+void DynamicResolution::Upscale(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* sceneTarget, UINT frameIndex,
+	D3D12_CPU_DESCRIPTOR_HANDLE backBuffer, const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissorRect)
+{
+	assert(frameIndex < mFrameCount);
+
+	// The target may be another texture every frame, so its view is written each
+	// time, into the slot no frame still in flight reads.
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = mFormat;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = 1;
+	md3dDevice->CreateShaderResourceView(sceneTarget, &srvDesc,
+		CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvHeap->GetCPUDescriptorHandleForHeapStart(), frameIndex, mSrvDescriptorSize));
+
+	float constants[4] =
+	{
+		(float)RenderWidth() / mWidth,
+		(float)RenderHeight() / mHeight,
+		(RenderWidth() - 0.5f) / mWidth,
+		(RenderHeight() - 0.5f) / mHeight
+	};
+
+	cmdList->RSSetViewports(1, &viewport);
+	cmdList->RSSetScissorRects(1, &scissorRect);
+	cmdList->OMSetRenderTargets(1, &backBuffer, true, nullptr);
+
+	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvHeap.Get() };
+	cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+
+	cmdList->SetGraphicsRootSignature(mRootSignature.Get());
+	cmdList->SetPipelineState(mPso.Get());
+	cmdList->SetGraphicsRoot32BitConstants(0, 4, constants, 0);
+	cmdList->SetGraphicsRootDescriptorTable(1,
+		CD3DX12_GPU_DESCRIPTOR_HANDLE(mSrvHeap->GetGPUDescriptorHandleForHeapStart(), frameIndex, mSrvDescriptorSize));
+
+	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	cmdList->DrawInstanced(3, 1, 0, 0);
+}
+
+void DynamicResolution::BuildDescriptorHeap(UINT frameCount)
+{
+	mFrameCount = (std::max)(frameCount, 1u);
+	mSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc;
+	srvHeapDesc.NumDescriptors = mFrameCount;
+	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	srvHeapDesc.NodeMask = 0;
+	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(mSrvHeap.GetAddressOf())));
+}
+
+void DynamicResolution::BuildRootSignature()
+{
+	CD3DX12_DESCRIPTOR_RANGE srvTable;
+	srvTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+
+	CD3DX12_ROOT_PARAMETER slotRootParameter[2];
+	slotRootParameter[0].InitAsConstants(4, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[1].InitAsDescriptorTable(1, &srvTable, D3D12_SHADER_VISIBILITY_PIXEL);
+
+	const CD3DX12_STATIC_SAMPLER_DESC linearClamp(
+		0,
+		D3D12_FILTER_MIN_MAG_MIP_LINEAR,
+		D3D12_TEXTURE_ADDRESS_MODE_CLAMP,
+		D3D12_TEXTURE_ADDRESS_MODE_CLAMP,
+		D3D12_TEXTURE_ADDRESS_MODE_CLAMP);
+
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(2, slotRootParameter,
+		1, &linearClamp,
+		D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+	ComPtr<ID3DBlob> serializedRootSig = nullptr;
+	ComPtr<ID3DBlob> errorBlob = nullptr;
+	HRESULT hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1,
+		serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
+
+	if (errorBlob != nullptr)
+	{
+		::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+	}
+	ThrowIfFailed(hr);
+
+	ThrowIfFailed(md3dDevice->CreateRootSignature(
+		0,
+		serializedRootSig->GetBufferPointer(),
+		serializedRootSig->GetBufferSize(),
+		IID_PPV_ARGS(mRootSignature.GetAddressOf())));
+}
+
+void DynamicResolution::BuildPso(const std::wstring& shaderFile)
+{
+	ComPtr<ID3DBlob> vs = d3dUtil::CompileShader(shaderFile, nullptr, "VS", "vs_5_0");
+	ComPtr<ID3DBlob> ps = d3dUtil::CompileShader(shaderFile, nullptr, "PS", "ps_5_0");
+
+	// A full screen triangle straight into the back buffer: no input layout, depth or blending.
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc;
+	ZeroMemory(&psoDesc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
+	psoDesc.InputLayout = { nullptr, 0 };
+	psoDesc.pRootSignature = mRootSignature.Get();
+	psoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(vs->GetBufferPointer()),
+		vs->GetBufferSize()
+	};
+	psoDesc.PS =
+	{
+		reinterpret_cast<BYTE*>(ps->GetBufferPointer()),
+		ps->GetBufferSize()
+	};
+	psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+	psoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+	psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+	psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+	psoDesc.DepthStencilState.DepthEnable = false;
+	psoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+	psoDesc.SampleMask = UINT_MAX;
+	psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	psoDesc.NumRenderTargets = 1;
+	psoDesc.RTVFormats[0] = mFormat;
+	psoDesc.SampleDesc.Count = 1;
+	psoDesc.SampleDesc.Quality = 0;
+	psoDesc.DSVFormat = DXGI_FORMAT_UNKNOWN;
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(mPso.GetAddressOf())));
+}
@@ -0,0 +1,100 @@
+//***************************************************************************************
+// DynamicResolution.h
+//
+// Renders the scene at a fraction of the client size and stretches it over the back
+// buffer, trading resolution for a steady GPU frame time.
+//
+// The scene target is the caller's, e.g. a render graph's transient texture, of
+// TargetWidth() x TargetHeight() in ClearValue().Format.  The scene only draws into
+// its top left Scale() part, through Viewport() and ScissorRect(), so changing the
+// scale never reallocates anything.  The same holds for D3DApp's depth buffer, which
+// the scene keeps using.  The caller also issues the target's barriers.
+//
+// Each frame Update() gets the GPU time of a recent frame (GpuProfiler) and moves
+// the scale towards the one that would meet the budget.  Pixel cost follows the
+// area, so the side scales with the square root of budget / time.  The time is a
+// few frames old, so the scale only moves part of the way each frame: quickly when
+// over budget, slowly when there is headroom, which keeps it from oscillating.
+//
+// Per frame:
+//     resolution.Update(profiler.LatestGpuTime("frame"));
+//     resolution.BeginScene(cmdList, sceneRtv);     // a render target, cleared
+//     ... draw into sceneRtv with Viewport(), ScissorRect() ...
+//     resolution.Upscale(cmdList, scene, frameIndex, backBufferView, screenViewport, scissorRect);
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class DynamicResolution
+{
+public:
+	// frameCount is the number of frames that can be in flight, one SRV slot each.
+	DynamicResolution(ID3D12Device* device, UINT width, UINT height, DXGI_FORMAT format,
+		const DirectX::XMFLOAT4& clearColor, UINT frameCount,
+		const std::wstring& shaderFile = L"../../Shader/Upscale.hlsl");
+	DynamicResolution(const DynamicResolution& rhs) = delete;
+	DynamicResolution& operator=(const DynamicResolution& rhs) = delete;
+	~DynamicResolution() = default;
+
+	// The scene target follows the client size.
+	void OnResize(UINT width, UINT height);
+
+	// GPU milliseconds per frame to hold, and the range of the scale.
+	void SetBudget(float milliseconds);
+	void SetScaleRange(float minScale, float maxScale);
+
+	// Adjusts the scale from the GPU time of a recent frame; 0 (no sample yet) keeps it.
+	void Update(float gpuMilliseconds);
+
+	float Scale()const;
+	UINT RenderWidth()const;
+	UINT RenderHeight()const;
+
+	D3D12_VIEWPORT Viewport()const;
+	D3D12_RECT ScissorRect()const;
+
+	// What the scene target must be: its size, and the format and clear colour
+	// BeginScene() clears it with.
+	UINT TargetWidth()const;
+	UINT TargetHeight()const;
+	D3D12_CLEAR_VALUE ClearValue()const;
+
+	// Clears the rendered part of the scene target, which must be a render target.
+	void BeginScene(ID3D12GraphicsCommandList* cmdList, D3D12_CPU_DESCRIPTOR_HANDLE sceneTarget);
+
+	// Draws the rendered part of sceneTarget, which must be a pixel shader resource,
+	// over viewport into backBuffer, which must be a render target.  Its SRV goes in
+	// slot frameIndex, which only the frames using the same index read.  The root
+	// signature, PSO and descriptor heaps are replaced.
+	void Upscale(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* sceneTarget, UINT frameIndex,
+		D3D12_CPU_DESCRIPTOR_HANDLE backBuffer, const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissorRect);
+
+private:
+	void BuildDescriptorHeap(UINT frameCount);
+	void BuildRootSignature();
+	void BuildPso(const std::wstring& shaderFile);
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+
+	UINT mWidth = 0;
+	UINT mHeight = 0;
+	DXGI_FORMAT mFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+	DirectX::XMFLOAT4 mClearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+	float mBudgetMs = 1000.0f / 60.0f;
+	float mMinScale = 0.5f;
+	float mMaxScale = 1.0f;
+	float mScale = 1.0f;
+
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> mPso = nullptr;
+
+	// One shader visible SRV per frame in flight, so Upscale() does not need slots in
+	// the caller's heap, and never rewrites one a frame on the GPU still reads.
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mSrvHeap = nullptr;
+	UINT mSrvDescriptorSize = 0;
+	UINT mFrameCount = 0;
+};
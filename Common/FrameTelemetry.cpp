@@ -0,0 +1,192 @@
+//***************************************************************************************
+// FrameTelemetry.cpp
+//***************************************************************************************
+
+#include "FrameTelemetry.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+	// Frames before the threshold relative to the median applies.
+	const UINT64 MinFramesForMedian = 30;
+
+	// Completed hitches kept for the next WriteLog(), so a run without a log stays bounded.
+	const size_t MaxCompletedHitches = 256;
+
+	std::wstring Milliseconds(float ms)
+	{
+		std::wostringstream text;
+		text << std::fixed << std::setprecision(1) << ms;
+		return text.str();
+	}
+
+	void WriteScopes(std::ofstream& fout, const char* label, const std::vector<FrameTelemetry::ScopeTime>& scopes)
+	{
+		fout << ' ' << label << ':';
+		for (const auto& scope : scopes)
+		{
+			fout << ' ' << scope.Name << '=' << scope.Ms;
+			if (scope.AverageMs > 0.0f)
+				fout << "(avg " << scope.AverageMs << ')';
+		}
+	}
+}
+
+void FrameTelemetry::SetHitchThreshold(float ms)
+{
+	mHitchMs = (std::max)(ms, 0.0f);
+}
+
+void FrameTelemetry::SetGpuLatency(UINT frames)
+{
+	mGpuLatency = frames;
+}
+
+UINT FrameTelemetry::BucketOf(float ms)
+{
+	// The last bucket takes everything slower.
+	UINT bucket = (UINT)((std::max)(ms, 0.0f) / BucketMs);
+	return (std::min)(bucket, BucketCount - 1);
+}
+
+float FrameTelemetry::HitchThreshold()const
+{
+	if (mHitchMs > 0.0f)
+		return mHitchMs;
+
+	if (mFrameCount < MinFramesForMedian)
+		return FLT_MAX;
+
+	return 2.0f * Percentile(0.5f);
+}
+
+bool FrameTelemetry::AddFrame(float ms)
+{
+	// Judged against the frames before it, so one hitch cannot raise its own bar.
+	bool hitch = ms > HitchThreshold();
+
+	UINT slot = (UINT)(mFrameCount % WindowLength);
+	if (mFrameCount >= WindowLength)
+		--mBuckets[BucketOf(mFrames[slot])];
+
+	mFrames[slot] = ms;
+	++mBuckets[BucketOf(ms)];
+	++mFrameCount;
+
+	return hitch;
+}
+
+void FrameTelemetry::AddHitch(const std::vector<ScopeTime>& cpuScopes)
+{
+	Hitch hitch;
+	hitch.Frame = mFrameCount - 1;
+	hitch.Ms = mFrames[hitch.Frame % WindowLength];
+	hitch.MedianMs = Percentile(0.5f);
+	hitch.CpuScopes = cpuScopes;
+
+	mPendingHitches.push_back(hitch);
+	++mHitchCount;
+}
+
+bool FrameTelemetry::GpuTimesDue()const
+{
+	return !mPendingHitches.empty() && mPendingHitches.front().Frame + mGpuLatency < mFrameCount;
+}
+
+void FrameTelemetry::SetGpuTimes(const std::vector<ScopeTime>& gpuScopes)
+{
+	while (GpuTimesDue())
+	{
+		mPendingHitches.front().GpuScopes = gpuScopes;
+		if (mCompletedHitches.size() == MaxCompletedHitches)
+			mCompletedHitches.erase(mCompletedHitches.begin());
+		mCompletedHitches.push_back(mPendingHitches.front());
+		mPendingHitches.erase(mPendingHitches.begin());
+	}
+}
+
+float FrameTelemetry::Percentile(float p)const
+{
+	UINT64 count = (std::min)(mFrameCount, (UINT64)WindowLength);
+	if (count == 0)
+		return 0.0f;
+
+	// The bucket holding the frame of rank ceil(p * count), reported by its upper edge.
+	UINT64 rank = (UINT64)ceil((double)p * (double)count);
+	rank = (std::max)(rank, (UINT64)1);
+
+	UINT64 seen = 0;
+	for (UINT i = 0; i < BucketCount - 1; ++i)
+	{
+		seen += mBuckets[i];
+		if (seen >= rank)
+			return (i + 1) * BucketMs;
+	}
+
+	return MaxMs();
+}
+
+float FrameTelemetry::MaxMs()const
+{
+	UINT count = (UINT)(std::min)(mFrameCount, (UINT64)WindowLength);
+
+	float maxMs = 0.0f;
+	for (UINT i = 0; i < count; ++i)
+		maxMs = (std::max)(maxMs, mFrames[i]);
+	return maxMs;
+}
+
+UINT64 FrameTelemetry::FrameCount()const
+{
+	return mFrameCount;
+}
+
+UINT64 FrameTelemetry::HitchCount()const
+{
+	return mHitchCount;
+}
+
+std::wstring FrameTelemetry::Summary()const
+{
+	return L"p50/p95/p99/max " +
+		Milliseconds(Percentile(0.5f)) + L"/" +
+		Milliseconds(Percentile(0.95f)) + L"/" +
+		Milliseconds(Percentile(0.99f)) + L"/" +
+		Milliseconds(MaxMs()) + L" ms   hitches " + std::to_wstring(mHitchCount);
+}
+
+bool FrameTelemetry::WriteLog(const std::wstring& filename, float elapsed)
+{
+	// Appended and closed every time, so a crash keeps what was written.
+	std::ofstream fout(filename, mLogHeaderWritten ? std::ios::app : std::ios::trunc);
+	if (!fout)
+		return false;
+
+	if (!mLogHeaderWritten)
+	{
+		fout << "# frame telemetry, built " << __DATE__ << ' ' << __TIME__ << '\n';
+		mLogHeaderWritten = true;
+	}
+
+	fout << std::fixed << std::setprecision(2);
+	fout << "t=" << elapsed << " frames=" << mFrameCount
+		<< " p50=" << Percentile(0.5f) << " p95=" << Percentile(0.95f)
+		<< " p99=" << Percentile(0.99f) << " max=" << MaxMs()
+		<< " hitches=" << mHitchCount << '\n';
+
+	for (const auto& hitch : mCompletedHitches)
+	{
+		fout << "hitch frame=" << hitch.Frame << " ms=" << hitch.Ms << " median=" << hitch.MedianMs;
+		WriteScopes(fout, "cpu", hitch.CpuScopes);
+		WriteScopes(fout, "gpu", hitch.GpuScopes);
+		fout << '\n';
+	}
+	mCompletedHitches.clear();
+
+	return fout.good();
+}
@@ -0,0 +1,120 @@
+//***************************************************************************************
+// FrameTelemetry.h
+//
+// Frame time percentiles and hitch records.
+//
+// An average over a second hides a single 80 ms frame among sixty 16 ms ones, and
+// that frame is what the user sees.  FrameTelemetry keeps the times of the last
+// WindowLength frames in a histogram of BucketMs wide buckets, so p50/p95/p99 cost a
+// walk over the buckets instead of a sort.
+//
+// A frame that takes longer than the hitch threshold is a hitch.  The caller
+// describes it with AddHitch(): the CPU scopes of that frame right away, the GPU
+// passes once the frame's timestamps have been read back, which is gpuLatency
+// frames later (see GpuProfiler).  WriteLog() appends the percentiles and the
+// completed hitches to a text file, one line each, so runs of two builds can be
+// diffed.
+//
+//     if (telemetry.AddFrame(ms))                   // once per frame
+//         telemetry.AddHitch(cpuScopes);
+//     if (telemetry.GpuTimesDue())
+//         telemetry.SetGpuTimes(gpuScopes);
+//***************************************************************************************
+
+#pragma once
+
+#include <windows.h>
+#include <string>
+#include <vector>
+
+class FrameTelemetry
+{
+public:
+	struct ScopeTime
+	{
+		ScopeTime() = default;
+		ScopeTime(const std::string& name, float ms, float averageMs = 0.0f) :
+			Name(name), Ms(ms), AverageMs(averageMs)
+		{
+		}
+
+		std::string Name;
+		float Ms = 0.0f;
+
+		// Average over recent frames, or 0 where there is none (CPU scopes).
+		float AverageMs = 0.0f;
+	};
+
+	struct Hitch
+	{
+		UINT64 Frame = 0;
+		float Ms = 0.0f;
+		float MedianMs = 0.0f;
+		std::vector<ScopeTime> CpuScopes;
+		std::vector<ScopeTime> GpuScopes;
+	};
+
+	FrameTelemetry() = default;
+	FrameTelemetry(const FrameTelemetry& rhs) = delete;
+	FrameTelemetry& operator=(const FrameTelemetry& rhs) = delete;
+	~FrameTelemetry() = default;
+
+	// Frames slower than ms are hitches.  With 0, the default, frames slower than
+	// twice the median of the window are.
+	void SetHitchThreshold(float ms);
+
+	// Frames between a frame and the read back of its GPU timestamps.
+	void SetGpuLatency(UINT frames);
+
+	// Adds a frame of ms milliseconds.  Returns true if it is a hitch; the caller
+	// should then describe it with AddHitch().
+	bool AddFrame(float ms);
+
+	// Records the frame AddFrame() just reported as a hitch.
+	void AddHitch(const std::vector<ScopeTime>& cpuScopes);
+
+	// True when the oldest hitch waiting for its GPU times has been read back.
+	bool GpuTimesDue()const;
+
+	// Completes every hitch GpuTimesDue() is true for with gpuScopes.
+	void SetGpuTimes(const std::vector<ScopeTime>& gpuScopes);
+
+	// Frame time in milliseconds p of the frames in the window are faster than,
+	// p in [0, 1], to BucketMs.  0 with an empty window.
+	float Percentile(float p)const;
+	float MaxMs()const;
+
+	UINT64 FrameCount()const;
+	UINT64 HitchCount()const;
+
+	// "p50/p95/p99/max 16.6/17.1/18.0/41.2 ms   hitches 3", for the caption.
+	std::wstring Summary()const;
+
+	// Appends a line with the percentiles and one per hitch completed since the
+	// last call.  elapsed is the run time in seconds, to line up runs.  Returns
+	// false if the file cannot be written.
+	bool WriteLog(const std::wstring& filename, float elapsed);
+
+private:
+	static const UINT WindowLength = 1024;
+	static const UINT BucketCount = 2500;
+	static constexpr float BucketMs = 0.1f;
+
+	static UINT BucketOf(float ms);
+
+	float HitchThreshold()const;
+
+private:
+	float mHitchMs = 0.0f;
+	UINT mGpuLatency = 3;
+
+	float mFrames[WindowLength] = {};
+	UINT mBuckets[BucketCount] = {};
+	UINT64 mFrameCount = 0;
+
+	UINT64 mHitchCount = 0;
+	std::vector<Hitch> mPendingHitches;
+	std::vector<Hitch> mCompletedHitches;
+
+	bool mLogHeaderWritten = false;
+};
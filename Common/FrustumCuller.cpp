@@ -0,0 +1,133 @@
+//***************************************************************************************
+// FrustumCuller.cpp
+//***************************************************************************************
+
+#include "FrustumCuller.h"
+
+using namespace DirectX;
+
+void FrustumCuller::SetViewProj(FXMMATRIX viewProj)
+{
+	// With row vectors clip = v * M, so clip.x = dot(v, column 0) and so on.
+	// The rows of the transpose are the columns of M.
+	XMMATRIX m = XMMatrixTranspose(viewProj);
+
+	// The planes are not normalized; the inside/outside test only needs the sign,
+	// and the box radius below is scaled by the same factor.
+	XMStoreFloat4(&mPlanes[0], m.r[3] + m.r[0]); // left:   -w <= x
+	XMStoreFloat4(&mPlanes[1], m.r[3] - m.r[0]); // right:   x <= w
+	XMStoreFloat4(&mPlanes[2], m.r[3] + m.r[1]); // bottom: -w <= y
+	XMStoreFloat4(&mPlanes[3], m.r[3] - m.r[1]); // top:     y <= w
+	XMStoreFloat4(&mPlanes[4], m.r[2]);          // near:    0 <= z
+	XMStoreFloat4(&mPlanes[5], m.r[3] - m.r[2]); // far:     z <= w
+}
+
+void FrustumCuller::Clear()
+{
+	mBoxCount = 0;
+	mCenterX.clear();
+	mCenterY.clear();
+	mCenterZ.clear();
+	mExtentX.clear();
+	mExtentY.clear();
+	mExtentZ.clear();
+}
+
+UINT FrustumCuller::AddBox(const BoundingBox& localBounds, FXMMATRIX world)
+{
+	XMVECTOR center = XMVector3Transform(XMLoadFloat3(&localBounds.Center), world);
+
+	// An AABB's extent along each world axis is the sum of the transformed
+	// local axes' absolute projections onto it.
+	XMVECTOR extent =
+		XMVectorAbs(world.r[0]) * localBounds.Extents.x +
+		XMVectorAbs(world.r[1]) * localBounds.Extents.y +
+		XMVectorAbs(world.r[2]) * localBounds.Extents.z;
+
+	XMFLOAT3 c, e;
+	XMStoreFloat3(&c, center);
+	XMStoreFloat3(&e, extent);
+
+	mCenterX.push_back(c.x);
+	mCenterY.push_back(c.y);
+	mCenterZ.push_back(c.z);
+	mExtentX.push_back(e.x);
+	mExtentY.push_back(e.y);
+	mExtentZ.push_back(e.z);
+
+	return mBoxCount++;
+}
+
+UINT FrustumCuller::BoxCount()const
+{
+	return mBoxCount;
+}
+
+UINT FrustumCuller::Cull(std::vector<UINT8>& visible)
+{
+	visible.resize(mBoxCount);
+	if (mBoxCount == 0)
+		return 0;
+
+	// Pad with empty boxes at the origin so every group has four lanes;
+	// their results are dropped.
+	const UINT paddedCount = (mBoxCount + 3) & ~3u;
+	mCenterX.resize(paddedCount, 0.0f);
+	mCenterY.resize(paddedCount, 0.0f);
+	mCenterZ.resize(paddedCount, 0.0f);
+	mExtentX.resize(paddedCount, 0.0f);
+	mExtentY.resize(paddedCount, 0.0f);
+	mExtentZ.resize(paddedCount, 0.0f);
+
+	XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+	XMVECTOR absX[6], absY[6], absZ[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		planeX[p] = XMVectorReplicate(mPlanes[p].x);
+		planeY[p] = XMVectorReplicate(mPlanes[p].y);
+		planeZ[p] = XMVectorReplicate(mPlanes[p].z);
+		planeW[p] = XMVectorReplicate(mPlanes[p].w);
+		absX[p] = XMVectorAbs(planeX[p]);
+		absY[p] = XMVectorAbs(planeY[p]);
+		absZ[p] = XMVectorAbs(planeZ[p]);
+	}
+
+	UINT visibleCount = 0;
+	for (UINT i = 0; i < paddedCount; i += 4)
+	{
+		XMVECTOR cx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&mCenterX[i]));
+		XMVECTOR cy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&mCenterY[i]));
+		XMVECTOR cz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&mCenterZ[i]));
+		XMVECTOR ex = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&mExtentX[i]));
+		XMVECTOR ey = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&mExtentY[i]));
+		XMVECTOR ez = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&mExtentZ[i]));
+
+		// A box is outside if, for some plane, even its corner farthest along
+		// the plane normal is behind it: dot(n, c) + d + dot(|n|, e) < 0.
+		XMVECTOR outside = XMVectorFalseInt();
+		for (int p = 0; p < 6; ++p)
+		{
+			XMVECTOR dist = XMVectorMultiplyAdd(planeX[p], cx,
+				XMVectorMultiplyAdd(planeY[p], cy,
+				XMVectorMultiplyAdd(planeZ[p], cz, planeW[p])));
+			XMVECTOR radius = XMVectorMultiplyAdd(absX[p], ex,
+				XMVectorMultiplyAdd(absY[p], ey, absZ[p] * ez));
+
+			outside = XMVectorOrInt(outside, XMVectorLess(dist + radius, XMVectorZero()));
+		}
+
+		XMUINT4 mask;
+		XMStoreUInt4(&mask, outside);
+		const uint32_t lanes[4] = { mask.x, mask.y, mask.z, mask.w };
+
+		UINT laneCount = std::min(4u, mBoxCount - i);
+		for (UINT lane = 0; lane < laneCount; ++lane)
+		{
+			UINT8 v = lanes[lane] == 0 ? 1 : 0;
+			visible[i + lane] = v;
+			visibleCount += v;
+		}
+	}
+
+	return visibleCount;
+}
@@ -0,0 +1,57 @@
+//***************************************************************************************
+// FrustumCuller.h
+//
+// Tests world-space bounding boxes against a view frustum.  Boxes are queued into
+// structure-of-arrays storage and tested four at a time with DirectXMath vectors,
+// so culling a layer costs a few instructions per box and plane.
+//
+// Typical use, once per frame and layer:
+//     culler.SetViewProj(view * proj);
+//     culler.Clear();
+//     for each item: culler.AddBox(submesh.Bounds, world);
+//     culler.Cull(visible);
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class FrustumCuller
+{
+public:
+	FrustumCuller() = default;
+	FrustumCuller(const FrustumCuller& rhs) = delete;
+	FrustumCuller& operator=(const FrustumCuller& rhs) = delete;
+	~FrustumCuller() = default;
+
+	// Extracts the six frustum planes from a view-projection matrix (row vectors,
+	// D3D clip space with 0 <= z <= w).  The same matrix the pass constants use.
+	void SetViewProj(DirectX::FXMMATRIX viewProj);
+
+	// Forgets the queued boxes; keeps the storage.
+	void Clear();
+
+	// Transforms localBounds by world and queues the world-space AABB around it.
+	// Returns the index of the box, which is also its index in Cull()'s output.
+	UINT AddBox(const DirectX::BoundingBox& localBounds, DirectX::FXMMATRIX world);
+
+	UINT BoxCount()const;
+
+	// Tests every queued box.  visible[i] is 1 if box i intersects the frustum
+	// and 0 if it lies fully outside one plane.  Returns the number of visible boxes.
+	UINT Cull(std::vector<UINT8>& visible);
+
+private:
+	// Plane i is (a, b, c, d) with a*x + b*y + c*z + d >= 0 on the inside.
+	DirectX::XMFLOAT4 mPlanes[6];
+
+	UINT mBoxCount = 0;
+
+	// Padded to a multiple of four by Cull().
+	std::vector<float> mCenterX;
+	std::vector<float> mCenterY;
+	std::vector<float> mCenterZ;
+	std::vector<float> mExtentX;
+	std::vector<float> mExtentY;
+	std::vector<float> mExtentZ;
+};
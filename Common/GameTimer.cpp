@@ -6,8 +6,8 @@
 #include "GameTimer.h"
 
 GameTimer::GameTimer()
-: mSecondsPerCount(0.0), mDeltaTime(-1.0), mBaseTime(0), 
-  mPausedTime(0), mPrevTime(0), mCurrTime(0), mStopped(false)
+: mSecondsPerCount(0.0), mDeltaTime(-1.0), mFixedTimeStep(0.0), mFixedTotalTime(0.0),
+  mBaseTime(0), mPausedTime(0), mPrevTime(0), mCurrTime(0), mStopped(false)
 {
 	__int64 countsPerSec;
 	QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
@@ -18,6 +18,11 @@ GameTimer::GameTimer()
 // time when the clock is stopped.
 float GameTimer::TotalTime()const
 {
+	if( mFixedTimeStep > 0.0 )
+	{
+		return (float)mFixedTotalTime;
+	}
+
 	// If we are stopped, do not count the time that has passed since we stopped.
 	// Moreover, if we previously already had a pause, the distance 
 	// mStopTime - mBaseTime includes paused time, which we do not want to count.
@@ -62,6 +67,13 @@ void GameTimer::Reset()
 	mPrevTime = currTime;
 	mStopTime = 0;
 	mStopped  = false;
+	mFixedTotalTime = 0.0;
+}
+
+void GameTimer::SetFixedTimeStep(double dt)
+{
+	mFixedTimeStep = dt;
+	mFixedTotalTime = 0.0;
 }
 
 void GameTimer::Start()
@@ -106,6 +118,13 @@ void GameTimer::Tick()
 		return;
 	}
 
+	if( mFixedTimeStep > 0.0 )
+	{
+		mDeltaTime = mFixedTimeStep;
+		mFixedTotalTime += mFixedTimeStep;
+		return;
+	}
+
 	__int64 currTime;
 	QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
 	mCurrTime = currTime;
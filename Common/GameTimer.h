@@ -18,10 +18,18 @@ public:
 	void Stop();  // Call when paused.
 	void Tick();  // Call every frame.
 
+	// Makes Tick() advance by exactly dt seconds instead of reading the clock,
+	// so a run is reproducible regardless of frame rate.  Pass 0 to go back
+	// to real time.
+	void SetFixedTimeStep(double dt);
+
 private:
 	double mSecondsPerCount;
 	double mDeltaTime;
 
+	double mFixedTimeStep;
+	double mFixedTotalTime;
+
 	__int64 mBaseTime;
 	__int64 mPausedTime;
 	__int64 mStopTime;
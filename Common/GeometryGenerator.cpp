@@ -4,9 +4,40 @@
 
 #include "GeometryGenerator.h"
 #include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <ppl.h>
 
 using namespace DirectX;
 
+namespace
+{
+	void StoreVertex(std::uint8_t* dst, const GeometryGenerator::VertexLayout& layout, const GeometryGenerator::Vertex& v)
+	{
+		if(layout.PositionOffset >= 0)
+			memcpy(dst + layout.PositionOffset, &v.Position, sizeof(v.Position));
+		if(layout.NormalOffset >= 0)
+			memcpy(dst + layout.NormalOffset, &v.Normal, sizeof(v.Normal));
+		if(layout.TangentOffset >= 0)
+			memcpy(dst + layout.TangentOffset, &v.TangentU, sizeof(v.TangentU));
+		if(layout.TexCOffset >= 0)
+			memcpy(dst + layout.TexCOffset, &v.TexC, sizeof(v.TexC));
+	}
+
+	void StoreIndex(const GeometryGenerator::MeshSpans& out, std::uint32_t i, std::uint32_t value)
+	{
+		if(out.IndexStride == sizeof(std::uint16_t))
+		{
+			assert(value <= 0xffff);
+			reinterpret_cast<std::uint16_t*>(out.Indices)[i] = static_cast<std::uint16_t>(value);
+		}
+		else
+		{
+			reinterpret_cast<std::uint32_t*>(out.Indices)[i] = value;
+		}
+	}
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions)
 {
     MeshData meshData;
@@ -104,6 +135,33 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 {
     MeshData meshData;
 
+	MeshSize size = SphereSize(sliceCount, stackCount);
+	meshData.Vertices.resize(size.VertexCount);
+	meshData.Indices32.resize(size.IndexCount);
+
+	MeshSpans out;
+	out.Vertices = meshData.Vertices.data();
+	out.Indices = meshData.Indices32.data();
+	WriteSphere(radius, sliceCount, stackCount, out);
+
+    return meshData;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::SphereSize(uint32 sliceCount, uint32 stackCount)
+{
+	// Two poles plus stackCount-1 rings; one triangle fan at each pole and two
+	// triangles per quad in between.
+	MeshSize size;
+	size.VertexCount = 2 + (stackCount - 1)*(sliceCount + 1);
+	size.IndexCount = 6*sliceCount + 6*sliceCount*(stackCount - 2);
+	return size;
+}
+
+void GeometryGenerator::WriteSphere(float radius, uint32 sliceCount, uint32 stackCount, const MeshSpans& out)
+{
+	std::uint8_t* vertices = reinterpret_cast<std::uint8_t*>(out.Vertices);
+	const size_t stride = out.Layout.Stride;
+
 	//
 	// Compute the vertices stating at the top pole and moving down the stacks.
 	//
@@ -114,15 +172,20 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
 	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 
-	meshData.Vertices.push_back( topVertex );
+	const uint32 ringVertexCount = sliceCount + 1;
+	const uint32 southPoleIndex = 1 + (stackCount - 1)*ringVertexCount;
+
+	StoreVertex(vertices, out.Layout, topVertex);
+	StoreVertex(vertices + southPoleIndex*stride, out.Layout, bottomVertex);
 
 	float phiStep   = XM_PI/stackCount;
 	float thetaStep = 2.0f*XM_PI/sliceCount;
 
 	// Compute vertices for each stack ring (do not count the poles as rings).
-	for(uint32 i = 1; i <= stackCount-1; ++i)
+	concurrency::parallel_for(1u, stackCount, [&](uint32 i)
 	{
 		float phi = i*phiStep;
+		std::uint8_t* ring = vertices + (1 + (i - 1)*ringVertexCount)*stride;
 
 		// Vertices of ring.
         for(uint32 j = 0; j <= sliceCount; ++j)
@@ -150,24 +213,23 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 			v.TexC.x = theta / XM_2PI;
 			v.TexC.y = phi / XM_PI;
 
-			meshData.Vertices.push_back( v );
+			StoreVertex(ring + j*stride, out.Layout, v);
 		}
-	}
-
-	meshData.Vertices.push_back( bottomVertex );
+	});
 
 	//
 	// Compute indices for top stack.  The top stack was written first to the vertex buffer
 	// and connects the top pole to the first ring.
 	//
 
+	uint32 k = 0;
     for(uint32 i = 1; i <= sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(0);
-		meshData.Indices32.push_back(i+1);
-		meshData.Indices32.push_back(i);
+		StoreIndex(out, k++, 0);
+		StoreIndex(out, k++, i+1);
+		StoreIndex(out, k++, i);
 	}
-	
+
 	//
 	// Compute indices for inner stacks (not connected to poles).
 	//
@@ -175,50 +237,49 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	// Offset the indices to the index of the first vertex in the first ring.
 	// This is just skipping the top pole vertex.
     uint32 baseIndex = 1;
-    uint32 ringVertexCount = sliceCount + 1;
-	for(uint32 i = 0; i < stackCount-2; ++i)
+	const uint32 innerStart = k;
+	concurrency::parallel_for(0u, stackCount - 2, [&](uint32 i)
 	{
+		uint32 k = innerStart + i*sliceCount*6;
 		for(uint32 j = 0; j < sliceCount; ++j)
 		{
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
+			StoreIndex(out, k++, baseIndex + i*ringVertexCount + j);
+			StoreIndex(out, k++, baseIndex + i*ringVertexCount + j+1);
+			StoreIndex(out, k++, baseIndex + (i+1)*ringVertexCount + j);
 
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j+1);
+			StoreIndex(out, k++, baseIndex + (i+1)*ringVertexCount + j);
+			StoreIndex(out, k++, baseIndex + i*ringVertexCount + j+1);
+			StoreIndex(out, k++, baseIndex + (i+1)*ringVertexCount + j+1);
 		}
-	}
+	});
+	k = innerStart + (stackCount - 2)*sliceCount*6;
 
 	//
 	// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
 	// and connects the bottom pole to the bottom ring.
 	//
 
-	// South pole vertex was added last.
-	uint32 southPoleIndex = (uint32)meshData.Vertices.size()-1;
-
 	// Offset the indices to the index of the first vertex in the last ring.
 	baseIndex = southPoleIndex - ringVertexCount;
-	
+
 	for(uint32 i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(southPoleIndex);
-		meshData.Indices32.push_back(baseIndex+i);
-		meshData.Indices32.push_back(baseIndex+i+1);
+		StoreIndex(out, k++, southPoleIndex);
+		StoreIndex(out, k++, baseIndex+i);
+		StoreIndex(out, k++, baseIndex+i+1);
 	}
-
-    return meshData;
 }
  
 void GeometryGenerator::Subdivide(MeshData& meshData)
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
-
+	// Take the input geometry over rather than copying it, and size the output
+	// exactly: every triangle becomes 6 vertices and 4 triangles.
+	MeshData inputCopy;
+	inputCopy.Vertices.swap(meshData.Vertices);
+	inputCopy.Indices32.swap(meshData.Indices32);
 
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
+	meshData.Vertices.reserve(inputCopy.Indices32.size()*2);
+	meshData.Indices32.reserve(inputCopy.Indices32.size()*4);
 
 	//       v1
 	//       *
@@ -379,6 +440,117 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
     return meshData;
 }
 
+GeometryGenerator::MeshSize GeometryGenerator::GeosphereSize(uint32 numSubdivisions)
+{
+	// 20 faces, each a triangular grid with s segments per edge.
+	const uint32 s = 1u << std::min<uint32>(numSubdivisions, 6u);
+
+	MeshSize size;
+	size.VertexCount = 20*(s+1)*(s+2)/2;
+	size.IndexCount = 20*s*s*3;
+	return size;
+}
+
+void GeometryGenerator::WriteGeosphere(float radius, uint32 numSubdivisions, const MeshSpans& out)
+{
+	// Same icosahedron as CreateGeosphere.
+	const float X = 0.525731f; 
+	const float Z = 0.850651f;
+
+	const XMFLOAT3 pos[12] = 
+	{
+		XMFLOAT3(-X, 0.0f, Z),  XMFLOAT3(X, 0.0f, Z),  
+		XMFLOAT3(-X, 0.0f, -Z), XMFLOAT3(X, 0.0f, -Z),    
+		XMFLOAT3(0.0f, Z, X),   XMFLOAT3(0.0f, Z, -X), 
+		XMFLOAT3(0.0f, -Z, X),  XMFLOAT3(0.0f, -Z, -X),    
+		XMFLOAT3(Z, X, 0.0f),   XMFLOAT3(-Z, X, 0.0f), 
+		XMFLOAT3(Z, -X, 0.0f),  XMFLOAT3(-Z, -X, 0.0f)
+	};
+
+    const uint32 k[60] =
+	{
+		1,4,0,  4,9,0,  4,5,9,  8,5,4,  1,8,4,    
+		1,10,8, 10,3,8, 8,3,5,  3,2,5,  3,7,2,    
+		3,10,7, 10,6,7, 6,11,7, 6,0,11, 6,1,0, 
+		10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7 
+	};
+
+	// Repeated midpoint subdivision of the flat face followed by a projection
+	// onto the sphere gives the same points as a uniform barycentric grid.
+	const uint32 s = 1u << std::min<uint32>(numSubdivisions, 6u);
+	const uint32 faceVertexCount = (s+1)*(s+2)/2;
+	const uint32 faceIndexCount = s*s*3;
+
+	std::uint8_t* vertices = reinterpret_cast<std::uint8_t*>(out.Vertices);
+	const size_t stride = out.Layout.Stride;
+
+	// Grid point (i, j) lies i steps from v0 towards v1 and j steps towards v2;
+	// row i holds the s-i+1 points with i+j <= s.
+	auto local = [s](uint32 i, uint32 j) { return i*(s+1) - i*(i-1)/2 + j; };
+
+	concurrency::parallel_for(0u, 20u, [&](uint32 face)
+	{
+		XMVECTOR v0 = XMLoadFloat3(&pos[k[face*3+0]]);
+		XMVECTOR e1 = (XMLoadFloat3(&pos[k[face*3+1]]) - v0) / (float)s;
+		XMVECTOR e2 = (XMLoadFloat3(&pos[k[face*3+2]]) - v0) / (float)s;
+
+		const uint32 baseVertex = face*faceVertexCount;
+		for(uint32 i = 0; i <= s; ++i)
+		{
+			for(uint32 j = 0; i + j <= s; ++j)
+			{
+				// Project onto unit sphere.
+				XMVECTOR n = XMVector3Normalize(v0 + (float)i*e1 + (float)j*e2);
+
+				Vertex v;
+				XMStoreFloat3(&v.Position, radius*n);
+				XMStoreFloat3(&v.Normal, n);
+
+				// Derive texture coordinates from spherical coordinates.
+				float theta = atan2f(v.Position.z, v.Position.x);
+
+				// Put in [0, 2pi].
+				if(theta < 0.0f)
+					theta += XM_2PI;
+
+				float phi = acosf(v.Position.y / radius);
+
+				v.TexC.x = theta/XM_2PI;
+				v.TexC.y = phi/XM_PI;
+
+				// Partial derivative of P with respect to theta
+				v.TangentU.x = -radius*sinf(phi)*sinf(theta);
+				v.TangentU.y = 0.0f;
+				v.TangentU.z = +radius*sinf(phi)*cosf(theta);
+
+				XMVECTOR T = XMLoadFloat3(&v.TangentU);
+				XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+
+				StoreVertex(vertices + (baseVertex + local(i, j))*stride, out.Layout, v);
+			}
+		}
+
+		// Both triangle shapes keep the winding of (v0, v1, v2).
+		uint32 idx = face*faceIndexCount;
+		for(uint32 i = 0; i < s; ++i)
+		{
+			for(uint32 j = 0; i + j < s; ++j)
+			{
+				StoreIndex(out, idx++, baseVertex + local(i, j));
+				StoreIndex(out, idx++, baseVertex + local(i+1, j));
+				StoreIndex(out, idx++, baseVertex + local(i, j+1));
+
+				if(i + j + 1 < s)
+				{
+					StoreIndex(out, idx++, baseVertex + local(i+1, j));
+					StoreIndex(out, idx++, baseVertex + local(i+1, j+1));
+					StoreIndex(out, idx++, baseVertex + local(i, j+1));
+				}
+			}
+		}
+	});
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount)
 {
     MeshData meshData;
@@ -552,8 +724,30 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 {
     MeshData meshData;
 
-	uint32 vertexCount = m*n;
-	uint32 faceCount   = (m-1)*(n-1)*2;
+	MeshSize size = GridSize(m, n);
+	meshData.Vertices.resize(size.VertexCount);
+	meshData.Indices32.resize(size.IndexCount);
+
+	MeshSpans out;
+	out.Vertices = meshData.Vertices.data();
+	out.Indices = meshData.Indices32.data();
+	WriteGrid(width, depth, m, n, out);
+
+    return meshData;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GridSize(uint32 m, uint32 n)
+{
+	MeshSize size;
+	size.VertexCount = m*n;
+	size.IndexCount = (m-1)*(n-1)*6; // 2 faces per quad, 3 indices per face
+	return size;
+}
+
+void GeometryGenerator::WriteGrid(float width, float depth, uint32 m, uint32 n, const MeshSpans& out)
+{
+	std::uint8_t* vertices = reinterpret_cast<std::uint8_t*>(out.Vertices);
+	const size_t stride = out.Layout.Stride;
 
 	//
 	// Create the vertices.
@@ -568,49 +762,48 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 	float du = 1.0f / (n-1);
 	float dv = 1.0f / (m-1);
 
-	meshData.Vertices.resize(vertexCount);
-	for(uint32 i = 0; i < m; ++i)
+	// Each row writes its own slice of the output, so rows need no synchronization.
+	concurrency::parallel_for(0u, m, [&](uint32 i)
 	{
 		float z = halfDepth - i*dz;
 		for(uint32 j = 0; j < n; ++j)
 		{
 			float x = -halfWidth + j*dx;
 
-			meshData.Vertices[i*n+j].Position = XMFLOAT3(x, 0.0f, z);
-			meshData.Vertices[i*n+j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i*n+j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+			Vertex v;
+			v.Position = XMFLOAT3(x, 0.0f, z);
+			v.Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
+			v.TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
 
 			// Stretch texture over grid.
-			meshData.Vertices[i*n+j].TexC.x = j*du;
-			meshData.Vertices[i*n+j].TexC.y = i*dv;
+			v.TexC.x = j*du;
+			v.TexC.y = i*dv;
+
+			StoreVertex(vertices + (i*n+j)*stride, out.Layout, v);
 		}
-	}
- 
+	});
+
     //
 	// Create the indices.
 	//
 
-	meshData.Indices32.resize(faceCount*3); // 3 indices per face
-
 	// Iterate over each quad and compute indices.
-	uint32 k = 0;
-	for(uint32 i = 0; i < m-1; ++i)
+	concurrency::parallel_for(0u, m-1, [&](uint32 i)
 	{
+		uint32 k = i*(n-1)*6;
 		for(uint32 j = 0; j < n-1; ++j)
 		{
-			meshData.Indices32[k]   = i*n+j;
-			meshData.Indices32[k+1] = i*n+j+1;
-			meshData.Indices32[k+2] = (i+1)*n+j;
+			StoreIndex(out, k,   i*n+j);
+			StoreIndex(out, k+1, i*n+j+1);
+			StoreIndex(out, k+2, (i+1)*n+j);
 
-			meshData.Indices32[k+3] = (i+1)*n+j;
-			meshData.Indices32[k+4] = i*n+j+1;
-			meshData.Indices32[k+5] = (i+1)*n+j+1;
+			StoreIndex(out, k+3, (i+1)*n+j);
+			StoreIndex(out, k+4, i*n+j+1);
+			StoreIndex(out, k+5, (i+1)*n+j+1);
 
 			k += 6; // next quad
 		}
-	}
-
-    return meshData;
+	});
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth)
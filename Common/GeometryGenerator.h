@@ -74,6 +74,61 @@ public:
 		std::vector<uint16> mIndices16;
 	};
 
+	///<summary>
+	/// Where the Write* functions put each vertex attribute: byte offsets from the
+	/// start of a vertex, or -1 to skip the attribute.  Lets a demo fill its own
+	/// Vertex type in place, e.g. straight in an upload buffer.
+	///</summary>
+	struct VertexLayout
+	{
+		size_t Stride = sizeof(Vertex);
+		int PositionOffset = 0;
+		int NormalOffset = sizeof(DirectX::XMFLOAT3);
+		int TangentOffset = 2 * sizeof(DirectX::XMFLOAT3);
+		int TexCOffset = 3 * sizeof(DirectX::XMFLOAT3);
+	};
+
+	///<summary>
+	/// Caller-owned output of the Write* functions.  Both arrays must hold at least
+	/// the counts returned by the matching *Size function.  IndexStride is 2 or 4.
+	///</summary>
+	struct MeshSpans
+	{
+		void* Vertices = nullptr;
+		VertexLayout Layout;
+		void* Indices = nullptr;
+		uint32 IndexStride = sizeof(uint32);
+	};
+
+	struct MeshSize
+	{
+		uint32 VertexCount = 0;
+		uint32 IndexCount = 0;
+	};
+
+	static MeshSize GridSize(uint32 m, uint32 n);
+	static MeshSize SphereSize(uint32 sliceCount, uint32 stackCount);
+	static MeshSize GeosphereSize(uint32 numSubdivisions);
+
+	///<summary>
+	/// Same mesh as CreateGrid, written in place.  Rows are generated in parallel.
+	///</summary>
+	void WriteGrid(float width, float depth, uint32 m, uint32 n, const MeshSpans& out);
+
+	///<summary>
+	/// Same mesh as CreateSphere, written in place.  Rings are generated in parallel.
+	///</summary>
+	void WriteSphere(float radius, uint32 sliceCount, uint32 stackCount, const MeshSpans& out);
+
+	///<summary>
+	/// Same surface as CreateGeosphere, written in place.  Each icosahedron face is
+	/// tessellated directly into a triangular grid of 2^numSubdivisions segments
+	/// per edge, in parallel, instead of rebuilding the mesh once per subdivision.
+	/// Vertices are shared inside a face, so there are far fewer than CreateGeosphere
+	/// makes and even 6 subdivisions fit 16-bit indices.
+	///</summary>
+	void WriteGeosphere(float radius, uint32 numSubdivisions, const MeshSpans& out);
+
 	///<summary>
 	/// Creates a box centered at the origin with the given dimensions, where each
     /// face has m rows and n columns of vertices.
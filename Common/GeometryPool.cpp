@@ -0,0 +1,98 @@
+//***************************************************************************************
+// GeometryPool.cpp
+//***************************************************************************************
+
+#include "GeometryPool.h"
+
+GeometryPool::GeometryPool(BufferSuballocator& allocator, UINT vertexByteStride, UINT maxVertexCount, UINT maxIndexCount) :
+	mVertexByteStride(vertexByteStride),
+	mMaxVertexCount(maxVertexCount),
+	mMaxIndexCount(maxIndexCount)
+{
+	mVertexBuffer = allocator.Allocate((UINT64)vertexByteStride * maxVertexCount);
+	mIndexBuffer = allocator.Allocate((UINT64)sizeof(std::uint32_t) * maxIndexCount);
+}
+
+void GeometryPool::AddMesh(StagingRing& staging, MeshGeometry& geo,
+	const void* vertices, UINT vertexCount,
+	const void* indices, UINT indexCount, UINT indexByteStride)
+{
+	assert(indexByteStride == 2 || indexByteStride == 4);
+
+	if(mVertexCount + vertexCount > mMaxVertexCount || mIndexCount + indexCount > mMaxIndexCount)
+		throw DxException(E_OUTOFMEMORY, L"GeometryPool::AddMesh", AnsiToWString(__FILE__), __LINE__);
+
+	const UINT baseVertex = mVertexCount;
+	const UINT startIndex = mIndexCount;
+
+	staging.Upload(mVertexBuffer.Resource,
+		mVertexBuffer.Offset + (UINT64)baseVertex * mVertexByteStride,
+		vertices, (UINT64)vertexCount * mVertexByteStride);
+
+	const UINT64 ibOffset = mIndexBuffer.Offset + (UINT64)startIndex * sizeof(std::uint32_t);
+	if(indexByteStride == 2)
+	{
+		const std::uint16_t* src = reinterpret_cast<const std::uint16_t*>(indices);
+		std::vector<std::uint32_t> wide(src, src + indexCount);
+		staging.Upload(mIndexBuffer.Resource, ibOffset, wide.data(), wide.size() * sizeof(std::uint32_t));
+	}
+	else
+	{
+		staging.Upload(mIndexBuffer.Resource, ibOffset, indices, (UINT64)indexCount * sizeof(std::uint32_t));
+	}
+
+	mVertexCount += vertexCount;
+	mIndexCount += indexCount;
+
+	// Every mesh of the pool shares the same views; only the draw arguments differ.
+	geo.VertexBufferGPU = mVertexBuffer.Resource;
+	geo.VertexBufferOffset = mVertexBuffer.Offset;
+	geo.VertexByteStride = mVertexByteStride;
+	geo.VertexBufferByteSize = mVertexByteStride * mMaxVertexCount;
+
+	geo.IndexBufferGPU = mIndexBuffer.Resource;
+	geo.IndexBufferOffset = mIndexBuffer.Offset;
+	geo.IndexFormat = DXGI_FORMAT_R32_UINT;
+	geo.IndexBufferByteSize = (UINT)sizeof(std::uint32_t) * mMaxIndexCount;
+
+	for(auto& arg : geo.DrawArgs)
+	{
+		arg.second.StartIndexLocation += startIndex;
+		arg.second.BaseVertexLocation += (INT)baseVertex;
+	}
+}
+
+D3D12_VERTEX_BUFFER_VIEW GeometryPool::VertexBufferView()const
+{
+	D3D12_VERTEX_BUFFER_VIEW vbv;
+	vbv.BufferLocation = mVertexBuffer.GPU;
+	vbv.StrideInBytes = mVertexByteStride;
+	vbv.SizeInBytes = mVertexByteStride * mMaxVertexCount;
+
+	return vbv;
+}
+
+D3D12_INDEX_BUFFER_VIEW GeometryPool::IndexBufferView()const
+{
+	D3D12_INDEX_BUFFER_VIEW ibv;
+	ibv.BufferLocation = mIndexBuffer.GPU;
+	ibv.Format = DXGI_FORMAT_R32_UINT;
+	ibv.SizeInBytes = (UINT)sizeof(std::uint32_t) * mMaxIndexCount;
+
+	return ibv;
+}
+
+UINT GeometryPool::VertexByteStride()const
+{
+	return mVertexByteStride;
+}
+
+UINT GeometryPool::VertexCount()const
+{
+	return mVertexCount;
+}
+
+UINT GeometryPool::IndexCount()const
+{
+	return mIndexCount;
+}
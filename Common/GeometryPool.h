@@ -0,0 +1,49 @@
+//***************************************************************************************
+// GeometryPool.h
+//
+// Packs every mesh of one vertex layout into a single vertex buffer and a single
+// 32-bit index buffer.  Each MeshGeometry added to the pool points at the shared
+// buffers and its DrawArgs are rebased to global StartIndexLocation and
+// BaseVertexLocation, so all meshes of the pool produce identical vertex/index
+// buffer views and a layer can bind them once.  This is also the layout
+// ExecuteIndirect needs, where only the draw arguments change per item.
+//***************************************************************************************
+
+#pragma once
+
+#include "StagingRing.h"
+
+class GeometryPool
+{
+public:
+	GeometryPool(BufferSuballocator& allocator, UINT vertexByteStride, UINT maxVertexCount, UINT maxIndexCount);
+	GeometryPool(const GeometryPool& rhs) = delete;
+	GeometryPool& operator=(const GeometryPool& rhs) = delete;
+	~GeometryPool() = default;
+
+	// Appends the mesh and uploads it through staging.  geo.DrawArgs must hold the
+	// submeshes relative to this mesh; they are shifted to the pool's global
+	// locations.  indexByteStride is 2 or 4; 16-bit indices are widened.
+	// Throws DxException(E_OUTOFMEMORY) if the pool is full.
+	void AddMesh(StagingRing& staging, MeshGeometry& geo,
+		const void* vertices, UINT vertexCount,
+		const void* indices, UINT indexCount, UINT indexByteStride);
+
+	D3D12_VERTEX_BUFFER_VIEW VertexBufferView()const;
+	D3D12_INDEX_BUFFER_VIEW IndexBufferView()const;
+
+	UINT VertexByteStride()const;
+	UINT VertexCount()const;
+	UINT IndexCount()const;
+
+private:
+	BufferAllocation mVertexBuffer;
+	BufferAllocation mIndexBuffer;
+
+	UINT mVertexByteStride = 0;
+	UINT mMaxVertexCount = 0;
+	UINT mMaxIndexCount = 0;
+
+	UINT mVertexCount = 0;
+	UINT mIndexCount = 0;
+};
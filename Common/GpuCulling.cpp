@@ -0,0 +1,437 @@
+//***************************************************************************************
+// GpuCulling.cpp
+//***************************************************************************************
+
+#include "GpuCulling.h"
+#include "HiZPyramid.h"
+
+using Microsoft::WRL::ComPtr;
+using namespace DirectX;
+
+GpuCulling::GpuCulling(ID3D12Device* device, ID3D12RootSignature* drawRootSignature,
+	UINT drawConstantsParameter, UINT layerCount, UINT frameCount, const std::wstring& shaderFile)
+{
+	md3dDevice = device;
+
+	if (layerCount == 0 || layerCount > MaxLayers)
+		throw DxException(E_INVALIDARG, L"GpuCulling layer count", AnsiToWString(__FILE__), __LINE__);
+	mLayerCount = layerCount;
+
+	if (frameCount == 0)
+		throw DxException(E_INVALIDARG, L"GpuCulling frame count", AnsiToWString(__FILE__), __LINE__);
+	mFrameCount = frameCount;
+
+	BuildRootSignature();
+	BuildPso(shaderFile);
+	BuildCommandSignature(drawRootSignature, drawConstantsParameter);
+
+	CD3DX12_HEAP_PROPERTIES uploadHeap(D3D12_HEAP_TYPE_UPLOAD);
+	CD3DX12_RESOURCE_DESC zeroDesc = CD3DX12_RESOURCE_DESC::Buffer(CountsByteSize);
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&uploadHeap,
+		D3D12_HEAP_FLAG_NONE,
+		&zeroDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(mZeroCounts.GetAddressOf())));
+	GpuMemory::Track(mZeroCounts.Get(), MemoryCategory::Upload);
+
+	void* mapped = nullptr;
+	ThrowIfFailed(mZeroCounts->Map(0, nullptr, &mapped));
+	ZeroMemory(mapped, CountsByteSize);
+	mZeroCounts->Unmap(0, nullptr);
+
+	CD3DX12_HEAP_PROPERTIES readbackHeap(D3D12_HEAP_TYPE_READBACK);
+	CD3DX12_RESOURCE_DESC readbackDesc = CD3DX12_RESOURCE_DESC::Buffer(
+		(UINT64)mFrameCount * StatisticsCount * sizeof(UINT));
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&readbackHeap,
+		D3D12_HEAP_FLAG_NONE,
+		&readbackDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(mStatisticsReadback.GetAddressOf())));
+	GpuMemory::Track(mStatisticsReadback.Get(), MemoryCategory::Upload);
+	mStatisticsPending.assign(mFrameCount, false);
+
+	mConstants = std::make_unique<UploadBuffer<CullConstants>>(md3dDevice, 2 * mFrameCount, true);
+
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc;
+	heapDesc.NumDescriptors = 1;
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	heapDesc.NodeMask = 0;
+	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(mNullHiZHeap.GetAddressOf())));
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC nullSrvDesc = {};
+	nullSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	nullSrvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	nullSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	nullSrvDesc.Texture2D.MipLevels = 1;
+	md3dDevice->CreateShaderResourceView(nullptr, &nullSrvDesc,
+		mNullHiZHeap->GetCPUDescriptorHandleForHeapStart());
+}
+
+void GpuCulling::AddRecord(UINT layer, UINT objectIndex, UINT materialIndex,
+	const BoundingBox& bounds, const SubmeshGeometry* lods, UINT lodCount)
+{
+	if (layer >= mLayerCount || lodCount == 0)
+		throw DxException(E_INVALIDARG, L"GpuCulling record", AnsiToWString(__FILE__), __LINE__);
+
+	Record record;
+	record.ObjectIndex = objectIndex;
+	record.MaterialIndex = materialIndex;
+	record.Layer = layer;
+	record.FirstLod = (UINT)mLods.size();
+	record.LodCount = lodCount;
+	record.BoundsCenter = bounds.Center;
+	record.BoundsExtents = bounds.Extents;
+	mRecords.push_back(record);
+
+	for (UINT i = 0; i < lodCount; ++i)
+	{
+		Lod lod;
+		lod.IndexCount = lods[i].IndexCount;
+		lod.StartIndexLocation = lods[i].StartIndexLocation;
+		lod.BaseVertexLocation = lods[i].BaseVertexLocation;
+		lod.Error = lods[i].LodError;
+		mLods.push_back(lod);
+	}
+}
+
+void GpuCulling::Upload(ID3D12GraphicsCommandList* cmdList)
+{
+	// Each layer's draws go to its own contiguous part of the argument buffer.
+	std::stable_sort(mRecords.begin(), mRecords.end(),
+		[](const Record& a, const Record& b) { return a.Layer < b.Layer; });
+
+	for (UINT layer = 0; layer < mLayerCount; ++layer)
+	{
+		mLayerRecordCount[layer] = 0;
+		mLayerFirst[layer] = 0;
+	}
+	for (size_t i = 0; i < mRecords.size(); ++i)
+	{
+		const UINT layer = mRecords[i].Layer;
+		if (mLayerRecordCount[layer]++ == 0)
+			mLayerFirst[layer] = (UINT)i;
+	}
+
+	// Never empty, so the root SRVs always point at a valid buffer.
+	Record placeholderRecord;
+	Lod placeholderLod;
+	const void* records = mRecords.empty() ? (const void*)&placeholderRecord : (const void*)mRecords.data();
+	const void* lods = mLods.empty() ? (const void*)&placeholderLod : (const void*)mLods.data();
+	const UINT recordCount = (std::max)(RecordCount(), 1u);
+
+	mRecordBuffer = d3dUtil::CreateDefaultBuffer(md3dDevice, cmdList,
+		records, (UINT64)recordCount * sizeof(Record), mRecordUploader, MemoryCategory::Other);
+	mLodBuffer = d3dUtil::CreateDefaultBuffer(md3dDevice, cmdList,
+		lods, (UINT64)(std::max)(mLods.size(), (size_t)1) * sizeof(Lod), mLodUploader, MemoryCategory::Other);
+
+	CD3DX12_HEAP_PROPERTIES defaultHeap(D3D12_HEAP_TYPE_DEFAULT);
+	CD3DX12_RESOURCE_DESC argsDesc = CD3DX12_RESOURCE_DESC::Buffer(2 * (UINT64)recordCount * sizeof(IndirectDraw),
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+	CD3DX12_RESOURCE_DESC countsDesc = CD3DX12_RESOURCE_DESC::Buffer(CountsByteSize,
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+	CD3DX12_RESOURCE_DESC flagsDesc = CD3DX12_RESOURCE_DESC::Buffer((UINT64)recordCount * sizeof(UINT),
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&defaultHeap,
+		D3D12_HEAP_FLAG_NONE,
+		&argsDesc,
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(mDrawArgs.GetAddressOf())));
+	GpuMemory::Track(mDrawArgs.Get(), MemoryCategory::Other);
+
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&defaultHeap,
+		D3D12_HEAP_FLAG_NONE,
+		&countsDesc,
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(mDrawCounts.GetAddressOf())));
+	GpuMemory::Track(mDrawCounts.Get(), MemoryCategory::Other);
+
+	// Only ever a UAV; the early phase writes every early record's flag.
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&defaultHeap,
+		D3D12_HEAP_FLAG_NONE,
+		&flagsDesc,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+		nullptr,
+		IID_PPV_ARGS(mLateFlags.GetAddressOf())));
+	GpuMemory::Track(mLateFlags.Get(), MemoryCategory::Other);
+	mArgsWritten = false;
+}
+
+void GpuCulling::DisposeUploaders()
+{
+	mRecordUploader = nullptr;
+	mLodUploader = nullptr;
+}
+
+UINT GpuCulling::RecordCount()const
+{
+	return (UINT)mRecords.size();
+}
+
+UINT GpuCulling::LayerRecordCount(UINT layer)const
+{
+	return layer < mLayerCount ? mLayerRecordCount[layer] : 0;
+}
+
+void GpuCulling::SetOcclusion(HiZPyramid* hiZ, UINT earlyLayerMask)
+{
+	mHiZ = hiZ;
+	mEarlyLayerMask = earlyLayerMask;
+}
+
+void GpuCulling::Cull(ID3D12GraphicsCommandList* cmdList, UINT frameIndex,
+	D3D12_GPU_VIRTUAL_ADDRESS objects, UINT objectByteStride,
+	const XMFLOAT4X4& viewProj, const XMFLOAT3& eyePos, float pixelScale, float maxPixelError)
+{
+	mFrameIndex = frameIndex % mFrameCount;
+
+	// The GPU is done with this frame, so its counters have arrived.
+	if (mStatisticsPending[mFrameIndex])
+	{
+		const SIZE_T offset = (SIZE_T)mFrameIndex * StatisticsCount * sizeof(UINT);
+		D3D12_RANGE readRange = { offset, offset + StatisticsCount * sizeof(UINT) };
+		D3D12_RANGE writtenRange = { 0, 0 };
+
+		void* mapped = nullptr;
+		ThrowIfFailed(mStatisticsReadback->Map(0, &readRange, &mapped));
+		const UINT* counters = reinterpret_cast<const UINT*>((const BYTE*)mapped + offset);
+		mStatistics.Visible = counters[0];
+		mStatistics.FrustumCulled = counters[1];
+		mStatistics.Occluded = counters[2];
+		mStatistics.Rescued = counters[3];
+		mStatisticsReadback->Unmap(0, &writtenRange);
+	}
+
+	CullConstants constants = {};
+
+	// The same planes as FrustumCuller::SetViewProj(): with row vectors the rows of
+	// the transpose are the columns of viewProj.  The shader normalizes nothing;
+	// the box radius is scaled by the same factor.
+	XMMATRIX m = XMMatrixTranspose(XMLoadFloat4x4(&viewProj));
+	XMStoreFloat4(&constants.FrustumPlanes[0], m.r[3] + m.r[0]); // left
+	XMStoreFloat4(&constants.FrustumPlanes[1], m.r[3] - m.r[0]); // right
+	XMStoreFloat4(&constants.FrustumPlanes[2], m.r[3] + m.r[1]); // bottom
+	XMStoreFloat4(&constants.FrustumPlanes[3], m.r[3] - m.r[1]); // top
+	XMStoreFloat4(&constants.FrustumPlanes[4], m.r[2]);          // near
+	XMStoreFloat4(&constants.FrustumPlanes[5], m.r[3] - m.r[2]); // far
+
+	constants.EyePosW = eyePos;
+	constants.PixelScale = pixelScale;
+	constants.RecordCount = RecordCount();
+	constants.ObjectByteStride = objectByteStride;
+	constants.MaxPixelError = maxPixelError;
+	for (UINT layer = 0; layer < mLayerCount; ++layer)
+		constants.LayerFirst[layer] = mLayerFirst[layer];
+
+	// Without a pyramid every layer is done here.  With one, the early phase tests
+	// against last frame's pyramid once there is one.
+	mOcclusionActive = mHiZ != nullptr;
+	constants.Phase = EarlyPhase;
+	constants.EarlyLayerMask = mOcclusionActive ? mEarlyLayerMask : (1u << mLayerCount) - 1;
+	constants.UseOcclusion = mOcclusionActive && mHiZ->IsValid() ? 1 : 0;
+	if (constants.UseOcclusion)
+	{
+		XMStoreFloat4x4(&constants.OcclusionViewProj, XMMatrixTranspose(XMLoadFloat4x4(&mHiZViewProj)));
+		constants.HiZValidSize = XMFLOAT2((float)mHiZ->ValidWidth(), (float)mHiZ->ValidHeight());
+	}
+
+	mViewProj = viewProj;
+	mObjects = objects;
+	mLastConstants = constants;
+
+	// Before the first Cull() both buffers are still in their initial state.
+	const D3D12_RESOURCE_STATES argsState = mArgsWritten ?
+		D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT : D3D12_RESOURCE_STATE_COMMON;
+	const D3D12_RESOURCE_STATES countsState = mArgsWritten ?
+		D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT | D3D12_RESOURCE_STATE_COPY_SOURCE : D3D12_RESOURCE_STATE_COMMON;
+
+	D3D12_RESOURCE_BARRIER toWrite[] =
+	{
+		CD3DX12_RESOURCE_BARRIER::Transition(mDrawArgs.Get(), argsState, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+		CD3DX12_RESOURCE_BARRIER::Transition(mDrawCounts.Get(), countsState, D3D12_RESOURCE_STATE_COPY_DEST)
+	};
+	cmdList->ResourceBarrier(_countof(toWrite), toWrite);
+
+	cmdList->CopyBufferRegion(mDrawCounts.Get(), 0, mZeroCounts.Get(), 0, CountsByteSize);
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDrawCounts.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+
+	Dispatch(cmdList, constants, 2 * mFrameIndex);
+	mArgsWritten = true;
+}
+
+void GpuCulling::CullLate(ID3D12GraphicsCommandList* cmdList)
+{
+	if (!mOcclusionActive || !mArgsWritten)
+		return;
+
+	CullConstants constants = mLastConstants;
+	constants.Phase = LatePhase;
+	constants.UseOcclusion = mHiZ->IsValid() ? 1 : 0;
+	XMStoreFloat4x4(&constants.OcclusionViewProj, XMMatrixTranspose(XMLoadFloat4x4(&mViewProj)));
+	constants.HiZValidSize = XMFLOAT2((float)mHiZ->ValidWidth(), (float)mHiZ->ValidHeight());
+
+	// The pyramid now holds this frame's depth; next frame's early phase uses it.
+	mHiZViewProj = mViewProj;
+
+	D3D12_RESOURCE_BARRIER toWrite[] =
+	{
+		CD3DX12_RESOURCE_BARRIER::Transition(mDrawArgs.Get(),
+			D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+		CD3DX12_RESOURCE_BARRIER::Transition(mDrawCounts.Get(),
+			D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT | D3D12_RESOURCE_STATE_COPY_SOURCE,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+		CD3DX12_RESOURCE_BARRIER::UAV(mLateFlags.Get())
+	};
+	cmdList->ResourceBarrier(_countof(toWrite), toWrite);
+
+	Dispatch(cmdList, constants, 2 * mFrameIndex + 1);
+}
+
+bool GpuCulling::OcclusionActive()const
+{
+	return mOcclusionActive;
+}
+
+void GpuCulling::Draw(ID3D12GraphicsCommandList* cmdList, UINT layer, bool late)const
+{
+	if (layer >= mLayerCount || mLayerRecordCount[layer] == 0)
+		return;
+
+	// The GPU reads the draw count from mDrawCounts and stops there.
+	const UINT64 first = (late ? RecordCount() : 0) + mLayerFirst[layer];
+	const UINT64 slot = 2 * layer + (late ? 1 : 0);
+	cmdList->ExecuteIndirect(mCommandSignature.Get(), mLayerRecordCount[layer],
+		mDrawArgs.Get(), first * sizeof(IndirectDraw),
+		mDrawCounts.Get(), slot * sizeof(UINT));
+}
+
+const GpuCulling::Statistics& GpuCulling::CullStatistics()const
+{
+	return mStatistics;
+}
+
+void GpuCulling::Dispatch(ID3D12GraphicsCommandList* cmdList, const CullConstants& constants, UINT constantsIndex)
+{
+	mConstants->CopyData(constantsIndex, constants);
+	const UINT cbByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(CullConstants));
+
+	ID3D12DescriptorHeap* hiZHeap = mHiZ != nullptr ? mHiZ->DescriptorHeap() : mNullHiZHeap.Get();
+	D3D12_GPU_DESCRIPTOR_HANDLE hiZSrv = mHiZ != nullptr ?
+		mHiZ->Srv() : mNullHiZHeap->GetGPUDescriptorHandleForHeapStart();
+
+	ID3D12DescriptorHeap* descriptorHeaps[] = { hiZHeap };
+	cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+	cmdList->SetComputeRootSignature(mRootSignature.Get());
+	cmdList->SetPipelineState(mPso.Get());
+	cmdList->SetComputeRootConstantBufferView(0,
+		mConstants->Resource()->GetGPUVirtualAddress() + (UINT64)constantsIndex * cbByteSize);
+	cmdList->SetComputeRootShaderResourceView(1, mObjects);
+	cmdList->SetComputeRootShaderResourceView(2, mRecordBuffer->GetGPUVirtualAddress());
+	cmdList->SetComputeRootShaderResourceView(3, mLodBuffer->GetGPUVirtualAddress());
+	cmdList->SetComputeRootUnorderedAccessView(4, mDrawArgs->GetGPUVirtualAddress());
+	cmdList->SetComputeRootUnorderedAccessView(5, mDrawCounts->GetGPUVirtualAddress());
+	cmdList->SetComputeRootUnorderedAccessView(6, mLateFlags->GetGPUVirtualAddress());
+	cmdList->SetComputeRootDescriptorTable(7, hiZSrv);
+
+	// One thread per record.
+	if (RecordCount() > 0)
+		cmdList->Dispatch((RecordCount() + ThreadGroupSize - 1) / ThreadGroupSize, 1, 1);
+
+	D3D12_RESOURCE_BARRIER toDraw[] =
+	{
+		CD3DX12_RESOURCE_BARRIER::Transition(mDrawArgs.Get(),
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT),
+		CD3DX12_RESOURCE_BARRIER::Transition(mDrawCounts.Get(),
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+			D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT | D3D12_RESOURCE_STATE_COPY_SOURCE)
+	};
+	cmdList->ResourceBarrier(_countof(toDraw), toDraw);
+
+	// The late phase's copy lands after the early one's and replaces it.
+	cmdList->CopyBufferRegion(mStatisticsReadback.Get(), (UINT64)mFrameIndex * StatisticsCount * sizeof(UINT),
+		mDrawCounts.Get(), 2 * MaxLayers * sizeof(UINT), StatisticsCount * sizeof(UINT));
+	mStatisticsPending[mFrameIndex] = true;
+}
+
+void GpuCulling::BuildRootSignature()
+{
+	CD3DX12_DESCRIPTOR_RANGE hiZTable;
+	hiZTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 3);
+
+	CD3DX12_ROOT_PARAMETER slotRootParameter[8];
+	slotRootParameter[0].InitAsConstantBufferView(0);
+	slotRootParameter[1].InitAsShaderResourceView(0);    // objects
+	slotRootParameter[2].InitAsShaderResourceView(1);    // records
+	slotRootParameter[3].InitAsShaderResourceView(2);    // LODs
+	slotRootParameter[4].InitAsUnorderedAccessView(0);   // draw arguments
+	slotRootParameter[5].InitAsUnorderedAccessView(1);   // draw counts and statistics
+	slotRootParameter[6].InitAsUnorderedAccessView(2);   // late flags
+	slotRootParameter[7].InitAsDescriptorTable(1, &hiZTable);
+
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(8, slotRootParameter,
+		0, nullptr,
+		D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+	ComPtr<ID3DBlob> serializedRootSig = nullptr;
+	ComPtr<ID3DBlob> errorBlob = nullptr;
+	HRESULT hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1,
+		serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
+
+	if (errorBlob != nullptr)
+	{
+		::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+	}
+	ThrowIfFailed(hr);
+
+	ThrowIfFailed(md3dDevice->CreateRootSignature(
+		0,
+		serializedRootSig->GetBufferPointer(),
+		serializedRootSig->GetBufferSize(),
+		IID_PPV_ARGS(mRootSignature.GetAddressOf())));
+}
+
+void GpuCulling::BuildPso(const std::wstring& shaderFile)
+{
+	ComPtr<ID3DBlob> cs = d3dUtil::CompileShader(shaderFile, nullptr, "CullCS", "cs_5_0");
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
+	psoDesc.pRootSignature = mRootSignature.Get();
+	psoDesc.CS =
+	{
+		reinterpret_cast<BYTE*>(cs->GetBufferPointer()),
+		cs->GetBufferSize()
+	};
+	psoDesc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+	ThrowIfFailed(md3dDevice->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(mPso.GetAddressOf())));
+}
+
+void GpuCulling::BuildCommandSignature(ID3D12RootSignature* drawRootSignature, UINT drawConstantsParameter)
+{
+	// IndirectDraw: the two per-draw root constants, then the draw itself.
+	D3D12_INDIRECT_ARGUMENT_DESC arguments[2] = {};
+	arguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+	arguments[0].Constant.RootParameterIndex = drawConstantsParameter;
+	arguments[0].Constant.DestOffsetIn32BitValues = 0;
+	arguments[0].Constant.Num32BitValuesToSet = 2;
+	arguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+	D3D12_COMMAND_SIGNATURE_DESC signatureDesc = {};
+	signatureDesc.ByteStride = sizeof(IndirectDraw);
+	signatureDesc.NumArgumentDescs = _countof(arguments);
+	signatureDesc.pArgumentDescs = arguments;
+	signatureDesc.NodeMask = 0;
+
+	ThrowIfFailed(md3dDevice->CreateCommandSignature(&signatureDesc, drawRootSignature,
+		IID_PPV_ARGS(mCommandSignature.GetAddressOf())));
+}
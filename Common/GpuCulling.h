@@ -0,0 +1,241 @@
+//***************************************************************************************
+// GpuCulling.h
+//
+// GPU-driven drawing: the render items live in a structured buffer on the GPU, a
+// compute pass (Shader/GpuCulling.hlsl) tests them against the view frustum, and
+// each layer is drawn with one ExecuteIndirect over the items that survived.  The
+// CPU cost of a layer no longer depends on how many items it has.
+//
+// Each record holds an item's object and material index, its local bounds and a
+// range of the LOD table.  Its world matrix is read from the caller's object buffer
+// at cull time, so moving an item only updates that buffer.  One thread per record
+// transforms the bounds, tests the six planes, picks the coarsest LOD whose error
+// stays under a pixel and appends
+//
+//     { objectIndex, materialIndex, D3D12_DRAW_INDEXED_ARGUMENTS }
+//
+// to its layer's part of the argument buffer.  The command signature writes the two
+// indices to the caller's per-draw root constants, so the shaders are the same as
+// for DrawIndexedInstanced with SetGraphicsRoot32BitConstants.  All items of a layer
+// must share one vertex and index buffer, e.g. a GeometryPool.
+//
+// Neither visible items nor their order come back to the CPU: the draws of a layer
+// are in the order the threads reach the counter, not sorted by depth, and there is
+// no LOD hysteresis.
+//
+// With a HiZPyramid (SetOcclusion()) the culling also drops items hidden behind
+// others, in two phases so the depth they are tested against is never stale:
+//
+//   early  Cull() tests the early layers (those in earlyLayerMask, e.g. the opaque
+//          one) against last frame's pyramid, projected with last frame's viewProj.
+//          What it rejects is only flagged; the rest is drawn.
+//   late   CullLate(), after those draws and a HiZPyramid::Build() from them,
+//          re-tests the flagged items against this frame's pyramid and draws those
+//          that are visible after all (they were hidden last frame but are not
+//          now, e.g. behind a box that moved away), so nothing pops in a frame late.
+//          The other layers are culled here only, in one test against both.
+//
+// The early layers draw Draw(layer) after Cull() and Draw(layer, true) after
+// CullLate(); the others Draw(layer) after CullLate().  Until the pyramid has
+// been built once the early phase tests the frustum only.  Without a pyramid
+// Cull() tests every layer's frustum and CullLate() does nothing.
+//
+// CullStatistics() counts what the GPU decided a few frames ago; each Cull() reads
+// back the counters of the frame that last used its frame resource.
+//
+// Per frame:
+//     culling.Cull(cmdList, frameIndex, objectBuffer, sizeof(ObjectConstants), viewProj, eyePos, pixelScale);
+//     ... per layer: set the root signature, PSO, VB/IB and the other parameters ...
+//     culling.Draw(cmdList, layer);
+//     ... with occlusion: hiZ.Build(), culling.CullLate(cmdList), the late draws ...
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "UploadBuffer.h"
+
+class HiZPyramid;
+
+class GpuCulling
+{
+public:
+	// Must match GpuCulling.hlsl.
+	static const UINT MaxLayers = 8;
+	static const UINT ThreadGroupSize = 64;
+
+	// drawRootSignature is the one the layers are drawn with; its parameter
+	// drawConstantsParameter must be two 32-bit root constants (object, material).
+	// frameCount is the number of frame resources, which Cull() is indexed by.
+	GpuCulling(ID3D12Device* device, ID3D12RootSignature* drawRootSignature,
+		UINT drawConstantsParameter, UINT layerCount, UINT frameCount,
+		const std::wstring& shaderFile = L"../../Shader/GpuCulling.hlsl");
+	GpuCulling(const GpuCulling& rhs) = delete;
+	GpuCulling& operator=(const GpuCulling& rhs) = delete;
+	~GpuCulling() = default;
+
+	// Queues a draw of one of lods[0, lodCount) into layer, finest first; an item
+	// without LODs passes its one submesh.  bounds are in the item's local space.
+	void AddRecord(UINT layer, UINT objectIndex, UINT materialIndex,
+		const DirectX::BoundingBox& bounds, const SubmeshGeometry* lods, UINT lodCount);
+
+	// Groups the records by layer and records their copy into default heap buffers
+	// on cmdList.  Call once after the last AddRecord(), and DisposeUploaders() once
+	// cmdList has executed.
+	void Upload(ID3D12GraphicsCommandList* cmdList);
+	void DisposeUploaders();
+
+	UINT RecordCount()const;
+	UINT LayerRecordCount(UINT layer)const;
+
+	// Occlusion tests against hiZ from now on; nullptr turns them off.  Bit i of
+	// earlyLayerMask puts layer i in the early phase.
+	void SetOcclusion(HiZPyramid* hiZ, UINT earlyLayerMask);
+
+	// Records the culling dispatch on cmdList, which replaces the compute root
+	// signature, the PSO and the descriptor heaps.  objects is the GPU address of the
+	// object buffer, whose elements are objectByteStride apart and start with the
+	// world matrix as the shaders read it (stored transposed).  viewProj is
+	// untransposed; pixelScale is proj(1,1) * viewportHeight / 2, as for
+	// MeshSimplifier::SelectLod().  The GPU must be done with frame frameIndex.
+	void Cull(ID3D12GraphicsCommandList* cmdList, UINT frameIndex,
+		D3D12_GPU_VIRTUAL_ADDRESS objects, UINT objectByteStride,
+		const DirectX::XMFLOAT4X4& viewProj, const DirectX::XMFLOAT3& eyePos, float pixelScale,
+		float maxPixelError = 1.0f);
+
+	// Records the late phase, against the pyramid built since Cull(), with the
+	// arguments of the last Cull().  Does nothing without SetOcclusion().
+	void CullLate(ID3D12GraphicsCommandList* cmdList);
+
+	// True if the last Cull() left work to CullLate().
+	bool OcclusionActive()const;
+
+	// Draws the visible items of layer with one ExecuteIndirect: those of the last
+	// Cull(), or with late those that only CullLate() found visible.
+	void Draw(ID3D12GraphicsCommandList* cmdList, UINT layer, bool late = false)const;
+
+	struct Statistics
+	{
+		UINT Visible = 0;
+		UINT FrustumCulled = 0;
+		UINT Occluded = 0;
+
+		// Rejected by the early phase, then drawn by the late one.
+		UINT Rescued = 0;
+	};
+
+	// From the last frame whose counters have come back.
+	const Statistics& CullStatistics()const;
+
+private:
+	// Must match the structs in GpuCulling.hlsl.
+	struct Record
+	{
+		UINT ObjectIndex = 0;
+		UINT MaterialIndex = 0;
+		UINT Layer = 0;
+		UINT FirstLod = 0;
+		DirectX::XMFLOAT3 BoundsCenter = { 0.0f, 0.0f, 0.0f };
+		UINT LodCount = 1;
+		DirectX::XMFLOAT3 BoundsExtents = { 0.0f, 0.0f, 0.0f };
+		UINT Pad = 0;
+	};
+
+	struct Lod
+	{
+		UINT IndexCount = 0;
+		UINT StartIndexLocation = 0;
+		INT BaseVertexLocation = 0;
+		float Error = 0.0f;
+	};
+
+	struct IndirectDraw
+	{
+		UINT ObjectIndex;
+		UINT MaterialIndex;
+		D3D12_DRAW_INDEXED_ARGUMENTS Args;
+	};
+
+	struct CullConstants
+	{
+		DirectX::XMFLOAT4 FrustumPlanes[6];
+		DirectX::XMFLOAT4X4 OcclusionViewProj;
+		DirectX::XMFLOAT3 EyePosW;
+		float PixelScale;
+		UINT RecordCount;
+		UINT ObjectByteStride;
+		float MaxPixelError;
+		UINT Phase;
+		UINT EarlyLayerMask;
+		UINT UseOcclusion;
+		DirectX::XMFLOAT2 HiZValidSize;
+		UINT LayerFirst[MaxLayers];
+	};
+
+	// The counters after the 2 * MaxLayers draw counts, in Statistics order.
+	static const UINT StatisticsCount = 4;
+	static const UINT CountsByteSize = (2 * MaxLayers + StatisticsCount) * sizeof(UINT);
+
+	enum Phase { EarlyPhase = 0, LatePhase = 1 };
+
+	void Dispatch(ID3D12GraphicsCommandList* cmdList, const CullConstants& constants, UINT constantsIndex);
+
+	void BuildRootSignature();
+	void BuildPso(const std::wstring& shaderFile);
+	void BuildCommandSignature(ID3D12RootSignature* drawRootSignature, UINT drawConstantsParameter);
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+
+	UINT mLayerCount = 0;
+	UINT mFrameCount = 0;
+	UINT mLayerFirst[MaxLayers] = {};
+	UINT mLayerRecordCount[MaxLayers] = {};
+
+	std::vector<Record> mRecords;
+	std::vector<Lod> mLods;
+
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> mPso = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12CommandSignature> mCommandSignature = nullptr;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mRecordBuffer = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mLodBuffer = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mRecordUploader = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mLodUploader = nullptr;
+
+	// Written by Cull(), read by Draw().  Frames run in order on one queue, so one
+	// copy serves every frame in flight.  The arguments hold an early and a late
+	// region of RecordCount() draws each; the late flags mark the records the early
+	// phase left to CullLate().
+	Microsoft::WRL::ComPtr<ID3D12Resource> mDrawArgs = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mDrawCounts = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mLateFlags = nullptr;
+	bool mArgsWritten = false;
+
+	// Zeros that reset mDrawCounts before every Cull().
+	Microsoft::WRL::ComPtr<ID3D12Resource> mZeroCounts = nullptr;
+
+	// Two constant buffers per frame, one per phase.
+	std::unique_ptr<UploadBuffer<CullConstants>> mConstants = nullptr;
+	CullConstants mLastConstants = {};
+	UINT mFrameIndex = 0;
+
+	HiZPyramid* mHiZ = nullptr;
+	UINT mEarlyLayerMask = 0;
+	bool mOcclusionActive = false;
+
+	// The viewProj and object buffer of the last Cull(), for CullLate(), and the
+	// viewProj the pyramid was built with, for the next early phase.
+	DirectX::XMFLOAT4X4 mViewProj = MathHelper::Identity4x4();
+	DirectX::XMFLOAT4X4 mHiZViewProj = MathHelper::Identity4x4();
+	D3D12_GPU_VIRTUAL_ADDRESS mObjects = 0;
+
+	// A null SRV to bind in place of the pyramid when there is none.
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mNullHiZHeap = nullptr;
+
+	// The counters of each frame, copied at the end of its last phase.
+	Microsoft::WRL::ComPtr<ID3D12Resource> mStatisticsReadback = nullptr;
+	std::vector<bool> mStatisticsPending;
+	Statistics mStatistics;
+};
@@ -0,0 +1,199 @@
+//***************************************************************************************
+// GpuMemory.cpp
+//***************************************************************************************
+
+#include "GpuMemory.h"
+#include <atomic>
+#include <iomanip>
+#include <sstream>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// The private data slot of the tag on every tracked resource.
+	// {6D0F3A4C-2B1E-4F8A-9C53-1A7E44D2903B}
+	const GUID GpuMemoryTagGuid =
+		{ 0x6d0f3a4c, 0x2b1e, 0x4f8a, { 0x9c, 0x53, 0x1a, 0x7e, 0x44, 0xd2, 0x90, 0x3b } };
+
+	std::atomic<UINT64> gBytes[(int)MemoryCategory::Count];
+	std::atomic<UINT> gCounts[(int)MemoryCategory::Count];
+
+	// Counted while it lives, which is as long as the resource holding it.
+	class AllocationTag : public IUnknown
+	{
+	public:
+		AllocationTag(MemoryCategory category, UINT64 bytes) :
+			mCategory(category), mBytes(bytes)
+		{
+			gBytes[(int)mCategory] += mBytes;
+			++gCounts[(int)mCategory];
+		}
+
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override
+		{
+			if (object == nullptr)
+				return E_POINTER;
+
+			if (riid == __uuidof(IUnknown))
+			{
+				*object = static_cast<IUnknown*>(this);
+				AddRef();
+				return S_OK;
+			}
+
+			*object = nullptr;
+			return E_NOINTERFACE;
+		}
+
+		ULONG STDMETHODCALLTYPE AddRef() override
+		{
+			return ++mRefCount;
+		}
+
+		ULONG STDMETHODCALLTYPE Release() override
+		{
+			ULONG refCount = --mRefCount;
+			if (refCount == 0)
+				delete this;
+			return refCount;
+		}
+
+	private:
+		~AllocationTag()
+		{
+			gBytes[(int)mCategory] -= mBytes;
+			--gCounts[(int)mCategory];
+		}
+
+		std::atomic<ULONG> mRefCount{ 1 };
+		MemoryCategory mCategory;
+		UINT64 mBytes;
+	};
+
+	std::wstring Megabytes(UINT64 bytes)
+	{
+		std::wostringstream text;
+		text << std::fixed << std::setprecision(1) << (double)bytes / (1024.0 * 1024.0);
+		return text.str();
+	}
+}
+
+void GpuMemory::Track(ID3D12Resource* resource, MemoryCategory category)
+{
+	if (resource == nullptr)
+		return;
+
+	ComPtr<ID3D12Device> device;
+	if (FAILED(resource->GetDevice(IID_PPV_ARGS(device.GetAddressOf()))))
+		return;
+
+	D3D12_RESOURCE_DESC desc = resource->GetDesc();
+	D3D12_RESOURCE_ALLOCATION_INFO info = device->GetResourceAllocationInfo(0, 1, &desc);
+
+	// The resource takes its own reference, and drops an older tag's.
+	AllocationTag* tag = new AllocationTag(category, info.SizeInBytes);
+	resource->SetPrivateDataInterface(GpuMemoryTagGuid, tag);
+	tag->Release();
+}
+
+UINT64 GpuMemory::Bytes(MemoryCategory category)
+{
+	return gBytes[(int)category];
+}
+
+UINT GpuMemory::Count(MemoryCategory category)
+{
+	return gCounts[(int)category];
+}
+
+UINT64 GpuMemory::TotalBytes()
+{
+	UINT64 total = 0;
+	for (int i = 0; i < (int)MemoryCategory::Count; ++i)
+		total += gBytes[i];
+	return total;
+}
+
+const wchar_t* GpuMemory::CategoryName(MemoryCategory category)
+{
+	switch (category)
+	{
+	case MemoryCategory::Geometry:     return L"geometry";
+	case MemoryCategory::Texture:      return L"texture";
+	case MemoryCategory::Upload:       return L"upload";
+	case MemoryCategory::RenderTarget: return L"target";
+	case MemoryCategory::Other:        return L"other";
+	default:                           return L"?";
+	}
+}
+
+std::wstring GpuMemory::Summary()
+{
+	std::wstring text;
+	for (int i = 0; i < (int)MemoryCategory::Count; ++i)
+	{
+		if (i > 0)
+			text += L"  ";
+		text += std::wstring(CategoryName((MemoryCategory)i)) + L" " + Megabytes(gBytes[i]);
+	}
+	return text;
+}
+
+VideoMemoryBudget::VideoMemoryBudget(IDXGIFactory4* factory, ID3D12Device* device)
+{
+	// Without DXGI 1.4 the numbers stay zero and nothing is ever over budget.
+	if (FAILED(factory->EnumAdapterByLuid(device->GetAdapterLuid(), IID_PPV_ARGS(mAdapter.GetAddressOf()))))
+		mAdapter = nullptr;
+
+	Update();
+}
+
+void VideoMemoryBudget::Update()
+{
+	if (mAdapter == nullptr)
+		return;
+
+	DXGI_QUERY_VIDEO_MEMORY_INFO local = {};
+	DXGI_QUERY_VIDEO_MEMORY_INFO nonLocal = {};
+	if (SUCCEEDED(mAdapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &local)))
+		mLocal = local;
+	if (SUCCEEDED(mAdapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL, &nonLocal)))
+		mNonLocal = nonLocal;
+
+	if (mLimit > 0 && mLimit < mLocal.Budget)
+		mLocal.Budget = mLimit;
+}
+
+void VideoMemoryBudget::SetLimit(UINT64 limit)
+{
+	mLimit = limit;
+	Update();
+}
+
+const DXGI_QUERY_VIDEO_MEMORY_INFO& VideoMemoryBudget::Local()const
+{
+	return mLocal;
+}
+
+const DXGI_QUERY_VIDEO_MEMORY_INFO& VideoMemoryBudget::NonLocal()const
+{
+	return mNonLocal;
+}
+
+UINT64 VideoMemoryBudget::OverBudget(float fraction)const
+{
+	UINT64 target = (UINT64)((double)mLocal.Budget * fraction);
+	return mLocal.CurrentUsage > target ? mLocal.CurrentUsage - target : 0;
+}
+
+UINT64 VideoMemoryBudget::Headroom(float fraction)const
+{
+	UINT64 target = (UINT64)((double)mLocal.Budget * fraction);
+	return mLocal.CurrentUsage < target ? target - mLocal.CurrentUsage : 0;
+}
+
+std::wstring VideoMemoryBudget::Summary()const
+{
+	return Megabytes(mLocal.CurrentUsage) + L"/" + Megabytes(mLocal.Budget) + L" MB";
+}
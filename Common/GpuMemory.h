@@ -0,0 +1,91 @@
+//***************************************************************************************
+// GpuMemory.h
+//
+// Video memory bookkeeping.
+//
+// GpuMemory counts the resources the Common helpers create, per category.  Track()
+// attaches a small COM object to the resource as private data; the resource
+// releases it when it is destroyed, which takes the bytes off the count, so no
+// helper has to report its frees.  The sizes are GetResourceAllocationInfo()'s,
+// i.e. with alignment.  Resources placed in a heap count on their own, so they
+// must not overlap another tracked resource.
+//
+// VideoMemoryBudget asks DXGI for the budget the OS gives the process and what the
+// process uses of it (IDXGIAdapter3::QueryVideoMemoryInfo).  Going over the local
+// budget is what makes the OS page memory out under the app, or remove the device;
+// TextureStreamer::Evict() gives memory back before that happens.
+//
+//     budget.Update();                              // once per frame
+//     if (budget.OverBudget(0.9f) > 0) ...          // trim to 90% of the budget
+//***************************************************************************************
+
+#pragma once
+
+#include <windows.h>
+#include <wrl.h>
+#include <dxgi1_4.h>
+#include <d3d12.h>
+#include <string>
+
+enum class MemoryCategory : int
+{
+	Geometry = 0,     // vertex, index and other mesh buffers
+	Texture,          // sampled textures
+	Upload,           // upload and readback heaps
+	RenderTarget,     // render targets, depth buffers and other screen-sized textures
+	Other,            // compute scratch and indirect argument buffers
+	Count
+};
+
+class GpuMemory
+{
+public:
+	// Counts resource in category until it is destroyed.  Tracking a resource
+	// again moves it to the new category.
+	static void Track(ID3D12Resource* resource, MemoryCategory category);
+
+	static UINT64 Bytes(MemoryCategory category);
+	static UINT Count(MemoryCategory category);
+	static UINT64 TotalBytes();
+
+	static const wchar_t* CategoryName(MemoryCategory category);
+
+	// "geometry 1.2   texture 10.5   ..." in megabytes, for the caption.
+	static std::wstring Summary();
+};
+
+class VideoMemoryBudget
+{
+public:
+	// Finds the adapter device was created on.
+	VideoMemoryBudget(IDXGIFactory4* factory, ID3D12Device* device);
+	VideoMemoryBudget(const VideoMemoryBudget& rhs) = delete;
+	VideoMemoryBudget& operator=(const VideoMemoryBudget& rhs) = delete;
+	~VideoMemoryBudget() = default;
+
+	// Queries both segment groups.  Does nothing where DXGI 1.4 is missing.
+	void Update();
+
+	// Caps the local budget at limit bytes, 0 for none, e.g. to try eviction on
+	// a card with plenty of memory.
+	void SetLimit(UINT64 limit);
+
+	// Device memory; system memory the GPU reads over the bus.  Budget is already
+	// capped by SetLimit().
+	const DXGI_QUERY_VIDEO_MEMORY_INFO& Local()const;
+	const DXGI_QUERY_VIDEO_MEMORY_INFO& NonLocal()const;
+
+	// Bytes the local usage is over fraction * Budget, and under it.
+	UINT64 OverBudget(float fraction)const;
+	UINT64 Headroom(float fraction)const;
+
+	// "used/budget MB".
+	std::wstring Summary()const;
+
+private:
+	Microsoft::WRL::ComPtr<IDXGIAdapter3> mAdapter;
+
+	UINT64 mLimit = 0;
+	DXGI_QUERY_VIDEO_MEMORY_INFO mLocal = {};
+	DXGI_QUERY_VIDEO_MEMORY_INFO mNonLocal = {};
+};
@@ -0,0 +1,246 @@
+//***************************************************************************************
+// GpuProfiler.cpp
+//***************************************************************************************
+
+#include "GpuProfiler.h"
+
+using Microsoft::WRL::ComPtr;
+
+GpuProfiler::GpuProfiler(ID3D12Device* device, ID3D12CommandQueue* queue, UINT frameCount, UINT maxScopesPerFrame) :
+	mFrameCount(frameCount),
+	mMaxScopes(maxScopesPerFrame),
+	mFrameScopes(frameCount),
+	mQueue(queue)
+{
+	UINT64 frequency = 0;
+	ThrowIfFailed(queue->GetTimestampFrequency(&frequency));
+	mTicksToMs = 1000.0 / (double)frequency;
+
+	LARGE_INTEGER cpuFrequency;
+	QueryPerformanceFrequency(&cpuFrequency);
+	mCpuTicksToMs = 1000.0 / (double)cpuFrequency.QuadPart;
+
+	// Two timestamps per scope, one slice per frame resource.
+	const UINT queryCount = 2 * mMaxScopes * mFrameCount;
+
+	D3D12_QUERY_HEAP_DESC heapDesc = {};
+	heapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	heapDesc.Count = queryCount;
+	heapDesc.NodeMask = 0;
+	ThrowIfFailed(device->CreateQueryHeap(&heapDesc, IID_PPV_ARGS(mQueryHeap.GetAddressOf())));
+
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(queryCount * sizeof(UINT64)),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(mReadbackBuffer.GetAddressOf())));
+	GpuMemory::Track(mReadbackBuffer.Get(), MemoryCategory::Upload);
+}
+
+void GpuProfiler::BeginFrame(UINT frameIndex)
+{
+	mCurrFrame = frameIndex;
+
+	std::vector<std::string>& scopes = mFrameScopes[mCurrFrame];
+	if (!scopes.empty())
+	{
+		const UINT firstQuery = 2 * mMaxScopes * mCurrFrame;
+
+		D3D12_RANGE readRange = { firstQuery * sizeof(UINT64), (firstQuery + 2 * scopes.size()) * sizeof(UINT64) };
+		UINT64* mapped = nullptr;
+		ThrowIfFailed(mReadbackBuffer->Map(0, &readRange, reinterpret_cast<void**>(&mapped)));
+		const UINT64* timestamps = mapped + firstQuery;
+
+		// A GPU timestamp and the CPU clock at the same moment; the frame is a few
+		// milliseconds old, so the difference to it is negative.
+		UINT64 gpuCalibration = 0;
+		UINT64 cpuCalibration = 0;
+		ThrowIfFailed(mQueue->GetClockCalibration(&gpuCalibration, &cpuCalibration));
+		auto cpuMs = [&](UINT64 gpuTimestamp)
+		{
+			return (double)cpuCalibration * mCpuTicksToMs +
+				(double)(INT64)(gpuTimestamp - gpuCalibration) * mTicksToMs;
+		};
+
+		struct FrameTime
+		{
+			std::string Name;
+			float Ms;
+			UINT64 Begin;
+			UINT64 End;
+		};
+
+		// Sum the scopes of each name first, so split layers add one sample.
+		std::vector<FrameTime> frameTimes;
+		for (size_t i = 0; i < scopes.size(); ++i)
+		{
+			UINT64 begin = timestamps[2 * i + 0];
+			UINT64 end = timestamps[2 * i + 1];
+			float ms = end > begin ? (float)((end - begin) * mTicksToMs) : 0.0f;
+
+			auto it = std::find_if(frameTimes.begin(), frameTimes.end(),
+				[&](const FrameTime& t) { return t.Name == scopes[i]; });
+			if (it != frameTimes.end())
+			{
+				it->Ms += ms;
+				it->Begin = (std::min)(it->Begin, begin);
+				it->End = (std::max)(it->End, end);
+			}
+			else
+			{
+				frameTimes.push_back({ scopes[i], ms, begin, end });
+			}
+		}
+
+		D3D12_RANGE writeRange = { 0, 0 };
+		mReadbackBuffer->Unmap(0, &writeRange);
+
+		for (const auto& t : frameTimes)
+			FindHistory(t.Name).Add(t.Ms, cpuMs(t.Begin), cpuMs(t.End));
+	}
+
+	scopes.clear();
+}
+
+UINT GpuProfiler::AddScope(const std::string& name)
+{
+	std::vector<std::string>& scopes = mFrameScopes[mCurrFrame];
+	assert(scopes.size() < mMaxScopes);
+
+	scopes.push_back(name);
+	return (UINT)scopes.size() - 1;
+}
+
+void GpuProfiler::BeginScope(ID3D12GraphicsCommandList* cmdList, UINT scope)
+{
+	cmdList->EndQuery(mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * (mMaxScopes * mCurrFrame + scope) + 0);
+}
+
+void GpuProfiler::EndScope(ID3D12GraphicsCommandList* cmdList, UINT scope)
+{
+	cmdList->EndQuery(mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * (mMaxScopes * mCurrFrame + scope) + 1);
+}
+
+void GpuProfiler::EndFrame(ID3D12GraphicsCommandList* cmdList)
+{
+	const UINT scopeCount = (UINT)mFrameScopes[mCurrFrame].size();
+	if (scopeCount == 0)
+		return;
+
+	const UINT firstQuery = 2 * mMaxScopes * mCurrFrame;
+	cmdList->ResolveQueryData(mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+		firstQuery, 2 * scopeCount, mReadbackBuffer.Get(), firstQuery * sizeof(UINT64));
+}
+
+float GpuProfiler::GpuTime(const std::string& name)const
+{
+	for (const auto& history : mHistories)
+	{
+		if (history.Name == name)
+			return history.Average();
+	}
+	return 0.0f;
+}
+
+float GpuProfiler::LatestGpuTime(const std::string& name)const
+{
+	for (const auto& history : mHistories)
+	{
+		if (history.Name == name)
+			return history.Latest();
+	}
+	return 0.0f;
+}
+
+std::vector<std::pair<std::string, float>> GpuProfiler::GpuTimes()const
+{
+	std::vector<std::pair<std::string, float>> times;
+	for (const auto& history : mHistories)
+		times.push_back({ history.Name, history.Average() });
+	return times;
+}
+
+std::wstring GpuProfiler::Summary()const
+{
+	std::wstring summary;
+	for (const auto& history : mHistories)
+	{
+		wchar_t buffer[32];
+		swprintf_s(buffer, L": %.3f ms", history.Average());
+
+		if (!summary.empty())
+			summary += L"   ";
+		summary += AnsiToWString(history.Name) + buffer;
+	}
+	return summary;
+}
+
+float GpuProfiler::Overlap(const GpuProfiler& a, const std::string& nameA,
+	const GpuProfiler& b, const std::string& nameB)
+{
+	const ScopeHistory* historyA = a.FindHistory(nameA);
+	const ScopeHistory* historyB = b.FindHistory(nameB);
+	if (historyA == nullptr || historyB == nullptr || historyA->SampleCount == 0)
+		return 0.0f;
+
+	// One sample per frame on each queue, so the intervals of b do not overlap
+	// each other and the intersections simply add up.
+	double overlap = 0.0;
+	for (UINT i = 0; i < historyA->SampleCount; ++i)
+	{
+		for (UINT j = 0; j < historyB->SampleCount; ++j)
+		{
+			double start = (std::max)(historyA->Starts[i], historyB->Starts[j]);
+			double end = (std::min)(historyA->Ends[i], historyB->Ends[j]);
+			if (end > start)
+				overlap += end - start;
+		}
+	}
+	return (float)(overlap / historyA->SampleCount);
+}
+
+const GpuProfiler::ScopeHistory* GpuProfiler::FindHistory(const std::string& name)const
+{
+	for (const auto& history : mHistories)
+	{
+		if (history.Name == name)
+			return &history;
+	}
+	return nullptr;
+}
+
+GpuProfiler::ScopeHistory& GpuProfiler::FindHistory(const std::string& name)
+{
+	for (auto& history : mHistories)
+	{
+		if (history.Name == name)
+			return history;
+	}
+
+	mHistories.push_back(ScopeHistory());
+	mHistories.back().Name = name;
+	return mHistories.back();
+}
+
+void GpuProfiler::ScopeHistory::Add(float ms, double start, double end)
+{
+	Sum += ms - Samples[NextSample];
+	Samples[NextSample] = ms;
+	Starts[NextSample] = start;
+	Ends[NextSample] = end;
+	NextSample = (NextSample + 1) % HistoryLength;
+	if (SampleCount < HistoryLength)
+		++SampleCount;
+}
+
+float GpuProfiler::ScopeHistory::Average()const
+{
+	return SampleCount > 0 ? Sum / SampleCount : 0.0f;
+}
+
+float GpuProfiler::ScopeHistory::Latest()const
+{
+	return SampleCount > 0 ? Samples[(NextSample + HistoryLength - 1) % HistoryLength] : 0.0f;
+}
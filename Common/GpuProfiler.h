@@ -0,0 +1,113 @@
+//***************************************************************************************
+// GpuProfiler.h
+//
+// Measures how long sections of the GPU work take with timestamp queries.
+//
+// Each frame resource owns a slice of the query heap and of a readback buffer.  The
+// frame's timestamps are resolved into its slice at the end of the frame and read
+// back the next time that frame resource comes around, when its fence has already
+// completed -- so reading the results never stalls.
+//
+// Per frame:
+//     profiler.BeginFrame(frameIndex);              // after waiting on that frame's fence
+//     UINT s = profiler.AddScope("opaque");         // on the recording thread, in order
+//     profiler.BeginScope(cmdList, s);              // from any thread
+//     ...
+//     profiler.EndScope(cmdList, s);
+//     profiler.EndFrame(lastCmdList);               // in the last list submitted
+//
+// Scopes with the same name are summed per frame, so a layer split over several
+// command lists reports one time.  Times are averaged over the last frames.
+//
+// Each queue needs its own profiler.  Their timestamps are put on the CPU clock
+// with the queue's clock calibration, so Overlap() can tell how much of one queue's
+// scope ran while the other queue was busy with another, e.g. async compute work
+// hidden behind the graphics work.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class GpuProfiler
+{
+public:
+	GpuProfiler(ID3D12Device* device, ID3D12CommandQueue* queue, UINT frameCount, UINT maxScopesPerFrame = 64);
+	GpuProfiler(const GpuProfiler& rhs) = delete;
+	GpuProfiler& operator=(const GpuProfiler& rhs) = delete;
+	~GpuProfiler() = default;
+
+	// Reads back the results last recorded for frameIndex and starts recording it again.
+	// The GPU must be done with that frame, which it is once its fence has completed.
+	void BeginFrame(UINT frameIndex);
+
+	// Reserves a scope for this frame.  Not thread safe; call before recording the lists.
+	UINT AddScope(const std::string& name);
+
+	// Write the scope's timestamps.  Different scopes may be written from different threads.
+	void BeginScope(ID3D12GraphicsCommandList* cmdList, UINT scope);
+	void EndScope(ID3D12GraphicsCommandList* cmdList, UINT scope);
+
+	// Resolves this frame's queries into its readback slice.  Record it in the command
+	// list that executes after every other list containing a scope of this frame.
+	void EndFrame(ID3D12GraphicsCommandList* cmdList);
+
+	// Average GPU milliseconds of the scopes called name, or 0 if there are none yet.
+	float GpuTime(const std::string& name)const;
+
+	// Milliseconds of the most recent frame read back, for controllers that should
+	// not lag behind the average.
+	float LatestGpuTime(const std::string& name)const;
+
+	// (name, average milliseconds) of every scope, in the order they were first seen.
+	std::vector<std::pair<std::string, float>> GpuTimes()const;
+
+	// "name: 0.123 ms" for every scope, for the window caption or a log.
+	std::wstring Summary()const;
+
+	// Average GPU milliseconds per frame that scope nameA of a ran while scope nameB
+	// of b was running, over the frames both still remember.  a and b profile
+	// different queues.
+	static float Overlap(const GpuProfiler& a, const std::string& nameA,
+		const GpuProfiler& b, const std::string& nameB);
+
+private:
+	static const UINT HistoryLength = 64;
+
+	struct ScopeHistory
+	{
+		std::string Name;
+		float Samples[HistoryLength] = {};
+
+		// CPU clock milliseconds of the first begin and last end of each sample.
+		double Starts[HistoryLength] = {};
+		double Ends[HistoryLength] = {};
+		UINT SampleCount = 0;
+		UINT NextSample = 0;
+		float Sum = 0.0f;
+
+		void Add(float ms, double start, double end);
+		float Average()const;
+		float Latest()const;
+	};
+
+	ScopeHistory& FindHistory(const std::string& name);
+	const ScopeHistory* FindHistory(const std::string& name)const;
+
+private:
+	UINT mFrameCount = 0;
+	UINT mMaxScopes = 0;
+	UINT mCurrFrame = 0;
+	double mTicksToMs = 0.0;
+
+	ID3D12CommandQueue* mQueue = nullptr;
+	double mCpuTicksToMs = 0.0;
+
+	Microsoft::WRL::ComPtr<ID3D12QueryHeap> mQueryHeap;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mReadbackBuffer;
+
+	// Scope names recorded for each frame resource, waiting to be read back.
+	std::vector<std::vector<std::string>> mFrameScopes;
+
+	std::vector<ScopeHistory> mHistories;
+};
@@ -0,0 +1,115 @@
+//***************************************************************************************
+// GpuWaves.h
+//
+// Performs the calculations for the wave simulation using the ComputeShader on the GPU.
+// The solution is saved to a floating-point texture.  The client must then set this
+// texture as a SRV and do the displacement mapping in the vertex shader over a grid.
+//
+// Mirrors the interface of the CPU Waves class so a demo can keep the CPU
+// version as a fallback and pick either one at startup.
+//
+// Update() and Disturb() can be recorded on a compute queue's command list.  The
+// solutions the shaders read stay in ReadState, which both queues can use, so the
+// step to the next solution may run while the vertex shader still draws the current
+// one.  The step overwrites the solution from two steps ago: the frames that drew
+// it must be done first.  Disturb() changes the current solution in place, so call
+// it right after an Update() that stepped, before anything draws the result.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class GpuWaves
+{
+public:
+	// State of the solutions that are read, valid on direct and compute queues.
+	static const D3D12_RESOURCE_STATES ReadState = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+
+	// m,n need not be multiples of the 16x16 thread group; the shader
+	// skips threads that fall outside the grid interior.
+	GpuWaves(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList,
+		int m, int n, float dx, float dt, float speed, float damping);
+	GpuWaves(const GpuWaves& rhs) = delete;
+	GpuWaves& operator=(const GpuWaves& rhs) = delete;
+	~GpuWaves() = default;
+
+	UINT RowCount()const;
+	UINT ColumnCount()const;
+	UINT VertexCount()const;
+	UINT TriangleCount()const;
+	float Width()const;
+	float Depth()const;
+	float SpatialStep()const;
+
+	// SRV of the current solution, sampled by the vertex shader.
+	CD3DX12_GPU_DESCRIPTOR_HANDLE DisplacementMap()const;
+
+	// Number of CBV/SRV/UAV descriptors BuildDescriptors() writes.
+	UINT DescriptorCount()const;
+
+	void BuildDescriptors(
+		CD3DX12_CPU_DESCRIPTOR_HANDLE hCpuDescriptor,
+		CD3DX12_GPU_DESCRIPTOR_HANDLE hGpuDescriptor,
+		UINT descriptorSize);
+
+	// Root signature layout expected by Update()/Disturb():
+	//   0: 6 root constants (b0)
+	//   1: SRV table t0 (previous solution)
+	//   2: SRV table t1 (current solution)
+	//   3: UAV table u0 (output)
+	void BuildRootSignature(ID3D12Device* device, Microsoft::WRL::ComPtr<ID3D12RootSignature>& rootSig);
+
+	// Returns whether a time step was taken and recorded.
+	bool Update(
+		float dt,
+		ID3D12GraphicsCommandList* cmdList,
+		ID3D12RootSignature* rootSig,
+		ID3D12PipelineState* pso);
+
+	void Disturb(
+		ID3D12GraphicsCommandList* cmdList,
+		ID3D12RootSignature* rootSig,
+		ID3D12PipelineState* pso,
+		UINT i, UINT j,
+		float magnitude);
+
+	// Texture uploads are recorded on the command list passed to the constructor,
+	// so the staging buffers must live until that list has executed.
+	void DisposeUploaders();
+
+private:
+	void BuildResources(ID3D12GraphicsCommandList* cmdList);
+
+private:
+	UINT mNumRows = 0;
+	UINT mNumCols = 0;
+
+	UINT mVertexCount = 0;
+	UINT mTriangleCount = 0;
+
+	// Simulation constants we can precompute.
+	float mK[3];
+
+	float mTimeStep = 0.0f;
+	float mSpatialStep = 0.0f;
+	float mAccumTime = 0.0f;
+
+	ID3D12Device* md3dDevice = nullptr;
+
+	CD3DX12_GPU_DESCRIPTOR_HANDLE mPrevSolSrv;
+	CD3DX12_GPU_DESCRIPTOR_HANDLE mCurrSolSrv;
+	CD3DX12_GPU_DESCRIPTOR_HANDLE mNextSolSrv;
+
+	CD3DX12_GPU_DESCRIPTOR_HANDLE mPrevSolUav;
+	CD3DX12_GPU_DESCRIPTOR_HANDLE mCurrSolUav;
+	CD3DX12_GPU_DESCRIPTOR_HANDLE mNextSolUav;
+
+	// Three solutions rotated every time step, so no copies are needed.
+	Microsoft::WRL::ComPtr<ID3D12Resource> mPrevSol = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mCurrSol = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mNextSol = nullptr;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mPrevUploadBuffer = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mCurrUploadBuffer = nullptr;
+};
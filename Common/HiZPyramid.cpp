@@ -0,0 +1,262 @@
+//***************************************************************************************
+// HiZPyramid.cpp
+//***************************************************************************************
+
+#include "HiZPyramid.h"
+
+using Microsoft::WRL::ComPtr;
+
+HiZPyramid::HiZPyramid(ID3D12Device* device, ID3D12Resource* depthBuffer, DXGI_FORMAT depthSrvFormat,
+	const std::wstring& shaderFile)
+{
+	md3dDevice = device;
+	mDepthSrvFormat = depthSrvFormat;
+	mDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	BuildDescriptorHeap();
+	BuildRootSignature();
+	BuildPsos(shaderFile);
+	OnResize(depthBuffer);
+}
+
+void HiZPyramid::OnResize(ID3D12Resource* depthBuffer)
+{
+	D3D12_RESOURCE_DESC depthDesc = depthBuffer->GetDesc();
+	if (depthDesc.SampleDesc.Count > 1)
+		throw DxException(E_INVALIDARG, L"HiZPyramid multisampled depth", AnsiToWString(__FILE__), __LINE__);
+
+	mDepthBuffer = depthBuffer;
+	mWidth = (UINT)depthDesc.Width;
+	mHeight = depthDesc.Height;
+	mValid = false;
+
+	mMipCount = 1;
+	while (mMipCount < MaxMipCount && ((mWidth | mHeight) >> mMipCount) != 0)
+		++mMipCount;
+
+	D3D12_RESOURCE_DESC texDesc;
+	ZeroMemory(&texDesc, sizeof(D3D12_RESOURCE_DESC));
+	texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	texDesc.Alignment = 0;
+	texDesc.Width = mWidth;
+	texDesc.Height = mHeight;
+	texDesc.DepthOrArraySize = 1;
+	texDesc.MipLevels = (UINT16)mMipCount;
+	texDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	texDesc.SampleDesc.Count = 1;
+	texDesc.SampleDesc.Quality = 0;
+	texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+	texDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+
+	CD3DX12_HEAP_PROPERTIES defaultHeap(D3D12_HEAP_TYPE_DEFAULT);
+
+	mPyramid = nullptr;
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&defaultHeap,
+		D3D12_HEAP_FLAG_NONE,
+		&texDesc,
+		D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+		nullptr,
+		IID_PPV_ARGS(mPyramid.GetAddressOf())));
+	GpuMemory::Track(mPyramid.Get(), MemoryCategory::RenderTarget);
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC depthSrvDesc = {};
+	depthSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	depthSrvDesc.Format = mDepthSrvFormat;
+	depthSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	depthSrvDesc.Texture2D.MostDetailedMip = 0;
+	depthSrvDesc.Texture2D.MipLevels = 1;
+	md3dDevice->CreateShaderResourceView(mDepthBuffer, &depthSrvDesc, CpuHandle(DepthSrvSlot));
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC pyramidSrvDesc = {};
+	pyramidSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	pyramidSrvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	pyramidSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	pyramidSrvDesc.Texture2D.MostDetailedMip = 0;
+	pyramidSrvDesc.Texture2D.MipLevels = mMipCount;
+	md3dDevice->CreateShaderResourceView(mPyramid.Get(), &pyramidSrvDesc, CpuHandle(PyramidSrvSlot));
+
+	// The downsample pass binds two consecutive levels; the null UAV after the last
+	// one keeps that table valid for the mip 0 pass of a 1x1 pyramid.
+	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+	uavDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+	for (UINT mip = 0; mip < mMipCount; ++mip)
+	{
+		uavDesc.Texture2D.MipSlice = mip;
+		md3dDevice->CreateUnorderedAccessView(mPyramid.Get(), nullptr, &uavDesc, CpuHandle(FirstUavSlot + mip));
+	}
+	uavDesc.Texture2D.MipSlice = 0;
+	md3dDevice->CreateUnorderedAccessView(nullptr, nullptr, &uavDesc, CpuHandle(FirstUavSlot + mMipCount));
+}
+
+void HiZPyramid::Build(ID3D12GraphicsCommandList* cmdList, UINT validWidth, UINT validHeight)
+{
+	mValidWidth = (std::min)(validWidth, mWidth);
+	mValidHeight = (std::min)(validHeight, mHeight);
+
+	D3D12_RESOURCE_BARRIER toBuild[] =
+	{
+		CD3DX12_RESOURCE_BARRIER::Transition(mDepthBuffer,
+			D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+		CD3DX12_RESOURCE_BARRIER::Transition(mPyramid.Get(),
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+	};
+	cmdList->ResourceBarrier(_countof(toBuild), toBuild);
+
+	ID3D12DescriptorHeap* descriptorHeaps[] = { mHeap.Get() };
+	cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+	cmdList->SetComputeRootSignature(mRootSignature.Get());
+
+	// Mip 0 from the depth buffer.
+	UINT constants[4] = { mWidth, mHeight, mValidWidth, mValidHeight };
+	cmdList->SetPipelineState(mCopyDepthPso.Get());
+	cmdList->SetComputeRoot32BitConstants(0, 4, constants, 0);
+	cmdList->SetComputeRootDescriptorTable(1, GpuHandle(DepthSrvSlot));
+	cmdList->SetComputeRootDescriptorTable(2, GpuHandle(FirstUavSlot));
+	cmdList->Dispatch((mWidth + 7) / 8, (mHeight + 7) / 8, 1);
+
+	// Every level from the one below; 8x8 texels per group.
+	cmdList->SetPipelineState(mDownsamplePso.Get());
+	for (UINT mip = 1; mip < mMipCount; ++mip)
+	{
+		UINT width = (std::max)(mWidth >> mip, 1u);
+		UINT height = (std::max)(mHeight >> mip, 1u);
+		constants[0] = width;
+		constants[1] = height;
+
+		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(mPyramid.Get()));
+		cmdList->SetComputeRoot32BitConstants(0, 4, constants, 0);
+		cmdList->SetComputeRootDescriptorTable(2, GpuHandle(FirstUavSlot + mip - 1));
+		cmdList->Dispatch((width + 7) / 8, (height + 7) / 8, 1);
+	}
+
+	D3D12_RESOURCE_BARRIER toRead[] =
+	{
+		CD3DX12_RESOURCE_BARRIER::Transition(mPyramid.Get(),
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+		CD3DX12_RESOURCE_BARRIER::Transition(mDepthBuffer,
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE)
+	};
+	cmdList->ResourceBarrier(_countof(toRead), toRead);
+
+	mValid = true;
+}
+
+bool HiZPyramid::IsValid()const
+{
+	return mValid;
+}
+
+UINT HiZPyramid::Width()const
+{
+	return mWidth;
+}
+
+UINT HiZPyramid::Height()const
+{
+	return mHeight;
+}
+
+UINT HiZPyramid::MipCount()const
+{
+	return mMipCount;
+}
+
+UINT HiZPyramid::ValidWidth()const
+{
+	return mValidWidth;
+}
+
+UINT HiZPyramid::ValidHeight()const
+{
+	return mValidHeight;
+}
+
+ID3D12DescriptorHeap* HiZPyramid::DescriptorHeap()const
+{
+	return mHeap.Get();
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE HiZPyramid::Srv()const
+{
+	return GpuHandle(PyramidSrvSlot);
+}
+
+CD3DX12_CPU_DESCRIPTOR_HANDLE HiZPyramid::CpuHandle(UINT slot)const
+{
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(mHeap->GetCPUDescriptorHandleForHeapStart(), slot, mDescriptorSize);
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE HiZPyramid::GpuHandle(UINT slot)const
+{
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(mHeap->GetGPUDescriptorHandleForHeapStart(), slot, mDescriptorSize);
+}
+
+void HiZPyramid::BuildDescriptorHeap()
+{
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc;
+	heapDesc.NumDescriptors = FirstUavSlot + MaxMipCount + 1;
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	heapDesc.NodeMask = 0;
+	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(mHeap.GetAddressOf())));
+}
+
+void HiZPyramid::BuildRootSignature()
+{
+	CD3DX12_DESCRIPTOR_RANGE srvTable;
+	srvTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+
+	CD3DX12_DESCRIPTOR_RANGE uavTable;
+	uavTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 2, 0);
+
+	CD3DX12_ROOT_PARAMETER slotRootParameter[3];
+	slotRootParameter[0].InitAsConstants(4, 0);
+	slotRootParameter[1].InitAsDescriptorTable(1, &srvTable);
+	slotRootParameter[2].InitAsDescriptorTable(1, &uavTable);
+
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(3, slotRootParameter,
+		0, nullptr,
+		D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+	ComPtr<ID3DBlob> serializedRootSig = nullptr;
+	ComPtr<ID3DBlob> errorBlob = nullptr;
+	HRESULT hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1,
+		serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
+
+	if (errorBlob != nullptr)
+	{
+		::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+	}
+	ThrowIfFailed(hr);
+
+	ThrowIfFailed(md3dDevice->CreateRootSignature(
+		0,
+		serializedRootSig->GetBufferPointer(),
+		serializedRootSig->GetBufferSize(),
+		IID_PPV_ARGS(mRootSignature.GetAddressOf())));
+}
+
+void HiZPyramid::BuildPsos(const std::wstring& shaderFile)
+{
+	ComPtr<ID3DBlob> copyDepthCS = d3dUtil::CompileShader(shaderFile, nullptr, "CopyDepthCS", "cs_5_0");
+	ComPtr<ID3DBlob> downsampleCS = d3dUtil::CompileShader(shaderFile, nullptr, "DownsampleCS", "cs_5_0");
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
+	psoDesc.pRootSignature = mRootSignature.Get();
+	psoDesc.CS =
+	{
+		reinterpret_cast<BYTE*>(copyDepthCS->GetBufferPointer()),
+		copyDepthCS->GetBufferSize()
+	};
+	psoDesc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+	ThrowIfFailed(md3dDevice->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(mCopyDepthPso.GetAddressOf())));
+
+	psoDesc.CS =
+	{
+		reinterpret_cast<BYTE*>(downsampleCS->GetBufferPointer()),
+		downsampleCS->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(mDownsamplePso.GetAddressOf())));
+}
@@ -0,0 +1,94 @@
+//***************************************************************************************
+// HiZPyramid.h
+//
+// A hierarchical depth buffer for occlusion culling.  Mip 0 is a copy of the depth
+// buffer; every level above holds the farthest depth of the 2x2 texels below it
+// (plus the extra row or column of an odd sized level), so one texel of level k
+// bounds the depth of a 2^k x 2^k block of pixels.  A box whose nearest depth is
+// behind the farthest depth of every texel its screen rectangle touches is hidden,
+// and at the right level that is four loads, however large the box.
+//
+// Build() runs a compute pass per level (Shader/HiZ.hlsl).  Only the top left
+// validWidth x validHeight part of the depth buffer is scene (DynamicResolution
+// draws there); the rest of mip 0 is written as far, so it never hides anything.
+//
+// The culling shader reads the pyramid through Srv(), a table in DescriptorHeap().
+// Outside Build() the pyramid is in the non pixel shader resource state.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class HiZPyramid
+{
+public:
+	// depthBuffer is single sampled and created with a typeless format that
+	// depthSrvFormat can view, e.g. R24G8_TYPELESS and R24_UNORM_X8_TYPELESS.
+	HiZPyramid(ID3D12Device* device, ID3D12Resource* depthBuffer, DXGI_FORMAT depthSrvFormat,
+		const std::wstring& shaderFile = L"../../Shader/HiZ.hlsl");
+	HiZPyramid(const HiZPyramid& rhs) = delete;
+	HiZPyramid& operator=(const HiZPyramid& rhs) = delete;
+	~HiZPyramid() = default;
+
+	// Recreates the pyramid for a new depth buffer.  The GPU must be done with the
+	// old one.  The pyramid is invalid until the next Build().
+	void OnResize(ID3D12Resource* depthBuffer);
+
+	// Records the build on cmdList, which replaces the compute root signature, the
+	// PSO and the descriptor heaps.  The depth buffer is in the depth write state
+	// before and after.
+	void Build(ID3D12GraphicsCommandList* cmdList, UINT validWidth, UINT validHeight);
+
+	// False until the first Build() after creation or OnResize().
+	bool IsValid()const;
+
+	UINT Width()const;
+	UINT Height()const;
+	UINT MipCount()const;
+
+	// The part of mip 0 the last Build() took from the scene.
+	UINT ValidWidth()const;
+	UINT ValidHeight()const;
+
+	ID3D12DescriptorHeap* DescriptorHeap()const;
+
+	// A Texture2D<float> view of every level.
+	D3D12_GPU_DESCRIPTOR_HANDLE Srv()const;
+
+private:
+	// Heap slots: depth SRV, pyramid SRV, one UAV per level, a null UAV.
+	static const UINT MaxMipCount = 16;
+	static const UINT DepthSrvSlot = 0;
+	static const UINT PyramidSrvSlot = 1;
+	static const UINT FirstUavSlot = 2;
+
+	void BuildDescriptorHeap();
+	void BuildRootSignature();
+	void BuildPsos(const std::wstring& shaderFile);
+
+	CD3DX12_CPU_DESCRIPTOR_HANDLE CpuHandle(UINT slot)const;
+	CD3DX12_GPU_DESCRIPTOR_HANDLE GpuHandle(UINT slot)const;
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+
+	DXGI_FORMAT mDepthSrvFormat = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+	ID3D12Resource* mDepthBuffer = nullptr;
+
+	UINT mWidth = 0;
+	UINT mHeight = 0;
+	UINT mMipCount = 0;
+	UINT mValidWidth = 0;
+	UINT mValidHeight = 0;
+	bool mValid = false;
+
+	UINT mDescriptorSize = 0;
+
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> mCopyDepthPso = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> mDownsamplePso = nullptr;
+
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mHeap = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mPyramid = nullptr;
+};
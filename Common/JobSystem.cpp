@@ -0,0 +1,244 @@
+//***************************************************************************************
+// JobSystem.cpp
+//***************************************************************************************
+
+#include "JobSystem.h"
+
+namespace
+{
+	// Which pool the current thread belongs to, and its deque in that pool.
+	thread_local const JobSystem* tJobSystem = nullptr;
+	thread_local UINT tThreadIndex = 0;
+}
+
+JobSystem::JobSystem(UINT workerCount)
+{
+	if(workerCount == 0)
+	{
+		UINT hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	mQueuedCount = 0;
+
+	mQueues.resize(workerCount + 1);
+	for(auto& queue : mQueues)
+		queue = std::make_unique<WorkQueue>();
+
+	tJobSystem = this;
+	tThreadIndex = 0;
+
+	mWorkers.reserve(workerCount);
+	for(UINT i = 1; i <= workerCount; ++i)
+		mWorkers.emplace_back(&JobSystem::WorkerMain, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	// Jobs may reference objects that are about to be destroyed; let them finish.
+	while(mQueuedCount > 0)
+	{
+		if(!RunOne(ThreadIndex()))
+			std::this_thread::yield();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mStop = true;
+	}
+	mWakeCondition.notify_all();
+
+	for(auto& worker : mWorkers)
+		worker.join();
+
+	if(tJobSystem == this)
+		tJobSystem = nullptr;
+}
+
+UINT JobSystem::ThreadCount()const
+{
+	return (UINT)mQueues.size();
+}
+
+UINT JobSystem::ThreadIndex()const
+{
+	return tJobSystem == this ? tThreadIndex : 0;
+}
+
+JobSystem::JobHandle JobSystem::Submit(std::function<void()> fn)
+{
+	return Submit(std::move(fn), std::vector<JobHandle>());
+}
+
+JobSystem::JobHandle JobSystem::Submit(std::function<void()> fn, std::initializer_list<JobHandle> dependencies)
+{
+	return Submit(std::move(fn), std::vector<JobHandle>(dependencies));
+}
+
+JobSystem::JobHandle JobSystem::Submit(std::function<void()> fn, const std::vector<JobHandle>& dependencies)
+{
+	auto job = std::make_shared<Job>();
+	job->Fn = std::move(fn);
+	job->Pending = 1;
+	job->Completed = false;
+
+	for(auto& dependency : dependencies)
+	{
+		if(dependency != nullptr)
+			Link(job, dependency);
+	}
+
+	// Drop the submission reference; schedule now unless a dependency is pending.
+	if(job->Pending.fetch_sub(1) == 1)
+		Schedule(job);
+
+	return job;
+}
+
+bool JobSystem::IsComplete(const JobHandle& job)
+{
+	return job == nullptr || job->Completed.load(std::memory_order_acquire);
+}
+
+void JobSystem::Wait(const JobHandle& job)
+{
+	if(job == nullptr)
+		return;
+
+	const UINT threadIndex = ThreadIndex();
+	while(!IsComplete(job))
+	{
+		if(!RunOne(threadIndex))
+			std::this_thread::yield();
+	}
+
+	if(job->Error)
+		std::rethrow_exception(job->Error);
+}
+
+void JobSystem::Wait(const std::vector<JobHandle>& jobs)
+{
+	const UINT threadIndex = ThreadIndex();
+	for(auto& job : jobs)
+	{
+		while(!IsComplete(job))
+		{
+			if(!RunOne(threadIndex))
+				std::this_thread::yield();
+		}
+	}
+
+	for(auto& job : jobs)
+	{
+		if(job != nullptr && job->Error)
+			std::rethrow_exception(job->Error);
+	}
+}
+
+void JobSystem::Link(const JobHandle& job, const JobHandle& dependency)
+{
+	std::lock_guard<std::mutex> lock(dependency->Mutex);
+	if(!dependency->Done)
+	{
+		job->Pending++;
+		dependency->Continuations.push_back(job);
+	}
+}
+
+void JobSystem::Schedule(const JobHandle& job)
+{
+	WorkQueue& queue = *mQueues[ThreadIndex()];
+	{
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		queue.Jobs.push_back(job);
+	}
+
+	// Taking the wake mutex orders the count against a worker that is about to
+	// sleep, so the notification cannot be missed.
+	mQueuedCount++;
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+	}
+	mWakeCondition.notify_one();
+}
+
+bool JobSystem::RunOne(UINT threadIndex)
+{
+	JobHandle job;
+
+	// Newest job of our own deque first...
+	{
+		WorkQueue& queue = *mQueues[threadIndex];
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		if(!queue.Jobs.empty())
+		{
+			job = std::move(queue.Jobs.back());
+			queue.Jobs.pop_back();
+		}
+	}
+
+	// ...otherwise the oldest job of another thread.
+	for(UINT i = 1; job == nullptr && i < (UINT)mQueues.size(); ++i)
+	{
+		WorkQueue& queue = *mQueues[(threadIndex + i) % mQueues.size()];
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		if(!queue.Jobs.empty())
+		{
+			job = std::move(queue.Jobs.front());
+			queue.Jobs.pop_front();
+		}
+	}
+
+	if(job == nullptr)
+		return false;
+
+	mQueuedCount--;
+	Execute(job);
+	return true;
+}
+
+void JobSystem::Execute(const JobHandle& job)
+{
+	try
+	{
+		job->Fn();
+	}
+	catch(...)
+	{
+		job->Error = std::current_exception();
+	}
+
+	// Release whatever the job captured as soon as it has run.
+	job->Fn = nullptr;
+
+	std::vector<JobHandle> continuations;
+	{
+		std::lock_guard<std::mutex> lock(job->Mutex);
+		job->Done = true;
+		continuations.swap(job->Continuations);
+	}
+	job->Completed.store(true, std::memory_order_release);
+
+	for(auto& continuation : continuations)
+	{
+		if(continuation->Pending.fetch_sub(1) == 1)
+			Schedule(continuation);
+	}
+}
+
+void JobSystem::WorkerMain(UINT threadIndex)
+{
+	tJobSystem = this;
+	tThreadIndex = threadIndex;
+
+	for(;;)
+	{
+		if(RunOne(threadIndex))
+			continue;
+
+		std::unique_lock<std::mutex> lock(mWakeMutex);
+		mWakeCondition.wait(lock, [this]() { return mStop || mQueuedCount > 0; });
+		if(mStop && mQueuedCount == 0)
+			return;
+	}
+}
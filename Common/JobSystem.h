@@ -0,0 +1,162 @@
+//***************************************************************************************
+// JobSystem.h
+//
+// A fixed pool of worker threads with work stealing.  Every thread of the pool,
+// plus the thread that created it (index 0, normally the main thread), owns a
+// deque: new jobs go to the back of the submitting thread's deque and the owner
+// pops from the back, so related work stays on one core while it is in cache; an
+// idle thread steals from the front of another thread's deque.
+//
+// Jobs may depend on other jobs, so a frame can be written as a small graph
+// (input -> camera -> culling -> constant buffers -> recording) instead of a fixed
+// serial order.  Wait() runs pending jobs on the calling thread until the awaited
+// ones are done, so waiting never idles a core and nested waits cannot deadlock.
+//
+// D3DApp owns one JobSystem; demos and Common subsystems should use it instead of
+// creating threads of their own, so the cores are not oversubscribed.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+class JobSystem
+{
+	struct Job;
+
+public:
+	using JobHandle = std::shared_ptr<Job>;
+
+	// workerCount 0 creates one worker per hardware thread, minus the calling one.
+	explicit JobSystem(UINT workerCount = 0);
+	JobSystem(const JobSystem& rhs) = delete;
+	JobSystem& operator=(const JobSystem& rhs) = delete;
+
+	// Finishes the queued jobs, then joins the workers.
+	~JobSystem();
+
+	// Threads that run jobs, including the creating thread.
+	UINT ThreadCount()const;
+
+	// In [0, ThreadCount()) on the pool's threads; 0 on threads outside the pool,
+	// which share the creating thread's deque.  Handy to index per-thread scratch.
+	UINT ThreadIndex()const;
+
+	// The job runs once every dependency has completed; null handles are ignored.
+	// A job that throws still counts as completed; Wait() rethrows its exception.
+	JobHandle Submit(std::function<void()> fn);
+	JobHandle Submit(std::function<void()> fn, std::initializer_list<JobHandle> dependencies);
+	JobHandle Submit(std::function<void()> fn, const std::vector<JobHandle>& dependencies);
+
+	static bool IsComplete(const JobHandle& job);
+
+	// Runs other jobs until the given ones have completed, then rethrows the first
+	// exception any of them threw.
+	void Wait(const JobHandle& job);
+	void Wait(const std::vector<JobHandle>& jobs);
+
+	// Calls body(i) for every i in [begin, end), split into a few chunks per thread
+	// that are at least grainSize indices long.  The calling thread takes part, and
+	// returns once every index is done.
+	template<typename Fn>
+	void ParallelFor(UINT begin, UINT end, UINT grainSize, const Fn& body);
+
+private:
+	struct Job
+	{
+		std::function<void()> Fn;
+
+		// Dependencies not completed yet, plus one while Submit() is linking them.
+		std::atomic<int> Pending;
+		std::atomic<bool> Completed;
+
+		// Guards Done and Continuations, so a dependent is either linked before the
+		// job completes or sees it completed.
+		std::mutex Mutex;
+		bool Done = false;
+		std::vector<JobHandle> Continuations;
+
+		std::exception_ptr Error;
+	};
+
+	struct WorkQueue
+	{
+		std::mutex Mutex;
+		std::deque<JobHandle> Jobs;
+	};
+
+	void Link(const JobHandle& job, const JobHandle& dependency);
+	void Schedule(const JobHandle& job);
+	bool RunOne(UINT threadIndex);
+	void Execute(const JobHandle& job);
+	void WorkerMain(UINT threadIndex);
+
+private:
+	std::vector<std::unique_ptr<WorkQueue>> mQueues;
+	std::vector<std::thread> mWorkers;
+
+	// Jobs sitting in a deque; workers sleep while it is zero.
+	std::atomic<int> mQueuedCount;
+	std::mutex mWakeMutex;
+	std::condition_variable mWakeCondition;
+	bool mStop = false;
+};
+
+template<typename Fn>
+void JobSystem::ParallelFor(UINT begin, UINT end, UINT grainSize, const Fn& body)
+{
+	if(end <= begin)
+		return;
+
+	const UINT count = end - begin;
+	if(grainSize == 0)
+		grainSize = 1;
+
+	// A few chunks per thread let stealing even out uneven chunks.
+	UINT chunkCount = (count + grainSize - 1) / grainSize;
+	if(chunkCount > ThreadCount() * 4)
+		chunkCount = ThreadCount() * 4;
+
+	std::vector<JobHandle> jobs;
+	jobs.reserve(chunkCount);
+	for(UINT c = 1; c < chunkCount; ++c)
+	{
+		UINT first = begin + (UINT)((UINT64)count * c / chunkCount);
+		UINT last = begin + (UINT)((UINT64)count * (c + 1) / chunkCount);
+		jobs.push_back(Submit([&body, first, last]()
+		{
+			for(UINT i = first; i < last; ++i)
+				body(i);
+		}));
+	}
+
+	// The first chunk runs here rather than waiting for a worker to pick it up.
+	// The other chunks reference body, so they must finish even if it throws.
+	std::exception_ptr error;
+	try
+	{
+		const UINT firstEnd = begin + count / chunkCount;
+		for(UINT i = begin; i < firstEnd; ++i)
+			body(i);
+	}
+	catch(...)
+	{
+		error = std::current_exception();
+	}
+
+	if(error)
+	{
+		try { Wait(jobs); }
+		catch(...) {}
+		std::rethrow_exception(error);
+	}
+
+	Wait(jobs);
+}
@@ -0,0 +1,172 @@
+//***************************************************************************************
+// LinearUploadAllocator.cpp
+//***************************************************************************************
+
+#include "LinearUploadAllocator.h"
+
+LinearUploadAllocator::LinearUploadAllocator(ID3D12Device* device, UINT64 pageSize) :
+	md3dDevice(device)
+{
+	// Keep each page a multiple of the CB alignment so the last slice fits.
+	mPageSize = (pageSize + D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1) &
+		~(UINT64)(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1);
+
+	mPages.Pages.push_back(CreatePage(mPageSize));
+	mPages.Current.store(mPages.Pages[0].get(), std::memory_order_release);
+}
+
+LinearUploadAllocator::~LinearUploadAllocator()
+{
+	for (PageChain* chain : { &mPages, &mLatePersistentPages })
+	{
+		for (auto& page : chain->Pages)
+			page->Buffer->Unmap(0, nullptr);
+	}
+}
+
+std::unique_ptr<LinearUploadAllocator::Page> LinearUploadAllocator::CreatePage(UINT64 capacity)const
+{
+	auto page = std::make_unique<Page>();
+	page->Capacity = capacity;
+
+	CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_UPLOAD);
+	CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(capacity);
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&heapProps,
+		D3D12_HEAP_FLAG_NONE,
+		&bufferDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&page->Buffer)));
+	GpuMemory::Track(page->Buffer.Get(), MemoryCategory::Upload);
+
+	ThrowIfFailed(page->Buffer->Map(0, nullptr, reinterpret_cast<void**>(&page->MappedData)));
+
+	page->BaseAddress = page->Buffer->GetGPUVirtualAddress();
+
+	return page;
+}
+
+UploadAllocation LinearUploadAllocator::Allocate(UINT64 byteSize, UINT64 alignment)
+{
+	return Allocate(mPages, byteSize, alignment);
+}
+
+UploadAllocation LinearUploadAllocator::AllocatePersistent(UINT64 byteSize, UINT64 alignment)
+{
+	// Before the mark every allocation is persistent anyway.
+	bool marked = false;
+	{
+		std::lock_guard<std::mutex> lock(mGrowMutex);
+		marked = mMarked;
+	}
+
+	return Allocate(marked ? mLatePersistentPages : mPages, byteSize, alignment);
+}
+
+UploadAllocation LinearUploadAllocator::Allocate(PageChain& chain, UINT64 byteSize, UINT64 alignment)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+	UploadAllocation allocation;
+	for (;;)
+	{
+		Page* page = chain.Current.load(std::memory_order_acquire);
+		if (page != nullptr && TryAllocate(*page, byteSize, alignment, allocation))
+			return allocation;
+
+		// Page offsets are aligned, so this much always fits a fresh page.
+		NextPage(chain, page, byteSize + alignment);
+	}
+}
+
+bool LinearUploadAllocator::TryAllocate(Page& page, UINT64 byteSize, UINT64 alignment, UploadAllocation& allocation)
+{
+	UINT64 offset = page.Offset.load(std::memory_order_relaxed);
+	UINT64 alignedOffset = 0;
+	do
+	{
+		alignedOffset = (offset + alignment - 1) & ~(alignment - 1);
+		if (alignedOffset + byteSize > page.Capacity)
+			return false;
+	} while (!page.Offset.compare_exchange_weak(offset, alignedOffset + byteSize, std::memory_order_relaxed));
+
+	allocation.CPU = page.MappedData + alignedOffset;
+	allocation.GPU = page.BaseAddress + alignedOffset;
+	allocation.Resource = page.Buffer.Get();
+	allocation.Offset = alignedOffset;
+	allocation.Size = byteSize;
+
+	return true;
+}
+
+void LinearUploadAllocator::NextPage(PageChain& chain, Page* full, UINT64 minCapacity)
+{
+	std::lock_guard<std::mutex> lock(mGrowMutex);
+
+	// Another thread got here first.
+	if (chain.Current.load(std::memory_order_relaxed) != full)
+		return;
+
+	size_t next = full != nullptr ? chain.CurrentIndex + 1 : 0;
+	if (next == chain.Pages.size() || chain.Pages[next]->Capacity < minCapacity)
+	{
+		const UINT64 capacity = (std::max)(mPageSize,
+			(minCapacity + D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1) &
+			~(UINT64)(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1));
+		chain.Pages.insert(chain.Pages.begin() + next, CreatePage(capacity));
+	}
+
+	chain.CurrentIndex = next;
+	chain.Current.store(chain.Pages[next].get(), std::memory_order_release);
+}
+
+void LinearUploadAllocator::MarkPersistent()
+{
+	std::lock_guard<std::mutex> lock(mGrowMutex);
+
+	mPersistentPage = mPages.CurrentIndex;
+	mPersistentOffset = mPages.Pages[mPersistentPage]->Offset.load(std::memory_order_relaxed);
+	mMarked = true;
+}
+
+void LinearUploadAllocator::Reset()
+{
+	std::lock_guard<std::mutex> lock(mGrowMutex);
+
+	// Back to the mark; the transient pages after it are reused as they are.
+	mPages.Pages[mPersistentPage]->Offset.store(mPersistentOffset, std::memory_order_relaxed);
+	for (size_t i = mPersistentPage + 1; i < mPages.Pages.size(); ++i)
+		mPages.Pages[i]->Offset.store(0, std::memory_order_relaxed);
+
+	mPages.CurrentIndex = mPersistentPage;
+	mPages.Current.store(mPages.Pages[mPersistentPage].get(), std::memory_order_release);
+}
+
+UINT64 LinearUploadAllocator::Capacity()const
+{
+	std::lock_guard<std::mutex> lock(mGrowMutex);
+
+	UINT64 capacity = 0;
+	for (const PageChain* chain : { &mPages, &mLatePersistentPages })
+	{
+		for (const auto& page : chain->Pages)
+			capacity += page->Capacity;
+	}
+
+	return capacity;
+}
+
+UINT64 LinearUploadAllocator::Used()const
+{
+	std::lock_guard<std::mutex> lock(mGrowMutex);
+
+	UINT64 used = 0;
+	for (const PageChain* chain : { &mPages, &mLatePersistentPages })
+	{
+		for (const auto& page : chain->Pages)
+			used += page->Offset.load(std::memory_order_relaxed);
+	}
+
+	return used;
+}
@@ -0,0 +1,171 @@
+//***************************************************************************************
+// LinearUploadAllocator.h
+//
+// Persistently mapped upload heaps with a lock-free bump allocator.  A frame
+// resource owns one of these and carves its constant buffers and dynamic vertex
+// buffers out of it, instead of creating a committed resource per buffer.
+//
+// Allocations made before MarkPersistent() live as long as the allocator (e.g.
+// constant buffers updated with the NumFramesDirty scheme).  Everything after the
+// mark is transient and is discarded by Reset() once the GPU is done with the frame.
+//
+// The heaps are pages: when the bump pointer runs out, the next page is chained
+// rather than failing, so neither part needs its exact size up front.  Transient
+// pages are kept and reused after Reset().
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include <atomic>
+#include <mutex>
+
+struct UploadAllocation
+{
+	BYTE* CPU = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS GPU = 0;
+
+	// The page the allocation lives in and its byte offset there, e.g. for copies.
+	ID3D12Resource* Resource = nullptr;
+	UINT64 Offset = 0;
+	UINT64 Size = 0;
+};
+
+class LinearUploadAllocator
+{
+public:
+	// pageSize is the size of each upload heap; a larger allocation gets a page of
+	// its own size.
+	LinearUploadAllocator(ID3D12Device* device, UINT64 pageSize);
+	LinearUploadAllocator(const LinearUploadAllocator& rhs) = delete;
+	LinearUploadAllocator& operator=(const LinearUploadAllocator& rhs) = delete;
+	~LinearUploadAllocator();
+
+	// Safe to call from several threads at once.  alignment must be a power of two.
+	UploadAllocation Allocate(UINT64 byteSize,
+		UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+	// Like an allocation made before the mark, also after it: grows a persistent
+	// buffer without rebuilding its owner.  The allocation it replaces stays valid
+	// until the allocator is destroyed, so the GPU may still read it.
+	UploadAllocation AllocatePersistent(UINT64 byteSize,
+		UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+	void MarkPersistent();
+
+	// Must not be called while the GPU may still read this frame's transient data.
+	void Reset();
+
+	// Totals over all pages.
+	UINT64 Capacity()const;
+	UINT64 Used()const;
+
+private:
+	struct Page
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> Buffer;
+		BYTE* MappedData = nullptr;
+		D3D12_GPU_VIRTUAL_ADDRESS BaseAddress = 0;
+		UINT64 Capacity = 0;
+		std::atomic<UINT64> Offset{ 0 };
+	};
+
+	// Pages are bumped through in order.  Current is read without the lock;
+	// everything else only changes under mGrowMutex.
+	struct PageChain
+	{
+		std::vector<std::unique_ptr<Page>> Pages;
+		size_t CurrentIndex = 0;
+		std::atomic<Page*> Current{ nullptr };
+	};
+
+	std::unique_ptr<Page> CreatePage(UINT64 capacity)const;
+	UploadAllocation Allocate(PageChain& chain, UINT64 byteSize, UINT64 alignment);
+	static bool TryAllocate(Page& page, UINT64 byteSize, UINT64 alignment, UploadAllocation& allocation);
+
+	// Moves chain past the full page, reusing the next page if it is big enough.
+	void NextPage(PageChain& chain, Page* full, UINT64 minCapacity);
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+	UINT64 mPageSize = 0;
+
+	// Persistent allocations and, after the mark, the transient ones.
+	PageChain mPages;
+	size_t mPersistentPage = 0;
+	UINT64 mPersistentOffset = 0;
+	bool mMarked = false;
+
+	// AllocatePersistent() after the mark.  Never reset.
+	PageChain mLatePersistentPages;
+
+	mutable std::mutex mGrowMutex;
+};
+
+enum class UploadLifetime
+{
+	// Persistent before MarkPersistent(), transient after it.
+	Default,
+	// Persistent either way; see AllocatePersistent().
+	Persistent
+};
+
+// Typed view over a range of a LinearUploadAllocator, with the same CopyData()
+// interface as UploadBuffer<T>.
+template<typename T>
+class UploadSlice
+{
+public:
+	UploadSlice() = default;
+	UploadSlice(LinearUploadAllocator& allocator, UINT elementCount, bool isConstantBuffer,
+		UploadLifetime lifetime = UploadLifetime::Default) :
+		mElementCount(elementCount)
+	{
+		mElementByteSize = sizeof(T);
+
+		// Constant buffer elements need to be multiples of 256 bytes.
+		if (isConstantBuffer)
+			mElementByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(T));
+
+		mAllocation = lifetime == UploadLifetime::Persistent ?
+			allocator.AllocatePersistent((UINT64)mElementByteSize * elementCount) :
+			allocator.Allocate((UINT64)mElementByteSize * elementCount);
+	}
+
+	void CopyData(int elementIndex, const T& data)
+	{
+		assert((UINT)elementIndex < mElementCount);
+		memcpy(&mAllocation.CPU[elementIndex * mElementByteSize], &data, sizeof(T));
+	}
+
+	// Only valid for tightly packed (non-constant buffer) slices.
+	T* MappedData()
+	{
+		assert(mElementByteSize == sizeof(T));
+		return reinterpret_cast<T*>(mAllocation.CPU);
+	}
+
+	// Start of one element, for callers that write it themselves (e.g. with
+	// streaming stores).  Write-only: the upload heap is write-combined.
+	T* MappedElement(int elementIndex)
+	{
+		assert((UINT)elementIndex < mElementCount);
+		return reinterpret_cast<T*>(&mAllocation.CPU[elementIndex * mElementByteSize]);
+	}
+
+	D3D12_GPU_VIRTUAL_ADDRESS GpuAddress(int elementIndex = 0)const
+	{
+		return mAllocation.GPU + (UINT64)elementIndex * mElementByteSize;
+	}
+
+	// The page holding the slice and the slice's byte offset within it.
+	ID3D12Resource* Resource()const { return mAllocation.Resource; }
+	UINT64 Offset()const { return mAllocation.Offset; }
+	UINT ElementByteSize()const { return mElementByteSize; }
+	UINT ElementCount()const { return mElementCount; }
+
+private:
+	UploadAllocation mAllocation;
+	UINT mElementByteSize = 0;
+	UINT mElementCount = 0;
+};
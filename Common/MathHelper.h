@@ -78,6 +78,30 @@ public:
         return DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(&det, A));
 	}
 
+	// Stores the transpose of M with non-temporal stores, for writing shader
+	// constants into write-combined upload memory without reading it into the
+	// cache.  dest must be 16-byte aligned.  Call StreamFence() after a batch.
+	static void StoreTransposedStream(DirectX::XMFLOAT4X4* dest, DirectX::FXMMATRIX M)
+	{
+		DirectX::XMMATRIX T = DirectX::XMMatrixTranspose(M);
+#if defined(_XM_SSE_INTRINSICS_)
+		float* p = &dest->m[0][0];
+		_mm_stream_ps(p + 0, T.r[0]);
+		_mm_stream_ps(p + 4, T.r[1]);
+		_mm_stream_ps(p + 8, T.r[2]);
+		_mm_stream_ps(p + 12, T.r[3]);
+#else
+		DirectX::XMStoreFloat4x4(dest, T);
+#endif
+	}
+
+	static void StreamFence()
+	{
+#if defined(_XM_SSE_INTRINSICS_)
+		_mm_sfence();
+#endif
+	}
+
     static DirectX::XMFLOAT4X4 Identity4x4()
     {
         static DirectX::XMFLOAT4X4 I(
@@ -0,0 +1,201 @@
+//***************************************************************************************
+// MeshFile.cpp
+//***************************************************************************************
+
+#include "MeshFile.h"
+#include <fstream>
+
+using namespace DirectX;
+
+namespace
+{
+	uint64_t AlignOffset(uint64_t offset)
+	{
+		return (offset + 15) & ~uint64_t(15);
+	}
+}
+
+MeshFile::~MeshFile()
+{
+	Close();
+}
+
+bool MeshFile::Open(const std::wstring& filename, UINT vertexStride, uint32_t vertexFormat)
+{
+	Close();
+
+	mFile = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(mFile, &fileSize) || (uint64_t)fileSize.QuadPart < sizeof(MeshFileHeader))
+	{
+		Close();
+		return false;
+	}
+
+	mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mMapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	mView = static_cast<const uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+	if (mView == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	memcpy(&mHeader, mView, sizeof(MeshFileHeader));
+
+	const uint64_t size = (uint64_t)fileSize.QuadPart;
+	const uint64_t vbByteSize = (uint64_t)mHeader.VertexCount * mHeader.VertexStride;
+	const uint64_t ibByteSize = (uint64_t)mHeader.IndexCount * mHeader.IndexStride;
+
+	bool valid =
+		mHeader.Magic == MeshFileHeader::MagicValue &&
+		mHeader.Version == MeshFileHeader::CurrentVersion &&
+		mHeader.VertexStride == vertexStride &&
+		mHeader.VertexFormat == vertexFormat &&
+		(mHeader.IndexStride == 2 || mHeader.IndexStride == 4) &&
+		mHeader.VertexOffset + vbByteSize <= size &&
+		mHeader.IndexOffset + ibByteSize <= size;
+
+	if (!valid)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MeshFile::Close()
+{
+	if (mView != nullptr)
+	{
+		UnmapViewOfFile(mView);
+		mView = nullptr;
+	}
+
+	if (mMapping != nullptr)
+	{
+		CloseHandle(mMapping);
+		mMapping = nullptr;
+	}
+
+	if (mFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mFile);
+		mFile = INVALID_HANDLE_VALUE;
+	}
+
+	mHeader = MeshFileHeader();
+}
+
+const MeshFileHeader& MeshFile::Header()const
+{
+	return mHeader;
+}
+
+const void* MeshFile::Vertices()const
+{
+	return mView + mHeader.VertexOffset;
+}
+
+UINT MeshFile::VertexByteSize()const
+{
+	return mHeader.VertexCount * mHeader.VertexStride;
+}
+
+const void* MeshFile::Indices()const
+{
+	return mView + mHeader.IndexOffset;
+}
+
+UINT MeshFile::IndexByteSize()const
+{
+	return mHeader.IndexCount * mHeader.IndexStride;
+}
+
+BoundingBox MeshFile::Bounds()const
+{
+	return BoundingBox(mHeader.BoundsCenter, mHeader.BoundsExtents);
+}
+
+bool MeshFile::Write(const std::wstring& filename,
+	const void* vertices, UINT vertexStride, UINT vertexCount,
+	const void* indices, UINT indexStride, UINT indexCount,
+	const BoundingBox& bounds, uint32_t vertexFormat)
+{
+	MeshFileHeader header;
+	header.VertexStride = vertexStride;
+	header.VertexCount = vertexCount;
+	header.IndexStride = indexStride;
+	header.IndexCount = indexCount;
+	header.VertexFormat = vertexFormat;
+	header.BoundsCenter = bounds.Center;
+	header.BoundsExtents = bounds.Extents;
+	header.VertexOffset = AlignOffset(sizeof(MeshFileHeader));
+	header.IndexOffset = AlignOffset(header.VertexOffset + (uint64_t)vertexCount * vertexStride);
+
+	std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+	if (!fout)
+		return false;
+
+	const char padding[16] = {};
+
+	fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	fout.write(padding, header.VertexOffset - sizeof(header));
+	fout.write(static_cast<const char*>(vertices), (std::streamsize)vertexCount * vertexStride);
+	fout.write(padding, header.IndexOffset - (header.VertexOffset + (uint64_t)vertexCount * vertexStride));
+	fout.write(static_cast<const char*>(indices), (std::streamsize)indexCount * indexStride);
+
+	return fout.good();
+}
+
+bool ImportTextMesh(const std::wstring& filename, TextMesh& mesh)
+{
+	std::ifstream fin(filename);
+	if (!fin)
+		return false;
+
+	UINT vertexCount = 0;
+	UINT triangleCount = 0;
+	std::string ignore;
+
+	fin >> ignore >> vertexCount;
+	fin >> ignore >> triangleCount;
+	fin >> ignore >> ignore >> ignore >> ignore;
+
+	mesh.Positions.resize(vertexCount);
+	mesh.Normals.resize(vertexCount);
+	for (UINT i = 0; i < vertexCount; ++i)
+	{
+		fin >> mesh.Positions[i].x >> mesh.Positions[i].y >> mesh.Positions[i].z;
+		fin >> mesh.Normals[i].x >> mesh.Normals[i].y >> mesh.Normals[i].z;
+	}
+
+	fin >> ignore;
+	fin >> ignore;
+	fin >> ignore;
+
+	mesh.Indices.resize(3 * triangleCount);
+	for (UINT i = 0; i < triangleCount; ++i)
+	{
+		fin >> mesh.Indices[i * 3 + 0] >> mesh.Indices[i * 3 + 1] >> mesh.Indices[i * 3 + 2];
+	}
+
+	// A truncated file leaves the stream failed; keep the partial mesh out.
+	if (!fin || mesh.Positions.empty())
+		return false;
+
+	BoundingBox::CreateFromPoints(mesh.Bounds, mesh.Positions.size(),
+		mesh.Positions.data(), sizeof(XMFLOAT3));
+
+	return true;
+}
@@ -0,0 +1,105 @@
+//***************************************************************************************
+// MeshFile.h
+//
+// A binary mesh format that is memory-mapped and handed straight to the GPU upload
+// code, so large models load without any text parsing:
+//
+//     MeshFileHeader
+//     vertex blob   (VertexCount * VertexStride bytes, in the layout VertexFormat names)
+//     index blob    (IndexCount * IndexStride bytes)
+//
+// The bounds of the whole mesh live in the header.  Blobs start on 16-byte
+// boundaries relative to the start of the file.  VertexFormat is 0 for the demo's
+// float Vertex, or VertexQuantizer::MeshFileFormat() for compact vertices, which
+// are quantized against the header's bounds.
+//
+// The text models shipped with the demos (skull.txt, car.txt) are read by
+// ImportTextMesh(); demos use it only when the binary file is missing or was
+// written for a different vertex layout or format, and then write the binary file next to it.
+//
+// Only depends on Windows and DirectXMath, so demos built against another copy of
+// Common can use it too.
+//***************************************************************************************
+
+#pragma once
+
+#include <windows.h>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct MeshFileHeader
+{
+	static const uint32_t MagicValue = 0x4853454D; // "MESH"
+	static const uint32_t CurrentVersion = 2;
+
+	uint32_t Magic = MagicValue;
+	uint32_t Version = CurrentVersion;
+
+	uint32_t VertexStride = 0;
+	uint32_t VertexCount = 0;
+	uint32_t IndexStride = 0; // 2 or 4 bytes
+	uint32_t IndexCount = 0;
+	uint32_t VertexFormat = 0;
+
+	DirectX::XMFLOAT3 BoundsCenter = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 BoundsExtents = { 0.0f, 0.0f, 0.0f };
+
+	uint64_t VertexOffset = 0;
+	uint64_t IndexOffset = 0;
+};
+
+// A read-only view of a mesh file.  The pointers stay valid until Close().
+class MeshFile
+{
+public:
+	MeshFile() = default;
+	MeshFile(const MeshFile& rhs) = delete;
+	MeshFile& operator=(const MeshFile& rhs) = delete;
+	~MeshFile();
+
+	// Maps the file.  Returns false if it is missing, truncated, from another
+	// version, or its vertices are not vertexStride bytes each in vertexFormat.
+	bool Open(const std::wstring& filename, UINT vertexStride, uint32_t vertexFormat = 0);
+	void Close();
+
+	const MeshFileHeader& Header()const;
+
+	const void* Vertices()const;
+	UINT VertexByteSize()const;
+
+	const void* Indices()const;
+	UINT IndexByteSize()const;
+
+	DirectX::BoundingBox Bounds()const;
+
+	// Writes a mesh file.  Returns false if the file cannot be written, which
+	// callers may ignore: the file is only a cache of the imported text model.
+	static bool Write(const std::wstring& filename,
+		const void* vertices, UINT vertexStride, UINT vertexCount,
+		const void* indices, UINT indexStride, UINT indexCount,
+		const DirectX::BoundingBox& bounds, uint32_t vertexFormat = 0);
+
+private:
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mMapping = nullptr;
+	const uint8_t* mView = nullptr;
+
+	MeshFileHeader mHeader;
+};
+
+// The "VertexCount: / TriangleCount: / VertexList (pos, normal) { ... }
+// TriangleList { ... }" text format of skull.txt and car.txt.
+struct TextMesh
+{
+	std::vector<DirectX::XMFLOAT3> Positions;
+	std::vector<DirectX::XMFLOAT3> Normals;
+	std::vector<uint32_t> Indices;
+
+	DirectX::BoundingBox Bounds;
+};
+
+// Returns false if the file cannot be opened.
+bool ImportTextMesh(const std::wstring& filename, TextMesh& mesh);
@@ -0,0 +1,332 @@
+//***************************************************************************************
+// MeshOptimizer.cpp
+//***************************************************************************************
+
+#include <windows.h>
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+using namespace DirectX;
+using std::uint32_t;
+
+namespace
+{
+	// Scoring constants from Tom Forsyth, "Linear-Speed Vertex Cache Optimisation".
+	const int MaxCacheSize = 32;
+	const float CacheDecayPower = 1.5f;
+	const float LastTriScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+
+	float VertexScore(int cachePosition, uint32_t liveTriangles)
+	{
+		// No triangles left to use this vertex.
+		if(liveTriangles == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if(cachePosition >= 0)
+		{
+			// The last triangle's vertices get a fixed score so the next triangle
+			// does not simply reuse the same edge and strip along it.
+			if(cachePosition < 3)
+				score = LastTriScore;
+			else
+			{
+				const float scaler = 1.0f / (MaxCacheSize - 3);
+				score = powf(1.0f - (cachePosition - 3) * scaler, CacheDecayPower);
+			}
+		}
+
+		// Boost vertices with few triangles left, so lone triangles get finished
+		// instead of leaving holes to come back to.
+		score += ValenceBoostScale * powf((float)liveTriangles, -ValenceBoostPower);
+
+		return score;
+	}
+
+	XMVECTOR LoadPosition(const BYTE* positions, size_t vertexStride, uint32_t index)
+	{
+		return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(positions + index * vertexStride));
+	}
+}
+
+float MeshOptimizer::ComputeACMR(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+	if(indexCount < 3)
+		return 0.0f;
+
+	// A vertex is still in the FIFO if it was inserted within the last cacheSize misses.
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	uint32_t time = cacheSize + 1;
+	uint32_t misses = 0;
+
+	for(size_t i = 0; i < indexCount; ++i)
+	{
+		uint32_t v = indices[i];
+		if(time - timestamps[v] > cacheSize)
+		{
+			timestamps[v] = time++;
+			misses++;
+		}
+	}
+
+	return (float)misses / (float)(indexCount / 3);
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	const size_t triCount = indexCount / 3;
+	if(triCount == 0)
+		return;
+
+	// Triangles using each vertex.  The first liveCount[v] entries of a vertex's
+	// range are the triangles not emitted yet.
+	std::vector<uint32_t> liveCount(vertexCount, 0);
+	for(size_t i = 0; i < indexCount; ++i)
+		liveCount[indices[i]]++;
+
+	std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+	for(size_t v = 0; v < vertexCount; ++v)
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + liveCount[v];
+
+	std::vector<uint32_t> adjacency(indexCount);
+	{
+		std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+		for(size_t i = 0; i < indexCount; ++i)
+			adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for(size_t v = 0; v < vertexCount; ++v)
+		vertexScore[v] = VertexScore(-1, liveCount[v]);
+
+	std::vector<float> triScore(triCount);
+	std::vector<bool> emitted(triCount, false);
+	int bestTri = 0;
+	for(size_t t = 0; t < triCount; ++t)
+	{
+		triScore[t] = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+		if(triScore[t] > triScore[bestTri])
+			bestTri = (int)t;
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(indexCount);
+
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	cache.reserve(MaxCacheSize + 3);
+	newCache.reserve(MaxCacheSize + 3);
+
+	size_t scanCursor = 0;
+	while(bestTri >= 0)
+	{
+		const uint32_t* tri = &indices[3 * bestTri];
+		emitted[bestTri] = true;
+		output.insert(output.end(), tri, tri + 3);
+
+		// The triangle's vertices move to the front of the cache.
+		newCache.clear();
+		for(int k = 0; k < 3; ++k)
+		{
+			uint32_t v = tri[k];
+			if(std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+				newCache.push_back(v);
+
+			// Retire the triangle from the vertex's live range.
+			uint32_t* first = &adjacency[adjacencyOffset[v]];
+			uint32_t* last = first + liveCount[v];
+			uint32_t* it = std::find(first, last, (uint32_t)bestTri);
+			std::swap(*it, *(last - 1));
+			liveCount[v]--;
+		}
+
+		for(uint32_t v : cache)
+		{
+			if(std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+				newCache.push_back(v);
+		}
+
+		// Entries past MaxCacheSize have just been evicted; they still need a
+		// rescore, so they stay in newCache for the loop below.
+		for(size_t i = 0; i < newCache.size(); ++i)
+		{
+			uint32_t v = newCache[i];
+			cachePosition[v] = i < (size_t)MaxCacheSize ? (int)i : -1;
+			vertexScore[v] = VertexScore(cachePosition[v], liveCount[v]);
+		}
+
+		bestTri = -1;
+		float bestScore = -1.0f;
+		for(uint32_t v : newCache)
+		{
+			for(uint32_t a = 0; a < liveCount[v]; ++a)
+			{
+				uint32_t t = adjacency[adjacencyOffset[v] + a];
+				triScore[t] = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+				if(triScore[t] > bestScore)
+				{
+					bestScore = triScore[t];
+					bestTri = (int)t;
+				}
+			}
+		}
+
+		if(newCache.size() > (size_t)MaxCacheSize)
+			newCache.resize(MaxCacheSize);
+		cache.swap(newCache);
+
+		// Nothing in the cache has triangles left; continue with any other one.
+		if(bestTri < 0)
+		{
+			while(scanCursor < triCount && emitted[scanCursor])
+				scanCursor++;
+
+			if(scanCursor < triCount)
+				bestTri = (int)scanCursor;
+		}
+	}
+
+	memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+void MeshOptimizer::OptimizeOverdraw(uint32_t* indices, size_t indexCount,
+	const void* positions, size_t vertexCount, size_t vertexStride)
+{
+	const size_t triCount = indexCount / 3;
+	if(triCount < 2)
+		return;
+
+	const BYTE* pos = reinterpret_cast<const BYTE*>(positions);
+
+	// Clusters start wherever the cache-optimized order restarts, i.e. at a
+	// triangle whose three vertices all miss the cache.  Moving whole clusters
+	// around therefore costs little vertex reuse.
+	std::vector<size_t> clusterStart;
+	{
+		std::vector<uint32_t> timestamps(vertexCount, 0);
+		uint32_t time = DefaultCacheSize + 1;
+		for(size_t t = 0; t < triCount; ++t)
+		{
+			int misses = 0;
+			for(int k = 0; k < 3; ++k)
+			{
+				uint32_t v = indices[3 * t + k];
+				if(time - timestamps[v] > DefaultCacheSize)
+				{
+					timestamps[v] = time++;
+					misses++;
+				}
+			}
+
+			if(t == 0 || misses == 3)
+				clusterStart.push_back(t);
+		}
+	}
+
+	const size_t clusterCount = clusterStart.size();
+	clusterStart.push_back(triCount);
+
+	XMVECTOR meshCentroid = XMVectorZero();
+	for(size_t i = 0; i < indexCount; ++i)
+		meshCentroid += LoadPosition(pos, vertexStride, indices[i]);
+	meshCentroid /= (float)indexCount;
+
+	// Clusters facing away from the mesh center are the likely occluders; draw
+	// them first.
+	std::vector<float> sortKey(clusterCount);
+	for(size_t c = 0; c < clusterCount; ++c)
+	{
+		XMVECTOR centroid = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		for(size_t t = clusterStart[c]; t < clusterStart[c + 1]; ++t)
+		{
+			XMVECTOR p0 = LoadPosition(pos, vertexStride, indices[3 * t]);
+			XMVECTOR p1 = LoadPosition(pos, vertexStride, indices[3 * t + 1]);
+			XMVECTOR p2 = LoadPosition(pos, vertexStride, indices[3 * t + 2]);
+
+			centroid += p0 + p1 + p2;
+			normal += XMVector3Cross(p1 - p0, p2 - p0); // area weighted
+		}
+
+		centroid /= 3.0f * (float)(clusterStart[c + 1] - clusterStart[c]);
+		normal = XMVector3Normalize(normal);
+		sortKey[c] = XMVectorGetX(XMVector3Dot(centroid - meshCentroid, normal));
+	}
+
+	std::vector<uint32_t> order(clusterCount);
+	for(size_t c = 0; c < clusterCount; ++c)
+		order[c] = (uint32_t)c;
+	std::stable_sort(order.begin(), order.end(),
+		[&sortKey](uint32_t a, uint32_t b) { return sortKey[a] > sortKey[b]; });
+
+	std::vector<uint32_t> output;
+	output.reserve(indexCount);
+	for(uint32_t c : order)
+		output.insert(output.end(), indices + 3 * clusterStart[c], indices + 3 * clusterStart[c + 1]);
+
+	memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+size_t MeshOptimizer::OptimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexStride,
+	uint32_t* indices, size_t indexCount)
+{
+	const uint32_t unused = ~0u;
+	std::vector<uint32_t> remap(vertexCount, unused);
+
+	uint32_t next = 0;
+	for(size_t i = 0; i < indexCount; ++i)
+	{
+		uint32_t& r = remap[indices[i]];
+		if(r == unused)
+			r = next++;
+		indices[i] = r;
+	}
+
+	BYTE* data = reinterpret_cast<BYTE*>(vertices);
+	std::vector<BYTE> original(data, data + vertexCount * vertexStride);
+	for(size_t v = 0; v < vertexCount; ++v)
+	{
+		if(remap[v] != unused)
+			memcpy(data + remap[v] * vertexStride, &original[v * vertexStride], vertexStride);
+	}
+
+	return next;
+}
+
+MeshOptimizerStats MeshOptimizer::Optimize(void* vertices, size_t& vertexCount, size_t vertexStride,
+	uint32_t* indices, size_t indexCount, const char* name)
+{
+	MeshOptimizerStats stats;
+	stats.VertexCountBefore = (uint32_t)vertexCount;
+	stats.AcmrBefore = ComputeACMR(indices, indexCount, vertexCount);
+
+	OptimizeVertexCache(indices, indexCount, vertexCount);
+	OptimizeOverdraw(indices, indexCount, vertices, vertexCount, vertexStride);
+	vertexCount = OptimizeVertexFetch(vertices, vertexCount, vertexStride, indices, indexCount);
+
+	stats.VertexCountAfter = (uint32_t)vertexCount;
+	stats.AcmrAfter = ComputeACMR(indices, indexCount, vertexCount);
+
+	std::string text = std::string("MeshOptimizer: ") + (name ? name : "mesh") +
+		" ACMR " + std::to_string(stats.AcmrBefore) + " -> " + std::to_string(stats.AcmrAfter) +
+		", vertices " + std::to_string(stats.VertexCountBefore) + " -> " + std::to_string(stats.VertexCountAfter) + "\n";
+	OutputDebugStringA(text.c_str());
+
+	return stats;
+}
+
+MeshOptimizerStats MeshOptimizer::Optimize(GeometryGenerator::MeshData& mesh, const char* name)
+{
+	size_t vertexCount = mesh.Vertices.size();
+	MeshOptimizerStats stats = Optimize(mesh.Vertices.data(), vertexCount, sizeof(GeometryGenerator::Vertex),
+		mesh.Indices32.data(), mesh.Indices32.size(), name);
+	mesh.Vertices.resize(vertexCount);
+
+	return stats;
+}
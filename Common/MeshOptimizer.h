@@ -0,0 +1,64 @@
+//***************************************************************************************
+// MeshOptimizer.h
+//
+// Reorders an indexed triangle list before upload so it is cheaper to draw:
+//
+//   1. OptimizeVertexCache  - greedy triangle reordering (Forsyth's linear-speed
+//                             algorithm) so recently transformed vertices are reused.
+//   2. OptimizeOverdraw     - splits the result into clusters at cache restarts and
+//                             draws clusters facing away from the mesh center first,
+//                             so they tend to occlude the rest.
+//   3. OptimizeVertexFetch  - renumbers vertices in first-use order and reorders the
+//                             vertex data to match, for sequential vertex fetch.
+//
+// ACMR (average cache miss ratio) is the number of vertex shader invocations per
+// triangle for a FIFO cache; 0.5 is ideal for a regular grid, 3.0 is the worst case.
+//
+// All functions work on 32-bit indices and an opaque vertex stride, so both
+// GeometryGenerator::MeshData and the demos' own Vertex types can use them.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+
+struct MeshOptimizerStats
+{
+	float AcmrBefore = 0.0f;
+	float AcmrAfter = 0.0f;
+	std::uint32_t VertexCountBefore = 0;
+	std::uint32_t VertexCountAfter = 0;
+};
+
+class MeshOptimizer
+{
+public:
+	// Cache size used for ACMR reports; matches the small FIFOs of older GPUs,
+	// which makes it a conservative estimate for newer ones.
+	static const std::uint32_t DefaultCacheSize = 16;
+
+	static float ComputeACMR(const std::uint32_t* indices, size_t indexCount, size_t vertexCount,
+		std::uint32_t cacheSize = DefaultCacheSize);
+
+	// Reorders triangles in place.
+	static void OptimizeVertexCache(std::uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+	// Call after OptimizeVertexCache.  positions points at the first vertex's
+	// XMFLOAT3 position; consecutive positions are vertexStride bytes apart.
+	// Reorders whole clusters, so the cache efficiency is largely kept.
+	static void OptimizeOverdraw(std::uint32_t* indices, size_t indexCount,
+		const void* positions, size_t vertexCount, size_t vertexStride);
+
+	// Rewrites vertices and indices in place.  Vertices no index refers to are
+	// dropped; returns the new vertex count.
+	static size_t OptimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexStride,
+		std::uint32_t* indices, size_t indexCount);
+
+	// Runs all three passes over a vertex array whose elements start with an
+	// XMFLOAT3 position.  The stats are also written to the debugger output.
+	static MeshOptimizerStats Optimize(void* vertices, size_t& vertexCount, size_t vertexStride,
+		std::uint32_t* indices, size_t indexCount, const char* name = nullptr);
+
+	// Call before MeshData::GetIndices16, which caches its result.
+	static MeshOptimizerStats Optimize(GeometryGenerator::MeshData& mesh, const char* name = nullptr);
+};
@@ -0,0 +1,221 @@
+//***************************************************************************************
+// MeshSimplifier.cpp
+//***************************************************************************************
+
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+using namespace DirectX;
+using std::uint32_t;
+using std::uint64_t;
+
+namespace
+{
+	const XMFLOAT3& PositionAt(const BYTE* positions, size_t vertexStride, uint32_t index)
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(positions + index * vertexStride);
+	}
+
+	// One clustering pass at a fixed grid resolution.
+	MeshLodLevel Cluster(const uint32_t* indices, size_t indexCount,
+		const BYTE* positions, size_t vertexCount, size_t vertexStride,
+		const XMFLOAT3& boundsMin, float cellSize)
+	{
+		const uint32_t none = ~0u;
+		const float invCellSize = 1.0f / cellSize;
+
+		// Cell of every referenced vertex, packed 21 bits per axis.
+		std::vector<uint32_t> vertexCluster(vertexCount, none);
+		std::unordered_map<uint64_t, uint32_t> cellToCluster;
+		std::vector<XMFLOAT4> centroids; // xyz sum, w count
+
+		for(size_t i = 0; i < indexCount; ++i)
+		{
+			uint32_t v = indices[i];
+			if(vertexCluster[v] != none)
+				continue;
+
+			const XMFLOAT3& p = PositionAt(positions, vertexStride, v);
+			uint64_t x = (uint64_t)((p.x - boundsMin.x) * invCellSize) & 0x1FFFFF;
+			uint64_t y = (uint64_t)((p.y - boundsMin.y) * invCellSize) & 0x1FFFFF;
+			uint64_t z = (uint64_t)((p.z - boundsMin.z) * invCellSize) & 0x1FFFFF;
+			uint64_t cell = x | (y << 21) | (z << 42);
+
+			auto it = cellToCluster.find(cell);
+			if(it == cellToCluster.end())
+			{
+				it = cellToCluster.emplace(cell, (uint32_t)centroids.size()).first;
+				centroids.push_back(XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+			}
+
+			uint32_t c = it->second;
+			vertexCluster[v] = c;
+			centroids[c].x += p.x;
+			centroids[c].y += p.y;
+			centroids[c].z += p.z;
+			centroids[c].w += 1.0f;
+		}
+
+		// Each cluster is represented by its member nearest the centroid, so the
+		// output keeps indexing the original vertex buffer.
+		std::vector<uint32_t> representative(centroids.size(), none);
+		std::vector<float> bestDistSq(centroids.size(), FLT_MAX);
+		for(size_t v = 0; v < vertexCount; ++v)
+		{
+			uint32_t c = vertexCluster[v];
+			if(c == none)
+				continue;
+
+			const XMFLOAT3& p = PositionAt(positions, vertexStride, (uint32_t)v);
+			float inv = 1.0f / centroids[c].w;
+			float dx = p.x - centroids[c].x * inv;
+			float dy = p.y - centroids[c].y * inv;
+			float dz = p.z - centroids[c].z * inv;
+			float distSq = dx * dx + dy * dy + dz * dz;
+			if(distSq < bestDistSq[c])
+			{
+				bestDistSq[c] = distSq;
+				representative[c] = (uint32_t)v;
+			}
+		}
+
+		MeshLodLevel level;
+		float maxErrorSq = 0.0f;
+		for(size_t v = 0; v < vertexCount; ++v)
+		{
+			uint32_t c = vertexCluster[v];
+			if(c == none)
+				continue;
+
+			XMVECTOR d = XMLoadFloat3(&PositionAt(positions, vertexStride, (uint32_t)v)) -
+				XMLoadFloat3(&PositionAt(positions, vertexStride, representative[c]));
+			float errorSq = XMVectorGetX(XMVector3LengthSq(d));
+			if(errorSq > maxErrorSq)
+				maxErrorSq = errorSq;
+		}
+		level.Error = sqrtf(maxErrorSq);
+
+		// Drop collapsed triangles.  Each survivor is rotated so its smallest index
+		// comes first, which keeps the winding and makes duplicates compare equal.
+		std::vector<std::array<uint32_t, 3>> triangles;
+		triangles.reserve(indexCount / 3);
+		for(size_t t = 0; t + 2 < indexCount; t += 3)
+		{
+			uint32_t a = representative[vertexCluster[indices[t]]];
+			uint32_t b = representative[vertexCluster[indices[t + 1]]];
+			uint32_t c = representative[vertexCluster[indices[t + 2]]];
+			if(a == b || b == c || c == a)
+				continue;
+
+			if(b < a && b < c)
+				triangles.push_back({ { b, c, a } });
+			else if(c < a && c < b)
+				triangles.push_back({ { c, a, b } });
+			else
+				triangles.push_back({ { a, b, c } });
+		}
+
+		std::sort(triangles.begin(), triangles.end());
+		triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+
+		level.Indices.reserve(triangles.size() * 3);
+		for(const auto& tri : triangles)
+			level.Indices.insert(level.Indices.end(), tri.begin(), tri.end());
+
+		return level;
+	}
+}
+
+MeshLodLevel MeshSimplifier::Simplify(const uint32_t* indices, size_t indexCount,
+	const void* positions, size_t vertexCount, size_t vertexStride,
+	size_t targetIndexCount)
+{
+	const BYTE* pos = reinterpret_cast<const BYTE*>(positions);
+
+	XMVECTOR vMin = XMVectorReplicate(FLT_MAX);
+	XMVECTOR vMax = XMVectorReplicate(-FLT_MAX);
+	for(size_t i = 0; i < indexCount; ++i)
+	{
+		XMVECTOR p = XMLoadFloat3(&PositionAt(pos, vertexStride, indices[i]));
+		vMin = XMVectorMin(vMin, p);
+		vMax = XMVectorMax(vMax, p);
+	}
+
+	XMFLOAT3 boundsMin, extent;
+	XMStoreFloat3(&boundsMin, vMin);
+	XMStoreFloat3(&extent, vMax - vMin);
+	float maxExtent = MathHelper::Max(extent.x, MathHelper::Max(extent.y, extent.z));
+	if(maxExtent <= 0.0f)
+		return MeshLodLevel();
+
+	// The index count grows with the grid resolution, so binary search for the
+	// finest grid that still meets the target.
+	MeshLodLevel best;
+	UINT lo = 1;
+	UINT hi = 1024;
+	while(lo <= hi)
+	{
+		UINT mid = (lo + hi) / 2;
+		MeshLodLevel level = Cluster(indices, indexCount, pos, vertexCount, vertexStride,
+			boundsMin, maxExtent / (float)mid * 1.0001f);
+
+		if(level.Indices.size() <= targetIndexCount)
+		{
+			best = std::move(level);
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid - 1;
+		}
+	}
+
+	return best;
+}
+
+std::vector<MeshLodLevel> MeshSimplifier::BuildLodChain(const uint32_t* indices, size_t indexCount,
+	const void* positions, size_t vertexCount, size_t vertexStride,
+	UINT maxLevels, float reduction)
+{
+	std::vector<MeshLodLevel> chain;
+
+	MeshLodLevel full;
+	full.Indices.assign(indices, indices + indexCount);
+	chain.push_back(std::move(full));
+
+	while(chain.size() < maxLevels)
+	{
+		const MeshLodLevel& previous = chain.back();
+		size_t target = (size_t)(previous.Indices.size() * reduction);
+
+		// Simplify from the full mesh every time, so errors do not accumulate.
+		MeshLodLevel level = Simplify(indices, indexCount, positions, vertexCount, vertexStride, target);
+		if(level.Indices.size() < 3 || level.Indices.size() > previous.Indices.size() * 9 / 10)
+			break;
+
+		MeshOptimizer::OptimizeVertexCache(level.Indices.data(), level.Indices.size(), vertexCount);
+		chain.push_back(std::move(level));
+	}
+
+	return chain;
+}
+
+int MeshSimplifier::SelectLod(const SubmeshGeometry* lods, int lodCount, int currentLod,
+	float distance, float worldScale, float pixelScale,
+	float maxPixelError, float hysteresis)
+{
+	if(lodCount <= 1)
+		return 0;
+
+	const float pixelsPerUnit = worldScale * pixelScale / MathHelper::Max(distance, 1e-3f);
+
+	int lod = MathHelper::Clamp(currentLod, 0, lodCount - 1);
+
+	while(lod + 1 < lodCount && lods[lod + 1].LodError * pixelsPerUnit < maxPixelError * (1.0f - hysteresis))
+		lod++;
+
+	while(lod > 0 && lods[lod].LodError * pixelsPerUnit > maxPixelError * (1.0f + hysteresis))
+		lod--;
+
+	return lod;
+}
@@ -0,0 +1,51 @@
+//***************************************************************************************
+// MeshSimplifier.h
+//
+// Builds LOD chains by vertex clustering.  The bounding box is cut into a uniform
+// grid, every cell collapses to the original vertex nearest its centroid, and
+// triangles that become degenerate are dropped.  The result only references the
+// input vertices, so all levels of a chain share one vertex buffer and only add
+// index ranges to MeshGeometry::DrawArgs.
+//
+// SelectLod() picks a level from its projected error in pixels, with hysteresis
+// so an item near a switching distance does not flicker between two levels.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+struct MeshLodLevel
+{
+	std::vector<std::uint32_t> Indices;
+
+	// Largest object-space distance from a vertex to the vertex it was merged into.
+	float Error = 0.0f;
+};
+
+class MeshSimplifier
+{
+public:
+	// Searches the grid resolution for the finest result with at most
+	// targetIndexCount indices.  positions points at the first vertex's XMFLOAT3
+	// position; consecutive positions are vertexStride bytes apart.
+	static MeshLodLevel Simplify(const std::uint32_t* indices, size_t indexCount,
+		const void* positions, size_t vertexCount, size_t vertexStride,
+		size_t targetIndexCount);
+
+	// Level 0 is a copy of the input.  Each further level aims for reduction times
+	// the index count of the previous one; the chain stops early when a level no
+	// longer shrinks much.  Every level is reordered for the vertex cache.
+	static std::vector<MeshLodLevel> BuildLodChain(const std::uint32_t* indices, size_t indexCount,
+		const void* positions, size_t vertexCount, size_t vertexStride,
+		UINT maxLevels = 4, float reduction = 0.5f);
+
+	// lods[0] is full detail.  distance is from the eye to the object, worldScale
+	// scales LodError to world space (the object's largest scale factor), and
+	// pixelScale is proj(1,1) * viewportHeight / 2.  A coarser level is chosen once
+	// its error drops below maxPixelError * (1 - hysteresis); the current level is
+	// kept until its error exceeds maxPixelError * (1 + hysteresis).
+	static int SelectLod(const SubmeshGeometry* lods, int lodCount, int currentLod,
+		float distance, float worldScale, float pixelScale,
+		float maxPixelError = 1.0f, float hysteresis = 0.25f);
+};
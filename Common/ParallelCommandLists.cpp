@@ -0,0 +1,58 @@
+//***************************************************************************************
+// ParallelCommandLists.cpp
+//***************************************************************************************
+
+#include "ParallelCommandLists.h"
+
+ParallelCommandLists::ParallelCommandLists(ID3D12Device* device, D3D12_COMMAND_LIST_TYPE type) :
+	md3dDevice(device), mType(type)
+{
+}
+
+void ParallelCommandLists::Resize(UINT count)
+{
+	while (mCommandLists.size() < count)
+	{
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocator;
+		ThrowIfFailed(md3dDevice->CreateCommandAllocator(
+			mType,
+			IID_PPV_ARGS(allocator.GetAddressOf())));
+
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> cmdList;
+		ThrowIfFailed(md3dDevice->CreateCommandList(
+			0,
+			mType,
+			allocator.Get(),
+			nullptr,
+			IID_PPV_ARGS(cmdList.GetAddressOf())));
+
+		// Start off in a closed state, like D3DApp::mCommandList.
+		ThrowIfFailed(cmdList->Close());
+
+		mAllocators.push_back(allocator);
+		mCommandLists.push_back(cmdList);
+	}
+}
+
+UINT ParallelCommandLists::Count()const
+{
+	return (UINT)mCommandLists.size();
+}
+
+ID3D12GraphicsCommandList* ParallelCommandLists::Begin(UINT i, ID3D12PipelineState* initialState)
+{
+	assert(i < mCommandLists.size());
+
+	ThrowIfFailed(mAllocators[i]->Reset());
+	ThrowIfFailed(mCommandLists[i]->Reset(mAllocators[i].Get(), initialState));
+
+	return mCommandLists[i].Get();
+}
+
+void ParallelCommandLists::Gather(UINT count, std::vector<ID3D12CommandList*>& cmdLists)const
+{
+	assert(count <= mCommandLists.size());
+
+	for (UINT i = 0; i < count; ++i)
+		cmdLists.push_back(mCommandLists[i].Get());
+}
@@ -0,0 +1,61 @@
+//***************************************************************************************
+// ParallelCommandLists.h
+//
+// A set of command allocator/list pairs so one frame can be recorded on several
+// threads.  Each slot is recorded by exactly one thread; the closed lists are then
+// submitted in slot order with a single ExecuteCommandLists, so the GPU sees the
+// same command stream as if they had been recorded serially.
+//
+// Like FrameResource::CmdListAlloc, the allocators can only be reset once the GPU
+// has finished with them, so keep one ParallelCommandLists per frame resource.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "JobSystem.h"
+
+class ParallelCommandLists
+{
+public:
+	ParallelCommandLists(ID3D12Device* device, D3D12_COMMAND_LIST_TYPE type = D3D12_COMMAND_LIST_TYPE_DIRECT);
+	ParallelCommandLists(const ParallelCommandLists& rhs) = delete;
+	ParallelCommandLists& operator=(const ParallelCommandLists& rhs) = delete;
+	~ParallelCommandLists() = default;
+
+	// Makes sure at least count slots exist.  Not thread safe; call before recording.
+	void Resize(UINT count);
+	UINT Count()const;
+
+	// Resets slot i and returns its list, open for recording.  Different slots
+	// may be reset and recorded on different threads at the same time.
+	ID3D12GraphicsCommandList* Begin(UINT i, ID3D12PipelineState* initialState);
+
+	// Appends the first count lists to cmdLists in slot order.  They must be closed.
+	void Gather(UINT count, std::vector<ID3D12CommandList*>& cmdLists)const;
+
+	// Calls record(i, cmdList) for every i in [0, count) on jobs' threads, one
+	// slot each, and closes the lists.  Returns once all of them are recorded.
+	template<typename RecordFn>
+	void Record(JobSystem& jobs, UINT count, ID3D12PipelineState* initialState, const RecordFn& record);
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+	D3D12_COMMAND_LIST_TYPE mType = D3D12_COMMAND_LIST_TYPE_DIRECT;
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> mAllocators;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>> mCommandLists;
+};
+
+template<typename RecordFn>
+void ParallelCommandLists::Record(JobSystem& jobs, UINT count, ID3D12PipelineState* initialState, const RecordFn& record)
+{
+	Resize(count);
+
+	jobs.ParallelFor(0, count, 1, [&](UINT i)
+	{
+		ID3D12GraphicsCommandList* cmdList = Begin(i, initialState);
+		record(i, cmdList);
+		ThrowIfFailed(cmdList->Close());
+	});
+}
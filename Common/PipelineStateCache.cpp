@@ -0,0 +1,224 @@
+//***************************************************************************************
+// PipelineStateCache.cpp
+//***************************************************************************************
+
+#include "PipelineStateCache.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// 64-bit FNV-1a over the parts of a description that define the PSO.
+	uint64_t HashBytes(const void* data, size_t size, uint64_t hash)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	template<typename T>
+	uint64_t HashValue(const T& value, uint64_t hash)
+	{
+		return HashBytes(&value, sizeof(T), hash);
+	}
+
+	uint64_t HashShader(const D3D12_SHADER_BYTECODE& shader, uint64_t hash)
+	{
+		hash = HashValue(shader.BytecodeLength, hash);
+		return shader.pShaderBytecode != nullptr ?
+			HashBytes(shader.pShaderBytecode, shader.BytecodeLength, hash) : hash;
+	}
+
+	uint64_t HashDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+	{
+		uint64_t hash = 14695981039346656037ull;
+
+		hash = HashShader(desc.VS, hash);
+		hash = HashShader(desc.PS, hash);
+		hash = HashShader(desc.DS, hash);
+		hash = HashShader(desc.HS, hash);
+		hash = HashShader(desc.GS, hash);
+
+		// Render target blend descs end in a UINT8, so their padding bytes are not
+		// reliable; hash them field by field.  The other states have no padding.
+		hash = HashValue(desc.BlendState.AlphaToCoverageEnable, hash);
+		hash = HashValue(desc.BlendState.IndependentBlendEnable, hash);
+		for (const D3D12_RENDER_TARGET_BLEND_DESC& rt : desc.BlendState.RenderTarget)
+		{
+			hash = HashValue(rt.BlendEnable, hash);
+			hash = HashValue(rt.LogicOpEnable, hash);
+			hash = HashValue(rt.SrcBlend, hash);
+			hash = HashValue(rt.DestBlend, hash);
+			hash = HashValue(rt.BlendOp, hash);
+			hash = HashValue(rt.SrcBlendAlpha, hash);
+			hash = HashValue(rt.DestBlendAlpha, hash);
+			hash = HashValue(rt.BlendOpAlpha, hash);
+			hash = HashValue(rt.LogicOp, hash);
+			hash = HashValue(rt.RenderTargetWriteMask, hash);
+		}
+
+		hash = HashValue(desc.SampleMask, hash);
+		hash = HashValue(desc.RasterizerState, hash);
+		hash = HashValue(desc.DepthStencilState, hash);
+		hash = HashValue(desc.IBStripCutValue, hash);
+		hash = HashValue(desc.PrimitiveTopologyType, hash);
+		hash = HashValue(desc.NumRenderTargets, hash);
+		hash = HashBytes(desc.RTVFormats, sizeof(desc.RTVFormats[0]) * desc.NumRenderTargets, hash);
+		hash = HashValue(desc.DSVFormat, hash);
+		hash = HashValue(desc.SampleDesc, hash);
+		hash = HashValue(desc.NodeMask, hash);
+		hash = HashValue(desc.Flags, hash);
+
+		for (UINT i = 0; i < desc.InputLayout.NumElements; ++i)
+		{
+			const D3D12_INPUT_ELEMENT_DESC& element = desc.InputLayout.pInputElementDescs[i];
+			hash = HashBytes(element.SemanticName, strlen(element.SemanticName), hash);
+			hash = HashValue(element.SemanticIndex, hash);
+			hash = HashValue(element.Format, hash);
+			hash = HashValue(element.InputSlot, hash);
+			hash = HashValue(element.AlignedByteOffset, hash);
+			hash = HashValue(element.InputSlotClass, hash);
+			hash = HashValue(element.InstanceDataStepRate, hash);
+		}
+
+		return hash;
+	}
+
+	uint64_t HashDesc(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		hash = HashShader(desc.CS, hash);
+		hash = HashValue(desc.NodeMask, hash);
+		hash = HashValue(desc.Flags, hash);
+		return hash;
+	}
+}
+
+PipelineStateCache::PipelineStateCache(ID3D12Device* device, const std::wstring& filename) :
+	md3dDevice(device), mFilename(filename)
+{
+	// Pipeline libraries need ID3D12Device1; without it every PSO is just created.
+	if (FAILED(md3dDevice->QueryInterface(IID_PPV_ARGS(mDevice1.GetAddressOf()))))
+		return;
+
+	std::ifstream fin(mFilename, std::ios::binary);
+	if (fin)
+		mLibraryData.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+
+	if (!mLibraryData.empty())
+	{
+		// Fails with D3D12_ERROR_DRIVER_VERSION_MISMATCH/ADAPTER_NOT_FOUND when the
+		// file was written on another driver or GPU; start over in that case.
+		HRESULT hr = mDevice1->CreatePipelineLibrary(mLibraryData.data(), mLibraryData.size(),
+			IID_PPV_ARGS(mLibrary.GetAddressOf()));
+		if (SUCCEEDED(hr))
+			return;
+	}
+
+	ResetLibrary();
+}
+
+ComPtr<ID3D12PipelineState> PipelineStateCache::CreateGraphicsPipelineState(
+	const std::string& name, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+	std::wstring key = MakeKey(name, HashDesc(desc));
+
+	ComPtr<ID3D12PipelineState> pso;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mLibrary != nullptr &&
+			SUCCEEDED(mLibrary->LoadGraphicsPipeline(key.c_str(), &desc, IID_PPV_ARGS(pso.GetAddressOf()))))
+		{
+			mPipelines.push_back({ key, pso });
+			return pso;
+		}
+	}
+
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(pso.GetAddressOf())));
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	Store(key, pso.Get());
+	mPipelines.push_back({ key, pso });
+	return pso;
+}
+
+ComPtr<ID3D12PipelineState> PipelineStateCache::CreateComputePipelineState(
+	const std::string& name, const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc)
+{
+	std::wstring key = MakeKey(name, HashDesc(desc));
+
+	ComPtr<ID3D12PipelineState> pso;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mLibrary != nullptr &&
+			SUCCEEDED(mLibrary->LoadComputePipeline(key.c_str(), &desc, IID_PPV_ARGS(pso.GetAddressOf()))))
+		{
+			mPipelines.push_back({ key, pso });
+			return pso;
+		}
+	}
+
+	ThrowIfFailed(md3dDevice->CreateComputePipelineState(&desc, IID_PPV_ARGS(pso.GetAddressOf())));
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	Store(key, pso.Get());
+	mPipelines.push_back({ key, pso });
+	return pso;
+}
+
+void PipelineStateCache::Save()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (mLibrary == nullptr || !mDirty)
+		return;
+
+	std::vector<char> data(mLibrary->GetSerializedSize());
+	ThrowIfFailed(mLibrary->Serialize(data.data(), data.size()));
+
+	// Nothing is lost if this fails; the next run compiles the PSOs again.
+	std::ofstream fout(mFilename, std::ios::binary | std::ios::trunc);
+	fout.write(data.data(), data.size());
+
+	mDirty = false;
+}
+
+void PipelineStateCache::ResetLibrary()
+{
+	mLibrary = nullptr;
+	mLibraryData.clear();
+
+	if (FAILED(mDevice1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(mLibrary.GetAddressOf()))))
+		mLibrary = nullptr;
+}
+
+void PipelineStateCache::Store(const std::wstring& key, ID3D12PipelineState* pso)
+{
+	if (mLibrary == nullptr)
+		return;
+
+	mDirty = true;
+	if (SUCCEEDED(mLibrary->StorePipeline(key.c_str(), pso)))
+		return;
+
+	// The key is taken by an entry that no longer loads (its root signature
+	// changed, say).  Entries cannot be replaced, so rebuild the library from
+	// what this run has created so far.
+	ResetLibrary();
+	if (mLibrary == nullptr)
+		return;
+
+	for (const auto& pipeline : mPipelines)
+		mLibrary->StorePipeline(pipeline.first.c_str(), pipeline.second.Get());
+	mLibrary->StorePipeline(key.c_str(), pso);
+}
+
+std::wstring PipelineStateCache::MakeKey(const std::string& name, uint64_t descHash)
+{
+	wchar_t hash[17];
+	swprintf_s(hash, L"%016llx", descHash);
+	return AnsiToWString(name) + L"_" + hash;
+}
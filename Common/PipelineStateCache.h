@@ -0,0 +1,66 @@
+//***************************************************************************************
+// PipelineStateCache.h
+//
+// Creates pipeline state objects through an ID3D12PipelineLibrary that is saved to
+// disk, so the driver only compiles a PSO the first time it is seen.
+//
+// PSOs are stored under the demo's name for them plus a hash of the description
+// (shader bytecode, input layout and fixed-function state), so editing a shader or
+// a state gives a new entry instead of a stale hit.  Whenever the library cannot be
+// used -- no ID3D12Device1, a file written by another driver or adapter, or a stored
+// PSO that no longer matches (e.g. a changed root signature) -- the PSO is simply
+// created from its description and the library is rebuilt on Save().
+//
+// PSOs may be created from several threads at once.  The library is used under a
+// lock, but the driver compiles outside it, so misses compile in parallel.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include <mutex>
+
+class PipelineStateCache
+{
+public:
+	PipelineStateCache(ID3D12Device* device, const std::wstring& filename);
+	PipelineStateCache(const PipelineStateCache& rhs) = delete;
+	PipelineStateCache& operator=(const PipelineStateCache& rhs) = delete;
+	~PipelineStateCache() = default;
+
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> CreateGraphicsPipelineState(
+		const std::string& name, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> CreateComputePipelineState(
+		const std::string& name, const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc);
+
+	// Writes the library to disk if any PSO was added this run.
+	void Save();
+
+private:
+	void ResetLibrary();
+
+	// Adds pso to the library, rebuilding the library if it refuses the entry.
+	// Called with mMutex held.
+	void Store(const std::wstring& key, ID3D12PipelineState* pso);
+
+	static std::wstring MakeKey(const std::string& name, uint64_t descHash);
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Device1> mDevice1;
+	Microsoft::WRL::ComPtr<ID3D12PipelineLibrary> mLibrary;
+
+	std::wstring mFilename;
+
+	// The library reads its entries from this memory, so it lives as long as mLibrary.
+	std::vector<char> mLibraryData;
+
+	// Every PSO handed out this run, so an invalidated library can be rebuilt.
+	std::vector<std::pair<std::wstring, Microsoft::WRL::ComPtr<ID3D12PipelineState>>> mPipelines;
+
+	bool mDirty = false;
+
+	// Guards mLibrary, mLibraryData, mPipelines and mDirty after construction.
+	std::mutex mMutex;
+};
@@ -0,0 +1,677 @@
+//***************************************************************************************
+// RenderGraph.cpp
+//***************************************************************************************
+
+#include "RenderGraph.h"
+#include <iomanip>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// States in which the resource may be written; the others can be combined.
+	const D3D12_RESOURCE_STATES gWriteStates =
+		D3D12_RESOURCE_STATE_RENDER_TARGET |
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS |
+		D3D12_RESOURCE_STATE_DEPTH_WRITE |
+		D3D12_RESOURCE_STATE_STREAM_OUT |
+		D3D12_RESOURCE_STATE_COPY_DEST |
+		D3D12_RESOURCE_STATE_RESOLVE_DEST;
+
+	// True when a resource in current may already be used as state, without a barrier.
+	bool IsSatisfied(D3D12_RESOURCE_STATES current, D3D12_RESOURCE_STATES state)
+	{
+		if (current == state)
+			return true;
+		return state != 0 && (current & gWriteStates) == 0 && (current & state) == state;
+	}
+
+	UINT64 AlignUp(UINT64 value, UINT64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Read(ResourceHandle resource, D3D12_RESOURCE_STATES state)
+{
+	Pass& pass = mGraph->mPasses[mPass];
+	pass.Accesses.push_back({ resource, state, false, false, (UINT)pass.Phases.size() - 1 });
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Write(ResourceHandle resource, D3D12_RESOURCE_STATES state, bool overwrites)
+{
+	Pass& pass = mGraph->mPasses[mPass];
+	pass.Accesses.push_back({ resource, state, true, overwrites, (UINT)pass.Phases.size() - 1 });
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::SideEffect()
+{
+	mGraph->mPasses[mPass].SideEffect = true;
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Then(std::function<void(ID3D12GraphicsCommandList*)> execute)
+{
+	mGraph->mPasses[mPass].Phases.push_back(std::move(execute));
+	return *this;
+}
+
+RenderGraph::RenderGraph(ID3D12Device* device)
+{
+	md3dDevice = device;
+	mRtvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+	mDsvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+}
+
+void RenderGraph::Reset(UINT64 completedFence)
+{
+	mPasses.clear();
+	mResources.clear();
+	mLivePasses.clear();
+	mBarriers.clear();
+	mPassBarriers.clear();
+	mFinalBarriers.clear();
+
+	mRetired.erase(std::remove_if(mRetired.begin(), mRetired.end(),
+		[completedFence](const RetiredObject& retired) { return retired.Fence <= completedFence; }),
+		mRetired.end());
+}
+
+RenderGraph::ResourceHandle RenderGraph::Import(const std::string& name, ID3D12Resource* resource,
+	D3D12_RESOURCE_STATES state, D3D12_RESOURCE_STATES finalState)
+{
+	ResourceNode node;
+	node.Name = name;
+	node.Imported = true;
+	node.External = resource;
+	node.State = state;
+	node.FinalState = finalState;
+	mResources.push_back(node);
+	return (ResourceHandle)mResources.size() - 1;
+}
+
+RenderGraph::ResourceHandle RenderGraph::CreateTexture(const std::string& name, const TextureDesc& desc)
+{
+	assert((desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) != 0);
+
+	ResourceNode node;
+	node.Name = name;
+	node.Desc = desc;
+	mResources.push_back(node);
+	return (ResourceHandle)mResources.size() - 1;
+}
+
+RenderGraph::PassBuilder RenderGraph::AddPass(const std::string& name, std::function<void(ID3D12GraphicsCommandList*)> execute)
+{
+	Pass pass;
+	pass.Name = name;
+	pass.Phases.push_back(std::move(execute));
+	mPasses.push_back(std::move(pass));
+	return PassBuilder(this, (UINT)mPasses.size() - 1);
+}
+
+void RenderGraph::Compile()
+{
+	CullPasses();
+	PlaceTextures();
+	PlanBarriers();
+}
+
+void RenderGraph::CullPasses()
+{
+	// Walk back from the end of the frame, where only the imported resources are
+	// needed.  A pass that runs needs what it reads; one that overwrites a resource
+	// means the writes before it are not needed.
+	std::vector<bool> needed(mResources.size(), false);
+	for (size_t i = 0; i < mResources.size(); ++i)
+		needed[i] = mResources[i].Imported;
+
+	std::vector<bool> live(mPasses.size(), false);
+	for (size_t p = mPasses.size(); p-- > 0;)
+	{
+		const Pass& pass = mPasses[p];
+
+		bool run = pass.SideEffect;
+		for (const Access& access : pass.Accesses)
+		{
+			if (access.Write && needed[access.Resource])
+				run = true;
+		}
+		if (!run)
+			continue;
+
+		live[p] = true;
+		for (const Access& access : pass.Accesses)
+		{
+			if (access.Write && access.Overwrites)
+				needed[access.Resource] = false;
+		}
+		for (const Access& access : pass.Accesses)
+		{
+			if (!access.Write)
+				needed[access.Resource] = true;
+		}
+	}
+
+	for (UINT p = 0; p < (UINT)mPasses.size(); ++p)
+	{
+		if (live[p])
+			mLivePasses.push_back(p);
+	}
+}
+
+void RenderGraph::PlaceTextures()
+{
+	// Lifetimes, in live passes.
+	for (UINT l = 0; l < (UINT)mLivePasses.size(); ++l)
+	{
+		for (const Access& access : mPasses[mLivePasses[l]].Accesses)
+		{
+			ResourceNode& node = mResources[access.Resource];
+			if (node.Imported)
+				continue;
+			node.FirstPass = (std::min)(node.FirstPass, l);
+			node.LastPass = (std::max)(node.LastPass, l);
+		}
+	}
+
+	struct Candidate
+	{
+		UINT Node;
+		D3D12_RESOURCE_DESC Desc;
+		D3D12_CLEAR_VALUE ClearValue;
+		UINT64 Size;
+		UINT64 Alignment;
+		UINT64 Offset;
+	};
+	std::vector<Candidate> candidates;
+
+	UINT64 heapAlignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	for (UINT i = 0; i < (UINT)mResources.size(); ++i)
+	{
+		const ResourceNode& node = mResources[i];
+		if (node.Imported || node.FirstPass == UINT_MAX)
+			continue;
+
+		Candidate candidate;
+		candidate.Node = i;
+
+		// Zeroed first, so the padding compares equal in the reuse test below.
+		ZeroMemory(&candidate.Desc, sizeof(candidate.Desc));
+		candidate.Desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+		candidate.Desc.Width = node.Desc.Width;
+		candidate.Desc.Height = node.Desc.Height;
+		candidate.Desc.DepthOrArraySize = 1;
+		candidate.Desc.MipLevels = 1;
+		candidate.Desc.Format = node.Desc.Format;
+		candidate.Desc.SampleDesc = node.Desc.SampleDesc;
+		candidate.Desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+		candidate.Desc.Flags = node.Desc.Flags;
+
+		candidate.ClearValue = node.Desc.ClearValue;
+		if (candidate.ClearValue.Format == DXGI_FORMAT_UNKNOWN)
+			candidate.ClearValue.Format = node.Desc.Format;
+
+		D3D12_RESOURCE_ALLOCATION_INFO info = md3dDevice->GetResourceAllocationInfo(0, 1, &candidate.Desc);
+		candidate.Size = info.SizeInBytes;
+		candidate.Alignment = info.Alignment;
+		candidate.Offset = 0;
+		heapAlignment = (std::max)(heapAlignment, info.Alignment);
+
+		candidates.push_back(candidate);
+	}
+
+	// Largest first, each at the lowest offset clear of the textures already placed
+	// whose lifetimes overlap its own.
+	std::vector<UINT> order(candidates.size());
+	for (UINT i = 0; i < (UINT)order.size(); ++i)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&candidates](UINT a, UINT b)
+	{
+		return candidates[a].Size > candidates[b].Size;
+	});
+
+	UINT64 heapBytes = 0;
+	mUnaliasedBytes = 0;
+	std::vector<UINT> placedOrder;
+	for (UINT c : order)
+	{
+		Candidate& candidate = candidates[c];
+		const ResourceNode& node = mResources[candidate.Node];
+
+		std::vector<const Candidate*> overlapping;
+		for (UINT other : placedOrder)
+		{
+			const ResourceNode& otherNode = mResources[candidates[other].Node];
+			if (otherNode.LastPass >= node.FirstPass && node.LastPass >= otherNode.FirstPass)
+				overlapping.push_back(&candidates[other]);
+		}
+		std::sort(overlapping.begin(), overlapping.end(), [](const Candidate* a, const Candidate* b)
+		{
+			return a->Offset < b->Offset;
+		});
+
+		UINT64 offset = 0;
+		for (const Candidate* other : overlapping)
+		{
+			if (offset + candidate.Size <= other->Offset)
+				break;
+			if (offset < other->Offset + other->Size)
+				offset = AlignUp(other->Offset + other->Size, candidate.Alignment);
+		}
+
+		candidate.Offset = offset;
+		heapBytes = (std::max)(heapBytes, offset + candidate.Size);
+		mUnaliasedBytes += candidate.Size;
+		placedOrder.push_back(c);
+	}
+	mHeapBytesUsed = heapBytes;
+
+	// A bigger layout needs a new heap, and everything in the old one goes with it.
+	if (!candidates.empty() && (heapBytes > mHeapSize || heapAlignment > mHeapAlignment))
+	{
+		if (mHeap != nullptr)
+			Retire(mHeap);
+		for (PlacedTexture& placed : mPlaced)
+			Retire(placed.Resource);
+		mPlaced.clear();
+		mHeap = nullptr;
+
+		mHeapSize = AlignUp(heapBytes, heapAlignment);
+		mHeapAlignment = heapAlignment;
+
+		CD3DX12_HEAP_DESC heapDesc(mHeapSize, D3D12_HEAP_TYPE_DEFAULT, mHeapAlignment,
+			D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES);
+		ThrowIfFailed(md3dDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(mHeap.GetAddressOf())));
+	}
+
+	// Keep the textures this frame places exactly where a previous one did.
+	std::vector<PlacedTexture> placed;
+	std::vector<bool> kept(mPlaced.size(), false);
+	for (const Candidate& candidate : candidates)
+	{
+		ResourceNode& node = mResources[candidate.Node];
+
+		int match = -1;
+		for (UINT i = 0; i < (UINT)mPlaced.size() && match < 0; ++i)
+		{
+			if (!kept[i] && mPlaced[i].Offset == candidate.Offset &&
+				memcmp(&mPlaced[i].Desc, &candidate.Desc, sizeof(candidate.Desc)) == 0 &&
+				memcmp(&mPlaced[i].ClearValue, &candidate.ClearValue, sizeof(candidate.ClearValue)) == 0)
+			{
+				match = (int)i;
+			}
+		}
+
+		if (match >= 0)
+		{
+			kept[match] = true;
+			placed.push_back(mPlaced[match]);
+		}
+		else
+		{
+			PlacedTexture texture;
+			texture.Desc = candidate.Desc;
+			texture.ClearValue = candidate.ClearValue;
+			texture.Offset = candidate.Offset;
+			texture.Size = candidate.Size;
+			texture.State = (candidate.Desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL) != 0 ?
+				D3D12_RESOURCE_STATE_DEPTH_WRITE : D3D12_RESOURCE_STATE_RENDER_TARGET;
+			ThrowIfFailed(md3dDevice->CreatePlacedResource(mHeap.Get(), texture.Offset, &texture.Desc,
+				texture.State, &texture.ClearValue, IID_PPV_ARGS(texture.Resource.GetAddressOf())));
+			placed.push_back(texture);
+		}
+
+		node.Placed = (int)placed.size() - 1;
+	}
+
+	bool layoutChanged = placed.size() != mPlaced.size();
+	for (UINT i = 0; i < (UINT)mPlaced.size(); ++i)
+	{
+		if (!kept[i])
+		{
+			Retire(mPlaced[i].Resource);
+			layoutChanged = true;
+		}
+	}
+	mPlaced = std::move(placed);
+
+	// Memory another texture also covers is in an undefined state when a texture
+	// starts using it, and so is all of it after the layout changed.
+	for (UINT i = 0; i < (UINT)mPlaced.size(); ++i)
+	{
+		mPlaced[i].Aliased = layoutChanged;
+		for (UINT j = 0; j < (UINT)mPlaced.size(); ++j)
+		{
+			if (i != j && mPlaced[i].Offset < mPlaced[j].Offset + mPlaced[j].Size &&
+				mPlaced[j].Offset < mPlaced[i].Offset + mPlaced[i].Size)
+			{
+				mPlaced[i].Aliased = true;
+			}
+		}
+	}
+
+	// Views: the descriptor heaps are CPU only, so they can be rewritten whatever
+	// the GPU is doing.
+	if (mPlaced.size() > mViewCapacity)
+	{
+		mViewCapacity = (std::max)(2 * (UINT)mPlaced.size(), 8u);
+
+		D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
+		rtvHeapDesc.NumDescriptors = mViewCapacity;
+		rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+		rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+		ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(mRtvHeap.ReleaseAndGetAddressOf())));
+
+		D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = rtvHeapDesc;
+		dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
+		ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(mDsvHeap.ReleaseAndGetAddressOf())));
+	}
+
+	for (UINT i = 0; i < (UINT)mPlaced.size(); ++i)
+	{
+		const PlacedTexture& texture = mPlaced[i];
+		if ((texture.Desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET) != 0)
+		{
+			CD3DX12_CPU_DESCRIPTOR_HANDLE rtv(mRtvHeap->GetCPUDescriptorHandleForHeapStart(), i, mRtvDescriptorSize);
+			md3dDevice->CreateRenderTargetView(texture.Resource.Get(), nullptr, rtv);
+		}
+		if ((texture.Desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL) != 0)
+		{
+			CD3DX12_CPU_DESCRIPTOR_HANDLE dsv(mDsvHeap->GetCPUDescriptorHandleForHeapStart(), i, mDsvDescriptorSize);
+			md3dDevice->CreateDepthStencilView(texture.Resource.Get(), nullptr, dsv);
+		}
+	}
+}
+
+void RenderGraph::PlanBarriers()
+{
+	const UINT liveCount = (UINT)mLivePasses.size();
+	mPassBarriers.resize(liveCount);
+
+	// Every resource's uses, one per live pass that touches it.  A pass that reads
+	// a resource in several states uses it in all of them; one that writes it uses
+	// it in the write state.  Phase is the first phase of the pass that touches it.
+	struct Use
+	{
+		UINT Pass;
+		D3D12_RESOURCE_STATES State;
+		bool Write;
+		UINT Phase;
+	};
+	std::vector<std::vector<Use>> uses(mResources.size());
+	for (UINT l = 0; l < liveCount; ++l)
+	{
+		for (const Access& access : mPasses[mLivePasses[l]].Accesses)
+		{
+			std::vector<Use>& resourceUses = uses[access.Resource];
+			if (resourceUses.empty() || resourceUses.back().Pass != l)
+			{
+				resourceUses.push_back({ l, access.State, access.Write, access.Phase });
+				continue;
+			}
+
+			Use& use = resourceUses.back();
+			use.Phase = (std::min)(use.Phase, access.Phase);
+			if (access.Write)
+			{
+				use.State = access.State;
+				use.Write = true;
+			}
+			else if (!use.Write)
+			{
+				use.State |= access.State;
+			}
+		}
+	}
+
+	for (UINT r = 0; r < (UINT)mResources.size(); ++r)
+	{
+		const ResourceNode& node = mResources[r];
+		const std::vector<Use>& resourceUses = uses[r];
+
+		PlacedTexture* texture = node.Placed >= 0 ? &mPlaced[node.Placed] : nullptr;
+		ID3D12Resource* resource = node.Imported ? node.External :
+			texture != nullptr ? texture->Resource.Get() : nullptr;
+		if (resource == nullptr)
+			continue;
+
+		D3D12_RESOURCE_STATES current = node.Imported ? node.State : texture->State;
+		UINT lastPass = NoPass;
+		bool lastWasUavWrite = false;
+
+		for (size_t i = 0; i < resourceUses.size(); ++i)
+		{
+			const Use& use = resourceUses[i];
+			D3D12_RESOURCE_STATES state = use.State;
+
+			if (!use.Write)
+			{
+				// A run of reads goes to the state all of them can read in, once.
+				if (i > 0 && !resourceUses[i - 1].Write)
+				{
+					lastPass = use.Pass;
+					continue;
+				}
+				for (size_t j = i + 1; j < resourceUses.size() && !resourceUses[j].Write; ++j)
+					state |= resourceUses[j].State;
+			}
+
+			// The memory has to be the texture's before a transition may touch it, so
+			// the first transition after an aliasing barrier is not split in the pass.
+			const bool aliasing = i == 0 && texture != nullptr && texture->Aliased;
+			if (aliasing)
+				AddBarrier(CD3DX12_RESOURCE_BARRIER::Aliasing(nullptr, resource), NoPass, use.Pass, use.Phase);
+
+			if (!IsSatisfied(current, state))
+			{
+				AddBarrier(CD3DX12_RESOURCE_BARRIER::Transition(resource, current, state), lastPass, use.Pass,
+					use.Phase, use.Phase > 0 && !aliasing);
+				current = state;
+			}
+			else if (use.Write && lastWasUavWrite && state == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+			{
+				AddBarrier(CD3DX12_RESOURCE_BARRIER::UAV(resource), NoPass, use.Pass, use.Phase);
+			}
+
+			// Last frame's contents are dead, so the first draw discards them; in
+			// memory another texture shares, that is also what initializes it, since
+			// drawing does not and the pass may not clear all of it.
+			if (i == 0 && texture != nullptr && use.Write &&
+				(state == D3D12_RESOURCE_STATE_RENDER_TARGET || state == D3D12_RESOURCE_STATE_DEPTH_WRITE))
+			{
+				mPassBarriers[use.Pass].Discards.push_back({ resource, use.Phase });
+			}
+
+			lastWasUavWrite = use.Write && state == D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+			lastPass = use.Pass;
+		}
+
+		if (node.Imported)
+		{
+			if (current != node.FinalState)
+				AddBarrier(CD3DX12_RESOURCE_BARRIER::Transition(resource, current, node.FinalState), lastPass, liveCount);
+		}
+		else
+		{
+			texture->State = current;
+		}
+	}
+}
+
+void RenderGraph::AddBarrier(const D3D12_RESOURCE_BARRIER& barrier, UINT beginPass, UINT endPass,
+	UINT endPhase, bool splitInPass)
+{
+	UINT index = (UINT)mBarriers.size();
+	mBarriers.push_back({ barrier, beginPass, endPass, endPhase, splitInPass });
+
+	if (endPass < (UINT)mPassBarriers.size())
+		mPassBarriers[endPass].Before.push_back(index);
+	else
+		mFinalBarriers.push_back(index);
+
+	if (beginPass != NoPass)
+		mPassBarriers[beginPass].After.push_back(index);
+}
+
+bool RenderGraph::IsSplit(const PlannedBarrier& barrier, bool split)const
+{
+	return split && barrier.Barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION &&
+		barrier.BeginPass != NoPass && barrier.BeginPass + 1 < barrier.EndPass;
+}
+
+void RenderGraph::RecordPass(ID3D12GraphicsCommandList* cmdList, UINT livePass, bool split)const
+{
+	const PassBarriers& passBarriers = mPassBarriers[livePass];
+	const Pass& pass = mPasses[mLivePasses[livePass]];
+	std::vector<D3D12_RESOURCE_BARRIER> batch;
+
+	for (UINT phase = 0; phase < (UINT)pass.Phases.size(); ++phase)
+	{
+		// Each phase's barriers end right before it.  The first phase also begins
+		// the transitions of the later ones that no earlier pass has begun.
+		batch.clear();
+		for (UINT index : passBarriers.Before)
+		{
+			const PlannedBarrier& planned = mBarriers[index];
+			D3D12_RESOURCE_BARRIER barrier = planned.Barrier;
+			const bool splitBefore = IsSplit(planned, split);
+
+			if (planned.EndPhase == phase)
+			{
+				if (splitBefore || planned.SplitInPass)
+					barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+				batch.push_back(barrier);
+			}
+			else if (phase == 0 && planned.SplitInPass && !splitBefore)
+			{
+				barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+				batch.push_back(barrier);
+			}
+		}
+		if (!batch.empty())
+			cmdList->ResourceBarrier((UINT)batch.size(), batch.data());
+
+		for (const Discard& discard : passBarriers.Discards)
+		{
+			if (discard.Phase == phase)
+				cmdList->DiscardResource(discard.Resource, nullptr);
+		}
+
+		pass.Phases[phase](cmdList);
+	}
+
+	batch.clear();
+	for (UINT index : passBarriers.After)
+	{
+		if (!IsSplit(mBarriers[index], split))
+			continue;
+		D3D12_RESOURCE_BARRIER barrier = mBarriers[index].Barrier;
+		barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+		batch.push_back(barrier);
+	}
+
+	// The last pass's list also returns the imported resources to their final states.
+	if (livePass + 1 == (UINT)mLivePasses.size())
+	{
+		for (UINT index : mFinalBarriers)
+		{
+			D3D12_RESOURCE_BARRIER barrier = mBarriers[index].Barrier;
+			if (IsSplit(mBarriers[index], split))
+				barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+			batch.push_back(barrier);
+		}
+	}
+	if (!batch.empty())
+		cmdList->ResourceBarrier((UINT)batch.size(), batch.data());
+}
+
+void RenderGraph::Execute(ID3D12GraphicsCommandList* cmdList, UINT64 fence)
+{
+	mLastFence = fence;
+	for (UINT l = 0; l < (UINT)mLivePasses.size(); ++l)
+		RecordPass(cmdList, l, true);
+}
+
+UINT RenderGraph::Record(JobSystem& jobs, ParallelCommandLists& cmdLists, UINT firstSlot,
+	ID3D12PipelineState* initialState, UINT64 fence)
+{
+	mLastFence = fence;
+
+	const UINT count = (UINT)mLivePasses.size();
+	cmdLists.Resize(firstSlot + count);
+	jobs.ParallelFor(0, count, 1, [&](UINT l)
+	{
+		ID3D12GraphicsCommandList* cmdList = cmdLists.Begin(firstSlot + l, initialState);
+		RecordPass(cmdList, l, false);
+		ThrowIfFailed(cmdList->Close());
+	});
+	return count;
+}
+
+ID3D12Resource* RenderGraph::Resource(ResourceHandle resource)const
+{
+	const ResourceNode& node = mResources[resource];
+	if (node.Imported)
+		return node.External;
+	return node.Placed >= 0 ? mPlaced[node.Placed].Resource.Get() : nullptr;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE RenderGraph::RenderTargetView(ResourceHandle resource)const
+{
+	const ResourceNode& node = mResources[resource];
+	assert(!node.Imported && node.Placed >= 0);
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(mRtvHeap->GetCPUDescriptorHandleForHeapStart(), node.Placed, mRtvDescriptorSize);
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE RenderGraph::DepthStencilView(ResourceHandle resource)const
+{
+	const ResourceNode& node = mResources[resource];
+	assert(!node.Imported && node.Placed >= 0);
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(mDsvHeap->GetCPUDescriptorHandleForHeapStart(), node.Placed, mDsvDescriptorSize);
+}
+
+UINT RenderGraph::PassCount()const
+{
+	return (UINT)mLivePasses.size();
+}
+
+UINT RenderGraph::CulledPassCount()const
+{
+	return (UINT)(mPasses.size() - mLivePasses.size());
+}
+
+UINT RenderGraph::BarrierCount()const
+{
+	return (UINT)mBarriers.size();
+}
+
+UINT64 RenderGraph::HeapBytes()const
+{
+	return mHeapBytesUsed;
+}
+
+UINT64 RenderGraph::UnaliasedBytes()const
+{
+	return mUnaliasedBytes;
+}
+
+std::wstring RenderGraph::Summary()const
+{
+	std::wostringstream text;
+	text << L"passes " << PassCount() << L" (" << CulledPassCount() << L" culled)   barriers " << BarrierCount();
+	if (mUnaliasedBytes > 0)
+	{
+		text << std::fixed << std::setprecision(1) << L"   transient " <<
+			(double)mHeapBytesUsed / (1024.0 * 1024.0) << L"/" <<
+			(double)mUnaliasedBytes / (1024.0 * 1024.0) << L" MB";
+	}
+	return text.str();
+}
+
+void RenderGraph::Retire(ComPtr<ID3D12Pageable> object)
+{
+	mRetired.push_back({ object, mLastFence });
+}
@@ -0,0 +1,285 @@
+//***************************************************************************************
+// RenderGraph.h
+//
+// Describes a frame as passes that declare which resources they read and write, and
+// derives the barriers from that instead of every demo writing its own transitions.
+//
+// Each frame the demo imports the resources it owns (the back buffer, the depth
+// buffer), creates the transient ones it needs only for this frame, and adds its
+// passes in submission order.  Compile() then
+//
+//   culls      the passes whose output nothing needs.  Imported resources are needed
+//              at the end of the frame; a pass that writes one, writes a resource a
+//              needed pass reads, or is marked SideEffect() runs.  A write that
+//              overwrites everything (a clear) ends the dependency on earlier writers.
+//   places     every transient texture in one heap.  Textures whose lifetimes do not
+//              overlap share memory, so a chain of full screen targets costs about
+//              as much as the two largest that are live at once.
+//   plans      the barriers.  The barriers a pass needs are issued as one batch
+//              before it, consecutive reads in different states are merged into one
+//              transition to the combined read state, and in Execute() a transition
+//              with passes in between is split (BEGIN_ONLY after the last pass that
+//              used the old state, END_ONLY before the next user).  A pass recorded
+//              in phases (PassBuilder::Then()) begins the transitions only a later
+//              phase needs before its first one and ends them before that phase,
+//              which also works in Record(), inside the pass's own list.
+//
+// A transient texture's contents never outlive the frame, so its first write, if it
+// draws into it, is preceded by a discard; memory another texture shares, or that
+// the layout just moved, also gets an aliasing barrier first.
+//
+// The graph keeps what a transient texture is across frames as long as the frames
+// compile to the same layout, so a steady frame creates nothing.  Placed textures
+// are not counted by GpuMemory, since they overlap; HeapBytes() is what they take.
+//
+// Per frame:
+//     graph.Reset(fence->GetCompletedValue());
+//     auto backBuffer = graph.Import("back buffer", CurrentBackBuffer(),
+//         D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT);
+//     auto pass = graph.AddPass("scene", [&](ID3D12GraphicsCommandList* cmdList) { ... });
+//     pass.Write(backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+//     graph.Compile();
+//     graph.Execute(cmdList, frameFence);       // or Record() on several lists
+//
+// A compiled graph is executed once, and the frame must be signalled with the fence
+// value given to Execute()/Record() before Reset() is given a completed value past it.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "JobSystem.h"
+#include "ParallelCommandLists.h"
+#include <functional>
+
+class RenderGraph
+{
+public:
+	// Index of a resource in the frame being built.
+	using ResourceHandle = UINT;
+
+	// A texture that only lives in this frame.  It must be a render target or depth
+	// target (it may also allow unordered access), so it can go in the one heap on
+	// every resource heap tier.
+	struct TextureDesc
+	{
+		UINT Width = 1;
+		UINT Height = 1;
+		DXGI_FORMAT Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		DXGI_SAMPLE_DESC SampleDesc = { 1, 0 };
+		D3D12_RESOURCE_FLAGS Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+
+		// The fast clear value; a depth target must give its Format.  Format itself
+		// is typed, since the graph creates the default views.
+		D3D12_CLEAR_VALUE ClearValue = {};
+	};
+
+	// What AddPass() returns, to declare the pass's accesses.
+	class PassBuilder
+	{
+	public:
+		// The pass reads resource in state, e.g. PIXEL_SHADER_RESOURCE or DEPTH_READ.
+		PassBuilder& Read(ResourceHandle resource, D3D12_RESOURCE_STATES state);
+
+		// The pass writes resource in state.  overwrites says it replaces every texel
+		// the frame keeps (clears or covers it), so earlier writes need not run.
+		PassBuilder& Write(ResourceHandle resource, D3D12_RESOURCE_STATES state, bool overwrites = false);
+
+		// The pass writes something the graph does not track, so it always runs.
+		PassBuilder& SideEffect();
+
+		// Records execute on the same list after what the pass recorded so far.  The
+		// accesses declared from here on are first used in this phase, so their
+		// transitions may run during the phases before.
+		PassBuilder& Then(std::function<void(ID3D12GraphicsCommandList*)> execute);
+
+	private:
+		friend class RenderGraph;
+		PassBuilder(RenderGraph* graph, UINT pass) : mGraph(graph), mPass(pass) {}
+
+		RenderGraph* mGraph;
+		UINT mPass;
+	};
+
+	explicit RenderGraph(ID3D12Device* device);
+	RenderGraph(const RenderGraph& rhs) = delete;
+	RenderGraph& operator=(const RenderGraph& rhs) = delete;
+	~RenderGraph() = default;
+
+	// Starts a new frame.  completedFence is the last fence value the GPU has
+	// reached; heaps and textures the graph replaced are released once it passes
+	// the frame that last used them.
+	void Reset(UINT64 completedFence);
+
+	// A resource the caller owns.  It is in state when the frame starts, and the
+	// graph leaves it in finalState.
+	ResourceHandle Import(const std::string& name, ID3D12Resource* resource,
+		D3D12_RESOURCE_STATES state, D3D12_RESOURCE_STATES finalState);
+
+	// A transient texture, allocated by Compile() if a pass that runs uses it.
+	ResourceHandle CreateTexture(const std::string& name, const TextureDesc& desc);
+
+	// Adds a pass after the ones added so far.  execute records its commands; with
+	// Record() it runs on a job thread, at the same time as the other passes.
+	PassBuilder AddPass(const std::string& name, std::function<void(ID3D12GraphicsCommandList*)> execute);
+
+	// Culls the passes, places the transient textures and plans the barriers.
+	void Compile();
+
+	// Records every pass that runs on cmdList, in order.  fence is the value the
+	// queue signals once the frame is done.
+	void Execute(ID3D12GraphicsCommandList* cmdList, UINT64 fence);
+
+	// Records every pass that runs on its own list of cmdLists, from slot firstSlot,
+	// on jobs' threads, and closes the lists.  Barriers are not split across lists,
+	// only between the phases of a pass.  Returns the number of slots used, which is
+	// PassCount().
+	UINT Record(JobSystem& jobs, ParallelCommandLists& cmdLists, UINT firstSlot,
+		ID3D12PipelineState* initialState, UINT64 fence);
+
+	// After Compile().  Resource() is the texture a transient handle got this
+	// frame; views of it in the caller's heaps must be rewritten every frame.
+	ID3D12Resource* Resource(ResourceHandle resource)const;
+	D3D12_CPU_DESCRIPTOR_HANDLE RenderTargetView(ResourceHandle resource)const;
+	D3D12_CPU_DESCRIPTOR_HANDLE DepthStencilView(ResourceHandle resource)const;
+
+	// Passes that run and passes that were culled.
+	UINT PassCount()const;
+	UINT CulledPassCount()const;
+
+	// Barriers planned for the frame, counting a split barrier once.
+	UINT BarrierCount()const;
+
+	// The transient heap, and what the same textures would take without aliasing.
+	UINT64 HeapBytes()const;
+	UINT64 UnaliasedBytes()const;
+
+	// "passes 9 (1 culled)   barriers 4   transient 8.0/16.0 MB", for the caption.
+	std::wstring Summary()const;
+
+private:
+	struct Access
+	{
+		ResourceHandle Resource;
+		D3D12_RESOURCE_STATES State;
+		bool Write;
+		bool Overwrites;
+		UINT Phase;
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		std::vector<std::function<void(ID3D12GraphicsCommandList*)>> Phases;
+		std::vector<Access> Accesses;
+		bool SideEffect = false;
+	};
+
+	struct ResourceNode
+	{
+		std::string Name;
+		bool Imported = false;
+		ID3D12Resource* External = nullptr;
+		D3D12_RESOURCE_STATES State = D3D12_RESOURCE_STATE_COMMON;
+		D3D12_RESOURCE_STATES FinalState = D3D12_RESOURCE_STATE_COMMON;
+		TextureDesc Desc;
+
+		// Set by Compile() for transient textures a pass that runs uses.
+		int Placed = -1;
+		UINT FirstPass = UINT_MAX;
+		UINT LastPass = 0;
+	};
+
+	// A texture in the heap, kept for the next frames while the layout holds.
+	struct PlacedTexture
+	{
+		D3D12_RESOURCE_DESC Desc;
+		D3D12_CLEAR_VALUE ClearValue;
+		UINT64 Offset = 0;
+		UINT64 Size = 0;
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+
+		// The state the texture was left in at the end of the last compiled frame.
+		D3D12_RESOURCE_STATES State = D3D12_RESOURCE_STATE_COMMON;
+
+		// Set when another texture shares some of its memory, or the layout has just
+		// changed, so its first use needs an aliasing barrier and a discard.
+		bool Aliased = false;
+	};
+
+	// A barrier and the live passes it goes between.  BeginPass is the last pass
+	// that used the old state, NoPass if none did this frame; EndPass is the next
+	// user, PassCount() for the transitions at the end of the frame, and EndPhase
+	// the phase of EndPass that first needs it.  SplitInPass says a transition for
+	// a phase after the first may begin with EndPass.
+	struct PlannedBarrier
+	{
+		D3D12_RESOURCE_BARRIER Barrier;
+		UINT BeginPass;
+		UINT EndPass;
+		UINT EndPhase;
+		bool SplitInPass;
+	};
+
+	struct Discard
+	{
+		ID3D12Resource* Resource;
+		UINT Phase;
+	};
+
+	// What is recorded around each live pass.
+	struct PassBarriers
+	{
+		std::vector<UINT> Before;        // indices into mBarriers that end here
+		std::vector<UINT> After;         // indices that may begin here
+		std::vector<Discard> Discards;
+	};
+
+	static const UINT NoPass = UINT_MAX;
+
+	void CullPasses();
+	void PlaceTextures();
+	void PlanBarriers();
+	void AddBarrier(const D3D12_RESOURCE_BARRIER& barrier, UINT beginPass, UINT endPass,
+		UINT endPhase = 0, bool splitInPass = false);
+
+	void RecordPass(ID3D12GraphicsCommandList* cmdList, UINT livePass, bool split)const;
+	bool IsSplit(const PlannedBarrier& barrier, bool split)const;
+
+	void Retire(Microsoft::WRL::ComPtr<ID3D12Pageable> object);
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+
+	std::vector<Pass> mPasses;
+	std::vector<ResourceNode> mResources;
+
+	// After Compile(): the passes that run, in order, and their barriers.
+	std::vector<UINT> mLivePasses;
+	std::vector<PlannedBarrier> mBarriers;
+	std::vector<PassBarriers> mPassBarriers;
+	std::vector<UINT> mFinalBarriers;
+
+	Microsoft::WRL::ComPtr<ID3D12Heap> mHeap;
+	UINT64 mHeapSize = 0;
+	UINT64 mHeapAlignment = 0;
+	UINT64 mHeapBytesUsed = 0;
+	UINT64 mUnaliasedBytes = 0;
+	std::vector<PlacedTexture> mPlaced;
+
+	// One view per placed texture, at the texture's index in mPlaced.
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mRtvHeap;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mDsvHeap;
+	UINT mViewCapacity = 0;
+	UINT mRtvDescriptorSize = 0;
+	UINT mDsvDescriptorSize = 0;
+
+	// Replaced heaps and textures, until the GPU is past the fence that last used them.
+	struct RetiredObject
+	{
+		Microsoft::WRL::ComPtr<ID3D12Pageable> Object;
+		UINT64 Fence;
+	};
+	std::vector<RetiredObject> mRetired;
+	UINT64 mLastFence = 0;
+};
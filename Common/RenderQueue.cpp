@@ -0,0 +1,112 @@
+//***************************************************************************************
+// RenderQueue.cpp
+//***************************************************************************************
+
+#include "RenderQueue.h"
+
+namespace
+{
+	const UINT DepthBits = 24;
+	const UINT DepthMask = (1u << DepthBits) - 1;
+
+	UINT QuantizeDepth(float depth)
+	{
+		if(!(depth > 0.0f))
+			return 0;
+		if(depth >= 1.0f)
+			return DepthMask;
+
+		return (UINT)(depth * (float)DepthMask);
+	}
+}
+
+UINT64 RenderQueue::OpaqueKey(UINT layer, UINT pso, UINT geometry, UINT material, float depth)
+{
+	return ((UINT64)(layer & 0xF) << 60) |
+		((UINT64)(pso & 0xFF) << 52) |
+		((UINT64)(geometry & 0xFFF) << 40) |
+		((UINT64)(material & 0xFFFF) << 24) |
+		(UINT64)QuantizeDepth(depth);
+}
+
+UINT64 RenderQueue::TransparentKey(UINT layer, UINT pso, UINT geometry, UINT material, float depth)
+{
+	return ((UINT64)(layer & 0xF) << 60) |
+		((UINT64)(DepthMask - QuantizeDepth(depth)) << 36) |
+		((UINT64)(pso & 0xFF) << 28) |
+		((UINT64)(geometry & 0xFFF) << 16) |
+		(UINT64)(material & 0xFFFF);
+}
+
+void RenderQueue::Clear()
+{
+	mKeys.clear();
+	mItems.clear();
+}
+
+void RenderQueue::Add(UINT64 key, UINT item)
+{
+	mKeys.push_back(key);
+	mItems.push_back(item);
+}
+
+void RenderQueue::Sort()
+{
+	const size_t count = mKeys.size();
+	if(count < 2)
+		return;
+
+	mTempKeys.resize(count);
+	mTempItems.resize(count);
+
+	// One read over the keys builds the histograms of all eight digits.
+	UINT histograms[8][256] = {};
+	for(size_t i = 0; i < count; ++i)
+	{
+		UINT64 key = mKeys[i];
+		for(int pass = 0; pass < 8; ++pass)
+			histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+	}
+
+	for(int pass = 0; pass < 8; ++pass)
+	{
+		UINT* histogram = histograms[pass];
+		const UINT shift = pass * 8;
+
+		if(histogram[(mKeys[0] >> shift) & 0xFF] == count)
+			continue;
+
+		UINT offsets[256];
+		UINT sum = 0;
+		for(int b = 0; b < 256; ++b)
+		{
+			offsets[b] = sum;
+			sum += histogram[b];
+		}
+
+		for(size_t i = 0; i < count; ++i)
+		{
+			UINT dst = offsets[(mKeys[i] >> shift) & 0xFF]++;
+			mTempKeys[dst] = mKeys[i];
+			mTempItems[dst] = mItems[i];
+		}
+
+		mKeys.swap(mTempKeys);
+		mItems.swap(mTempItems);
+	}
+}
+
+size_t RenderQueue::Size()const
+{
+	return mKeys.size();
+}
+
+UINT RenderQueue::Item(size_t i)const
+{
+	return mItems[i];
+}
+
+UINT64 RenderQueue::Key(size_t i)const
+{
+	return mKeys[i];
+}
@@ -0,0 +1,50 @@
+//***************************************************************************************
+// RenderQueue.h
+//
+// Orders draws by 64-bit sort keys.  The demo builds one key per visible render
+// item, Sort() radix-sorts the (key, item) pairs, and the draw loop walks them
+// in order so consecutive draws share as much state as possible.
+//
+// Opaque keys, most significant first:
+//     layer:4 | pso:8 | geometry:12 | material:16 | depth:24 (front-to-back)
+// Transparent keys put depth right after the layer, inverted (back-to-front):
+//     layer:4 | depth:24 | pso:8 | geometry:12 | material:16
+//
+// Fields wider than their slot are masked; ids that collide only cost a state
+// change, never correctness.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class RenderQueue
+{
+public:
+	RenderQueue() = default;
+	RenderQueue(const RenderQueue& rhs) = delete;
+	RenderQueue& operator=(const RenderQueue& rhs) = delete;
+	~RenderQueue() = default;
+
+	// depth is normalized to [0, 1] (e.g. view-space z / far plane) and clamped.
+	static UINT64 OpaqueKey(UINT layer, UINT pso, UINT geometry, UINT material, float depth);
+	static UINT64 TransparentKey(UINT layer, UINT pso, UINT geometry, UINT material, float depth);
+
+	void Clear();
+	void Add(UINT64 key, UINT item);
+
+	// Stable LSD radix sort, 8 bits per pass.  Passes where every key has the same
+	// digit are skipped, so keys that only differ in a few fields sort quickly.
+	void Sort();
+
+	size_t Size()const;
+	UINT Item(size_t i)const;
+	UINT64 Key(size_t i)const;
+
+private:
+	std::vector<UINT64> mKeys;
+	std::vector<UINT> mItems;
+
+	std::vector<UINT64> mTempKeys;
+	std::vector<UINT> mTempItems;
+};
@@ -0,0 +1,304 @@
+//***************************************************************************************
+// SceneFile.cpp
+//***************************************************************************************
+
+#include "SceneFile.h"
+#include <fstream>
+
+using namespace DirectX;
+
+namespace
+{
+	uint64_t AlignOffset(uint64_t offset)
+	{
+		return (offset + 15) & ~uint64_t(15);
+	}
+
+	bool TableFits(uint64_t offset, uint64_t count, uint64_t recordSize, uint64_t fileSize)
+	{
+		return offset >= sizeof(SceneFileHeader) && offset <= fileSize &&
+			count * recordSize <= fileSize - offset;
+	}
+}
+
+SceneFile::~SceneFile()
+{
+	Close();
+}
+
+bool SceneFile::Open(const std::wstring& filename)
+{
+	Close();
+
+	mFile = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(mFile, &fileSize) || (uint64_t)fileSize.QuadPart < sizeof(SceneFileHeader))
+	{
+		Close();
+		return false;
+	}
+
+	mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mMapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	mView = static_cast<const uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+	if (mView == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	memcpy(&mHeader, mView, sizeof(SceneFileHeader));
+
+	const uint64_t size = (uint64_t)fileSize.QuadPart;
+
+	bool valid =
+		mHeader.Magic == SceneFileHeader::MagicValue &&
+		mHeader.Version == SceneFileHeader::CurrentVersion &&
+		TableFits(mHeader.TextureOffset, mHeader.TextureCount, sizeof(SceneTexture), size) &&
+		TableFits(mHeader.MaterialOffset, mHeader.MaterialCount, sizeof(SceneMaterial), size) &&
+		TableFits(mHeader.MeshOffset, mHeader.MeshCount, sizeof(SceneMesh), size) &&
+		TableFits(mHeader.InstanceOffset, mHeader.InstanceCount, sizeof(SceneInstance), size) &&
+		TableFits(mHeader.StringOffset, mHeader.StringBytes, 1, size) &&
+		Validate();
+
+	if (!valid)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool SceneFile::Validate()const
+{
+	// Every string must end inside the table, which the last byte being 0 ensures.
+	const char* strings = reinterpret_cast<const char*>(mView + mHeader.StringOffset);
+	if (mHeader.StringBytes == 0 || strings[mHeader.StringBytes - 1] != '\0')
+		return false;
+
+	auto validString = [this](uint32_t offset) { return offset < mHeader.StringBytes; };
+
+	for (uint32_t i = 0; i < mHeader.TextureCount; ++i)
+	{
+		const SceneTexture& texture = Textures()[i];
+		if (!validString(texture.Name) || !validString(texture.Path))
+			return false;
+	}
+
+	for (uint32_t i = 0; i < mHeader.MaterialCount; ++i)
+	{
+		const SceneMaterial& material = Materials()[i];
+		if (!validString(material.Name) ||
+			(material.DiffuseTexture != SceneNone && material.DiffuseTexture >= mHeader.TextureCount))
+			return false;
+	}
+
+	for (uint32_t i = 0; i < mHeader.MeshCount; ++i)
+	{
+		const SceneMesh& mesh = Meshes()[i];
+		if (!validString(mesh.Geometry) || !validString(mesh.Submesh))
+			return false;
+	}
+
+	const SceneInstance* instances = Instances();
+	for (uint32_t i = 0; i < mHeader.InstanceCount; ++i)
+	{
+		const SceneInstance& instance = instances[i];
+		if (instance.Parent != SceneNone && instance.Parent >= i)
+			return false;
+		if (instance.Mesh != SceneNone &&
+			(instance.Mesh >= mHeader.MeshCount || instance.Material >= mHeader.MaterialCount))
+			return false;
+	}
+
+	return true;
+}
+
+void SceneFile::Close()
+{
+	if (mView != nullptr)
+	{
+		UnmapViewOfFile(mView);
+		mView = nullptr;
+	}
+
+	if (mMapping != nullptr)
+	{
+		CloseHandle(mMapping);
+		mMapping = nullptr;
+	}
+
+	if (mFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mFile);
+		mFile = INVALID_HANDLE_VALUE;
+	}
+
+	mHeader = SceneFileHeader();
+}
+
+bool SceneFile::IsOpen()const
+{
+	return mView != nullptr;
+}
+
+const SceneFileHeader& SceneFile::Header()const
+{
+	return mHeader;
+}
+
+const SceneTexture* SceneFile::Textures()const
+{
+	return reinterpret_cast<const SceneTexture*>(mView + mHeader.TextureOffset);
+}
+
+const SceneMaterial* SceneFile::Materials()const
+{
+	return reinterpret_cast<const SceneMaterial*>(mView + mHeader.MaterialOffset);
+}
+
+const SceneMesh* SceneFile::Meshes()const
+{
+	return reinterpret_cast<const SceneMesh*>(mView + mHeader.MeshOffset);
+}
+
+const SceneInstance* SceneFile::Instances()const
+{
+	return reinterpret_cast<const SceneInstance*>(mView + mHeader.InstanceOffset);
+}
+
+const char* SceneFile::String(uint32_t offset)const
+{
+	return reinterpret_cast<const char*>(mView + mHeader.StringOffset) + offset;
+}
+
+std::wstring SceneFile::WideString(uint32_t offset)const
+{
+	const char* s = String(offset);
+	int length = MultiByteToWideChar(CP_UTF8, 0, s, -1, nullptr, 0);
+	if (length <= 1)
+		return std::wstring();
+
+	std::wstring result(length - 1, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, s, -1, &result[0], length);
+	return result;
+}
+
+XMMATRIX SceneFile::LocalTransform(const SceneInstance& instance)
+{
+	return XMMatrixScaling(instance.Scale.x, instance.Scale.y, instance.Scale.z) *
+		XMMatrixRotationQuaternion(XMLoadFloat4(&instance.Rotation)) *
+		XMMatrixTranslation(instance.Translation.x, instance.Translation.y, instance.Translation.z);
+}
+
+uint32_t SceneWriter::AddTexture(const std::string& name, const std::string& path)
+{
+	SceneTexture texture;
+	texture.Name = AddString(name);
+	texture.Path = AddString(path);
+	mTextures.push_back(texture);
+	return (uint32_t)mTextures.size() - 1;
+}
+
+uint32_t SceneWriter::AddMaterial(const std::string& name, uint32_t diffuseTexture,
+	const XMFLOAT4& diffuseAlbedo, const XMFLOAT3& fresnelR0, float roughness)
+{
+	SceneMaterial material;
+	material.Name = AddString(name);
+	material.DiffuseTexture = diffuseTexture;
+	material.DiffuseAlbedo = diffuseAlbedo;
+	material.FresnelR0 = fresnelR0;
+	material.Roughness = roughness;
+	mMaterials.push_back(material);
+	return (uint32_t)mMaterials.size() - 1;
+}
+
+uint32_t SceneWriter::AddMesh(const std::string& geometry, const std::string& submesh)
+{
+	SceneMesh mesh;
+	mesh.Geometry = AddString(geometry);
+	mesh.Submesh = AddString(submesh);
+	mMeshes.push_back(mesh);
+	return (uint32_t)mMeshes.size() - 1;
+}
+
+uint32_t SceneWriter::AddInstance(const SceneInstance& instance)
+{
+	mInstances.push_back(instance);
+	return (uint32_t)mInstances.size() - 1;
+}
+
+void SceneWriter::Reserve(size_t instanceCount)
+{
+	mInstances.reserve(instanceCount);
+}
+
+size_t SceneWriter::InstanceCount()const
+{
+	return mInstances.size();
+}
+
+uint32_t SceneWriter::AddString(const std::string& s)
+{
+	auto it = mStringOffsets.find(s);
+	if (it != mStringOffsets.end())
+		return it->second;
+
+	uint32_t offset = (uint32_t)mStrings.size();
+	mStrings.insert(mStrings.end(), s.begin(), s.end());
+	mStrings.push_back('\0');
+	mStringOffsets[s] = offset;
+	return offset;
+}
+
+bool SceneWriter::Write(const std::wstring& filename)const
+{
+	// Open() needs a string table even if nothing is named.
+	std::vector<char> strings = mStrings;
+	if (strings.empty())
+		strings.push_back('\0');
+
+	SceneFileHeader header;
+	header.TextureCount = (uint32_t)mTextures.size();
+	header.MaterialCount = (uint32_t)mMaterials.size();
+	header.MeshCount = (uint32_t)mMeshes.size();
+	header.InstanceCount = (uint32_t)mInstances.size();
+	header.StringBytes = (uint32_t)strings.size();
+	header.TextureOffset = AlignOffset(sizeof(SceneFileHeader));
+	header.MaterialOffset = AlignOffset(header.TextureOffset + mTextures.size() * sizeof(SceneTexture));
+	header.MeshOffset = AlignOffset(header.MaterialOffset + mMaterials.size() * sizeof(SceneMaterial));
+	header.InstanceOffset = AlignOffset(header.MeshOffset + mMeshes.size() * sizeof(SceneMesh));
+	header.StringOffset = AlignOffset(header.InstanceOffset + mInstances.size() * sizeof(SceneInstance));
+
+	std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+	if (!fout)
+		return false;
+
+	const char padding[16] = {};
+	uint64_t written = 0;
+	auto writeTable = [&](uint64_t offset, const void* data, uint64_t byteSize)
+	{
+		fout.write(padding, (std::streamsize)(offset - written));
+		fout.write(static_cast<const char*>(data), (std::streamsize)byteSize);
+		written = offset + byteSize;
+	};
+
+	writeTable(0, &header, sizeof(header));
+	writeTable(header.TextureOffset, mTextures.data(), mTextures.size() * sizeof(SceneTexture));
+	writeTable(header.MaterialOffset, mMaterials.data(), mMaterials.size() * sizeof(SceneMaterial));
+	writeTable(header.MeshOffset, mMeshes.data(), mMeshes.size() * sizeof(SceneMesh));
+	writeTable(header.InstanceOffset, mInstances.data(), mInstances.size() * sizeof(SceneInstance));
+	writeTable(header.StringOffset, strings.data(), strings.size());
+
+	return fout.good();
+}
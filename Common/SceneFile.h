@@ -0,0 +1,161 @@
+//***************************************************************************************
+// SceneFile.h
+//
+// A binary scene format that is memory-mapped and read table by table, so a demo can
+// load a scene of a million instances without parsing anything:
+//
+//     SceneFileHeader
+//     textures      (TextureCount SceneTexture records)
+//     materials     (MaterialCount SceneMaterial records)
+//     meshes        (MeshCount SceneMesh records)
+//     instances     (InstanceCount SceneInstance records)
+//     strings       (StringBytes of null-terminated UTF-8 strings)
+//
+// Records refer to each other by index and to their names by byte offset into the
+// string table.  Tables start on 16-byte boundaries relative to the start of the file.
+//
+// A mesh names a submesh of a geometry the demo builds itself ("skullGeo", "skull"),
+// so the scene only says where things go.  An instance's parent comes before it in
+// the table; an instance without a mesh only groups its children.  What Layer means
+// is up to the demo.
+//
+// Open() checks every index and offset, so a demo can use the tables as they are.
+// SceneWriter builds and writes a file, e.g. for SceneGenerator's stress scenes.
+//
+// Only depends on Windows and DirectXMath, like MeshFile.
+//***************************************************************************************
+
+#pragma once
+
+#include <windows.h>
+#include <DirectXMath.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct SceneFileHeader
+{
+	static const uint32_t MagicValue = 0x454E4353; // "SCNE"
+	static const uint32_t CurrentVersion = 1;
+
+	uint32_t Magic = MagicValue;
+	uint32_t Version = CurrentVersion;
+
+	uint32_t TextureCount = 0;
+	uint32_t MaterialCount = 0;
+	uint32_t MeshCount = 0;
+	uint32_t InstanceCount = 0;
+	uint32_t StringBytes = 0;
+	uint32_t HeaderPad = 0;
+
+	uint64_t TextureOffset = 0;
+	uint64_t MaterialOffset = 0;
+	uint64_t MeshOffset = 0;
+	uint64_t InstanceOffset = 0;
+	uint64_t StringOffset = 0;
+};
+
+// Index fields that refer to nothing.
+const uint32_t SceneNone = UINT32_MAX;
+
+struct SceneTexture
+{
+	uint32_t Name;
+	uint32_t Path;            // a DDS file, relative to the demo's working directory
+};
+
+struct SceneMaterial
+{
+	uint32_t Name;
+	uint32_t DiffuseTexture;  // or SceneNone for the demo's white placeholder
+	DirectX::XMFLOAT4 DiffuseAlbedo;
+	DirectX::XMFLOAT3 FresnelR0;
+	float Roughness;
+};
+
+struct SceneMesh
+{
+	uint32_t Geometry;
+	uint32_t Submesh;
+};
+
+// Placed relative to Parent as scale, then rotation, then translation.
+struct SceneInstance
+{
+	DirectX::XMFLOAT3 Translation;
+	uint32_t Parent;          // an earlier instance, or SceneNone
+	DirectX::XMFLOAT4 Rotation;  // quaternion
+	DirectX::XMFLOAT3 Scale;
+	uint32_t Mesh;            // or SceneNone for a group
+	uint32_t Material;        // used when Mesh is set
+	uint32_t Layer;
+};
+
+// A read-only view of a scene file.  The pointers stay valid until Close().
+class SceneFile
+{
+public:
+	SceneFile() = default;
+	SceneFile(const SceneFile& rhs) = delete;
+	SceneFile& operator=(const SceneFile& rhs) = delete;
+	~SceneFile();
+
+	// Maps the file.  Returns false if it is missing, truncated, from another
+	// version, or a record refers to something that is not there.
+	bool Open(const std::wstring& filename);
+	void Close();
+	bool IsOpen()const;
+
+	const SceneFileHeader& Header()const;
+
+	const SceneTexture* Textures()const;
+	const SceneMaterial* Materials()const;
+	const SceneMesh* Meshes()const;
+	const SceneInstance* Instances()const;
+
+	// A string of the string table, by its offset.  WideString() converts it from
+	// UTF-8, e.g. for a path.
+	const char* String(uint32_t offset)const;
+	std::wstring WideString(uint32_t offset)const;
+
+	// The local transform of an instance.
+	static DirectX::XMMATRIX LocalTransform(const SceneInstance& instance);
+
+private:
+	bool Validate()const;
+
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mMapping = nullptr;
+	const uint8_t* mView = nullptr;
+
+	SceneFileHeader mHeader;
+};
+
+// Collects the tables of a scene and writes the file.  Names and paths are shared in
+// the string table when they repeat.
+class SceneWriter
+{
+public:
+	uint32_t AddTexture(const std::string& name, const std::string& path);
+	uint32_t AddMaterial(const std::string& name, uint32_t diffuseTexture,
+		const DirectX::XMFLOAT4& diffuseAlbedo, const DirectX::XMFLOAT3& fresnelR0, float roughness);
+	uint32_t AddMesh(const std::string& geometry, const std::string& submesh);
+	uint32_t AddInstance(const SceneInstance& instance);
+
+	void Reserve(size_t instanceCount);
+	size_t InstanceCount()const;
+
+	// Returns false if the file cannot be written.
+	bool Write(const std::wstring& filename)const;
+
+private:
+	uint32_t AddString(const std::string& s);
+
+	std::vector<SceneTexture> mTextures;
+	std::vector<SceneMaterial> mMaterials;
+	std::vector<SceneMesh> mMeshes;
+	std::vector<SceneInstance> mInstances;
+	std::vector<char> mStrings;
+	std::unordered_map<std::string, uint32_t> mStringOffsets;
+};
@@ -0,0 +1,282 @@
+//***************************************************************************************
+// SceneTarget.cpp
+//***************************************************************************************
+
+#include "SceneTarget.h"
+
+using Microsoft::WRL::ComPtr;
+using namespace DirectX;
+
+SceneTarget::SceneTarget(ID3D12Device* device, DXGI_FORMAT format, const XMFLOAT4& clearColor,
+	const std::wstring& fxaaShaderFile)
+{
+	md3dDevice = device;
+	mFormat = format;
+	mClearColor = clearColor;
+
+	BuildDescriptorHeaps();
+	BuildRootSignature();
+	BuildPso(fxaaShaderFile);
+}
+
+void SceneTarget::Resize(UINT width, UINT height, DXGI_SAMPLE_DESC sampleDesc, bool fxaa)
+{
+	mWidth = (std::max)(width, 1u);
+	mHeight = (std::max)(height, 1u);
+	mMsaa = sampleDesc.Count > 1;
+	mFxaa = fxaa;
+
+	mMsaaTarget = nullptr;
+	mColorTarget = nullptr;
+	mFxaaOutput = nullptr;
+
+	UINT rtvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+	UINT srvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	CD3DX12_CPU_DESCRIPTOR_HANDLE hRtv(mRtvHeap->GetCPUDescriptorHandleForHeapStart());
+	CD3DX12_CPU_DESCRIPTOR_HANDLE hSrvUav(mSrvUavHeap->GetCPUDescriptorHandleForHeapStart());
+
+	if (mMsaa)
+	{
+		mMsaaTargetState = D3D12_RESOURCE_STATE_RENDER_TARGET;
+		mMsaaTarget = CreateTexture(sampleDesc, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET, mMsaaTargetState);
+		md3dDevice->CreateRenderTargetView(mMsaaTarget.Get(), nullptr, hRtv);
+	}
+
+	if (mFxaa)
+	{
+		DXGI_SAMPLE_DESC singleSample = { 1, 0 };
+
+		mColorTargetState = D3D12_RESOURCE_STATE_RENDER_TARGET;
+		mColorTarget = CreateTexture(singleSample, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET, mColorTargetState);
+		md3dDevice->CreateRenderTargetView(mColorTarget.Get(), nullptr, CD3DX12_CPU_DESCRIPTOR_HANDLE(hRtv, 1, rtvDescriptorSize));
+
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.Format = mFormat;
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+		srvDesc.Texture2D.MipLevels = 1;
+		md3dDevice->CreateShaderResourceView(mColorTarget.Get(), &srvDesc, hSrvUav);
+
+		mFxaaOutputState = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+		mFxaaOutput = CreateTexture(singleSample, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, mFxaaOutputState);
+
+		D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+		uavDesc.Format = mFormat;
+		uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+		uavDesc.Texture2D.MipSlice = 0;
+		md3dDevice->CreateUnorderedAccessView(mFxaaOutput.Get(), nullptr, &uavDesc,
+			CD3DX12_CPU_DESCRIPTOR_HANDLE(hSrvUav, 1, srvDescriptorSize));
+	}
+}
+
+bool SceneTarget::IsOffscreen()const
+{
+	return mMsaa || mFxaa;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE SceneTarget::RenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE backBufferView)const
+{
+	if (mMsaa)
+		return mRtvHeap->GetCPUDescriptorHandleForHeapStart();
+
+	if (mFxaa)
+	{
+		UINT rtvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+		return CD3DX12_CPU_DESCRIPTOR_HANDLE(mRtvHeap->GetCPUDescriptorHandleForHeapStart(), 1, rtvDescriptorSize);
+	}
+
+	return backBufferView;
+}
+
+void SceneTarget::BeginScene(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* backBuffer)
+{
+	if (mMsaa)
+	{
+		Transition(cmdList, mMsaaTarget.Get(), mMsaaTargetState, D3D12_RESOURCE_STATE_RENDER_TARGET);
+	}
+	else if (mFxaa)
+	{
+		Transition(cmdList, mColorTarget.Get(), mColorTargetState, D3D12_RESOURCE_STATE_RENDER_TARGET);
+	}
+	else
+	{
+		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(backBuffer,
+			D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+	}
+}
+
+void SceneTarget::EndScene(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* backBuffer)
+{
+	if (!IsOffscreen())
+	{
+		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(backBuffer,
+			D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+		return;
+	}
+
+	if (mMsaa)
+	{
+		Transition(cmdList, mMsaaTarget.Get(), mMsaaTargetState, D3D12_RESOURCE_STATE_RESOLVE_SOURCE);
+
+		if (!mFxaa)
+		{
+			cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(backBuffer,
+				D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RESOLVE_DEST));
+			cmdList->ResolveSubresource(backBuffer, 0, mMsaaTarget.Get(), 0, mFormat);
+			cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(backBuffer,
+				D3D12_RESOURCE_STATE_RESOLVE_DEST, D3D12_RESOURCE_STATE_PRESENT));
+			return;
+		}
+
+		Transition(cmdList, mColorTarget.Get(), mColorTargetState, D3D12_RESOURCE_STATE_RESOLVE_DEST);
+		cmdList->ResolveSubresource(mColorTarget.Get(), 0, mMsaaTarget.Get(), 0, mFormat);
+	}
+
+	Transition(cmdList, mColorTarget.Get(), mColorTargetState, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+	Transition(cmdList, mFxaaOutput.Get(), mFxaaOutputState, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	float constants[4] = { 1.0f / mWidth, 1.0f / mHeight, 0.0f, 0.0f };
+
+	UINT srvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	CD3DX12_GPU_DESCRIPTOR_HANDLE hGpu(mSrvUavHeap->GetGPUDescriptorHandleForHeapStart());
+
+	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvUavHeap.Get() };
+	cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+
+	cmdList->SetComputeRootSignature(mRootSignature.Get());
+	cmdList->SetPipelineState(mFxaaPso.Get());
+	cmdList->SetComputeRoot32BitConstants(0, 4, constants, 0);
+	cmdList->SetComputeRootDescriptorTable(1, hGpu);
+	cmdList->SetComputeRootDescriptorTable(2, CD3DX12_GPU_DESCRIPTOR_HANDLE(hGpu, 1, srvDescriptorSize));
+
+	// 8x8 pixels per group.
+	cmdList->Dispatch((mWidth + 7) / 8, (mHeight + 7) / 8, 1);
+
+	Transition(cmdList, mFxaaOutput.Get(), mFxaaOutputState, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(backBuffer,
+		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_COPY_DEST));
+	cmdList->CopyResource(backBuffer, mFxaaOutput.Get());
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(backBuffer,
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PRESENT));
+}
+
+void SceneTarget::Transition(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* resource,
+	D3D12_RESOURCE_STATES& current, D3D12_RESOURCE_STATES state)
+{
+	if (current == state)
+		return;
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(resource, current, state));
+	current = state;
+}
+
+ComPtr<ID3D12Resource> SceneTarget::CreateTexture(DXGI_SAMPLE_DESC sampleDesc,
+	D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES state)
+{
+	D3D12_RESOURCE_DESC texDesc;
+	ZeroMemory(&texDesc, sizeof(D3D12_RESOURCE_DESC));
+	texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	texDesc.Alignment = 0;
+	texDesc.Width = mWidth;
+	texDesc.Height = mHeight;
+	texDesc.DepthOrArraySize = 1;
+	texDesc.MipLevels = 1;
+	texDesc.Format = mFormat;
+	texDesc.SampleDesc = sampleDesc;
+	texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+	texDesc.Flags = flags;
+
+	// Only render targets take a clear value.
+	D3D12_CLEAR_VALUE optClear;
+	optClear.Format = mFormat;
+	memcpy(optClear.Color, &mClearColor, sizeof(optClear.Color));
+	bool renderTarget = (flags & D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET) != 0;
+
+	CD3DX12_HEAP_PROPERTIES defaultHeap(D3D12_HEAP_TYPE_DEFAULT);
+
+	ComPtr<ID3D12Resource> texture;
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&defaultHeap,
+		D3D12_HEAP_FLAG_NONE,
+		&texDesc,
+		state,
+		renderTarget ? &optClear : nullptr,
+		IID_PPV_ARGS(texture.GetAddressOf())));
+	GpuMemory::Track(texture.Get(), MemoryCategory::RenderTarget);
+	return texture;
+}
+
+void SceneTarget::BuildDescriptorHeaps()
+{
+	D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc;
+	rtvHeapDesc.NumDescriptors = 2;
+	rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+	rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	rtvHeapDesc.NodeMask = 0;
+	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(mRtvHeap.GetAddressOf())));
+
+	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc;
+	srvHeapDesc.NumDescriptors = 2;
+	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	srvHeapDesc.NodeMask = 0;
+	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(mSrvUavHeap.GetAddressOf())));
+}
+
+void SceneTarget::BuildRootSignature()
+{
+	CD3DX12_DESCRIPTOR_RANGE srvTable;
+	srvTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+
+	CD3DX12_DESCRIPTOR_RANGE uavTable;
+	uavTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
+
+	CD3DX12_ROOT_PARAMETER slotRootParameter[3];
+	slotRootParameter[0].InitAsConstants(4, 0);
+	slotRootParameter[1].InitAsDescriptorTable(1, &srvTable);
+	slotRootParameter[2].InitAsDescriptorTable(1, &uavTable);
+
+	const CD3DX12_STATIC_SAMPLER_DESC linearClamp(
+		0,
+		D3D12_FILTER_MIN_MAG_MIP_LINEAR,
+		D3D12_TEXTURE_ADDRESS_MODE_CLAMP,
+		D3D12_TEXTURE_ADDRESS_MODE_CLAMP,
+		D3D12_TEXTURE_ADDRESS_MODE_CLAMP);
+
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(3, slotRootParameter,
+		1, &linearClamp,
+		D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+	ComPtr<ID3DBlob> serializedRootSig = nullptr;
+	ComPtr<ID3DBlob> errorBlob = nullptr;
+	HRESULT hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1,
+		serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
+
+	if (errorBlob != nullptr)
+	{
+		::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+	}
+	ThrowIfFailed(hr);
+
+	ThrowIfFailed(md3dDevice->CreateRootSignature(
+		0,
+		serializedRootSig->GetBufferPointer(),
+		serializedRootSig->GetBufferSize(),
+		IID_PPV_ARGS(mRootSignature.GetAddressOf())));
+}
+
+void SceneTarget::BuildPso(const std::wstring& shaderFile)
+{
+	ComPtr<ID3DBlob> cs = d3dUtil::CompileShader(shaderFile, nullptr, "FxaaCS", "cs_5_0");
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
+	psoDesc.pRootSignature = mRootSignature.Get();
+	psoDesc.CS =
+	{
+		reinterpret_cast<BYTE*>(cs->GetBufferPointer()),
+		cs->GetBufferSize()
+	};
+	psoDesc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+	ThrowIfFailed(md3dDevice->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(mFxaaPso.GetAddressOf())));
+}
@@ -0,0 +1,101 @@
+//***************************************************************************************
+// SceneTarget.h
+//
+// Where the scene is drawn before it reaches the flip model back buffer, which cannot
+// be multisampled or written by a compute shader.
+//
+//   no anti-aliasing   the back buffer itself
+//   MSAA               a multisampled target, resolved into the back buffer with
+//                      ResolveSubresource
+//   FXAA               a single sampled target; FxaaCS (Shader/Fxaa.hlsl) filters it
+//                      into a UAV texture that is copied into the back buffer
+//   MSAA + FXAA        the multisampled target is resolved first, then filtered
+//
+// MSAA costs memory and bandwidth for every sample of colour and depth but only
+// shades once per pixel; FXAA is one cheap compute pass at the end that also
+// smooths shading and alpha tested edges, at the cost of some blur.
+//
+// Per frame:
+//     target.BeginScene(cmdList, CurrentBackBuffer());
+//     ... clear and draw into target.RenderTargetView(CurrentBackBufferView()) ...
+//     target.EndScene(cmdList, CurrentBackBuffer());     // back buffer left in PRESENT
+//
+// The depth buffer must match the sample count given to Resize() (D3DApp's does when
+// it comes from MsaaSampleDesc()).  FXAA needs a format with typed UAV stores, e.g.
+// R8G8B8A8_UNORM.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class SceneTarget
+{
+public:
+	SceneTarget(ID3D12Device* device, DXGI_FORMAT format, const DirectX::XMFLOAT4& clearColor,
+		const std::wstring& fxaaShaderFile = L"../../Shader/Fxaa.hlsl");
+	SceneTarget(const SceneTarget& rhs) = delete;
+	SceneTarget& operator=(const SceneTarget& rhs) = delete;
+	~SceneTarget() = default;
+
+	// Recreates the targets for a new size or anti-aliasing setup.  The GPU must be
+	// done with the old ones.
+	void Resize(UINT width, UINT height, DXGI_SAMPLE_DESC sampleDesc, bool fxaa);
+
+	// False when the scene is drawn straight into the back buffer.
+	bool IsOffscreen()const;
+
+	// The view to draw the scene into; backBufferView when not offscreen.
+	D3D12_CPU_DESCRIPTOR_HANDLE RenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE backBufferView)const;
+
+	// Makes RenderTargetView() a render target.  backBuffer is in the PRESENT state.
+	void BeginScene(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* backBuffer);
+
+	// Resolves and filters the scene into backBuffer and leaves it in PRESENT.  With
+	// FXAA the compute root signature and the PSO are replaced, and the descriptor
+	// heaps; set them again before drawing more.
+	void EndScene(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* backBuffer);
+
+private:
+	void BuildDescriptorHeaps();
+	void BuildRootSignature();
+	void BuildPso(const std::wstring& shaderFile);
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateTexture(DXGI_SAMPLE_DESC sampleDesc,
+		D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES state);
+
+	// Records the barrier if resource is not in state yet.
+	static void Transition(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* resource,
+		D3D12_RESOURCE_STATES& current, D3D12_RESOURCE_STATES state);
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+
+	DXGI_FORMAT mFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+	DirectX::XMFLOAT4 mClearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+	UINT mWidth = 0;
+	UINT mHeight = 0;
+	bool mMsaa = false;
+	bool mFxaa = false;
+
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> mFxaaPso = nullptr;
+
+	// RTVs: multisampled target, single sampled target.
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mRtvHeap = nullptr;
+
+	// Shader visible: SRV of the single sampled target, UAV of the FXAA output.
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mSrvUavHeap = nullptr;
+
+	// Drawn into with MSAA.
+	Microsoft::WRL::ComPtr<ID3D12Resource> mMsaaTarget = nullptr;
+	D3D12_RESOURCE_STATES mMsaaTargetState = D3D12_RESOURCE_STATE_RENDER_TARGET;
+
+	// FXAA input: drawn into without MSAA, the resolve destination with it.
+	Microsoft::WRL::ComPtr<ID3D12Resource> mColorTarget = nullptr;
+	D3D12_RESOURCE_STATES mColorTargetState = D3D12_RESOURCE_STATE_RENDER_TARGET;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mFxaaOutput = nullptr;
+	D3D12_RESOURCE_STATES mFxaaOutputState = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+};
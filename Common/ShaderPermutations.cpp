@@ -0,0 +1,231 @@
+//***************************************************************************************
+// ShaderPermutations.cpp
+//***************************************************************************************
+
+#include "ShaderPermutations.h"
+#include <ppl.h>
+
+using Microsoft::WRL::ComPtr;
+
+ShaderPermutations::ShaderPermutations(const std::wstring& filename, const std::vector<ShaderOption>& options)
+{
+	mFilename = filename;
+	mOptions = options;
+
+	UINT shift = 0;
+	for (const auto& option : mOptions)
+	{
+		Field field;
+		field.Shift = shift;
+		field.Bits = option.Bits;
+		field.Mask = ((1u << option.Bits) - 1) << shift;
+		mFields[option.Define] = field;
+
+		shift += option.Bits;
+	}
+
+	if (shift > 32)
+		throw DxException(E_INVALIDARG, L"ShaderPermutations " + filename, AnsiToWString(__FILE__), __LINE__);
+}
+
+void ShaderPermutations::AddEntryPoint(const std::string& entrypoint, const std::string& target,
+	const std::vector<std::string>& options)
+{
+	EntryPoint entry;
+	entry.Target = target;
+	entry.OptionMask = 0;
+	for (const auto& option : options)
+		entry.OptionMask |= FindField(option).Mask;
+
+	if (mEntryPoints.find(entrypoint) == mEntryPoints.end())
+		mEntryNames.push_back(entrypoint);
+	mEntryPoints[entrypoint] = entry;
+}
+
+const ShaderPermutations::Field& ShaderPermutations::FindField(const std::string& define)const
+{
+	auto it = mFields.find(define);
+	if (it == mFields.end())
+		throw DxException(E_INVALIDARG, L"ShaderPermutations " + AnsiToWString(define), AnsiToWString(__FILE__), __LINE__);
+	return it->second;
+}
+
+ShaderKey ShaderPermutations::With(ShaderKey key, const std::string& define, UINT value)const
+{
+	const Field& field = FindField(define);
+	if (value >= (1u << field.Bits))
+		throw DxException(E_INVALIDARG, L"ShaderPermutations " + AnsiToWString(define), AnsiToWString(__FILE__), __LINE__);
+
+	return (key & ~field.Mask) | (value << field.Shift);
+}
+
+UINT ShaderPermutations::ValueOf(ShaderKey key, const std::string& define)const
+{
+	const Field& field = FindField(define);
+	return (key & field.Mask) >> field.Shift;
+}
+
+std::vector<ShaderKey> ShaderPermutations::Expand(ShaderKey baseKey, const std::vector<std::string>& varying)const
+{
+	std::vector<ShaderKey> keys;
+	for (UINT combination = 0; combination < (1u << varying.size()); ++combination)
+	{
+		ShaderKey key = baseKey;
+		for (size_t i = 0; i < varying.size(); ++i)
+			key = With(key, varying[i], (combination >> i) & 1);
+		keys.push_back(key);
+	}
+	return keys;
+}
+
+UINT64 ShaderPermutations::VariantId(UINT entryIndex, ShaderKey key)
+{
+	return ((UINT64)entryIndex << 32) | key;
+}
+
+void ShaderPermutations::Compile(const std::vector<ShaderKey>& keys)
+{
+	struct Pending
+	{
+		UINT EntryIndex;
+		ShaderKey Key;
+		ComPtr<ID3DBlob> Blob;
+	};
+
+	// Masking keys per entry point collapses variants that only differ in options
+	// the entry point ignores.
+	std::vector<Pending> pending;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		std::unordered_map<UINT64, bool> queued;
+		for (UINT e = 0; e < (UINT)mEntryNames.size(); ++e)
+		{
+			const EntryPoint& entry = mEntryPoints[mEntryNames[e]];
+			for (ShaderKey key : keys)
+			{
+				ShaderKey masked = key & entry.OptionMask;
+				UINT64 id = VariantId(e, masked);
+				if (mVariants.find(id) != mVariants.end() || queued[id])
+					continue;
+
+				queued[id] = true;
+				pending.push_back({ e, masked, nullptr });
+			}
+		}
+	}
+
+	concurrency::parallel_for(size_t(0), pending.size(), [&](size_t i)
+	{
+		pending[i].Blob = CompileVariant(mEntryNames[pending[i].EntryIndex], pending[i].Key);
+	});
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	for (auto& variant : pending)
+		mVariants[VariantId(variant.EntryIndex, variant.Key)] = variant.Blob;
+}
+
+D3D12_SHADER_BYTECODE ShaderPermutations::Bytecode(const std::string& entrypoint, ShaderKey key)
+{
+	auto entry = mEntryPoints.find(entrypoint);
+	if (entry == mEntryPoints.end())
+		throw DxException(E_INVALIDARG, L"ShaderPermutations " + AnsiToWString(entrypoint), AnsiToWString(__FILE__), __LINE__);
+
+	const UINT entryIndex = (UINT)(std::find(mEntryNames.begin(), mEntryNames.end(), entrypoint) - mEntryNames.begin());
+	const ShaderKey masked = key & entry->second.OptionMask;
+	const UINT64 id = VariantId(entryIndex, masked);
+
+	ID3DBlob* blob = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		auto it = mVariants.find(id);
+		if (it != mVariants.end())
+			blob = it->second.Get();
+	}
+
+	if (blob == nullptr)
+	{
+		ComPtr<ID3DBlob> compiled = CompileVariant(entrypoint, masked);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		auto& stored = mVariants[id];
+		if (stored == nullptr)
+			stored = compiled;
+		blob = stored.Get();
+	}
+
+	return { reinterpret_cast<BYTE*>(blob->GetBufferPointer()), blob->GetBufferSize() };
+}
+
+ComPtr<ID3DBlob> ShaderPermutations::CompileVariant(const std::string& entrypoint, ShaderKey key)const
+{
+	std::vector<std::string> values;
+	values.reserve(mOptions.size());
+
+	std::vector<D3D_SHADER_MACRO> defines;
+	for (const auto& option : mOptions)
+	{
+		UINT value = ValueOf(key, option.Define);
+
+		// Flags that are off stay undefined so #ifdef works.
+		if (option.Bits == 1 && value == 0)
+			continue;
+
+		values.push_back(std::to_string(value));
+		defines.push_back({ option.Define.c_str(), nullptr });
+	}
+
+	// values does not reallocate after the reserve, so the pointers stay valid.
+	for (size_t i = 0; i < defines.size(); ++i)
+		defines[i].Definition = values[i].c_str();
+	defines.push_back({ nullptr, nullptr });
+
+	return d3dUtil::CompileShader(mFilename, defines.data(), entrypoint, mEntryPoints.at(entrypoint).Target);
+}
+
+std::string ShaderPermutations::Describe(ShaderKey key)const
+{
+	std::string text;
+	for (const auto& option : mOptions)
+	{
+		UINT value = ValueOf(key, option.Define);
+		if (value == 0)
+			continue;
+
+		if (!text.empty())
+			text += " ";
+		text += option.Define;
+		if (option.Bits > 1)
+			text += "=" + std::to_string(value);
+	}
+	return text;
+}
+
+UINT ShaderPermutations::VariantCount()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return (UINT)mVariants.size();
+}
+
+PermutationPsos::PermutationPsos(ID3D12Device* device, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& baseDesc,
+	ShaderPermutations& shaders, const std::string& vs, const std::string& ps) :
+	mShaders(shaders)
+{
+	md3dDevice = device;
+	mBaseDesc = baseDesc;
+	mVS = vs;
+	mPS = ps;
+}
+
+ID3D12PipelineState* PermutationPsos::Get(ShaderKey key)
+{
+	auto& pso = mPsos[key];
+	if (pso == nullptr)
+	{
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = mBaseDesc;
+		desc.VS = mShaders.Bytecode(mVS, key);
+		if (!mPS.empty())
+			desc.PS = mShaders.Bytecode(mPS, key);
+		ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(pso.GetAddressOf())));
+	}
+	return pso.Get();
+}
@@ -0,0 +1,124 @@
+//***************************************************************************************
+// ShaderPermutations.h
+//
+// Compiles the specialized variants of one shader file from a declared set of
+// options, instead of hand-written D3D_SHADER_MACRO arrays per variant.  A variant
+// is named by a ShaderKey, a bitfield with one field per option:
+//
+//   ShaderPermutations shaders(L"Default.hlsl", { { "NUM_DIR_LIGHTS", 2 }, { "FOG" }, { "ALPHA_TEST" } });
+//   ShaderKey key = shaders.With(shaders.With(0, "NUM_DIR_LIGHTS", 3), "FOG");
+//
+// A 1-bit option is #defined as 1 when set and left undefined otherwise, so the
+// shader keeps using #ifdef.  Wider options (light counts) are always defined to
+// their value.
+//
+// Each entry point lists the options it depends on; the others are masked out of
+// its keys, so a pixel shader flag does not compile the vertex shader again.
+// Compile() builds every missing variant in parallel through d3dUtil::CompileShader,
+// so variants also come from its disk cache on later runs.
+//
+// PermutationPsos then keeps one PSO per key for a pass, so a draw picks the PSO of
+// its material's key instead of branching in the shader.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include <mutex>
+
+using ShaderKey = UINT32;
+
+struct ShaderOption
+{
+	std::string Define;
+
+	// Width of the option's field; the value is in [0, 2^Bits).
+	UINT Bits = 1;
+};
+
+class ShaderPermutations
+{
+public:
+	ShaderPermutations(const std::wstring& filename, const std::vector<ShaderOption>& options);
+	ShaderPermutations(const ShaderPermutations& rhs) = delete;
+	ShaderPermutations& operator=(const ShaderPermutations& rhs) = delete;
+	~ShaderPermutations() = default;
+
+	// options are the ones the entry point reads; with none it has a single variant.
+	void AddEntryPoint(const std::string& entrypoint, const std::string& target,
+		const std::vector<std::string>& options = {});
+
+	// key with the option set to value.  Throws DxException(E_INVALIDARG) for an
+	// unknown option or a value that does not fit.
+	ShaderKey With(ShaderKey key, const std::string& define, UINT value = 1)const;
+	UINT ValueOf(ShaderKey key, const std::string& define)const;
+
+	// Every combination of the varying options on top of baseKey, e.g. all the
+	// fog/alpha test variants of a light count.  1-bit options only.
+	std::vector<ShaderKey> Expand(ShaderKey baseKey, const std::vector<std::string>& varying)const;
+
+	// Compiles every entry point for each key, skipping variants already built.
+	void Compile(const std::vector<ShaderKey>& keys);
+
+	// The variant's bytecode, compiled here if Compile() did not cover it.
+	D3D12_SHADER_BYTECODE Bytecode(const std::string& entrypoint, ShaderKey key);
+
+	// "FOG NUM_DIR_LIGHTS=3", for debug output.
+	std::string Describe(ShaderKey key)const;
+
+	UINT VariantCount()const;
+
+private:
+	struct Field
+	{
+		UINT Shift = 0;
+		UINT Bits = 1;
+		ShaderKey Mask = 0;
+	};
+
+	struct EntryPoint
+	{
+		std::string Target;
+		ShaderKey OptionMask = 0;
+	};
+
+	const Field& FindField(const std::string& define)const;
+	Microsoft::WRL::ComPtr<ID3DBlob> CompileVariant(const std::string& entrypoint, ShaderKey key)const;
+	static UINT64 VariantId(UINT entryIndex, ShaderKey key);
+
+private:
+	std::wstring mFilename;
+	std::vector<ShaderOption> mOptions;
+	std::unordered_map<std::string, Field> mFields;
+
+	std::vector<std::string> mEntryNames;
+	std::unordered_map<std::string, EntryPoint> mEntryPoints;
+
+	mutable std::mutex mMutex;
+	std::unordered_map<UINT64, Microsoft::WRL::ComPtr<ID3DBlob>> mVariants;
+};
+
+class PermutationPsos
+{
+public:
+	// baseDesc holds everything but the shaders, which come from shaders' vs and ps
+	// entry points for each key.  baseDesc's pointers must outlive this object.
+	PermutationPsos(ID3D12Device* device, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& baseDesc,
+		ShaderPermutations& shaders, const std::string& vs, const std::string& ps);
+	PermutationPsos(const PermutationPsos& rhs) = delete;
+	PermutationPsos& operator=(const PermutationPsos& rhs) = delete;
+	~PermutationPsos() = default;
+
+	// Creates the PSO the first time a key is seen; create the keys a scene uses
+	// at load time so no frame pays for it.
+	ID3D12PipelineState* Get(ShaderKey key);
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC mBaseDesc;
+	ShaderPermutations& mShaders;
+	std::string mVS;
+	std::string mPS;
+
+	std::unordered_map<ShaderKey, Microsoft::WRL::ComPtr<ID3D12PipelineState>> mPsos;
+};
@@ -0,0 +1,192 @@
+//***************************************************************************************
+// StagingRing.cpp
+//***************************************************************************************
+
+#include "StagingRing.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// Keeps every copy source 16-byte aligned for the memcpy.
+	const UINT64 StagingAlignment = 16;
+}
+
+StagingRing::StagingRing(ID3D12Device* device, ID3D12CommandQueue* queue, UINT64 capacity) :
+	md3dDevice(device),
+	mQueue(queue),
+	mCapacity(capacity)
+{
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(capacity),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(mUploadBuffer.GetAddressOf())));
+	GpuMemory::Track(mUploadBuffer.Get(), MemoryCategory::Upload);
+
+	// We do not need to unmap until we are done with the resource.
+	ThrowIfFailed(mUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedData)));
+
+	ThrowIfFailed(device->CreateCommandAllocator(
+		D3D12_COMMAND_LIST_TYPE_DIRECT,
+		IID_PPV_ARGS(mCurrCmdListAlloc.GetAddressOf())));
+
+	ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+		mCurrCmdListAlloc.Get(), nullptr,
+		IID_PPV_ARGS(mCmdList.GetAddressOf())));
+	ThrowIfFailed(mCmdList->Close());
+	mFreeCmdListAllocs.push_back(mCurrCmdListAlloc);
+	mCurrCmdListAlloc = nullptr;
+
+	ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(mFence.GetAddressOf())));
+	mFenceEvent = CreateEventEx(nullptr, nullptr, false, EVENT_ALL_ACCESS);
+}
+
+StagingRing::~StagingRing()
+{
+	Flush();
+
+	if(mUploadBuffer != nullptr)
+		mUploadBuffer->Unmap(0, nullptr);
+
+	if(mFenceEvent != nullptr)
+		CloseHandle(mFenceEvent);
+}
+
+void StagingRing::Upload(ID3D12Resource* dest, UINT64 destOffset, const void* data, UINT64 byteSize)
+{
+	const BYTE* src = reinterpret_cast<const BYTE*>(data);
+	while(byteSize > 0)
+	{
+		UINT64 chunkSize = byteSize < mCapacity ? byteSize : mCapacity;
+		UINT64 offset = Reserve(chunkSize);
+
+		if(!mRecording)
+			BeginBatch();
+
+		memcpy(mMappedData + offset, src, (size_t)chunkSize);
+		mCmdList->CopyBufferRegion(dest, destOffset, mUploadBuffer.Get(), offset, chunkSize);
+
+		src += chunkSize;
+		destOffset += chunkSize;
+		byteSize -= chunkSize;
+	}
+}
+
+void StagingRing::Upload(const BufferAllocation& dest, const void* data)
+{
+	Upload(dest.Resource, dest.Offset, data, dest.Size);
+}
+
+UINT64 StagingRing::Submit()
+{
+	if(!mRecording)
+		return 0;
+
+	ThrowIfFailed(mCmdList->Close());
+	ID3D12CommandList* cmdsLists[] = { mCmdList.Get() };
+	mQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+
+	Batch batch;
+	batch.FenceValue = ++mFenceValue;
+	batch.End = mHead;
+	batch.CmdListAlloc = mCurrCmdListAlloc;
+	ThrowIfFailed(mQueue->Signal(mFence.Get(), batch.FenceValue));
+
+	mInFlight.push_back(batch);
+	mCurrCmdListAlloc = nullptr;
+	mRecording = false;
+
+	return batch.FenceValue;
+}
+
+void StagingRing::Flush()
+{
+	Submit();
+	WaitForFence(mFenceValue);
+	Reclaim();
+}
+
+bool StagingRing::IsComplete(UINT64 fenceValue)const
+{
+	return mFence->GetCompletedValue() >= fenceValue;
+}
+
+UINT64 StagingRing::Reserve(UINT64 byteSize)
+{
+	assert(byteSize <= mCapacity);
+
+	for(;;)
+	{
+		UINT64 start = (mHead + StagingAlignment - 1) & ~(StagingAlignment - 1);
+
+		// Never split a copy across the end of the buffer; skip to the front instead.
+		UINT64 position = start % mCapacity;
+		if(position + byteSize > mCapacity)
+		{
+			start += mCapacity - position;
+			position = 0;
+		}
+
+		if(start + byteSize - mTail <= mCapacity)
+		{
+			mHead = start + byteSize;
+			return position;
+		}
+
+		// Full.  Take back whatever the GPU has finished with, and if that is not
+		// enough, push out the pending copies and wait on the oldest batch.
+		Reclaim();
+		if(start + byteSize - mTail <= mCapacity)
+			continue;
+
+		Submit();
+		WaitForFence(mInFlight.front().FenceValue);
+		Reclaim();
+	}
+}
+
+void StagingRing::BeginBatch()
+{
+	if(mFreeCmdListAllocs.empty())
+	{
+		ThrowIfFailed(md3dDevice->CreateCommandAllocator(
+			D3D12_COMMAND_LIST_TYPE_DIRECT,
+			IID_PPV_ARGS(mCurrCmdListAlloc.GetAddressOf())));
+	}
+	else
+	{
+		mCurrCmdListAlloc = mFreeCmdListAllocs.back();
+		mFreeCmdListAllocs.pop_back();
+	}
+
+	ThrowIfFailed(mCurrCmdListAlloc->Reset());
+	ThrowIfFailed(mCmdList->Reset(mCurrCmdListAlloc.Get(), nullptr));
+	mRecording = true;
+}
+
+void StagingRing::Reclaim()
+{
+	UINT64 completed = mFence->GetCompletedValue();
+	while(!mInFlight.empty() && mInFlight.front().FenceValue <= completed)
+	{
+		mTail = mInFlight.front().End;
+		mFreeCmdListAllocs.push_back(mInFlight.front().CmdListAlloc);
+		mInFlight.pop_front();
+	}
+
+	// Nothing is in flight or pending, so the whole ring is free again.
+	if(mInFlight.empty() && !mRecording)
+		mTail = mHead;
+}
+
+void StagingRing::WaitForFence(UINT64 fenceValue)
+{
+	if(fenceValue == 0 || mFence->GetCompletedValue() >= fenceValue)
+		return;
+
+	ThrowIfFailed(mFence->SetEventOnCompletion(fenceValue, mFenceEvent));
+	WaitForSingleObject(mFenceEvent, INFINITE);
+}
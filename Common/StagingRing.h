@@ -0,0 +1,76 @@
+//***************************************************************************************
+// StagingRing.h
+//
+// One persistently mapped upload buffer used as a ring for initial buffer data.
+// Upload() copies into the ring and records a CopyBufferRegion on the ring's own
+// command list; Submit() executes everything recorded so far with a single
+// ExecuteCommandLists and a single Signal.  Ring space and command allocators of a
+// batch are recycled as soon as its fence completes, so callers no longer keep
+// per-buffer uploaders alive (MeshGeometry::DisposeUploaders becomes a no-op).
+//
+// Submit on the queue that later draws with the buffers: queue order then
+// guarantees the copies land first and no extra GPU wait is needed.
+//***************************************************************************************
+
+#pragma once
+
+#include "BufferSuballocator.h"
+#include <deque>
+
+class StagingRing
+{
+public:
+	StagingRing(ID3D12Device* device, ID3D12CommandQueue* queue, UINT64 capacity = 4 * 1024 * 1024);
+	StagingRing(const StagingRing& rhs) = delete;
+	StagingRing& operator=(const StagingRing& rhs) = delete;
+	~StagingRing();
+
+	// Data larger than the ring is split into several copies.  When the ring is
+	// full the pending copies are submitted and the oldest batch is waited on.
+	void Upload(ID3D12Resource* dest, UINT64 destOffset, const void* data, UINT64 byteSize);
+	void Upload(const BufferAllocation& dest, const void* data);
+
+	// Returns the fence value of the batch, or 0 if nothing was recorded.
+	UINT64 Submit();
+
+	// Submit() and wait for every batch to complete.
+	void Flush();
+
+	bool IsComplete(UINT64 fenceValue)const;
+
+private:
+	UINT64 Reserve(UINT64 byteSize);
+	void BeginBatch();
+	void Reclaim();
+	void WaitForFence(UINT64 fenceValue);
+
+private:
+	struct Batch
+	{
+		UINT64 FenceValue = 0;
+		UINT64 End = 0;
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
+	};
+
+	ID3D12Device* md3dDevice = nullptr;
+	ID3D12CommandQueue* mQueue = nullptr;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
+	BYTE* mMappedData = nullptr;
+	UINT64 mCapacity = 0;
+
+	// Monotonic byte positions; the live region is [mTail, mHead) modulo mCapacity.
+	UINT64 mHead = 0;
+	UINT64 mTail = 0;
+
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> mCmdList;
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> mCurrCmdListAlloc;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> mFreeCmdListAllocs;
+	bool mRecording = false;
+
+	std::deque<Batch> mInFlight;
+
+	Microsoft::WRL::ComPtr<ID3D12Fence> mFence;
+	UINT64 mFenceValue = 0;
+	HANDLE mFenceEvent = nullptr;
+};
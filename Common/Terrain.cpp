@@ -0,0 +1,382 @@
+//***************************************************************************************
+// Terrain.cpp
+//***************************************************************************************
+
+#include "Terrain.h"
+#include <cmath>
+
+using namespace DirectX;
+
+FunctionHeightSource::FunctionHeightSource(std::function<float(float, float)> height) :
+	mHeight(std::move(height))
+{
+}
+
+float FunctionHeightSource::Height(float x, float z)const
+{
+	return mHeight(x, z);
+}
+
+Terrain::Terrain(ID3D12Device* device, ID3D12CommandQueue* queue, JobSystem& jobs,
+	const TerrainDesc& desc, std::unique_ptr<TerrainHeightSource> heightSource) :
+	mJobs(&jobs),
+	mDesc(desc),
+	mHeightSource(std::move(heightSource)),
+	mAllocator(device),
+	mStaging(device, queue)
+{
+	const UINT n = mDesc.TileQuads;
+	assert((n & (n - 1)) == 0);
+	assert(mDesc.LodCount >= 1 && n >= (1u << (mDesc.LodCount - 1)));
+	assert(mDesc.VertexByteStride > 0 && mDesc.WriteVertex != nullptr);
+
+	// 16-bit indices, rebased per tile with BaseVertexLocation.
+	mTileVertexCount = (n + 1) * (n + 1);
+	assert(mTileVertexCount <= 0x10000);
+
+	// Enough slots for every tile the resident circle plus the eviction margin
+	// can touch.
+	const UINT k = (UINT)ceilf(mDesc.ResidentRadius / mDesc.TileSize) + 2;
+	mSlotCount = (2 * k + 1) * (2 * k + 1);
+
+	mVertexBuffer = mAllocator.Allocate((UINT64)mSlotCount * mTileVertexCount * mDesc.VertexByteStride);
+
+	mFreeSlots.reserve(mSlotCount);
+	for(UINT i = mSlotCount; i > 0; --i)
+		mFreeSlots.push_back(i - 1);
+
+	BuildIndexBuffer();
+}
+
+Terrain::~Terrain()
+{
+	// Workers still write into the tiles; errors no longer matter here.
+	for(auto& e : mTiles)
+	{
+		try { mJobs->Wait(e.second->Job); }
+		catch(...) {}
+	}
+}
+
+void Terrain::Update(const XMFLOAT3& eyePos, UINT64 lastSubmittedFence, UINT64 completedFence)
+{
+	// Slots whose last draw has finished on the GPU can take a new tile.
+	for(size_t i = 0; i < mRetiredSlots.size();)
+	{
+		if(mRetiredSlots[i].Fence <= completedFence)
+		{
+			mFreeSlots.push_back(mRetiredSlots[i].Slot);
+			mRetiredSlots[i] = mRetiredSlots.back();
+			mRetiredSlots.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	// Evict with a tile's margin over the resident radius, so tiles on the
+	// boundary do not stream in and out as the camera jitters.
+	const float evictRadius = mDesc.ResidentRadius + mDesc.TileSize;
+	for(auto it = mTiles.begin(); it != mTiles.end();)
+	{
+		Tile& tile = *it->second;
+		if(!JobSystem::IsComplete(tile.Job) || TileDistance(tile.X, tile.Z, eyePos) <= evictRadius)
+		{
+			++it;
+			continue;
+		}
+
+		// A tile that never became ready was never drawn from its slot.
+		if(tile.Ready)
+			mRetiredSlots.push_back({ tile.Slot, lastSubmittedFence });
+		else
+			mFreeSlots.push_back(tile.Slot);
+
+		it = mTiles.erase(it);
+	}
+
+	// Request missing tiles, nearest first.
+	const int k = (int)ceilf(mDesc.ResidentRadius / mDesc.TileSize);
+	const int cx = (int)floorf(eyePos.x / mDesc.TileSize);
+	const int cz = (int)floorf(eyePos.z / mDesc.TileSize);
+
+	std::vector<std::pair<float, UINT64>> missing;
+	for(int z = cz - k; z <= cz + k; ++z)
+	{
+		for(int x = cx - k; x <= cx + k; ++x)
+		{
+			float distance = TileDistance(x, z, eyePos);
+			if(distance <= mDesc.ResidentRadius && mTiles.find(TileKey(x, z)) == mTiles.end())
+				missing.push_back(std::make_pair(distance, TileKey(x, z)));
+		}
+	}
+	std::sort(missing.begin(), missing.end());
+
+	for(size_t i = 0; i < missing.size() && i < mDesc.MaxRequestsPerUpdate && !mFreeSlots.empty(); ++i)
+	{
+		auto tile = std::make_unique<Tile>();
+		tile->X = (int)(INT32)(missing[i].second >> 32);
+		tile->Z = (int)(INT32)(missing[i].second & 0xffffffff);
+		tile->Slot = mFreeSlots.back();
+		mFreeSlots.pop_back();
+
+		// The tile is never erased before its job is done, so the pointer stays valid.
+		Tile* t = tile.get();
+		tile->Job = mJobs->Submit([this, t]() { GenerateTile(*t); });
+
+		mTiles[missing[i].second] = std::move(tile);
+	}
+
+	// Upload what the workers have finished.  The copies go to the drawing queue
+	// ahead of this frame, so the tiles can be drawn right away.
+	const UINT64 tileByteSize = (UINT64)mTileVertexCount * mDesc.VertexByteStride;
+	bool uploaded = false;
+	for(auto& e : mTiles)
+	{
+		Tile& tile = *e.second;
+		if(tile.Ready || !JobSystem::IsComplete(tile.Job))
+			continue;
+
+		mJobs->Wait(tile.Job); // rethrows worker errors
+
+		mStaging.Upload(mVertexBuffer.Resource,
+			mVertexBuffer.Offset + tile.Slot * tileByteSize,
+			tile.Vertices.data(), tileByteSize);
+
+		std::vector<BYTE>().swap(tile.Vertices);
+		tile.Ready = true;
+		uploaded = true;
+	}
+
+	if(uploaded)
+		mStaging.Submit();
+
+	SelectLods(eyePos);
+}
+
+void Terrain::Draw(ID3D12GraphicsCommandList* cmdList)const
+{
+	D3D12_VERTEX_BUFFER_VIEW vbv;
+	vbv.BufferLocation = mVertexBuffer.GPU;
+	vbv.StrideInBytes = mDesc.VertexByteStride;
+	vbv.SizeInBytes = (UINT)mVertexBuffer.Size;
+
+	D3D12_INDEX_BUFFER_VIEW ibv;
+	ibv.BufferLocation = mIndexBuffer.GPU;
+	ibv.Format = DXGI_FORMAT_R16_UINT;
+	ibv.SizeInBytes = (UINT)mIndexBuffer.Size;
+
+	cmdList->IASetVertexBuffers(0, 1, &vbv);
+	cmdList->IASetIndexBuffer(&ibv);
+	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	for(auto& e : mTiles)
+	{
+		const Tile& tile = *e.second;
+		if(!tile.Ready)
+			continue;
+
+		const IndexRange& range = mIndexRanges[tile.Lod * 16 + tile.StitchMask];
+		cmdList->DrawIndexedInstanced(range.Count, 1, range.Start, (INT)(tile.Slot * mTileVertexCount), 0);
+	}
+}
+
+UINT Terrain::ResidentTileCount()const
+{
+	return (UINT)mTiles.size() - PendingTileCount();
+}
+
+UINT Terrain::PendingTileCount()const
+{
+	UINT count = 0;
+	for(auto& e : mTiles)
+	{
+		if(!e.second->Ready)
+			count++;
+	}
+	return count;
+}
+
+UINT Terrain::DrawnTriangleCount()const
+{
+	return mDrawnTriangleCount;
+}
+
+UINT64 Terrain::TileKey(int x, int z)
+{
+	return ((UINT64)(UINT32)x << 32) | (UINT32)z;
+}
+
+void Terrain::BuildIndexBuffer()
+{
+	const UINT n = mDesc.TileQuads;
+
+	std::vector<std::uint16_t> indices;
+	mIndexRanges.resize(mDesc.LodCount * 16);
+
+	for(UINT lod = 0; lod < mDesc.LodCount; ++lod)
+	{
+		const UINT s = 1u << lod;
+
+		for(UINT mask = 0; mask < 16; ++mask)
+		{
+			// On an edge that borders a coarser tile, vertices the neighbour does not
+			// have collapse onto the previous one it does have.
+			auto vertex = [n, s, mask](UINT r, UINT c) -> std::uint16_t
+			{
+				if(((mask & EdgeSouth) && r == 0) || ((mask & EdgeNorth) && r == n))
+				{
+					if((c / s) % 2 == 1)
+						c -= s;
+				}
+				if(((mask & EdgeWest) && c == 0) || ((mask & EdgeEast) && c == n))
+				{
+					if((r / s) % 2 == 1)
+						r -= s;
+				}
+				return (std::uint16_t)(r * (n + 1) + c);
+			};
+
+			IndexRange& range = mIndexRanges[lod * 16 + mask];
+			range.Start = (UINT)indices.size();
+
+			// Row r is at z = r * spacing, so (r+1, c), (r+1, c+1), (r, c) is
+			// clockwise seen from above, like GeometryGenerator's grid.
+			for(UINT r = 0; r < n; r += s)
+			{
+				for(UINT c = 0; c < n; c += s)
+				{
+					std::uint16_t tri[2][3] =
+					{
+						{ vertex(r + s, c), vertex(r + s, c + s), vertex(r, c) },
+						{ vertex(r, c), vertex(r + s, c + s), vertex(r, c + s) }
+					};
+
+					for(auto& t : tri)
+					{
+						if(t[0] != t[1] && t[1] != t[2] && t[2] != t[0])
+							indices.insert(indices.end(), t, t + 3);
+					}
+				}
+			}
+
+			range.Count = (UINT)indices.size() - range.Start;
+		}
+	}
+
+	const UINT64 byteSize = indices.size() * sizeof(std::uint16_t);
+	mIndexBuffer = mAllocator.Allocate(byteSize);
+	mStaging.Upload(mIndexBuffer.Resource, mIndexBuffer.Offset, indices.data(), byteSize);
+	mStaging.Submit();
+}
+
+void Terrain::GenerateTile(Tile& tile)const
+{
+	const UINT n = mDesc.TileQuads;
+	const float spacing = mDesc.TileSize / n;
+	const UINT stride = mDesc.VertexByteStride;
+
+	tile.Vertices.resize((size_t)mTileVertexCount * stride);
+
+	// Global sample coordinates: both tiles of a shared edge evaluate exactly
+	// the same floats there.
+	auto height = [this, spacing](int gx, int gz) { return mHeightSource->Height(gx * spacing, gz * spacing); };
+
+	for(UINT r = 0; r <= n; ++r)
+	{
+		const int gz = tile.Z * (int)n + (int)r;
+		for(UINT c = 0; c <= n; ++c)
+		{
+			const int gx = tile.X * (int)n + (int)c;
+
+			XMFLOAT3 pos(gx * spacing, height(gx, gz), gz * spacing);
+
+			// Central differences; n = (-dh/dx, 1, -dh/dz) scaled by 2 * spacing.
+			XMFLOAT3 normal(
+				height(gx - 1, gz) - height(gx + 1, gz),
+				2.0f * spacing,
+				height(gx, gz - 1) - height(gx, gz + 1));
+			XMStoreFloat3(&normal, XMVector3Normalize(XMLoadFloat3(&normal)));
+
+			mDesc.WriteVertex(&tile.Vertices[(r * (n + 1) + c) * stride], pos, normal);
+		}
+	}
+}
+
+void Terrain::SelectLods(const XMFLOAT3& eyePos)
+{
+	for(auto& e : mTiles)
+	{
+		Tile& tile = *e.second;
+		if(!tile.Ready)
+			continue;
+
+		float distance = TileDistance(tile.X, tile.Z, eyePos);
+		distance = sqrtf(distance * distance + eyePos.y * eyePos.y);
+
+		int lod = 0;
+		if(distance > mDesc.LodDistance)
+			lod = (int)floorf(log2f(distance / mDesc.LodDistance)) + 1;
+		tile.Lod = MathHelper::Min(lod, (int)mDesc.LodCount - 1);
+	}
+
+	const int dx[4] = { 0, 0, -1, 1 };
+	const int dz[4] = { -1, 1, 0, 0 };
+	const UINT bits[4] = { EdgeSouth, EdgeNorth, EdgeWest, EdgeEast };
+
+	auto neighbour = [this](int x, int z) -> const Tile*
+	{
+		auto it = mTiles.find(TileKey(x, z));
+		return (it != mTiles.end() && it->second->Ready) ? it->second.get() : nullptr;
+	};
+
+	// Stitching only covers one level of difference, so refine tiles next to much
+	// finer ones.  Levels only decrease, so this terminates.
+	bool changed = true;
+	while(changed)
+	{
+		changed = false;
+		for(auto& e : mTiles)
+		{
+			Tile& tile = *e.second;
+			if(!tile.Ready)
+				continue;
+
+			for(int i = 0; i < 4; ++i)
+			{
+				const Tile* nb = neighbour(tile.X + dx[i], tile.Z + dz[i]);
+				if(nb != nullptr && tile.Lod > nb->Lod + 1)
+				{
+					tile.Lod = nb->Lod + 1;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	mDrawnTriangleCount = 0;
+	for(auto& e : mTiles)
+	{
+		Tile& tile = *e.second;
+		if(!tile.Ready)
+			continue;
+
+		tile.StitchMask = 0;
+		for(int i = 0; i < 4; ++i)
+		{
+			const Tile* nb = neighbour(tile.X + dx[i], tile.Z + dz[i]);
+			if(nb != nullptr && nb->Lod == tile.Lod + 1)
+				tile.StitchMask |= bits[i];
+		}
+
+		mDrawnTriangleCount += mIndexRanges[tile.Lod * 16 + tile.StitchMask].Count / 3;
+	}
+}
+
+float Terrain::TileDistance(int x, int z, const XMFLOAT3& eyePos)const
+{
+	float dx = (x + 0.5f) * mDesc.TileSize - eyePos.x;
+	float dz = (z + 0.5f) * mDesc.TileSize - eyePos.z;
+	return sqrtf(dx * dx + dz * dz);
+}
@@ -0,0 +1,164 @@
+//***************************************************************************************
+// Terrain.h
+//
+// Tiled terrain with geomipmapping.  The world is an endless grid of square tiles;
+// tiles within ResidentRadius of the camera are generated from a TerrainHeightSource
+// on JobSystem workers, uploaded through a StagingRing and drawn, tiles that drift
+// out of range are evicted and their slot reused.
+//
+// Every tile keeps its full-resolution vertices; a level of detail only changes
+// which of them the index buffer uses (level l takes every 2^l-th row and column).
+// The index buffer holds each level in 16 variants, one per combination of edges
+// that border a tile one level coarser.  On such an edge every other vertex is
+// collapsed into its neighbour, so both tiles share exactly the same edge vertices
+// and no cracks open.  Update() limits neighbouring levels to a difference of one.
+//
+// Vertex positions are computed from global sample coordinates, so the shared edge
+// of two tiles gets bit-identical heights no matter which tile generated it.
+//***************************************************************************************
+
+#pragma once
+
+#include "StagingRing.h"
+#include "JobSystem.h"
+#include <functional>
+
+class TerrainHeightSource
+{
+public:
+	virtual ~TerrainHeightSource() = default;
+
+	// World-space height at (x, z).  Called concurrently from worker threads.
+	virtual float Height(float x, float z)const = 0;
+};
+
+// Wraps an analytic height function, e.g. a demo's GetHillsHeight.  A source that
+// streams a height map from disk implements the same interface.
+class FunctionHeightSource : public TerrainHeightSource
+{
+public:
+	explicit FunctionHeightSource(std::function<float(float, float)> height);
+
+	virtual float Height(float x, float z)const override;
+
+private:
+	std::function<float(float, float)> mHeight;
+};
+
+struct TerrainDesc
+{
+	float TileSize = 64.0f;
+
+	// Quads along a tile edge at full detail.  Power of two, at most 255, and at
+	// least 2^(LodCount-1) so the coarsest level still has a whole quad.
+	UINT TileQuads = 32;
+	UINT LodCount = 4;
+
+	// Tiles closer than LodDistance use level 0; every doubling of the distance
+	// drops one level.
+	float LodDistance = 80.0f;
+
+	// Tiles whose center is within this xz distance of the camera are kept resident.
+	float ResidentRadius = 600.0f;
+
+	// Caps the tiles handed to worker threads per Update(), which bounds the
+	// upload work of a single frame.
+	UINT MaxRequestsPerUpdate = 8;
+
+	// Writes one vertex of the demo's format.  Called from worker threads.
+	UINT VertexByteStride = 0;
+	std::function<void(void* vertex, const DirectX::XMFLOAT3& pos, const DirectX::XMFLOAT3& normal)> WriteVertex;
+};
+
+class Terrain
+{
+public:
+	// Uploads go to queue, which must be the queue that draws the terrain.  Tiles
+	// are generated on jobs, which must outlive the terrain.
+	Terrain(ID3D12Device* device, ID3D12CommandQueue* queue, JobSystem& jobs,
+		const TerrainDesc& desc, std::unique_ptr<TerrainHeightSource> heightSource);
+	Terrain(const Terrain& rhs) = delete;
+	Terrain& operator=(const Terrain& rhs) = delete;
+
+	// Waits for outstanding tile jobs and uploads.
+	~Terrain();
+
+	// Streams tiles around eyePos and picks their levels.  lastSubmittedFence is
+	// the value of the last frame submitted to the queue, completedFence the last
+	// value the GPU has reached; slots of evicted tiles are reused once it passes
+	// the frame that last drew them.
+	void Update(const DirectX::XMFLOAT3& eyePos, UINT64 lastSubmittedFence, UINT64 completedFence);
+
+	// Draws every resident tile.  Vertices are in world space, so bind an identity
+	// world matrix first.  Sets the vertex/index buffers and the topology.
+	void Draw(ID3D12GraphicsCommandList* cmdList)const;
+
+	UINT ResidentTileCount()const;
+	UINT PendingTileCount()const;
+	UINT DrawnTriangleCount()const;
+
+private:
+	enum EdgeBits
+	{
+		EdgeSouth = 1,	// -z
+		EdgeNorth = 2,	// +z
+		EdgeWest = 4,	// -x
+		EdgeEast = 8,	// +x
+	};
+
+	struct Tile
+	{
+		int X = 0;
+		int Z = 0;
+		UINT Slot = 0;
+		int Lod = 0;
+		UINT StitchMask = 0;
+		bool Ready = false;
+
+		// Written by the worker; empty once uploaded.
+		std::vector<BYTE> Vertices;
+		JobSystem::JobHandle Job;
+	};
+
+	struct IndexRange
+	{
+		UINT Start = 0;
+		UINT Count = 0;
+	};
+
+	struct RetiredSlot
+	{
+		UINT Slot = 0;
+		UINT64 Fence = 0;
+	};
+
+	static UINT64 TileKey(int x, int z);
+
+	void BuildIndexBuffer();
+	void GenerateTile(Tile& tile)const;
+	void SelectLods(const DirectX::XMFLOAT3& eyePos);
+	float TileDistance(int x, int z, const DirectX::XMFLOAT3& eyePos)const;
+
+private:
+	JobSystem* mJobs = nullptr;
+	TerrainDesc mDesc;
+	std::unique_ptr<TerrainHeightSource> mHeightSource;
+
+	BufferSuballocator mAllocator;
+	StagingRing mStaging;
+
+	UINT mTileVertexCount = 0;
+	UINT mSlotCount = 0;
+
+	BufferAllocation mVertexBuffer;
+	BufferAllocation mIndexBuffer;
+
+	// [lod * 16 + stitch mask]
+	std::vector<IndexRange> mIndexRanges;
+
+	std::unordered_map<UINT64, std::unique_ptr<Tile>> mTiles;
+	std::vector<UINT> mFreeSlots;
+	std::vector<RetiredSlot> mRetiredSlots;
+
+	UINT mDrawnTriangleCount = 0;
+};
@@ -0,0 +1,1244 @@
+//***************************************************************************************
+// TextureConverter.cpp
+//***************************************************************************************
+
+#include "TextureConverter.h"
+#include <wincodec.h>
+#include <ppl.h>
+#include <cfloat>
+#include <climits>
+#include <cwctype>
+#include <iterator>
+
+#pragma comment(lib, "windowscodecs.lib")
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	std::wstring gTextureCacheDirectory = L"TextureCache";
+
+	struct Image
+	{
+		UINT Width = 0;
+		UINT Height = 0;
+		std::vector<uint8_t> Rgba;
+	};
+
+	void ThrowSourceError(HRESULT hr, const std::wstring& filename)
+	{
+		throw DxException(hr, L"TextureConverter " + filename, AnsiToWString(__FILE__), __LINE__);
+	}
+
+	uint32_t ReadU32(const uint8_t* p)
+	{
+		return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+
+	void WriteU32(std::vector<uint8_t>& out, uint32_t value)
+	{
+		for (int i = 0; i < 4; ++i)
+			out.push_back((uint8_t)(value >> (8 * i)));
+	}
+
+	uint8_t ClampByte(float value)
+	{
+		if (value <= 0.0f)
+			return 0;
+		if (value >= 255.0f)
+			return 255;
+		return (uint8_t)(value + 0.5f);
+	}
+
+	//-----------------------------------------------------------------------------
+	// Block encoding
+	//-----------------------------------------------------------------------------
+
+	// Mean and principal axis of pixels[count][4].  Only the first channels
+	// channels take part; the axis is found by power iteration on the covariance.
+	void PrincipalAxis(const float (*pixels)[4], int count, int channels, float mean[4], float axis[4])
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			mean[c] = 0.0f;
+			axis[c] = 0.0f;
+		}
+
+		for (int i = 0; i < count; ++i)
+			for (int c = 0; c < channels; ++c)
+				mean[c] += pixels[i][c];
+		for (int c = 0; c < channels; ++c)
+			mean[c] /= (float)count;
+
+		float cov[4][4] = {};
+		for (int i = 0; i < count; ++i)
+		{
+			float d[4] = {};
+			for (int c = 0; c < channels; ++c)
+				d[c] = pixels[i][c] - mean[c];
+			for (int r = 0; r < channels; ++r)
+				for (int c = 0; c < channels; ++c)
+					cov[r][c] += d[r] * d[c];
+		}
+
+		// Start from the covariance row of the widest channel, which already points
+		// along the line; the bounding box diagonal can be orthogonal to it.
+		int widest = 0;
+		for (int c = 1; c < channels; ++c)
+		{
+			if (cov[c][c] > cov[widest][widest])
+				widest = c;
+		}
+
+		float v[4] = {};
+		for (int c = 0; c < channels; ++c)
+			v[c] = cov[widest][c];
+
+		for (int iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = {};
+			for (int r = 0; r < channels; ++r)
+				for (int c = 0; c < channels; ++c)
+					next[r] += cov[r][c] * v[c];
+
+			float lengthSq = 0.0f;
+			for (int c = 0; c < channels; ++c)
+				lengthSq += next[c] * next[c];
+			if (lengthSq < 1e-12f)
+				break;
+
+			float invLength = 1.0f / sqrtf(lengthSq);
+			for (int c = 0; c < channels; ++c)
+				v[c] = next[c] * invLength;
+		}
+
+		float lengthSq = 0.0f;
+		for (int c = 0; c < channels; ++c)
+			lengthSq += v[c] * v[c];
+		if (lengthSq > 0.0f)
+		{
+			float invLength = 1.0f / sqrtf(lengthSq);
+			for (int c = 0; c < channels; ++c)
+				axis[c] = v[c] * invLength;
+		}
+	}
+
+	// Endpoints at the extremes of the pixels' projection onto the principal axis.
+	void FitEndpoints(const float (*pixels)[4], int count, int channels, float e0[4], float e1[4])
+	{
+		float mean[4], axis[4];
+		PrincipalAxis(pixels, count, channels, mean, axis);
+
+		float minT = FLT_MAX;
+		float maxT = -FLT_MAX;
+		for (int i = 0; i < count; ++i)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < channels; ++c)
+				t += (pixels[i][c] - mean[c]) * axis[c];
+			minT = MathHelper::Min(minT, t);
+			maxT = MathHelper::Max(maxT, t);
+		}
+
+		for (int c = 0; c < 4; ++c)
+		{
+			e0[c] = MathHelper::Clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+			e1[c] = MathHelper::Clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+		}
+	}
+
+	// Least-squares endpoints for fixed interpolation weights (the weight of e1 per
+	// pixel).  Returns false if the weights do not determine both endpoints.
+	bool RefineEndpoints(const float (*pixels)[4], const float* weights, int count, int channels,
+		float e0[4], float e1[4])
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[4] = {}, bx[4] = {};
+		for (int i = 0; i < count; ++i)
+		{
+			float b = weights[i];
+			float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < channels; ++c)
+			{
+				ax[c] += a * pixels[i][c];
+				bx[c] += b * pixels[i][c];
+			}
+		}
+
+		float det = aa * bb - ab * ab;
+		if (fabsf(det) < 1e-6f)
+			return false;
+
+		float invDet = 1.0f / det;
+		for (int c = 0; c < channels; ++c)
+		{
+			e0[c] = MathHelper::Clamp((ax[c] * bb - bx[c] * ab) * invDet, 0.0f, 255.0f);
+			e1[c] = MathHelper::Clamp((bx[c] * aa - ax[c] * ab) * invDet, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	uint16_t Pack565(const float color[4])
+	{
+		int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+		int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+		int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	void Unpack565(uint16_t packed, int rgb[3])
+	{
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	// The four entries of a BC1 palette.  c0 > c1 selects four colors, otherwise
+	// three colors and transparent black.
+	void Bc1Palette(uint16_t c0, uint16_t c1, int palette[4][3])
+	{
+		Unpack565(c0, palette[0]);
+		Unpack565(c1, palette[1]);
+		for (int c = 0; c < 3; ++c)
+		{
+			if (c0 > c1)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			else
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+	}
+
+	struct Bc1Candidate
+	{
+		uint16_t C0 = 0;
+		uint16_t C1 = 0;
+		uint32_t Indices = 0;
+		float Error = FLT_MAX;
+	};
+
+	// Orders the endpoints for the wanted mode and picks the nearest entry per pixel.
+	Bc1Candidate EvaluateBc1(const float (*pixels)[4], const bool* transparent,
+		const float e0[4], const float e1[4], bool threeColor)
+	{
+		Bc1Candidate candidate;
+		candidate.C0 = Pack565(e0);
+		candidate.C1 = Pack565(e1);
+		if (threeColor ? candidate.C0 > candidate.C1 : candidate.C0 < candidate.C1)
+			std::swap(candidate.C0, candidate.C1);
+
+		int palette[4][3];
+		Bc1Palette(candidate.C0, candidate.C1, palette);
+		const int colorCount = candidate.C0 > candidate.C1 ? 4 : 3;
+
+		candidate.Error = 0.0f;
+		for (int i = 0; i < 16; ++i)
+		{
+			uint32_t index = 3;
+			if (!transparent[i])
+			{
+				float best = FLT_MAX;
+				for (int p = 0; p < colorCount; ++p)
+				{
+					float dr = pixels[i][0] - palette[p][0];
+					float dg = pixels[i][1] - palette[p][1];
+					float db = pixels[i][2] - palette[p][2];
+					float error = dr * dr + dg * dg + db * db;
+					if (error < best)
+					{
+						best = error;
+						index = (uint32_t)p;
+					}
+				}
+				candidate.Error += best;
+			}
+			candidate.Indices |= index << (2 * i);
+		}
+		return candidate;
+	}
+
+	void EncodeColorBlock(const uint8_t rgba[64], uint8_t* block, bool allowTransparent)
+	{
+		float pixels[16][4];
+		float opaque[16][4];
+		bool transparent[16];
+		int opaqueCount = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int c = 0; c < 4; ++c)
+				pixels[i][c] = (float)rgba[4 * i + c];
+
+			transparent[i] = allowTransparent && rgba[4 * i + 3] < 128;
+			if (!transparent[i])
+			{
+				for (int c = 0; c < 4; ++c)
+					opaque[opaqueCount][c] = pixels[i][c];
+				++opaqueCount;
+			}
+		}
+
+		Bc1Candidate best;
+		if (opaqueCount == 0)
+		{
+			// c0 == c1 selects the three-color mode; index 3 is transparent.
+			best.C0 = best.C1 = 0;
+			best.Indices = 0xFFFFFFFF;
+		}
+		else
+		{
+			const bool threeColor = opaqueCount < 16;
+
+			float e0[4], e1[4];
+			FitEndpoints(opaque, opaqueCount, 3, e0, e1);
+			best = EvaluateBc1(pixels, transparent, e0, e1, threeColor);
+
+			// A couple of least-squares passes over the chosen indices.
+			for (int iteration = 0; iteration < 2 && best.Error > 0.0f; ++iteration)
+			{
+				const bool fourColor = best.C0 > best.C1;
+				float weights[16];
+				float fitted[16][4];
+				int fittedCount = 0;
+				for (int i = 0; i < 16; ++i)
+				{
+					uint32_t index = (best.Indices >> (2 * i)) & 3;
+					if (transparent[i])
+						continue;
+
+					static const float fourColorWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+					static const float threeColorWeights[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+					weights[fittedCount] = fourColor ? fourColorWeights[index] : threeColorWeights[index];
+					for (int c = 0; c < 4; ++c)
+						fitted[fittedCount][c] = pixels[i][c];
+					++fittedCount;
+				}
+
+				int p0[3], p1[3];
+				Unpack565(best.C0, p0);
+				Unpack565(best.C1, p1);
+				for (int c = 0; c < 3; ++c)
+				{
+					e0[c] = (float)p0[c];
+					e1[c] = (float)p1[c];
+				}
+
+				if (!RefineEndpoints(fitted, weights, fittedCount, 3, e0, e1))
+					break;
+
+				Bc1Candidate refined = EvaluateBc1(pixels, transparent, e0, e1, threeColor);
+				if (refined.Error >= best.Error)
+					break;
+				best = refined;
+			}
+		}
+
+		block[0] = (uint8_t)(best.C0 & 0xFF);
+		block[1] = (uint8_t)(best.C0 >> 8);
+		block[2] = (uint8_t)(best.C1 & 0xFF);
+		block[3] = (uint8_t)(best.C1 >> 8);
+		for (int i = 0; i < 4; ++i)
+			block[4 + i] = (uint8_t)(best.Indices >> (8 * i));
+	}
+
+	// BC4-style alpha: two 8-bit endpoints and 3-bit indices.  Both the 8-value mode
+	// and the 6-value mode with exact 0 and 255 are tried.
+	void EncodeAlphaBlock(const uint8_t rgba[64], uint8_t* block)
+	{
+		int alpha[16];
+		int minA = 255, maxA = 0;
+		int minInner = 255, maxInner = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			alpha[i] = rgba[4 * i + 3];
+			minA = MathHelper::Min(minA, alpha[i]);
+			maxA = MathHelper::Max(maxA, alpha[i]);
+			if (alpha[i] != 0 && alpha[i] != 255)
+			{
+				minInner = MathHelper::Min(minInner, alpha[i]);
+				maxInner = MathHelper::Max(maxInner, alpha[i]);
+			}
+		}
+
+		uint64_t bestBits = 0;
+		int bestError = INT_MAX;
+		int bestA0 = maxA, bestA1 = minA;
+
+		for (int mode = 0; mode < 2; ++mode)
+		{
+			int a0, a1;
+			int palette[8];
+			if (mode == 0)
+			{
+				// a0 > a1: six interpolated values.
+				a0 = maxA;
+				a1 = minA;
+				if (a0 == a1)
+				{
+					bestBits = 0;
+					bestError = 0;
+					bestA0 = a0;
+					bestA1 = a1;
+					break;
+				}
+				palette[0] = a0;
+				palette[1] = a1;
+				for (int i = 1; i < 7; ++i)
+					palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+			}
+			else
+			{
+				// a0 <= a1: four interpolated values plus exact 0 and 255.
+				if (minInner > maxInner)
+				{
+					minInner = maxInner = minA;
+				}
+				a0 = minInner;
+				a1 = maxInner;
+				palette[0] = a0;
+				palette[1] = a1;
+				for (int i = 1; i < 5; ++i)
+					palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+				palette[6] = 0;
+				palette[7] = 255;
+			}
+
+			uint64_t bits = 0;
+			int error = 0;
+			for (int i = 0; i < 16; ++i)
+			{
+				int bestIndex = 0;
+				int bestDiff = INT_MAX;
+				for (int p = 0; p < 8; ++p)
+				{
+					int diff = abs(alpha[i] - palette[p]);
+					if (diff < bestDiff)
+					{
+						bestDiff = diff;
+						bestIndex = p;
+					}
+				}
+				error += bestDiff * bestDiff;
+				bits |= (uint64_t)bestIndex << (3 * i);
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				bestBits = bits;
+				bestA0 = a0;
+				bestA1 = a1;
+			}
+		}
+
+		block[0] = (uint8_t)bestA0;
+		block[1] = (uint8_t)bestA1;
+		for (int i = 0; i < 6; ++i)
+			block[2 + i] = (uint8_t)(bestBits >> (8 * i));
+	}
+
+	// BC7 mode 6: one subset, RGBA endpoints with 7 bits per channel plus a shared
+	// low bit per endpoint, and 4-bit indices.
+	const int kBc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct Bc7Endpoint
+	{
+		int Q[4] = {};  // 7-bit
+		int P = 0;      // shared low bit
+		int Value(int c)const { return (Q[c] << 1) | P; }
+	};
+
+	Bc7Endpoint QuantizeBc7(const float e[4])
+	{
+		Bc7Endpoint best;
+		float bestError = FLT_MAX;
+		for (int p = 0; p < 2; ++p)
+		{
+			Bc7Endpoint candidate;
+			candidate.P = p;
+			float error = 0.0f;
+			for (int c = 0; c < 4; ++c)
+			{
+				int q = (int)((e[c] - p) * 0.5f + 0.5f);
+				candidate.Q[c] = MathHelper::Clamp(q, 0, 127);
+				float d = (float)candidate.Value(c) - e[c];
+				error += d * d;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				best = candidate;
+			}
+		}
+		return best;
+	}
+
+	struct Bc7Candidate
+	{
+		Bc7Endpoint E0, E1;
+		int Indices[16] = {};
+		float Error = FLT_MAX;
+	};
+
+	Bc7Candidate EvaluateBc7(const float (*pixels)[4], const float e0[4], const float e1[4])
+	{
+		Bc7Candidate candidate;
+		candidate.E0 = QuantizeBc7(e0);
+		candidate.E1 = QuantizeBc7(e1);
+
+		int palette[16][4];
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				int a = candidate.E0.Value(c);
+				int b = candidate.E1.Value(c);
+				palette[i][c] = ((64 - kBc7Weights4[i]) * a + kBc7Weights4[i] * b + 32) >> 6;
+			}
+		}
+
+		candidate.Error = 0.0f;
+		for (int i = 0; i < 16; ++i)
+		{
+			float best = FLT_MAX;
+			for (int p = 0; p < 16; ++p)
+			{
+				float error = 0.0f;
+				for (int c = 0; c < 4; ++c)
+				{
+					float d = pixels[i][c] - palette[p][c];
+					error += d * d;
+				}
+				if (error < best)
+				{
+					best = error;
+					candidate.Indices[i] = p;
+				}
+			}
+			candidate.Error += best;
+		}
+		return candidate;
+	}
+
+	struct BitWriter
+	{
+		uint8_t* Bytes;
+		UINT Position = 0;
+
+		void Write(uint32_t value, UINT bitCount)
+		{
+			for (UINT i = 0; i < bitCount; ++i, ++Position)
+			{
+				if ((value >> i) & 1)
+					Bytes[Position >> 3] |= (uint8_t)(1 << (Position & 7));
+			}
+		}
+	};
+
+	void EncodeBc7Block(const uint8_t rgba[64], uint8_t* block)
+	{
+		float pixels[16][4];
+		for (int i = 0; i < 16; ++i)
+			for (int c = 0; c < 4; ++c)
+				pixels[i][c] = (float)rgba[4 * i + c];
+
+		float e0[4], e1[4];
+		FitEndpoints(pixels, 16, 4, e0, e1);
+		Bc7Candidate best = EvaluateBc7(pixels, e0, e1);
+
+		for (int iteration = 0; iteration < 2 && best.Error > 0.0f; ++iteration)
+		{
+			float weights[16];
+			for (int i = 0; i < 16; ++i)
+				weights[i] = kBc7Weights4[best.Indices[i]] / 64.0f;
+
+			if (!RefineEndpoints(pixels, weights, 16, 4, e0, e1))
+				break;
+
+			Bc7Candidate refined = EvaluateBc7(pixels, e0, e1);
+			if (refined.Error >= best.Error)
+				break;
+			best = refined;
+		}
+
+		// The first index has an implicit leading zero; flip the block if needed.
+		if (best.Indices[0] >= 8)
+		{
+			std::swap(best.E0, best.E1);
+			for (int i = 0; i < 16; ++i)
+				best.Indices[i] = 15 - best.Indices[i];
+		}
+
+		memset(block, 0, 16);
+		BitWriter writer = { block };
+		writer.Write(1 << 6, 7);
+		for (int c = 0; c < 4; ++c)
+		{
+			writer.Write((uint32_t)best.E0.Q[c], 7);
+			writer.Write((uint32_t)best.E1.Q[c], 7);
+		}
+		writer.Write((uint32_t)best.E0.P, 1);
+		writer.Write((uint32_t)best.E1.P, 1);
+		writer.Write((uint32_t)best.Indices[0], 3);
+		for (int i = 1; i < 16; ++i)
+			writer.Write((uint32_t)best.Indices[i], 4);
+	}
+
+	//-----------------------------------------------------------------------------
+	// Block decoding, for DDS sources
+	//-----------------------------------------------------------------------------
+
+	void DecodeColorBlock(const uint8_t* block, uint8_t rgba[64], bool fourColorOnly)
+	{
+		uint16_t c0 = (uint16_t)(block[0] | (block[1] << 8));
+		uint16_t c1 = (uint16_t)(block[2] | (block[3] << 8));
+
+		int palette[4][3];
+		Bc1Palette(c0, c1, palette);
+		if (fourColorOnly && c0 <= c1)
+		{
+			// BC2/BC3 color blocks always interpolate four colors.
+			for (int c = 0; c < 3; ++c)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+		}
+
+		uint32_t indices = ReadU32(block + 4);
+		for (int i = 0; i < 16; ++i)
+		{
+			uint32_t index = (indices >> (2 * i)) & 3;
+			for (int c = 0; c < 3; ++c)
+				rgba[4 * i + c] = (uint8_t)palette[index][c];
+			rgba[4 * i + 3] = (!fourColorOnly && c0 <= c1 && index == 3) ? 0 : 255;
+		}
+	}
+
+	void DecodeAlphaBlock(const uint8_t* block, uint8_t rgba[64])
+	{
+		int a0 = block[0];
+		int a1 = block[1];
+		int palette[8] = { a0, a1 };
+		if (a0 > a1)
+		{
+			for (int i = 1; i < 7; ++i)
+				palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+		}
+		else
+		{
+			for (int i = 1; i < 5; ++i)
+				palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; ++i)
+			bits |= (uint64_t)block[2 + i] << (8 * i);
+		for (int i = 0; i < 16; ++i)
+			rgba[4 * i + 3] = (uint8_t)palette[(bits >> (3 * i)) & 7];
+	}
+
+	//-----------------------------------------------------------------------------
+	// Source loading
+	//-----------------------------------------------------------------------------
+
+	bool ReadFileBytes(const std::wstring& filename, std::vector<uint8_t>& bytes)
+	{
+		std::ifstream fin(filename, std::ios::binary);
+		if (!fin)
+			return false;
+
+		bytes.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+	// Only 24/32-bit uncompressed bitmaps; WIC reads a 32-bit BI_RGB bitmap as BGR
+	// and drops the alpha the tree bitmaps keep in the fourth byte.
+	bool LoadBmp(const std::vector<uint8_t>& file, Image& image)
+	{
+		if (file.size() < 54 || file[0] != 'B' || file[1] != 'M')
+			return false;
+
+		uint32_t dataOffset = ReadU32(&file[10]);
+		int width = (int)ReadU32(&file[18]);
+		int height = (int)ReadU32(&file[22]);
+		int bitCount = file[28] | (file[29] << 8);
+		uint32_t compression = ReadU32(&file[30]);
+		if (compression != 0 || (bitCount != 24 && bitCount != 32) || width <= 0 || height == 0)
+			return false;
+
+		const bool bottomUp = height > 0;
+		height = abs(height);
+		const size_t bytesPerPixel = bitCount / 8;
+		const size_t rowPitch = (width * bytesPerPixel + 3) & ~(size_t)3;
+		if (dataOffset + rowPitch * height > file.size())
+			return false;
+
+		image.Width = (UINT)width;
+		image.Height = (UINT)height;
+		image.Rgba.resize((size_t)width * height * 4);
+
+		bool anyAlpha = false;
+		for (int y = 0; y < height; ++y)
+		{
+			const uint8_t* src = &file[dataOffset + rowPitch * (bottomUp ? height - 1 - y : y)];
+			uint8_t* dst = &image.Rgba[(size_t)y * width * 4];
+			for (int x = 0; x < width; ++x, src += bytesPerPixel, dst += 4)
+			{
+				dst[0] = src[2];
+				dst[1] = src[1];
+				dst[2] = src[0];
+				dst[3] = bytesPerPixel == 4 ? src[3] : 255;
+				anyAlpha = anyAlpha || dst[3] != 0;
+			}
+		}
+
+		// An all-zero fourth byte is padding, not a fully transparent image.
+		if (!anyAlpha)
+		{
+			for (size_t i = 3; i < image.Rgba.size(); i += 4)
+				image.Rgba[i] = 255;
+		}
+		return true;
+	}
+
+	// The top level of the first slice of a DXT1/3/5 or 32/24-bit DDS file.
+	HRESULT LoadDds(const std::vector<uint8_t>& file, Image& image)
+	{
+		if (file.size() < 128 || ReadU32(&file[0]) != 0x20534444) // "DDS "
+			return HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+
+		const uint32_t height = ReadU32(&file[12]);
+		const uint32_t width = ReadU32(&file[16]);
+		const uint32_t pfFlags = ReadU32(&file[80]);
+		const uint32_t fourCC = ReadU32(&file[84]);
+		const uint32_t bitCount = ReadU32(&file[88]);
+		const uint32_t masks[4] = { ReadU32(&file[92]), ReadU32(&file[96]), ReadU32(&file[100]), ReadU32(&file[104]) };
+		const uint32_t caps2 = ReadU32(&file[112]);
+		if (caps2 & 0x200) // cube map
+			return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+		size_t offset = 128;
+		enum { Rgb, Bc1, Bc2, Bc3 } layout = Rgb;
+		bool bgra = false;
+		bool hasAlpha = (pfFlags & 0x1) != 0;
+		UINT bytesPerPixel = bitCount / 8;
+
+		if (pfFlags & 0x4) // DDPF_FOURCC
+		{
+			if (fourCC == 0x31545844)      // DXT1
+				layout = Bc1;
+			else if (fourCC == 0x33545844) // DXT3
+				layout = Bc2;
+			else if (fourCC == 0x35545844) // DXT5
+				layout = Bc3;
+			else if (fourCC == 0x30315844 && file.size() >= 148) // DX10
+			{
+				offset = 148;
+				switch (ReadU32(&file[128]))
+				{
+				case DXGI_FORMAT_BC1_UNORM: case DXGI_FORMAT_BC1_UNORM_SRGB: layout = Bc1; break;
+				case DXGI_FORMAT_BC2_UNORM: case DXGI_FORMAT_BC2_UNORM_SRGB: layout = Bc2; break;
+				case DXGI_FORMAT_BC3_UNORM: case DXGI_FORMAT_BC3_UNORM_SRGB: layout = Bc3; break;
+				case DXGI_FORMAT_R8G8B8A8_UNORM: case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+					bytesPerPixel = 4;
+					hasAlpha = true;
+					break;
+				case DXGI_FORMAT_B8G8R8A8_UNORM: case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+					bytesPerPixel = 4;
+					hasAlpha = true;
+					bgra = true;
+					break;
+				default:
+					return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+				}
+			}
+			else
+				return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+		}
+		else if ((pfFlags & 0x40) && (bitCount == 32 || bitCount == 24)) // DDPF_RGB
+		{
+			// Only the byte orders the DDS writers actually produce.
+			bgra = masks[0] == 0x00FF0000;
+			if (!bgra && masks[0] != 0x000000FF)
+				return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+		}
+		else
+			return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+		image.Width = width;
+		image.Height = height;
+		image.Rgba.assign((size_t)width * height * 4, 255);
+
+		if (layout == Rgb)
+		{
+			if (offset + (size_t)width * height * bytesPerPixel > file.size())
+				return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+
+			const uint8_t* src = &file[offset];
+			for (size_t i = 0; i < (size_t)width * height; ++i, src += bytesPerPixel)
+			{
+				uint8_t* dst = &image.Rgba[4 * i];
+				dst[0] = bgra ? src[2] : src[0];
+				dst[1] = src[1];
+				dst[2] = bgra ? src[0] : src[2];
+				dst[3] = (hasAlpha && bytesPerPixel == 4) ? src[3] : 255;
+			}
+			return S_OK;
+		}
+
+		const UINT blocksX = MathHelper::Max(1u, (width + 3) / 4);
+		const UINT blocksY = MathHelper::Max(1u, (height + 3) / 4);
+		const size_t blockBytes = layout == Bc1 ? 8 : 16;
+		if (offset + blocksX * blocksY * blockBytes > file.size())
+			return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+
+		for (UINT by = 0; by < blocksY; ++by)
+		{
+			for (UINT bx = 0; bx < blocksX; ++bx)
+			{
+				const uint8_t* block = &file[offset + (by * blocksX + bx) * blockBytes];
+				uint8_t pixels[64];
+				if (layout == Bc1)
+				{
+					DecodeColorBlock(block, pixels, false);
+				}
+				else
+				{
+					DecodeColorBlock(block + 8, pixels, true);
+					if (layout == Bc3)
+					{
+						DecodeAlphaBlock(block, pixels);
+					}
+					else
+					{
+						for (int i = 0; i < 16; ++i)
+						{
+							int a = (block[i / 2] >> (4 * (i & 1))) & 15;
+							pixels[4 * i + 3] = (uint8_t)(a * 17);
+						}
+					}
+				}
+
+				for (UINT y = 0; y < 4 && by * 4 + y < height; ++y)
+				{
+					for (UINT x = 0; x < 4 && bx * 4 + x < width; ++x)
+					{
+						memcpy(&image.Rgba[((size_t)(by * 4 + y) * width + bx * 4 + x) * 4],
+							&pixels[(y * 4 + x) * 4], 4);
+					}
+				}
+			}
+		}
+		return S_OK;
+	}
+
+	// Initializes COM for the calling thread if nobody has yet.
+	struct ComScope
+	{
+		HRESULT Result = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+		~ComScope()
+		{
+			if (SUCCEEDED(Result))
+				CoUninitialize();
+		}
+	};
+
+	HRESULT LoadWic(const std::wstring& filename, Image& image)
+	{
+		// RPC_E_CHANGED_MODE only means the thread already runs COM as an STA.
+		ComScope com;
+		if (FAILED(com.Result) && com.Result != RPC_E_CHANGED_MODE)
+			return com.Result;
+
+		ComPtr<IWICImagingFactory> factory;
+		HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
+			IID_PPV_ARGS(factory.GetAddressOf()));
+		if (FAILED(hr))
+			return hr;
+
+		ComPtr<IWICBitmapDecoder> decoder;
+		hr = factory->CreateDecoderFromFilename(filename.c_str(), nullptr, GENERIC_READ,
+			WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf());
+		if (FAILED(hr))
+			return hr;
+
+		ComPtr<IWICBitmapFrameDecode> frame;
+		hr = decoder->GetFrame(0, frame.GetAddressOf());
+		if (FAILED(hr))
+			return hr;
+
+		ComPtr<IWICFormatConverter> converter;
+		hr = factory->CreateFormatConverter(converter.GetAddressOf());
+		if (FAILED(hr))
+			return hr;
+
+		hr = converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA,
+			WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom);
+		if (FAILED(hr))
+			return hr;
+
+		hr = converter->GetSize(&image.Width, &image.Height);
+		if (FAILED(hr))
+			return hr;
+
+		image.Rgba.resize((size_t)image.Width * image.Height * 4);
+		return converter->CopyPixels(nullptr, image.Width * 4, (UINT)image.Rgba.size(), image.Rgba.data());
+	}
+
+	Image LoadSource(const std::wstring& filename)
+	{
+		std::wstring extension;
+		size_t dot = filename.find_last_of(L'.');
+		if (dot != std::wstring::npos)
+			extension = filename.substr(dot);
+		for (auto& ch : extension)
+			ch = towlower(ch);
+
+		Image image;
+		HRESULT hr = S_OK;
+		if (extension == L".dds" || extension == L".bmp")
+		{
+			std::vector<uint8_t> file;
+			if (!ReadFileBytes(filename, file))
+				ThrowSourceError(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND), filename);
+
+			if (extension == L".dds")
+				hr = LoadDds(file, image);
+			else if (!LoadBmp(file, image))
+				hr = LoadWic(filename, image);
+		}
+		else
+		{
+			hr = LoadWic(filename, image);
+		}
+
+		if (FAILED(hr))
+			ThrowSourceError(hr, filename);
+		return image;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Mips and output
+	//-----------------------------------------------------------------------------
+
+	float SrgbToLinear(uint8_t value)
+	{
+		static const std::vector<float> table = []()
+		{
+			std::vector<float> t(256);
+			for (int i = 0; i < 256; ++i)
+			{
+				float c = i / 255.0f;
+				t[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+			}
+			return t;
+		}();
+		return table[value];
+	}
+
+	uint8_t LinearToSrgb(float value)
+	{
+		float c = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+		return ClampByte(c * 255.0f);
+	}
+
+	// 2x2 box filter; a level with an odd size repeats its last row/column.
+	Image Downsample(const Image& src, bool srgb)
+	{
+		Image dst;
+		dst.Width = MathHelper::Max(1u, src.Width / 2);
+		dst.Height = MathHelper::Max(1u, src.Height / 2);
+		dst.Rgba.resize((size_t)dst.Width * dst.Height * 4);
+
+		concurrency::parallel_for(0u, dst.Height, [&](UINT y)
+		{
+			UINT y0 = MathHelper::Min(2 * y, src.Height - 1);
+			UINT y1 = MathHelper::Min(2 * y + 1, src.Height - 1);
+			for (UINT x = 0; x < dst.Width; ++x)
+			{
+				UINT x0 = MathHelper::Min(2 * x, src.Width - 1);
+				UINT x1 = MathHelper::Min(2 * x + 1, src.Width - 1);
+				const uint8_t* p[4] =
+				{
+					&src.Rgba[((size_t)y0 * src.Width + x0) * 4],
+					&src.Rgba[((size_t)y0 * src.Width + x1) * 4],
+					&src.Rgba[((size_t)y1 * src.Width + x0) * 4],
+					&src.Rgba[((size_t)y1 * src.Width + x1) * 4]
+				};
+
+				uint8_t* out = &dst.Rgba[((size_t)y * dst.Width + x) * 4];
+				for (int c = 0; c < 4; ++c)
+				{
+					if (srgb && c < 3)
+					{
+						float sum = SrgbToLinear(p[0][c]) + SrgbToLinear(p[1][c]) +
+							SrgbToLinear(p[2][c]) + SrgbToLinear(p[3][c]);
+						out[c] = LinearToSrgb(0.25f * sum);
+					}
+					else
+					{
+						out[c] = (uint8_t)((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4);
+					}
+				}
+			}
+		});
+
+		return dst;
+	}
+
+	void CompressImage(const Image& image, TextureCompression compression, std::vector<uint8_t>& out)
+	{
+		const UINT blocksX = MathHelper::Max(1u, (image.Width + 3) / 4);
+		const UINT blocksY = MathHelper::Max(1u, (image.Height + 3) / 4);
+		const size_t blockBytes = compression == TextureCompression::BC1 ? 8 : 16;
+
+		const size_t offset = out.size();
+		out.resize(offset + blocksX * blocksY * blockBytes);
+		uint8_t* blocks = &out[offset];
+
+		concurrency::parallel_for(0u, blocksY, [&](UINT by)
+		{
+			uint8_t pixels[64];
+			for (UINT bx = 0; bx < blocksX; ++bx)
+			{
+				// Blocks over the edge of a small level repeat the edge pixels.
+				for (UINT y = 0; y < 4; ++y)
+				{
+					UINT sy = MathHelper::Min(by * 4 + y, image.Height - 1);
+					for (UINT x = 0; x < 4; ++x)
+					{
+						UINT sx = MathHelper::Min(bx * 4 + x, image.Width - 1);
+						memcpy(&pixels[(y * 4 + x) * 4], &image.Rgba[((size_t)sy * image.Width + sx) * 4], 4);
+					}
+				}
+
+				uint8_t* block = blocks + (by * blocksX + bx) * blockBytes;
+				switch (compression)
+				{
+				case TextureCompression::BC1: TextureConverter::EncodeBC1(pixels, block); break;
+				case TextureCompression::BC3: TextureConverter::EncodeBC3(pixels, block); break;
+				case TextureCompression::BC7: TextureConverter::EncodeBC7(pixels, block); break;
+				}
+			}
+		});
+	}
+
+	DXGI_FORMAT OutputFormat(const TextureConvertDesc& desc)
+	{
+		switch (desc.Compression)
+		{
+		case TextureCompression::BC1: return desc.SRGB ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+		case TextureCompression::BC3: return desc.SRGB ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+		default:                      return desc.SRGB ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+		}
+	}
+
+	// DDS header with the DX10 extension, which every format here can be described by.
+	void WriteDdsHeader(std::vector<uint8_t>& out, UINT width, UINT height, UINT mipCount,
+		UINT arraySize, DXGI_FORMAT format, uint32_t topLevelSize)
+	{
+		WriteU32(out, 0x20534444); // "DDS "
+
+		WriteU32(out, 124);                                   // size
+		WriteU32(out, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000); // caps, height, width, pixel format, mip count, linear size
+		WriteU32(out, height);
+		WriteU32(out, width);
+		WriteU32(out, topLevelSize);
+		WriteU32(out, 0);                                     // depth
+		WriteU32(out, mipCount);
+		for (int i = 0; i < 11; ++i)
+			WriteU32(out, 0);
+
+		WriteU32(out, 32);                                    // pixel format size
+		WriteU32(out, 0x4);                                   // DDPF_FOURCC
+		WriteU32(out, 0x30315844);                            // "DX10"
+		for (int i = 0; i < 5; ++i)
+			WriteU32(out, 0);
+
+		uint32_t caps = 0x1000;                               // DDSCAPS_TEXTURE
+		if (mipCount > 1)
+			caps |= 0x8 | 0x400000;                           // complex, mipmap
+		WriteU32(out, caps);
+		for (int i = 0; i < 4; ++i)
+			WriteU32(out, 0);
+
+		WriteU32(out, (uint32_t)format);
+		WriteU32(out, D3D12_RESOURCE_DIMENSION_TEXTURE2D);
+		WriteU32(out, 0);                                     // misc flags
+		WriteU32(out, arraySize);
+		WriteU32(out, 0);                                     // alpha mode unknown
+	}
+
+	bool IsCompressed(DXGI_FORMAT format)
+	{
+		return (format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM) ||
+			(format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+	}
+}
+
+void TextureConverter::Convert(const std::vector<std::wstring>& sourceFiles,
+	const std::wstring& ddsFile, const TextureConvertDesc& desc)
+{
+	if (sourceFiles.empty())
+		ThrowSourceError(E_INVALIDARG, ddsFile);
+
+	std::vector<Image> slices;
+	for (const auto& source : sourceFiles)
+	{
+		slices.push_back(LoadSource(source));
+
+		// D3D12 wants block compressed top levels in whole blocks.
+		const Image& image = slices.back();
+		if (image.Width % 4 != 0 || image.Height % 4 != 0 ||
+			image.Width != slices[0].Width || image.Height != slices[0].Height)
+			ThrowSourceError(E_INVALIDARG, source);
+	}
+
+	const UINT width = slices[0].Width;
+	const UINT height = slices[0].Height;
+
+	UINT mipCount = 1;
+	if (desc.GenerateMips)
+	{
+		while ((MathHelper::Max(width, height) >> mipCount) > 0)
+			++mipCount;
+	}
+
+	std::vector<uint8_t> data;
+	for (auto& slice : slices)
+	{
+		Image level = std::move(slice);
+		for (UINT mip = 0; mip < mipCount; ++mip)
+		{
+			CompressImage(level, desc.Compression, data);
+			if (mip + 1 < mipCount)
+				level = Downsample(level, desc.SRGB);
+		}
+	}
+
+	const size_t blockBytes = desc.Compression == TextureCompression::BC1 ? 8 : 16;
+	std::vector<uint8_t> file;
+	WriteDdsHeader(file, width, height, mipCount, (UINT)slices.size(), OutputFormat(desc),
+		(uint32_t)((width / 4) * (height / 4) * blockBytes));
+	file.insert(file.end(), data.begin(), data.end());
+
+	// Written under a temporary name first so an interrupted run leaves no
+	// truncated file for ConvertCached() to pick up.
+	std::wstring tempFile = ddsFile + L".tmp";
+	{
+		std::ofstream fout(tempFile, std::ios::binary | std::ios::trunc);
+		fout.write(reinterpret_cast<const char*>(file.data()), file.size());
+		if (!fout)
+			ThrowSourceError(HRESULT_FROM_WIN32(ERROR_WRITE_FAULT), ddsFile);
+	}
+
+	if (!MoveFileExW(tempFile.c_str(), ddsFile.c_str(), MOVEFILE_REPLACE_EXISTING))
+		ThrowSourceError(HRESULT_FROM_WIN32(GetLastError()), ddsFile);
+}
+
+std::wstring TextureConverter::ConvertCached(const std::wstring& sourceFile, const TextureConvertDesc& desc)
+{
+	size_t nameStart = sourceFile.find_last_of(L"/\\");
+	std::wstring name = sourceFile.substr(nameStart == std::wstring::npos ? 0 : nameStart + 1);
+	size_t dot = name.find_last_of(L'.');
+	if (dot != std::wstring::npos)
+		name.resize(dot);
+
+	return ConvertCached(std::vector<std::wstring>{ sourceFile }, name, desc);
+}
+
+std::wstring TextureConverter::ConvertCached(const std::vector<std::wstring>& sourceFiles,
+	const std::wstring& name, const TextureConvertDesc& desc)
+{
+	// The settings are part of the name, so every variant of a source has its own entry.
+	static const wchar_t* const compressionNames[] = { L"bc1", L"bc3", L"bc7" };
+	std::wstring ddsFile = gTextureCacheDirectory + L"/" + name + L"." +
+		compressionNames[(int)desc.Compression] +
+		(desc.SRGB ? L"_srgb" : L"") +
+		(desc.GenerateMips ? L"" : L"_nomips") + L".dds";
+
+	// A cache shipped without its sources stays usable.
+	WIN32_FILE_ATTRIBUTE_DATA ddsInfo;
+	bool upToDate = GetFileAttributesExW(ddsFile.c_str(), GetFileExInfoStandard, &ddsInfo) != 0;
+	for (const auto& source : sourceFiles)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA sourceInfo;
+		if (upToDate && GetFileAttributesExW(source.c_str(), GetFileExInfoStandard, &sourceInfo) &&
+			CompareFileTime(&ddsInfo.ftLastWriteTime, &sourceInfo.ftLastWriteTime) < 0)
+			upToDate = false;
+	}
+	if (upToDate)
+		return ddsFile;
+
+	CreateDirectoryW(gTextureCacheDirectory.c_str(), nullptr);
+	Convert(sourceFiles, ddsFile, desc);
+
+	std::wstring text = L"TextureConverter: " + sourceFiles[0] +
+		(sourceFiles.size() > 1 ? L", ..." : L"") + L" -> " + ddsFile + L"\n";
+	OutputDebugStringW(text.c_str());
+
+	return ddsFile;
+}
+
+void TextureConverter::SetCacheDirectory(const std::wstring& directory)
+{
+	gTextureCacheDirectory = directory;
+}
+
+bool TextureConverter::Validate(const Texture& texture)
+{
+	if (texture.Resource == nullptr)
+		return true;
+
+	D3D12_RESOURCE_DESC desc = texture.Resource->GetDesc();
+
+	// Nothing is gained on a texture smaller than one block.
+	if (desc.Width < 4 || desc.Height < 4)
+		return true;
+
+	bool compressed = IsCompressed(desc.Format);
+	bool mipless = desc.MipLevels == 1;
+	if (compressed && !mipless)
+		return true;
+
+	std::wstring text = L"Texture warning: " + AnsiToWString(texture.Name) + L" (" + texture.Filename + L")";
+	if (!compressed)
+		text += L" is not block compressed (DXGI format " + std::to_wstring(desc.Format) + L")";
+	if (!compressed && mipless)
+		text += L" and";
+	if (mipless)
+		text += L" has no mip chain";
+	text += L"; rebuild it with TextureConverter.\n";
+	OutputDebugStringW(text.c_str());
+
+	return false;
+}
+
+void TextureConverter::EncodeBC1(const uint8_t rgba[64], uint8_t* block)
+{
+	EncodeColorBlock(rgba, block, true);
+}
+
+void TextureConverter::EncodeBC3(const uint8_t rgba[64], uint8_t* block)
+{
+	EncodeAlphaBlock(rgba, block);
+	EncodeColorBlock(rgba, block + 8, false);
+}
+
+void TextureConverter::EncodeBC7(const uint8_t rgba[64], uint8_t* block)
+{
+	EncodeBc7Block(rgba, block);
+}
@@ -0,0 +1,76 @@
+//***************************************************************************************
+// TextureConverter.h
+//
+// Turns source images into the textures the demos should sample: block compressed
+// and with a full mip chain, so they take a fraction of the memory and a minified
+// surface reads a few cache lines instead of striding across the top level.
+//
+// Sources can be anything WIC decodes (png, jpg, tiff, ...), 24/32-bit BMPs, and
+// DDS files in DXT1/DXT3/DXT5 or 32-bit RGBA, so the repo's mipless and
+// uncompressed DDS files can be rebuilt as well.  Only the top level of a DDS
+// source is used; the mips are regenerated with a box filter (in linear space for
+// sRGB data).  Several sources of one size become the slices of a texture array.
+//
+//   BC1  RGB, 4 bpp.  Pixels with alpha < 128 use the 1-bit transparent index.
+//   BC3  RGB + smooth alpha, 8 bpp.
+//   BC7  RGBA, 8 bpp, mode 6 only: much less banding than BC1/BC3, but one color
+//        line per block, so cutout alpha over a color gradient is better in BC3.
+//
+// ConvertCached() is meant for first run: it converts into a cache directory next
+// to the working directory and only converts again when the source is newer.
+// Validate() is called after loading a texture and warns, in the debugger output,
+// about textures that could use this.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+enum class TextureCompression
+{
+	BC1,
+	BC3,
+	BC7
+};
+
+struct TextureConvertDesc
+{
+	TextureCompression Compression = TextureCompression::BC7;
+
+	// Color textures are usually sRGB; normal, height and mask maps are not.
+	bool SRGB = false;
+
+	bool GenerateMips = true;
+};
+
+class TextureConverter
+{
+public:
+	// Writes ddsFile from the sources, which become the array slices and must all
+	// have the same size.  Throws DxException if a source cannot be read.
+	static void Convert(const std::vector<std::wstring>& sourceFiles,
+		const std::wstring& ddsFile, const TextureConvertDesc& desc);
+
+	// Returns the converted file for sourceFile in the cache directory, converting
+	// it first if it is missing or older than the source.
+	static std::wstring ConvertCached(const std::wstring& sourceFile, const TextureConvertDesc& desc);
+
+	// The same for the slices of a texture array; name is the cache entry's name,
+	// and the array is converted again when any of the sources is newer.
+	static std::wstring ConvertCached(const std::vector<std::wstring>& sourceFiles,
+		const std::wstring& name, const TextureConvertDesc& desc);
+
+	// Directory ConvertCached() writes to, relative to the working directory.
+	// Defaults to L"TextureCache".
+	static void SetCacheDirectory(const std::wstring& directory);
+
+	// Warns about a loaded texture that is not block compressed or has no mips.
+	// Returns false if it warned.
+	static bool Validate(const Texture& texture);
+
+	// Block encoders.  rgba is a 4x4 block of 8-bit RGBA pixels, row by row; the
+	// output is 8 bytes for BC1 and 16 for BC3/BC7.
+	static void EncodeBC1(const uint8_t rgba[64], uint8_t* block);
+	static void EncodeBC3(const uint8_t rgba[64], uint8_t* block);
+	static void EncodeBC7(const uint8_t rgba[64], uint8_t* block);
+};
@@ -0,0 +1,269 @@
+//***************************************************************************************
+// TextureStreamer.cpp
+//***************************************************************************************
+
+#include "TextureStreamer.h"
+#include "DDSTextureLoader.h"
+#include "TextureConverter.h"
+
+using Microsoft::WRL::ComPtr;
+
+TextureStreamer::TextureStreamer(ID3D12Device* device) :
+	md3dDevice(device)
+{
+	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+	ThrowIfFailed(md3dDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(mCopyQueue.GetAddressOf())));
+
+	ThrowIfFailed(md3dDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(mFence.GetAddressOf())));
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// Workers and the copy queue still reference the jobs; errors no longer matter here.
+	for (auto& task : mTasks)
+	{
+		try { task.wait(); }
+		catch (...) {}
+	}
+
+	if (mFence->GetCompletedValue() < mFenceValue)
+	{
+		HANDLE eventHandle = CreateEventEx(nullptr, nullptr, false, EVENT_ALL_ACCESS);
+		mFence->SetEventOnCompletion(mFenceValue, eventHandle);
+		WaitForSingleObject(eventHandle, INFINITE);
+		CloseHandle(eventHandle);
+	}
+}
+
+void TextureStreamer::Request(Texture* texture, CD3DX12_CPU_DESCRIPTOR_HANDLE srvDescriptor,
+	std::function<void(Texture*)> onReady, std::function<void(Texture*)> onEvicted)
+{
+	auto job = std::make_shared<Job>();
+	job->Tex = texture;
+	job->SrvDescriptor = srvDescriptor;
+	job->OnReady = std::move(onReady);
+	job->OnEvicted = std::move(onEvicted);
+
+	++mPendingCount;
+	mTasks.push_back(concurrency::create_task([this, job]()
+	{
+		Load(*job);
+
+		std::lock_guard<std::mutex> lock(mSubmitMutex);
+		mSubmitted.push_back(job);
+	}));
+}
+
+void TextureStreamer::Load(Job& job)
+{
+	// Read the whole file on this worker thread.
+	std::ifstream fin(job.Tex->Filename, std::ios::binary);
+	if (!fin)
+	{
+		job.Result = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+		return;
+	}
+
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+	fin.close();
+
+	job.Result = md3dDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY,
+		IID_PPV_ARGS(job.CmdListAlloc.GetAddressOf()));
+	if (FAILED(job.Result))
+		return;
+
+	job.Result = md3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY,
+		job.CmdListAlloc.Get(), nullptr, IID_PPV_ARGS(job.CmdList.GetAddressOf()));
+	if (FAILED(job.Result))
+		return;
+
+	// Parses the DDS data and records the upload; copy lists end in COMMON.
+	job.Result = DirectX::CreateDDSTextureFromMemory12(md3dDevice, job.CmdList.Get(),
+		data.data(), data.size(), job.Resource, job.UploadHeap,
+		0, nullptr, D3D12_RESOURCE_STATE_COMMON);
+
+	HRESULT closeResult = job.CmdList->Close();
+	if (FAILED(job.Result) || FAILED(closeResult))
+	{
+		if (SUCCEEDED(job.Result))
+			job.Result = closeResult;
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mSubmitMutex);
+	ID3D12CommandList* cmdsLists[] = { job.CmdList.Get() };
+	mCopyQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	job.Fence = ++mFenceValue;
+	mCopyQueue->Signal(mFence.Get(), job.Fence);
+}
+
+UINT TextureStreamer::Update()
+{
+	// Forget the workers that have finished; their jobs are in mSubmitted.
+	mTasks.erase(std::remove_if(mTasks.begin(), mTasks.end(),
+		[](const concurrency::task<void>& task) { return task.is_done(); }), mTasks.end());
+
+	UINT64 completedFence = mFence->GetCompletedValue();
+
+	std::vector<std::shared_ptr<Job>> ready;
+	{
+		std::lock_guard<std::mutex> lock(mSubmitMutex);
+		for (size_t i = 0; i < mSubmitted.size();)
+		{
+			// Failed jobs were never submitted, so they are ready right away.
+			if (FAILED(mSubmitted[i]->Result) || mSubmitted[i]->Fence <= completedFence)
+			{
+				ready.push_back(std::move(mSubmitted[i]));
+				mSubmitted[i] = std::move(mSubmitted.back());
+				mSubmitted.pop_back();
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+
+	for (auto& job : ready)
+	{
+		--mPendingCount;
+
+		if (FAILED(job->Result))
+		{
+			throw DxException(job->Result, L"TextureStreamer::Load " + job->Tex->Filename,
+				AnsiToWString(__FILE__), __LINE__);
+		}
+
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.Format = job->Resource->GetDesc().Format;
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+		srvDesc.Texture2D.MipLevels = -1;
+		md3dDevice->CreateShaderResourceView(job->Resource.Get(), &srvDesc, job->SrvDescriptor);
+
+		// The copy is done, so the staging memory can go right away.
+		job->Tex->Resource = job->Resource;
+		job->Tex->UploadHeap = nullptr;
+		TextureConverter::Validate(*job->Tex);
+
+		D3D12_RESOURCE_DESC desc = job->Resource->GetDesc();
+		Resident& resident = mResidents[job->Tex];
+		resident.Tex = job->Tex;
+		resident.OnReady = job->OnReady;
+		resident.OnEvicted = std::move(job->OnEvicted);
+		resident.Bytes = md3dDevice->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+
+		if (job->OnReady)
+			job->OnReady(job->Tex);
+	}
+
+	return (UINT)ready.size();
+}
+
+UINT TextureStreamer::PendingCount()const
+{
+	return mPendingCount;
+}
+
+void TextureStreamer::Flush()
+{
+	for (auto& task : mTasks)
+		task.wait();
+	mTasks.clear();
+
+	if (mFence->GetCompletedValue() < mFenceValue)
+	{
+		HANDLE eventHandle = CreateEventEx(nullptr, nullptr, false, EVENT_ALL_ACCESS);
+		ThrowIfFailed(mFence->SetEventOnCompletion(mFenceValue, eventHandle));
+		WaitForSingleObject(eventHandle, INFINITE);
+		CloseHandle(eventHandle);
+	}
+
+	Update();
+}
+
+void TextureStreamer::Use(Texture* texture, UINT64 frame)
+{
+	auto it = mResidents.find(texture);
+	if (it != mResidents.end())
+		it->second.LastUse = (std::max)(it->second.LastUse, frame);
+}
+
+UINT64 TextureStreamer::Evict(UINT64 bytes, UINT64 lastCompletedFrame)
+{
+	std::vector<Resident*> candidates;
+	for (auto& entry : mResidents)
+	{
+		if (!entry.second.Evicted && entry.second.LastUse <= lastCompletedFrame)
+			candidates.push_back(&entry.second);
+	}
+	std::sort(candidates.begin(), candidates.end(),
+		[](const Resident* a, const Resident* b) { return a->LastUse < b->LastUse; });
+
+	UINT64 freed = 0;
+	for (size_t i = 0; i < candidates.size() && freed < bytes; ++i)
+	{
+		Resident& resident = *candidates[i];
+
+		// Frames recorded from now on must not sample it.
+		if (resident.OnEvicted)
+			resident.OnEvicted(resident.Tex);
+
+		ID3D12Pageable* pageable = resident.Tex->Resource.Get();
+		ThrowIfFailed(md3dDevice->Evict(1, &pageable));
+
+		resident.Evicted = true;
+		resident.EvictedAt = resident.LastUse;
+		++mEvictedCount;
+		mEvictedBytes += resident.Bytes;
+		freed += resident.Bytes;
+	}
+
+	return freed;
+}
+
+UINT64 TextureStreamer::Restore(UINT64 bytes)
+{
+	std::vector<Resident*> candidates;
+	for (auto& entry : mResidents)
+	{
+		if (entry.second.Evicted && entry.second.LastUse > entry.second.EvictedAt)
+			candidates.push_back(&entry.second);
+	}
+	std::sort(candidates.begin(), candidates.end(),
+		[](const Resident* a, const Resident* b) { return a->LastUse > b->LastUse; });
+
+	UINT64 restored = 0;
+	for (Resident* resident : candidates)
+	{
+		if (restored + resident->Bytes > bytes)
+			continue;
+
+		// Blocks until the texture is back in video memory.
+		ID3D12Pageable* pageable = resident->Tex->Resource.Get();
+		ThrowIfFailed(md3dDevice->MakeResident(1, &pageable));
+
+		resident->Evicted = false;
+		--mEvictedCount;
+		mEvictedBytes -= resident->Bytes;
+		restored += resident->Bytes;
+
+		if (resident->OnReady)
+			resident->OnReady(resident->Tex);
+	}
+
+	return restored;
+}
+
+UINT TextureStreamer::EvictedCount()const
+{
+	return mEvictedCount;
+}
+
+UINT64 TextureStreamer::EvictedBytes()const
+{
+	return mEvictedBytes;
+}
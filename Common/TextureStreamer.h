@@ -0,0 +1,127 @@
+//***************************************************************************************
+// TextureStreamer.h
+//
+// Loads DDS textures in the background.  File I/O and DDS parsing run on PPL worker
+// threads, and the uploads are recorded on copy command lists and submitted to a
+// dedicated D3D12_COMMAND_LIST_TYPE_COPY queue, so neither the main thread nor the
+// graphics queue waits on texture data.
+//
+// A demo keeps drawing with a placeholder (e.g. white1x1.dds) and calls Update()
+// once per frame.  When a texture's copy fence has completed, Update() writes its
+// SRV into the descriptor given to Request() and runs the request's callback, which
+// typically points the material at that descriptor.  The descriptor must not be in
+// use by the GPU before then; give each streamed texture its own slot instead of
+// overwriting the placeholder's.
+//
+// Copies leave the textures in D3D12_RESOURCE_STATE_COMMON; the direct queue then
+// promotes them to a shader resource state implicitly on first use.
+//
+// Ready textures can be evicted to stay under the video memory budget (see
+// VideoMemoryBudget).  The caller reports which frame samples which texture with
+// Use(); Evict() only picks textures no frame still on the GPU uses, runs their
+// onEvicted (which points the material back at the placeholder) and evicts them.
+// Restore() makes them resident again once there is room and they are wanted.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include <functional>
+#include <mutex>
+#include <ppltasks.h>
+
+class TextureStreamer
+{
+public:
+	TextureStreamer(ID3D12Device* device);
+	TextureStreamer(const TextureStreamer& rhs) = delete;
+	TextureStreamer& operator=(const TextureStreamer& rhs) = delete;
+
+	// Waits for the outstanding loads and copies.
+	~TextureStreamer();
+
+	// Starts loading texture->Filename.  texture must outlive the request; its
+	// Resource is set by Update() once the texture is ready to be sampled.
+	// onReady runs again for every Restore(), onEvicted before every Evict().
+	void Request(Texture* texture, CD3DX12_CPU_DESCRIPTOR_HANDLE srvDescriptor,
+		std::function<void(Texture*)> onReady = nullptr,
+		std::function<void(Texture*)> onEvicted = nullptr);
+
+	// Swaps in every texture whose copy has completed.  Call on the thread that
+	// records the frame, before recording it.  Rethrows loading errors as DxException.
+	// Returns the number of textures that became ready.
+	UINT Update();
+
+	// Requests that have not become ready yet.
+	UINT PendingCount()const;
+
+	// Blocks until every request made so far has become ready.
+	void Flush();
+
+	// Residency, on the thread that calls Update().  Frames are any count that
+	// grows by one per frame.  Use() marks texture as sampled by frame, whether
+	// or not it is evicted right now.
+	void Use(Texture* texture, UINT64 frame);
+
+	// Evicts ready textures that no frame after lastCompletedFrame uses, least
+	// recently used first, until bytes are freed.  Returns the bytes freed.
+	UINT64 Evict(UINT64 bytes, UINT64 lastCompletedFrame);
+
+	// Makes evicted textures that were used since their eviction resident, most
+	// recently used first, while they fit in bytes.  Returns the bytes restored.
+	UINT64 Restore(UINT64 bytes);
+
+	UINT EvictedCount()const;
+	UINT64 EvictedBytes()const;
+
+private:
+	struct Job
+	{
+		Texture* Tex = nullptr;
+		CD3DX12_CPU_DESCRIPTOR_HANDLE SrvDescriptor;
+		std::function<void(Texture*)> OnReady;
+		std::function<void(Texture*)> OnEvicted;
+
+		// Filled in by the worker thread.
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+		Microsoft::WRL::ComPtr<ID3D12Resource> UploadHeap;
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> CmdList;
+		HRESULT Result = S_OK;
+		UINT64 Fence = 0;
+	};
+
+	// A ready texture.
+	struct Resident
+	{
+		Texture* Tex = nullptr;
+		std::function<void(Texture*)> OnReady;
+		std::function<void(Texture*)> OnEvicted;
+		UINT64 Bytes = 0;
+		UINT64 LastUse = 0;
+		UINT64 EvictedAt = 0;
+		bool Evicted = false;
+	};
+
+	void Load(Job& job);
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> mCopyQueue;
+	Microsoft::WRL::ComPtr<ID3D12Fence> mFence;
+	UINT64 mFenceValue = 0;
+
+	// Guards mFenceValue so submissions signal in increasing order, and mSubmitted.
+	std::mutex mSubmitMutex;
+
+	// Jobs whose worker is done, waiting for their copy fence.
+	std::vector<std::shared_ptr<Job>> mSubmitted;
+
+	std::vector<concurrency::task<void>> mTasks;
+	UINT mPendingCount = 0;
+
+	std::unordered_map<Texture*, Resident> mResidents;
+	UINT mEvictedCount = 0;
+	UINT64 mEvictedBytes = 0;
+};
@@ -0,0 +1,111 @@
+//***************************************************************************************
+// TransformHierarchy.cpp
+//***************************************************************************************
+
+#include "TransformHierarchy.h"
+
+using namespace DirectX;
+
+UINT TransformHierarchy::AddNode(UINT parent, FXMMATRIX local)
+{
+	assert(parent == NoParent || parent < NodeCount());
+
+	UINT node = NodeCount();
+	mParents.push_back(parent);
+	mDerived.push_back(0);
+	mLocals.push_back(XMFLOAT4X4A());
+	mWorlds.push_back(XMFLOAT4X4A());
+	mDirty.push_back(1);
+	XMStoreFloat4x4A(&mLocals[node], local);
+
+	mFirstDirty = (std::min)(mFirstDirty, node);
+	return node;
+}
+
+UINT TransformHierarchy::AddDerivedNode(UINT source, FXMMATRIX transform)
+{
+	assert(source != NoParent);
+
+	UINT node = AddNode(source, transform);
+	mDerived[node] = 1;
+	return node;
+}
+
+void TransformHierarchy::SetLocal(UINT node, FXMMATRIX local)
+{
+	XMStoreFloat4x4A(&mLocals[node], local);
+	mDirty[node] = 1;
+	mFirstDirty = (std::min)(mFirstDirty, node);
+}
+
+XMMATRIX TransformHierarchy::Local(UINT node)const
+{
+	return XMLoadFloat4x4A(&mLocals[node]);
+}
+
+XMMATRIX TransformHierarchy::World(UINT node)const
+{
+	return XMLoadFloat4x4A(&mWorlds[node]);
+}
+
+UINT TransformHierarchy::Parent(UINT node)const
+{
+	return mParents[node];
+}
+
+bool TransformHierarchy::IsDerived(UINT node)const
+{
+	return mDerived[node] != 0;
+}
+
+UINT TransformHierarchy::NodeCount()const
+{
+	return (UINT)mParents.size();
+}
+
+const std::vector<UINT>& TransformHierarchy::Update()
+{
+	mChanged.clear();
+
+	// Parents come first, so their flag is final by the time a child reads it.
+	const UINT nodeCount = NodeCount();
+	for (UINT i = mFirstDirty; i < nodeCount; ++i)
+	{
+		UINT parent = mParents[i];
+		if (parent != NoParent && mDirty[parent])
+			mDirty[i] = 1;
+		if (mDirty[i])
+			mChanged.push_back(i);
+	}
+
+	// The changed nodes are in index order too.  Siblings are usually neighbours,
+	// so the parent's world matrix stays in registers across a run of them.
+	UINT loadedParent = NoParent;
+	XMMATRIX parentWorld = XMMatrixIdentity();
+	for (UINT node : mChanged)
+	{
+		UINT parent = mParents[node];
+		XMMATRIX local = XMLoadFloat4x4A(&mLocals[node]);
+
+		if (parent == NoParent)
+		{
+			XMStoreFloat4x4A(&mWorlds[node], local);
+			continue;
+		}
+
+		if (parent != loadedParent)
+		{
+			parentWorld = XMLoadFloat4x4A(&mWorlds[parent]);
+			loadedParent = parent;
+		}
+
+		XMMATRIX world = mDerived[node] ? XMMatrixMultiply(parentWorld, local) : XMMatrixMultiply(local, parentWorld);
+		XMStoreFloat4x4A(&mWorlds[node], world);
+	}
+
+	for (UINT node : mChanged)
+		mDirty[node] = 0;
+	mFirstDirty = nodeCount;
+
+	return mChanged;
+}
@@ -0,0 +1,71 @@
+//***************************************************************************************
+// TransformHierarchy.h
+//
+// Parent/child transforms in flat arrays.  A node's parent must exist before it,
+// so the arrays are always in topological order: one forward pass sees every
+// parent's world matrix before its children need it, without recursion or
+// pointer chasing.  The node's fields are separate arrays (structure of arrays),
+// so the pass over the dirty flags touches nothing else.
+//
+//   node     world = local * World(parent)          (row vectors, as DirectXMath)
+//   derived  world = World(source) * transform      a copy of source moved in world
+//                                                   space, e.g. mirrored or flattened
+//                                                   onto a plane by a shadow matrix
+//
+// SetLocal() only flags the node.  Update() spreads the flags to the subtrees and
+// recomputes just those world matrices; what it returns tells the caller which
+// object constants to rewrite from World().
+//
+//     UINT skull = transforms.AddNode(TransformHierarchy::NoParent, skullWorld);
+//     UINT mirrored = transforms.AddDerivedNode(skull, XMMatrixReflect(plane));
+//     transforms.SetLocal(skull, moved);
+//     for (UINT node : transforms.Update()) ...
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class TransformHierarchy
+{
+public:
+	static const UINT NoParent = UINT_MAX;
+
+	TransformHierarchy() = default;
+	TransformHierarchy(const TransformHierarchy& rhs) = delete;
+	TransformHierarchy& operator=(const TransformHierarchy& rhs) = delete;
+	~TransformHierarchy() = default;
+
+	// Adds a node below parent, or a root with NoParent.  Returns its index.
+	UINT AddNode(UINT parent, DirectX::FXMMATRIX local);
+
+	// Adds a node that follows source with transform applied after its world matrix.
+	UINT AddDerivedNode(UINT source, DirectX::FXMMATRIX transform);
+
+	// The local matrix of a node, the transform of a derived node.
+	void SetLocal(UINT node, DirectX::FXMMATRIX local);
+	DirectX::XMMATRIX Local(UINT node)const;
+
+	// As of the last Update().
+	DirectX::XMMATRIX World(UINT node)const;
+
+	UINT Parent(UINT node)const;
+	bool IsDerived(UINT node)const;
+	UINT NodeCount()const;
+
+	// Recomputes the world matrix of every flagged node and of everything below or
+	// derived from one.  Returns those nodes in index order; valid until the next call.
+	const std::vector<UINT>& Update();
+
+private:
+	std::vector<UINT> mParents;
+	std::vector<UINT8> mDerived;
+	std::vector<DirectX::XMFLOAT4X4A> mLocals;
+	std::vector<DirectX::XMFLOAT4X4A> mWorlds;
+
+	// Nodes before mFirstDirty are all clean, so Update() starts there.
+	std::vector<UINT8> mDirty;
+	UINT mFirstDirty = 0;
+
+	std::vector<UINT> mChanged;
+};
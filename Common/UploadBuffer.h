@@ -28,6 +28,7 @@ public:
 			D3D12_RESOURCE_STATE_GENERIC_READ,
             nullptr,
             IID_PPV_ARGS(&mUploadBuffer)));
+        GpuMemory::Track(mUploadBuffer.Get(), MemoryCategory::Upload);
 
         ThrowIfFailed(mUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedData)));
 
@@ -55,6 +56,37 @@ public:
         memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
     }
 
+    // Copies count elements starting at firstElement.  For tightly packed buffers
+    // this is a single memcpy rather than one call per element.
+    void CopyData(int firstElement, const T* data, UINT count)
+    {
+        if(mElementByteSize == sizeof(T))
+        {
+            memcpy(&mMappedData[firstElement*mElementByteSize], data, sizeof(T)*count);
+        }
+        else
+        {
+            for(UINT i = 0; i < count; ++i)
+                CopyData(firstElement + i, data[i]);
+        }
+    }
+
+    // Typed view of the mapped memory so the caller can fill elements in place.
+    // Only valid for non-constant buffers, where elements are tightly packed.
+    // The upload heap is write-combined: write sequentially and never read back.
+    T* MappedData()
+    {
+        assert(!mIsConstantBuffer);
+        return reinterpret_cast<T*>(mMappedData);
+    }
+
+    // Start of one element, constant buffer or not, for callers that write the
+    // element themselves (e.g. with streaming stores).  Write-only, as above.
+    T* MappedElement(int elementIndex)
+    {
+        return reinterpret_cast<T*>(&mMappedData[elementIndex*mElementByteSize]);
+    }
+
 private:
     Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
     BYTE* mMappedData = nullptr;
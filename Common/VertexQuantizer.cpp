@@ -0,0 +1,221 @@
+//***************************************************************************************
+// VertexQuantizer.cpp
+//***************************************************************************************
+
+#include "VertexQuantizer.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	const XMFLOAT3& Attribute3(const void* vertices, UINT stride, UINT i, UINT offset)
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(static_cast<const uint8_t*>(vertices) + (size_t)i * stride + offset);
+	}
+
+	const XMFLOAT2& Attribute2(const void* vertices, UINT stride, UINT i, UINT offset)
+	{
+		return *reinterpret_cast<const XMFLOAT2*>(static_cast<const uint8_t*>(vertices) + (size_t)i * stride + offset);
+	}
+
+	int16_t ToSnorm16(float v)
+	{
+		v = (std::max)(-1.0f, (std::min)(1.0f, v));
+		return (int16_t)lroundf(v * 32767.0f);
+	}
+
+	uint16_t ToUnorm16(float v)
+	{
+		v = (std::max)(0.0f, (std::min)(1.0f, v));
+		return (uint16_t)lroundf(v * 65535.0f);
+	}
+
+	void QuantizePosition(const XMFLOAT3& p, const BoundingBox& bounds, PositionEncoding encoding, uint16_t out[4])
+	{
+		const float position[3] = { p.x, p.y, p.z };
+		const float center[3] = { bounds.Center.x, bounds.Center.y, bounds.Center.z };
+		const float extents[3] = { bounds.Extents.x, bounds.Extents.y, bounds.Extents.z };
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (encoding == PositionEncoding::Half)
+			{
+				out[axis] = XMConvertFloatToHalf(position[axis] - center[axis]);
+			}
+			else
+			{
+				// A flat box (a floor, a wall) stores 0; its scale is 0 too.
+				float size = 2.0f * extents[axis];
+				float t = size > 0.0f ? (position[axis] - (center[axis] - extents[axis])) / size : 0.0f;
+				out[axis] = ToUnorm16(t);
+			}
+		}
+		out[3] = 0;
+	}
+
+	template<typename CompactT>
+	void QuantizeCommon(const void* vertices, const VertexAttributes& attributes, UINT i,
+		const BoundingBox& bounds, PositionEncoding encoding, CompactT& out)
+	{
+		QuantizePosition(Attribute3(vertices, attributes.Stride, i, attributes.Position), bounds, encoding, out.Position);
+
+		if (attributes.Normal != VertexAttributes::None)
+		{
+			VertexQuantizer::EncodeOctahedral(Attribute3(vertices, attributes.Stride, i, attributes.Normal), out.Normal);
+		}
+		else
+		{
+			out.Normal[0] = 0;
+			out.Normal[1] = 0;
+		}
+
+		if (attributes.TexC != VertexAttributes::None)
+		{
+			const XMFLOAT2& texC = Attribute2(vertices, attributes.Stride, i, attributes.TexC);
+			out.TexC[0] = XMConvertFloatToHalf(texC.x);
+			out.TexC[1] = XMConvertFloatToHalf(texC.y);
+		}
+		else
+		{
+			out.TexC[0] = 0;
+			out.TexC[1] = 0;
+		}
+	}
+}
+
+void VertexQuantizer::PositionTransform(const BoundingBox& bounds, PositionEncoding encoding,
+	XMFLOAT3& scale, XMFLOAT3& bias)
+{
+	if (encoding == PositionEncoding::Half)
+	{
+		scale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+		bias = bounds.Center;
+	}
+	else
+	{
+		scale = XMFLOAT3(2.0f * bounds.Extents.x, 2.0f * bounds.Extents.y, 2.0f * bounds.Extents.z);
+		bias = XMFLOAT3(bounds.Center.x - bounds.Extents.x, bounds.Center.y - bounds.Extents.y,
+			bounds.Center.z - bounds.Extents.z);
+	}
+}
+
+void VertexQuantizer::Quantize(const void* vertices, const VertexAttributes& attributes, UINT count,
+	const BoundingBox& bounds, PositionEncoding encoding, CompactVertex* out)
+{
+	for (UINT i = 0; i < count; ++i)
+		QuantizeCommon(vertices, attributes, i, bounds, encoding, out[i]);
+}
+
+void VertexQuantizer::Quantize(const void* vertices, const VertexAttributes& attributes, UINT count,
+	const BoundingBox& bounds, PositionEncoding encoding, CompactTangentVertex* out)
+{
+	for (UINT i = 0; i < count; ++i)
+	{
+		QuantizeCommon(vertices, attributes, i, bounds, encoding, out[i]);
+
+		if (attributes.Tangent != VertexAttributes::None)
+		{
+			EncodeOctahedral(Attribute3(vertices, attributes.Stride, i, attributes.Tangent), out[i].Tangent);
+		}
+		else
+		{
+			out[i].Tangent[0] = 0;
+			out[i].Tangent[1] = 0;
+		}
+	}
+}
+
+void VertexQuantizer::DecodePositions(const void* vertices, UINT stride, UINT count,
+	const BoundingBox& bounds, PositionEncoding encoding, XMFLOAT3* out)
+{
+	XMFLOAT3 scale, bias;
+	PositionTransform(bounds, encoding, scale, bias);
+
+	for (UINT i = 0; i < count; ++i)
+	{
+		const uint16_t* q = reinterpret_cast<const uint16_t*>(static_cast<const uint8_t*>(vertices) + (size_t)i * stride);
+
+		float stored[3];
+		for (int axis = 0; axis < 3; ++axis)
+			stored[axis] = encoding == PositionEncoding::Half ? XMConvertHalfToFloat(q[axis]) : q[axis] / 65535.0f;
+
+		out[i] = XMFLOAT3(stored[0] * scale.x + bias.x, stored[1] * scale.y + bias.y, stored[2] * scale.z + bias.z);
+	}
+}
+
+void VertexQuantizer::EncodeOctahedral(const XMFLOAT3& n, int16_t out[2])
+{
+	// Project onto the octahedron |x| + |y| + |z| = 1, and fold the lower half over
+	// the diagonals onto the square.
+	float sum = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	if (sum == 0.0f)
+	{
+		out[0] = 0;
+		out[1] = 0;
+		return;
+	}
+
+	float x = n.x / sum;
+	float y = n.y / sum;
+	if (n.z < 0.0f)
+	{
+		float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	out[0] = ToSnorm16(x);
+	out[1] = ToSnorm16(y);
+}
+
+XMFLOAT3 VertexQuantizer::DecodeOctahedral(const int16_t encoded[2])
+{
+	// As DecodeOctahedral() in Shader/VertexCompression.hlsl.
+	float x = (std::max)(encoded[0] / 32767.0f, -1.0f);
+	float y = (std::max)(encoded[1] / 32767.0f, -1.0f);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+
+	float t = (std::max)(-z, 0.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	XMFLOAT3 n;
+	XMStoreFloat3(&n, XMVector3Normalize(XMVectorSet(x, y, z, 0.0f)));
+	return n;
+}
+
+std::vector<D3D12_INPUT_ELEMENT_DESC> VertexQuantizer::InputLayout(PositionEncoding encoding, bool tangent)
+{
+	std::vector<D3D12_INPUT_ELEMENT_DESC> layout =
+	{
+		{ "POSITION", 0, PositionFormat(encoding), 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+	};
+
+	if (tangent)
+	{
+		layout.push_back({ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+		layout.push_back({ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 16, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+	}
+	else
+	{
+		layout.push_back({ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+	}
+
+	return layout;
+}
+
+DXGI_FORMAT VertexQuantizer::PositionFormat(PositionEncoding encoding)
+{
+	return encoding == PositionEncoding::Half ? DXGI_FORMAT_R16G16B16A16_FLOAT : DXGI_FORMAT_R16G16B16A16_UNORM;
+}
+
+uint32_t VertexQuantizer::MeshFileFormat(PositionEncoding encoding, bool tangent)
+{
+	return 1 + (uint32_t)encoding + (tangent ? 2 : 0);
+}
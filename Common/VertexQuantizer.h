@@ -0,0 +1,96 @@
+//***************************************************************************************
+// VertexQuantizer.h
+//
+// Compact vertex layouts for large static meshes, half the size of the float ones:
+//
+//   position   three 16-bit UNORMs in the mesh's bounding box, or three halves
+//              relative to its centre (a fourth component pads it to 8 bytes)
+//   normal     octahedral encoding in two 16-bit SNORMs; the tangent alike
+//   uv         two halves
+//
+// CompactVertex is 16 bytes where the demos' Vertex is 32; CompactTangentVertex is
+// 20 bytes where GeometryGenerator::Vertex is 44.
+//
+// The vertex shader gets the position back as stored * scale + bias, with the scale
+// and bias PositionTransform() gives for the same box, so the box a range was
+// quantized against (normally its submesh's Bounds) must reach the shader, e.g.
+// per object.  Shader/VertexCompression.hlsl has the decode functions; InputLayout()
+// the matching layout.
+//
+// Only depends on Windows, D3D12 and DirectXMath, like MeshFile, which stores the
+// compact vertices with MeshFileFormat() as their format.
+//***************************************************************************************
+
+#pragma once
+
+#include <windows.h>
+#include <d3d12.h>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+enum class PositionEncoding : int
+{
+	Unorm16 = 0,      // 16 bits per axis across the box: even precision, needs a box
+	Half              // half floats around the box centre: finer near the centre
+};
+
+struct CompactVertex
+{
+	uint16_t Position[4];
+	int16_t Normal[2];
+	uint16_t TexC[2];
+};
+
+struct CompactTangentVertex
+{
+	uint16_t Position[4];
+	int16_t Normal[2];
+	int16_t Tangent[2];
+	uint16_t TexC[2];
+};
+
+// Byte offsets of the attributes in the float vertices to quantize.
+struct VertexAttributes
+{
+	static const UINT None = UINT_MAX;
+
+	UINT Stride = 0;
+	UINT Position = 0;
+	UINT Normal = None;
+	UINT Tangent = None;
+	UINT TexC = None;
+};
+
+class VertexQuantizer
+{
+public:
+	// What the shader multiplies and adds to the position the input assembler reads.
+	static void PositionTransform(const DirectX::BoundingBox& bounds, PositionEncoding encoding,
+		DirectX::XMFLOAT3& scale, DirectX::XMFLOAT3& bias);
+
+	// Quantizes count vertices against bounds, which must contain their positions.
+	// Missing attributes are stored as zero.
+	static void Quantize(const void* vertices, const VertexAttributes& attributes, UINT count,
+		const DirectX::BoundingBox& bounds, PositionEncoding encoding, CompactVertex* out);
+	static void Quantize(const void* vertices, const VertexAttributes& attributes, UINT count,
+		const DirectX::BoundingBox& bounds, PositionEncoding encoding, CompactTangentVertex* out);
+
+	// The positions as the shader sees them, for CPU code that needs float
+	// positions, e.g. MeshSimplifier.  Works for both layouts given their stride.
+	static void DecodePositions(const void* vertices, UINT stride, UINT count,
+		const DirectX::BoundingBox& bounds, PositionEncoding encoding, DirectX::XMFLOAT3* out);
+
+	// A unit vector in two SNORMs, and back.
+	static void EncodeOctahedral(const DirectX::XMFLOAT3& n, int16_t out[2]);
+	static DirectX::XMFLOAT3 DecodeOctahedral(const int16_t encoded[2]);
+
+	// POSITION, NORMAL, (TANGENT,) TEXCOORD in slot 0, matching the structs.
+	static std::vector<D3D12_INPUT_ELEMENT_DESC> InputLayout(PositionEncoding encoding, bool tangent);
+	static DXGI_FORMAT PositionFormat(PositionEncoding encoding);
+
+	// MeshFileHeader::VertexFormat of a file of compact vertices.  0 stays free for
+	// the demos' float layouts.
+	static uint32_t MeshFileFormat(PositionEncoding encoding, bool tangent);
+};
@@ -3,12 +3,37 @@
 //***************************************************************************************
 
 #include "d3dApp.h"
+#include "CpuProfiler.h"
 #include <WindowsX.h>
+#include <shellapi.h>
+#include <cstdio>
+#include <cstdlib>
+
+#pragma comment(lib, "shell32.lib")
 
 using Microsoft::WRL::ComPtr;
 using namespace std;
 using namespace DirectX;
 
+namespace
+{
+	// High resolution wall clock in milliseconds, for measuring waits.
+	double QueryMilliseconds()
+	{
+		static double msPerCount = 0.0;
+		if(msPerCount == 0.0)
+		{
+			__int64 countsPerSec;
+			QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
+			msPerCount = 1000.0 / (double)countsPerSec;
+		}
+
+		__int64 currTime;
+		QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+		return currTime * msPerCount;
+	}
+}
+
 LRESULT CALLBACK
 MainWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
@@ -29,12 +54,20 @@ D3DApp::D3DApp(HINSTANCE hInstance)
     // Only one D3DApp can be constructed.
     assert(mApp == nullptr);
     mApp = this;
+
+	mJobs = std::make_unique<JobSystem>();
 }
 
 D3DApp::~D3DApp()
 {
 	if(md3dDevice != nullptr)
 		FlushCommandQueue();
+
+	if(mFrameLatencyWaitableObject != nullptr)
+		CloseHandle(mFrameLatencyWaitableObject);
+
+	if(mFenceEvent != nullptr)
+		CloseHandle(mFenceEvent);
 }
 
 HINSTANCE D3DApp::AppInst()const
@@ -59,18 +92,45 @@ bool D3DApp::Get4xMsaaState()const
 
 void D3DApp::Set4xMsaaState(bool value)
 {
+    value = value && mAntiAliasingSupported;
     if(m4xMsaaState != value)
     {
         m4xMsaaState = value;
 
-        // Recreate the swapchain and buffers with new multisample settings.
-        CreateSwapChain();
+        // The swap chain stays single sampled; OnResize() recreates the depth
+        // buffer and lets the derived class rebuild its targets and PSOs.
+        OnResize();
+    }
+}
+
+bool D3DApp::GetFxaaState()const
+{
+    return mFxaaState;
+}
+
+void D3DApp::SetFxaaState(bool value)
+{
+    value = value && mAntiAliasingSupported;
+    if(mFxaaState != value)
+    {
+        mFxaaState = value;
         OnResize();
     }
 }
 
+DXGI_SAMPLE_DESC D3DApp::MsaaSampleDesc()const
+{
+    DXGI_SAMPLE_DESC sampleDesc;
+    sampleDesc.Count = m4xMsaaState ? mMsaaSampleCount : 1;
+    sampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
+    return sampleDesc;
+}
+
 int D3DApp::Run()
 {
+	if(mPipelined)
+		return RunPipelined();
+
 	MSG msg = {0};
  
 	mTimer.Reset();
@@ -86,16 +146,49 @@ int D3DApp::Run()
 		// Otherwise, do animation/game stuff.
 		else
         {	
+			CPU_PROFILE_FRAME();
+
+			if( !mAppPaused )
+			{
+				// Block until the swap chain can take another frame, so input and
+				// simulation are sampled as late as possible.
+				mCpuWaitTime = 0.0f;
+				mGpuWaitTime = 0.0f;
+				CPU_PROFILE_SCOPE("WaitForSwapChain");
+				WaitForSwapChain();
+			}
+
 			mTimer.Tick();
 
 			if( !mAppPaused )
 			{
+				if(mBenchmark)
+					BeginBenchmarkFrame();
+
+				mVideoMemory->Update();
+
+				double frameStart = QueryMilliseconds();
+				float fenceWaitStart = mGpuWaitTime;
+				{
+					CPU_PROFILE_SCOPE("Update");
+					Update(mTimer);
+				}
+				PublishFrame();
+				{
+					CPU_PROFILE_SCOPE("Draw");
+					Draw(mTimer);
+				}
+
+				if(mBenchmark)
+					EndBenchmarkFrame((float)(QueryMilliseconds() - frameStart) - (mGpuWaitTime - fenceWaitStart));
+
+				RecordFrameTelemetry();
 				CalculateFrameStats();
-				Update(mTimer);	
-                Draw(mTimer);
 			}
 			else
 			{
+				// The pause is not a frame.
+				mTelemetryFrameStart = 0;
 				Sleep(100);
 			}
         }
@@ -104,14 +197,224 @@ int D3DApp::Run()
 	return (int)msg.wParam;
 }
 
+int D3DApp::RunPipelined()
+{
+	MSG msg = {0};
+
+	mTimer.Reset();
+	StartRenderThread();
+
+	try
+	{
+		// Whether the render thread was handed a frame since the last pause.
+		bool drawing = false;
+
+		while(msg.message != WM_QUIT)
+		{
+			if(PeekMessage(&msg, 0, 0, 0, PM_REMOVE))
+			{
+				TranslateMessage(&msg);
+				DispatchMessage(&msg);
+				continue;
+			}
+
+			CPU_PROFILE_FRAME();
+
+			mTimer.Tick();
+
+			if(mAppPaused)
+			{
+				WaitForRenderThread();
+				drawing = false;
+				mTelemetryFrameStart = 0;
+				Sleep(100);
+				continue;
+			}
+
+			// Simulate frame N+1 while the render thread draws frame N.
+			mGpuWaitTime = 0.0f;
+			mVideoMemory->Update();
+			double updateStart = QueryMilliseconds();
+			{
+				CPU_PROFILE_SCOPE("Update");
+				Update(mTimer);
+			}
+			float updateTime = (float)(QueryMilliseconds() - updateStart) - mGpuWaitTime;
+
+			double stallStart = QueryMilliseconds();
+			{
+				CPU_PROFILE_SCOPE("WaitForRenderThread");
+				WaitForRenderThread();
+			}
+			mSimStallTime = (float)(QueryMilliseconds() - stallStart);
+			mGpuQueueDepth = (UINT)(mCurrentFence - mFence->GetCompletedValue());
+
+			// Both threads are at a safe point now.  Frame N is submitted, so its
+			// benchmark timestamps close here, and frame N+1 opens its own.
+			if(drawing)
+			{
+				if(mBenchmark)
+					EndBenchmarkFrame(MathHelper::Max(updateTime, mRenderDrawTime));
+
+				RecordFrameTelemetry();
+				CalculateFrameStats();
+			}
+
+			if(mBenchmark)
+				BeginBenchmarkFrame();
+
+			PublishFrame();
+			KickRenderThread();
+			drawing = true;
+		}
+
+		WaitForRenderThread();
+	}
+	catch(...)
+	{
+		StopRenderThread();
+		throw;
+	}
+
+	StopRenderThread();
+
+	return (int)msg.wParam;
+}
+
+void D3DApp::RenderThreadMain()
+{
+	std::unique_lock<std::mutex> lock(mRenderMutex);
+	for(;;)
+	{
+		double idleStart = QueryMilliseconds();
+		mRenderCondition.wait(lock, [this]() { return mRenderFramePending || mRenderThreadExit; });
+		if(!mRenderFramePending)
+			return;
+
+		mRenderStallTime = (float)(QueryMilliseconds() - idleStart);
+		lock.unlock();
+
+		std::exception_ptr error;
+		try
+		{
+			// The swap chain wait moves here too, so a full GPU queue holds back
+			// recording but not simulation.
+			mCpuWaitTime = 0.0f;
+			{
+				CPU_PROFILE_SCOPE("WaitForSwapChain");
+				WaitForSwapChain();
+			}
+
+			double drawStart = QueryMilliseconds();
+			{
+				CPU_PROFILE_SCOPE("Draw");
+				Draw(mRenderTimer);
+			}
+			mRenderDrawTime = (float)(QueryMilliseconds() - drawStart);
+		}
+		catch(...)
+		{
+			error = std::current_exception();
+		}
+
+		lock.lock();
+		mRenderError = error;
+		mRenderFramePending = false;
+		mRenderCondition.notify_all();
+	}
+}
+
+void D3DApp::StartRenderThread()
+{
+	mRenderThreadExit = false;
+	mRenderThread = std::thread(&D3DApp::RenderThreadMain, this);
+}
+
+void D3DApp::StopRenderThread()
+{
+	if(!mRenderThread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mRenderMutex);
+		mRenderThreadExit = true;
+	}
+	mRenderCondition.notify_all();
+
+	// A pending frame is still drawn before the thread exits.
+	mRenderThread.join();
+}
+
+void D3DApp::KickRenderThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(mRenderMutex);
+		mRenderTimer = mTimer;
+		mRenderFramePending = true;
+	}
+	mRenderCondition.notify_all();
+}
+
+void D3DApp::WaitForRenderThread()
+{
+	if(!mRenderThread.joinable())
+		return;
+
+	std::exception_ptr error;
+	{
+		std::unique_lock<std::mutex> lock(mRenderMutex);
+		while(!mRenderCondition.wait_for(lock, std::chrono::milliseconds(1), [this]() { return !mRenderFramePending; }))
+		{
+			// Present() on the render thread may send this window messages (e.g. on
+			// a mode change) and wait for them, so keep handling sent messages.
+			lock.unlock();
+			MSG msg;
+			PeekMessage(&msg, nullptr, 0, 0, PM_NOREMOVE | PM_QS_SENDMESSAGE);
+			lock.lock();
+		}
+		std::swap(error, mRenderError);
+	}
+
+	if(error)
+		std::rethrow_exception(error);
+}
+
 bool D3DApp::Initialize()
 {
+	if(!ParseCommandLine())
+		return false;
+
+	if(mPrecompileShaders)
+	{
+		// A build step runs this, so a failure goes to stderr and the exit code
+		// instead of a message box nobody is there to close.
+		try
+		{
+			PrecompileShaders();
+		}
+		catch(DxException& e)
+		{
+			fwprintf(stderr, L"error: %s\n", e.ToString().c_str());
+			exit(EXIT_FAILURE);
+		}
+		return false;
+	}
+
 	if(!InitMainWindow())
 		return false;
 
 	if(!InitDirect3D())
 		return false;
 
+	if(mBenchmark)
+	{
+		// Seed before the derived class builds its scene so any random
+		// placement is the same on every run.
+		srand(mBenchmarkSeed);
+		mTimer.SetFixedTimeStep(mBenchmarkTimeStep);
+		BuildBenchmarkQueries();
+	}
+
     // Do the initial resize code.
     OnResize();
 
@@ -120,22 +423,13 @@ bool D3DApp::Initialize()
  
 void D3DApp::CreateRtvAndDsvDescriptorHeaps()
 {
-    D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc;
-    rtvHeapDesc.NumDescriptors = SwapChainBufferCount;
-    rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-    rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-	rtvHeapDesc.NodeMask = 0;
-    ThrowIfFailed(md3dDevice->CreateDescriptorHeap(
-        &rtvHeapDesc, IID_PPV_ARGS(mRtvHeap.GetAddressOf())));
+	mRtvAllocator = std::make_unique<DescriptorAllocator>(
+		md3dDevice.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_RTV, SwapChainBufferCount + ExtraRtvCount);
+	mDsvAllocator = std::make_unique<DescriptorAllocator>(
+		md3dDevice.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 1 + ExtraDsvCount);
 
-
-    D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc;
-    dsvHeapDesc.NumDescriptors = 1;
-    dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
-    dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-	dsvHeapDesc.NodeMask = 0;
-    ThrowIfFailed(md3dDevice->CreateDescriptorHeap(
-        &dsvHeapDesc, IID_PPV_ARGS(mDsvHeap.GetAddressOf())));
+	mSwapChainRtvs = mRtvAllocator->Allocate(SwapChainBufferCount);
+	mDepthStencilDsv = mDsvAllocator->Allocate(1);
 }
 
 void D3DApp::OnResize()
@@ -145,6 +439,7 @@ void D3DApp::OnResize()
     assert(mDirectCmdListAlloc);
 
 	// Flush before changing any resources.
+	WaitForRenderThread();
 	FlushCommandQueue();
 
     ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
@@ -159,14 +454,15 @@ void D3DApp::OnResize()
 		SwapChainBufferCount, 
 		mClientWidth, mClientHeight, 
 		mBackBufferFormat, 
-		DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH));
+		mSwapChainFlags));
 
-	mCurrBackBuffer = 0;
+	mCurrBackBuffer = mSwapChain->GetCurrentBackBufferIndex();
  
-	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHeapHandle(mRtvHeap->GetCPUDescriptorHandleForHeapStart());
+	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHeapHandle(mSwapChainRtvs.CPU);
 	for (UINT i = 0; i < SwapChainBufferCount; i++)
 	{
 		ThrowIfFailed(mSwapChain->GetBuffer(i, IID_PPV_ARGS(&mSwapChainBuffer[i])));
+		GpuMemory::Track(mSwapChainBuffer[i].Get(), MemoryCategory::RenderTarget);
 		md3dDevice->CreateRenderTargetView(mSwapChainBuffer[i].Get(), nullptr, rtvHeapHandle);
 		rtvHeapHandle.Offset(1, mRtvDescriptorSize);
 	}
@@ -179,9 +475,11 @@ void D3DApp::OnResize()
     depthStencilDesc.Height = mClientHeight;
     depthStencilDesc.DepthOrArraySize = 1;
     depthStencilDesc.MipLevels = 1;
-    depthStencilDesc.Format = mDepthStencilFormat;
-    depthStencilDesc.SampleDesc.Count = m4xMsaaState ? 4 : 1;
-    depthStencilDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
+
+    // The typeless form of mDepthStencilFormat (D24_UNORM_S8_UINT), so the depth can
+    // also be read through an R24_UNORM_X8_TYPELESS SRV, e.g. by HiZPyramid.
+    depthStencilDesc.Format = DXGI_FORMAT_R24G8_TYPELESS;
+    depthStencilDesc.SampleDesc = MsaaSampleDesc();
     depthStencilDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
     depthStencilDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
 
@@ -196,9 +494,16 @@ void D3DApp::OnResize()
 		D3D12_RESOURCE_STATE_COMMON,
         &optClear,
         IID_PPV_ARGS(mDepthStencilBuffer.GetAddressOf())));
+    GpuMemory::Track(mDepthStencilBuffer.Get(), MemoryCategory::RenderTarget);
 
     // Create descriptor to mip level 0 of entire resource using the format of the resource.
-    md3dDevice->CreateDepthStencilView(mDepthStencilBuffer.Get(), nullptr, DepthStencilView());
+    D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc;
+    dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
+    dsvDesc.ViewDimension = depthStencilDesc.SampleDesc.Count > 1 ?
+        D3D12_DSV_DIMENSION_TEXTURE2DMS : D3D12_DSV_DIMENSION_TEXTURE2D;
+    dsvDesc.Format = mDepthStencilFormat;
+    dsvDesc.Texture2D.MipSlice = 0;
+    md3dDevice->CreateDepthStencilView(mDepthStencilBuffer.Get(), &dsvDesc, DepthStencilView());
 
     // Transition the resource from its initial state to be used as a depth buffer.
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDepthStencilBuffer.Get(),
@@ -231,6 +536,10 @@ LRESULT D3DApp::MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 	// We pause the game when the window is deactivated and unpause it 
 	// when it becomes active.  
 	case WM_ACTIVATE:
+		// A benchmark keeps running without focus.
+		if( mBenchmark )
+			return 0;
+
 		if( LOWORD(wParam) == WA_INACTIVE )
 		{
 			mAppPaused = true;
@@ -245,6 +554,8 @@ LRESULT D3DApp::MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 
 	// WM_SIZE is sent when the user resizes the window.  
 	case WM_SIZE:
+		WaitForRenderThread();
+
 		// Save the new client area dimensions.
 		mClientWidth  = LOWORD(lParam);
 		mClientHeight = HIWORD(lParam);
@@ -353,6 +664,13 @@ LRESULT D3DApp::MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         }
         else if((int)wParam == VK_F2)
             Set4xMsaaState(!m4xMsaaState);
+        else if((int)wParam == VK_F4)
+            SetFxaaState(!mFxaaState);
+#if CPU_PROFILER_ENABLED
+        // Dump the CPU scopes of the last 120 frames for chrome://tracing.
+        else if((int)wParam == VK_F3)
+            CpuProfiler::DumpChromeTrace(L"cpu_trace.json", 120);
+#endif
 
         return 0;
 	}
@@ -434,26 +752,43 @@ bool D3DApp::InitDirect3D()
 	ThrowIfFailed(md3dDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE,
 		IID_PPV_ARGS(&mFence)));
 
+	mVideoMemory = std::make_unique<VideoMemoryBudget>(mdxgiFactory.Get(), md3dDevice.Get());
+	mVideoMemory->SetLimit(mVideoMemoryLimit);
+
+	// One event for every fence wait, instead of creating one per wait.
+	mFenceEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+	if(mFenceEvent == nullptr)
+		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+
 	mRtvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
 	mDsvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
 	mCbvSrvUavDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
-    // Check 4X MSAA quality support for our back buffer format.
-    // All Direct3D 11 capable devices support 4X MSAA for all render 
-    // target formats, so we only need to check quality support.
-
-	D3D12_FEATURE_DATA_MULTISAMPLE_QUALITY_LEVELS msQualityLevels;
-	msQualityLevels.Format = mBackBufferFormat;
-	msQualityLevels.SampleCount = 4;
-	msQualityLevels.Flags = D3D12_MULTISAMPLE_QUALITY_LEVELS_FLAG_NONE;
-	msQualityLevels.NumQualityLevels = 0;
-	ThrowIfFailed(md3dDevice->CheckFeatureSupport(
-		D3D12_FEATURE_MULTISAMPLE_QUALITY_LEVELS,
-		&msQualityLevels,
-		sizeof(msQualityLevels)));
-
-    m4xMsaaQuality = msQualityLevels.NumQualityLevels;
+    // Find the highest sample count up to mMsaaSampleCount that the back buffer
+    // format supports.  All Direct3D 11 capable devices support 4X MSAA for all
+    // render target formats, so this never ends below 4 unless asked to.
+	mMsaaSampleCount = MathHelper::Clamp(mMsaaSampleCount, 1u, (UINT)D3D12_MAX_MULTISAMPLE_SAMPLE_COUNT);
+	for(;;)
+	{
+		D3D12_FEATURE_DATA_MULTISAMPLE_QUALITY_LEVELS msQualityLevels;
+		msQualityLevels.Format = mBackBufferFormat;
+		msQualityLevels.SampleCount = mMsaaSampleCount;
+		msQualityLevels.Flags = D3D12_MULTISAMPLE_QUALITY_LEVELS_FLAG_NONE;
+		msQualityLevels.NumQualityLevels = 0;
+		ThrowIfFailed(md3dDevice->CheckFeatureSupport(
+			D3D12_FEATURE_MULTISAMPLE_QUALITY_LEVELS,
+			&msQualityLevels,
+			sizeof(msQualityLevels)));
+
+		m4xMsaaQuality = msQualityLevels.NumQualityLevels;
+		if(m4xMsaaQuality > 0 || mMsaaSampleCount == 1)
+			break;
+		--mMsaaSampleCount;
+	}
 	assert(m4xMsaaQuality > 0 && "Unexpected MSAA quality level.");
+
+	// One sample is no multisampling.
+	m4xMsaaState = m4xMsaaState && mMsaaSampleCount > 1;
 	
 #ifdef _DEBUG
     LogAdapters();
@@ -488,39 +823,89 @@ void D3DApp::CreateCommandObjects()
 	// to the command list we will Reset it, and it needs to be closed before
 	// calling Reset.
 	mCommandList->Close();
+
+	mAsyncCompute = mAsyncCompute && mAsyncComputeSupported;
+	if(mAsyncCompute)
+	{
+		D3D12_COMMAND_QUEUE_DESC computeQueueDesc = {};
+		computeQueueDesc.Type = D3D12_COMMAND_LIST_TYPE_COMPUTE;
+		computeQueueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+		ThrowIfFailed(md3dDevice->CreateCommandQueue(&computeQueueDesc, IID_PPV_ARGS(&mComputeQueue)));
+
+		ThrowIfFailed(md3dDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE,
+			IID_PPV_ARGS(&mComputeFence)));
+	}
 }
 
 void D3DApp::CreateSwapChain()
 {
     // Release the previous swapchain we will be recreating.
     mSwapChain.Reset();
+	if(mFrameLatencyWaitableObject != nullptr)
+	{
+		CloseHandle(mFrameLatencyWaitableObject);
+		mFrameLatencyWaitableObject = nullptr;
+	}
 
-    DXGI_SWAP_CHAIN_DESC sd;
-    sd.BufferDesc.Width = mClientWidth;
-    sd.BufferDesc.Height = mClientHeight;
-    sd.BufferDesc.RefreshRate.Numerator = 60;
-    sd.BufferDesc.RefreshRate.Denominator = 1;
-    sd.BufferDesc.Format = mBackBufferFormat;
-    sd.BufferDesc.ScanlineOrdering = DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED;
-    sd.BufferDesc.Scaling = DXGI_MODE_SCALING_UNSPECIFIED;
-    sd.SampleDesc.Count = m4xMsaaState ? 4 : 1;
-    sd.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
+	// Tearing lets an unsynchronized Present go out immediately, which is
+	// what variable refresh rate displays want.  It needs DXGI 1.5.
+	mTearingSupported = false;
+	ComPtr<IDXGIFactory5> factory5;
+	if(SUCCEEDED(mdxgiFactory.As(&factory5)))
+	{
+		BOOL allowTearing = FALSE;
+		if(SUCCEEDED(factory5->CheckFeatureSupport(DXGI_FEATURE_PRESENT_ALLOW_TEARING, &allowTearing, sizeof(allowTearing))))
+			mTearingSupported = (allowTearing == TRUE);
+	}
+
+	mSwapChainFlags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH | DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+	if(mTearingSupported)
+		mSwapChainFlags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+
+    DXGI_SWAP_CHAIN_DESC1 sd = {};
+    sd.Width = mClientWidth;
+    sd.Height = mClientHeight;
+    sd.Format = mBackBufferFormat;
+    // Flip model buffers cannot be multisampled; see mAntiAliasingSupported.
+    sd.SampleDesc.Count = 1;
+    sd.SampleDesc.Quality = 0;
     sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
     sd.BufferCount = SwapChainBufferCount;
-    sd.OutputWindow = mhMainWnd;
-    sd.Windowed = true;
+    sd.Scaling = DXGI_SCALING_STRETCH;
 	sd.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-    sd.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;
+    sd.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
+    sd.Flags = mSwapChainFlags;
+
+    DXGI_SWAP_CHAIN_FULLSCREEN_DESC fsd = {};
+    fsd.RefreshRate.Numerator = 60;
+    fsd.RefreshRate.Denominator = 1;
+    fsd.ScanlineOrdering = DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED;
+    fsd.Scaling = DXGI_MODE_SCALING_UNSPECIFIED;
+    fsd.Windowed = TRUE;
 
 	// Note: Swap chain uses queue to perform flush.
-    ThrowIfFailed(mdxgiFactory->CreateSwapChain(
+	ComPtr<IDXGISwapChain1> swapChain;
+    ThrowIfFailed(mdxgiFactory->CreateSwapChainForHwnd(
 		mCommandQueue.Get(),
+		mhMainWnd,
 		&sd, 
-		mSwapChain.GetAddressOf()));
+		&fsd,
+		nullptr,
+		swapChain.GetAddressOf()));
+	ThrowIfFailed(swapChain.As(&mSwapChain));
+
+	// Bound the number of queued frames; the waitable object is signaled
+	// whenever the swap chain can accept another one.
+	ThrowIfFailed(mSwapChain->SetMaximumFrameLatency(mMaxFrameLatency));
+	mFrameLatencyWaitableObject = mSwapChain->GetFrameLatencyWaitableObject();
 }
 
 void D3DApp::FlushCommandQueue()
 {
+	// The direct queue waits for the compute queue, so its fence covers both.
+	if(mComputeQueue != nullptr)
+		GraphicsWaitForCompute(SignalCompute());
+
 	// Advance the fence value to mark commands up to this fence point.
     mCurrentFence++;
 
@@ -530,17 +915,82 @@ void D3DApp::FlushCommandQueue()
     ThrowIfFailed(mCommandQueue->Signal(mFence.Get(), mCurrentFence));
 
 	// Wait until the GPU has completed commands up to this fence point.
-    if(mFence->GetCompletedValue() < mCurrentFence)
-	{
-		HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
+	WaitForFence(mCurrentFence);
+}
+
+UINT64 D3DApp::SignalCompute()
+{
+	++mCurrentComputeFence;
+	ThrowIfFailed(mComputeQueue->Signal(mComputeFence.Get(), mCurrentComputeFence));
+	return mCurrentComputeFence;
+}
+
+void D3DApp::ComputeWaitForGraphics(UINT64 fenceValue)
+{
+	if(fenceValue > 0)
+		ThrowIfFailed(mComputeQueue->Wait(mFence.Get(), fenceValue));
+}
+
+void D3DApp::GraphicsWaitForCompute(UINT64 fenceValue)
+{
+	if(fenceValue > 0)
+		ThrowIfFailed(mCommandQueue->Wait(mComputeFence.Get(), fenceValue));
+}
+
+void D3DApp::WaitForFence(UINT64 fenceValue)
+{
+	if(fenceValue == 0 || mFence->GetCompletedValue() >= fenceValue)
+		return;
+
+	CPU_PROFILE_SCOPE("WaitForFence");
+	double start = QueryMilliseconds();
+
+	// Fire event when GPU hits the fence.
+	ThrowIfFailed(mFence->SetEventOnCompletion(fenceValue, mFenceEvent));
+	WaitForSingleObject(mFenceEvent, INFINITE);
+
+	mGpuWaitTime += (float)(QueryMilliseconds() - start);
+}
+
+void D3DApp::WaitForSwapChain()
+{
+	if(mFrameLatencyWaitableObject == nullptr)
+		return;
+
+	double start = QueryMilliseconds();
+
+	// Time out rather than hang if a frame was never presented.
+	WaitForSingleObjectEx(mFrameLatencyWaitableObject, 1000, TRUE);
+
+	mCpuWaitTime += (float)(QueryMilliseconds() - start);
+}
 
-        // Fire event when GPU hits current fence.  
-        ThrowIfFailed(mFence->SetEventOnCompletion(mCurrentFence, eventHandle));
+void D3DApp::Present()
+{
+	UINT syncInterval = mVSync ? 1 : 0;
+	UINT presentFlags = 0;
 
-        // Wait until the GPU hits current fence event is fired.
-		WaitForSingleObject(eventHandle, INFINITE);
-        CloseHandle(eventHandle);
+	// Tearing is not allowed in exclusive fullscreen.
+	if(!mVSync && mTearingSupported)
+	{
+		BOOL fullscreen = FALSE;
+		mSwapChain->GetFullscreenState(&fullscreen, nullptr);
+		if(!fullscreen)
+			presentFlags = DXGI_PRESENT_ALLOW_TEARING;
 	}
+
+	ThrowIfFailed(mSwapChain->Present(syncInterval, presentFlags));
+	mCurrBackBuffer = mSwapChain->GetCurrentBackBufferIndex();
+}
+
+float D3DApp::CpuWaitTime()const
+{
+	return mCpuWaitTime;
+}
+
+float D3DApp::GpuWaitTime()const
+{
+	return mGpuWaitTime;
 }
 
 ID3D12Resource* D3DApp::CurrentBackBuffer()const
@@ -551,14 +1001,14 @@ ID3D12Resource* D3DApp::CurrentBackBuffer()const
 D3D12_CPU_DESCRIPTOR_HANDLE D3DApp::CurrentBackBufferView()const
 {
 	return CD3DX12_CPU_DESCRIPTOR_HANDLE(
-		mRtvHeap->GetCPUDescriptorHandleForHeapStart(),
+		mSwapChainRtvs.CPU,
 		mCurrBackBuffer,
 		mRtvDescriptorSize);
 }
 
 D3D12_CPU_DESCRIPTOR_HANDLE D3DApp::DepthStencilView()const
 {
-	return mDsvHeap->GetCPUDescriptorHandleForHeapStart();
+	return mDepthStencilDsv.CPU;
 }
 
 void D3DApp::CalculateFrameStats()
@@ -569,8 +1019,18 @@ void D3DApp::CalculateFrameStats()
     
 	static int frameCnt = 0;
 	static float timeElapsed = 0.0f;
+	static float cpuWaitSum = 0.0f;
+	static float gpuWaitSum = 0.0f;
+	static float simStallSum = 0.0f;
+	static float renderStallSum = 0.0f;
+	static UINT gpuQueueSum = 0;
 
 	frameCnt++;
+	cpuWaitSum += mCpuWaitTime;
+	gpuWaitSum += mGpuWaitTime;
+	simStallSum += mSimStallTime;
+	renderStallSum += mRenderStallTime;
+	gpuQueueSum += mGpuQueueDepth;
 
 	// Compute averages over one second period.
 	if( (mTimer.TotalTime() - timeElapsed) >= 1.0f )
@@ -583,16 +1043,299 @@ void D3DApp::CalculateFrameStats()
 
         wstring windowText = mMainWndCaption +
             L"    fps: " + fpsStr +
-            L"   mspf: " + mspfStr;
+            L"   mspf: " + mspfStr +
+            L"   cpu wait: " + to_wstring(cpuWaitSum / frameCnt) +
+            L"   gpu wait: " + to_wstring(gpuWaitSum / frameCnt) +
+            L"   " + mTelemetry.Summary();
+
+		if(mPipelined)
+		{
+			windowText +=
+				L"   sim stall: " + to_wstring(simStallSum / frameCnt) +
+				L"   render stall: " + to_wstring(renderStallSum / frameCnt) +
+				L"   gpu queue: " + to_wstring((float)gpuQueueSum / frameCnt);
+		}
+
+		windowText += L"   vram: " + mVideoMemory->Summary() + L" (" + GpuMemory::Summary() + L")";
+		windowText += FrameStatsText();
 
         SetWindowText(mhMainWnd, windowText.c_str());
 		
 		// Reset for next average.
 		frameCnt = 0;
+		cpuWaitSum = 0.0f;
+		gpuWaitSum = 0.0f;
+		simStallSum = 0.0f;
+		renderStallSum = 0.0f;
+		gpuQueueSum = 0;
 		timeElapsed += 1.0f;
 	}
 }
 
+void D3DApp::RecordFrameTelemetry()
+{
+	// Wall clock time between calls, not the timer's delta, which a benchmark fixes.
+	__int64 frequency;
+	__int64 now;
+	QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+	QueryPerformanceCounter((LARGE_INTEGER*)&now);
+	double msPerCount = 1000.0 / (double)frequency;
+
+	__int64 frameStart = mTelemetryFrameStart;
+	mTelemetryFrameStart = now;
+	if(mTelemetryRunStart == 0)
+		mTelemetryRunStart = now;
+	if(frameStart == 0)
+		return;
+
+	float frameTime = (float)((now - frameStart) * msPerCount);
+	if(mTelemetry.AddFrame(frameTime))
+	{
+		// The waits D3DApp measures itself are there in every build; the scopes
+		// only where the CPU profiler is compiled in.
+		vector<FrameTelemetry::ScopeTime> cpuScopes;
+		cpuScopes.push_back(FrameTelemetry::ScopeTime("swapchain wait", mCpuWaitTime));
+		cpuScopes.push_back(FrameTelemetry::ScopeTime("fence wait", mGpuWaitTime));
+		if(mPipelined)
+		{
+			cpuScopes.push_back(FrameTelemetry::ScopeTime("sim stall", mSimStallTime));
+			cpuScopes.push_back(FrameTelemetry::ScopeTime("render stall", mRenderStallTime));
+		}
+#if CPU_PROFILER_ENABLED
+		for(const auto& scope : CpuProfiler::ScopeTimesSince(frameStart))
+			cpuScopes.push_back(FrameTelemetry::ScopeTime(scope.first, scope.second));
+#endif
+		mTelemetry.AddHitch(cpuScopes);
+
+		wstring text = L"Hitch: frame " + to_wstring(mTelemetry.FrameCount() - 1) +
+			L", " + to_wstring(frameTime) + L" ms\n";
+		OutputDebugString(text.c_str());
+	}
+
+	if(mTelemetry.GpuTimesDue())
+		mTelemetry.SetGpuTimes(GpuScopeTimes());
+
+	double elapsed = (now - mTelemetryRunStart) * msPerCount / 1000.0;
+	if(!mTelemetryLogFilename.empty() && elapsed - mTelemetryLogTime >= mTelemetryLogInterval)
+	{
+		if(!mTelemetry.WriteLog(mTelemetryLogFilename, (float)elapsed))
+			OutputDebugString((L"Cannot write " + mTelemetryLogFilename + L"\n").c_str());
+		mTelemetryLogTime = elapsed;
+	}
+}
+
+bool D3DApp::ParseCommandLine()
+{
+	int argc = 0;
+	LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+	if(argv == nullptr)
+		return true;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		std::wstring arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if(arg == L"-pipelined")
+			mPipelined = true;
+		else if(arg == L"-asynccompute")
+			mAsyncCompute = true;
+		else if(arg == L"-fxaa")
+			mFxaaState = true;
+		else if(arg == L"-precompile-shaders")
+			mPrecompileShaders = true;
+		else if(!hasValue)
+			break;
+		else if(arg == L"-benchmark")
+		{
+			mBenchmarkFrameCount = (UINT)_wtoi(argv[++i]);
+			mBenchmark = mBenchmarkFrameCount > 0;
+		}
+		else if(arg == L"-seed")
+			mBenchmarkSeed = (UINT)_wtoi(argv[++i]);
+		else if(arg == L"-dt")
+			mBenchmarkTimeStep = _wtof(argv[++i]);
+		else if(arg == L"-benchmarkcsv")
+			mBenchmarkCsvFilename = argv[++i];
+		else if(arg == L"-hitchms")
+			mTelemetry.SetHitchThreshold((float)_wtof(argv[++i]));
+		else if(arg == L"-telemetrylog")
+			mTelemetryLogFilename = argv[++i];
+		else if(arg == L"-frames")
+		{
+			if(!mFrameCountSupported)
+			{
+				LocalFree(argv);
+				MessageBox(0, L"This demo does not support -frames.", 0, 0);
+				return false;
+			}
+			mNumFrameResources = _wtoi(argv[++i]);
+		}
+		else if(arg == L"-vrambudget")
+			mVideoMemoryLimit = (UINT64)_wtoi(argv[++i]) * 1024 * 1024;
+		else if(arg == L"-msaa")
+		{
+			mMsaaSampleCount = (UINT)_wtoi(argv[++i]);
+			m4xMsaaState = mMsaaSampleCount > 1;
+		}
+	}
+
+	LocalFree(argv);
+
+	if(mBenchmarkTimeStep <= 0.0)
+		mBenchmarkTimeStep = 1.0 / 60.0;
+
+	mNumFrameResources = MathHelper::Max(mNumFrameResources, 2);
+	mTelemetry.SetGpuLatency((UINT)mNumFrameResources);
+	mPipelined = mPipelined && mPipelineSupported;
+	m4xMsaaState = m4xMsaaState && mAntiAliasingSupported;
+	mFxaaState = mFxaaState && mAntiAliasingSupported;
+	return true;
+}
+
+void D3DApp::BuildBenchmarkQueries()
+{
+	D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+	queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	queryHeapDesc.Count = 2 * mBenchmarkFrameCount;
+	ThrowIfFailed(md3dDevice->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(mBenchmarkQueryHeap.GetAddressOf())));
+
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(queryHeapDesc.Count * sizeof(UINT64)),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(mBenchmarkReadback.GetAddressOf())));
+	GpuMemory::Track(mBenchmarkReadback.Get(), MemoryCategory::Upload);
+
+	for(int i = 0; i < SwapChainBufferCount; ++i)
+	{
+		ThrowIfFailed(md3dDevice->CreateCommandAllocator(
+			D3D12_COMMAND_LIST_TYPE_DIRECT,
+			IID_PPV_ARGS(mBenchmarkCmdListAlloc[i].GetAddressOf())));
+
+		ThrowIfFailed(md3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+			mBenchmarkCmdListAlloc[i].Get(), nullptr,
+			IID_PPV_ARGS(mBenchmarkBeginCmdList[i].GetAddressOf())));
+		ThrowIfFailed(mBenchmarkBeginCmdList[i]->Close());
+
+		ThrowIfFailed(md3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+			mBenchmarkCmdListAlloc[i].Get(), nullptr,
+			IID_PPV_ARGS(mBenchmarkEndCmdList[i].GetAddressOf())));
+		ThrowIfFailed(mBenchmarkEndCmdList[i]->Close());
+	}
+
+	mBenchmarkFrames.reserve(mBenchmarkFrameCount);
+}
+
+void D3DApp::BeginBenchmarkFrame()
+{
+	// Scripted camera: hold the left button and sweep the mouse so the orbit
+	// cameras turn a full circle every 360 frames while tilting up and down.
+	int cx = mClientWidth / 2;
+	int cy = mClientHeight / 2;
+	if(mBenchmarkFrame == 0)
+		OnMouseDown(MK_LBUTTON, cx, cy);
+
+	int x = cx + 4 * (int)mBenchmarkFrame;
+	int y = cy + (int)(60.0f * sinf(0.02f * mBenchmarkFrame));
+	OnMouseMove(MK_LBUTTON, x, y);
+
+	int slot = mBenchmarkFrame % SwapChainBufferCount;
+	WaitForFence(mBenchmarkFence[slot]);
+
+	auto cmdListAlloc = mBenchmarkCmdListAlloc[slot];
+	ThrowIfFailed(cmdListAlloc->Reset());
+
+	auto cmdList = mBenchmarkBeginCmdList[slot];
+	ThrowIfFailed(cmdList->Reset(cmdListAlloc.Get(), nullptr));
+	cmdList->EndQuery(mBenchmarkQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * mBenchmarkFrame);
+	ThrowIfFailed(cmdList->Close());
+
+	ID3D12CommandList* cmdsLists[] = { cmdList.Get() };
+	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+}
+
+void D3DApp::EndBenchmarkFrame(float cpuTime)
+{
+	int slot = mBenchmarkFrame % SwapChainBufferCount;
+	UINT query = 2 * mBenchmarkFrame;
+
+	auto cmdList = mBenchmarkEndCmdList[slot];
+	ThrowIfFailed(cmdList->Reset(mBenchmarkCmdListAlloc[slot].Get(), nullptr));
+	cmdList->EndQuery(mBenchmarkQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, query + 1);
+	cmdList->ResolveQueryData(mBenchmarkQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+		query, 2, mBenchmarkReadback.Get(), query * sizeof(UINT64));
+	ThrowIfFailed(cmdList->Close());
+
+	ID3D12CommandList* cmdsLists[] = { cmdList.Get() };
+	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+
+	mBenchmarkFence[slot] = ++mCurrentFence;
+	ThrowIfFailed(mCommandQueue->Signal(mFence.Get(), mCurrentFence));
+
+	BenchmarkFrame frame;
+	frame.CpuTime = cpuTime;
+	frame.FenceWaitTime = mGpuWaitTime;
+	frame.SwapChainWaitTime = mCpuWaitTime;
+	frame.SimStallTime = mSimStallTime;
+	frame.RenderStallTime = mRenderStallTime;
+	frame.GpuQueueDepth = mGpuQueueDepth;
+	mBenchmarkFrames.push_back(frame);
+
+	if(++mBenchmarkFrame < mBenchmarkFrameCount)
+		return;
+
+	OnMouseUp(MK_LBUTTON, mClientWidth / 2 + 4 * (int)mBenchmarkFrame, mClientHeight / 2);
+
+	FlushCommandQueue();
+	WriteBenchmarkCsv();
+
+	mBenchmark = false;
+	PostQuitMessage(0);
+}
+
+void D3DApp::WriteBenchmarkCsv()
+{
+	UINT64 frequency = 0;
+	ThrowIfFailed(mCommandQueue->GetTimestampFrequency(&frequency));
+	double msPerTick = 1000.0 / (double)frequency;
+
+	UINT64* timestamps = nullptr;
+	D3D12_RANGE readRange = { 0, mBenchmarkFrames.size() * 2 * sizeof(UINT64) };
+	ThrowIfFailed(mBenchmarkReadback->Map(0, &readRange, reinterpret_cast<void**>(&timestamps)));
+
+	std::ofstream fout(mBenchmarkCsvFilename);
+	fout << "frame,cpu_ms,gpu_ms,fence_wait_ms,swapchain_wait_ms,sim_stall_ms,render_stall_ms,gpu_queue\n";
+
+	double cpuSum = 0.0;
+	double gpuSum = 0.0;
+	for(size_t i = 0; i < mBenchmarkFrames.size(); ++i)
+	{
+		const BenchmarkFrame& frame = mBenchmarkFrames[i];
+		UINT64 begin = timestamps[2 * i];
+		UINT64 end = timestamps[2 * i + 1];
+		double gpuTime = end > begin ? (end - begin) * msPerTick : 0.0;
+
+		fout << i << ',' << frame.CpuTime << ',' << gpuTime << ','
+			<< frame.FenceWaitTime << ',' << frame.SwapChainWaitTime << ','
+			<< frame.SimStallTime << ',' << frame.RenderStallTime << ',' << frame.GpuQueueDepth << '\n';
+
+		cpuSum += frame.CpuTime;
+		gpuSum += gpuTime;
+	}
+
+	D3D12_RANGE writeRange = { 0, 0 };
+	mBenchmarkReadback->Unmap(0, &writeRange);
+
+	double count = mBenchmarkFrames.empty() ? 1.0 : (double)mBenchmarkFrames.size();
+	std::wstring text = L"Benchmark: " + std::to_wstring(mBenchmarkFrames.size()) +
+		L" frames, cpu " + std::to_wstring(cpuSum / count) +
+		L" ms, gpu " + std::to_wstring(gpuSum / count) +
+		L" ms -> " + mBenchmarkCsvFilename + L"\n";
+	OutputDebugString(text.c_str());
+}
+
 void D3DApp::LogAdapters()
 {
     UINT i = 0;
@@ -605,6 +1348,8 @@ void D3DApp::LogAdapters()
 
         std::wstring text = L"***Adapter: ";
         text += desc.Description;
+        text += L" (" + std::to_wstring(desc.DedicatedVideoMemory / (1024 * 1024)) + L" MB dedicated, " +
+            std::to_wstring(desc.SharedSystemMemory / (1024 * 1024)) + L" MB shared)";
         text += L"\n";
 
         OutputDebugString(text.c_str());
@@ -10,7 +10,14 @@
 #endif
 
 #include "d3dUtil.h"
+#include "DescriptorAllocator.h"
+#include "FrameTelemetry.h"
 #include "GameTimer.h"
+#include "JobSystem.h"
+#include <dxgi1_5.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 // Link necessary d3d12 libraries.
 #pragma comment(lib,"d3dcompiler.lib")
@@ -36,6 +43,11 @@ public:
 
     bool Get4xMsaaState()const;
     void Set4xMsaaState(bool value);
+    bool GetFxaaState()const;
+    void SetFxaaState(bool value);
+
+	// {mMsaaSampleCount, quality} with MSAA on, {1, 0} otherwise.
+	DXGI_SAMPLE_DESC MsaaSampleDesc()const;
 
 	int Run();
  
@@ -48,6 +60,17 @@ protected:
 	virtual void Update(const GameTimer& gt)=0;
     virtual void Draw(const GameTimer& gt)=0;
 
+	// Called between Update() and Draw() of the same frame.  In pipelined mode it
+	// runs on the main thread while the render thread is idle, so it is the one
+	// place where the state Update() simulated may be handed to Draw().
+	virtual void PublishFrame() { }
+
+	// "-precompile-shaders" on the command line calls this instead of creating the
+	// window and device, then quits.  A derived class compiles every shader variant
+	// it can use, so d3dUtil::CompileShader() writes them all to the shader cache;
+	// the Release builds run it as a post-build step.
+	virtual void PrecompileShaders() { }
+
 	// Convenience overrides for handling mouse input.
 	virtual void OnMouseDown(WPARAM btnState, int x, int y){ }
 	virtual void OnMouseUp(WPARAM btnState, int x, int y)  { }
@@ -62,12 +85,68 @@ protected:
 
 	void FlushCommandQueue();
 
+	// Async compute.  SignalCompute() signals mComputeFence after the work submitted
+	// to mComputeQueue so far and returns the value.  The waits make one queue wait on
+	// the GPU until the other's fence reaches fenceValue; the CPU does not block.
+	UINT64 SignalCompute();
+	void ComputeWaitForGraphics(UINT64 fenceValue);
+	void GraphicsWaitForCompute(UINT64 fenceValue);
+
+	// Pipelined mode: the render thread runs Draw() of frame N while Run() calls
+	// Update() of frame N+1 on the main thread.  WaitForRenderThread() blocks until
+	// the Draw() in progress has returned and rethrows what it threw; Run() and
+	// anything recreating what Draw() uses (OnResize) call it first.
+	int RunPipelined();
+	void RenderThreadMain();
+	void StartRenderThread();
+	void StopRenderThread();
+	void KickRenderThread();
+	void WaitForRenderThread();
+
+	// Blocks on the persistent fence event until the GPU reaches fenceValue.
+	// The time spent is added to GpuWaitTime().
+	void WaitForFence(UINT64 fenceValue);
+
+	// Blocks until the swap chain can queue another frame (at most
+	// mMaxFrameLatency frames in flight).  Run() calls this before Update().
+	void WaitForSwapChain();
+
+	// Presents the back buffer and advances mCurrBackBuffer.  Uses tearing
+	// when vsync is off and the display supports it (VRR).
+	void Present();
+
+	// Milliseconds the last frame spent blocked on the swap chain / on the GPU fence.
+	float CpuWaitTime()const;
+	float GpuWaitTime()const;
+
 	ID3D12Resource* CurrentBackBuffer()const;
 	D3D12_CPU_DESCRIPTOR_HANDLE CurrentBackBufferView()const;
 	D3D12_CPU_DESCRIPTOR_HANDLE DepthStencilView()const;
 
 	void CalculateFrameStats();
 
+	// Extra text CalculateFrameStats() appends to the caption, e.g. culling counts.
+	virtual std::wstring FrameStatsText()const { return std::wstring(); }
+
+	// Adds the time since the last call to mTelemetry and describes hitches.  Both
+	// run loops call it once per frame, where Draw() is not running.
+	void RecordFrameTelemetry();
+
+	// Latest and average GPU milliseconds of the demo's passes, e.g. from its
+	// GpuProfiler; a hitch records them once its frame has been read back.
+	virtual std::vector<FrameTelemetry::ScopeTime> GpuScopeTimes()const { return {}; }
+
+	// Benchmark mode, enabled with "-benchmark <frames>" on the command line
+	// (optional "-seed <n>", "-dt <seconds>", "-benchmarkcsv <file>").  The run
+	// uses a fixed time step, a seeded rand() and a scripted orbit of the camera
+	// fed through OnMouseDown/OnMouseMove, so every demo replays the same frames.
+	// Per-frame CPU, GPU and wait times are written as CSV and the app exits.
+	bool ParseCommandLine();
+	void BuildBenchmarkQueries();
+	void BeginBenchmarkFrame();
+	void EndBenchmarkFrame(float cpuTime);
+	void WriteBenchmarkCsv();
+
     void LogAdapters();
     void LogAdapterOutputs(IDXGIAdapter* adapter);
     void LogOutputDisplayModes(IDXGIOutput* output, DXGI_FORMAT format);
@@ -84,31 +163,126 @@ protected:
 	bool      mResizing = false;   // are the resize bars being dragged?
     bool      mFullscreenState = false;// fullscreen enabled
 
-	// Set true to use 4X MSAA (4.1.8).  The default is false.
-    bool      m4xMsaaState = false;    // 4X MSAA enabled
-    UINT      m4xMsaaQuality = 0;      // quality level of 4X MSAA
+	// Multisampling of the scene.  The flip model swap chain cannot be multisampled,
+	// so apps render into a SceneTarget and resolve it; only derived classes that set
+	// mAntiAliasingSupported in their constructor do, and only they get F2/F4,
+	// "-msaa <samples>" and "-fxaa".  mMsaaSampleCount is lowered in Initialize()
+	// to the highest count the back buffer format supports, m4xMsaaQuality then
+	// holds its quality levels.  PSOs take their SampleDesc from MsaaSampleDesc().
+	bool      mAntiAliasingSupported = false;
+	bool      m4xMsaaState = false;    // MSAA enabled
+	UINT      mMsaaSampleCount = 4;
+	UINT      m4xMsaaQuality = 0;      // quality levels of mMsaaSampleCount
+
+	// FXAA on the resolved scene when SceneTarget draws it into the back buffer.
+	bool      mFxaaState = false;
 
 	// Used to keep track of the delta-time and game time (4.4).
 	GameTimer mTimer;
 	
     Microsoft::WRL::ComPtr<IDXGIFactory4> mdxgiFactory;
-    Microsoft::WRL::ComPtr<IDXGISwapChain> mSwapChain;
+    Microsoft::WRL::ComPtr<IDXGISwapChain3> mSwapChain;
     Microsoft::WRL::ComPtr<ID3D12Device> md3dDevice;
 
     Microsoft::WRL::ComPtr<ID3D12Fence> mFence;
     UINT64 mCurrentFence = 0;
+	HANDLE mFenceEvent = nullptr;
+
+	// Frame pacing.  Derived classes may change mMaxFrameLatency and mVSync
+	// in their constructor.
+	UINT mMaxFrameLatency = 1;
+	bool mVSync = false;
+	bool mTearingSupported = false;
+	UINT mSwapChainFlags = 0;
+	HANDLE mFrameLatencyWaitableObject = nullptr;
+	float mCpuWaitTime = 0.0f;
+	float mGpuWaitTime = 0.0f;
+
+	// Frame resources a derived class should create; "-frames <n>" on the command
+	// line, at least 2.  Read it in Initialize(), not in the constructor.  Only
+	// derived classes that set mFrameCountSupported in their constructor accept
+	// "-frames"; the others create a fixed count and refuse to start with it.
+	int mNumFrameResources = 3;
+	bool mFrameCountSupported = false;
+
+	// "-pipelined" on the command line runs Update() and Draw() on two threads.
+	// Only derived classes that set mPipelineSupported in their constructor get
+	// it: their Draw() may only read what PublishFrame() handed over, besides
+	// state nothing writes after initialization, and must not wait on fences.
+	bool mPipelineSupported = false;
+	bool mPipelined = false;
+
+	bool mPrecompileShaders = false;
+
+	// "-asynccompute" on the command line creates mComputeQueue, for derived classes
+	// that set mAsyncComputeSupported in their constructor.  Its work overlaps the
+	// direct queue's; the two order it only through each other's fences.
+	bool mAsyncComputeSupported = false;
+	bool mAsyncCompute = false;
+
+	std::thread mRenderThread;
+	std::mutex mRenderMutex;
+	std::condition_variable mRenderCondition;
+	bool mRenderFramePending = false;
+	bool mRenderThreadExit = false;
+	std::exception_ptr mRenderError;
+
+	// The timer as it was when the pending frame was published; Draw() sees this copy.
+	GameTimer mRenderTimer;
+
+	// Pipeline statistics of the last frame: ms the main thread waited for the
+	// render thread (render bound), ms the render thread waited for a frame to
+	// draw (simulation bound), and fence signals the GPU has not reached yet.
+	float mSimStallTime = 0.0f;
+	float mRenderStallTime = 0.0f;
+	UINT mGpuQueueDepth = 0;
+	float mRenderDrawTime = 0.0f;
+
+	// Frame time percentiles and hitches, in the caption.  "-hitchms <ms>" on the
+	// command line sets the hitch threshold, "-telemetrylog <file>" writes them to
+	// file every mTelemetryLogInterval seconds.
+	FrameTelemetry mTelemetry;
+	std::wstring mTelemetryLogFilename;
+	double mTelemetryLogInterval = 10.0;
+	double mTelemetryLogTime = 0.0;
+	__int64 mTelemetryFrameStart = 0;
+	__int64 mTelemetryRunStart = 0;
+
+	// The process's video memory budget and usage, queried before every Update().
+	// "-vrambudget <MB>" caps the budget, to try eviction on a roomy card.
+	std::unique_ptr<VideoMemoryBudget> mVideoMemory;
+	UINT64 mVideoMemoryLimit = 0;
+	
+	// Worker pool for Update stages and command recording, created with the app
+	// so the main thread is its thread 0.
+	std::unique_ptr<JobSystem> mJobs;
 	
     Microsoft::WRL::ComPtr<ID3D12CommandQueue> mCommandQueue;
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> mDirectCmdListAlloc;
     Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> mCommandList;
 
-	static const int SwapChainBufferCount = 2;
+	// Null without mAsyncCompute.  FlushCommandQueue() drains this queue too.
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> mComputeQueue;
+	Microsoft::WRL::ComPtr<ID3D12Fence> mComputeFence;
+	UINT64 mCurrentComputeFence = 0;
+
+	// Three buffers so a GPU-bound frame does not stall the CPU on Present;
+	// mMaxFrameLatency still bounds how far ahead the CPU may run.
+	static const int SwapChainBufferCount = 3;
+
+	// Room in the RTV/DSV allocators beyond the swap chain and depth views.
+	static const UINT ExtraRtvCount = 16;
+	static const UINT ExtraDsvCount = 8;
 	int mCurrBackBuffer = 0;
     Microsoft::WRL::ComPtr<ID3D12Resource> mSwapChainBuffer[SwapChainBufferCount];
     Microsoft::WRL::ComPtr<ID3D12Resource> mDepthStencilBuffer;
 
-    Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mRtvHeap;
-    Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mDsvHeap;
+	// The swap chain and depth views come first; derived classes can Allocate()
+	// views for their own targets from the rest.
+	std::unique_ptr<DescriptorAllocator> mRtvAllocator;
+	std::unique_ptr<DescriptorAllocator> mDsvAllocator;
+	DescriptorAllocation mSwapChainRtvs;
+	DescriptorAllocation mDepthStencilDsv;
 
     D3D12_VIEWPORT mScreenViewport; 
     D3D12_RECT mScissorRect;
@@ -124,5 +298,32 @@ protected:
     DXGI_FORMAT mDepthStencilFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
 	int mClientWidth = 800;
 	int mClientHeight = 600;
+
+	struct BenchmarkFrame
+	{
+		float CpuTime = 0.0f;           // Update + Draw, minus fence waits (ms)
+		float FenceWaitTime = 0.0f;     // ms
+		float SwapChainWaitTime = 0.0f; // ms
+		float SimStallTime = 0.0f;      // ms, pipelined mode
+		float RenderStallTime = 0.0f;   // ms, pipelined mode
+		UINT GpuQueueDepth = 0;         // fence signals in flight
+	};
+
+	bool mBenchmark = false;
+	UINT mBenchmarkFrameCount = 0;
+	UINT mBenchmarkFrame = 0;
+	UINT mBenchmarkSeed = 1;
+	double mBenchmarkTimeStep = 1.0 / 60.0;
+	std::wstring mBenchmarkCsvFilename = L"benchmark.csv";
+	std::vector<BenchmarkFrame> mBenchmarkFrames;
+
+	// Two timestamps per frame, bracketing the demo's submissions.  The begin and
+	// end lists of a frame share an allocator, reused SwapChainBufferCount frames later.
+	Microsoft::WRL::ComPtr<ID3D12QueryHeap> mBenchmarkQueryHeap;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mBenchmarkReadback;
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> mBenchmarkCmdListAlloc[SwapChainBufferCount];
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> mBenchmarkBeginCmdList[SwapChainBufferCount];
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> mBenchmarkEndCmdList[SwapChainBufferCount];
+	UINT64 mBenchmarkFence[SwapChainBufferCount] = { 0 };
 };
 
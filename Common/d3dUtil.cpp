@@ -1,6 +1,7 @@
 
 #include "d3dUtil.h"
 #include <comdef.h>
+#include <cstdio>
 #include <fstream>
 
 using Microsoft::WRL::ComPtr;
@@ -40,7 +41,8 @@ Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
     ID3D12GraphicsCommandList* cmdList,
     const void* initData,
     UINT64 byteSize,
-    Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer)
+    Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer,
+    MemoryCategory category)
 {
     ComPtr<ID3D12Resource> defaultBuffer;
 
@@ -52,6 +54,7 @@ Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
 		D3D12_RESOURCE_STATE_COMMON,
         nullptr,
         IID_PPV_ARGS(defaultBuffer.GetAddressOf())));
+    GpuMemory::Track(defaultBuffer.Get(), category);
 
     // In order to copy CPU memory data into our default buffer, we need to create
     // an intermediate upload heap. 
@@ -62,6 +65,7 @@ Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
 		D3D12_RESOURCE_STATE_GENERIC_READ,
         nullptr,
         IID_PPV_ARGS(uploadBuffer.GetAddressOf())));
+    GpuMemory::Track(uploadBuffer.Get(), MemoryCategory::Upload);
 
 
     // Describe the data we want to copy into the default buffer.
@@ -87,6 +91,136 @@ Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
     return defaultBuffer;
 }
 
+namespace
+{
+	std::wstring gShaderCacheDirectory = L"ShaderCache";
+
+	// 64-bit FNV-1a; only used to name and validate cache entries.
+	uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	uint64_t HashString(const std::string& str, uint64_t hash)
+	{
+		// Include the terminator so "ab"+"c" and "a"+"bc" differ.
+		return HashBytes(str.c_str(), str.size() + 1, hash);
+	}
+
+	bool ReadFileBytes(const std::wstring& filename, std::string& bytes)
+	{
+		std::ifstream fin(filename, std::ios::binary);
+		if (!fin)
+			return false;
+
+		bytes.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+	std::wstring DirectoryOf(const std::wstring& filename)
+	{
+		size_t slash = filename.find_last_of(L"\\/");
+		return slash == std::wstring::npos ? std::wstring() : filename.substr(0, slash + 1);
+	}
+
+	std::string WStringToAnsi(const std::wstring& str)
+	{
+		char buffer[512];
+		WideCharToMultiByte(CP_ACP, 0, str.c_str(), -1, buffer, 512, nullptr, nullptr);
+		return std::string(buffer);
+	}
+
+	std::wstring HashToWString(uint64_t hash)
+	{
+		wchar_t buffer[17];
+		swprintf_s(buffer, L"%016llx", hash);
+		return buffer;
+	}
+
+	// A file the shader was built from, with the hash of its contents.
+	struct ShaderDependency
+	{
+		std::wstring Filename;
+		uint64_t Hash = 0;
+	};
+
+	// Resolves #include like D3D_COMPILE_STANDARD_FILE_INCLUDE (relative to the
+	// including file) and records every file it opens.
+	class RecordingInclude : public ID3DInclude
+	{
+	public:
+		RecordingInclude(const std::wstring& rootDirectory, std::vector<ShaderDependency>& dependencies) :
+			mRootDirectory(rootDirectory), mDependencies(dependencies)
+		{
+		}
+
+		HRESULT __stdcall Open(D3D_INCLUDE_TYPE includeType, LPCSTR pFileName,
+			LPCVOID pParentData, LPCVOID* ppData, UINT* pBytes)override
+		{
+			auto parent = mDirectories.find(pParentData);
+			std::wstring directory = parent != mDirectories.end() ? parent->second : mRootDirectory;
+			std::wstring filename = directory + AnsiToWString(pFileName);
+
+			std::string bytes;
+			if (!ReadFileBytes(filename, bytes))
+				return E_FAIL;
+
+			char* data = new char[bytes.size()];
+			memcpy(data, bytes.data(), bytes.size());
+			mDirectories[data] = DirectoryOf(filename);
+
+			ShaderDependency dependency;
+			dependency.Filename = filename;
+			dependency.Hash = HashBytes(bytes.data(), bytes.size());
+			mDependencies.push_back(dependency);
+
+			*ppData = data;
+			*pBytes = (UINT)bytes.size();
+			return S_OK;
+		}
+
+		HRESULT __stdcall Close(LPCVOID pData)override
+		{
+			mDirectories.erase(pData);
+			delete[] static_cast<const char*>(pData);
+			return S_OK;
+		}
+
+	private:
+		std::wstring mRootDirectory;
+		std::vector<ShaderDependency>& mDependencies;
+		std::unordered_map<LPCVOID, std::wstring> mDirectories;
+	};
+
+	// The .dep file lists one "hash filename" pair per line.  Returns false if
+	// it is missing or any listed file has changed.
+	bool DependenciesUpToDate(const std::wstring& depFilename)
+	{
+		std::wifstream fin(depFilename);
+		if (!fin)
+			return false;
+
+		uint64_t hash = 0;
+		std::wstring filename;
+		bool any = false;
+		while (fin >> std::hex >> hash && std::getline(fin >> std::ws, filename))
+		{
+			std::string bytes;
+			if (!ReadFileBytes(filename, bytes) || HashBytes(bytes.data(), bytes.size()) != hash)
+				return false;
+			any = true;
+		}
+
+		return any;
+	}
+}
+
 ComPtr<ID3DBlob> d3dUtil::CompileShader(
 	const std::wstring& filename,
 	const D3D_SHADER_MACRO* defines,
@@ -98,21 +232,90 @@ ComPtr<ID3DBlob> d3dUtil::CompileShader(
 	compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
 #endif
 
+	// Key everything that selects a variant; file contents are checked separately.
+	std::wstring csoFilename;
+	std::wstring depFilename;
+	if (!gShaderCacheDirectory.empty())
+	{
+		uint64_t key = HashBytes(filename.c_str(), filename.size() * sizeof(wchar_t));
+		for (const D3D_SHADER_MACRO* define = defines; define != nullptr && define->Name != nullptr; ++define)
+		{
+			key = HashString(define->Name, key);
+			key = HashString(define->Definition != nullptr ? define->Definition : "", key);
+		}
+		key = HashString(entrypoint, key);
+		key = HashString(target, key);
+		key = HashBytes(&compileFlags, sizeof(compileFlags), key);
+
+		std::wstring entryName = gShaderCacheDirectory + L"\\" + HashToWString(key);
+		csoFilename = entryName + L".cso";
+		depFilename = entryName + L".dep";
+
+		if (DependenciesUpToDate(depFilename))
+		{
+			std::ifstream cso(csoFilename, std::ios::binary);
+			if (cso)
+			{
+				cso.close();
+				return LoadBinary(csoFilename);
+			}
+		}
+	}
+
+	std::string source;
+	if (!ReadFileBytes(filename, source))
+		ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND));
+
+	std::vector<ShaderDependency> dependencies(1);
+	dependencies[0].Filename = filename;
+	dependencies[0].Hash = HashBytes(source.data(), source.size());
+
+	RecordingInclude include(DirectoryOf(filename), dependencies);
+
 	HRESULT hr = S_OK;
 
 	ComPtr<ID3DBlob> byteCode = nullptr;
 	ComPtr<ID3DBlob> errors;
-	hr = D3DCompileFromFile(filename.c_str(), defines, D3D_COMPILE_STANDARD_FILE_INCLUDE,
+	std::string sourceName = WStringToAnsi(filename);
+	hr = D3DCompile(source.data(), source.size(), sourceName.c_str(), defines, &include,
 		entrypoint.c_str(), target.c_str(), compileFlags, 0, &byteCode, &errors);
 
+	// Also to stderr for -precompile-shaders, whose build step reports the
+	// file(line) diagnostics as build errors.
 	if(errors != nullptr)
+	{
 		OutputDebugStringA((char*)errors->GetBufferPointer());
+		fputs((char*)errors->GetBufferPointer(), stderr);
+	}
 
 	ThrowIfFailed(hr);
 
+	// Write the bytecode first so a .dep never describes a missing .cso.  A cache
+	// that cannot be written only costs the next launch a compile.
+	if (!csoFilename.empty())
+	{
+		CreateDirectoryW(gShaderCacheDirectory.c_str(), nullptr);
+
+		std::ofstream cso(csoFilename, std::ios::binary | std::ios::trunc);
+		cso.write((const char*)byteCode->GetBufferPointer(), byteCode->GetBufferSize());
+		cso.close();
+
+		if (cso)
+		{
+			std::wofstream dep(depFilename, std::ios::trunc);
+			for (const auto& dependency : dependencies)
+				dep << HashToWString(dependency.Hash) << L" " << dependency.Filename << L"\n";
+		}
+	}
+
 	return byteCode;
 }
 
+void d3dUtil::SetShaderCacheDirectory(const std::wstring& directory)
+{
+	gShaderCacheDirectory = directory;
+}
+
 std::wstring DxException::ToString()const
 {
     // Get the string description of the error code.
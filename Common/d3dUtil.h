@@ -28,6 +28,7 @@
 #include "d3dx12.h"
 #include "DDSTextureLoader.h"
 #include "MathHelper.h"
+#include "GpuMemory.h"
 
 extern const int gNumFrameResources;
 
@@ -119,13 +120,23 @@ public:
         ID3D12GraphicsCommandList* cmdList,
         const void* initData,
         UINT64 byteSize,
-        Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer);
-
+        Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer,
+        MemoryCategory category = MemoryCategory::Geometry);
+
+	// Compiled bytecode is cached on disk, keyed by the file name, defines, entry
+	// point, target and compile flags.  Each entry also records the contents hash of
+	// the source and every file it includes, and is recompiled when any of them changes.
+	// The Release builds fill the cache ahead of time by running the demo with
+	// "-precompile-shaders" after linking (see D3DApp::PrecompileShaders()).
 	static Microsoft::WRL::ComPtr<ID3DBlob> CompileShader(
 		const std::wstring& filename,
 		const D3D_SHADER_MACRO* defines,
 		const std::string& entrypoint,
 		const std::string& target);
+
+	// Directory CompileShader() caches bytecode in, relative to the working
+	// directory.  Defaults to L"ShaderCache"; an empty string disables the cache.
+	static void SetShaderCacheDirectory(const std::wstring& directory);
 };
 
 class DxException
@@ -155,6 +166,10 @@ struct SubmeshGeometry
     // Bounding box of the geometry defined by this submesh. 
     // This is used in later chapters of the book.
 	DirectX::BoundingBox Bounds;
+
+	// For simplified LOD levels: how far (object space) the surface may be from
+	// the full-detail mesh.  0 for full detail.
+	float LodError = 0.0f;
 };
 
 struct MeshGeometry
@@ -176,8 +191,11 @@ struct MeshGeometry
     // Data about the buffers.
 	UINT VertexByteStride = 0;
 	UINT VertexBufferByteSize = 0;
+	// Byte offset of the vertices within VertexBufferGPU, for buffers sub-allocated from a larger heap.
+	UINT64 VertexBufferOffset = 0;
 	DXGI_FORMAT IndexFormat = DXGI_FORMAT_R16_UINT;
 	UINT IndexBufferByteSize = 0;
+	UINT64 IndexBufferOffset = 0;
 
 	// A MeshGeometry may store multiple geometries in one vertex/index buffer.
 	// Use this container to define the Submesh geometries so we can draw
@@ -187,7 +205,7 @@ struct MeshGeometry
 	D3D12_VERTEX_BUFFER_VIEW VertexBufferView()const
 	{
 		D3D12_VERTEX_BUFFER_VIEW vbv;
-		vbv.BufferLocation = VertexBufferGPU->GetGPUVirtualAddress();
+		vbv.BufferLocation = VertexBufferGPU->GetGPUVirtualAddress() + VertexBufferOffset;
 		vbv.StrideInBytes = VertexByteStride;
 		vbv.SizeInBytes = VertexBufferByteSize;
 
@@ -197,7 +215,7 @@ struct MeshGeometry
 	D3D12_INDEX_BUFFER_VIEW IndexBufferView()const
 	{
 		D3D12_INDEX_BUFFER_VIEW ibv;
-		ibv.BufferLocation = IndexBufferGPU->GetGPUVirtualAddress();
+		ibv.BufferLocation = IndexBufferGPU->GetGPUVirtualAddress() + IndexBufferOffset;
 		ibv.Format = IndexFormat;
 		ibv.SizeInBytes = IndexBufferByteSize;
 
@@ -7,6 +7,8 @@
 struct ObjectConstants
 {
 	DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
+	float GridSpatialStep = 1.0f;
+	DirectX::XMFLOAT3 Pad;
 };
 
 struct PassConstants
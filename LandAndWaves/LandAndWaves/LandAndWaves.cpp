@@ -1,9 +1,12 @@
 // hold down '1' key to view scene in wireframe mode
+// W/A/S/D move the camera target across the terrain
 
 #include "../../Common/d3dApp.h"
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/Terrain.h"
+#include "../../Common/GpuWaves.h"
 #include "FrameResource.h"
 #include "Waves.h"
 
@@ -24,6 +27,9 @@ struct RenderItem
 	// and scale of the object in the world.
 	XMFLOAT4X4 World = MathHelper::Identity4x4();
 
+	// Only used by the GPU waves render item.
+	float GridSpatialStep = 1.0f;
+
 	int NumFramesDirty = gNumFrameResources;
 
 	// Index into GPU constant buffer corresponding to the ObjectCB for this render item.
@@ -41,6 +47,7 @@ struct RenderItem
 enum class RenderLayer : int
 {
 	Opaque = 0,
+	GpuWaves,
 	Count
 };
 
@@ -58,6 +65,8 @@ private:
 	virtual void OnResize()override;
 	virtual void Update(const GameTimer& gt)override;
 	virtual void Draw(const GameTimer& gt)override;
+	virtual void PrecompileShaders()override;
+	virtual std::wstring FrameStatsText()const override;
 
 	virtual void OnMouseDown(WPARAM btnState, int x, int y)override;
 	virtual void OnMouseUp(WPARAM btnState, int x, int y)override;
@@ -68,10 +77,13 @@ private:
 	void UpdateObjectCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 	void UpdateWaves(const GameTimer& gt);
+	void UpdateWavesGPU(const GameTimer& gt);
 
 	void BuildRootSignature();
+	void BuildWavesRootSignature();
+	void BuildDescriptorHeaps();
 	void BuildShadersAndInputLayout();
-	void BuildLandGeometry();
+	void BuildTerrain();
 	void BuildWavesGeometryBuffers();
 	void BuildPSOs();
 	void BuildFrameResources();
@@ -80,6 +92,7 @@ private:
 
 	float GetHillsHeight(float x, float z)const;
 	XMFLOAT3 GetHillsNormal(float x, float z)const;
+	static XMFLOAT4 GetHeightColor(float y);
 
 private:
 
@@ -90,6 +103,9 @@ private:
 	UINT mCbvSrvDescriptorSize = 0;
 
 	ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
+	ComPtr<ID3D12RootSignature> mWavesRootSignature = nullptr;
+
+	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
@@ -99,18 +115,30 @@ private:
 
 	RenderItem* mWavesRitem = nullptr;
 
+	// Only supplies the terrain's (identity) object constants; the terrain
+	// issues its own draws.
+	RenderItem* mTerrainRitem = nullptr;
+	std::unique_ptr<Terrain> mTerrain;
+
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 
 	// Render items divided by PSO
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
+	// Run the wave simulation in a compute shader and displace a static grid in
+	// the vertex shader.  Set false to fall back to the CPU Waves class, which
+	// rewrites the whole vertex buffer every frame.
+	bool mUseGpuWaves = true;
+
 	std::unique_ptr<Waves> mWaves;
+	std::unique_ptr<GpuWaves> mGpuWaves;
 
 	PassConstants mMainPassCB;
 
 	bool mIsWireframe = false;
 
 	XMFLOAT3 mEyePos = { 0.0f,0.0f,0.0f };
+	XMFLOAT3 mTarget = { 0.0f,0.0f,0.0f };
 	XMFLOAT4X4 mView = MathHelper::Identity4x4();
 	XMFLOAT4X4 mProj = MathHelper::Identity4x4();
 
@@ -164,11 +192,19 @@ bool LandAndWavesApp::Initialize()
 
 	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
-	mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+	mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	if (mUseGpuWaves)
+		mGpuWaves = std::make_unique<GpuWaves>(md3dDevice.Get(), mCommandList.Get(),
+			128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+	else
+		mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
 
 	BuildRootSignature();
+	BuildWavesRootSignature();
+	BuildDescriptorHeaps();
 	BuildShadersAndInputLayout();
-	BuildLandGeometry();
+	BuildTerrain();
 	BuildWavesGeometryBuffers();
 	BuildRenderItems();
 	BuildFrameResources();
@@ -180,6 +216,9 @@ bool LandAndWavesApp::Initialize()
 
 	FlushCommandQueue();
 
+	if (mGpuWaves != nullptr)
+		mGpuWaves->DisposeUploaders();
+
 	return true;
 }
 
@@ -196,20 +235,18 @@ void LandAndWavesApp::Update(const GameTimer& gt)
 	OnKeyboardInput(gt);
 	UpdateCamera(gt);
 
+	// Tiles evicted now were last drawn by frame mCurrentFence at the latest.
+	mTerrain->Update(mEyePos, mCurrentFence, mFence->GetCompletedValue());
+
 	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
 	mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
 
-	if (mCurrFrameResource->Fence != 0 && mFence->GetCompletedValue() < mCurrFrameResource->Fence)
-	{
-		HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-		ThrowIfFailed(mFence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle));
-		WaitForSingleObject(eventHandle, INFINITE);
-		CloseHandle(eventHandle);
-	}
+	WaitForFence(mCurrFrameResource->Fence);
 
 	UpdateObjectCBs(gt);
 	UpdateMainPassCB(gt);
-	UpdateWaves(gt);
+	if (!mUseGpuWaves)
+		UpdateWaves(gt);
 }
 
 void LandAndWavesApp::Draw(const GameTimer& gt)
@@ -230,6 +267,17 @@ void LandAndWavesApp::Draw(const GameTimer& gt)
 	mCommandList->RSSetViewports(1, &mScreenViewport);
 	mCommandList->RSSetScissorRects(1, &mScissorRect);
 
+	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
+	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+
+	// The waves step binds its own compute root signature and PSO, so it goes
+	// before the graphics state below is set.
+	if (mUseGpuWaves)
+	{
+		UpdateWavesGPU(gt);
+		mCommandList->SetPipelineState(mIsWireframe ? mPSOs["opaque_wireframe"].Get() : mPSOs["opaque"].Get());
+	}
+
 	// Indicate a state transition on the resource usage.
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
 		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
@@ -249,6 +297,19 @@ void LandAndWavesApp::Draw(const GameTimer& gt)
 
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
 
+	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
+	mCommandList->SetGraphicsRootConstantBufferView(0,
+		objectCB->GetGPUVirtualAddress() + mTerrainRitem->ObjCBIndex * objCBByteSize);
+	mTerrain->Draw(mCommandList.Get());
+
+	if (mUseGpuWaves)
+	{
+		mCommandList->SetPipelineState(mIsWireframe ? mPSOs["wavesRender_wireframe"].Get() : mPSOs["wavesRender"].Get());
+		mCommandList->SetGraphicsRootDescriptorTable(2, mGpuWaves->DisplacementMap());
+		DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::GpuWaves]);
+	}
+
 	// Indicate a state transition on the resource usage
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
 		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
@@ -261,8 +322,7 @@ void LandAndWavesApp::Draw(const GameTimer& gt)
 	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
 
 	// swap back and front buffer
-	ThrowIfFailed(mSwapChain->Present(0, 0));
-	mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
+	Present();
 
 	// Advance the fence value to mark commands up to this fence point
 	mCurrFrameResource->Fence = ++mCurrentFence;
@@ -273,6 +333,13 @@ void LandAndWavesApp::Draw(const GameTimer& gt)
 	mCommandQueue->Signal(mFence.Get(), mCurrentFence);
 }
 
+std::wstring LandAndWavesApp::FrameStatsText()const
+{
+	return L"   tiles: " + std::to_wstring(mTerrain->ResidentTileCount()) +
+		L" (+" + std::to_wstring(mTerrain->PendingTileCount()) + L" pending)" +
+		L"   terrain tris: " + std::to_wstring(mTerrain->DrawnTriangleCount());
+}
+
 void LandAndWavesApp::OnMouseDown(WPARAM btnState, int x, int y)
 {
 	mLastMousePos.x = x;
@@ -306,7 +373,7 @@ void LandAndWavesApp::OnMouseMove(WPARAM btnState, int x, int y)
 
 		mRadius += dx - dy;
 
-		mRadius = MathHelper::Clamp(mRadius, 5.0f, 150.0f);
+		mRadius = MathHelper::Clamp(mRadius, 5.0f, 400.0f);
 	}
 
 	mLastMousePos.x = x;
@@ -319,17 +386,44 @@ void LandAndWavesApp::OnKeyboardInput(const GameTimer& gt)
 		mIsWireframe = true;
 	else
 		mIsWireframe = false;
+
+	// Pan the target along the camera's heading, faster when zoomed out.
+	const float speed = 0.5f * mRadius * gt.DeltaTime();
+	XMFLOAT2 forward(-cosf(mTheta), -sinf(mTheta));
+	XMFLOAT2 left(-forward.y, forward.x);
+
+	if (GetAsyncKeyState('W') & 0x8000)
+	{
+		mTarget.x += speed * forward.x;
+		mTarget.z += speed * forward.y;
+	}
+	if (GetAsyncKeyState('S') & 0x8000)
+	{
+		mTarget.x -= speed * forward.x;
+		mTarget.z -= speed * forward.y;
+	}
+	if (GetAsyncKeyState('D') & 0x8000)
+	{
+		mTarget.x -= speed * left.x;
+		mTarget.z -= speed * left.y;
+	}
+	if (GetAsyncKeyState('A') & 0x8000)
+	{
+		mTarget.x += speed * left.x;
+		mTarget.z += speed * left.y;
+	}
+	mTarget.y = MathHelper::Max(GetHillsHeight(mTarget.x, mTarget.z), 0.0f);
 }
 
 void LandAndWavesApp::UpdateCamera(const GameTimer& gt)
 {
 	// Convert Spherical to Cartesian coordinates
-	mEyePos.x = mRadius * sinf(mPhi) * cosf(mTheta);
-	mEyePos.z = mRadius * sinf(mPhi) * sinf(mTheta);
-	mEyePos.y = mRadius * cosf(mPhi);
+	mEyePos.x = mTarget.x + mRadius * sinf(mPhi) * cosf(mTheta);
+	mEyePos.z = mTarget.z + mRadius * sinf(mPhi) * sinf(mTheta);
+	mEyePos.y = mTarget.y + mRadius * cosf(mPhi);
 
 	XMVECTOR pos = XMVectorSet(mEyePos.x, mEyePos.y, mEyePos.z, 1.0f);
-	XMVECTOR target = XMVectorZero();
+	XMVECTOR target = XMVectorSet(mTarget.x, mTarget.y, mTarget.z, 1.0f);
 	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
 
 	XMMATRIX view = XMMatrixLookAtLH(pos, target, up);
@@ -349,6 +443,7 @@ void LandAndWavesApp::UpdateObjectCBs(const GameTimer& gt)
 
 			ObjectConstants objConstants;
 			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
+			objConstants.GridSpatialStep = e->GridSpatialStep;
 
 			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
 
@@ -402,7 +497,7 @@ void LandAndWavesApp::UpdateWaves(const GameTimer& gt)
 	}
 
 	// Update the wave simulation
-	mWaves->Update(gt.DeltaTime());
+	mWaves->Update(gt.DeltaTime(), *mJobs);
 
 	// Update the wave vertex buffer with the new solution
 	auto currWavesVB = mCurrFrameResource->WavesVB.get();
@@ -420,15 +515,42 @@ void LandAndWavesApp::UpdateWaves(const GameTimer& gt)
 	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
 }
 
+void LandAndWavesApp::UpdateWavesGPU(const GameTimer& gt)
+{
+	// Update the wave simulation.
+	if (!mGpuWaves->Update(gt.DeltaTime(), mCommandList.Get(), mWavesRootSignature.Get(), mPSOs["wavesUpdate"].Get()))
+		return;
+
+	// Every quarter second, generate a random wave.  Only right after a step: the
+	// solution it changes is then one no frame has drawn yet.
+	static float t_base = 0.0f;
+	if ((mTimer.TotalTime() - t_base) >= 0.25f)
+	{
+		t_base += 0.25f;
+
+		int i = MathHelper::Rand(4, mGpuWaves->RowCount() - 5);
+		int j = MathHelper::Rand(4, mGpuWaves->ColumnCount() - 5);
+
+		float r = MathHelper::RandF(0.2f, 0.5f);
+
+		mGpuWaves->Disturb(mCommandList.Get(), mWavesRootSignature.Get(), mPSOs["wavesDisturb"].Get(), i, j, r);
+	}
+}
+
 void LandAndWavesApp::BuildRootSignature()
 {
+	// Displacement map of the GPU waves, read by the vertex shader.
+	CD3DX12_DESCRIPTOR_RANGE displacementMapTable;
+	displacementMapTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+
 	// Root parameter can be a table or root descriptor, root constants
-	CD3DX12_ROOT_PARAMETER slotRootParameter[2];
+	CD3DX12_ROOT_PARAMETER slotRootParameter[3];
 
 	slotRootParameter[0].InitAsConstantBufferView(0);
 	slotRootParameter[1].InitAsConstantBufferView(1);
+	slotRootParameter[2].InitAsDescriptorTable(1, &displacementMapTable, D3D12_SHADER_VISIBILITY_VERTEX);
 
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(2, slotRootParameter, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(3, slotRootParameter, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
 	// create a root signature with a signal slot which points to a descriptor range consisting of a single constant buffer
 	ComPtr<ID3DBlob> serializedRootSig = nullptr;
@@ -450,11 +572,56 @@ void LandAndWavesApp::BuildRootSignature()
 	));
 }
 
+void LandAndWavesApp::BuildWavesRootSignature()
+{
+	if (mUseGpuWaves)
+		mGpuWaves->BuildRootSignature(md3dDevice.Get(), mWavesRootSignature);
+}
+
+void LandAndWavesApp::BuildDescriptorHeaps()
+{
+	// Only the GPU waves need descriptors; keep one slot either way so the heap
+	// can always be set.
+	const UINT wavesDescriptorCount = mUseGpuWaves ? mGpuWaves->DescriptorCount() : 0;
+
+	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
+	srvHeapDesc.NumDescriptors = (std::max)(wavesDescriptorCount, 1u);
+	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
+
+	if (mUseGpuWaves)
+	{
+		mGpuWaves->BuildDescriptors(
+			CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart()),
+			CD3DX12_GPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart()),
+			mCbvSrvDescriptorSize);
+	}
+}
+
+void LandAndWavesApp::PrecompileShaders()
+{
+	BuildShadersAndInputLayout();
+}
+
 void LandAndWavesApp::BuildShadersAndInputLayout()
 {
+	const D3D_SHADER_MACRO wavesDefines[] =
+	{
+		"DISPLACEMENT_MAP", "1",
+		NULL, NULL
+	};
+
 	mShaders["standardVS"] = d3dUtil::CompileShader(L"VertexShader.hlsl", nullptr, "VS", "vs_5_0");
 	mShaders["opaquePS"] = d3dUtil::CompileShader(L"VertexShader.hlsl", nullptr, "PS", "ps_5_0");
 
+	if (mUseGpuWaves)
+	{
+		mShaders["wavesVS"] = d3dUtil::CompileShader(L"VertexShader.hlsl", wavesDefines, "VS", "vs_5_0");
+		mShaders["wavesUpdateCS"] = d3dUtil::CompileShader(L"../../Shader/WaveSim.hlsl", nullptr, "UpdateWavesCS", "cs_5_0");
+		mShaders["wavesDisturbCS"] = d3dUtil::CompileShader(L"../../Shader/WaveSim.hlsl", nullptr, "DisturbWavesCS", "cs_5_0");
+	}
+
 	mInputLayout =
 	{
 		{"POSITION",0,DXGI_FORMAT_R32G32B32_FLOAT,0,0,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0},
@@ -462,86 +629,87 @@ void LandAndWavesApp::BuildShadersAndInputLayout()
 	};
 }
 
-void LandAndWavesApp::BuildLandGeometry()
+void LandAndWavesApp::BuildTerrain()
 {
-	GeometryGenerator geoGen;
-	GeometryGenerator::MeshData grid = geoGen.CreateGrid(160.0f, 160.0f, 50, 50);
+	// The hills are one height source of a streamed, tiled terrain.  Vertices are
+	// colored by height so we have sandy looking beaches, grassy low hills and
+	// snow mountain peaks.
+	TerrainDesc desc;
+	desc.TileSize = 64.0f;
+	desc.TileQuads = 32;
+	desc.LodCount = 4;
+	desc.LodDistance = 80.0f;
+	desc.ResidentRadius = 600.0f;
+	desc.VertexByteStride = sizeof(Vertex);
+	desc.WriteVertex = [](void* vertex, const XMFLOAT3& pos, const XMFLOAT3& normal)
+	{
+		Vertex* v = reinterpret_cast<Vertex*>(vertex);
+		v->Pos = pos;
+		v->Color = GetHeightColor(pos.y);
+	};
 
-	// Extract the vertex elements we are interested and apply the height function to each vertex.
-	// In additon, color the vertices based on the height so we have sandy looking beaches, grassy low hills and snow mountain peaks.
+	auto heights = std::make_unique<FunctionHeightSource>(
+		[this](float x, float z) { return GetHillsHeight(x, z); });
 
-	std::vector<Vertex> vertices(grid.Vertices.size());
-	for (size_t i = 0; i < grid.Vertices.size(); ++i)
-	{
-		auto& p = grid.Vertices[i].Position;
-		vertices[i].Pos = p;
-		vertices[i].Pos.y = GetHillsHeight(p.x, p.z);
+	mTerrain = std::make_unique<Terrain>(md3dDevice.Get(), mCommandQueue.Get(), *mJobs, desc, std::move(heights));
+}
 
-		// Color
-		if (vertices[i].Pos.y < -10.0f)
-		{
-			// beach
-			vertices[i].Color = XMFLOAT4(1.0f, 0.96f, 0.62f, 1.0f);
-		}
-		else if (vertices[i].Pos.y < 5.0f)
-		{
-			// yellow-green
-			vertices[i].Color = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
-		}
-		else if (vertices[i].Pos.y < 12.0f)
-		{
-			// dark yellow-green
-			vertices[i].Color = XMFLOAT4(0.1f, 0.48f, 0.19f, 1.0f);
-		}
-		else if (vertices[i].Pos.y < 20.0f)
-		{
-			// Dark brown.
-			vertices[i].Color = XMFLOAT4(0.45f, 0.39f, 0.34f, 1.0f);
-		}
-		else
+void LandAndWavesApp::BuildWavesGeometryBuffers()
+{
+	if (mUseGpuWaves)
+	{
+		// The heights come from the displacement map, so the grid itself never changes
+		// and can live in a default buffer like any other static mesh.
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData grid = geoGen.CreateGrid(
+			(mGpuWaves->ColumnCount() - 1) * mGpuWaves->SpatialStep(),
+			(mGpuWaves->RowCount() - 1) * mGpuWaves->SpatialStep(),
+			mGpuWaves->RowCount(), mGpuWaves->ColumnCount());
+
+		std::vector<Vertex> vertices(grid.Vertices.size());
+		for (size_t i = 0; i < grid.Vertices.size(); ++i)
 		{
-			// White snow.
-			vertices[i].Color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+			vertices[i].Pos = grid.Vertices[i].Position;
+			vertices[i].Color = XMFLOAT4(DirectX::Colors::Blue);
 		}
-	}
 
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+		std::vector<std::uint16_t> indices = grid.GetIndices16();
+		assert(vertices.size() < 0x0000ffff);
 
-	std::vector<std::uint16_t> indices = grid.GetIndices16();
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+		UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+		UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
-	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = "landGeo";
+		auto geo = std::make_unique<MeshGeometry>();
+		geo->Name = "waterGeo";
 
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+		ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+		CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
 
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+		ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+		geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+			mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
 
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+		geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+			mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
 
-	geo->VertexByteStride = sizeof(Vertex);
-	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
-	geo->IndexBufferByteSize = ibByteSize;
+		geo->VertexByteStride = sizeof(Vertex);
+		geo->VertexBufferByteSize = vbByteSize;
+		geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+		geo->IndexBufferByteSize = ibByteSize;
 
-	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
-	submesh.StartIndexLocation = 0;
-	submesh.BaseVertexLocation = 0;
+		SubmeshGeometry submesh;
+		submesh.IndexCount = (UINT)indices.size();
+		submesh.StartIndexLocation = 0;
+		submesh.BaseVertexLocation = 0;
 
-	geo->DrawArgs["grid"] = submesh;
+		geo->DrawArgs["grid"] = submesh;
 
-	mGeometries["landGeo"] = std::move(geo);
-}
+		mGeometries["waterGeo"] = std::move(geo);
+		return;
+	}
 
-void LandAndWavesApp::BuildWavesGeometryBuffers()
-{
 	std::vector<std::uint16_t> indices(3 * mWaves->TriangleCount());
 	assert(mWaves->VertexCount() < 0x0000ffff);
 
@@ -631,7 +799,44 @@ void LandAndWavesApp::BuildPSOs()
 
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaqueWireframePsoDesc = opaquePsoDesc;
 	opaqueWireframePsoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaqueWireframePsoDesc, IID_PPV_ARGS(&oljuj["opaque_wireframe"])));
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaqueWireframePsoDesc, IID_PPV_ARGS(&mPSOs["opaque_wireframe"])));
+
+	if (mUseGpuWaves)
+	{
+		// PSOs for the displaced waves grid
+
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC wavesRenderPSO = opaquePsoDesc;
+		wavesRenderPSO.VS =
+		{
+			reinterpret_cast<BYTE*>(mShaders["wavesVS"]->GetBufferPointer()),
+			mShaders["wavesVS"]->GetBufferSize()
+		};
+		ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&wavesRenderPSO, IID_PPV_ARGS(&mPSOs["wavesRender"])));
+
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC wavesWireframePSO = wavesRenderPSO;
+		wavesWireframePSO.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+		ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&wavesWireframePSO, IID_PPV_ARGS(&mPSOs["wavesRender_wireframe"])));
+
+		D3D12_COMPUTE_PIPELINE_STATE_DESC wavesDisturbPSO = {};
+		wavesDisturbPSO.pRootSignature = mWavesRootSignature.Get();
+		wavesDisturbPSO.CS =
+		{
+			reinterpret_cast<BYTE*>(mShaders["wavesDisturbCS"]->GetBufferPointer()),
+			mShaders["wavesDisturbCS"]->GetBufferSize()
+		};
+		wavesDisturbPSO.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+		ThrowIfFailed(md3dDevice->CreateComputePipelineState(&wavesDisturbPSO, IID_PPV_ARGS(&mPSOs["wavesDisturb"])));
+
+		D3D12_COMPUTE_PIPELINE_STATE_DESC wavesUpdatePSO = {};
+		wavesUpdatePSO.pRootSignature = mWavesRootSignature.Get();
+		wavesUpdatePSO.CS =
+		{
+			reinterpret_cast<BYTE*>(mShaders["wavesUpdateCS"]->GetBufferPointer()),
+			mShaders["wavesUpdateCS"]->GetBufferSize()
+		};
+		wavesUpdatePSO.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+		ThrowIfFailed(md3dDevice->CreateComputePipelineState(&wavesUpdatePSO, IID_PPV_ARGS(&mPSOs["wavesUpdate"])));
+	}
 }
 
 void LandAndWavesApp::BuildFrameResources()
@@ -639,7 +844,7 @@ void LandAndWavesApp::BuildFrameResources()
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
 		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-			1, (UINT)mAllRitems.size(), mWaves->VertexCount()));
+			1, (UINT)mAllRitems.size(), mUseGpuWaves ? 0 : mWaves->VertexCount()));
 	}
 }
 
@@ -656,21 +861,23 @@ void LandAndWavesApp::BuildRenderItems()
 
 	mWavesRitem = wavesRitem.get();
 
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(wavesRitem.get());
-
-	auto gridRitem = std::make_unique<RenderItem>();
-	gridRitem->World = MathHelper::Identity4x4();
-	gridRitem->ObjCBIndex = 1;
-	gridRitem->Geo = mGeometries["landGeo"].get();
-	gridRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
-	gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
-	gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+	if (mUseGpuWaves)
+	{
+		wavesRitem->GridSpatialStep = mGpuWaves->SpatialStep();
+		mRitemLayer[(int)RenderLayer::GpuWaves].push_back(wavesRitem.get());
+	}
+	else
+	{
+		mRitemLayer[(int)RenderLayer::Opaque].push_back(wavesRitem.get());
+	}
 
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(gridRitem.get());
+	auto terrainRitem = std::make_unique<RenderItem>();
+	terrainRitem->World = MathHelper::Identity4x4();
+	terrainRitem->ObjCBIndex = 1;
+	mTerrainRitem = terrainRitem.get();
 
 	mAllRitems.push_back(std::move(wavesRitem));
-	mAllRitems.push_back(std::move(gridRitem));
+	mAllRitems.push_back(std::move(terrainRitem));
 }
 
 void LandAndWavesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
@@ -696,6 +903,35 @@ void LandAndWavesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const
 	}
 }
 
+XMFLOAT4 LandAndWavesApp::GetHeightColor(float y)
+{
+	if (y < -10.0f)
+	{
+		// beach
+		return XMFLOAT4(1.0f, 0.96f, 0.62f, 1.0f);
+	}
+	else if (y < 5.0f)
+	{
+		// yellow-green
+		return XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
+	}
+	else if (y < 12.0f)
+	{
+		// dark yellow-green
+		return XMFLOAT4(0.1f, 0.48f, 0.19f, 1.0f);
+	}
+	else if (y < 20.0f)
+	{
+		// Dark brown.
+		return XMFLOAT4(0.45f, 0.39f, 0.34f, 1.0f);
+	}
+	else
+	{
+		// White snow.
+		return XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+	}
+}
+
 float LandAndWavesApp::GetHillsHeight(float x, float z)const
 {
 	return 0.3f * (z * sinf(0.1f * x) + x * cosf(0.1f * z));
@@ -1,6 +1,15 @@
+#ifdef DISPLACEMENT_MAP
+#include "../../Shader/WaveDisplacement.hlsl"
+
+// Wave heights written by WaveSim.hlsl.
+Texture2D gDisplacementMap : register(t0);
+#endif
+
 cbuffer cbPerObject : register(b0)
 {
     float4x4 gWorld;
+    float gGridSpatialStep;
+    float3 cbPerObjectPad0;
 }
 
 cbuffer cbPass : register(b1)
@@ -33,10 +42,16 @@ struct VertexOut
     float4 Color : COLOR;
 };
 
-VertexOut VS(VertexIn vin)
+VertexOut VS(VertexIn vin, uint vertexId : SV_VertexID)
 {
     VertexOut vout;
     
+#ifdef DISPLACEMENT_MAP
+    // The waves are unlit, so the normal goes unused.
+    float3 normalL;
+    vin.PosL.y += WaveHeight(gDisplacementMap, vertexId, gGridSpatialStep, normalL);
+#endif
+    
     float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
     vout.PosH = mul(posW, gViewProj);
     
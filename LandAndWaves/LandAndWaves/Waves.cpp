@@ -1,5 +1,5 @@
 #include "Waves.h"
-#include <ppl.h>
+#include "../../Common/JobSystem.h"
 #include <algorithm>
 #include <vector>
 #include <cassert>
@@ -82,7 +82,7 @@ float Waves::Depth()const
 	return mNumRows * mSpatialStep;
 }
 
-void Waves::Update(float dt)
+void Waves::Update(float dt, JobSystem& jobs)
 {
 	static float t = 0;
 
@@ -94,7 +94,7 @@ void Waves::Update(float dt)
 	{
 		// Only update interior points;
 		// We use zero boundary condition
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
+		jobs.ParallelFor(1, mNumRows - 1, 8, [this](int i)
 			// for(int i = 1; i < mNumRows - 1; ++i)
 			{
 				for (int j = i; j < mNumCols - 1; ++j)
@@ -128,7 +128,7 @@ void Waves::Update(float dt)
 
 		// Compute normals using finite difference scheme
 
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
+		jobs.ParallelFor(1, mNumRows - 1, 8, [this](int i)
 			// for(int i = 1; i < mNumRows - 1; ++i)
 			{
 				for (int j = 0; j < mNumCols - 1; j++)
@@ -11,6 +11,8 @@
 #include <vector>
 #include <DirectXMath.h>
 
+class JobSystem;
+
 class Waves
 {
 public:
@@ -35,7 +37,7 @@ public:
 	// Resturns the unit tangent vector at the ith grid point in the local x-axis direction.
 	const DirectX::XMFLOAT3& TangentX(int i)const { return mTangentX[i]; }
 
-	void Update(float dt);
+	void Update(float dt, JobSystem& jobs);
 	void Disturb(int i, int j, float magnitude);
 
 private:
@@ -12,9 +12,18 @@
 
 #include "../../Shader/LightingUtil.hlsl"
 
+#ifdef DISPLACEMENT_MAP
+#include "../../Shader/WaveDisplacement.hlsl"
+
+// Wave heights written by WaveSim.hlsl.
+Texture2D gDisplacementMap : register(t0);
+#endif
+
 cbuffer cbPerObject : register(b0)
 {
     float4x4 gWorld;
+    float gGridSpatialStep;
+    float3 cbPerObjectPad0;
 };
 
 cbuffer cbMaterial : register(b1)
@@ -59,10 +68,14 @@ struct VertexOut
     float3 NormalW : NORMAL;
 };
 
-VertexOut VS(VertexIn vin)
+VertexOut VS(VertexIn vin, uint vertexId : SV_VertexID)
 {
     VertexOut vout = (VertexOut) 0.0f;
     
+#ifdef DISPLACEMENT_MAP
+    vin.PosL.y += WaveHeight(gDisplacementMap, vertexId, gGridSpatialStep, vin.NormalL);
+#endif
+    
     float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
     vout.PosW = posW.xyz;
     
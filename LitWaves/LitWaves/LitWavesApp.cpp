@@ -4,6 +4,7 @@
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/GpuWaves.h"
 #include "FrameResource.h"
 #include "Waves.h"
 
@@ -21,6 +22,9 @@ struct RenderItem
 
 	XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
 
+	// Only used by the GPU waves render item.
+	float GridSpatialStep = 1.0f;
+
 	int NumFramesDirty = gNumFrameResources;
 
 	UINT ObjCBIndex = -1;
@@ -38,6 +42,7 @@ struct RenderItem
 enum class RenderLayer :int
 {
 	Opaque = 0,
+	GpuWaves,
 	Count
 };
 
@@ -55,6 +60,7 @@ private:
 	virtual void OnResize()override;
 	virtual void Update(const GameTimer& gt)override;
 	virtual void Draw(const GameTimer& gt)override;
+	virtual void PrecompileShaders()override;
 
 	virtual void OnMouseDown(WPARAM btnState, int x, int y)override;
 	virtual void OnMouseUp(WPARAM btnState, int x, int y)override;
@@ -66,8 +72,11 @@ private:
 	void UpdateMaterialCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 	void UpdateWaves(const GameTimer& gt);
+	void UpdateWavesGPU(const GameTimer& gt);
 
 	void BuildRootSignature();
+	void BuildWavesRootSignature();
+	void BuildDescriptorHeaps();
 	void BuildShadersAndInputLayout();
 	void BuildLandGeometry();
 	void BuildWavesGeometryBuffers();
@@ -89,6 +98,9 @@ private:
 	UINT mCbvSrvDescriptorSize = 0;
 
 	ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
+	ComPtr<ID3D12RootSignature> mWavesRootSignature = nullptr;
+
+	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
 	std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
@@ -106,7 +118,13 @@ private:
 	// Render items divided by PSO
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
+	// Run the wave simulation in a compute shader and displace a static grid in
+	// the vertex shader.  Set false to fall back to the CPU Waves class, which
+	// rewrites the whole vertex buffer every frame.
+	bool mUseGpuWaves = true;
+
 	std::unique_ptr<Waves> mWaves;
+	std::unique_ptr<GpuWaves> mGpuWaves;
 
 	PassConstants mMainPassCB;
 
@@ -165,9 +183,15 @@ bool LitWavesApp::Initialize()
 
 	mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
-	mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+	if (mUseGpuWaves)
+		mGpuWaves = std::make_unique<GpuWaves>(md3dDevice.Get(), mCommandList.Get(),
+			128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+	else
+		mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
 
 	BuildRootSignature();
+	BuildWavesRootSignature();
+	BuildDescriptorHeaps();
 	BuildShadersAndInputLayout();
 	BuildLandGeometry();
 	BuildWavesGeometryBuffers();
@@ -182,6 +206,9 @@ bool LitWavesApp::Initialize()
 
 	FlushCommandQueue();
 
+	if (mGpuWaves != nullptr)
+		mGpuWaves->DisposeUploaders();
+
 	return true;
 }
 
@@ -201,18 +228,13 @@ void LitWavesApp::Update(const GameTimer& gt)
 	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
 	mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
 
-	if (mCurrFrameResource->Fence != 0 && mFence->GetCompletedValue() < mCurrFrameResource->Fence)
-	{
-		HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-		ThrowIfFailed(mFence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle));
-		WaitForSingleObject(eventHandle, INFINITE);
-		CloseHandle(eventHandle);
-	}
+	WaitForFence(mCurrFrameResource->Fence);
 
 	UpdateObjectCBs(gt);
 	UpdateMaterialCBs(gt);
 	UpdateMainPassCB(gt);
-	UpdateWaves(gt);
+	if (!mUseGpuWaves)
+		UpdateWaves(gt);
 }
 
 void LitWavesApp::Draw(const GameTimer& gt)
@@ -226,6 +248,17 @@ void LitWavesApp::Draw(const GameTimer& gt)
 	mCommandList->RSSetViewports(1, &mScreenViewport);
 	mCommandList->RSSetScissorRects(1, &mScissorRect);
 
+	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
+	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+
+	// The waves step binds its own compute root signature and PSO, so it goes
+	// before the graphics state below is set.
+	if (mUseGpuWaves)
+	{
+		UpdateWavesGPU(gt);
+		mCommandList->SetPipelineState(mPSOs["opaque"].Get());
+	}
+
 	// Indicate resource state to render target for Render
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
 		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
@@ -243,6 +276,13 @@ void LitWavesApp::Draw(const GameTimer& gt)
 
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
 
+	if (mUseGpuWaves)
+	{
+		mCommandList->SetPipelineState(mPSOs["wavesRender"].Get());
+		mCommandList->SetGraphicsRootDescriptorTable(3, mGpuWaves->DisplacementMap());
+		DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::GpuWaves]);
+	}
+
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
 		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
 
@@ -251,8 +291,7 @@ void LitWavesApp::Draw(const GameTimer& gt)
 	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
 	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
 
-	ThrowIfFailed(mSwapChain->Present(0,0));
-	mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
+	Present();
 
 	mCurrFrameResource->Fence = ++mCurrentFence;
 
@@ -345,6 +384,7 @@ void LitWavesApp::UpdateObjectCBs(const GameTimer& gt)
 
 			ObjectConstants objConstants;
 			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
+			objConstants.GridSpatialStep = e->GridSpatialStep;
 
 			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
 
@@ -424,7 +464,7 @@ void LitWavesApp::UpdateWaves(const GameTimer& gt)
 		mWaves->Disturb(i, j, r);
 	}
 
-	mWaves->Update(gt.DeltaTime());
+	mWaves->Update(gt.DeltaTime(), *mJobs);
 
 	auto currWavesVB = mCurrFrameResource->WavesVB.get();
 	for (int i = 0; i < mWaves->VertexCount(); ++i)
@@ -441,16 +481,43 @@ void LitWavesApp::UpdateWaves(const GameTimer& gt)
 	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
 }
 
+void LitWavesApp::UpdateWavesGPU(const GameTimer& gt)
+{
+	// Update the wave simulation.
+	if (!mGpuWaves->Update(gt.DeltaTime(), mCommandList.Get(), mWavesRootSignature.Get(), mPSOs["wavesUpdate"].Get()))
+		return;
+
+	// Every quarter second, generate a random wave.  Only right after a step: the
+	// solution it changes is then one no frame has drawn yet.
+	static float t_base = 0.0f;
+	if ((mTimer.TotalTime() - t_base) >= 0.25f)
+	{
+		t_base += 0.25f;
+
+		int i = MathHelper::Rand(4, mGpuWaves->RowCount() - 5);
+		int j = MathHelper::Rand(4, mGpuWaves->ColumnCount() - 5);
+
+		float r = MathHelper::RandF(0.2f, 0.5f);
+
+		mGpuWaves->Disturb(mCommandList.Get(), mWavesRootSignature.Get(), mPSOs["wavesDisturb"].Get(), i, j, r);
+	}
+}
+
 void LitWavesApp::BuildRootSignature()
 {
-	CD3DX12_ROOT_PARAMETER slotRootParameter[3];
+	// Displacement map of the GPU waves, read by the vertex shader.
+	CD3DX12_DESCRIPTOR_RANGE displacementMapTable;
+	displacementMapTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+
+	CD3DX12_ROOT_PARAMETER slotRootParameter[4];
 
 	slotRootParameter[0].InitAsConstantBufferView(0);
 	slotRootParameter[1].InitAsConstantBufferView(1);
 	slotRootParameter[2].InitAsConstantBufferView(2);
+	slotRootParameter[3].InitAsDescriptorTable(1, &displacementMapTable, D3D12_SHADER_VISIBILITY_VERTEX);
 	
 	// A root signature is an arry of root parameter
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(3, slotRootParameter, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
 	ComPtr<ID3DBlob> serializedRootSig = nullptr;
 	ComPtr<ID3DBlob> errorBlob = nullptr;
@@ -471,11 +538,56 @@ void LitWavesApp::BuildRootSignature()
 	));
 }
 
+void LitWavesApp::BuildWavesRootSignature()
+{
+	if (mUseGpuWaves)
+		mGpuWaves->BuildRootSignature(md3dDevice.Get(), mWavesRootSignature);
+}
+
+void LitWavesApp::BuildDescriptorHeaps()
+{
+	// Only the GPU waves need descriptors; keep one slot either way so the heap
+	// can always be set.
+	const UINT wavesDescriptorCount = mUseGpuWaves ? mGpuWaves->DescriptorCount() : 0;
+
+	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
+	srvHeapDesc.NumDescriptors = (std::max)(wavesDescriptorCount, 1u);
+	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
+
+	if (mUseGpuWaves)
+	{
+		mGpuWaves->BuildDescriptors(
+			CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart()),
+			CD3DX12_GPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart()),
+			mCbvSrvDescriptorSize);
+	}
+}
+
+void LitWavesApp::PrecompileShaders()
+{
+	BuildShadersAndInputLayout();
+}
+
 void LitWavesApp::BuildShadersAndInputLayout()
 {
+	const D3D_SHADER_MACRO wavesDefines[] =
+	{
+		"DISPLACEMENT_MAP", "1",
+		NULL, NULL
+	};
+
 	mShaders["standardVS"] = d3dUtil::CompileShader(L"Default.hlsl", nullptr, "VS", "vs_5_0");
 	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Default.hlsl", nullptr, "PS", "ps_5_0");
 
+	if (mUseGpuWaves)
+	{
+		mShaders["wavesVS"] = d3dUtil::CompileShader(L"Default.hlsl", wavesDefines, "VS", "vs_5_0");
+		mShaders["wavesUpdateCS"] = d3dUtil::CompileShader(L"../../Shader/WaveSim.hlsl", nullptr, "UpdateWavesCS", "cs_5_0");
+		mShaders["wavesDisturbCS"] = d3dUtil::CompileShader(L"../../Shader/WaveSim.hlsl", nullptr, "DisturbWavesCS", "cs_5_0");
+	}
+
 	mInputLayout =
 	{
 		{"POSITION",0,DXGI_FORMAT_R32G32B32_FLOAT,0,0,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0},
@@ -534,6 +646,60 @@ void LitWavesApp::BuildLandGeometry()
 
 void LitWavesApp::BuildWavesGeometryBuffers()
 {
+	if (mUseGpuWaves)
+	{
+		// The heights come from the displacement map, so the grid itself never changes
+		// and can live in a default buffer like any other static mesh.
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData grid = geoGen.CreateGrid(
+			(mGpuWaves->ColumnCount() - 1) * mGpuWaves->SpatialStep(),
+			(mGpuWaves->RowCount() - 1) * mGpuWaves->SpatialStep(),
+			mGpuWaves->RowCount(), mGpuWaves->ColumnCount());
+
+		std::vector<Vertex> vertices(grid.Vertices.size());
+		for (size_t i = 0; i < grid.Vertices.size(); ++i)
+		{
+			vertices[i].Pos = grid.Vertices[i].Position;
+			vertices[i].Normal = grid.Vertices[i].Normal;
+		}
+
+		std::vector<std::uint16_t> indices = grid.GetIndices16();
+		assert(vertices.size() < 0x0000ffff);
+
+		UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+		UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+
+		auto geo = std::make_unique<MeshGeometry>();
+		geo->Name = "waterGeo";
+
+		ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+		CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+
+		ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+
+		geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+			mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+
+		geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+			mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+
+		geo->VertexByteStride = sizeof(Vertex);
+		geo->VertexBufferByteSize = vbByteSize;
+		geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+		geo->IndexBufferByteSize = ibByteSize;
+
+		SubmeshGeometry submesh;
+		submesh.IndexCount = (UINT)indices.size();
+		submesh.BaseVertexLocation = 0;
+		submesh.StartIndexLocation = 0;
+
+		geo->DrawArgs["grid"] = submesh;
+
+		mGeometries["waterGeo"] = std::move(geo);
+		return;
+	}
+
 	std::vector<std::uint16_t> indices(3 * mWaves->TriangleCount());
 	assert(mWaves->VertexCount() < 0x0000ffff);
 
@@ -617,6 +783,37 @@ void LitWavesApp::BuildPSOs()
 	opaquePsoDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
 ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+
+	if (mUseGpuWaves)
+	{
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC wavesRenderPSO = opaquePsoDesc;
+		wavesRenderPSO.VS =
+		{
+			reinterpret_cast<BYTE*>(mShaders["wavesVS"]->GetBufferPointer()),
+			mShaders["wavesVS"]->GetBufferSize()
+		};
+		ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&wavesRenderPSO, IID_PPV_ARGS(&mPSOs["wavesRender"])));
+
+		D3D12_COMPUTE_PIPELINE_STATE_DESC wavesDisturbPSO = {};
+		wavesDisturbPSO.pRootSignature = mWavesRootSignature.Get();
+		wavesDisturbPSO.CS =
+		{
+			reinterpret_cast<BYTE*>(mShaders["wavesDisturbCS"]->GetBufferPointer()),
+			mShaders["wavesDisturbCS"]->GetBufferSize()
+		};
+		wavesDisturbPSO.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+		ThrowIfFailed(md3dDevice->CreateComputePipelineState(&wavesDisturbPSO, IID_PPV_ARGS(&mPSOs["wavesDisturb"])));
+
+		D3D12_COMPUTE_PIPELINE_STATE_DESC wavesUpdatePSO = {};
+		wavesUpdatePSO.pRootSignature = mWavesRootSignature.Get();
+		wavesUpdatePSO.CS =
+		{
+			reinterpret_cast<BYTE*>(mShaders["wavesUpdateCS"]->GetBufferPointer()),
+			mShaders["wavesUpdateCS"]->GetBufferSize()
+		};
+		wavesUpdatePSO.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+		ThrowIfFailed(md3dDevice->CreateComputePipelineState(&wavesUpdatePSO, IID_PPV_ARGS(&mPSOs["wavesUpdate"])));
+	}
 }
 
 void LitWavesApp::BuildFrameResources()
@@ -624,7 +821,7 @@ void LitWavesApp::BuildFrameResources()
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
 		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-			1, (UINT)mAllRitems.size(), (UINT)mMaterials.size(), mWaves->VertexCount()));
+			1, (UINT)mAllRitems.size(), (UINT)mMaterials.size(), mUseGpuWaves ? 0 : mWaves->VertexCount()));
 	}
 }
 
@@ -665,7 +862,15 @@ void LitWavesApp::BuildRenderItems()
 
 	mWavesRitem = wavesRitem.get();
 
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(wavesRitem.get());
+	if (mUseGpuWaves)
+	{
+		wavesRitem->GridSpatialStep = mGpuWaves->SpatialStep();
+		mRitemLayer[(int)RenderLayer::GpuWaves].push_back(wavesRitem.get());
+	}
+	else
+	{
+		mRitemLayer[(int)RenderLayer::Opaque].push_back(wavesRitem.get());
+	}
 
 	auto gridRitem = std::make_unique<RenderItem>();
 	gridRitem->World = MathHelper::Identity4x4();
@@ -1,5 +1,5 @@
 #include "Waves.h"
-#include <ppl.h>
+#include "../../Common/JobSystem.h"
 #include <algorithm>
 #include <vector>
 #include <cassert>
@@ -80,7 +80,7 @@ float Waves::Depth()const
 	return mNumRows * mSpatialStep;
 }
 
-void Waves::Update(float dt)
+void Waves::Update(float dt, JobSystem& jobs)
 {
 	static float t = 0.0f;
 
@@ -89,7 +89,7 @@ void Waves::Update(float dt)
 	if (t >= mTimeStep)
 	{
 		// Only update interior points; we use zero boundary conditions.
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
+		jobs.ParallelFor(1, mNumRows - 1, 8, [this](int i)
 			{
 				for (int j = 1; j < mNumCols; ++j)
 				{
@@ -107,7 +107,7 @@ void Waves::Update(float dt)
 
 		t = 0.0f;
 
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
+		jobs.ParallelFor(1, mNumRows - 1, 8, [this](int i)
 			{
 				for (int j = 0; j < mNumCols - 1; ++j)
 				{
@@ -3,6 +3,8 @@
 #include <vector>
 #include <DirectXMath.h>
 
+class JobSystem;
+
 class Waves
 {
 public:
@@ -22,7 +24,7 @@ public:
 	const DirectX::XMFLOAT3& Normal(int i)const { return mNormals[i]; }
 	const DirectX::XMFLOAT3& TangentX(int i)const { return mTangentX[i]; }
 
-	void Update(float dt);
+	void Update(float dt, JobSystem& jobs);
 	void Disturb(int i, int j, float magnitude);
 
 private:
@@ -210,6 +210,7 @@ void BoxApp::Draw(const GameTimer& gt) {
 	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
 
 	// swap the back and front buffers;
+	// the book's D3DApp creates this swap chain, so there is no waitable object or tearing here.
 	ThrowIfFailed(mSwapChain->Present(0, 0));
 	mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
 
@@ -1,8 +1,11 @@
-cbuffer cbPerObject : register(b0)
+struct InstanceData
 {
-    float4x4 gWorld;
+    float4x4 World;
 };
 
+// Bound per batch at the batch's first instance, so SV_InstanceID indexes it directly.
+StructuredBuffer<InstanceData> gInstanceData : register(t0);
+
 cbuffer cbPass : register(b1)
 {
     float4x4 gView;
@@ -33,11 +36,12 @@ struct VertexOut
     float4 Color : COLOR;
 };
 
-VertexOut VS(VertexIn vin)
+VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 {
     VertexOut vout;
     
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4x4 world = gInstanceData[instanceID].World;
+    float4 posW = mul(float4(vin.PosL, 1.0f), world);
     vout.PosH = mul(posW, gViewProj);
     
     vout.Color = vin.Color;
@@ -4,7 +4,9 @@
 #include "../../../Common/MathHelper.h"
 #include "../../../Common/UploadBuffer.h"
 
-struct ObjectConstants {
+// Per-instance data read by the vertex shader through SV_InstanceID.
+// Structured buffer elements need no 256-byte padding, unlike cbuffers.
+struct InstanceData {
 	DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
 };
 
@@ -48,7 +50,7 @@ public:
 	// we cannot update a cbuffer until the GPU is done processing the commands
 	// that reference it. So each frame needs their own cbuffers
 	std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
-	std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
+	std::unique_ptr<UploadBuffer<InstanceData>> InstanceBuffer = nullptr;
 
 	// Fence value to mark commands up to this fence point
 	// check if these frame resource are still in use by the GPU
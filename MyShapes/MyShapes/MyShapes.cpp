@@ -7,6 +7,7 @@
 #include "../../../Common/MathHelper.h"
 #include "../../../Common/UploadBuffer.h"
 #include "../../../Common/GeometryGenerator.h"
+#include "../../Common/MeshFile.h"
 #include "FrameResource.h"
 
 using Microsoft::WRL::ComPtr;
@@ -30,8 +31,8 @@ struct RenderItem {
 	// Thus, when we modify object data we should set NumFramesDirty = gNumFrameResouces so that each frame resource gets the update.
 	int NumFramesDirty = gNumFrameResources;
 
-	// Index into GPU constant buffer corresponding to thevObjectCBfor this render item.
-	// ȾӦ 峣
+	// Index into the per-frame instance buffer.  BuildInstanceBatches() assigns these
+	// so that the items of one batch are contiguous.
 	UINT ObjCBIndex = -1;
 
 	MeshGeometry* Geo = nullptr;
@@ -45,6 +46,21 @@ struct RenderItem {
 	int BaseVertexLocation = 0;
 };
 
+// Render items that share geometry, submesh and topology, drawn with one
+// instanced call.  Their world matrices are InstanceCount consecutive
+// elements of the instance buffer, starting at FirstInstance.
+struct InstanceBatch
+{
+	MeshGeometry* Geo = nullptr;
+	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	UINT IndexCount = 0;
+	UINT StartIndexLocation = 0;
+	int BaseVertexLocation = 0;
+
+	UINT FirstInstance = 0;
+	UINT InstanceCount = 0;
+};
+
 class ShapesApp:public D3DApp
 {
 public:
@@ -66,7 +82,7 @@ private:
 
 	void OnKeyboardInput(const GameTimer& gt);
 	void UpdateCamera(const GameTimer& gt);
-	void UpdateObjectCBs(const GameTimer& gt);
+	void UpdateInstanceData(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 
 	void BuildDescriptorHeaps();
@@ -78,7 +94,8 @@ private:
 	void BuildPSOs();
 	void BuildFrameResources();
 	void BuildRenderItems();
-	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+	void BuildInstanceBatches(std::vector<RenderItem*>& ritems, std::vector<InstanceBatch>& batches);
+	void DrawInstanceBatches(ID3D12GraphicsCommandList* cmdList, const std::vector<InstanceBatch>& batches);
 
 private:
 	std::vector<std::unique_ptr<FrameResource>> mFrameResources;
@@ -101,6 +118,7 @@ private:
 
 	// Rnder items divided by PSO
 	std::vector<RenderItem*> mOpaqueRitems;
+	std::vector<InstanceBatch> mOpaqueBatches;
 
 	PassConstants mMainPassCB;
 
@@ -117,6 +135,9 @@ private:
 	float mRadius = 15.0f;
 
 	POINT mLastMousePos;
+
+	// Waited on by Update() for the frame resource's fence; created once.
+	HANDLE mFrameFenceEvent = nullptr;
 };
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
@@ -144,12 +165,15 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 ShapesApp::ShapesApp(HINSTANCE hInstance)
 	: D3DApp(hInstance)
 {
+	mFrameFenceEvent = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
 }
 
 ShapesApp::~ShapesApp()
 {
 	if (md3dDevice != nullptr)
 		FlushCommandQueue();
+	if (mFrameFenceEvent != nullptr)
+		CloseHandle(mFrameFenceEvent);
 }
 
 bool ShapesApp::Initialize() {
@@ -164,6 +188,7 @@ bool ShapesApp::Initialize() {
 	BuildShapeGeometry(); 
 	BuildSkullGeometry();
 	BuildRenderItems();
+	BuildInstanceBatches(mOpaqueRitems, mOpaqueBatches);
 	BuildFrameResources();
 	BuildDescriptorHeaps();
 	BuildConstantBufferViews();
@@ -199,13 +224,11 @@ void ShapesApp::Update(const GameTimer& gt) {
 	// Has GPU finished processing the commands of the current frame resource?
 	// if not, wait unntil the GPU has completed commands up to this fence point
 	if (mCurrFrameResource->Fence != 0 && mFence->GetCompletedValue() < mCurrFrameResource->Fence) {
-		HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-		ThrowIfFailed(mFence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle));
-		WaitForSingleObject(eventHandle, INFINITE);
-		CloseHandle(eventHandle);
+		ThrowIfFailed(mFence->SetEventOnCompletion(mCurrFrameResource->Fence, mFrameFenceEvent));
+		WaitForSingleObject(mFrameFenceEvent, INFINITE);
 	}
 
-	UpdateObjectCBs(gt);
+	UpdateInstanceData(gt);
 	UpdateMainPassCB(gt);
 }
 
@@ -251,7 +274,7 @@ void ShapesApp::Draw(const GameTimer& gt) {
 	passCbvHandle.Offset(passCbvIndex, mCbvSrvUavDescriptorSize);
 	mCommandList->SetGraphicsRootDescriptorTable(1, passCbvHandle);
 
-	DrawRenderItems(mCommandList.Get(), mOpaqueRitems);
+	DrawInstanceBatches(mCommandList.Get(), mOpaqueBatches);
 
 	// Indicate a state transition on the resource usage
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
@@ -265,6 +288,7 @@ void ShapesApp::Draw(const GameTimer& gt) {
 	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
 
 	// Swap the back and front buffers
+	// The book's D3DApp creates this swap chain, so there is no waitable object or tearing here.
 	ThrowIfFailed(mSwapChain->Present(0, 0));
 	mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
 
@@ -346,21 +370,21 @@ void ShapesApp::UpdateCamera(const GameTimer& gt)
 	XMStoreFloat4x4(&mView, view);
 }
 
-void ShapesApp::UpdateObjectCBs(const GameTimer& gt)
+void ShapesApp::UpdateInstanceData(const GameTimer& gt)
 {
-	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
+	auto currInstanceBuffer = mCurrFrameResource->InstanceBuffer.get();
 	for (auto& e : mAllRitems)
 	{
-		// Only update the cbuffer date if the constants have changed
+		// Only update the instance data if it has changed
 		// This needs to be trancked per frame resource
 		if (e->NumFramesDirty > 0)
 		{
 			XMMATRIX world = XMLoadFloat4x4(&e->World);
 
-			ObjectConstants objConstants;
-			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
+			InstanceData instance;
+			XMStoreFloat4x4(&instance.World, XMMatrixTranspose(world));
 
-			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
+			currInstanceBuffer->CopyData(e->ObjCBIndex, instance);
 
 			// Next FrameResource need to be updated too
 			e->NumFramesDirty--;
@@ -398,14 +422,12 @@ void ShapesApp::UpdateMainPassCB(const GameTimer& gt)
 
 void ShapesApp::BuildDescriptorHeaps()
 {
-	UINT objCount = (UINT)mOpaqueRitems.size();
-
-	// Need a CBV descriptor for each object for each frame resource
-	// +1 for the perPass CBV for each frame resource
-	UINT numDescriptors = (objCount + 1) * gNumFrameResources;
+	// Per-object data comes from the instance buffer, bound as a root SRV,
+	// so only the perPass CBV for each frame resource needs a descriptor.
+	UINT numDescriptors = gNumFrameResources;
 
 	// Save an offset to the start of the pass CBVs
-	mPassCbvOffset = objCount * gNumFrameResources;
+	mPassCbvOffset = 0;
 
 	D3D12_DESCRIPTOR_HEAP_DESC cbvHeapDesc;
 	cbvHeapDesc.NumDescriptors = numDescriptors;
@@ -418,37 +440,9 @@ void ShapesApp::BuildDescriptorHeaps()
 
 void ShapesApp::BuildConstantBufferViews()
 {
-	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
-
-	UINT objCount = (UINT)mOpaqueRitems.size();
-
-	// Need a CBV descriptor for each object for each frame resource
-	for (int frameIndex = 0; frameIndex < gNumFrameResources; ++frameIndex)
-	{
-		auto objectCB = mFrameResources[frameIndex]->ObjectCB->Resource();
-		for (UINT i = 0; i < objCount; ++i)
-		{
-			D3D12_GPU_VIRTUAL_ADDRESS cbAddress = objectCB->GetGPUVirtualAddress();
-
-			// Offset to the ith object constant buffer in the buffer
-			cbAddress += i * objCBByteSize;
-
-			// Offset to the object cbv in the descriptor heap
-			int heapIndex = frameIndex * objCount + i;
-			auto handle = CD3DX12_CPU_DESCRIPTOR_HANDLE(mCbvHeap->GetCPUDescriptorHandleForHeapStart());
-			handle.Offset(heapIndex, mCbvSrvUavDescriptorSize);
-
-			D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDESC;
-			cbvDESC.BufferLocation = cbAddress;
-			cbvDESC.SizeInBytes = objCBByteSize;
-
-			md3dDevice->CreateConstantBufferView(&cbvDESC, handle);
-		}
-	}
-
 	UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
 
-	// Last three descriptors are the pass CBVs for each frame resource.
+	// One pass CBV for each frame resource.
 	for (int frameIndex = 0; frameIndex < gNumFrameResources; ++frameIndex)
 	{
 		auto passCB = mFrameResources[frameIndex]->PassCB->Resource();
@@ -469,17 +463,14 @@ void ShapesApp::BuildConstantBufferViews()
 
 void ShapesApp::BuildRootSignature()
 {
-	CD3DX12_DESCRIPTOR_RANGE cbvTable0;
-	cbvTable0.Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0);
-
 	CD3DX12_DESCRIPTOR_RANGE cbvTable1;
 	cbvTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 1);
 
 	// Root parameter can be a table, root descriptor or root constants
 	CD3DX12_ROOT_PARAMETER slotRootParameter[2];
 
-	// Create root CBVs
-	slotRootParameter[0].InitAsDescriptorTable(1, &cbvTable0);
+	// Root SRV for the instance buffer (t0), offset per batch; table for the pass CBV
+	slotRootParameter[0].InitAsShaderResourceView(0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
 	slotRootParameter[1].InitAsDescriptorTable(1, &cbvTable1);
 
 	// A root signature is an array of root parameter
@@ -519,70 +510,65 @@ void ShapesApp::BuildShadersAndInputLayout()
 
 void ShapesApp::BuildSkullGeometry()
 {
-	// open skull file
-	std::ifstream fin("skull.txt");
-
-	if (!fin)
+	// skull.mesh is written from skull.txt the first time the demo runs,
+	// or again when the Vertex layout changes.
+	MeshFile mesh;
+	if (!mesh.Open(L"skull.mesh", sizeof(Vertex)))
 	{
-		MessageBox(0, L"skull.txt not found.", 0, 0);
-		return;
-	}
-
-	UINT vertexCount = 0;
-	UINT triangleCount = 0;
-	std::string ignore;
-
-	// read vertex, triangle and write them
-	fin >> ignore >> vertexCount;
-	fin >> ignore >> triangleCount;
-	fin >> ignore >> ignore >> ignore >> ignore; // в
-
-	std::vector<Vertex> vertices(vertexCount);
-	for (UINT i = 0; i < vertexCount; ++i)
-	{
-		fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-		fin >> ignore >> ignore >> ignore;	// normal dont read
-		vertices[i].Color = XMFLOAT4(DirectX::Colors::White);
-	}
+		TextMesh text;
+		if (!ImportTextMesh(L"skull.txt", text))
+		{
+			MessageBox(0, L"skull.txt not found.", 0, 0);
+			return;
+		}
 
-	fin >> ignore;
-	fin >> ignore;
-	fin >> ignore;
+		// normals are not used here
+		std::vector<Vertex> vertices(text.Positions.size());
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			vertices[i].Pos = text.Positions[i];
+			vertices[i].Color = XMFLOAT4(DirectX::Colors::White);
+		}
 
-	std::vector<std::int32_t> indices(triangleCount * 3);
-	for (UINT i = 0; i < triangleCount; ++i)
-	{
-		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
+		if (!MeshFile::Write(L"skull.mesh",
+			vertices.data(), sizeof(Vertex), (UINT)vertices.size(),
+			text.Indices.data(), sizeof(std::int32_t), (UINT)text.Indices.size(),
+			text.Bounds) ||
+			!mesh.Open(L"skull.mesh", sizeof(Vertex)))
+		{
+			MessageBox(0, L"skull.mesh could not be written.", 0, 0);
+			return;
+		}
 	}
-	fin.close();
 
-	const UINT vbByteSize = vertices.size() * sizeof(Vertex);
-	const UINT ibByteSize = indices.size() * sizeof(std::int32_t);
+	const UINT vbByteSize = mesh.VertexByteSize();
+	const UINT ibByteSize = mesh.IndexByteSize();
 
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "skullGeo";
 	
 	// copy to CPU
 	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), mesh.Vertices(), vbByteSize);
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), mesh.Indices(), ibByteSize);
 
-	// Copy to GPU
+	// Copy to GPU, straight from the mapped file
 	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+		mCommandList.Get(), mesh.Vertices(), vbByteSize, geo->VertexBufferUploader);
 	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+		mCommandList.Get(), mesh.Indices(), ibByteSize, geo->IndexBufferUploader);
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
 	geo->IndexBufferByteSize = ibByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
+	geo->IndexFormat = mesh.Header().IndexStride == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 
 	SubmeshGeometry skullSubmesh;
 	skullSubmesh.BaseVertexLocation = 0;
 	skullSubmesh.StartIndexLocation = 0;
-	skullSubmesh.IndexCount = (UINT)indices.size();
+	skullSubmesh.IndexCount = mesh.Header().IndexCount;
+	skullSubmesh.Bounds = mesh.Bounds();
 
 	geo->DrawArgs["skull"] = skullSubmesh;
 
@@ -848,28 +834,72 @@ void ShapesApp::BuildRenderItems()
 	}
 }
 
-void ShapesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
+void ShapesApp::BuildInstanceBatches(std::vector<RenderItem*>& ritems, std::vector<InstanceBatch>& batches)
 {
-	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+	// Group the items by what a draw call needs to share.  All items of a
+	// layer use the same PSO, and this demo has no materials.
+	std::vector<std::vector<RenderItem*>> batchItems;
+	batches.clear();
+	for (auto ri : ritems)
+	{
+		size_t b = 0;
+		for (; b < batches.size(); ++b)
+		{
+			const InstanceBatch& batch = batches[b];
+			if (batch.Geo == ri->Geo &&
+				batch.PrimitiveType == ri->PrimitiveType &&
+				batch.IndexCount == ri->IndexCount &&
+				batch.StartIndexLocation == ri->StartIndexLocation &&
+				batch.BaseVertexLocation == ri->BaseVertexLocation)
+				break;
+		}
 
-	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
+		if (b == batches.size())
+		{
+			InstanceBatch batch;
+			batch.Geo = ri->Geo;
+			batch.PrimitiveType = ri->PrimitiveType;
+			batch.IndexCount = ri->IndexCount;
+			batch.StartIndexLocation = ri->StartIndexLocation;
+			batch.BaseVertexLocation = ri->BaseVertexLocation;
+			batches.push_back(batch);
+			batchItems.push_back({});
+		}
 
-	// For each render item
-	for (size_t i = 0; i < ritems.size(); ++i)
+		batchItems[b].push_back(ri);
+	}
+
+	// Give every item its slot in the instance buffer, batch after batch.
+	UINT instanceIndex = 0;
+	for (size_t b = 0; b < batches.size(); ++b)
 	{
-		auto ri = ritems[i];
+		batches[b].FirstInstance = instanceIndex;
+		batches[b].InstanceCount = (UINT)batchItems[b].size();
 
-		cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-		cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
-		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+		for (auto ri : batchItems[b])
+		{
+			ri->ObjCBIndex = instanceIndex++;
+			ri->NumFramesDirty = gNumFrameResources;
+		}
+	}
+}
+
+void ShapesApp::DrawInstanceBatches(ID3D12GraphicsCommandList* cmdList, const std::vector<InstanceBatch>& batches)
+{
+	auto instanceBuffer = mCurrFrameResource->InstanceBuffer->Resource();
 
-		// Offset to the CBV int the descriptor heap for this frame resource
-		UINT cbvIndex = mCurrFrameResourceIndex * (UINT)mOpaqueRitems.size() + ri->ObjCBIndex;
-		auto cbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-		cbvHandle.Offset(cbvIndex, mCbvSrvUavDescriptorSize);
+	// One draw call per batch
+	for (const auto& batch : batches)
+	{
+		cmdList->IASetVertexBuffers(0, 1, &batch.Geo->VertexBufferView());
+		cmdList->IASetIndexBuffer(&batch.Geo->IndexBufferView());
+		cmdList->IASetPrimitiveTopology(batch.PrimitiveType);
 
-		cmdList->SetGraphicsRootDescriptorTable(0, cbvHandle);
+		// SV_InstanceID starts from 0 in every draw, so offset the view to the batch's first instance
+		D3D12_GPU_VIRTUAL_ADDRESS instanceAddress = instanceBuffer->GetGPUVirtualAddress() +
+			batch.FirstInstance * sizeof(InstanceData);
+		cmdList->SetGraphicsRootShaderResourceView(0, instanceAddress);
 
-		cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, ri->StartIndexLocation);
+		cmdList->DrawIndexedInstanced(batch.IndexCount, batch.InstanceCount, batch.StartIndexLocation, batch.BaseVertexLocation, 0);
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,173 @@
+//***************************************************************************************
+// SceneGenerator.cpp
+//
+// Writes synthetic stress scenes in the SceneFile format, for running the demos'
+// culling, LOD, streaming and submission paths at production scale:
+//
+//     SceneGenerator.exe [-instances <n>] [-out <file.scene>] [-seed <n>]
+//
+// -instances takes a plain count or one with a k or m suffix (10k, 100k, 1m); the
+// default is 10k.  StencilDemo loads Models/stress.scene if it exists, so
+//
+//     SceneGenerator.exe -instances 100k -out ../../StencilDemo/StencilDemo/Models/stress.scene
+//
+// puts a hundred thousand skulls behind its mirror wall.  The skulls stand on a square
+// grid in blocks of 8 x 8 under a group node each, with their own rotation, size and
+// one of 16 materials over the demo's three textures.  The same seed writes the same
+// file.
+//***************************************************************************************
+
+#include "../../Common/SceneFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cwctype>
+#include <iostream>
+
+using namespace DirectX;
+
+namespace
+{
+	// A tiny deterministic generator, so the scene does not depend on rand()'s state.
+	struct Lcg
+	{
+		UINT State = 12345;
+
+		UINT Next()
+		{
+			State = State * 1664525u + 1013904223u;
+			return State >> 8;
+		}
+
+		float NextFloat(float a, float b)
+		{
+			return a + (b - a) * (float)(Next() & 0xFFFF) / 65535.0f;
+		}
+	};
+
+	// "10k" -> 10000.  Returns 0 for anything else that is not a count.
+	uint64_t ParseCount(const std::wstring& s)
+	{
+		wchar_t* end = nullptr;
+		uint64_t count = wcstoull(s.c_str(), &end, 10);
+		if (end == s.c_str())
+			return 0;
+
+		std::wstring suffix(end);
+		if (suffix.empty())
+			return count;
+		if (suffix.size() == 1 && std::towlower(suffix[0]) == L'k')
+			return count * 1000;
+		if (suffix.size() == 1 && std::towlower(suffix[0]) == L'm')
+			return count * 1000000;
+		return 0;
+	}
+
+	// The room the demo builds is x in [-3.5, 7.5], z in [-10, 0]; the scene starts
+	// behind its wall, which then occludes the nearest blocks.
+	const float GridOriginX = 2.0f;
+	const float GridStartZ = 4.0f;
+	const float Spacing = 3.0f;
+	const UINT BlockSize = 8;
+	const UINT MaterialCount = 16;
+
+	void BuildScene(SceneWriter& writer, UINT instanceCount, UINT seed)
+	{
+		const uint32_t textures[] =
+		{
+			writer.AddTexture("bricks", "../../Textures/bricks3.dds"),
+			writer.AddTexture("checkboard", "../../Textures/checkboard.dds"),
+			writer.AddTexture("ice", "../../Textures/ice.dds")
+		};
+
+		Lcg lcg;
+		lcg.State = seed;
+
+		uint32_t materials[MaterialCount];
+		for (UINT i = 0; i < MaterialCount; ++i)
+		{
+			XMFLOAT4 albedo(lcg.NextFloat(0.4f, 1.0f), lcg.NextFloat(0.4f, 1.0f), lcg.NextFloat(0.4f, 1.0f), 1.0f);
+			materials[i] = writer.AddMaterial("stress" + std::to_string(i), textures[i % _countof(textures)],
+				albedo, XMFLOAT3(0.05f, 0.05f, 0.05f), lcg.NextFloat(0.2f, 0.8f));
+		}
+
+		const uint32_t skull = writer.AddMesh("skullGeo", "skull");
+
+		// Whole blocks along x, as many rows of them as the count needs.
+		const UINT blockCount = (instanceCount + BlockSize * BlockSize - 1) / (BlockSize * BlockSize);
+		const UINT blocksPerRow = (std::max)(1u, (UINT)std::ceil(std::sqrt((double)blockCount)));
+		const float blockExtent = BlockSize * Spacing;
+		const float gridStartX = GridOriginX - 0.5f * blocksPerRow * blockExtent;
+
+		writer.Reserve(instanceCount + blockCount);
+
+		UINT placed = 0;
+		for (UINT block = 0; block < blockCount; ++block)
+		{
+			SceneInstance group = {};
+			group.Translation = XMFLOAT3(
+				gridStartX + (block % blocksPerRow) * blockExtent,
+				0.0f,
+				GridStartZ + (block / blocksPerRow) * blockExtent);
+			group.Parent = SceneNone;
+			group.Rotation = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+			group.Scale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+			group.Mesh = SceneNone;
+			group.Material = SceneNone;
+			group.Layer = 0;
+			const uint32_t groupIndex = writer.AddInstance(group);
+
+			for (UINT i = 0; i < BlockSize * BlockSize && placed < instanceCount; ++i, ++placed)
+			{
+				float scale = lcg.NextFloat(0.2f, 0.35f);
+
+				SceneInstance instance = {};
+				instance.Translation = XMFLOAT3((i % BlockSize + 0.5f) * Spacing, 1.0f, (i / BlockSize + 0.5f) * Spacing);
+				instance.Parent = groupIndex;
+				XMStoreFloat4(&instance.Rotation, XMQuaternionRotationRollPitchYaw(0.0f, lcg.NextFloat(0.0f, XM_2PI), 0.0f));
+				instance.Scale = XMFLOAT3(scale, scale, scale);
+				instance.Mesh = skull;
+				instance.Material = materials[lcg.Next() % MaterialCount];
+				instance.Layer = 0;     // StencilDemo's opaque layer
+				writer.AddInstance(instance);
+			}
+		}
+	}
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+	uint64_t instanceCount = 10000;
+	std::wstring outFilename = L"stress.scene";
+	UINT seed = 12345;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::wstring arg = argv[i];
+		if (arg == L"-instances")
+			instanceCount = ParseCount(argv[i + 1]);
+		else if (arg == L"-out")
+			outFilename = argv[i + 1];
+		else if (arg == L"-seed")
+			seed = (UINT)_wtoi(argv[i + 1]);
+	}
+
+	// Keeps the instance count, group nodes included, well inside the file's 32-bit fields.
+	if (instanceCount == 0 || instanceCount > 100000000)
+	{
+		std::wcerr << L"-instances must be between 1 and 100m\n";
+		return 1;
+	}
+
+	SceneWriter writer;
+	BuildScene(writer, (UINT)instanceCount, seed);
+
+	if (!writer.Write(outFilename))
+	{
+		std::wcerr << L"Cannot write " << outFilename << L"\n";
+		return 1;
+	}
+
+	std::wcout << L"Wrote " << outFilename << L": " << instanceCount << L" instances in "
+		<< writer.InstanceCount() - instanceCount << L" groups\n";
+	return 0;
+}
@@ -0,0 +1,75 @@
+//=============================================================================
+// ClusteredLighting.hlsl
+//
+// Point and spot lights binned into screen tiles and depth slices by
+// LightClusters.hlsl.  Include after LightingUtil.hlsl.  A pixel shader adds
+// ComputeClusteredLighting() to ComputeLighting(), which then only needs
+// the directional lights of the pass constants.
+//
+// The registers b4, t3, t4 (and u0 for the build pass) are reserved for
+// these resources; see ClusteredLighting.h for the root parameters.
+//=============================================================================
+
+// Must match ClusteredLighting.h.
+#define CLUSTER_TILE_SIZE 64
+#define CLUSTER_DEPTH_SLICES 16
+#define CLUSTER_MAX_LIGHTS 63
+
+cbuffer cbClusters : register(b4)
+{
+    float4x4 gClusterView;
+    float4x4 gClusterInvProj;
+    uint3 gClusterGrid;
+    uint gPointLightCount;
+    float2 gClusterScreenSize;
+    float gClusterSliceScale;
+    float gClusterSliceBias;
+    uint gSpotLightCount;
+    float3 cbClustersPad;
+};
+
+// Point lights first, then spot lights.
+StructuredBuffer<Light> gClusterLights : register(t3);
+
+#ifndef CLUSTER_BUILD
+// Per cluster: the light count, then up to CLUSTER_MAX_LIGHTS light indices.
+StructuredBuffer<uint> gClusterLightLists : register(t4);
+#endif
+
+// Depth slices are spaced exponentially, so near clusters are not stretched.
+uint ClusterSlice(float viewZ)
+{
+    int slice = (int)floor(log(viewZ) * gClusterSliceScale + gClusterSliceBias);
+    return (uint)clamp(slice, 0, CLUSTER_DEPTH_SLICES - 1);
+}
+
+uint ClusterListStart(uint3 cluster)
+{
+    uint index = (cluster.z * gClusterGrid.y + cluster.y) * gClusterGrid.x + cluster.x;
+    return index * (CLUSTER_MAX_LIGHTS + 1);
+}
+
+#ifndef CLUSTER_BUILD
+// screenPos is SV_Position.xy and viewZ the view space depth, i.e. SV_Position.w.
+float3 ComputeClusteredLighting(Material mat, float3 pos, float3 normal, float3 toEye,
+    float2 screenPos, float viewZ)
+{
+    uint2 tile = min((uint2)screenPos / CLUSTER_TILE_SIZE, gClusterGrid.xy - 1);
+    uint listStart = ClusterListStart(uint3(tile, ClusterSlice(viewZ)));
+    uint count = gClusterLightLists[listStart];
+
+    float3 result = 0.0f;
+    for (uint i = 0; i < count; ++i)
+    {
+        uint lightIndex = gClusterLightLists[listStart + 1 + i];
+        Light L = gClusterLights[lightIndex];
+
+        if (lightIndex < gPointLightCount)
+            result += ComputePointLight(L, mat, pos, normal, toEye);
+        else
+            result += ComputeSpotLight(L, mat, pos, normal, toEye);
+    }
+
+    return result;
+}
+#endif
@@ -0,0 +1,91 @@
+//=============================================================================
+// Fxaa.hlsl
+//
+// FxaaCS(): Fast approximate anti-aliasing on the resolved scene, in the
+//     style of FXAA's console variant.  A pixel whose 2x2 neighbourhood has
+//     little luma contrast is copied.  Otherwise the luma gradient gives the
+//     edge direction, and the pixel is blurred along the edge with two or
+//     four bilinear taps.  The wider result is only kept when its luma stays
+//     inside the neighbourhood's range, which keeps thin lines from fading.
+//=============================================================================
+
+cbuffer cbFxaa : register(b0)
+{
+    // 1 / target size.
+    float2 gRcpFrame;
+    float2 gPad;
+};
+
+Texture2D gInput : register(t0);
+RWTexture2D<float4> gOutput : register(u0);
+
+SamplerState gsamLinearClamp : register(s0);
+
+// Larger is fewer pixels filtered: the contrast needed relative to the brightest
+// neighbour, and in absolute terms for dark areas.
+static const float EdgeThreshold = 0.125f;
+static const float EdgeThresholdMin = 0.0312f;
+
+// Longest blur along an edge, in pixels, and how much short edges are reduced.
+static const float SpanMax = 8.0f;
+static const float ReduceMul = 1.0f / 8.0f;
+static const float ReduceMin = 1.0f / 128.0f;
+
+float Luma(float3 rgb)
+{
+    return dot(rgb, float3(0.299f, 0.587f, 0.114f));
+}
+
+float3 SampleScene(float2 uv)
+{
+    return gInput.SampleLevel(gsamLinearClamp, uv, 0.0f).rgb;
+}
+
+[numthreads(8, 8, 1)]
+void FxaaCS(uint3 dispatchThreadID : SV_DispatchThreadID)
+{
+    uint width, height;
+    gOutput.GetDimensions(width, height);
+
+    if (dispatchThreadID.x >= width || dispatchThreadID.y >= height)
+        return;
+
+    float2 uv = (dispatchThreadID.xy + 0.5f) * gRcpFrame;
+
+    // The corner taps each average a 2x2 block of texels.
+    float3 rgbM = gInput[dispatchThreadID.xy].rgb;
+    float lumaM = Luma(rgbM);
+    float lumaNW = Luma(SampleScene(uv + float2(-0.5f, -0.5f) * gRcpFrame));
+    float lumaNE = Luma(SampleScene(uv + float2(0.5f, -0.5f) * gRcpFrame));
+    float lumaSW = Luma(SampleScene(uv + float2(-0.5f, 0.5f) * gRcpFrame));
+    float lumaSE = Luma(SampleScene(uv + float2(0.5f, 0.5f) * gRcpFrame));
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    if (lumaMax - lumaMin < max(EdgeThresholdMin, lumaMax * EdgeThreshold))
+    {
+        gOutput[dispatchThreadID.xy] = float4(rgbM, 1.0f);
+        return;
+    }
+
+    // Perpendicular to the luma gradient, i.e. along the edge.
+    float2 dir;
+    dir.x = -((lumaNW + lumaNE) - (lumaSW + lumaSE));
+    dir.y = ((lumaNW + lumaSW) - (lumaNE + lumaSE));
+
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * (0.25f * ReduceMul), ReduceMin);
+    float rcpDirMin = 1.0f / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, -SpanMax, SpanMax) * gRcpFrame;
+
+    float3 rgbA = 0.5f * (
+        SampleScene(uv + dir * (1.0f / 3.0f - 0.5f)) +
+        SampleScene(uv + dir * (2.0f / 3.0f - 0.5f)));
+    float3 rgbB = rgbA * 0.5f + 0.25f * (
+        SampleScene(uv - dir * 0.5f) +
+        SampleScene(uv + dir * 0.5f));
+
+    float lumaB = Luma(rgbB);
+    float3 result = (lumaB < lumaMin || lumaB > lumaMax) ? rgbA : rgbB;
+    gOutput[dispatchThreadID.xy] = float4(result, 1.0f);
+}
@@ -0,0 +1,249 @@
+//=============================================================================
+// GpuCulling.hlsl
+//
+// CullCS(): One thread per draw record.  Transforms the record's local box
+//     by its object's world matrix, tests it against the frustum planes,
+//     picks a LOD from its projected error, and appends the draw to its
+//     layer's part of the indirect argument buffer.
+//
+//     With occlusion on, the box is also tested against the Hi-Z pyramid
+//     (HiZ.hlsl).  The early phase does the early layers against last
+//     frame's pyramid and only flags what it rejects; the late phase
+//     re-tests the flagged records against this frame's pyramid, appending
+//     the visible ones to the late slot of their layer, and does all the
+//     other layers.
+//=============================================================================
+
+// Must match GpuCulling::MaxLayers and ThreadGroupSize.
+#define MAX_LAYERS 8
+#define THREAD_GROUP_SIZE 64
+
+#define PHASE_EARLY 0
+#define PHASE_LATE 1
+
+// Offsets into gDrawCounts: a pair of draw counts per layer (early, late),
+// then the statistics, as in GpuCulling::Statistics.
+#define STAT_VISIBLE (2 * MAX_LAYERS * 4)
+#define STAT_FRUSTUM_CULLED (STAT_VISIBLE + 4)
+#define STAT_OCCLUDED (STAT_VISIBLE + 8)
+#define STAT_RESCUED (STAT_VISIBLE + 12)
+
+cbuffer cbCull : register(b0)
+{
+    float4 gFrustumPlanes[6];
+
+    // The pyramid's viewProj, transposed like every matrix the shaders read.
+    float4x4 gOcclusionViewProj;
+    float3 gEyePosW;
+    float gPixelScale;
+    uint gRecordCount;
+    uint gObjectByteStride;
+    float gMaxPixelError;
+    uint gPhase;
+    uint gEarlyLayerMask;
+    uint gUseOcclusion;
+    float2 gHiZValidSize;
+    uint4 gLayerFirst[MAX_LAYERS / 4];
+};
+
+struct DrawRecord
+{
+    uint ObjectIndex;
+    uint MaterialIndex;
+    uint Layer;
+    uint FirstLod;
+    float3 BoundsCenter;
+    uint LodCount;
+    float3 BoundsExtents;
+    uint RecordPad;
+};
+
+struct DrawLod
+{
+    uint IndexCount;
+    uint StartIndexLocation;
+    int BaseVertexLocation;
+    float Error;
+};
+
+// The command signature's layout: two root constants, then
+// D3D12_DRAW_INDEXED_ARGUMENTS.
+struct IndirectDraw
+{
+    uint ObjectIndex;
+    uint MaterialIndex;
+    uint IndexCountPerInstance;
+    uint InstanceCount;
+    uint StartIndexLocation;
+    int BaseVertexLocation;
+    uint StartInstanceLocation;
+};
+
+// The caller's object buffer; only the world matrix at the start of each
+// element is read, so any element layout works.
+ByteAddressBuffer gObjects : register(t0);
+StructuredBuffer<DrawRecord> gRecords : register(t1);
+StructuredBuffer<DrawLod> gLods : register(t2);
+
+RWStructuredBuffer<IndirectDraw> gDrawsOut : register(u0);
+RWByteAddressBuffer gDrawCounts : register(u1);
+RWStructuredBuffer<uint> gLateFlags : register(u2);
+
+Texture2D<float> gHiZ : register(t3);
+
+// True if the box is behind the depth in the pyramid everywhere it covers.
+// A box reaching behind the eye is never hidden.
+bool Occluded(float3 centerW, float3 extentsW)
+{
+    float2 uvMin = float2(1.0f, 1.0f);
+    float2 uvMax = float2(0.0f, 0.0f);
+    float nearestZ = 1.0f;
+
+    [unroll]
+    for (uint i = 0; i < 8; ++i)
+    {
+        float3 corner = centerW + extentsW * float3(
+            (i & 1) ? 1.0f : -1.0f,
+            (i & 2) ? 1.0f : -1.0f,
+            (i & 4) ? 1.0f : -1.0f);
+        float4 posH = mul(float4(corner, 1.0f), gOcclusionViewProj);
+        if (posH.w <= 0.0f)
+            return false;
+
+        float3 ndc = posH.xyz / posH.w;
+        float2 uv = float2(ndc.x * 0.5f + 0.5f, 0.5f - ndc.y * 0.5f);
+        uvMin = min(uvMin, uv);
+        uvMax = max(uvMax, uv);
+        nearestZ = min(nearestZ, ndc.z);
+    }
+
+    uvMin = saturate(uvMin);
+    uvMax = saturate(uvMax);
+
+    // The pixels of the scene part of mip 0 the box covers, and the level at
+    // which they span at most two texels per axis.
+    float2 pixelMin = uvMin * gHiZValidSize;
+    float2 pixelMax = uvMax * gHiZValidSize;
+    float2 extent = max(pixelMax - pixelMin, 1.0f);
+    uint width, height, mipCount;
+    gHiZ.GetDimensions(0, width, height, mipCount);
+    uint mip = (uint)min(ceil(log2(max(extent.x, extent.y))), (float)(mipCount - 1));
+
+    uint2 levelSize = uint2(max(width >> mip, 1u), max(height >> mip, 1u));
+    float scale = 1.0f / (float)(1u << mip);
+    uint2 texelMin = min((uint2)(pixelMin * scale), levelSize - 1);
+    uint2 texelMax = min((uint2)(pixelMax * scale), levelSize - 1);
+
+    // The rectangle spans at most two texels; load its corners.
+    float farthest = max(
+        max(gHiZ.Load(int3(texelMin, mip)), gHiZ.Load(int3(texelMax.x, texelMin.y, mip))),
+        max(gHiZ.Load(int3(texelMin.x, texelMax.y, mip)), gHiZ.Load(int3(texelMax, mip))));
+
+    return nearestZ > farthest;
+}
+
+void AppendDraw(DrawRecord record, DrawLod submesh, uint late)
+{
+    uint slot;
+    gDrawCounts.InterlockedAdd((record.Layer * 2 + late) * 4, 1, slot);
+
+    IndirectDraw draw;
+    draw.ObjectIndex = record.ObjectIndex;
+    draw.MaterialIndex = record.MaterialIndex;
+    draw.IndexCountPerInstance = submesh.IndexCount;
+    draw.InstanceCount = 1;
+    draw.StartIndexLocation = submesh.StartIndexLocation;
+    draw.BaseVertexLocation = submesh.BaseVertexLocation;
+    draw.StartInstanceLocation = 0;
+
+    uint first = gLayerFirst[record.Layer / 4][record.Layer % 4] + late * gRecordCount;
+    gDrawsOut[first + slot] = draw;
+
+    uint unused;
+    gDrawCounts.InterlockedAdd(STAT_VISIBLE, 1, unused);
+    if (late)
+        gDrawCounts.InterlockedAdd(STAT_RESCUED, 1, unused);
+}
+
+[numthreads(THREAD_GROUP_SIZE, 1, 1)]
+void CullCS(uint3 dispatchThreadID : SV_DispatchThreadID)
+{
+    if (dispatchThreadID.x >= gRecordCount)
+        return;
+
+    uint index = dispatchThreadID.x;
+    DrawRecord record = gRecords[index];
+
+    bool earlyLayer = (gEarlyLayerMask >> record.Layer) & 1;
+    bool rescue = false;
+    if (gPhase == PHASE_EARLY)
+    {
+        // The other layers wait for the late phase.
+        if (!earlyLayer)
+            return;
+        gLateFlags[index] = 0;
+    }
+    else if (earlyLayer)
+    {
+        // Drawn or frustum culled in the early phase.
+        if (gLateFlags[index] == 0)
+            return;
+        rescue = true;
+    }
+
+    uint unused;
+
+    // The matrix is stored transposed, so these are the columns of World and
+    // a row vector v transforms to (dot(v, c0), dot(v, c1), dot(v, c2)).
+    uint address = record.ObjectIndex * gObjectByteStride;
+    float4 c0 = asfloat(gObjects.Load4(address));
+    float4 c1 = asfloat(gObjects.Load4(address + 16));
+    float4 c2 = asfloat(gObjects.Load4(address + 32));
+
+    float4 centerL = float4(record.BoundsCenter, 1.0f);
+    float3 centerW = float3(dot(centerL, c0), dot(centerL, c1), dot(centerL, c2));
+    float3 extentsW = float3(
+        dot(record.BoundsExtents, abs(c0.xyz)),
+        dot(record.BoundsExtents, abs(c1.xyz)),
+        dot(record.BoundsExtents, abs(c2.xyz)));
+
+    [unroll]
+    for (int i = 0; i < 6; ++i)
+    {
+        float4 plane = gFrustumPlanes[i];
+        float radius = dot(extentsW, abs(plane.xyz));
+        if (dot(plane.xyz, centerW) + plane.w + radius < 0.0f)
+        {
+            gDrawCounts.InterlockedAdd(STAT_FRUSTUM_CULLED, 1, unused);
+            return;
+        }
+    }
+
+    // As MeshSimplifier::SelectLod(), without the hysteresis: the coarsest
+    // level whose error stays under gMaxPixelError pixels.  The largest axis
+    // scale, the length of a row of World, bounds how much the error grows.
+    float3 r0 = float3(c0.x, c1.x, c2.x);
+    float3 r1 = float3(c0.y, c1.y, c2.y);
+    float3 r2 = float3(c0.z, c1.z, c2.z);
+    float worldScale = sqrt(max(dot(r0, r0), max(dot(r1, r1), dot(r2, r2))));
+    float distance = length(centerW - gEyePosW);
+    float pixelsPerUnit = worldScale * gPixelScale / max(distance, 1e-3f);
+
+    uint lod = 0;
+    while (lod + 1 < record.LodCount && gLods[record.FirstLod + lod + 1].Error * pixelsPerUnit < gMaxPixelError)
+        lod++;
+
+    DrawLod submesh = gLods[record.FirstLod + lod];
+
+    if (gUseOcclusion && Occluded(centerW, extentsW))
+    {
+        // Counted once it is final, in the late phase.
+        if (gPhase == PHASE_EARLY)
+            gLateFlags[index] = 1;
+        else
+            gDrawCounts.InterlockedAdd(STAT_OCCLUDED, 1, unused);
+        return;
+    }
+
+    AppendDraw(record, submesh, rescue ? 1 : 0);
+}
@@ -0,0 +1,74 @@
+//=============================================================================
+// HiZ.hlsl
+//
+// CopyDepthCS(): Writes mip 0 of the pyramid from the depth buffer; texels
+//     outside the part the scene was drawn into are far.
+//
+// DownsampleCS(): Writes one level from the level below, keeping the
+//     farthest depth of the texels each one covers.  The last texel of an
+//     odd sized row or column also takes the one left over, so no texel of
+//     the level below is skipped.
+//=============================================================================
+
+cbuffer cbHiZ : register(b0)
+{
+    // Size of the level written, and of the scene part of the depth buffer.
+    uint2 gDstSize;
+    uint2 gValidSize;
+};
+
+Texture2D<float> gDepth : register(t0);
+
+// The level below and the level written; mip 0 is written through gUpper.
+RWTexture2D<float> gUpper : register(u0);
+RWTexture2D<float> gLower : register(u1);
+
+[numthreads(8, 8, 1)]
+void CopyDepthCS(uint3 dispatchThreadID : SV_DispatchThreadID)
+{
+    uint2 texel = dispatchThreadID.xy;
+    if (any(texel >= gDstSize))
+        return;
+
+    bool inScene = all(texel < gValidSize);
+    gUpper[texel] = inScene ? gDepth.Load(int3(texel, 0)) : 1.0f;
+}
+
+float LoadUpper(uint2 texel, uint2 upperSize)
+{
+    return gUpper[min(texel, upperSize - 1)];
+}
+
+[numthreads(8, 8, 1)]
+void DownsampleCS(uint3 dispatchThreadID : SV_DispatchThreadID)
+{
+    uint2 texel = dispatchThreadID.xy;
+    if (any(texel >= gDstSize))
+        return;
+
+    uint2 upperSize;
+    gUpper.GetDimensions(upperSize.x, upperSize.y);
+
+    uint2 base = texel * 2;
+    float depth = max(
+        max(LoadUpper(base, upperSize), LoadUpper(base + uint2(1, 0), upperSize)),
+        max(LoadUpper(base + uint2(0, 1), upperSize), LoadUpper(base + uint2(1, 1), upperSize)));
+
+    bool extraColumn = (upperSize.x & 1) != 0 && texel.x == gDstSize.x - 1;
+    bool extraRow = (upperSize.y & 1) != 0 && texel.y == gDstSize.y - 1;
+
+    if (extraColumn)
+    {
+        depth = max(depth, LoadUpper(base + uint2(2, 0), upperSize));
+        depth = max(depth, LoadUpper(base + uint2(2, 1), upperSize));
+    }
+    if (extraRow)
+    {
+        depth = max(depth, LoadUpper(base + uint2(0, 2), upperSize));
+        depth = max(depth, LoadUpper(base + uint2(1, 2), upperSize));
+    }
+    if (extraColumn && extraRow)
+        depth = max(depth, LoadUpper(base + uint2(2, 2), upperSize));
+
+    gLower[texel] = depth;
+}
@@ -0,0 +1,105 @@
+//=============================================================================
+// LightClusters.hlsl
+//
+// BuildClustersCS(): One thread per cluster.  Bounds the cluster's part of
+//     the view frustum with a view space box and writes the indices of the
+//     lights that can reach it.
+//=============================================================================
+
+#define CLUSTER_BUILD
+
+#include "LightingUtil.hlsl"
+#include "ClusteredLighting.hlsl"
+
+RWStructuredBuffer<uint> gClusterLightListsOut : register(u0);
+
+// View space point at depth viewZ on the ray through a render target pixel.
+float3 ScreenToView(float2 pixel, float viewZ)
+{
+    float2 ndc = float2(pixel.x / gClusterScreenSize.x * 2.0f - 1.0f,
+                        1.0f - pixel.y / gClusterScreenSize.y * 2.0f);
+    float4 p = mul(float4(ndc, 1.0f, 1.0f), gClusterInvProj);
+    p.xyz /= p.w;
+    return p.xyz * (viewZ / p.z);
+}
+
+float SliceDepth(uint slice)
+{
+    return exp((slice - gClusterSliceBias) / gClusterSliceScale);
+}
+
+// A spot light reaches at most the cone where its falloff is above 1/256,
+// tested against the cluster's bounding sphere.
+bool SpotLightReachesSphere(float3 posV, float3 dirV, float range, float spotPower,
+    float3 center, float radius)
+{
+    float cosAngle = exp2(-8.0f / max(spotPower, 1e-3f));
+    float sinAngle = sqrt(1.0f - cosAngle * cosAngle);
+
+    float3 v = center - posV;
+    float vLenSq = dot(v, v);
+    float v1Len = dot(v, dirV);
+    float distanceToCone = cosAngle * sqrt(max(vLenSq - v1Len * v1Len, 0.0f)) - v1Len * sinAngle;
+
+    bool outsideAngle = distanceToCone > radius;
+    bool beyondRange = v1Len > radius + range;
+    bool behind = v1Len < -radius;
+    return !(outsideAngle || beyondRange || behind);
+}
+
+[numthreads(8, 8, 1)]
+void BuildClustersCS(uint3 dispatchThreadID : SV_DispatchThreadID)
+{
+    if (dispatchThreadID.x >= gClusterGrid.x || dispatchThreadID.y >= gClusterGrid.y)
+        return;
+
+    float2 pixelMin = dispatchThreadID.xy * CLUSTER_TILE_SIZE;
+    float2 pixelMax = min(pixelMin + CLUSTER_TILE_SIZE, gClusterScreenSize);
+    float zNear = SliceDepth(dispatchThreadID.z);
+    float zFar = SliceDepth(dispatchThreadID.z + 1);
+
+    float3 boxMin = 1e30f;
+    float3 boxMax = -1e30f;
+    [unroll]
+    for (uint c = 0; c < 8; ++c)
+    {
+        float2 pixel = float2((c & 1) ? pixelMax.x : pixelMin.x, (c & 2) ? pixelMax.y : pixelMin.y);
+        float3 p = ScreenToView(pixel, (c & 4) ? zFar : zNear);
+        boxMin = min(boxMin, p);
+        boxMax = max(boxMax, p);
+    }
+
+    float3 center = 0.5f * (boxMin + boxMax);
+    float radius = length(boxMax - center);
+
+    uint listStart = ClusterListStart(dispatchThreadID);
+    uint lightCount = gPointLightCount + gSpotLightCount;
+    uint count = 0;
+
+    for (uint i = 0; i < lightCount && count < CLUSTER_MAX_LIGHTS; ++i)
+    {
+        Light L = gClusterLights[i];
+        float3 posV = mul(float4(L.Position, 1.0f), gClusterView).xyz;
+
+        bool reaches;
+        if (i < gPointLightCount)
+        {
+            // Distance from the light to the nearest point of the box.
+            float3 d = max(max(boxMin - posV, 0.0f), posV - boxMax);
+            reaches = dot(d, d) <= L.FalloffEnd * L.FalloffEnd;
+        }
+        else
+        {
+            float3 dirV = normalize(mul(L.Direction, (float3x3)gClusterView));
+            reaches = SpotLightReachesSphere(posV, dirV, L.FalloffEnd, L.SpotPower, center, radius);
+        }
+
+        if (reaches)
+        {
+            gClusterLightListsOut[listStart + 1 + count] = i;
+            ++count;
+        }
+    }
+
+    gClusterLightListsOut[listStart] = count;
+}
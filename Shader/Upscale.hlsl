@@ -0,0 +1,44 @@
+//=============================================================================
+// Upscale.hlsl
+//
+// VS()/PS(): Stretches the scaled scene in the top left corner of the scene
+//     target over the whole viewport with one full screen triangle.  The
+//     texture coordinates are clamped half a texel inside the rendered
+//     region, so the bilinear filter never reads the stale texels beyond it.
+//=============================================================================
+
+cbuffer cbUpscale : register(b0)
+{
+    // Rendered size / scene target size.
+    float2 gUvScale;
+
+    // Largest coordinate inside the rendered region.
+    float2 gUvMax;
+};
+
+Texture2D gScene : register(t0);
+
+SamplerState gsamLinearClamp : register(s0);
+
+struct VertexOut
+{
+    float4 PosH : SV_POSITION;
+    float2 TexC : TEXCOORD;
+};
+
+VertexOut VS(uint vertexID : SV_VertexID)
+{
+    VertexOut vout;
+
+    // (0,0), (2,0), (0,2) covers the screen.
+    vout.TexC = float2((vertexID << 1) & 2, vertexID & 2);
+    vout.PosH = float4(vout.TexC * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+
+    return vout;
+}
+
+float4 PS(VertexOut pin) : SV_Target
+{
+    float2 uv = min(pin.TexC * gUvScale, gUvMax);
+    return gScene.SampleLevel(gsamLinearClamp, uv, 0.0f);
+}
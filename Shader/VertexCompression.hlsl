@@ -0,0 +1,36 @@
+//=============================================================================
+// VertexCompression.hlsl
+//
+// Decodes the attributes of Common/VertexQuantizer's compact vertices.  The
+// input assembler has already turned the UNORM/SNORM/half formats into
+// floats; what is left is the position transform and the octahedral unfold.
+//
+// DequantizePosition(): stored * scale + bias, with the scale and bias
+//     VertexQuantizer::PositionTransform() gave for the mesh's box.  Every
+//     shader that draws the same mesh into the same depth buffer must decode
+//     it with exactly this function, so the positions match bit for bit.
+//
+// DecodeOctahedral(): A unit vector from its two octahedral coordinates.
+//=============================================================================
+
+#ifndef VERTEX_COMPRESSION_HLSL
+#define VERTEX_COMPRESSION_HLSL
+
+float3 DequantizePosition(float3 stored, float3 scale, float3 bias)
+{
+    precise float3 posL = mad(stored, scale, bias);
+    return posL;
+}
+
+float3 DecodeOctahedral(float2 e)
+{
+    // SNORM16 gives -1 for both -32768 and -32767.
+    e = max(e, -1.0f);
+
+    float3 n = float3(e, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += n.xy >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+#endif // VERTEX_COMPRESSION_HLSL
@@ -0,0 +1,27 @@
+//=============================================================================
+// WaveDisplacement.hlsl
+//
+// Displaces a flat grid by the wave heights WaveSim.hlsl writes.  Vertex k
+// of the grid (row i = k / width, column j = k % width) reads texel (j, i)
+// of the solution, so the grid needs neither texture coordinates nor a
+// sampler.  Draw the grid with a BaseVertexLocation of 0.
+//=============================================================================
+
+// Returns the wave height at vertexId and writes the normal estimated from
+// the neighbouring heights by finite differences to normalL.
+float WaveHeight(Texture2D displacementMap, uint vertexId, float spatialStep, out float3 normalL)
+{
+    uint width, height;
+    displacementMap.GetDimensions(width, height);
+
+    int2 texel = int2(vertexId % width, vertexId / width);
+    int2 maxTexel = int2(width - 1, height - 1);
+
+    float l = displacementMap.Load(int3(max(texel.x - 1, 0), texel.y, 0)).r;
+    float r = displacementMap.Load(int3(min(texel.x + 1, maxTexel.x), texel.y, 0)).r;
+    float t = displacementMap.Load(int3(texel.x, max(texel.y - 1, 0), 0)).r;
+    float b = displacementMap.Load(int3(texel.x, min(texel.y + 1, maxTexel.y), 0)).r;
+    normalL = normalize(float3(-r + l, 2.0f * spatialStep, b - t));
+
+    return displacementMap.Load(int3(texel, 0)).r;
+}
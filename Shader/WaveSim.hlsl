@@ -0,0 +1,70 @@
+//=============================================================================
+// WaveSim.hlsl
+//
+// UpdateWavesCS(): Solves 2D wave equation using the compute shader.
+//
+// DisturbWavesCS(): Runs one thread to disturb a grid height and its
+//     neighbors to generate a wave.
+//=============================================================================
+
+// For updating the simulation.
+cbuffer cbUpdateSettings : register(b0)
+{
+    float gWaveConstant0;
+    float gWaveConstant1;
+    float gWaveConstant2;
+
+    float gDisturbMag;
+    int2 gDisturbIndex;
+};
+
+// The inputs are SRVs so they stay in a read state another queue can share.
+Texture2D<float>   gPrevSolInput : register(t0);
+Texture2D<float>   gCurrSolInput : register(t1);
+RWTexture2D<float> gOutput       : register(u0);
+
+[numthreads(16, 16, 1)]
+void UpdateWavesCS(int3 dispatchThreadID : SV_DispatchThreadID)
+{
+    // x indexes columns (j), y indexes rows (i), matching Waves::Update.
+    int x = dispatchThreadID.x;
+    int y = dispatchThreadID.y;
+
+    uint width, height;
+    gOutput.GetDimensions(width, height);
+
+    // Only update interior points; we use zero boundary conditions.
+    if (x < 1 || y < 1 || x >= (int)width - 1 || y >= (int)height - 1)
+        return;
+
+    gOutput[int2(x, y)] =
+        gWaveConstant0 * gPrevSolInput[int2(x, y)] +
+        gWaveConstant1 * gCurrSolInput[int2(x, y)] +
+        gWaveConstant2 * (
+            gCurrSolInput[int2(x, y + 1)] +
+            gCurrSolInput[int2(x, y - 1)] +
+            gCurrSolInput[int2(x + 1, y)] +
+            gCurrSolInput[int2(x - 1, y)]);
+}
+
+[numthreads(1, 1, 1)]
+void DisturbWavesCS(int3 groupThreadID : SV_GroupThreadID,
+                    int3 dispatchThreadID : SV_DispatchThreadID)
+{
+    // We do not need to do bounds checking because:
+    //   *out-of-bounds reads return 0, which works for us--it just means the boundary of
+    //    our water simulation is clamped to 0 in local space.
+    //   *out-of-bounds writes are a no-op.
+
+    int x = gDisturbIndex.x;
+    int y = gDisturbIndex.y;
+
+    float halfMag = 0.5f * gDisturbMag;
+
+    // Buffer is RW so operator += is well defined.
+    gOutput[int2(x, y)] += gDisturbMag;
+    gOutput[int2(x + 1, y)] += halfMag;
+    gOutput[int2(x - 1, y)] += halfMag;
+    gOutput[int2(x, y + 1)] += halfMag;
+    gOutput[int2(x, y - 1)] += halfMag;
+}
@@ -7,9 +7,35 @@ FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCo
 		IID_PPV_ARGS(CmdListAlloc.GetAddressOf())
 	));
 
-	PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
-	ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
-	MaterialCB = std::make_unique<UploadBuffer<MaterialConstants>>(device, materialCount, true);
+	LayerCmdLists = std::make_unique<ParallelCommandLists>(device);
+
+	const UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+
+	UINT64 persistentBytes =
+		(UINT64)passCount * d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants)) +
+		(UINT64)objectCount * sizeof(ObjectConstants) + alignment +
+		(UINT64)materialCount * sizeof(MaterialData) + alignment;
+
+	Upload = std::make_unique<LinearUploadAllocator>(device, persistentBytes);
+
+	PassCB = UploadSlice<PassConstants>(*Upload, passCount, true);
+	ObjectBuffer = UploadSlice<ObjectConstants>(*Upload, objectCount, false);
+	MaterialBuffer = UploadSlice<MaterialData>(*Upload, materialCount, false);
+
+	Upload->MarkPersistent();
+}
+
+bool FrameResource::ReserveObjects(UINT objectCount)
+{
+	if (objectCount <= ObjectBuffer.ElementCount())
+		return false;
+
+	// Grow geometrically, so adding items one at a time still moves rarely.  The
+	// old slice is not reused, which wastes at most as much as the new one holds.
+	objectCount = (std::max)(objectCount, 2 * ObjectBuffer.ElementCount());
+	ObjectBuffer = UploadSlice<ObjectConstants>(*Upload, objectCount, false, UploadLifetime::Persistent);
+
+	return true;
 }
 
 FrameResource::~FrameResource()
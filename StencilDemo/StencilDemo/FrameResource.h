@@ -2,12 +2,34 @@
 
 #include "../../Common/d3dUtil.h"
 #include "../../Common/MathHelper.h"
-#include "../../Common/UploadBuffer.h"
+#include "../../Common/LinearUploadAllocator.h"
+#include "../../Common/ParallelCommandLists.h"
 
+// Elements of the per-frame StructuredBuffers; layouts must match StencilShader.hlsl.
 struct ObjectConstants
 {
 	DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
 	DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+
+	// Decodes compact vertex positions: posL = stored * PosScale + PosBias.
+	DirectX::XMFLOAT4 PosScale = { 1.0f, 1.0f, 1.0f, 0.0f };
+	DirectX::XMFLOAT4 PosBias = { 0.0f, 0.0f, 0.0f, 0.0f };
+};
+
+struct MaterialData
+{
+	DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
+	DirectX::XMFLOAT3 FresnelR0 = { 0.01f, 0.01f, 0.01f };
+	float Roughness = 0.25f;
+
+	// Used in texture mapping.
+	DirectX::XMFLOAT4X4 MatTransform = MathHelper::Identity4x4();
+
+	// Index into the unbounded texture table, i.e. the SRV heap.
+	UINT DiffuseMapIndex = 0;
+	UINT MaterialPad0;
+	UINT MaterialPad1;
+	UINT MaterialPad2;
 };
 
 struct PassConstants
@@ -58,11 +80,21 @@ public:
 	FrameResource& operator=(const FrameResource& rhs) = delete;
 	~FrameResource();
 
+	// Makes room for objectCount objects.  Returns true if the object buffer had to
+	// move to a larger slice, in which case every object must be written again.
+	bool ReserveObjects(UINT objectCount);
+
 	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
 
-	std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
-	std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
-	std::unique_ptr<UploadBuffer<MaterialConstants>> MaterialCB = nullptr;
+	// Per-thread lists for recording the render layers in parallel.
+	std::unique_ptr<ParallelCommandLists> LayerCmdLists = nullptr;
+
+	// All of the frame's upload memory; the buffers below are persistent slices of it.
+	std::unique_ptr<LinearUploadAllocator> Upload = nullptr;
+
+	UploadSlice<PassConstants> PassCB;
+	UploadSlice<ObjectConstants> ObjectBuffer;
+	UploadSlice<MaterialData> MaterialBuffer;
 
 	UINT64 Fence = 0;
 };
\ No newline at end of file
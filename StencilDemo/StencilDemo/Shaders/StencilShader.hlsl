@@ -11,8 +11,34 @@
 #endif
 
 #include "../../../Shader/LightingUtil.hlsl"
+#include "../../../Shader/VertexCompression.hlsl"
 
-Texture2D gDiffuseMap : register(t0);
+// Every texture of the demo, indexed by MaterialData::DiffuseMapIndex.
+Texture2D gTextureMaps[] : register(t0);
+
+struct ObjectData
+{
+    float4x4 World;
+    float4x4 TexTransform;
+    float4 PosScale;
+    float4 PosBias;
+};
+
+struct MaterialData
+{
+    float4 DiffuseAlbedo;
+    float3 FresnelR0;
+    float Roughness;
+    float4x4 MatTransform;
+    uint DiffuseMapIndex;
+    uint MatPad0;
+    uint MatPad1;
+    uint MatPad2;
+};
+
+// All objects and materials of the frame; the per-draw root constants pick one of each.
+StructuredBuffer<ObjectData> gObjectData : register(t0, space1);
+StructuredBuffer<MaterialData> gMaterialData : register(t1, space1);
 
 SamplerState gsamPointWrap : register(s0);
 SamplerState gsamPointClamp : register(s1);
@@ -21,10 +47,10 @@ SamplerState gsamLinearClamp : register(s3);
 SamplerState gsamAnisotropicWrap : register(s4);
 SamplerState gsamAnisotropicClamp : register(s5);
 
-cbuffer cbPerObject : register(b0)
+cbuffer cbPerDraw : register(b0)
 {
-    float4x4 gWorld;
-    float4x4 gTexTransform;
+    uint gObjectIndex;
+    uint gMaterialIndex;
 };
 
 cbuffer cbPass : register(b1)
@@ -53,18 +79,17 @@ cbuffer cbPass : register(b1)
     Light Lights[MaxLights];
 };
 
-cbuffer cbMaterial : register(b2)
-{
-    float4 gDiffuseAlbedo;
-    float3 gFresnelR0;
-    float gRoughness;
-    float4x4 gMatTransform;
-};
-
+// With COMPACT_VERTICES the vertices are Common/VertexQuantizer's CompactVertex:
+// the position is relative to PosScale/PosBias, the normal octahedral.  Float
+// vertices get a scale of 1 and a bias of 0, so both decode the same way.
 struct VertexIn
 {
     float3 PosL : POSITION;
+#ifdef COMPACT_VERTICES
+    float2 Normal : NORMAL;
+#else
     float3 Normal : NORMAL;
+#endif
     float2 TexC : TEXCOORD;
 };
 
@@ -79,22 +104,46 @@ struct VertexOut
 VertexOut VS(VertexIn vin)
 {
     VertexOut vout;
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    ObjectData objData = gObjectData[gObjectIndex];
+    MaterialData matData = gMaterialData[gMaterialIndex];
+
+    // precise: DepthVS must produce the same bits for the depth EQUAL test.
+    float3 posL = DequantizePosition(vin.PosL, objData.PosScale.xyz, objData.PosBias.xyz);
+    precise float4 posW = mul(float4(posL, 1.0f), objData.World);
     vout.PosW = posW.xyz;
     
-    vout.NormalW = mul(vin.Normal, (float3x3) gWorld);
+#ifdef COMPACT_VERTICES
+    float3 normalL = DecodeOctahedral(vin.Normal);
+#else
+    float3 normalL = vin.Normal;
+#endif
+    vout.NormalW = mul(normalL, (float3x3) objData.World);
     
-    vout.PosH = mul(posW, gViewProj);
+    precise float4 posH = mul(posW, gViewProj);
+    vout.PosH = posH;
     
-    float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
-    vout.TexC = mul(texC, gMatTransform).xy;
+    float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), objData.TexTransform);
+    vout.TexC = mul(texC, matData.MatTransform).xy;
     
     return vout;
 }
 
+// Position only, for the depth pre-pass.  Transforms exactly like VS.
+float4 DepthVS(float3 posL : POSITION) : SV_POSITION
+{
+    ObjectData objData = gObjectData[gObjectIndex];
+
+    float3 pos = DequantizePosition(posL, objData.PosScale.xyz, objData.PosBias.xyz);
+    precise float4 posW = mul(float4(pos, 1.0f), objData.World);
+    precise float4 posH = mul(posW, gViewProj);
+    return posH;
+}
+
 float4 PS(VertexOut pin):SV_Target
 {
-    float4 diffuseAlbedeo = gDiffuseMap.Sample(gsamAnisotropicWrap, pin.TexC) * gDiffuseAlbedo;
+    MaterialData matData = gMaterialData[gMaterialIndex];
+
+    float4 diffuseAlbedeo = gTextureMaps[matData.DiffuseMapIndex].Sample(gsamAnisotropicWrap, pin.TexC) * matData.DiffuseAlbedo;
     
     #ifdef ALPHA_TEST
         clip(diffuseAlbedeo - 0.1f);
@@ -108,8 +157,8 @@ float4 PS(VertexOut pin):SV_Target
     
     float4 ambient = diffuseAlbedeo * gAmbientLight;
     
-    const float shininess = 1.0f - gRoughness;
-    Material mat = { diffuseAlbedeo, gFresnelR0, shininess };
+    const float shininess = 1.0f - matData.Roughness;
+    Material mat = { diffuseAlbedeo, matData.FresnelR0, shininess };
     float3 shadowFactor = 1.0f;
     float4 directLight = ComputeLighting(Lights, mat, pin.PosW,
     pin.NormalW, toEyeW, shadowFactor);
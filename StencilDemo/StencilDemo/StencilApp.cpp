@@ -7,23 +7,88 @@
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/FrustumCuller.h"
+#include "../../Common/MeshFile.h"
+#include "../../Common/TextureStreamer.h"
+#include "../../Common/TextureConverter.h"
+#include "../../Common/PipelineStateCache.h"
+#include "../../Common/GpuProfiler.h"
+#include "../../Common/DynamicResolution.h"
+#include "../../Common/GeometryPool.h"
+#include "../../Common/RenderQueue.h"
+#include "../../Common/MeshOptimizer.h"
+#include "../../Common/MeshSimplifier.h"
+#include "../../Common/GpuCulling.h"
+#include "../../Common/HiZPyramid.h"
+#include "../../Common/TransformHierarchy.h"
+#include "../../Common/RenderGraph.h"
+#include "../../Common/VertexQuantizer.h"
+#include "../../Common/SceneFile.h"
 #include "FrameResource.h"
+#include <iomanip>
+#include <unordered_set>
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
 using namespace DirectX::PackedVector;
 
-const int gNumFrameResources = 3;
+// Frame resources created unless "-frames <n>" asks for another count.  What
+// sizes the frame resources and the dirty counts at runtime is
+// mNumFrameResources, never this constant.
+const int gDefaultNumFrameResources = 3;
+
+// Only the initial dirty count of d3dUtil.h's Material, which BuildMaterials()
+// overwrites with mNumFrameResources.
+const int gNumFrameResources = gDefaultNumFrameResources;
+
+// Streamed textures are evicted while video memory use is over this fraction of
+// the budget, and come back below the lower one, so they do not flip every frame.
+const float gEvictBudgetFraction = 0.9f;
+const float gRestoreBudgetFraction = 0.8f;
+
+// Render items recorded per command list.  Large layers are split into several
+// lists so they can be recorded on several threads.
+const size_t gRitemsPerCommandList = 256;
+
+// SRVs of the bindless texture table, which starts at the heap start.
+const UINT gSrvHeapCapacity = 64;
+
+const float gFarZ = 1000.0f;
+
+// The key light; it does not move, so neither does the plane it shadows the skull onto.
+const XMFLOAT3 gMainLightDirection = { 0.57735f, -0.57735f, 0.57735f };
+
+// Wall-clock milliseconds, for the initialization timings.
+static double WallClockMs()
+{
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return 1000.0 * (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+// Where VertexQuantizer finds the attributes of a Vertex.
+static VertexAttributes VertexLayout()
+{
+	VertexAttributes attributes;
+	attributes.Stride = sizeof(Vertex);
+	attributes.Position = offsetof(Vertex, Pos);
+	attributes.Normal = offsetof(Vertex, Normal);
+	attributes.TexC = offsetof(Vertex, TexC);
+	return attributes;
+}
 
 struct RenderItem
 {
 	RenderItem() = default;
 
-	XMFLOAT4X4 World = MathHelper::Identity4x4();
+	// Node in mTransforms whose world matrix the item is drawn with.
+	UINT Transform = 0;
 
 	XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
 
-	int NumFrameDirety = gNumFrameResources;
+	// Set by MarkDirty() and BuildRenderItems() to mNumFrameResources.
+	int NumFrameDirety = 0;
 
 	UINT ObjCBIndex = -1;
 
@@ -35,6 +100,14 @@ struct RenderItem
 	UINT IndexCount = 0;
 	UINT StartIndexLocation = 0;
 	int BaseVertexLocation = 0;
+
+	// Local-space bounds of the submesh, tested against the frustum every frame.
+	BoundingBox Bounds;
+
+	// Optional LOD chain, finest first.  CullRenderItems picks one for every
+	// visible item and draws its index range instead of IndexCount/StartIndexLocation.
+	std::vector<SubmeshGeometry> Lods;
+	int CurrentLod = 0;
 };
 
 enum class RenderLayer : int
@@ -47,6 +120,59 @@ enum class RenderLayer : int
 	Count
 };
 
+// Names the GPU profiler reports each layer under.
+const char* const gRenderLayerNames[(int)RenderLayer::Count] =
+{
+	"opaque",
+	"mirrors",
+	"reflected",
+	"transparent",
+	"shadow"
+};
+
+// One visible item as Draw() records it.  The index range is copied because in
+// pipelined mode culling picks the next frame's LOD while this one is drawn.
+struct DrawItem
+{
+	const RenderItem* Item = nullptr;
+	UINT IndexCount = 0;
+	UINT StartIndexLocation = 0;
+};
+
+// Everything Draw() reads that Update() changes.  Update() fills mSimFrame and
+// PublishFrame() swaps it with mDrawFrame.
+struct FrameSnapshot
+{
+	FrameResource* Resource = nullptr;
+	int ResourceIndex = 0;
+
+	// The items of each layer that survived frustum culling, in draw order.
+	std::vector<DrawItem> Visible[(int)RenderLayer::Count];
+
+	// The camera culled against, for the GPU-driven path that culls in Draw().
+	XMFLOAT4X4 ViewProj = MathHelper::Identity4x4();
+	XMFLOAT3 EyePos = { 0.0f, 0.0f, 0.0f };
+	float PixelScale = 1.0f;
+};
+
+// A contiguous range of one layer, recorded into its own command list.
+struct LayerDrawJob
+{
+	RenderLayer Layer = RenderLayer::Opaque;
+	size_t First = 0;
+	size_t Count = 0;
+
+	// The layer's depth pre-pass instead of its lit pass.
+	bool DepthOnly = false;
+
+	// With occlusion culling: the draws only the late phase found visible, and
+	// the job between the phases that builds the Hi-Z pyramid and runs the late one.
+	bool Late = false;
+	bool Occlusion = false;
+
+	UINT GpuScope = 0;
+};
+
 class StencilApp : public D3DApp
 {
 public:
@@ -60,61 +186,215 @@ public:
 private:
 	virtual void OnResize()override;
 	virtual void Update(const GameTimer& gt)override;
+	virtual void PublishFrame()override;
 	virtual void Draw(const GameTimer& gt)override;
+	virtual void PrecompileShaders()override;
 
 	virtual void OnMouseDown(WPARAM btnState, int x, int y)override;
 	virtual void OnMouseUp(WPARAM btnState, int x, int y)override;
 	virtual void OnMouseMove(WPARAM btnState, int x, int y)override;
 
+	virtual std::wstring FrameStatsText()const override;
+	virtual std::vector<FrameTelemetry::ScopeTime> GpuScopeTimes()const override;
+
 	void UpdateCamera(const GameTimer& gt);
+	void CullRenderItems();
+	void SelectLod(RenderItem* ri, FXMVECTOR eyePos, float pixelScale);
 	void OnKeyboardInput(const GameTimer& gt);
+	XMMATRIX SkullWorld()const;
+	void UpdateTransforms();
 	void AnimateMaterials(const GameTimer& gt);
-	void UpdateObjectCBs(const GameTimer& gt);
-	void UpdateMaterialCBs(const GameTimer& gt);
+	void MarkDirty(RenderItem* ri);
+	void MarkDirty(Material* mat);
+	void UpdateObjectBuffer(const GameTimer& gt);
+	void UpdateMaterialBuffer(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 	void UpdateReflectedPassCB(const GameTimer& gt);
 
+	void OpenScene();
 	void LoadTextures();
+	void ConvertTextures();
+	void StreamTextures();
+	void UpdateTextureResidency();
 	void BuildRootSignature();
 	void BuildDescriptorHeaps();
 	void BuildShadersAndInputLayout();
 	void BuildRoomGeometry();
 	void BuildSkullGeometry();
 	void BuildPSOs();
+	void CreatePSOs(bool deferred);
 	void BuildFrameResources();
 	void BuildMaterials();
 	void BuildRenderItems();
-	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritem);
+	void BuildSceneRenderItems();
+	void BuildGpuCulling();
+	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<DrawItem>& items, size_t first, size_t count);
+	void DrawLayerIndirect(ID3D12GraphicsCommandList* cmdList, RenderLayer layer, bool late);
+	void PrepareLayerCommandList(ID3D12GraphicsCommandList* cmdList, RenderLayer layer, bool depthOnly);
 
 	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSamplers();
 
+	// Runs fn and records its wall-clock span as an initialization stage.  May be
+	// called from any thread.
+	template<typename Fn>
+	void TimeInitStage(const char* name, const Fn& fn)
+	{
+		const double start = WallClockMs() - mInitStartMs;
+		fn();
+		const double end = WallClockMs() - mInitStartMs;
+
+		std::lock_guard<std::mutex> lock(mInitStageMutex);
+		mInitStages.push_back({ name, start, end });
+	}
+	void ReportInitStages();
+
 private:
 	std::vector<std::unique_ptr<FrameResource>> mFrameResources;
 	FrameResource* mCurrFrameResource = nullptr;
 	int mCurrFrameResourceIndex = 0;
 
-	UINT mCbvSrvDescriptorSize = 0;
-
 	ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
 	
-	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
-
+	// Every material's texture is an index into this heap.  mPlaceholderSrv is the
+	// white texture materials show while theirs is streamed in or evicted.
+	std::unique_ptr<DescriptorAllocator> mSrvHeap;
+	DescriptorAllocation mPlaceholderSrv;
+
+	// All meshes share the vertex/index buffers of mGeometryPool, which lives in a
+	// page of mGeometryHeap; their initial data goes through mGeometryStaging in one batch.
+	std::unique_ptr<BufferSuballocator> mGeometryHeap;
+	std::unique_ptr<StagingRing> mGeometryStaging;
+	std::unique_ptr<GeometryPool> mGeometryPool;
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
+
+	// The meshes are built on several threads at once; this guards mGeometryPool,
+	// mGeometryStaging and mGeometries while they are.
+	std::mutex mGeometryMutex;
+
+	// Store every mesh as CompactVertex (16 bytes) instead of Vertex (32 bytes),
+	// quantized against its submesh's Bounds; the vertex shaders decode it.
+	bool mUseCompactVertices = true;
+	PositionEncoding mPositionEncoding = PositionEncoding::Unorm16;
+
+	// Instances placed around the room on top of the demo's own items, e.g. a
+	// stress scene written by SceneGenerator.  Loaded if the file exists; it is
+	// only mapped while Initialize() runs.
+	std::wstring mSceneFile = L"Models/stress.scene";
+	SceneFile mScene;
+
 	std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
+
+	// Declared after mTextures so it is destroyed, and waits for its loads, first.
+	std::unique_ptr<TextureStreamer> mTextureStreamer;
+
+	// The textures ConvertTextures() and StreamTextures() load, and the texture
+	// each material samples once it is in.
+	std::vector<std::string> mStreamedTextureNames;
+	std::vector<std::pair<std::string, std::string>> mMaterialTextures;
+
+	// The materials that sample each streamed texture, for residency.
+	std::vector<std::pair<const Material*, Texture*>> mStreamedMaterials;
+
+	// The SRV slot of each resident streamed texture.  An evicted texture's slot
+	// waits in mEvictedSrvs until PublishFrame() knows the last fence value of
+	// the frames that may still index it.
+	std::unordered_map<const Texture*, DescriptorAllocation> mStreamedSrvs;
+	std::vector<DescriptorAllocation> mEvictedSrvs;
+	UINT64 mSimFrameCount = 0;
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 	std::unordered_map < std::string, ComPtr<ID3D12PipelineState>> mPSOs;
 
+	// Every PSO's description, filled in by BuildPSOs().  The first frame only
+	// needs some of them; the deferred ones are created in the background, after
+	// Initialize(), and their layers are skipped until mDeferredPsosReady.
+	struct PsoBuild
+	{
+		std::string Name;
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc;
+		bool Deferred = false;
+	};
+	std::vector<PsoBuild> mPsoBuilds;
+	std::unique_ptr<PipelineStateCache> mPsoCache;
+	concurrency::task<void> mDeferredPsos;
+	std::atomic<bool> mDeferredPsosReady{ false };
+
+	// Layers drawn with a deferred PSO: the reflection and the shadow only appear
+	// a few frames in, the rest of the scene is there from the first one.
+	bool mDeferredLayer[(int)RenderLayer::Count] = { false, false, true, false, true };
+
+	// Wall-clock span of each Initialize() stage, in milliseconds since it began.
+	struct InitStage
+	{
+		const char* Name;
+		double Start;
+		double End;
+	};
+	std::mutex mInitStageMutex;
+	std::vector<InitStage> mInitStages;
+	double mInitStartMs = 0.0;
+	bool mFirstFrameReported = false;
+
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
+	std::vector<D3D12_INPUT_ELEMENT_DESC> mDepthInputLayout;
+
+	// Layers that first lay down their depth with a position-only pass, so their
+	// lit pass tests for EQUAL and shades every pixel once.  Only layers that write
+	// depth without blending or clipping qualify.  The reflection's pre-pass keeps
+	// its stencil test, so it also stays inside the mirror.
+	bool mDepthPrepass[(int)RenderLayer::Count] = { true, false, true, false, false };
 
-	RenderItem* mSkullRitem = nullptr;
-	RenderItem* mReflectedSkullRitem = nullptr;
-	RenderItem* mShadowedSkullRitem = nullptr;
+	// Every item's world matrix.  The reflected and shadowed skulls are derived
+	// from the skull, so moving it moves them.  mTransformRitems maps a node to
+	// the item drawn with it, if any.
+	TransformHierarchy mTransforms;
+	std::vector<RenderItem*> mTransformRitems;
+	UINT mSkullNode = 0;
 
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 
+	// Items and materials whose constants still differ in some frame resource.
+	// Only these are visited by UpdateObjectBuffer/UpdateMaterialBuffer.
+	std::vector<RenderItem*> mDirtyRitems;
+	std::vector<Material*> mDirtyMaterials;
+	bool mDirtyRitemsSorted = false;
+
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
+	FrameSnapshot mSimFrame;
+	FrameSnapshot mDrawFrame;
+
+	FrustumCuller mFrustumCuller;
+	std::vector<UINT8> mCullResults;
+	UINT mCulledRitemCount = 0;
+
+	RenderQueue mRenderQueue;
+
+	// Cull on the GPU and draw every layer with one ExecuteIndirect instead of
+	// culling, sorting and issuing the draws on the CPU.
+	bool mUseGpuCulling = true;
+	std::unique_ptr<GpuCulling> mGpuCulling;
+
+	// Also drop items hidden behind the opaque layer: it is drawn first, reduced
+	// to a Hi-Z pyramid, and the rest of the frame is tested against that.
+	bool mUseOcclusionCulling = true;
+	std::unique_ptr<HiZPyramid> mHiZ;
+
+	std::vector<LayerDrawJob> mLayerDrawJobs;
+
+	// Rebuilt by Draw() every frame; only its transient heap outlives the frame.
+	// mSceneTarget is DynamicResolution's scene target, a transient texture of it.
+	std::unique_ptr<RenderGraph> mRenderGraph;
+	RenderGraph::ResourceHandle mSceneTarget = 0;
+
+	std::unique_ptr<GpuProfiler> mGpuProfiler;
+
+	// Render the scene at a scale that holds this GPU budget and stretch it over
+	// the back buffer.  The scene PSOs assume 4x MSAA is off.
+	bool mUseDynamicResolution = true;
+	float mGpuBudgetMs = 1000.0f / 60.0f;
+	std::unique_ptr<DynamicResolution> mDynamicResolution;
+
 	PassConstants mMainPassCB;
 	PassConstants mReflectedPassCB;
 
@@ -157,11 +437,25 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 StencilApp::StencilApp(HINSTANCE hInstance)
 	:D3DApp(hInstance)
 {
+	mNumFrameResources = gDefaultNumFrameResources;
+	mFrameCountSupported = true;
 
+	// Draw() only reads mDrawFrame and state fixed after initialization.
+	mPipelineSupported = true;
 }
 
 StencilApp::~StencilApp()
 {
+	// The deferred PSOs use the device and the cache.  The task reports its own
+	// errors, so wait() only throws if Initialize() never started it.
+	try
+	{
+		mDeferredPsos.wait();
+	}
+	catch (...)
+	{
+	}
+
 	if (md3dDevice != nullptr)
 		FlushCommandQueue();
 }
@@ -171,134 +465,423 @@ bool StencilApp::Initialize()
 	if (!D3DApp::Initialize())
 		return false;
 
+	mInitStartMs = WallClockMs();
+
 	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
-	mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	// Initialization is a small job graph.  The stages that only need the device
+	// (texture conversion, shaders and root signature, then the PSOs, and the
+	// meshes) run on the job system, while this thread records mCommandList,
+	// which only one thread may do, and builds what depends on nothing else.
+	TimeInitStage("scene file", [this]() { OpenScene(); });
+	TimeInitStage("placeholder texture", [this]() { LoadTextures(); });
+
+	mGeometryHeap = std::make_unique<BufferSuballocator>(md3dDevice.Get());
+	mGeometryStaging = std::make_unique<StagingRing>(md3dDevice.Get(), mCommandQueue.Get());
+	const UINT vertexStride = mUseCompactVertices ? (UINT)sizeof(CompactVertex) : (UINT)sizeof(Vertex);
+	mGeometryPool = std::make_unique<GeometryPool>(*mGeometryHeap, vertexStride, 64 * 1024, 256 * 1024);
+
+	auto textures = mJobs->Submit([this]() { TimeInitStage("texture conversion", [this]() { ConvertTextures(); }); });
+	auto rootSignature = mJobs->Submit([this]() { TimeInitStage("root signature", [this]() { BuildRootSignature(); }); });
+	auto shaders = mJobs->Submit([this]() { TimeInitStage("shaders", [this]() { BuildShadersAndInputLayout(); }); });
+	auto psos = mJobs->Submit([this]() { TimeInitStage("first-frame PSOs", [this]() { BuildPSOs(); }); },
+		{ rootSignature, shaders });
+	auto room = mJobs->Submit([this]() { TimeInitStage("room geometry", [this]() { BuildRoomGeometry(); }); });
+	auto skull = mJobs->Submit([this]() { TimeInitStage("skull geometry", [this]() { BuildSkullGeometry(); }); });
+
+	// Initialize() must not return, or throw, while one of these still runs.
+	const std::vector<JobSystem::JobHandle> initJobs = { textures, rootSignature, shaders, psos, room, skull };
 
-	LoadTextures();
-	BuildRootSignature();
-	BuildDescriptorHeaps();
-	BuildShadersAndInputLayout();
-	BuildRoomGeometry();
-	BuildSkullGeometry();
-	BuildMaterials();
-	BuildRenderItems();
-	BuildFrameResources();
-	BuildPSOs();
+	try
+	{
+		TimeInitStage("descriptors and materials", [this]()
+		{
+			BuildDescriptorHeaps();
+			BuildMaterials();
+		});
 
-	ThrowIfFailed(mCommandList->Close());
-	ID3D12CommandList* cmdsList[] = { mCommandList.Get() };
-	mCommandQueue->ExecuteCommandLists(_countof(cmdsList), cmdsList);
+		mJobs->Wait({ room, skull });
+		TimeInitStage("render items", [this]()
+		{
+			mGeometryStaging->Submit();
+			BuildRenderItems();
+			BuildFrameResources();
+		});
+
+		mJobs->Wait(textures);
+		TimeInitStage("texture streaming", [this]() { StreamTextures(); });
 
-	FlushCommandQueue();
+		mJobs->Wait(rootSignature);
+		if (mUseGpuCulling)
+			TimeInitStage("gpu culling", [this]() { BuildGpuCulling(); });
+
+		mJobs->Wait(initJobs);
+	}
+	catch (...)
+	{
+		try
+		{
+			mJobs->Wait(initJobs);
+		}
+		catch (...)
+		{
+		}
+		throw;
+	}
+
+	// The rest of the PSOs compile while the first frames are drawn.  This is a PPL
+	// task rather than a job: the frame's own Wait() calls would pick a job up on the
+	// main thread and stall a frame for as long as the driver compiles.
+	mDeferredPsos = concurrency::create_task([this]()
+	{
+		try
+		{
+			TimeInitStage("deferred PSOs", [this]() { CreatePSOs(true); });
+			mPsoCache->Save();
+			mDeferredPsosReady = true;
+			ReportInitStages();
+		}
+		catch (DxException& e)
+		{
+			// Their layers stay hidden; the rest of the scene still draws.
+			OutputDebugString((L"Deferred PSOs failed: " + e.ToString() + L"\n").c_str());
+		}
+	});
+
+	mGpuProfiler = std::make_unique<GpuProfiler>(md3dDevice.Get(), mCommandQueue.Get(), mNumFrameResources);
+	mRenderGraph = std::make_unique<RenderGraph>(md3dDevice.Get());
+
+	if (mUseDynamicResolution)
+	{
+		mDynamicResolution = std::make_unique<DynamicResolution>(md3dDevice.Get(), mClientWidth, mClientHeight,
+			mBackBufferFormat, mMainPassCB.FogColor, (UINT)mNumFrameResources);
+		mDynamicResolution->SetBudget(mGpuBudgetMs);
+	}
+
+	TimeInitStage("initial upload", [this]()
+	{
+		ThrowIfFailed(mCommandList->Close());
+		ID3D12CommandList* cmdsList[] = { mCommandList.Get() };
+		mCommandQueue->ExecuteCommandLists(_countof(cmdsList), cmdsList);
+
+		FlushCommandQueue();
+	});
+
+	if (mGpuCulling != nullptr)
+		mGpuCulling->DisposeUploaders();
+
+	ReportInitStages();
 
 	return true;
 }
 
+void StencilApp::ReportInitStages()
+{
+	std::lock_guard<std::mutex> lock(mInitStageMutex);
+
+	std::wostringstream text;
+	text << std::fixed << std::setprecision(1);
+	for (const InitStage& stage : mInitStages)
+	{
+		text << L"init: " << stage.Name << L" " << stage.Start << L"-" << stage.End <<
+			L" ms (" << stage.End - stage.Start << L" ms)\n";
+	}
+	mInitStages.clear();
+	OutputDebugString(text.str().c_str());
+}
+
 void StencilApp::OnResize()
 {
 	D3DApp::OnResize();
 
-	XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f * MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
+	// The scale keeps the aspect ratio, so the projection does not change.
+	XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f * MathHelper::Pi, AspectRatio(), 1.0f, gFarZ);
 	XMStoreFloat4x4(&mProj, P);
+
+	if (mDynamicResolution != nullptr)
+		mDynamicResolution->OnResize(mClientWidth, mClientHeight);
+
+	if (mHiZ != nullptr)
+		mHiZ->OnResize(mDepthStencilBuffer.Get());
 }
 
 void StencilApp::Update(const GameTimer& gt)
 {
-	OnKeyboardInput(gt);
-	UpdateCamera(gt);
-
-	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
+	// The stages run as a job graph.  Input moves the skull and recomputes the
+	// world matrices, so everything that reads them waits for it; culling overlaps
+	// the fence wait below.
+	auto input = mJobs->Submit([this, &gt]()
+	{
+		OnKeyboardInput(gt);
+		UpdateTransforms();
+	});
+	auto camera = mJobs->Submit([this, &gt]() { UpdateCamera(gt); });
+	auto cull = mJobs->Submit([this]() { CullRenderItems(); }, { input, camera });
+
+	++mSimFrameCount;
+	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % mNumFrameResources;
 	mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
+	mSimFrame.Resource = mCurrFrameResource;
+	mSimFrame.ResourceIndex = mCurrFrameResourceIndex;
+
+	WaitForFence(mCurrFrameResource->Fence);
+
+	// Slots of evicted textures come back before the streamer asks for new ones.
+	mSrvHeap->ReleaseCompleted(mFence->GetCompletedValue());
 
-	if (mCurrFrameResource->Fence > 0 && mFence->GetCompletedValue() < mCurrFrameResource->Fence)
+	// Swap in the textures that finished streaming before the material CBs are written.
+	mTextureStreamer->Update();
+
+	// Eviction reads this frame's visible items and may retarget materials, so it
+	// runs after culling and before the material buffer is written.
+	auto residency = mJobs->Submit([this]() { UpdateTextureResidency(); }, { cull });
+
+	auto objects = mJobs->Submit([this, &gt]() { UpdateObjectBuffer(gt); }, { input });
+	auto materials = mJobs->Submit([this, &gt]()
 	{
-		HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-		ThrowIfFailed(mFence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle));
-		WaitForSingleObject(eventHandle, INFINITE);
-		CloseHandle(eventHandle);
-	}
+		AnimateMaterials(gt);
+		UpdateMaterialBuffer(gt);
+	}, { residency });
+	auto pass = mJobs->Submit([this, &gt]()
+	{
+		UpdateMainPassCB(gt);
+		UpdateReflectedPassCB(gt);
+	}, { camera });
+
+	mJobs->Wait({ cull, objects, materials, pass });
+}
 
-	AnimateMaterials(gt);
-	UpdateObjectCBs(gt);
-	UpdateMaterialCBs(gt);
-	UpdateMainPassCB(gt);
-	UpdateReflectedPassCB(gt);
+void StencilApp::PublishFrame()
+{
+	// Swapping keeps the capacity of both snapshots' lists.
+	std::swap(mSimFrame, mDrawFrame);
+
+	// The frame just simulated is the first whose materials no longer point at
+	// the slots evicted in it.  Every frame before it is submitted by now, the
+	// last one with mCurrentFence, so the slots are free once that completes.
+	for (const DescriptorAllocation& srv : mEvictedSrvs)
+		mSrvHeap->FreeDeferred(srv, mCurrentFence);
+	mEvictedSrvs.clear();
 }
 
 void StencilApp::Draw(const GameTimer& gt)
 {
-	auto cmdListAlloc = mCurrFrameResource->CmdListAlloc;
+	FrameResource* frameResource = mDrawFrame.Resource;
+	auto cmdListAlloc = frameResource->CmdListAlloc;
 
 	ThrowIfFailed(cmdListAlloc->Reset());
 
 	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
 
-	mCommandList->RSSetViewports(1, &mScreenViewport);
-	mCommandList->RSSetScissorRects(1, &mScissorRect);
-
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+	// The fence wait in Update() means this frame resource's timestamps are ready.
+	mGpuProfiler->BeginFrame(mDrawFrame.ResourceIndex);
+	UINT frameScope = mGpuProfiler->AddScope("frame");
+	mGpuProfiler->BeginScope(mCommandList.Get(), frameScope);
+
+	// Pick this frame's scale from the last frame read back, before any layer
+	// list reads the viewport.
+	if (mDynamicResolution != nullptr)
+		mDynamicResolution->Update(mGpuProfiler->LatestGpuTime("frame"));
+
+	// The frame is a render graph.  The passes declare what they draw into, and the
+	// graph issues the barriers, returns the back buffer to PRESENT at the end and
+	// places DynamicResolution's scene target in its transient heap.
+	mRenderGraph->Reset(mFence->GetCompletedValue());
+	const RenderGraph::ResourceHandle backBuffer = mRenderGraph->Import("back buffer", CurrentBackBuffer(),
+		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT);
+	const RenderGraph::ResourceHandle depthBuffer = mRenderGraph->Import("depth", mDepthStencilBuffer.Get(),
+		D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+	RenderGraph::ResourceHandle colorTarget = backBuffer;
+	if (mDynamicResolution != nullptr)
+	{
+		RenderGraph::TextureDesc sceneDesc;
+		sceneDesc.Width = mDynamicResolution->TargetWidth();
+		sceneDesc.Height = mDynamicResolution->TargetHeight();
+		sceneDesc.ClearValue = mDynamicResolution->ClearValue();
+		sceneDesc.Format = sceneDesc.ClearValue.Format;
+		mSceneTarget = mRenderGraph->CreateTexture("scene", sceneDesc);
+		colorTarget = mSceneTarget;
+	}
 
 	// RenderTargetView  Ҫл滭ĶDepthStencilView  Ǹ/ģϢ
-	mCommandList->ClearRenderTargetView(CurrentBackBufferView(), (float*)&mMainPassCB.FogColor, 0, nullptr);
-	mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
-
-	// specify the buffers we want to render, look at that StencilView~
-	mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
-
-	ID3D12DescriptorHeap* descriptorHeap[] = { mSrvDescriptorHeap.Get() };
-	mCommandList->SetDescriptorHeaps(_countof(descriptorHeap), descriptorHeap);
-
-	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
-
-	UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
-
-	// Draw opaque items_floors, walls and skull.
-	auto passCB = mCurrFrameResource->PassCB->Resource();
-	mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
-
-	// Mark the visible mirror pixels in the stencil buffer with the value 1
-	mCommandList->OMSetStencilRef(1);
-	mCommandList->SetPipelineState(mPSOs["markStencilMirrors"].Get());
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Mirrors]);
-
-	// Draw the reflection into the mirror only (stencil buffer value is 1)
-	// Note that we must supply a different per-pass constant buffer-one whit light reflect
-	mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress() + 1 * passCBByteSize);
-	mCommandList->SetPipelineState(mPSOs["drawStencilReflections"].Get());
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Reflected]);
+	// Depth is cleared first, in a phase of its own, so the colour target's
+	// transition is split around it.
+	auto clearPass = mRenderGraph->AddPass("clear", [this](ID3D12GraphicsCommandList* cmdList)
+	{
+		cmdList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+	});
+	clearPass.Write(depthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE, true);
+	clearPass.Then([this](ID3D12GraphicsCommandList* cmdList)
+	{
+		if (mDynamicResolution != nullptr)
+			mDynamicResolution->BeginScene(cmdList, mRenderGraph->RenderTargetView(mSceneTarget));
+		else
+			cmdList->ClearRenderTargetView(CurrentBackBufferView(), (float*)&mMainPassCB.FogColor, 0, nullptr);
+	});
+	clearPass.Write(colorTarget, D3D12_RESOURCE_STATE_RENDER_TARGET, true);
+
+	// Write the indirect arguments of every layer before any layer list runs.
+	if (mGpuCulling != nullptr)
+	{
+		UINT cullScope = mGpuProfiler->AddScope("cull");
+		mRenderGraph->AddPass("cull", [this, frameResource, cullScope](ID3D12GraphicsCommandList* cmdList)
+		{
+			mGpuProfiler->BeginScope(cmdList, cullScope);
+			mGpuCulling->Cull(cmdList, mDrawFrame.ResourceIndex,
+				frameResource->ObjectBuffer.GpuAddress(), sizeof(ObjectConstants), mDrawFrame.ViewProj, mDrawFrame.EyePos, mDrawFrame.PixelScale);
+			mGpuProfiler->EndScope(cmdList, cullScope);
+		}).SideEffect();
+	}
 
-	// restore main pass constants and stencil ref
-	mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
-	mCommandList->OMSetStencilRef(0);
+	// done recording the frame's start
+	ThrowIfFailed(mCommandList->Close());
 
-	// draw mirror with transparency so reflection blends through
-	mCommandList->SetPipelineState(mPSOs["transparent"].Get());
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Transparent]);
+	// The layers are drawn in this order: opaque items (floors, walls and skull),
+	// the mirror marked into the stencil buffer, the reflection inside the marked
+	// pixels, the mirror blended on top, and finally the shadows.
+	const RenderLayer drawOrder[] =
+	{
+		RenderLayer::Opaque,
+		RenderLayer::Mirrors,
+		RenderLayer::Reflected,
+		RenderLayer::Transparent,
+		RenderLayer::Shadow
+	};
 
-	// Draw shadows
-	mCommandList->SetPipelineState(mPSOs["shadow"].Get());
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Shadow]);
+	// A layer's depth pre-pass goes right before its lit pass, after everything
+	// that layer depends on (the reflection needs the mirror's stencil mask).
+	// With GPU culling a layer is one ExecuteIndirect, so it is one job.  With
+	// occlusion culling the opaque layer is drawn twice, around the job that
+	// builds the Hi-Z pyramid from its first half and culls the rest against it.
+	const bool occlusion = mGpuCulling != nullptr && mGpuCulling->OcclusionActive();
+	const bool deferredPsosReady = mDeferredPsosReady;
+	mLayerDrawJobs.clear();
+	for (RenderLayer layer : drawOrder)
+	{
+		if (mDeferredLayer[(int)layer] && !deferredPsosReady)
+			continue;
+
+		const size_t itemCount = mGpuCulling != nullptr ?
+			mGpuCulling->LayerRecordCount((UINT)layer) : mDrawFrame.Visible[(int)layer].size();
+		const size_t itemsPerList = mGpuCulling != nullptr ? itemCount : gRitemsPerCommandList;
+		const int phaseCount = occlusion && layer == RenderLayer::Opaque ? 2 : 1;
+		for (int phase = 0; phase < phaseCount; ++phase)
+		{
+			if (phase == 1)
+			{
+				LayerDrawJob job;
+				job.Occlusion = true;
+				job.GpuScope = mGpuProfiler->AddScope("occlusion");
+				mLayerDrawJobs.push_back(job);
+			}
+
+			for (int pass = mDepthPrepass[(int)layer] ? 0 : 1; pass < 2; ++pass)
+			{
+				bool depthOnly = pass == 0;
+				std::string scopeName = gRenderLayerNames[(int)layer];
+				if (depthOnly)
+					scopeName += " depth";
+				if (phase == 1)
+					scopeName += " late";
+
+				for (size_t first = 0; first < itemCount; first += itemsPerList)
+				{
+					LayerDrawJob job;
+					job.Layer = layer;
+					job.First = first;
+					job.Count = std::min(itemsPerList, itemCount - first);
+					job.DepthOnly = depthOnly;
+					job.Late = phase == 1;
+					job.GpuScope = mGpuProfiler->AddScope(scopeName);
+					mLayerDrawJobs.push_back(job);
+				}
+			}
+		}
+	}
 
-	// indicate a state transition on the resource usage
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+	// The part of the depth buffer the scene is drawn into this frame.
+	const UINT sceneWidth = mDynamicResolution != nullptr ? mDynamicResolution->RenderWidth() : (UINT)mClientWidth;
+	const UINT sceneHeight = mDynamicResolution != nullptr ? mDynamicResolution->RenderHeight() : (UINT)mClientHeight;
 
-	// done recording commands
-	ThrowIfFailed(mCommandList->Close());
+	// Every job is a pass of its own.  The Hi-Z build moves the depth buffer to a
+	// shader resource and back by itself, so to the graph it stays a depth target.
+	for (UINT i = 0; i < (UINT)mLayerDrawJobs.size(); ++i)
+	{
+		const LayerDrawJob& job = mLayerDrawJobs[i];
+		const char* passName = job.Occlusion ? "occlusion" : gRenderLayerNames[(int)job.Layer];
+		auto pass = mRenderGraph->AddPass(passName, [this, i, sceneWidth, sceneHeight](ID3D12GraphicsCommandList* cmdList)
+		{
+			const LayerDrawJob& job = mLayerDrawJobs[i];
+			mGpuProfiler->BeginScope(cmdList, job.GpuScope);
+			if (job.Occlusion)
+			{
+				mHiZ->Build(cmdList, sceneWidth, sceneHeight);
+				mGpuCulling->CullLate(cmdList);
+			}
+			else
+			{
+				PrepareLayerCommandList(cmdList, job.Layer, job.DepthOnly);
+				if (mGpuCulling != nullptr)
+					DrawLayerIndirect(cmdList, job.Layer, job.Late);
+				else
+					DrawRenderItems(cmdList, mDrawFrame.Visible[(int)job.Layer], job.First, job.Count);
+			}
+			mGpuProfiler->EndScope(cmdList, job.GpuScope);
+		});
+
+		pass.Write(depthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+		if (job.Occlusion)
+			pass.SideEffect();
+		else
+			pass.Write(colorTarget, D3D12_RESOURCE_STATE_RENDER_TARGET);
+	}
 
-	// add the command list to queue for execution
-	ID3D12CommandList* cmdsList[] = { mCommandList.Get() };
-	mCommandQueue->ExecuteCommandLists(_countof(cmdsList), cmdsList);
+	if (mDynamicResolution != nullptr)
+	{
+		UINT upscaleScope = mGpuProfiler->AddScope("upscale");
+		mRenderGraph->AddPass("upscale", [this, upscaleScope](ID3D12GraphicsCommandList* cmdList)
+		{
+			mGpuProfiler->BeginScope(cmdList, upscaleScope);
+			mDynamicResolution->Upscale(cmdList, mRenderGraph->Resource(mSceneTarget), mDrawFrame.ResourceIndex,
+				CurrentBackBufferView(), mScreenViewport, mScissorRect);
+			mGpuProfiler->EndScope(cmdList, upscaleScope);
+		})
+			.Read(mSceneTarget, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE)
+			.Write(backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET, true);
+	}
 
+	// Record every pass into its own command list on the worker threads.  The
+	// frame's fence is signalled right after Present().
+	mRenderGraph->Compile();
+	auto layerCmdLists = frameResource->LayerCmdLists.get();
+	UINT passCount = mRenderGraph->Record(*mJobs, *layerCmdLists, 0, nullptr, mCurrentFence + 1);
+
+	// The frame scope ends after every pass
+	layerCmdLists->Resize(passCount + 1);
+	ID3D12GraphicsCommandList* finalCmdList = layerCmdLists->Begin(passCount, nullptr);
+	mGpuProfiler->EndScope(finalCmdList, frameScope);
+	mGpuProfiler->EndFrame(finalCmdList);
+	ThrowIfFailed(finalCmdList->Close());
+
+	// add the command lists to queue for execution, in recording order
+	std::vector<ID3D12CommandList*> cmdsList = { mCommandList.Get() };
+	layerCmdLists->Gather(passCount + 1, cmdsList);
+	mCommandQueue->ExecuteCommandLists((UINT)cmdsList.size(), cmdsList.data());
 	// swap the back and front buffers
-	ThrowIfFailed(mSwapChain->Present(0, 0));
-	mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
+	Present();
+
+	if (!mFirstFrameReported)
+	{
+		mFirstFrameReported = true;
+		std::wostringstream text;
+		text << std::fixed << std::setprecision(1) << L"init: first frame presented at " <<
+			WallClockMs() - mInitStartMs << L" ms\n";
+		OutputDebugString(text.str().c_str());
+	}
 
 	// Advance the fence value to mark commands up to this fence point
-	mCurrFrameResource->Fence = ++mCurrentFence;
+	frameResource->Fence = ++mCurrentFence;
 
 	// notify the fence when the gpu completes commands up to this fence point
 	mCommandQueue->Signal(mFence.Get(), mCurrentFence);
@@ -347,6 +930,7 @@ void StencilApp::OnKeyboardInput(const GameTimer& gt)
 {
 	// move the skull
 	const float dt = gt.DeltaTime();
+	const XMFLOAT3 oldTranslation = mSkullTranslation;
 	if (GetAsyncKeyState('A') & 0x8000)
 	{
 		mSkullTranslation.x -= 1.75f * dt;
@@ -366,27 +950,26 @@ void StencilApp::OnKeyboardInput(const GameTimer& gt)
 
 	mSkullTranslation.y = MathHelper::Max(mSkullTranslation.y, 0.0f);
 
+	// Its reflection and shadow follow through the hierarchy.
+	if (XMVector3NotEqual(XMLoadFloat3(&mSkullTranslation), XMLoadFloat3(&oldTranslation)))
+		mTransforms.SetLocal(mSkullNode, SkullWorld());
+}
+
+XMMATRIX StencilApp::SkullWorld()const
+{
 	XMMATRIX skullRotate = XMMatrixRotationY(0.5f * MathHelper::Pi);
 	XMMATRIX skullScale = XMMatrixScaling(0.4f, 0.4f, 0.4f);
 	XMMATRIX skullOffset = XMMatrixTranslation(mSkullTranslation.x, mSkullTranslation.y, mSkullTranslation.z);
-	XMMATRIX skullWorld = skullRotate * skullScale * skullOffset;
-	XMStoreFloat4x4(&mSkullRitem->World, skullWorld);
-
-	// Update reflection world matrix
-	XMVECTOR mirrorPlane = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
-	XMMATRIX R = XMMatrixReflect(mirrorPlane);
-	XMStoreFloat4x4(&mReflectedSkullRitem->World, skullWorld * R);
-
-	// Update shadow world matrix
-	XMVECTOR shadowPlane = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
-	XMVECTOR toMainLight = -XMLoadFloat3(&mMainPassCB.Lights[0].Direction);
-	XMMATRIX S = XMMatrixShadow(shadowPlane, toMainLight);
-	XMMATRIX shadowOffsetY = XMMatrixTranslation(0.0f, 0.001f, 0.0f);
-	XMStoreFloat4x4(&mShadowedSkullRitem->World, skullWorld * S * shadowOffsetY);
+	return skullRotate * skullScale * skullOffset;
+}
 
-	mSkullRitem->NumFrameDirety = gNumFrameResources;
-	mReflectedSkullRitem->NumFrameDirety = gNumFrameResources;
-	mShadowedSkullRitem->NumFrameDirety = gNumFrameResources;
+void StencilApp::UpdateTransforms()
+{
+	for (UINT node : mTransforms.Update())
+	{
+		if (mTransformRitems[node] != nullptr)
+			MarkDirty(mTransformRitems[node]);
+	}
 }
 
 void StencilApp::UpdateCamera(const GameTimer& gt)
@@ -403,53 +986,224 @@ void StencilApp::UpdateCamera(const GameTimer& gt)
 	XMStoreFloat4x4(&mView, view);
 }
 
+void StencilApp::CullRenderItems()
+{
+	// The reflected and shadowed items carry the mirror/shadow transform in
+	// their world matrix, so every layer is tested against the main camera.
+	XMMATRIX view = XMLoadFloat4x4(&mView);
+	XMMATRIX proj = XMLoadFloat4x4(&mProj);
+	mFrustumCuller.SetViewProj(XMMatrixMultiply(view, proj));
+
+	// Converts a world-space error at distance 1 to pixels.
+	XMVECTOR eyePos = XMLoadFloat3(&mEyePos);
+	float pixelScale = mProj(1, 1) * 0.5f * (float)mClientHeight;
+
+	XMStoreFloat4x4(&mSimFrame.ViewProj, XMMatrixMultiply(view, proj));
+	mSimFrame.EyePos = mEyePos;
+	mSimFrame.PixelScale = pixelScale;
+
+	// The GPU-driven path culls and picks LODs in Draw() from the camera above.
+	if (mGpuCulling != nullptr)
+		return;
+
+	mCulledRitemCount = 0;
+	for (int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+	{
+		const auto& ritems = mRitemLayer[layer];
+
+		mFrustumCuller.Clear();
+		for (auto ri : ritems)
+			mFrustumCuller.AddBox(ri->Bounds, mTransforms.World(ri->Transform));
+
+		UINT visibleCount = mFrustumCuller.Cull(mCullResults);
+		mCulledRitemCount += (UINT)ritems.size() - visibleCount;
+
+		// Opaque layers draw front-to-back for early z rejection, blended layers
+		// back-to-front.  Each layer has its own PSO, so the layer doubles as the
+		// PSO id; geometry is grouped by vertex buffer.
+		bool blended = layer == (int)RenderLayer::Transparent || layer == (int)RenderLayer::Shadow;
+
+		mRenderQueue.Clear();
+		for (size_t i = 0; i < ritems.size(); ++i)
+		{
+			if (!mCullResults[i])
+				continue;
+
+			auto ri = ritems[i];
+			if (!ri->Lods.empty())
+				SelectLod(ri, eyePos, pixelScale);
+
+			XMMATRIX worldView = XMMatrixMultiply(mTransforms.World(ri->Transform), view);
+			XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&ri->Bounds.Center), worldView);
+			float depth = XMVectorGetZ(center) / gFarZ;
+
+			UINT geometry = (UINT)(ri->Geo->VertexBufferView().BufferLocation >> 16);
+			UINT material = (UINT)ri->Mat->MatCBIndex;
+
+			UINT64 key = blended ?
+				RenderQueue::TransparentKey(layer, layer, geometry, material, depth) :
+				RenderQueue::OpaqueKey(layer, layer, geometry, material, depth);
+			mRenderQueue.Add(key, (UINT)i);
+		}
+
+		mRenderQueue.Sort();
+
+		auto& visible = mSimFrame.Visible[layer];
+		visible.clear();
+		for (size_t i = 0; i < mRenderQueue.Size(); ++i)
+		{
+			auto ri = ritems[mRenderQueue.Item(i)];
+
+			DrawItem item;
+			item.Item = ri;
+			item.IndexCount = ri->IndexCount;
+			item.StartIndexLocation = ri->StartIndexLocation;
+			if (!ri->Lods.empty())
+			{
+				item.IndexCount = ri->Lods[ri->CurrentLod].IndexCount;
+				item.StartIndexLocation = ri->Lods[ri->CurrentLod].StartIndexLocation;
+			}
+			visible.push_back(item);
+		}
+	}
+}
+
+void StencilApp::SelectLod(RenderItem* ri, FXMVECTOR eyePos, float pixelScale)
+{
+	XMMATRIX world = mTransforms.World(ri->Transform);
+	XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&ri->Bounds.Center), world);
+	float distance = XMVectorGetX(XMVector3Length(center - eyePos));
+
+	// The largest axis scale bounds how much the world matrix can stretch the error.
+	float worldScale = MathHelper::Max(XMVectorGetX(XMVector3Length(world.r[0])),
+		MathHelper::Max(XMVectorGetX(XMVector3Length(world.r[1])), XMVectorGetX(XMVector3Length(world.r[2]))));
+
+	ri->CurrentLod = MeshSimplifier::SelectLod(ri->Lods.data(), (int)ri->Lods.size(),
+		ri->CurrentLod, distance, worldScale, pixelScale);
+}
+
+std::wstring StencilApp::FrameStatsText()const
+{
+	std::wstring scale;
+	if (mDynamicResolution != nullptr)
+		scale = L"   resolution: " + std::to_wstring(mDynamicResolution->RenderWidth()) +
+			L"x" + std::to_wstring(mDynamicResolution->RenderHeight());
+
+	// The GPU-driven path's counters come back a few frames late.
+	std::wstring culled = L"   culled: " + std::to_wstring(mCulledRitemCount) + L"/" + std::to_wstring(mAllRitems.size());
+	if (mGpuCulling != nullptr)
+	{
+		const GpuCulling::Statistics& stats = mGpuCulling->CullStatistics();
+		culled = L"   visible on gpu: " + std::to_wstring(stats.Visible) + L"/" +
+			std::to_wstring(mGpuCulling->RecordCount()) + L" draws";
+		if (mHiZ != nullptr)
+			culled += L"   occluded: " + std::to_wstring(stats.Occluded) +
+				L"   rescued: " + std::to_wstring(stats.Rescued);
+	}
+
+	std::wstring evicted;
+	if (mTextureStreamer->EvictedCount() > 0)
+		evicted = L"   evicted: " + std::to_wstring(mTextureStreamer->EvictedCount()) + L" textures";
+
+	return culled + scale + evicted +
+		L"   gpu " + mGpuProfiler->Summary();
+}
+
+std::vector<FrameTelemetry::ScopeTime> StencilApp::GpuScopeTimes()const
+{
+	std::vector<FrameTelemetry::ScopeTime> times;
+	for (const auto& scope : mGpuProfiler->GpuTimes())
+		times.push_back(FrameTelemetry::ScopeTime(scope.first, mGpuProfiler->LatestGpuTime(scope.first), scope.second));
+	return times;
+}
+
 void StencilApp::AnimateMaterials(const GameTimer& gt)
 {
 
 }
 
-void StencilApp::UpdateObjectCBs(const GameTimer& gt)
+void StencilApp::MarkDirty(RenderItem* ri)
 {
-	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
-	for (auto& e : mAllRitems)
+	// Items still in the list only get their count restored.
+	if (ri->NumFrameDirety == 0)
 	{
-		if (e->NumFrameDirety > 0)
-		{
-			XMMATRIX world = XMLoadFloat4x4(&e->World);
-			XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
+		mDirtyRitems.push_back(ri);
+		mDirtyRitemsSorted = false;
+	}
+	ri->NumFrameDirety = mNumFrameResources;
+}
 
-			ObjectConstants objConstants;
-			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
+void StencilApp::MarkDirty(Material* mat)
+{
+	if (mat->NumFramesDirty == 0)
+		mDirtyMaterials.push_back(mat);
+	mat->NumFramesDirty = mNumFrameResources;
+}
 
-			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
+void StencilApp::UpdateObjectBuffer(const GameTimer& gt)
+{
+	// Items added after the frame resources were built get a larger object
+	// buffer, and everything is written into it again.
+	if (mCurrFrameResource->ReserveObjects((UINT)mAllRitems.size()))
+	{
+		for (auto& e : mAllRitems)
+			MarkDirty(e.get());
+	}
 
-			e->NumFrameDirety--;
-		}
+	// Written in ObjCBIndex order, so runs of neighbouring items stream through
+	// the write-combined upload heap sequentially.
+	if (!mDirtyRitemsSorted)
+	{
+		std::sort(mDirtyRitems.begin(), mDirtyRitems.end(),
+			[](const RenderItem* a, const RenderItem* b) { return a->ObjCBIndex < b->ObjCBIndex; });
+		mDirtyRitemsSorted = true;
 	}
+
+	auto currObjectBuffer = &mCurrFrameResource->ObjectBuffer;
+	size_t stillDirty = 0;
+	for (auto ri : mDirtyRitems)
+	{
+		ObjectConstants* objConstants = currObjectBuffer->MappedElement(ri->ObjCBIndex);
+		MathHelper::StoreTransposedStream(&objConstants->World, mTransforms.World(ri->Transform));
+		MathHelper::StoreTransposedStream(&objConstants->TexTransform, XMLoadFloat4x4(&ri->TexTransform));
+
+		// The box the item's vertices were quantized against is its Bounds.
+		XMFLOAT3 posScale(1.0f, 1.0f, 1.0f), posBias(0.0f, 0.0f, 0.0f);
+		if (mUseCompactVertices)
+			VertexQuantizer::PositionTransform(ri->Bounds, mPositionEncoding, posScale, posBias);
+		objConstants->PosScale = XMFLOAT4(posScale.x, posScale.y, posScale.z, 0.0f);
+		objConstants->PosBias = XMFLOAT4(posBias.x, posBias.y, posBias.z, 0.0f);
+
+		// Compacting in place keeps the list sorted.
+		if (--ri->NumFrameDirety > 0)
+			mDirtyRitems[stillDirty++] = ri;
+	}
+	mDirtyRitems.resize(stillDirty);
+
+	MathHelper::StreamFence();
 }
 /**/
-void StencilApp::UpdateMaterialCBs(const GameTimer& gt)
+void StencilApp::UpdateMaterialBuffer(const GameTimer& gt)
 {
-	auto currMaterialCB = mCurrFrameResource->MaterialCB.get();
-	for (auto& e : mMaterials)
+	auto currMaterialBuffer = &mCurrFrameResource->MaterialBuffer;
+	size_t stillDirty = 0;
+	for (auto mat : mDirtyMaterials)
 	{
-		Material* mat = e.second.get();
-		if (mat->NumFramesDirty > 0)
-		{
-			XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
+		XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
 
-			MaterialConstants matConstants;
-			matConstants.DiffuseAlbedo = mat->DiffuseAlbedo;
-			matConstants.FresnelR0 = mat->FresnelR0;
-			matConstants.Roughness = mat->Roughness;
-			XMStoreFloat4x4(&matConstants.MatTransform, XMMatrixTranspose(matTransform));
+		MaterialData matData;
+		matData.DiffuseAlbedo = mat->DiffuseAlbedo;
+		matData.FresnelR0 = mat->FresnelR0;
+		matData.Roughness = mat->Roughness;
+		XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
+		matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
 
-			currMaterialCB->CopyData(mat->MatCBIndex, matConstants);
+		currMaterialBuffer->CopyData(mat->MatCBIndex, matData);
 
-			mat->NumFramesDirty--;
-		}
+		if (--mat->NumFramesDirty > 0)
+			mDirtyMaterials[stillDirty++] = mat;
 	}
+	mDirtyMaterials.resize(stillDirty);
 }
 
 void StencilApp::UpdateMainPassCB(const GameTimer& gt)
@@ -472,11 +1226,11 @@ void StencilApp::UpdateMainPassCB(const GameTimer& gt)
 	mMainPassCB.RenderTargetSize = XMFLOAT2((float)mClientWidth, (float)mClientHeight);
 	mMainPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / mClientWidth, 1.0f / mClientHeight);
 	mMainPassCB.NearZ = 1.0f;
-	mMainPassCB.FarZ = 1000.0f;
+	mMainPassCB.FarZ = gFarZ;
 	mMainPassCB.TotalTime = gt.TotalTime();
 	mMainPassCB.DeltaTime = gt.DeltaTime();
 	mMainPassCB.AmbientLight = { 0.25f,0.25f,0.35f,1.0f };
-	mMainPassCB.Lights[0].Direction = { 0.57735f, -0.57735f, 0.57735f };
+	mMainPassCB.Lights[0].Direction = gMainLightDirection;
 	mMainPassCB.Lights[0].Strength = { 0.6f,0.6f,0.6f };
 	mMainPassCB.Lights[1].Direction = { -0.57735f, -0.57735f, 0.57735f };
 	mMainPassCB.Lights[1].Strength = { 0.3f,0.3f,0.3f };
@@ -484,7 +1238,7 @@ void StencilApp::UpdateMainPassCB(const GameTimer& gt)
 	mMainPassCB.Lights[2].Strength = { 0.15f,0.15f,0.15f };
 
 	// main passCB in index 0
-	auto currPassCB = mCurrFrameResource->PassCB.get();
+	auto currPassCB = &mCurrFrameResource->PassCB;
 	currPassCB->CopyData(0, mMainPassCB);
 }
 
@@ -503,61 +1257,226 @@ void StencilApp::UpdateReflectedPassCB(const GameTimer& gt)
 	}
 
 	// reflect pass store in index 1
-	auto currPassCB = mCurrFrameResource->PassCB.get();
+	auto currPassCB = &mCurrFrameResource->PassCB;
 	currPassCB->CopyData(1, mReflectedPassCB);
 }
 
+void StencilApp::OpenScene()
+{
+	if (mSceneFile.empty() || GetFileAttributes(mSceneFile.c_str()) == INVALID_FILE_ATTRIBUTES)
+		return;
+
+	if (!mScene.Open(mSceneFile))
+	{
+		MessageBox(0, (mSceneFile + L" could not be read").c_str(), 0, 0);
+		return;
+	}
+
+	// Layers, and names that must be unique among the scene's own, are what
+	// SceneFile cannot check for the demo.
+	bool valid = true;
+	for (uint32_t i = 0; i < mScene.Header().InstanceCount && valid; ++i)
+		valid = mScene.Instances()[i].Layer < (uint32_t)RenderLayer::Count;
+
+	std::unordered_set<std::string> names;
+	for (uint32_t i = 0; i < mScene.Header().TextureCount && valid; ++i)
+		valid = names.insert(mScene.String(mScene.Textures()[i].Name)).second;
+
+	names.clear();
+	for (uint32_t i = 0; i < mScene.Header().MaterialCount && valid; ++i)
+		valid = names.insert(mScene.String(mScene.Materials()[i].Name)).second;
+
+	if (!valid)
+	{
+		MessageBox(0, (mSceneFile + L" has a bad layer or a repeated name").c_str(), 0, 0);
+		mScene.Close();
+	}
+}
+
 void StencilApp::LoadTextures()
 {
+	// These are loaded by StreamTextures(), from the files ConvertTextures()
+	// writes; the materials use white1x1 until then.
 	auto bricksTex = std::make_unique<Texture>();
 	bricksTex->Name = "bricksTex";
 	bricksTex->Filename = L"../../Textures/bricks3.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), bricksTex->Filename.c_str(),
-		bricksTex->Resource, bricksTex->UploadHeap));
 
 	auto checkboardTex = std::make_unique<Texture>();
 	checkboardTex->Name = "checkboardTex";
 	checkboardTex->Filename = L"../../Textures/checkboard.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), checkboardTex->Filename.c_str(),
-		checkboardTex->Resource, checkboardTex->UploadHeap));
 
 	auto iceTex = std::make_unique<Texture>();
 	iceTex->Name = "iceTex";
 	iceTex->Filename = L"../../Textures/ice.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), iceTex->Filename.c_str(),
-		iceTex->Resource, iceTex->UploadHeap));
 
+	// The placeholder is tiny, so it is loaded up front with the geometry.
 	auto white1x1Tex = std::make_unique<Texture>();
 	white1x1Tex->Name = "white1x1Tex";
 	white1x1Tex->Filename = L"../../Textures/white1x1.dds";
 	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
 		mCommandList.Get(), white1x1Tex->Filename.c_str(),
 		white1x1Tex->Resource, white1x1Tex->UploadHeap));
+	TextureConverter::Validate(*white1x1Tex);
+
+	mStreamedTextureNames = { bricksTex->Name, checkboardTex->Name, iceTex->Name };
 
 	mTextures[bricksTex->Name] = std::move(bricksTex);
 	mTextures[checkboardTex->Name] = std::move(checkboardTex);
 	mTextures[iceTex->Name] = std::move(iceTex);
 	mTextures[white1x1Tex->Name] = std::move(white1x1Tex);
+
+	// The scene's textures stream like the demo's own, under names of their own.
+	for (uint32_t i = 0; i < mScene.Header().TextureCount; ++i)
+	{
+		const SceneTexture& sceneTex = mScene.Textures()[i];
+
+		auto tex = std::make_unique<Texture>();
+		tex->Name = std::string("scene/") + mScene.String(sceneTex.Name);
+		tex->Filename = mScene.WideString(sceneTex.Path);
+
+		mStreamedTextureNames.push_back(tex->Name);
+		mTextures[tex->Name] = std::move(tex);
+	}
+}
+
+void StencilApp::ConvertTextures()
+{
+	// The shipped files have no mips, so they are rebuilt once into the texture
+	// cache with a full chain.  Only the Filename of the existing entries changes,
+	// so mTextures itself is not modified while other stages read it.
+	TextureConvertDesc convertDesc;
+	convertDesc.Compression = TextureCompression::BC1;
+
+	std::vector<Texture*> textures;
+	for (const std::string& name : mStreamedTextureNames)
+		textures.push_back(mTextures.at(name).get());
+
+	mJobs->ParallelFor(0, (UINT)textures.size(), 1, [&](UINT i)
+	{
+		textures[i]->Filename = TextureConverter::ConvertCached(textures[i]->Filename, convertDesc);
+	});
+}
+
+void StencilApp::StreamTextures()
+{
+	mTextureStreamer = std::make_unique<TextureStreamer>(md3dDevice.Get());
+
+	// Each streamed texture has its own SRV slot, so the placeholder's descriptor
+	// is never rewritten while frames in flight may still read it.  A texture no
+	// material samples is not loaded.
+	for (const std::string& texName : mStreamedTextureNames)
+	{
+		std::vector<Material*> mats;
+		for (const auto& e : mMaterialTextures)
+		{
+			if (e.second == texName)
+				mats.push_back(mMaterials.at(e.first).get());
+		}
+		if (mats.empty())
+			continue;
+
+		Texture* tex = mTextures.at(texName).get();
+		DescriptorAllocation srv = mSrvHeap->Allocate();
+		mStreamedSrvs[tex] = srv;
+
+		// The texture keeps its slot while it is resident.  Eviction gives the slot
+		// back, so a restored texture takes a new one and gets its SRV again.
+		mTextureStreamer->Request(tex, CD3DX12_CPU_DESCRIPTOR_HANDLE(srv.CPU),
+			[this, mats](Texture* readyTex)
+		{
+			DescriptorAllocation& readySrv = mStreamedSrvs[readyTex];
+			if (readySrv.IsNull())
+			{
+				readySrv = mSrvHeap->Allocate();
+
+				D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+				srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+				srvDesc.Format = readyTex->Resource->GetDesc().Format;
+				srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+				srvDesc.Texture2D.MostDetailedMip = 0;
+				srvDesc.Texture2D.MipLevels = -1;
+				md3dDevice->CreateShaderResourceView(readyTex->Resource.Get(), &srvDesc, readySrv.CPU);
+			}
+
+			for (Material* mat : mats)
+			{
+				mat->DiffuseSrvHeapIndex = (int)readySrv.Index;
+				MarkDirty(mat);
+			}
+		},
+			[this, mats](Texture* evictedTex)
+		{
+			for (Material* mat : mats)
+			{
+				mat->DiffuseSrvHeapIndex = (int)mPlaceholderSrv.Index;
+				MarkDirty(mat);
+			}
+
+			DescriptorAllocation& evictedSrv = mStreamedSrvs[evictedTex];
+			mEvictedSrvs.push_back(evictedSrv);
+			evictedSrv = DescriptorAllocation();
+		});
+
+		for (Material* mat : mats)
+			mStreamedMaterials.push_back(std::make_pair(mat, tex));
+	}
+}
+
+void StencilApp::UpdateTextureResidency()
+{
+	// The materials this frame draws, by MatCBIndex.  The GPU-driven path does not
+	// know what is visible, so to it every item is.
+	std::vector<bool> usedMaterials(mMaterials.size(), false);
+	for (int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+	{
+		if (mGpuCulling != nullptr)
+		{
+			for (auto ri : mRitemLayer[layer])
+				usedMaterials[ri->Mat->MatCBIndex] = true;
+		}
+		else
+		{
+			for (const DrawItem& item : mSimFrame.Visible[layer])
+				usedMaterials[item.Item->Mat->MatCBIndex] = true;
+		}
+	}
+
+	for (const auto& streamed : mStreamedMaterials)
+	{
+		if (usedMaterials[streamed.first->MatCBIndex])
+			mTextureStreamer->Use(streamed.second, mSimFrameCount);
+	}
+
+	// The fence wait in Update() covered the frame that used this frame resource
+	// last, so every frame up to that one is done on the GPU.
+	const UINT64 completedFrame = mSimFrameCount > (UINT64)mNumFrameResources ?
+		mSimFrameCount - mNumFrameResources : 0;
+
+	UINT64 overBudget = mVideoMemory->OverBudget(gEvictBudgetFraction);
+	if (overBudget > 0)
+		mTextureStreamer->Evict(overBudget, completedFrame);
+	else
+		mTextureStreamer->Restore(mVideoMemory->Headroom(gRestoreBudgetFraction));
 }
 /**/
 void StencilApp::BuildRootSignature()
 {
+	// Unbounded: the shader indexes the whole SRV heap with MaterialData::DiffuseMapIndex.
 	CD3DX12_DESCRIPTOR_RANGE texTable;
-	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0, 0);
 
-	CD3DX12_ROOT_PARAMETER slotRootParameter[4];
-	slotRootParameter[0].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
-	slotRootParameter[1].InitAsConstantBufferView(0);
-	slotRootParameter[2].InitAsConstantBufferView(1);
-	slotRootParameter[3].InitAsConstantBufferView(2);
+	// Per draw only the two root constants change; the rest is set once per list.
+	CD3DX12_ROOT_PARAMETER slotRootParameter[5];
+	slotRootParameter[0].InitAsConstants(2, 0);                  // object, material index
+	slotRootParameter[1].InitAsConstantBufferView(1);            // pass
+	slotRootParameter[2].InitAsShaderResourceView(0, 1);         // objects
+	slotRootParameter[3].InitAsShaderResourceView(1, 1);         // materials
+	slotRootParameter[4].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
 
 	auto staticSamplers = GetStaticSamplers();
 
 	// a root signature is an array of root parameters
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(5, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -583,45 +1502,39 @@ void StencilApp::BuildRootSignature()
 
 void StencilApp::BuildDescriptorHeaps()
 {
-	// create srv heap
-	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 4;
-	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
-
-	// fill the heap with actual descriptors
-	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-
-	auto bricksTex = mTextures["bricksTex"]->Resource;
-	auto checkboardTex = mTextures["checkboardTex"]->Resource;
-	auto iceTex = mTextures["iceTex"]->Resource;
+	// create srv heap, with a slot for each of the scene's textures on top
+	mSrvHeap = std::make_unique<DescriptorAllocator>(
+		md3dDevice.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, gSrvHeapCapacity + mScene.Header().TextureCount);
+
+	// The streamed textures take their slots in StreamTextures(); the TextureStreamer
+	// writes each once its texture has been uploaded.
 	auto white1x1Tex = mTextures["white1x1Tex"]->Resource;
 
+	mPlaceholderSrv = mSrvHeap->Allocate();
+	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mPlaceholderSrv.CPU);
+
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = bricksTex->GetDesc().Format;
+	srvDesc.Format = white1x1Tex->GetDesc().Format;
 	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
 	srvDesc.Texture2D.MostDetailedMip = 0;
 	srvDesc.Texture2D.MipLevels = -1;
-	md3dDevice->CreateShaderResourceView(bricksTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	srvDesc.Format = checkboardTex->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(checkboardTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	srvDesc.Format = iceTex->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(iceTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	srvDesc.Format = white1x1Tex->GetDesc().Format;
 	md3dDevice->CreateShaderResourceView(white1x1Tex.Get(), &srvDesc, hDescriptor);
 }
 
+void StencilApp::PrecompileShaders()
+{
+	// Both vertex formats, so turning mUseCompactVertices off finds its shaders
+	// cached too.
+	const bool useCompactVertices = mUseCompactVertices;
+	for (bool compact : { true, false })
+	{
+		mUseCompactVertices = compact;
+		BuildShadersAndInputLayout();
+	}
+	mUseCompactVertices = useCompactVertices;
+}
+
 void StencilApp::BuildShadersAndInputLayout()
 {
 	const D3D_SHADER_MACRO defines[] =
@@ -637,16 +1550,56 @@ void StencilApp::BuildShadersAndInputLayout()
 		NULL,NULL
 	};
 
-	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\StencilShader.hlsl", nullptr, "VS", "vs_5_0");
-	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\StencilShader.hlsl", defines, "PS", "ps_5_0");
-	mShaders["alphaTestedPS"] = d3dUtil::CompileShader(L"Shaders\\StencilShader.hlsl", alphaTestDefines, "PS", "ps_5_0");
+	const D3D_SHADER_MACRO compactVertexDefines[] =
+	{
+		"COMPACT_VERTICES","1",
+		NULL,NULL
+	};
+	const D3D_SHADER_MACRO* vsDefines = mUseCompactVertices ? compactVertexDefines : nullptr;
+
+	struct ShaderBuild
+	{
+		const char* Name;
+		const D3D_SHADER_MACRO* Defines;
+		const char* EntryPoint;
+		const char* Target;
+	};
 
-	mInputLayout =
+	// Shader model 5.1 for the unbounded texture array.
+	const ShaderBuild shaderBuilds[] =
 	{
-		{"POSITION",0,DXGI_FORMAT_R32G32B32_FLOAT,0,0,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0},
-		{"NORMAL",0,DXGI_FORMAT_R32G32B32_FLOAT,0,12,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0},
-		{"TEXCOORD",0,DXGI_FORMAT_R32G32_FLOAT,0,24,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0}
+		{ "standardVS", vsDefines, "VS", "vs_5_1" },
+		{ "opaquePS", defines, "PS", "ps_5_1" },
+		{ "alphaTestedPS", alphaTestDefines, "PS", "ps_5_1" },
+		{ "depthVS", vsDefines, "DepthVS", "vs_5_1" }
 	};
+
+	// Each variant compiles on its own thread; mShaders is filled in afterwards.
+	ComPtr<ID3DBlob> blobs[_countof(shaderBuilds)];
+	mJobs->ParallelFor(0, _countof(shaderBuilds), 1, [&](UINT i)
+	{
+		blobs[i] = d3dUtil::CompileShader(L"Shaders\\StencilShader.hlsl",
+			shaderBuilds[i].Defines, shaderBuilds[i].EntryPoint, shaderBuilds[i].Target);
+	});
+	for (UINT i = 0; i < _countof(shaderBuilds); ++i)
+		mShaders[shaderBuilds[i].Name] = blobs[i];
+
+	if (mUseCompactVertices)
+	{
+		mInputLayout = VertexQuantizer::InputLayout(mPositionEncoding, false);
+	}
+	else
+	{
+		mInputLayout =
+		{
+			{"POSITION",0,DXGI_FORMAT_R32G32B32_FLOAT,0,0,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0},
+			{"NORMAL",0,DXGI_FORMAT_R32G32B32_FLOAT,0,12,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0},
+			{"TEXCOORD",0,DXGI_FORMAT_R32G32_FLOAT,0,24,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0}
+		};
+	}
+
+	// Reads the same vertex buffers; the stride comes from the buffer view.
+	mDepthInputLayout = { mInputLayout[0] };
 }
 
 void StencilApp::BuildRoomGeometry()
@@ -716,125 +1669,199 @@ void StencilApp::BuildRoomGeometry()
 		16, 18, 19
 	};
 
+	// The floor, wall and mirror use consecutive vertex ranges, which is
+	// all the bounds need.
 	SubmeshGeometry floorSubmesh;
 	floorSubmesh.IndexCount = 6;
 	floorSubmesh.StartIndexLocation = 0;
 	floorSubmesh.BaseVertexLocation = 0;
+	BoundingBox::CreateFromPoints(floorSubmesh.Bounds, 4, &vertices[0].Pos, sizeof(Vertex));
 
 	SubmeshGeometry wallSubmesh;
 	wallSubmesh.IndexCount = 18;
 	wallSubmesh.StartIndexLocation = 6;
 	wallSubmesh.BaseVertexLocation = 0;
+	BoundingBox::CreateFromPoints(wallSubmesh.Bounds, 12, &vertices[4].Pos, sizeof(Vertex));
 
 	SubmeshGeometry mirrorSubmesh;
 	mirrorSubmesh.IndexCount = 6;
 	mirrorSubmesh.StartIndexLocation = 24;
 	mirrorSubmesh.BaseVertexLocation = 0;
+	BoundingBox::CreateFromPoints(mirrorSubmesh.Bounds, 4, &vertices[16].Pos, sizeof(Vertex));
+
+	// Each range is quantized against its own submesh's bounds, the box its
+	// render item decodes with.
+	std::array<CompactVertex, 20> compactVertices;
+	if (mUseCompactVertices)
+	{
+		const VertexAttributes attributes = VertexLayout();
+		VertexQuantizer::Quantize(&vertices[0], attributes, 4, floorSubmesh.Bounds, mPositionEncoding, &compactVertices[0]);
+		VertexQuantizer::Quantize(&vertices[4], attributes, 12, wallSubmesh.Bounds, mPositionEncoding, &compactVertices[4]);
+		VertexQuantizer::Quantize(&vertices[16], attributes, 4, mirrorSubmesh.Bounds, mPositionEncoding, &compactVertices[16]);
+	}
+	const void* vertexData = mUseCompactVertices ? (const void*)compactVertices.data() : (const void*)vertices.data();
 
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+	const UINT vbByteSize = (UINT)vertices.size() * mGeometryPool->VertexByteStride();
 	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "roomGeo";
 
 	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertexData, vbByteSize);
 
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
-	geo->VertexByteStride = sizeof(Vertex);
-	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
-	geo->IndexBufferByteSize = ibByteSize;
-
 	geo->DrawArgs["floor"] = floorSubmesh;
 	geo->DrawArgs["wall"] = wallSubmesh;
 	geo->DrawArgs["mirror"] = mirrorSubmesh;
 
+	std::lock_guard<std::mutex> lock(mGeometryMutex);
+	mGeometryPool->AddMesh(*mGeometryStaging, *geo,
+		vertexData, (UINT)vertices.size(),
+		indices.data(), (UINT)indices.size(), sizeof(std::uint16_t));
+
 	mGeometries[geo->Name] = std::move(geo);
 }
 
 void StencilApp::BuildSkullGeometry()
 {
-	std::ifstream fin("Models/skull.txt");
+	// Models/skull.mesh is written from Models/skull.txt the first time the demo
+	// runs, or again when the Vertex layout or the compact format changes.
+	const UINT vertexStride = mGeometryPool->VertexByteStride();
+	const uint32_t vertexFormat = mUseCompactVertices ? VertexQuantizer::MeshFileFormat(mPositionEncoding, false) : 0;
 
-	if (!fin)
+	MeshFile mesh;
+	if (!mesh.Open(L"Models/skull.mesh", vertexStride, vertexFormat))
 	{
-		MessageBox(0, L"Models/skull.txt not found", 0, 0);
-		return;
-	}
+		TextMesh text;
+		if (!ImportTextMesh(L"Models/skull.txt", text))
+		{
+			MessageBox(0, L"Models/skull.txt not found", 0, 0);
+			return;
+		}
 
-	UINT vcount = 0;
-	UINT tcount = 0;
-	std::string ignore;
+		std::vector<Vertex> vertices(text.Positions.size());
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			vertices[i].Pos = text.Positions[i];
+			vertices[i].Normal = text.Normals[i];
+			vertices[i].TexC = { 0.0f,0.0f };
+		}
 
-	fin >> ignore >> vcount;
-	fin >> ignore >> tcount;
-	fin >> ignore >> ignore >> ignore >> ignore;
+		// Reorder once at import; skull.mesh stores the optimized order.
+		size_t vertexCount = vertices.size();
+		MeshOptimizer::Optimize(vertices.data(), vertexCount, sizeof(Vertex),
+			text.Indices.data(), text.Indices.size(), "skull");
+		vertices.resize(vertexCount);
 
-	std::vector<Vertex> vertices(vcount);
-	for (UINT i = 0; i < vcount; ++i)
-	{
-		fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-		fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
+		// Quantized after the reorder, against the bounds the file stores.
+		std::vector<CompactVertex> compactVertices;
+		const void* vertexData = vertices.data();
+		if (mUseCompactVertices)
+		{
+			compactVertices.resize(vertices.size());
+			VertexQuantizer::Quantize(vertices.data(), VertexLayout(), (UINT)vertices.size(),
+				text.Bounds, mPositionEncoding, compactVertices.data());
+			vertexData = compactVertices.data();
+		}
 
-		vertices[i].TexC = { 0.0f,0.0f };
+		if (!MeshFile::Write(L"Models/skull.mesh",
+			vertexData, vertexStride, (UINT)vertices.size(),
+			text.Indices.data(), sizeof(std::uint32_t), (UINT)text.Indices.size(),
+			text.Bounds, vertexFormat) ||
+			!mesh.Open(L"Models/skull.mesh", vertexStride, vertexFormat))
+		{
+			MessageBox(0, L"Models/skull.mesh could not be written", 0, 0);
+			return;
+		}
 	}
 
-	fin >> ignore;
-	fin >> ignore;
-	fin >> ignore;
+	// Vertices are read straight from the mapped file.
+	const UINT vertexCount = mesh.Header().VertexCount;
+	const UINT indexCount = mesh.Header().IndexCount;
+	const UINT vbByteSize = mesh.VertexByteSize();
 
-	std::vector<std::uint32_t> indices(3 * tcount);
-	for (UINT i = 0; i < tcount; ++i)
+	std::vector<std::uint32_t> indices(indexCount);
+	if (mesh.Header().IndexStride == sizeof(std::uint16_t))
 	{
-		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
+		const std::uint16_t* src = reinterpret_cast<const std::uint16_t*>(mesh.Indices());
+		std::copy(src, src + indexCount, indices.begin());
+	}
+	else
+	{
+		CopyMemory(indices.data(), mesh.Indices(), indexCount * sizeof(std::uint32_t));
 	}
 
-	fin.close();
+	// The simplifier measures its error on the positions the shader will see.
+	const void* positions = mesh.Vertices();
+	size_t positionStride = sizeof(Vertex);
+	std::vector<XMFLOAT3> decodedPositions;
+	if (mUseCompactVertices)
+	{
+		decodedPositions.resize(vertexCount);
+		VertexQuantizer::DecodePositions(mesh.Vertices(), vertexStride, vertexCount,
+			mesh.Bounds(), mPositionEncoding, decodedPositions.data());
+		positions = decodedPositions.data();
+		positionStride = sizeof(XMFLOAT3);
+	}
 
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint32_t);
+	// The simplified levels only reference the original vertices, so they are
+	// appended to one index buffer and share the vertex buffer.
+	std::vector<MeshLodLevel> lods = MeshSimplifier::BuildLodChain(indices.data(), indexCount,
+		positions, vertexCount, positionStride);
 
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "skullGeo";
 
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+	std::vector<std::uint32_t> allIndices;
+	for (size_t i = 0; i < lods.size(); ++i)
+	{
+		SubmeshGeometry submesh;
+		submesh.IndexCount = (UINT)lods[i].Indices.size();
+		submesh.StartIndexLocation = (UINT)allIndices.size();
+		submesh.BaseVertexLocation = 0;
+		submesh.Bounds = mesh.Bounds();
+		submesh.LodError = lods[i].Error;
+
+		geo->DrawArgs[i == 0 ? "skull" : "skull_lod" + std::to_string(i)] = submesh;
+		allIndices.insert(allIndices.end(), lods[i].Indices.begin(), lods[i].Indices.end());
+	}
 
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+	const UINT ibByteSize = (UINT)(allIndices.size() * sizeof(std::uint32_t));
 
-	geo->VertexByteStride = sizeof(Vertex);
-	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
-	geo->IndexBufferByteSize = ibByteSize;
+	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), mesh.Vertices(), vbByteSize);
 
-	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
-	submesh.StartIndexLocation = 0;
-	submesh.BaseVertexLocation = 0;
+	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), allIndices.data(), ibByteSize);
 
-	geo->DrawArgs["skull"] = submesh;
+	std::lock_guard<std::mutex> lock(mGeometryMutex);
+	mGeometryPool->AddMesh(*mGeometryStaging, *geo,
+		mesh.Vertices(), vertexCount,
+		allIndices.data(), (UINT)allIndices.size(), sizeof(std::uint32_t));
 
 	mGeometries[geo->Name] = std::move(geo);
 }
 
 void StencilApp::BuildPSOs()
 {
+	// PSOs come out of the pipeline library saved by the previous run when they
+	// still match; only new or changed ones are compiled by the driver.  The
+	// library is saved once the deferred ones exist too.
+	mPsoCache = std::make_unique<PipelineStateCache>(md3dDevice.Get(), L"StencilDemo.psolib");
+
+	// Deferred PSOs draw the layers marked in mDeferredLayer.
+	auto addPso = [this](const std::string& name, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, bool deferred)
+	{
+		PsoBuild build;
+		build.Name = name;
+		build.Desc = desc;
+		build.Deferred = deferred;
+		mPsoBuilds.push_back(build);
+	};
+
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaquePsoDesc;
 
 	// opaque objects
@@ -862,7 +1889,7 @@ void StencilApp::BuildPSOs()
 	opaquePsoDesc.SampleDesc.Count = m4xMsaaState ? 4 : 1;
 	opaquePsoDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+	addPso("opaque", opaquePsoDesc, false);
 
 	// transparent objects
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC transparentPsoDesc = opaquePsoDesc;
@@ -880,7 +1907,7 @@ void StencilApp::BuildPSOs()
 	transparencyBlendDesc.RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
 
 	transparentPsoDesc.BlendState.RenderTarget[0] = transparencyBlendDesc;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&transparentPsoDesc, IID_PPV_ARGS(&mPSOs["transparent"])));
+	addPso("transparent", transparentPsoDesc, false);
 
 	// mark stencil mirrors
 	CD3DX12_BLEND_DESC mirrorBlendState(D3D12_DEFAULT);
@@ -908,7 +1935,7 @@ void StencilApp::BuildPSOs()
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC markMirrorsPsoDesc = opaquePsoDesc;
 	markMirrorsPsoDesc.BlendState = mirrorBlendState;
 	markMirrorsPsoDesc.DepthStencilState = mirrorDSS;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&markMirrorsPsoDesc, IID_PPV_ARGS(&mPSOs["markStencilMirrors"])));
+	addPso("markStencilMirrors", markMirrorsPsoDesc, false);
 
 	// stencil reflections
 	D3D12_DEPTH_STENCIL_DESC reflectionDSS;
@@ -934,7 +1961,7 @@ void StencilApp::BuildPSOs()
 	drawReflectionsPsoDesc.DepthStencilState = reflectionDSS;
 	drawReflectionsPsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;		// DONT DRAW BACK
 	drawReflectionsPsoDesc.RasterizerState.FrontCounterClockwise = true;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&drawReflectionsPsoDesc, IID_PPV_ARGS(&mPSOs["drawStencilReflections"])));
+	addPso("drawStencilReflections", drawReflectionsPsoDesc, true);
 
 	// shadow object
 	// we will draw shadows with transparency, so base it off transparency description.
@@ -959,12 +1986,71 @@ void StencilApp::BuildPSOs()
 
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC shadowPsoDesc = transparentPsoDesc;
 	shadowPsoDesc.DepthStencilState = shadowDSS;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&shadowPsoDesc, IID_PPV_ARGS(&mPSOs["shadow"])));
+	addPso("shadow", shadowPsoDesc, true);
+
+	// depth pre-pass
+	// The pre-pass keeps the pass's rasterizer and stencil state, so culling and the
+	// mirror mask match, but has no pixel shader.  The lit pass then only shades
+	// the pixels whose depth it laid down.
+	auto buildDepthPrepass = [&](const std::string& name, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, bool deferred)
+	{
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC depthPsoDesc = desc;
+		depthPsoDesc.InputLayout = { mDepthInputLayout.data(),(UINT)mDepthInputLayout.size() };
+		depthPsoDesc.VS =
+		{
+			reinterpret_cast<BYTE*>(mShaders["depthVS"]->GetBufferPointer()),
+			mShaders["depthVS"]->GetBufferSize()
+		};
+		depthPsoDesc.PS = { nullptr, 0 };
+		depthPsoDesc.BlendState.RenderTarget[0].RenderTargetWriteMask = 0;
+		addPso(name + "DepthPrepass", depthPsoDesc, deferred);
+
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC equalPsoDesc = desc;
+		equalPsoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_EQUAL;
+		equalPsoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+		addPso(name + "DepthEqual", equalPsoDesc, deferred);
+	};
+	buildDepthPrepass("opaque", opaquePsoDesc, false);
+	buildDepthPrepass("drawStencilReflections", drawReflectionsPsoDesc, true);
+
+	// Every name is in the map before any PSO is created, so filling in the
+	// deferred ones later never rehashes it under the threads recording a frame.
+	for (const PsoBuild& build : mPsoBuilds)
+		mPSOs[build.Name] = nullptr;
+
+	CreatePSOs(false);
+}
+
+void StencilApp::CreatePSOs(bool deferred)
+{
+	std::vector<const PsoBuild*> builds;
+	for (const PsoBuild& build : mPsoBuilds)
+	{
+		if (build.Deferred == deferred)
+			builds.push_back(&build);
+	}
+
+	auto create = [this, &builds](UINT i)
+	{
+		mPSOs.at(builds[i]->Name) = mPsoCache->CreateGraphicsPipelineState(builds[i]->Name, builds[i]->Desc);
+	};
+
+	// The first-frame PSOs are waited for, so they take every thread; the deferred
+	// ones run on a background thread beside the frames, one after another.
+	if (deferred)
+	{
+		for (UINT i = 0; i < (UINT)builds.size(); ++i)
+			create(i);
+	}
+	else
+	{
+		mJobs->ParallelFor(0, (UINT)builds.size(), 1, create);
+	}
 }
 
 void StencilApp::BuildFrameResources()
 {
-	for (int i = 0; i < gNumFrameResources; ++i)
+	for (int i = 0; i < mNumFrameResources; ++i)
 	{
 		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
 			2, (UINT)mAllRitems.size(), (UINT)mMaterials.size()));
@@ -976,7 +2062,9 @@ void StencilApp::BuildMaterials()
 	auto bricks = std::make_unique<Material>();
 	bricks->Name = "bricks";
 	bricks->MatCBIndex = 0;
-	bricks->DiffuseSrvHeapIndex = 0;;
+	// bricks, checkertile and icemirror sample the white placeholder
+	// until StreamTextures() points them at their own texture.
+	bricks->DiffuseSrvHeapIndex = (int)mPlaceholderSrv.Index;
 	bricks->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	bricks->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	bricks->Roughness = 0.25f;
@@ -984,7 +2072,7 @@ void StencilApp::BuildMaterials()
 	auto checkertile = std::make_unique<Material>();
 	checkertile->Name = "checkertile";
 	checkertile->MatCBIndex = 1;
-	checkertile->DiffuseSrvHeapIndex = 1;
+	checkertile->DiffuseSrvHeapIndex = (int)mPlaceholderSrv.Index;
 	checkertile->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	checkertile->FresnelR0 = XMFLOAT3(0.07f, 0.07f, 0.07f);
 	checkertile->Roughness = 0.3f;
@@ -992,7 +2080,7 @@ void StencilApp::BuildMaterials()
 	auto icemirror = std::make_unique<Material>();
 	icemirror->Name = "icemirror";
 	icemirror->MatCBIndex = 2;
-	icemirror->DiffuseSrvHeapIndex = 2;
+	icemirror->DiffuseSrvHeapIndex = (int)mPlaceholderSrv.Index;
 	icemirror->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 0.25f);
 	icemirror->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	icemirror->Roughness = 0.5f;
@@ -1000,7 +2088,7 @@ void StencilApp::BuildMaterials()
 	auto skullMat = std::make_unique<Material>();
 	skullMat->Name = "skullMat";
 	skullMat->MatCBIndex = 3;
-	skullMat->DiffuseSrvHeapIndex = 3;
+	skullMat->DiffuseSrvHeapIndex = (int)mPlaceholderSrv.Index;
 	skullMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	skullMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	skullMat->Roughness = 0.3f;
@@ -1008,7 +2096,7 @@ void StencilApp::BuildMaterials()
 	auto shadowMat = std::make_unique<Material>();
 	shadowMat->Name = "shadowMat";
 	shadowMat->MatCBIndex = 4;
-	shadowMat->DiffuseSrvHeapIndex = 3;
+	shadowMat->DiffuseSrvHeapIndex = (int)mPlaceholderSrv.Index;
 	shadowMat->DiffuseAlbedo = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.5f);
 	shadowMat->FresnelR0 = XMFLOAT3(0.001f, 0.001f, 0.001f);
 	shadowMat->Roughness = 0.0F;
@@ -1018,12 +2106,49 @@ void StencilApp::BuildMaterials()
 	mMaterials["icemirror"] = std::move(icemirror);
 	mMaterials["skullMat"] = std::move(skullMat);
 	mMaterials["shadowMat"] = std::move(shadowMat);
+
+	mMaterialTextures =
+	{
+		{ "bricks", "bricksTex" },
+		{ "checkertile", "checkboardTex" },
+		{ "icemirror", "iceTex" }
+	};
+
+	// The scene's materials follow the demo's in the material buffer.
+	for (uint32_t i = 0; i < mScene.Header().MaterialCount; ++i)
+	{
+		const SceneMaterial& sceneMat = mScene.Materials()[i];
+
+		auto mat = std::make_unique<Material>();
+		mat->Name = std::string("scene/") + mScene.String(sceneMat.Name);
+		mat->MatCBIndex = (int)mMaterials.size();
+		mat->DiffuseSrvHeapIndex = (int)mPlaceholderSrv.Index;
+		mat->DiffuseAlbedo = sceneMat.DiffuseAlbedo;
+		mat->FresnelR0 = sceneMat.FresnelR0;
+		mat->Roughness = sceneMat.Roughness;
+
+		if (sceneMat.DiffuseTexture != SceneNone)
+		{
+			const SceneTexture& sceneTex = mScene.Textures()[sceneMat.DiffuseTexture];
+			mMaterialTextures.push_back(std::make_pair(mat->Name, std::string("scene/") + mScene.String(sceneTex.Name)));
+		}
+
+		// OpenScene() made sure the names are unique.
+		mMaterials[mat->Name] = std::move(mat);
+	}
+
+	// Every material starts out dirty in all frame resources.
+	for (auto& e : mMaterials)
+	{
+		e.second->NumFramesDirty = mNumFrameResources;
+		mDirtyMaterials.push_back(e.second.get());
+	}
 }
 
 void StencilApp::BuildRenderItems()
 {
 	auto floorRitem = std::make_unique<RenderItem>();
-	floorRitem->World = MathHelper::Identity4x4();
+	floorRitem->Transform = mTransforms.AddNode(TransformHierarchy::NoParent, XMMatrixIdentity());
 	floorRitem->TexTransform = MathHelper::Identity4x4();
 	floorRitem->ObjCBIndex = 0;
 	floorRitem->Mat = mMaterials["checkertile"].get();
@@ -1032,10 +2157,11 @@ void StencilApp::BuildRenderItems()
 	floorRitem->IndexCount = floorRitem->Geo->DrawArgs["floor"].IndexCount;
 	floorRitem->StartIndexLocation = floorRitem->Geo->DrawArgs["floor"].StartIndexLocation;
 	floorRitem->BaseVertexLocation = floorRitem->Geo->DrawArgs["floor"].BaseVertexLocation;
+	floorRitem->Bounds = floorRitem->Geo->DrawArgs["floor"].Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(floorRitem.get());
 
 	auto wallsRitem = std::make_unique<RenderItem>();
-	wallsRitem->World = MathHelper::Identity4x4();
+	wallsRitem->Transform = mTransforms.AddNode(TransformHierarchy::NoParent, XMMatrixIdentity());
 	wallsRitem->TexTransform = MathHelper::Identity4x4();
 	wallsRitem->ObjCBIndex = 1;
 	wallsRitem->Mat = mMaterials["bricks"].get();
@@ -1043,10 +2169,13 @@ void StencilApp::BuildRenderItems()
 	wallsRitem->IndexCount = wallsRitem->Geo->DrawArgs["wall"].IndexCount;
 	wallsRitem->StartIndexLocation = wallsRitem->Geo->DrawArgs["wall"].StartIndexLocation;
 	wallsRitem->BaseVertexLocation = wallsRitem->Geo->DrawArgs["wall"].BaseVertexLocation;
+	wallsRitem->Bounds = wallsRitem->Geo->DrawArgs["wall"].Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(wallsRitem.get());
 
+	mSkullNode = mTransforms.AddNode(TransformHierarchy::NoParent, SkullWorld());
+
 	auto skullRitem = std::make_unique<RenderItem>();
-	skullRitem->World = MathHelper::Identity4x4();
+	skullRitem->Transform = mSkullNode;
 	skullRitem->TexTransform = MathHelper::Identity4x4();
 	skullRitem->ObjCBIndex = 2;
 	skullRitem->Mat = mMaterials["skullMat"].get();
@@ -1055,28 +2184,37 @@ void StencilApp::BuildRenderItems()
 	skullRitem->IndexCount = skullRitem->Geo->DrawArgs["skull"].IndexCount;
 	skullRitem->StartIndexLocation = skullRitem->Geo->DrawArgs["skull"].StartIndexLocation;
 	skullRitem->BaseVertexLocation = skullRitem->Geo->DrawArgs["skull"].BaseVertexLocation;
+	skullRitem->Bounds = skullRitem->Geo->DrawArgs["skull"].Bounds;
+	skullRitem->Lods.push_back(skullRitem->Geo->DrawArgs["skull"]);
+	for (int i = 1; skullRitem->Geo->DrawArgs.count("skull_lod" + std::to_string(i)); ++i)
+		skullRitem->Lods.push_back(skullRitem->Geo->DrawArgs["skull_lod" + std::to_string(i)]);
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(skullRitem.get());
-	mSkullRitem = skullRitem.get();
 
 	// reflected_skull will have different world matrix, 
-	// so it needs to be its own render item.
+	// so it needs to be its own render item.  The mirror is the z = 0 plane.
+	XMVECTOR mirrorPlane = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
 	auto reflectedSkullRitem = std::make_unique<RenderItem>();
 	*reflectedSkullRitem = *skullRitem;
+	reflectedSkullRitem->Transform = mTransforms.AddDerivedNode(mSkullNode, XMMatrixReflect(mirrorPlane));
 	reflectedSkullRitem->ObjCBIndex = 3;
-	mReflectedSkullRitem = reflectedSkullRitem.get();
 	mRitemLayer[(int)RenderLayer::Reflected].push_back(reflectedSkullRitem.get());
 
 	// shadowed skull with different world matrix
-	// so needs to be its own render item
+	// so needs to be its own render item.  It is squashed onto the floor along
+	// the main light and lifted a little to avoid z-fighting.
+	XMVECTOR shadowPlane = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+	XMVECTOR toMainLight = -XMLoadFloat3(&gMainLightDirection);
+	XMMATRIX S = XMMatrixShadow(shadowPlane, toMainLight);
+	XMMATRIX shadowOffsetY = XMMatrixTranslation(0.0f, 0.001f, 0.0f);
 	auto shadowedSkullRitem = std::make_unique<RenderItem>();
 	*shadowedSkullRitem = *skullRitem;
+	shadowedSkullRitem->Transform = mTransforms.AddDerivedNode(mSkullNode, S * shadowOffsetY);
 	shadowedSkullRitem->ObjCBIndex = 4;
 	shadowedSkullRitem->Mat = mMaterials["shadowMat"].get();
-	mShadowedSkullRitem = shadowedSkullRitem.get();
 	mRitemLayer[(int)RenderLayer::Shadow].push_back(shadowedSkullRitem.get());
 
 	auto mirrorRitem = std::make_unique<RenderItem>();
-	mirrorRitem->World = MathHelper::Identity4x4();
+	mirrorRitem->Transform = mTransforms.AddNode(TransformHierarchy::NoParent, XMMatrixIdentity());
 	mirrorRitem->TexTransform = MathHelper::Identity4x4();
 	mirrorRitem->ObjCBIndex = 5;
 	mirrorRitem->Mat = mMaterials["icemirror"].get();
@@ -1085,6 +2223,7 @@ void StencilApp::BuildRenderItems()
 	mirrorRitem->IndexCount = mirrorRitem->Geo->DrawArgs["mirror"].IndexCount;
 	mirrorRitem->StartIndexLocation = mirrorRitem->Geo->DrawArgs["mirror"].StartIndexLocation;
 	mirrorRitem->BaseVertexLocation = mirrorRitem->Geo->DrawArgs["mirror"].BaseVertexLocation;
+	mirrorRitem->Bounds = mirrorRitem->Geo->DrawArgs["mirror"].Bounds;
 	mRitemLayer[(int)RenderLayer::Mirrors].push_back(mirrorRitem.get());
 	mRitemLayer[(int)RenderLayer::Transparent].push_back(mirrorRitem.get());
 
@@ -1094,37 +2233,252 @@ void StencilApp::BuildRenderItems()
 	mAllRitems.push_back(std::move(reflectedSkullRitem));
 	mAllRitems.push_back(std::move(shadowedSkullRitem));
 	mAllRitems.push_back(std::move(mirrorRitem));
+
+	BuildSceneRenderItems();
+
+	mTransformRitems.resize(mTransforms.NodeCount(), nullptr);
+	for (auto& e : mAllRitems)
+		mTransformRitems[e->Transform] = e.get();
+
+	// Every item starts out dirty in all frame resources.
+	mTransforms.Update();
+	for (auto& e : mAllRitems)
+	{
+		e->NumFrameDirety = mNumFrameResources;
+		mDirtyRitems.push_back(e.get());
+	}
 }
 
 
-void StencilApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
+void StencilApp::BuildSceneRenderItems()
 {
-	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
-	UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
+	if (!mScene.IsOpen())
+		return;
+
+	// Each mesh is looked up once.  A mesh the demo does not build leaves its
+	// instances as empty nodes, so their children are still placed.
+	const uint32_t meshCount = mScene.Header().MeshCount;
+	std::vector<MeshGeometry*> meshGeos(meshCount, nullptr);
+	std::vector<std::vector<SubmeshGeometry>> meshLods(meshCount);
+	for (uint32_t i = 0; i < meshCount; ++i)
+	{
+		const SceneMesh& sceneMesh = mScene.Meshes()[i];
+		auto geo = mGeometries.find(mScene.String(sceneMesh.Geometry));
+		if (geo == mGeometries.end())
+			continue;
+
+		const std::string submesh = mScene.String(sceneMesh.Submesh);
+		auto args = geo->second->DrawArgs.find(submesh);
+		if (args == geo->second->DrawArgs.end())
+			continue;
+
+		meshGeos[i] = geo->second.get();
+		meshLods[i].push_back(args->second);
+		for (int lod = 1; geo->second->DrawArgs.count(submesh + "_lod" + std::to_string(lod)); ++lod)
+			meshLods[i].push_back(geo->second->DrawArgs[submesh + "_lod" + std::to_string(lod)]);
+	}
 
-	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
-	auto matCB = mCurrFrameResource->MaterialCB->Resource();
+	std::vector<Material*> mats(mScene.Header().MaterialCount);
+	for (uint32_t i = 0; i < mScene.Header().MaterialCount; ++i)
+		mats[i] = mMaterials.at(std::string("scene/") + mScene.String(mScene.Materials()[i].Name)).get();
 
-	for (size_t i = 0; i < ritems.size(); ++i)
+	const uint32_t instanceCount = mScene.Header().InstanceCount;
+	const SceneInstance* instances = mScene.Instances();
+	std::vector<UINT> nodes(instanceCount);
+	mAllRitems.reserve(mAllRitems.size() + instanceCount);
+	for (uint32_t i = 0; i < instanceCount; ++i)
 	{
-		auto ri = ritems[i];
+		const SceneInstance& instance = instances[i];
+		UINT parent = instance.Parent == SceneNone ? TransformHierarchy::NoParent : nodes[instance.Parent];
+		nodes[i] = mTransforms.AddNode(parent, SceneFile::LocalTransform(instance));
+
+		if (instance.Mesh == SceneNone || meshGeos[instance.Mesh] == nullptr)
+			continue;
+
+		const std::vector<SubmeshGeometry>& lods = meshLods[instance.Mesh];
+
+		auto ritem = std::make_unique<RenderItem>();
+		ritem->Transform = nodes[i];
+		ritem->TexTransform = MathHelper::Identity4x4();
+		ritem->ObjCBIndex = (UINT)mAllRitems.size();
+		ritem->Mat = mats[instance.Material];
+		ritem->Geo = meshGeos[instance.Mesh];
+		ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		ritem->IndexCount = lods[0].IndexCount;
+		ritem->StartIndexLocation = lods[0].StartIndexLocation;
+		ritem->BaseVertexLocation = lods[0].BaseVertexLocation;
+		ritem->Bounds = lods[0].Bounds;
+		if (lods.size() > 1)
+			ritem->Lods = lods;
+
+		mRitemLayer[instance.Layer].push_back(ritem.get());
+		mAllRitems.push_back(std::move(ritem));
+	}
+
+	// Everything is copied out; the mapping is not needed any more.
+	std::wostringstream report;
+	report << L"Scene " << mSceneFile << L": " << instanceCount << L" instances, "
+		<< mScene.Header().MaterialCount << L" materials, " << mScene.Header().TextureCount << L" textures\n";
+	OutputDebugString(report.str().c_str());
+
+	mScene.Close();
+}
+
+void StencilApp::BuildGpuCulling()
+{
+	// Root parameter 0 holds the per-draw object and material index.
+	mGpuCulling = std::make_unique<GpuCulling>(md3dDevice.Get(), mRootSignature.Get(), 0, (UINT)RenderLayer::Count,
+		mNumFrameResources);
 
-		cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-		cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
-		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+	// D3DApp's depth buffer is single sampled here; the scene PSOs assume no MSAA.
+	if (mUseOcclusionCulling)
+	{
+		mHiZ = std::make_unique<HiZPyramid>(md3dDevice.Get(), mDepthStencilBuffer.Get(),
+			DXGI_FORMAT_R24_UNORM_X8_TYPELESS);
+		mGpuCulling->SetOcclusion(mHiZ.get(), 1u << (UINT)RenderLayer::Opaque);
+	}
 
-		CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-		tex.Offset(ri->Mat->DiffuseSrvHeapIndex,mCbvSrvDescriptorSize);
+	// An item in several layers (the mirror) gets a record in each.
+	for (int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+	{
+		for (auto ri : mRitemLayer[layer])
+		{
+			SubmeshGeometry submesh;
+			submesh.IndexCount = ri->IndexCount;
+			submesh.StartIndexLocation = ri->StartIndexLocation;
+			submesh.BaseVertexLocation = ri->BaseVertexLocation;
+
+			const SubmeshGeometry* lods = ri->Lods.empty() ? &submesh : ri->Lods.data();
+			UINT lodCount = ri->Lods.empty() ? 1 : (UINT)ri->Lods.size();
+			mGpuCulling->AddRecord((UINT)layer, ri->ObjCBIndex, (UINT)ri->Mat->MatCBIndex,
+				ri->Bounds, lods, lodCount);
+		}
+	}
 
-		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex * objCBByteSize;
-		D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB->GetGPUVirtualAddress() + ri->Mat->MatCBIndex * matCBByteSize;
+	mGpuCulling->Upload(mCommandList.Get());
+}
 
-		cmdList->SetGraphicsRootDescriptorTable(0, tex);
-		cmdList->SetGraphicsRootConstantBufferView(1, objCBAddress);
-		cmdList->SetGraphicsRootConstantBufferView(3, matCBAddress);
+void StencilApp::PrepareLayerCommandList(ID3D12GraphicsCommandList* cmdList, RenderLayer layer, bool depthOnly)
+{
+	// Every list starts with no state, so each one sets up the whole pass.
+	if (mDynamicResolution != nullptr)
+	{
+		D3D12_VIEWPORT viewport = mDynamicResolution->Viewport();
+		D3D12_RECT scissorRect = mDynamicResolution->ScissorRect();
+		D3D12_CPU_DESCRIPTOR_HANDLE sceneTarget = mRenderGraph->RenderTargetView(mSceneTarget);
+		cmdList->RSSetViewports(1, &viewport);
+		cmdList->RSSetScissorRects(1, &scissorRect);
+		cmdList->OMSetRenderTargets(1, &sceneTarget, true, &DepthStencilView());
+	}
+	else
+	{
+		cmdList->RSSetViewports(1, &mScreenViewport);
+		cmdList->RSSetScissorRects(1, &mScissorRect);
 
-		cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		// specify the buffers we want to render, look at that StencilView~
+		cmdList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
 	}
+
+	ID3D12DescriptorHeap* descriptorHeap[] = { mSrvHeap->Heap() };
+	cmdList->SetDescriptorHeaps(_countof(descriptorHeap), descriptorHeap);
+
+	cmdList->SetGraphicsRootSignature(mRootSignature.Get());
+
+	const char* psoName = "opaque";
+	UINT stencilRef = 0;
+	UINT passIndex = 0;
+
+	switch (layer)
+	{
+	case RenderLayer::Mirrors:
+		// Mark the visible mirror pixels in the stencil buffer with the value 1
+		psoName = "markStencilMirrors";
+		stencilRef = 1;
+		break;
+	case RenderLayer::Reflected:
+		// Draw the reflection into the mirror only (stencil buffer value is 1)
+		// with the pass constants whose lights are reflected too.
+		psoName = "drawStencilReflections";
+		stencilRef = 1;
+		passIndex = 1;
+		break;
+	case RenderLayer::Transparent:
+		// draw mirror with transparency so reflection blends through
+		psoName = "transparent";
+		break;
+	case RenderLayer::Shadow:
+		psoName = "shadow";
+		break;
+	default:
+		break;
+	}
+
+	const auto& passCB = mDrawFrame.Resource->PassCB;
+
+	// at() rather than operator[]: this runs on several threads at once.
+	std::string pso = psoName;
+	if (mDepthPrepass[(int)layer])
+		pso += depthOnly ? "DepthPrepass" : "DepthEqual";
+
+	cmdList->SetPipelineState(mPSOs.at(pso).Get());
+	cmdList->OMSetStencilRef(stencilRef);
+	cmdList->SetGraphicsRootConstantBufferView(1, passCB.GpuAddress(passIndex));
+	cmdList->SetGraphicsRootShaderResourceView(2, mDrawFrame.Resource->ObjectBuffer.GpuAddress());
+	cmdList->SetGraphicsRootShaderResourceView(3, mDrawFrame.Resource->MaterialBuffer.GpuAddress());
+	cmdList->SetGraphicsRootDescriptorTable(4, mSrvHeap->GpuHandle(0));
+}
+
+void StencilApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<DrawItem>& items, size_t first, size_t count)
+{
+	// Meshes from mGeometryPool all share one VB/IB, so these are normally set
+	// once per command list.
+	D3D12_GPU_VIRTUAL_ADDRESS boundVB = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS boundIB = 0;
+	D3D12_PRIMITIVE_TOPOLOGY boundTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+
+	for (size_t i = first; i < first + count; ++i)
+	{
+		const DrawItem& item = items[i];
+		const RenderItem* ri = item.Item;
+
+		D3D12_VERTEX_BUFFER_VIEW vbv = ri->Geo->VertexBufferView();
+		if (vbv.BufferLocation != boundVB)
+		{
+			cmdList->IASetVertexBuffers(0, 1, &vbv);
+			boundVB = vbv.BufferLocation;
+		}
+
+		D3D12_INDEX_BUFFER_VIEW ibv = ri->Geo->IndexBufferView();
+		if (ibv.BufferLocation != boundIB)
+		{
+			cmdList->IASetIndexBuffer(&ibv);
+			boundIB = ibv.BufferLocation;
+		}
+
+		if (ri->PrimitiveType != boundTopology)
+		{
+			cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+			boundTopology = ri->PrimitiveType;
+		}
+
+		// Objects, materials and textures are all indexed in the shader.
+		UINT drawIndices[2] = { ri->ObjCBIndex, (UINT)ri->Mat->MatCBIndex };
+		cmdList->SetGraphicsRoot32BitConstants(0, 2, drawIndices, 0);
+
+		cmdList->DrawIndexedInstanced(item.IndexCount, 1, item.StartIndexLocation, ri->BaseVertexLocation, 0);
+	}
+}
+
+void StencilApp::DrawLayerIndirect(ID3D12GraphicsCommandList* cmdList, RenderLayer layer, bool late)
+{
+	// Every record's mesh comes from mGeometryPool, so one VB/IB serves the layer.
+	D3D12_VERTEX_BUFFER_VIEW vbv = mGeometryPool->VertexBufferView();
+	D3D12_INDEX_BUFFER_VIEW ibv = mGeometryPool->IndexBufferView();
+	cmdList->IASetVertexBuffers(0, 1, &vbv);
+	cmdList->IASetIndexBuffer(&ibv);
+	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	mGpuCulling->Draw(cmdList, (UINT)layer, late);
 }
 
 std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> StencilApp::GetStaticSamplers()
@@ -14,6 +14,13 @@
 
 Texture2D gDiffuseMap : register(t0);
 
+#ifdef DISPLACEMENT_MAP
+#include "../../Shader/WaveDisplacement.hlsl"
+
+// Wave heights written by WaveSim.hlsl.
+Texture2D gDisplacementMap : register(t1);
+#endif
+
 SamplerState gsamPointWrap : register(s0);
 SamplerState gsamPointClamp : register(s1);
 SamplerState gsamLinearWrap : register(s2);
@@ -25,6 +32,8 @@ cbuffer cbPerObject : register(b0)
 {
     float4x4 gWorld;
     float4x4 gTexTransform;
+    float gGridSpatialStep;
+    float3 cbPerObjectPad0;
 };
 
 cbuffer cbPass : register(b1)
@@ -71,10 +80,14 @@ struct VertexOut
     float2 TexC : TEXCOORD;
 };
 
-VertexOut VS(VertexIn vin)
+VertexOut VS(VertexIn vin, uint vertexId : SV_VertexID)
 {
     VertexOut vout = (VertexOut) 0.0f;
     
+#ifdef DISPLACEMENT_MAP
+    vin.PosL.y += WaveHeight(gDisplacementMap, vertexId, gGridSpatialStep, vin.NoramlL);
+#endif
+    
     float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
     vout.PosW = posW;
     
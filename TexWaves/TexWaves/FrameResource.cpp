@@ -11,7 +11,10 @@ FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCo
 	MaterialCB = std::make_unique<UploadBuffer<MaterialConstants>>(device, materialCount, true);
 	ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
 
-	WavesVB = std::make_unique<UploadBuffer<Vertex>>(device, waveVertCount, false);
+	// The GPU wave simulation displaces a static grid in the vertex shader,
+	// so it does not need any per-frame vertex data.
+	if (waveVertCount > 0)
+		WavesVB = std::make_unique<UploadBuffer<Vertex>>(device, waveVertCount, false);
 }
 
 FrameResource::~FrameResource()
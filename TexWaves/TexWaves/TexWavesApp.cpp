@@ -2,6 +2,8 @@
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/TextureConverter.h"
+#include "../../Common/GpuWaves.h"
 #include "FrameResource.h"
 #include "Waves.h"
 
@@ -19,6 +21,9 @@ struct RenderItem
 
 	XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
 
+	// Only used by the GPU waves render item.
+	float GridSpatialStep = 1.0f;
+
 	int NumFramesDirty = gNumFrameResources;
 
 	UINT ObjCBIndex = -1;
@@ -36,6 +41,7 @@ struct RenderItem
 enum class RenderLayer :int
 {
 	Opaque = 0,
+	GpuWaves,
 	Count
 };
 
@@ -53,6 +59,7 @@ private:
 	virtual void OnResize()override;
 	virtual void Update(const GameTimer& gt)override;
 	virtual void Draw(const GameTimer& gt)override;
+	virtual void PrecompileShaders()override;
 
 	virtual void OnMouseDown(WPARAM btnState, int x, int y)override;
 	virtual void OnMouseUp(WPARAM btnState, int x, int y)override;
@@ -65,9 +72,11 @@ private:
 	void UpdateMaterialCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 	void UpdateWaves(const GameTimer& gt);
+	void UpdateWavesGPU(const GameTimer& gt);
 
 	void LoadTextures();
 	void BuildRootSignature();
+	void BuildWavesRootSignature();
 	void BuildDescriptorHeaps();
 	void BuildShadersAndInputLayout();
 	void BuildLandGeometry();
@@ -92,6 +101,7 @@ private:
 	UINT mCbvSrvDescriptorSize = 0;
 
 	ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
+	ComPtr<ID3D12RootSignature> mWavesRootSignature = nullptr;
 
 	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 
@@ -109,7 +119,13 @@ private:
 
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
+	// Run the wave simulation in a compute shader and displace a static grid in
+	// the vertex shader.  Set false to fall back to the CPU Waves class, which
+	// rewrites the whole vertex buffer every frame.
+	bool mUseGpuWaves = true;
+
 	std::unique_ptr<Waves> mWaves;
+	std::unique_ptr<GpuWaves> mGpuWaves;
 
 	PassConstants mMainPassCB;
 
@@ -167,10 +183,15 @@ bool TexWavesApp::Initialize()
 
 	mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
-	mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+	if (mUseGpuWaves)
+		mGpuWaves = std::make_unique<GpuWaves>(md3dDevice.Get(), mCommandList.Get(),
+			128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+	else
+		mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
 
 	LoadTextures();
 	BuildRootSignature();
+	BuildWavesRootSignature();
 	BuildDescriptorHeaps();
 	BuildShadersAndInputLayout();
 	BuildLandGeometry();
@@ -187,6 +208,9 @@ bool TexWavesApp::Initialize()
 
 	FlushCommandQueue();
 
+	if (mGpuWaves != nullptr)
+		mGpuWaves->DisposeUploaders();
+
 	return true;
 }
 
@@ -206,19 +230,14 @@ void TexWavesApp::Update(const GameTimer& gt)
 	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
 	mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
 
-	if (mCurrFrameResource->Fence != 0 && mFence->GetCompletedValue() < mCurrFrameResource->Fence)
-	{
-		HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-		ThrowIfFailed(mFence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle));
-		WaitForSingleObject(eventHandle, INFINITE);
-		CloseHandle(eventHandle);
-	}
+	WaitForFence(mCurrFrameResource->Fence);
 
 	AnimateMaterials(gt);
 	UpdateObjectCBs(gt);
 	UpdateMaterialCBs(gt);
 	UpdateMainPassCB(gt);
-	UpdateWaves(gt);
+	if (!mUseGpuWaves)
+		UpdateWaves(gt);
 }
 
 void TexWavesApp::Draw(const GameTimer& gt)
@@ -243,6 +262,14 @@ void TexWavesApp::Draw(const GameTimer& gt)
 	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
 	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
+	// The waves step binds its own compute root signature and PSO, so it goes
+	// before the graphics state below is set.
+	if (mUseGpuWaves)
+	{
+		UpdateWavesGPU(gt);
+		mCommandList->SetPipelineState(mPSOs["opaque"].Get());
+	}
+
 	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
 
 	auto passCB = mCurrFrameResource->PassCB->Resource();
@@ -250,6 +277,13 @@ void TexWavesApp::Draw(const GameTimer& gt)
 
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
 
+	if (mUseGpuWaves)
+	{
+		mCommandList->SetPipelineState(mPSOs["wavesRender"].Get());
+		mCommandList->SetGraphicsRootDescriptorTable(4, mGpuWaves->DisplacementMap());
+		DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::GpuWaves]);
+	}
+
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
 		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
 
@@ -258,8 +292,7 @@ void TexWavesApp::Draw(const GameTimer& gt)
 	ID3D12CommandList* cmdsList[] = { mCommandList.Get() };
 	mCommandQueue->ExecuteCommandLists(_countof(cmdsList), cmdsList);
 
-	ThrowIfFailed(mSwapChain->Present(0, 0));
-	mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
+	Present();
 
 	mCurrFrameResource->Fence = ++mCurrentFence;
 
@@ -393,6 +426,7 @@ void TexWavesApp::UpdateObjectCBs(const GameTimer& gt)
 		ObjectConstants objConstants;
 		XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
 		XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
+		objConstants.GridSpatialStep = e->GridSpatialStep;
 
 		currObjectCB->CopyData(e->ObjCBIndex, objConstants);
 
@@ -473,7 +507,7 @@ void TexWavesApp::UpdateWaves(const GameTimer& gt)
 		mWaves->Disturb(i, j, r);
 	}
 
-	mWaves->Update(gt.DeltaTime());
+	mWaves->Update(gt.DeltaTime(), *mJobs);
 
 	auto currWavesVB = mCurrFrameResource->WavesVB.get();
 	for (int i = 0; i < mWaves->VertexCount(); ++i)
@@ -492,6 +526,28 @@ void TexWavesApp::UpdateWaves(const GameTimer& gt)
 	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
 }
 
+void TexWavesApp::UpdateWavesGPU(const GameTimer& gt)
+{
+	// Update the wave simulation.
+	if (!mGpuWaves->Update(gt.DeltaTime(), mCommandList.Get(), mWavesRootSignature.Get(), mPSOs["wavesUpdate"].Get()))
+		return;
+
+	// Every quarter second, generate a random wave.  Only right after a step: the
+	// solution it changes is then one no frame has drawn yet.
+	static float t_base = 0.0f;
+	if ((mTimer.TotalTime() - t_base) >= 0.25f)
+	{
+		t_base += 0.25f;
+
+		int i = MathHelper::Rand(4, mGpuWaves->RowCount() - 5);
+		int j = MathHelper::Rand(4, mGpuWaves->ColumnCount() - 5);
+
+		float r = MathHelper::RandF(0.2f, 0.5f);
+
+		mGpuWaves->Disturb(mCommandList.Get(), mWavesRootSignature.Get(), mPSOs["wavesDisturb"].Get(), i, j, r);
+	}
+}
+
 void TexWavesApp::LoadTextures()
 {
 	auto grassTex = std::make_unique<Texture>();
@@ -500,6 +556,7 @@ void TexWavesApp::LoadTextures()
 	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
 		mCommandList.Get(), grassTex->Filename.c_str(),
 		grassTex->Resource, grassTex->UploadHeap));
+	TextureConverter::Validate(*grassTex);
 
 	auto waterTex = std::make_unique<Texture>();
 	waterTex->Name = "waterTex";
@@ -507,6 +564,7 @@ void TexWavesApp::LoadTextures()
 	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
 		mCommandList.Get(), waterTex->Filename.c_str(),
 		waterTex->Resource, waterTex->UploadHeap));
+	TextureConverter::Validate(*waterTex);
 
 	auto fenceTex = std::make_unique<Texture>();
 	fenceTex->Name = "fenceTex";
@@ -514,6 +572,7 @@ void TexWavesApp::LoadTextures()
 	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
 		mCommandList.Get(), fenceTex->Filename.c_str(),
 		fenceTex->Resource, fenceTex->UploadHeap));
+	TextureConverter::Validate(*fenceTex);
 
 	mTextures[grassTex->Name] = std::move(grassTex);
 	mTextures[waterTex->Name] = std::move(waterTex);
@@ -525,16 +584,21 @@ void TexWavesApp::BuildRootSignature()
 	CD3DX12_DESCRIPTOR_RANGE texTable;
 	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
 
-	CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+	// Displacement map of the GPU waves, read by the vertex shader.
+	CD3DX12_DESCRIPTOR_RANGE displacementMapTable;
+	displacementMapTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1);
+
+	CD3DX12_ROOT_PARAMETER slotRootParameter[5];
 
 	slotRootParameter[0].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
 	slotRootParameter[1].InitAsConstantBufferView(0);
 	slotRootParameter[2].InitAsConstantBufferView(1);
 	slotRootParameter[3].InitAsConstantBufferView(2);
+	slotRootParameter[4].InitAsDescriptorTable(1, &displacementMapTable, D3D12_SHADER_VISIBILITY_VERTEX);
 
 	auto staticSamplers = GetStaticSamplers();
 
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(5, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -557,10 +621,19 @@ void TexWavesApp::BuildRootSignature()
 	));
 }
 
+void TexWavesApp::BuildWavesRootSignature()
+{
+	if (mUseGpuWaves)
+		mGpuWaves->BuildRootSignature(md3dDevice.Get(), mWavesRootSignature);
+}
+
 void TexWavesApp::BuildDescriptorHeaps()
 {
+	const UINT textureDescriptorCount = 3;
+	const UINT wavesDescriptorCount = mUseGpuWaves ? mGpuWaves->DescriptorCount() : 0;
+
 	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 3;
+	srvHeapDesc.NumDescriptors = textureDescriptorCount + wavesDescriptorCount;
 	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
@@ -588,13 +661,42 @@ void TexWavesApp::BuildDescriptorHeaps()
 
 	srvDesc.Format = fenceTex->GetDesc().Format;
 	md3dDevice->CreateShaderResourceView(fenceTex.Get(), &srvDesc, hDescriptor);
+
+	// The waves descriptors go after the textures.
+	if (mUseGpuWaves)
+	{
+		mGpuWaves->BuildDescriptors(
+			CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(),
+				textureDescriptorCount, mCbvSrvDescriptorSize),
+			CD3DX12_GPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart(),
+				textureDescriptorCount, mCbvSrvDescriptorSize),
+			mCbvSrvDescriptorSize);
+	}
+}
+
+void TexWavesApp::PrecompileShaders()
+{
+	BuildShadersAndInputLayout();
 }
 
 void TexWavesApp::BuildShadersAndInputLayout()
 {
+	const D3D_SHADER_MACRO wavesDefines[] =
+	{
+		"DISPLACEMENT_MAP", "1",
+		NULL, NULL
+	};
+
 	mShaders["standardVS"] = d3dUtil::CompileShader(L"Default.hlsl", nullptr, "VS", "vs_5_0");
 	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Default.hlsl", nullptr, "PS", "ps_5_0");
 
+	if (mUseGpuWaves)
+	{
+		mShaders["wavesVS"] = d3dUtil::CompileShader(L"Default.hlsl", wavesDefines, "VS", "vs_5_0");
+		mShaders["wavesUpdateCS"] = d3dUtil::CompileShader(L"../../Shader/WaveSim.hlsl", nullptr, "UpdateWavesCS", "cs_5_0");
+		mShaders["wavesDisturbCS"] = d3dUtil::CompileShader(L"../../Shader/WaveSim.hlsl", nullptr, "DisturbWavesCS", "cs_5_0");
+	}
+
 	mInputLayout =
 	{
 		{"POSITION",0,DXGI_FORMAT_R32G32B32_FLOAT,0,0,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0},
@@ -655,6 +757,61 @@ void TexWavesApp::BuildLandGeometry()
 
 void TexWavesApp::BuildWavesGeometry()
 {
+	if (mUseGpuWaves)
+	{
+		// The heights come from the displacement map, so the grid itself never changes
+		// and can live in a default buffer like any other static mesh.
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData grid = geoGen.CreateGrid(
+			(mGpuWaves->ColumnCount() - 1) * mGpuWaves->SpatialStep(),
+			(mGpuWaves->RowCount() - 1) * mGpuWaves->SpatialStep(),
+			mGpuWaves->RowCount(), mGpuWaves->ColumnCount());
+
+		std::vector<Vertex> vertices(grid.Vertices.size());
+		for (size_t i = 0; i < grid.Vertices.size(); ++i)
+		{
+			vertices[i].Pos = grid.Vertices[i].Position;
+			vertices[i].Normal = grid.Vertices[i].Normal;
+			vertices[i].TexC = grid.Vertices[i].TexC;
+		}
+
+		std::vector<std::uint16_t> indices = grid.GetIndices16();
+		assert(vertices.size() < 0x0000ffff);
+
+		UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+		UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+
+		auto geo = std::make_unique<MeshGeometry>();
+		geo->Name = "waterGeo";
+
+		ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+		CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+
+		ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+
+		geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+			mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+
+		geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+			mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+
+		geo->VertexByteStride = sizeof(Vertex);
+		geo->VertexBufferByteSize = vbByteSize;
+		geo->IndexBufferByteSize = ibByteSize;
+		geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+
+		SubmeshGeometry submesh;
+		submesh.IndexCount = (UINT)indices.size();
+		submesh.StartIndexLocation = 0;
+		submesh.BaseVertexLocation = 0;
+
+		geo->DrawArgs["grid"] = submesh;
+
+		mGeometries["waterGeo"] = std::move(geo);
+		return;
+	}
+
 	std::vector<std::uint16_t> indices(3 * mWaves->TriangleCount());
 	assert(mWaves->VertexCount() < 0x0000ffff);
 
@@ -784,6 +941,37 @@ void TexWavesApp::BuildPSOs()
 	opaquePsoDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+
+	if (mUseGpuWaves)
+	{
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC wavesRenderPSO = opaquePsoDesc;
+		wavesRenderPSO.VS =
+		{
+			reinterpret_cast<BYTE*>(mShaders["wavesVS"]->GetBufferPointer()),
+			mShaders["wavesVS"]->GetBufferSize()
+		};
+		ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&wavesRenderPSO, IID_PPV_ARGS(&mPSOs["wavesRender"])));
+
+		D3D12_COMPUTE_PIPELINE_STATE_DESC wavesDisturbPSO = {};
+		wavesDisturbPSO.pRootSignature = mWavesRootSignature.Get();
+		wavesDisturbPSO.CS =
+		{
+			reinterpret_cast<BYTE*>(mShaders["wavesDisturbCS"]->GetBufferPointer()),
+			mShaders["wavesDisturbCS"]->GetBufferSize()
+		};
+		wavesDisturbPSO.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+		ThrowIfFailed(md3dDevice->CreateComputePipelineState(&wavesDisturbPSO, IID_PPV_ARGS(&mPSOs["wavesDisturb"])));
+
+		D3D12_COMPUTE_PIPELINE_STATE_DESC wavesUpdatePSO = {};
+		wavesUpdatePSO.pRootSignature = mWavesRootSignature.Get();
+		wavesUpdatePSO.CS =
+		{
+			reinterpret_cast<BYTE*>(mShaders["wavesUpdateCS"]->GetBufferPointer()),
+			mShaders["wavesUpdateCS"]->GetBufferSize()
+		};
+		wavesUpdatePSO.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+		ThrowIfFailed(md3dDevice->CreateComputePipelineState(&wavesUpdatePSO, IID_PPV_ARGS(&mPSOs["wavesUpdate"])));
+	}
 }
 
 void TexWavesApp::BuildFrameResources()
@@ -791,7 +979,7 @@ void TexWavesApp::BuildFrameResources()
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
 		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-			1, (UINT)mAllRitems.size(), (UINT)mMaterials.size(), mWaves->VertexCount()));
+			1, (UINT)mAllRitems.size(), (UINT)mMaterials.size(), mUseGpuWaves ? 0 : mWaves->VertexCount()));
 	}
 }
 
@@ -841,7 +1029,15 @@ void TexWavesApp::BuildRenderItems()
 
 	mWavesRitem = wavesRitem.get();
 
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(wavesRitem.get());
+	if (mUseGpuWaves)
+	{
+		wavesRitem->GridSpatialStep = mGpuWaves->SpatialStep();
+		mRitemLayer[(int)RenderLayer::GpuWaves].push_back(wavesRitem.get());
+	}
+	else
+	{
+		mRitemLayer[(int)RenderLayer::Opaque].push_back(wavesRitem.get());
+	}
 
 	auto gridRitem = std::make_unique<RenderItem>();
 	gridRitem->World = MathHelper::Identity4x4();
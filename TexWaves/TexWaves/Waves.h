@@ -3,6 +3,8 @@
 #include <vector>
 #include <DirectXMath.h>
 
+class JobSystem;
+
 class Waves
 {
 public:
@@ -24,7 +26,7 @@ public:
 
 	const DirectX::XMFLOAT3& TangentX(int i)const { return mTangentX[i]; }
 
-	void Update(float dt);
+	void Update(float dt, JobSystem& jobs);
 	void Disturb(int i, int j, float magnitude);
 
 private: